@@ -14,11 +14,13 @@
 #include <propidl.h>
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include <gdiplus.h>
 
+#include "BackgroundSurfaceCache.h"
 #include "OptionsStore.h"
 
 namespace shelltabs {
@@ -44,6 +46,13 @@ bool CopyImageToBackgroundCache(const std::wstring& sourcePath,
 
 std::unique_ptr<Gdiplus::Bitmap> LoadBackgroundBitmap(const std::wstring& path);
 
+// Decodes an image to premultiplied BGRA. Needs GDI+ on the calling thread.
+std::optional<BackgroundPixels> DecodeBackgroundPixels(const std::wstring& path);
+
+// Decoded backgrounds at their painted sizes, shared by every Explorer window
+// in the process.
+BackgroundSurfaceCache& GetBackgroundSurfaceCache();
+
 void TouchCachedImage(const std::wstring& path) noexcept;
 
 std::vector<std::wstring> CollectCachedImageReferences(const ShellTabsOptions& options);
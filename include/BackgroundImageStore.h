@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <limits>
+#include <optional>
+#include <set>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "ContentHash.h"
+
+namespace shelltabs {
+
+struct BackgroundImageRecord {
+    ContentDigest digest;
+    // Relative to the store directory.
+    std::filesystem::path fileName;
+    uint64_t bytes = 0;
+    // Seconds since the Unix epoch.
+    uint64_t lastUse = 0;
+    // Option entries pointing at the image as of the last SetReferences.
+    uint32_t references = 0;
+};
+
+struct BackgroundImageImport {
+    std::filesystem::path path;
+    // False when an image with the same content was already stored.
+    bool created = false;
+};
+
+struct BackgroundImageRemoval {
+    std::vector<std::filesystem::path> removed;
+    std::vector<std::pair<std::filesystem::path, std::error_code>> failures;
+};
+
+// Content-addressed store for folder background images. Imported files are
+// named after a hash of their bytes, so picking the same picture again, for
+// any number of folders, resolves to the file already stored. A small text
+// manifest beside the images records each file's digest, size, last use and
+// reference count; usage is tracked there rather than in file timestamps.
+//
+// Maintenance works from the manifest alone: unreferenced images are indexed
+// by last use, so eviction costs O(evicted) and reference updates cost
+// O(references) regardless of how many images are stored. Open lists the
+// directory's file names and scans only when the manifest is missing,
+// unreadable or names other files, and Rescan scans on demand; the scan
+// drops records whose files are gone and hashes and adopts files the
+// manifest does not know, such as images cached before the store existed.
+//
+// Every Explorer process shares the directory. Saves take a lock file and
+// merge the manifest on disk into their own records first, so one process
+// never drops another's images.
+//
+// File names compare case-insensitively, as on Windows. Thread safe.
+class BackgroundImageStore {
+public:
+    // Touch only rewrites the manifest once a recorded use is this old, so
+    // painting does not turn into a stream of manifest writes.
+    static constexpr uint64_t kTouchResolutionSeconds = 60 * 60;
+
+    BackgroundImageStore() = default;
+    BackgroundImageStore(const BackgroundImageStore&) = delete;
+    BackgroundImageStore& operator=(const BackgroundImageStore&) = delete;
+
+    bool Open(const std::filesystem::path& directory, uint64_t now);
+    bool IsOpen() const;
+    std::filesystem::path Directory() const;
+    // Reconciles the manifest with the directory contents.
+    void Rescan(uint64_t now);
+
+    // Returns the stored copy of source, copying it in only when no stored
+    // image has the same content.
+    std::optional<BackgroundImageImport> Import(const std::filesystem::path& source, uint64_t now,
+                                                std::error_code* error = nullptr);
+    // Records a use of a stored image. Returns false for unknown files.
+    bool Touch(const std::filesystem::path& path, uint64_t now);
+    // Replaces every reference count with the number of times each image
+    // appears in paths, and marks those images used.
+    void SetReferences(const std::vector<std::filesystem::path>& paths, uint64_t now);
+    // Deletes images without references that have not been used for
+    // maxIdleSeconds (0 removes every unreferenced image), then the least
+    // recently used unreferenced images until the store fits maxTotalBytes.
+    // Referenced images are never removed, even over the cap.
+    BackgroundImageRemoval RemoveUnreferenced(uint64_t now, uint64_t maxIdleSeconds,
+                                              uint64_t maxTotalBytes = std::numeric_limits<uint64_t>::max());
+
+    std::optional<BackgroundImageRecord> Find(const std::filesystem::path& path) const;
+    std::vector<BackgroundImageRecord> Records() const;
+    uint64_t TotalBytes() const;
+
+private:
+    // Last-write time and size of the manifest, to tell whether another
+    // process wrote it since this one did.
+    using ManifestStamp = std::pair<std::filesystem::file_time_type, uintmax_t>;
+
+    static std::wstring KeyFor(const std::filesystem::path& path);
+
+    bool LoadManifestLocked();
+    bool ManifestMatchesDirectoryLocked() const;
+    // Folds records written by other processes into this one's.
+    void MergeManifestLocked();
+    bool SaveManifestLocked();
+    bool RescanLocked(uint64_t now);
+    void InsertLocked(BackgroundImageRecord record);
+    void EraseLocked(const std::wstring& key);
+    // Changes a record's usage while keeping the indexes in step.
+    bool UpdateUsageLocked(const std::wstring& key, uint64_t lastUse, uint32_t references);
+
+    mutable std::mutex m_mutex;
+    std::filesystem::path m_directory;
+    bool m_open = false;
+    // Keyed by lowercased file name.
+    std::unordered_map<std::wstring, BackgroundImageRecord> m_records;
+    std::unordered_multimap<ContentDigest, std::wstring, ContentDigestHasher> m_byDigest;
+    // (lastUse, key) of every record without references, oldest first.
+    std::set<std::pair<uint64_t, std::wstring>> m_idle;
+    std::unordered_set<std::wstring> m_referenced;
+    uint64_t m_totalBytes = 0;
+    std::optional<ManifestStamp> m_manifestStamp;
+};
+
+}  // namespace shelltabs
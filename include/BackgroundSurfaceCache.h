@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "PreviewWorkQueue.h"
+
+namespace shelltabs {
+
+// Premultiplied 32bpp BGRA, top-down with no row padding.
+struct BackgroundPixels {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> bgra;
+
+    size_t Bytes() const noexcept { return bgra.size() * sizeof(uint32_t); }
+};
+
+// A background as it is painted: the image stretched to a surface size, in
+// physical pixels, at a monitor DPI.
+struct BackgroundSurfaceKey {
+    std::wstring imagePath;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t dpi = 96;
+
+    friend bool operator==(const BackgroundSurfaceKey& left, const BackgroundSurfaceKey& right) noexcept {
+        return left.width == right.width && left.height == right.height && left.dpi == right.dpi &&
+               left.imagePath == right.imagePath;
+    }
+};
+
+struct BackgroundSurfaceKeyHasher {
+    size_t operator()(const BackgroundSurfaceKey& key) const noexcept;
+};
+
+struct BackgroundSurfaceCacheStats {
+    size_t residentBytes = 0;
+    size_t surfaces = 0;
+    size_t decodedImages = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t decodes = 0;
+    uint64_t scales = 0;
+    uint64_t evictions = 0;
+    uint64_t failures = 0;
+};
+
+// Process-wide store of decoded backgrounds at the sizes windows actually
+// paint, so windows showing the same image share one copy and painting is a
+// plain blit. Decoding and scaling run on a worker; decoded originals are
+// kept too so a resize only rescales. Over the byte budget, originals are
+// evicted least recently used before any painted surface is.
+class BackgroundSurfaceCache {
+public:
+    using Surface = std::shared_ptr<const BackgroundPixels>;
+    using Decoder = std::function<std::optional<BackgroundPixels>(const std::wstring& imagePath)>;
+    // Receives the finished surface, or null if the image could not be
+    // decoded. Runs on the worker thread.
+    using ReadyCallback = std::function<void(const Surface& surface)>;
+
+    static constexpr size_t kDefaultBudgetBytes = 96u * 1024u * 1024u;
+
+    BackgroundSurfaceCache(Decoder decoder, PreviewWorkQueueOptions workerOptions = {},
+                           size_t budgetBytes = kDefaultBudgetBytes);
+    ~BackgroundSurfaceCache();
+
+    BackgroundSurfaceCache(const BackgroundSurfaceCache&) = delete;
+    BackgroundSurfaceCache& operator=(const BackgroundSurfaceCache&) = delete;
+
+    // Returns the surface when it is resident. Otherwise queues it, unless the
+    // image already failed to decode, and returns null; queued reports whether
+    // onReady will run. Concurrent requests for one key share the work.
+    Surface Acquire(const BackgroundSurfaceKey& key, ReadyCallback onReady = {}, bool* queued = nullptr);
+    Surface Find(const BackgroundSurfaceKey& key);
+    // Returns imagePath, or fallbackPath once imagePath has failed to decode,
+    // so a broken folder image shows the universal background instead.
+    std::wstring ResolveImagePath(const std::wstring& imagePath, const std::wstring& fallbackPath) const;
+
+    // Drops everything derived from imagePath, including a remembered decode
+    // failure. Work already running for it is discarded when it finishes.
+    void Invalidate(const std::wstring& imagePath);
+    void Clear();
+
+    void SetBudget(size_t budgetBytes);
+    BackgroundSurfaceCacheStats Stats() const;
+
+private:
+    struct Entry {
+        Surface pixels;
+        std::list<BackgroundSurfaceKey>::iterator lru;
+    };
+
+    // Decoded originals share the map with scaled surfaces under a key with
+    // no size.
+    static BackgroundSurfaceKey SourceKey(const std::wstring& imagePath);
+    static bool IsSourceKey(const BackgroundSurfaceKey& key) noexcept { return key.width == 0; }
+
+    std::list<BackgroundSurfaceKey>& LruFor(const BackgroundSurfaceKey& key) {
+        return IsSourceKey(key) ? m_sourceLru : m_surfaceLru;
+    }
+
+    void Build(const BackgroundSurfaceKey& key, uint64_t generation);
+    Surface FindLocked(const BackgroundSurfaceKey& key);
+    void InsertLocked(const BackgroundSurfaceKey& key, Surface pixels);
+    void EraseLocked(std::unordered_map<BackgroundSurfaceKey, Entry, BackgroundSurfaceKeyHasher>::iterator it);
+    void TrimLocked();
+
+    Decoder m_decoder;
+    size_t m_budgetBytes = 0;
+    mutable std::mutex m_mutex;
+    std::unordered_map<BackgroundSurfaceKey, Entry, BackgroundSurfaceKeyHasher> m_entries;
+    // Most recently used first.
+    std::list<BackgroundSurfaceKey> m_sourceLru;
+    std::list<BackgroundSurfaceKey> m_surfaceLru;
+    std::unordered_map<BackgroundSurfaceKey, std::vector<ReadyCallback>, BackgroundSurfaceKeyHasher> m_pending;
+    std::unordered_set<std::wstring> m_failedImages;
+    // Bumped by Invalidate and Clear so stale work does not repopulate.
+    uint64_t m_generation = 0;
+    BackgroundSurfaceCacheStats m_stats;
+    // Declared last so workers are joined before the state they touch goes away.
+    PreviewWorkQueue m_workQueue;
+};
+
+}  // namespace shelltabs
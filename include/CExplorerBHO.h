@@ -35,6 +35,7 @@
 #include "ExplorerGlowSurfaces.h"
 #include "EditGradientRenderer.h"
 #include "ExplorerThemeUtils.h"
+#include "FolderBackgroundIndex.h"
 #include "OptionsStore.h"
 #include "PaneHooks.h"
 #include "Utilities.h"
@@ -285,12 +286,11 @@ class ShellTabsListView;
                 void InvalidateNamespaceTreeControl() const;
                 bool HandleExplorerViewMessage(HWND source, UINT msg, WPARAM wParam, LPARAM lParam, LRESULT* result);
                 void HandleExplorerPostPaint(HWND hwnd, UINT msg, WPARAM wParam);
-                void ReloadFolderBackgrounds(const ShellTabsOptions& options);
+                void ReloadFolderBackgrounds(const ShellTabsOptions& options, uint64_t optionsGeneration);
                 void ClearFolderBackgrounds();
                 std::wstring NormalizeBackgroundKey(const std::wstring& path) const;
-                bool EnsureFolderBackgroundBitmap(const std::wstring& key) const;
-                bool EnsureUniversalBackgroundBitmap() const;
-                Gdiplus::Bitmap* ResolveCurrentFolderBackground() const;
+                std::wstring ResolveFolderBackgroundRuleKey(const std::wstring& folderKey) const;
+                std::wstring ResolveCurrentBackgroundImagePath() const;
                 void UpdateCurrentFolderBackground();
                 void InvalidateFolderBackgroundTargets() const;
                 std::wstring ResolveBackgroundCacheKey() const;
@@ -540,10 +540,11 @@ class ShellTabsListView;
                 };
                 bool m_folderBackgroundsEnabled = false;
                 std::unordered_map<std::wstring, FolderBackgroundEntryData> m_folderBackgroundEntries;
-                mutable std::unordered_map<std::wstring, std::unique_ptr<Gdiplus::Bitmap>> m_folderBackgroundBitmaps;
-                mutable std::wstring m_universalBackgroundImagePath;
-                mutable std::unique_ptr<Gdiplus::Bitmap> m_universalBackgroundBitmap;
-                mutable std::unordered_set<std::wstring> m_failedBackgroundKeys;
+                std::vector<std::wstring> m_folderBackgroundRuleKeys;
+                FolderBackgroundIndex m_folderBackgroundIndex;
+                mutable FolderBackgroundIndex::LookupMemo m_folderBackgroundLookupMemo;
+                uint64_t m_folderBackgroundOptionsGeneration = 0;
+                std::wstring m_universalBackgroundImagePath;
                 std::wstring m_currentFolderKey;
                 std::unique_ptr<ShellTabsListView> m_listViewControl;
                 bool m_hasActiveListViewAccent = false;
@@ -552,6 +553,8 @@ class ShellTabsListView;
                 HBRUSH m_listViewAccentBrush = nullptr;
                 COLORREF m_listViewAccentBrushColor = 0;
                 HBITMAP m_currentBackgroundBitmap = nullptr;
+                // List view with a background surface request in flight.
+                HWND m_backgroundSurfaceRequestView = nullptr;
                 HMENU m_trackedContextMenu = nullptr;
                 std::vector<std::wstring> m_pendingOpenInNewTabPaths;
                 std::vector<std::wstring> m_openInNewTabQueue;
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+namespace shelltabs {
+
+enum class CacheEvictionPolicy : uint8_t {
+    kLru = 0,
+    kClock,
+    // Simplified 2Q: first-time entries go through a short FIFO and only
+    // entries seen again (or recently evicted from the FIFO) reach the main
+    // LRU, so a one-off scan cannot flush the hot set.
+    kTwoQueue,
+};
+
+constexpr CacheEvictionPolicy kCacheEvictionPolicies[] = {
+    CacheEvictionPolicy::kLru,
+    CacheEvictionPolicy::kClock,
+    CacheEvictionPolicy::kTwoQueue,
+};
+
+const char* CacheEvictionPolicyName(CacheEvictionPolicy policy) noexcept;
+
+// Bookkeeping a policy threads through each cached entry. Entries derive from
+// this so ordering never allocates or duplicates the key.
+struct CachePolicyNode {
+    CachePolicyNode* prev = nullptr;
+    CachePolicyNode* next = nullptr;
+    uint64_t key = 0;
+    bool referenced = false;
+    uint8_t queue = 0;
+};
+
+// Circular doubly linked list over CachePolicyNode with a sentinel head.
+class CachePolicyList {
+public:
+    CachePolicyList() noexcept;
+    CachePolicyList(const CachePolicyList&) = delete;
+    CachePolicyList& operator=(const CachePolicyList&) = delete;
+
+    bool Empty() const noexcept { return m_size == 0; }
+    size_t Size() const noexcept { return m_size; }
+    CachePolicyNode* Front() const noexcept { return Empty() ? nullptr : m_head.next; }
+    CachePolicyNode* Back() const noexcept { return Empty() ? nullptr : m_head.prev; }
+    // Neighbours skipping the sentinel; null at the ends.
+    CachePolicyNode* Next(const CachePolicyNode* node) const noexcept;
+    CachePolicyNode* Prev(const CachePolicyNode* node) const noexcept;
+
+    void PushFront(CachePolicyNode* node) noexcept;
+    void PushBack(CachePolicyNode* node) noexcept;
+    // Links node ahead of position, or at the back when position is null.
+    void InsertBefore(CachePolicyNode* position, CachePolicyNode* node) noexcept;
+    void Remove(CachePolicyNode* node) noexcept;
+    void MoveToFront(CachePolicyNode* node) noexcept;
+
+private:
+    CachePolicyNode m_head;
+    size_t m_size = 0;
+};
+
+// Orders the entries of one cache. All calls are made with the owning cache's
+// lock held. SelectVictim only nominates a node; the cache then removes it
+// through OnRemove with evicted set.
+class CachePolicy {
+public:
+    using EvictablePredicate = bool (*)(const CachePolicyNode& node);
+
+    virtual ~CachePolicy() = default;
+
+    virtual void SetCapacity(size_t capacity) noexcept { (void)capacity; }
+    virtual void OnInsert(CachePolicyNode* node) = 0;
+    virtual void OnAccess(CachePolicyNode* node) noexcept = 0;
+    virtual void OnRemove(CachePolicyNode* node, bool evicted) = 0;
+    virtual CachePolicyNode* SelectVictim(EvictablePredicate evictable) noexcept = 0;
+};
+
+std::unique_ptr<CachePolicy> CreateCachePolicy(CacheEvictionPolicy policy, size_t capacity);
+
+uint64_t HashCacheKey(std::string_view bytes) noexcept;
+
+// Replays key accesses against a policy with a fixed capacity and no pinned
+// entries, for comparing policies on recorded traces. Optional per-access
+// sizes let the replay report resident bytes alongside the hit rate.
+class CachePolicySimulator {
+public:
+    CachePolicySimulator(CacheEvictionPolicy policy, size_t capacity);
+
+    // Returns true on a hit; a miss inserts the key, evicting as needed.
+    bool Access(uint64_t key, size_t bytes = 0);
+    void Invalidate(uint64_t key);
+
+    uint64_t Hits() const noexcept { return m_hits; }
+    uint64_t Misses() const noexcept { return m_misses; }
+    size_t Size() const noexcept { return m_entries.size(); }
+    size_t Bytes() const noexcept { return m_bytes; }
+    size_t PeakBytes() const noexcept { return m_peakBytes; }
+    double HitRate() const noexcept;
+
+private:
+    struct Node : CachePolicyNode {
+        size_t bytes = 0;
+    };
+
+    void Erase(Node* node, bool evicted);
+
+    std::unique_ptr<CachePolicy> m_policy;
+    std::unordered_map<uint64_t, std::unique_ptr<Node>> m_entries;
+    size_t m_capacity = 0;
+    size_t m_bytes = 0;
+    size_t m_peakBytes = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
+
+}  // namespace shelltabs
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace shelltabs {
+
+enum class CacheTraceSource : uint8_t {
+    kIcon = 0,
+    kPreview,
+    kListView,
+};
+
+enum class CacheTraceEvent : uint8_t {
+    kHit = 0,
+    kMiss,
+    // A miss was filled; sizeBytes is the cost of the new entry.
+    kInsert,
+    kEvict,
+    kInvalidate,
+};
+
+// One access event as written to disk, little-endian with no padding.
+struct CacheTraceRecord {
+    uint64_t keyHash = 0;
+    // Microseconds since the recorder started.
+    uint64_t timestampMicros = 0;
+    uint32_t sizeBytes = 0;
+    uint8_t source = 0;
+    uint8_t event = 0;
+    uint16_t reserved = 0;
+};
+static_assert(sizeof(CacheTraceRecord) == 24, "CacheTraceRecord is a fixed on-disk layout");
+
+struct CacheTraceFileHeader {
+    char magic[8] = {'S', 'T', 'T', 'R', 'A', 'C', 'E', '1'};
+    uint32_t version = 1;
+    uint32_t recordSize = sizeof(CacheTraceRecord);
+};
+static_assert(sizeof(CacheTraceFileHeader) == 16, "CacheTraceFileHeader is a fixed on-disk layout");
+
+const char* CacheTraceSourceName(CacheTraceSource source) noexcept;
+
+// Opt-in recorder of cache access events. Caches call Record unconditionally;
+// while no trace is running it costs one relaxed load. Records are buffered
+// and full batches are handed to a writer thread, so Record never touches the
+// file even when called under a cache's locks.
+class CacheTraceRecorder {
+public:
+    static constexpr size_t kFlushThreshold = 4096;
+
+    static CacheTraceRecorder& Instance();
+
+    CacheTraceRecorder() = default;
+    ~CacheTraceRecorder();
+    CacheTraceRecorder(const CacheTraceRecorder&) = delete;
+    CacheTraceRecorder& operator=(const CacheTraceRecorder&) = delete;
+
+    // Truncates path and starts recording. Returns false if a trace is
+    // already running or the file cannot be created.
+    bool Start(const std::filesystem::path& path);
+    // Flushes buffered records, stops the writer thread and closes the file.
+    void Stop();
+    // Writes every buffered record on the calling thread.
+    void Flush();
+
+    bool IsEnabled() const noexcept { return m_enabled.load(std::memory_order_relaxed); }
+
+    void Record(CacheTraceSource source, CacheTraceEvent event, uint64_t keyHash, size_t sizeBytes) noexcept;
+
+    uint64_t RecordedCount() const noexcept { return m_recorded.load(std::memory_order_relaxed); }
+    // Records lost to allocation or write failures.
+    uint64_t DroppedCount() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    void WriterMain();
+    // Caller holds m_fileMutex, which keeps batches in the order they filled.
+    void WriteQueuedLocked(bool includePending);
+    void WriteBatch(std::vector<CacheTraceRecord>& batch);
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<uint64_t> m_recorded{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::chrono::steady_clock::time_point m_start{};
+
+    // m_bufferMutex guards the pending records and the full batches waiting
+    // for the writer; m_fileMutex serializes writes so lookups only wait for a
+    // buffer swap, never for the disk. m_fileMutex is taken first.
+    std::mutex m_bufferMutex;
+    std::vector<CacheTraceRecord> m_pending;
+    std::deque<std::vector<CacheTraceRecord>> m_fullBatches;
+    std::condition_variable m_writerWake;
+    bool m_stopWriter = false;
+    std::mutex m_fileMutex;
+    std::ofstream m_file;
+    std::thread m_writer;
+};
+
+// Reads a trace written by CacheTraceRecorder. Returns false if the file is
+// missing or not a trace; a truncated final record is ignored.
+bool ReadCacheTrace(const std::filesystem::path& path, std::vector<CacheTraceRecord>* records);
+
+}  // namespace shelltabs
@@ -0,0 +1,20 @@
+#pragma once
+
+namespace shelltabs {
+
+// Wires the process-wide ConfigurationService to the ShellTabs data directory:
+// external edits of options.db and groups.db are reloaded once per process and
+// re-broadcast through the existing change messages with the document
+// generation in WPARAM. Safe to call repeatedly from any window thread.
+void EnsureConfigurationMonitorStarted();
+
+// Must not be called under the loader lock; the watcher and dispatcher threads
+// are joined.
+void StopConfigurationMonitor();
+
+// For DLL_PROCESS_DETACH, after which no configuration change is delivered.
+// The threads are left to the process instead of being joined, so a monitor
+// that DllCanUnloadNow never stopped does not block static destruction.
+void AbandonConfigurationMonitor();
+
+}  // namespace shelltabs
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace shelltabs {
+
+enum class ConfigurationDocument : uint8_t {
+    kOptions = 0,
+    kSavedGroups,
+};
+
+constexpr size_t kConfigurationDocumentCount = 2;
+
+// Reports file names that changed inside a watched directory. Implementations
+// may invoke the callback from any thread.
+class ConfigurationWatcher {
+public:
+    using ChangeCallback = std::function<void(std::wstring_view fileName)>;
+
+    virtual ~ConfigurationWatcher() = default;
+
+    virtual bool Start(const std::wstring& directory, ChangeCallback callback) = 0;
+    virtual void Stop() = 0;
+};
+
+// Process-wide owner of the shared configuration documents. External edits
+// reported by the watcher are debounced, reloaded once through the document's
+// loader and pushed to subscribers with a per-document generation, so windows
+// apply an update instead of each re-reading the file.
+class ConfigurationService {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Reloads the backing store and returns true when its contents changed.
+    using Loader = std::function<bool()>;
+    using Listener = std::function<void(ConfigurationDocument document, uint64_t generation)>;
+
+    static constexpr std::chrono::milliseconds kDefaultDebounce{250};
+
+    static ConfigurationService& Instance();
+
+    explicit ConfigurationService(std::chrono::milliseconds debounce = kDefaultDebounce);
+    // Never joins: a service still running here is abandoned, since static
+    // destruction may run under the loader lock.
+    ~ConfigurationService();
+
+    ConfigurationService(const ConfigurationService&) = delete;
+    ConfigurationService& operator=(const ConfigurationService&) = delete;
+
+    void RegisterDocument(ConfigurationDocument document, std::wstring fileName, Loader loader);
+    uint64_t Subscribe(Listener listener);
+    void Unsubscribe(uint64_t token);
+
+    // Starts the watcher. When runDispatcher is false the caller drives
+    // ProcessPendingChanges itself, which keeps tests deterministic.
+    bool Start(std::unique_ptr<ConfigurationWatcher> watcher, const std::wstring& directory,
+               bool runDispatcher = true);
+    // Joins the watcher and dispatcher threads.
+    void Stop();
+    // Stops delivering changes without waiting for the threads, for DllMain:
+    // the dispatcher is signalled and detached and the watcher is leaked
+    // rather than stopped, because both would need the loader lock to exit.
+    void Abandon();
+    bool IsRunning() const;
+
+    void NotifyFileChanged(std::wstring_view fileName, Clock::time_point now);
+    // Reloads every document whose debounce window has elapsed and returns the
+    // next pending deadline, if any.
+    std::optional<Clock::time_point> ProcessPendingChanges(Clock::time_point now);
+
+    // Announces an in-process save so subscribers update without waiting for
+    // the watcher. The watcher's echo of the same write reloads to an
+    // unchanged store and is not re-published.
+    uint64_t Publish(ConfigurationDocument document);
+    uint64_t Generation(ConfigurationDocument document) const;
+
+private:
+    struct DocumentState {
+        std::wstring fileName;
+        Loader loader;
+        uint64_t generation = 0;
+        std::optional<Clock::time_point> deadline;
+    };
+
+    void DispatcherMain();
+    void NotifyListeners(ConfigurationDocument document, uint64_t generation);
+    std::optional<Clock::time_point> NextDeadlineLocked() const;
+
+    const std::chrono::milliseconds m_debounce;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::array<DocumentState, kConfigurationDocumentCount> m_documents{};
+    std::vector<std::pair<uint64_t, Listener>> m_listeners;
+    uint64_t m_nextListenerToken = 1;
+    bool m_running = false;
+    bool m_stopRequested = false;
+
+    // Serializes loaders so a document is never reloaded concurrently.
+    std::mutex m_reloadMutex;
+
+    std::unique_ptr<ConfigurationWatcher> m_watcher;
+    std::thread m_dispatcher;
+};
+
+}  // namespace shelltabs
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace shelltabs {
+
+struct ContentDigest {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    friend bool operator==(const ContentDigest& left, const ContentDigest& right) noexcept {
+        return left.low == right.low && left.high == right.high;
+    }
+    friend bool operator!=(const ContentDigest& left, const ContentDigest& right) noexcept {
+        return !(left == right);
+    }
+};
+
+struct ContentDigestHasher {
+    size_t operator()(const ContentDigest& digest) const noexcept {
+        return static_cast<size_t>(digest.low ^ (digest.high * 0x9E3779B97F4A7C15ull));
+    }
+};
+
+enum class ContentHashPath : uint8_t {
+    // The fastest path this CPU supports.
+    kAuto,
+    kScalar,
+    kSse2,
+    kAvx2,
+};
+
+// Streaming 128-bit content hash for deduplicating files. Input is consumed
+// in 64-byte stripes folded into eight 64-bit lanes, so the vector paths
+// process whole stripes per instruction; every path and every way of
+// splitting the input into Update calls yields the same digest. Not
+// cryptographic: it guards against accidental collisions only.
+class ContentHasher {
+public:
+    explicit ContentHasher(ContentHashPath path = ContentHashPath::kAuto) noexcept;
+
+    void Update(const void* data, size_t size) noexcept;
+    // Digest of everything passed to Update so far; hashing may continue.
+    ContentDigest Finish() const noexcept;
+
+    uint64_t BytesHashed() const noexcept { return m_total; }
+
+    static constexpr size_t kStripeBytes = 64;
+    static constexpr size_t kStripesPerBlock = 16;
+    static constexpr size_t kBlockBytes = kStripeBytes * kStripesPerBlock;
+
+private:
+    alignas(32) uint64_t m_lanes[8];
+    uint8_t m_buffer[kBlockBytes];
+    size_t m_buffered = 0;
+    uint64_t m_total = 0;
+    ContentHashPath m_path = ContentHashPath::kScalar;
+};
+
+ContentDigest HashContent(const void* data, size_t size, ContentHashPath path = ContentHashPath::kAuto) noexcept;
+
+bool IsContentHashPathSupported(ContentHashPath path) noexcept;
+
+// 32 lowercase hex digits, high half first.
+std::wstring FormatContentDigest(const ContentDigest& digest);
+std::optional<ContentDigest> ParseContentDigest(std::wstring_view text);
+
+}  // namespace shelltabs
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace shelltabs {
+
+// Half-open pixel rectangle: [left, right) x [top, bottom).
+struct DirtyRect {
+    int32_t left = 0;
+    int32_t top = 0;
+    int32_t right = 0;
+    int32_t bottom = 0;
+
+    bool Empty() const noexcept { return right <= left || bottom <= top; }
+    int64_t Area() const noexcept {
+        return Empty() ? 0 : static_cast<int64_t>(right - left) * static_cast<int64_t>(bottom - top);
+    }
+
+    friend bool operator==(const DirtyRect& first, const DirtyRect& second) noexcept {
+        return first.left == second.left && first.top == second.top && first.right == second.right &&
+               first.bottom == second.bottom;
+    }
+};
+
+// The parts of a surface that need repainting, kept as at most maxRects
+// disjoint rectangles. Added rectangles are split around what is already
+// covered and neighbours that form a rectangle are joined. Past the limit,
+// the pair whose bounding box adds the fewest pixels is replaced by that box,
+// which absorbs anything it overlaps. Every added pixel stays covered;
+// merging may cover some clean ones too.
+class DirtyRegion {
+public:
+    static constexpr size_t kDefaultMaxRects = 4;
+
+    explicit DirtyRegion(size_t maxRects = kDefaultMaxRects);
+
+    void Add(const DirtyRect& rect);
+    void Add(const DirtyRegion& region);
+    // Drops everything outside bounds.
+    void Clip(const DirtyRect& bounds);
+    void Clear() noexcept { m_rects.clear(); }
+
+    bool Empty() const noexcept { return m_rects.empty(); }
+    // Pixels covered; each counted once.
+    int64_t Area() const noexcept;
+    DirtyRect Bounds() const noexcept;
+    const std::vector<DirtyRect>& Rects() const noexcept { return m_rects; }
+
+private:
+    void Insert(const DirtyRect& rect);
+    void JoinNeighbours();
+    void MergeCheapestPair();
+
+    size_t m_maxRects = kDefaultMaxRects;
+    std::vector<DirtyRect> m_rects;
+};
+
+}  // namespace shelltabs
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace shelltabs {
+
+// Case-insensitive trie over path components used to resolve the most specific
+// folder background rule for a folder. Lookups walk at most one node per path
+// component and never allocate.
+class FolderBackgroundIndex {
+public:
+    struct Match {
+        uint32_t ruleIndex = 0;
+        bool exact = false;
+    };
+
+    // Small per-window memo of recent lookups. Entries are tied to the index
+    // generation so a rebuild implicitly invalidates them.
+    class LookupMemo {
+    public:
+        static constexpr size_t kCapacity = 4;
+
+        void Clear() noexcept;
+
+    private:
+        friend class FolderBackgroundIndex;
+
+        struct Slot {
+            uint64_t generation = 0;
+            std::wstring path;
+            std::optional<Match> match;
+        };
+
+        std::array<Slot, kCapacity> m_slots{};
+        size_t m_nextSlot = 0;
+    };
+
+    void Clear();
+    bool Insert(std::wstring_view path, uint32_t ruleIndex, bool inheritToSubfolders);
+    std::optional<Match> FindMostSpecific(std::wstring_view path) const;
+    std::optional<Match> Resolve(std::wstring_view path, LookupMemo* memo) const;
+
+    uint64_t Generation() const noexcept { return m_generation; }
+    size_t RuleCount() const noexcept { return m_ruleCount; }
+    size_t NodeCount() const noexcept { return m_nodes.size(); }
+
+    // Replaces the edge key derivation so tests can force probe collisions.
+    using EdgeKeyFunction = uint64_t (*)(uint32_t parent, uint64_t componentHash);
+    void SetEdgeKeyForTest(EdgeKeyFunction edgeKey) noexcept { m_edgeKeyForTest = edgeKey; }
+
+private:
+    static constexpr uint32_t kNoRule = UINT32_MAX;
+    static constexpr uint32_t kNoNode = UINT32_MAX;
+    static constexpr uint32_t kRootNode = 0;
+
+    struct Node {
+        // Edges of different parents share the probe sequence, so a probe
+        // must match the parent as well as the component.
+        uint32_t parent = kNoNode;
+        std::wstring component;
+        uint32_t rule = kNoRule;
+        bool inherit = false;
+    };
+
+    uint64_t EdgeKey(uint32_t parent, uint64_t componentHash) const noexcept;
+    uint32_t FindChild(uint32_t parent, std::wstring_view component, uint64_t componentHash) const;
+    uint32_t FindOrAddChild(uint32_t parent, std::wstring_view component, uint64_t componentHash);
+
+    std::vector<Node> m_nodes;
+    std::unordered_map<uint64_t, uint32_t> m_edges;
+    size_t m_ruleCount = 0;
+    uint64_t m_generation = 1;
+    EdgeKeyFunction m_edgeKeyForTest = nullptr;
+};
+
+}  // namespace shelltabs
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace shelltabs {
+
+// Estimated cost of a cached GDI resource.
+struct GdiResourceCost {
+    size_t bytes = 0;
+    size_t handles = 0;
+};
+
+// Cost of a 32bpp bitmap of the given size, plus a 1bpp mask for icons. An
+// unknown size still counts its handles.
+GdiResourceCost EstimateBitmapCost(long width, long height, bool withMask) noexcept;
+
+struct GdiBudgetLimits {
+    size_t maxBytes = 48u * 1024u * 1024u;
+    size_t maxHandles = 2048;
+    // Never squeeze the caches below this many handles, however busy the
+    // rest of the process is.
+    size_t minHandles = 64;
+    // Windows' default GDIProcessHandleQuota.
+    size_t processHandleQuota = 10000;
+    // Share of the quota the whole process should stay under; the caches get
+    // whatever the rest of the process leaves of it.
+    double softLimitFraction = 0.7;
+    // How often Relieve re-reads the process handle count.
+    std::chrono::milliseconds sampleInterval{250};
+};
+
+struct GdiBudgetCounters {
+    size_t bytes = 0;
+    size_t handles = 0;
+    size_t byteLimit = 0;
+    size_t handleLimit = 0;
+    size_t processHandles = 0;
+    uint64_t pressureEvents = 0;
+    uint64_t shedEntries = 0;
+    uint64_t shedBytes = 0;
+    uint64_t shedHandles = 0;
+};
+
+struct GdiBudgetShedResult {
+    size_t entries = 0;
+    GdiResourceCost freed;
+};
+
+struct GdiBudgetPressure {
+    GdiResourceCost requested;
+    GdiBudgetShedResult shed;
+    size_t processHandles = 0;
+    size_t handleLimit = 0;
+};
+
+// Process-wide byte and GDI handle budget shared by the icon and preview
+// caches. Caches charge the estimated cost of each entry they hold and call
+// Relieve after dropping their own locks; when usage exceeds the limit, the
+// budget asks clients to shed cold entries, largest consumer first. The
+// handle limit shrinks as the rest of the process consumes handles, so the
+// caches back off before Explorer hits the GDI quota.
+class GdiResourceBudget {
+public:
+    // Frees unpinned entries until roughly `excess` has been released and
+    // reports what was freed. Called without any budget lock held; the
+    // client credits the freed cost as it drops entries.
+    using Shedder = std::function<GdiBudgetShedResult(const GdiResourceCost& excess)>;
+    using PressureListener = std::function<void(const GdiBudgetPressure& pressure)>;
+    using HandleCountProvider = std::function<size_t()>;
+
+    // Caches keep the handle RegisterClient returns and charge through it,
+    // so charges and credits touch only atomics and never the budget lock.
+    struct Client;
+    using ClientHandle = std::shared_ptr<Client>;
+
+    static GdiResourceBudget& Instance();
+
+    GdiResourceBudget();
+    GdiResourceBudget(const GdiResourceBudget&) = delete;
+    GdiResourceBudget& operator=(const GdiResourceBudget&) = delete;
+
+    ClientHandle RegisterClient(std::wstring name, Shedder shedder);
+    // Later charges and credits through the handle are ignored.
+    void UnregisterClient(const ClientHandle& client);
+
+    void Charge(const ClientHandle& client, const GdiResourceCost& cost) noexcept;
+    void Credit(const ClientHandle& client, const GdiResourceCost& cost) noexcept;
+    GdiResourceCost ClientUsage(const ClientHandle& client) const;
+
+    // Sheds cold entries if usage exceeds the current limits. Returns true
+    // when shedding ran. Concurrent callers return immediately while another
+    // thread is shedding.
+    bool Relieve();
+
+    uint64_t SubscribePressure(PressureListener listener);
+    void UnsubscribePressure(uint64_t token);
+
+    void SetLimits(const GdiBudgetLimits& limits);
+    GdiBudgetLimits Limits() const;
+    // Defaults to the process GDI object count on Windows.
+    void SetHandleCountProvider(HandleCountProvider provider);
+    GdiBudgetCounters Counters() const;
+
+private:
+    size_t SampleProcessHandles(std::chrono::steady_clock::time_point now);
+    size_t HandleLimitLocked(size_t processHandles) const noexcept;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<Client>> m_clients;
+    std::vector<std::pair<uint64_t, PressureListener>> m_listeners;
+    GdiBudgetLimits m_limits;
+    HandleCountProvider m_handleCountProvider;
+    std::chrono::steady_clock::time_point m_lastSample{};
+    size_t m_processHandles = 0;
+    size_t m_handleLimit = 0;
+    uint64_t m_nextToken = 1;
+
+    std::atomic<size_t> m_bytes{0};
+    std::atomic<size_t> m_handles{0};
+    std::atomic<bool> m_shedding{false};
+    std::atomic<uint64_t> m_pressureEvents{0};
+    std::atomic<uint64_t> m_shedEntries{0};
+    std::atomic<uint64_t> m_shedBytes{0};
+    std::atomic<uint64_t> m_shedHandles{0};
+};
+
+}  // namespace shelltabs
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "DirtyRegion.h"
+#include "GradientSpanCache.h"
+
+namespace shelltabs {
+
+// A vertical gradient as painted into a surface of width x height pixels.
+// Empty (zero size) when the surface holds nothing usable.
+struct VerticalGradientState {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    GradientColor start;
+    GradientColor end;
+
+    bool Empty() const noexcept { return width == 0 || height == 0; }
+};
+
+// The pixels that differ between a surface painted as previous and the same
+// surface painted as next, assuming the pixels both share are kept. Each row
+// depends only on the colors and the height: new colors, or a new height when
+// the colors differ, repaint everything, while any other resize repaints only
+// the newly exposed strips.
+DirtyRegion VerticalGradientDamage(const VerticalGradientState& previous, const VerticalGradientState& next);
+
+// Paints the parts of region inside the gradient (pixels and stride as for
+// FillGradient) with ramps from cache. Returns false for invalid arguments.
+bool RepaintVerticalGradient(uint32_t* pixels, size_t stride, const VerticalGradientState& state,
+                             const DirtyRegion& region, GradientSpanCache& cache);
+
+}  // namespace shelltabs
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace shelltabs {
+
+enum class GradientDirection : uint8_t {
+    // Start color on the top row, end color on the bottom row.
+    kVertical,
+    // Start color in the left column, end color in the right column.
+    kHorizontal,
+    // Start color in the top-left corner, end color in the bottom-right one;
+    // constant along each anti-diagonal.
+    kDiagonal,
+};
+
+enum class GradientFillPath : uint8_t {
+    // The fastest path this CPU supports.
+    kAuto,
+    kScalar,
+    kSse2,
+    kAvx2,
+};
+
+// Straight (not premultiplied) color.
+struct GradientColor {
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t a = 0xFF;
+};
+
+struct GradientSpec {
+    GradientColor start;
+    GradientColor end;
+    GradientDirection direction = GradientDirection::kVertical;
+};
+
+// Fills width * height premultiplied BGRA pixels, top-down; stride is in
+// pixels and padding past width is left alone. Each channel, alpha included,
+// interpolates linearly from start to end along the direction and rounds half
+// up, except that exact halves round as the original double-precision fill
+// did, so vertical opaque gradients stay bit-identical to it. Every path
+// produces identical output. Returns false for empty images, or when the
+// requested path is not available on this CPU.
+bool FillGradient(uint32_t* pixels, uint32_t width, uint32_t height, size_t stride, const GradientSpec& spec,
+                  GradientFillPath path = GradientFillPath::kAuto);
+
+// FillGradient in two steps, for callers that keep ramps around. Every
+// direction interpolates along a ramp of premultiplied pixels: one per row for
+// vertical gradients, one per column for horizontal ones, and one per
+// anti-diagonal for diagonal ones. A ramp depends only on the two colors and
+// its length, so one ramp serves every direction and size that needs that
+// length.
+uint32_t GradientRampLength(GradientDirection direction, uint32_t width, uint32_t height) noexcept;
+void BuildGradientRamp(const GradientColor& start, const GradientColor& end, uint32_t length, uint32_t* ramp);
+// ramp must hold GradientRampLength(direction, width, height) pixels.
+bool FillGradientFromRamp(uint32_t* pixels, uint32_t width, uint32_t height, size_t stride,
+                          GradientDirection direction, const uint32_t* ramp,
+                          GradientFillPath path = GradientFillPath::kAuto);
+
+bool IsGradientFillPathSupported(GradientFillPath path) noexcept;
+
+}  // namespace shelltabs
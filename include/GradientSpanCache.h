@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "GradientFill.h"
+
+namespace shelltabs {
+
+struct GradientSpanKey {
+    GradientColor start;
+    GradientColor end;
+    uint32_t length = 0;
+
+    friend bool operator==(const GradientSpanKey& left, const GradientSpanKey& right) noexcept {
+        return left.length == right.length && left.start.r == right.start.r && left.start.g == right.start.g &&
+               left.start.b == right.start.b && left.start.a == right.start.a && left.end.r == right.end.r &&
+               left.end.g == right.end.g && left.end.b == right.end.b && left.end.a == right.end.a;
+    }
+};
+
+struct GradientSpanKeyHasher {
+    size_t operator()(const GradientSpanKey& key) const noexcept;
+};
+
+struct GradientSpanCacheStats {
+    size_t residentBytes = 0;
+    size_t spans = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+// Gradient ramps (see BuildGradientRamp) shared by every surface that paints
+// the same colors. Explorer windows use a handful of color sets, so after the
+// first paint at a size, filling a gradient is only the row stores. Least
+// recently used ramps go first once the byte budget is exceeded; a ramp
+// larger than the budget is built for the caller but not kept. Thread safe.
+class GradientSpanCache {
+public:
+    using Span = std::shared_ptr<const std::vector<uint32_t>>;
+
+    static constexpr size_t kDefaultBudgetBytes = 2u * 1024u * 1024u;
+
+    explicit GradientSpanCache(size_t budgetBytes = kDefaultBudgetBytes);
+
+    GradientSpanCache(const GradientSpanCache&) = delete;
+    GradientSpanCache& operator=(const GradientSpanCache&) = delete;
+
+    // Returns the ramp of length pixels from start to end, building it on a
+    // miss. Null for length 0.
+    Span Acquire(const GradientColor& start, const GradientColor& end, uint32_t length);
+
+    // FillGradient through the cache; same output and arguments.
+    bool Fill(uint32_t* pixels, uint32_t width, uint32_t height, size_t stride, const GradientSpec& spec,
+              GradientFillPath path = GradientFillPath::kAuto);
+
+    void Clear();
+    void SetBudget(size_t budgetBytes);
+    GradientSpanCacheStats Stats() const;
+
+private:
+    struct Entry {
+        Span pixels;
+        std::list<GradientSpanKey>::iterator lru;
+    };
+
+    void TrimLocked();
+
+    size_t m_budgetBytes = 0;
+    mutable std::mutex m_mutex;
+    std::unordered_map<GradientSpanKey, Entry, GradientSpanKeyHasher> m_entries;
+    // Most recently used first.
+    std::list<GradientSpanKey> m_lru;
+    GradientSpanCacheStats m_stats;
+};
+
+// The cache shared by every hooked surface in the process.
+GradientSpanCache& GetGradientSpanCache();
+
+}  // namespace shelltabs
@@ -3,6 +3,10 @@
 #include <windows.h>
 
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -22,11 +26,16 @@ class GroupStore {
 public:
     static GroupStore& Instance();
 
-    const std::vector<SavedGroup>& Groups() const noexcept { return m_groups; }
+    // The configuration monitor reloads on its own thread, so readers get an
+    // immutable snapshot or a copy rather than references into the store.
+    std::shared_ptr<const std::vector<SavedGroup>> Groups() const;
     std::vector<std::wstring> GroupNames() const;
-    const SavedGroup* Find(const std::wstring& name) const;
+    std::optional<SavedGroup> Find(const std::wstring& name) const;
 
     bool Load(std::wstring* errorContext = nullptr);
+    // Re-reads the file even when already loaded; bumps ChangeGeneration when
+    // the saved groups differ from the previous contents.
+    bool Reload(std::wstring* errorContext = nullptr);
     bool Save() const;
 
     bool Upsert(SavedGroup group);
@@ -36,21 +45,33 @@ public:
 
     void RecordChanges(const std::vector<std::pair<std::wstring, std::wstring>>& renamedGroups,
                        const std::vector<std::wstring>& removedGroupIds);
-    uint64_t ChangeGeneration() const noexcept { return m_changeGeneration; }
-    const std::vector<std::pair<std::wstring, std::wstring>>& LastRenamedGroups() const noexcept {
-        return m_lastRenamedGroups;
-    }
-    const std::vector<std::wstring>& LastRemovedGroups() const noexcept { return m_lastRemovedGroups; }
+    uint64_t ChangeGeneration() const;
+    std::vector<std::pair<std::wstring, std::wstring>> LastRenamedGroups() const;
+    std::vector<std::wstring> LastRemovedGroups() const;
 
 private:
+    using GroupList = std::vector<SavedGroup>;
+
     GroupStore() = default;
 
     std::wstring ResolveStoragePath() const;
     bool EnsureLoaded(std::wstring* errorContext = nullptr) const;
+    // Reads the file and publishes it; a failed read keeps the published
+    // groups. The caller holds m_writeMutex.
+    bool ReadLocked(std::wstring* errorContext);
+    // The caller holds m_writeMutex.
+    bool WriteLocked(const GroupList& groups) const;
+    // Applies edit to a copy of the groups, publishes and saves the copy.
+    // edit returns false when there is nothing to change.
+    bool Update(const std::function<bool(GroupList& groups)>& edit);
 
-    mutable bool m_loaded = false;
+    // m_writeMutex serializes reads, edits and writes of the file end to end;
+    // m_mutex guards the published state and is only held to swap or copy it.
+    mutable std::mutex m_writeMutex;
+    mutable std::mutex m_mutex;
+    bool m_loaded = false;
     mutable std::wstring m_storagePath;
-    std::vector<SavedGroup> m_groups;
+    std::shared_ptr<const GroupList> m_groups = std::make_shared<const GroupList>();
     uint64_t m_changeGeneration = 0;
     std::vector<std::pair<std::wstring, std::wstring>> m_lastRenamedGroups;
     std::vector<std::wstring> m_lastRemovedGroups;
@@ -2,9 +2,15 @@
 
 #include <windows.h>
 
+#include "CachePolicy.h"
+#include "GdiResourceBudget.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
-#include <list>
-#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
@@ -21,7 +27,6 @@ std::wstring BuildIconCacheFamilyKey(PCIDLIST_ABSOLUTE pidl, const std::wstring&
 class IconCache {
 private:
     struct Entry;
-    using FamilyIndex = std::multimap<std::wstring, Entry*>;
 
 public:
     class Reference {
@@ -51,6 +56,24 @@ public:
         HICON m_icon = nullptr;
     };
 
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        // Requests that waited for another thread's in-flight load instead of
+        // invoking their own loader.
+        uint64_t coalesced = 0;
+        // Requests answered from the negative cache without calling the loader.
+        uint64_t negativeHits = 0;
+        // Requests whose 64-bit variant key belonged to a different family and
+        // were served uncached.
+        uint64_t collisions = 0;
+        uint64_t evictions = 0;
+        size_t size = 0;
+        size_t largestShard = 0;
+    };
+
+    static constexpr std::chrono::milliseconds kDefaultNegativeTtl{2000};
+
     static IconCache& Instance();
 
     Reference Acquire(const std::wstring& familyKey, UINT iconFlags, const std::function<HICON()>& loader);
@@ -58,54 +81,100 @@ public:
     void InvalidatePidl(PCIDLIST_ABSOLUTE pidl);
     void InvalidatePath(const std::wstring& path);
     void LogStatsNow();
+    Stats GetStats();
+    void SetEvictionPolicy(CacheEvictionPolicy policy);
 #if defined(SHELLTABS_BUILD_TESTS)
     void DebugSetCapacity(size_t capacity);
+    void DebugSetNegativeTtl(std::chrono::milliseconds ttl);
     size_t DebugGetLastFamilyInvalidationCount();
     void DebugResetLastFamilyInvalidationCount();
 #endif
 
+    // Entries are spread over independently locked shards chosen by a hash of
+    // the family key, so every variant of a family lives in one shard and
+    // unrelated lookups from different threads rarely contend.
+    static constexpr size_t kShardCount = 16;
+
 private:
-    IconCache() = default;
+    // Upper bound only; the shared GDI budget usually sheds well before it.
+    static constexpr size_t kDefaultCapacity = 512;
 
-    struct Entry {
-        std::wstring key;
+    IconCache();
+
+    // Keyed by a 64-bit hash of family and variant; family and large are kept
+    // to reject hash collisions.
+    struct Entry : CachePolicyNode {
         std::wstring family;
+        bool large = false;
         HICON icon = nullptr;
         SIZE metrics{0, 0};
-        size_t refCount = 0;
-        std::list<std::wstring>::iterator lruIt;
-        FamilyIndex::iterator familyIt{};
-        bool stale = false;
+        // Only Acquire raises the count from zero, and it does so under the
+        // shard lock; copies of a live Reference bump it without locking.
+        std::atomic<size_t> refCount{0};
+        size_t shard = 0;
+        GdiResourceCost cost;
         bool hasMetrics = false;
     };
 
-    struct StatsSnapshot {
+    struct InFlightLoad {
+        bool done = false;
+    };
+
+    struct NegativeEntry {
+        std::wstring family;
+        bool large = false;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        // Variant keys are derived from the family hash, so the entries of a
+        // family are found by probing its variants; no separate index is kept.
+        std::unordered_map<uint64_t, std::unique_ptr<Entry>> entries;
+        std::unique_ptr<CachePolicy> policy;
+        // Invalidated entries that were still referenced; destroyed by the
+        // last Release.
+        std::unordered_map<Entry*, std::unique_ptr<Entry>> stale;
+        // Variant keys whose loader is running; later misses wait on
+        // loadFinished instead of loading the same icon again.
+        std::unordered_map<uint64_t, std::shared_ptr<InFlightLoad>> inFlight;
+        std::condition_variable loadFinished;
+        // Variant keys whose loader returned null.
+        std::unordered_map<uint64_t, NegativeEntry> negative;
+        size_t capacity = kDefaultCapacity / kShardCount;
         uint64_t hits = 0;
         uint64_t misses = 0;
+        uint64_t coalesced = 0;
+        uint64_t negativeHits = 0;
+        uint64_t collisions = 0;
         uint64_t evictions = 0;
-        size_t size = 0;
     };
 
     Reference MakeUncachedReference(HICON icon);
-    void AddRef(Entry* entry);
-    void Release(Entry* entry);
-    static std::wstring BuildVariantKey(const std::wstring& familyKey, UINT iconFlags);
-    void Touch(Entry* entry);
-    std::optional<StatsSnapshot> LogStatsIfNeededLocked();
-    void TrimLocked(std::vector<HICON>* destroyList);
-
-    std::unordered_map<std::wstring, std::unique_ptr<Entry>> m_entries;
-    FamilyIndex m_familyIndex;
-    std::list<std::wstring> m_lru;
-    std::mutex m_mutex;
-    size_t m_capacity = 128;
-    uint64_t m_hits = 0;
-    uint64_t m_misses = 0;
-    uint64_t m_evictions = 0;
-    uint64_t m_requestsSinceLog = 0;
-    uint64_t m_nextToken = 1;
+    void AddRef(Entry* entry) noexcept;
+    void Release(Entry* entry) noexcept;
+    static uint64_t HashFamily(const std::wstring& familyKey) noexcept;
+    static uint64_t VariantKey(uint64_t familyHash, bool large) noexcept;
+    static size_t ShardIndex(uint64_t familyHash) noexcept;
+    static size_t ShardCapacity(size_t capacity) noexcept;
+    static bool IsEvictable(const CachePolicyNode& node);
+    void EraseLocked(Shard& shard, Entry* entry, bool evicted, std::vector<HICON>* destroyList);
+    void TrimLocked(Shard& shard, std::vector<HICON>* destroyList);
+    GdiBudgetShedResult ShedColdEntries(const GdiResourceCost& excess);
+    static void FinishLoadLocked(Shard& shard, uint64_t variantKey);
+    static bool IsNegativeLocked(Shard& shard, uint64_t variantKey, const std::wstring& familyKey, bool large,
+                                 std::chrono::steady_clock::time_point now);
+    void RememberNegativeLocked(Shard& shard, uint64_t variantKey, const std::wstring& familyKey, bool large,
+                                std::chrono::steady_clock::time_point now);
+    std::optional<Stats> CountRequest();
+    static void LogStats(const Stats& stats);
+
+    std::array<Shard, kShardCount> m_shards{};
+    GdiResourceBudget::ClientHandle m_budgetClient;
+    std::atomic<uint64_t> m_requestsSinceLog{0};
+    std::atomic<int64_t> m_negativeTtlMs{kDefaultNegativeTtl.count()};
 #if defined(SHELLTABS_BUILD_TESTS)
-    size_t m_debugLastFamilyInvalidationCount = 0;
+    std::atomic<size_t> m_debugLastFamilyInvalidationCount{0};
 #endif
 };
 
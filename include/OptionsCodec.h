@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "OptionsStore.h"
+
+namespace shelltabs {
+
+// Reads and writes the options.db document. Both directions are driven by one
+// field table: parsing dispatches keys through a compile-time perfect hash and
+// works directly over the UTF-8 file bytes, while serialization emits UTF-8
+// into a single buffer sized up front.
+ShellTabsOptions ParseOptionsDocument(std::string_view utf8, const std::wstring& storageDirectory);
+std::string SerializeOptionsDocument(const ShellTabsOptions& options, const std::wstring& storageDirectory);
+
+}  // namespace shelltabs
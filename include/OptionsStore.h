@@ -4,6 +4,9 @@
 
 #include "IconCache.h"
 
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -99,6 +102,7 @@ IconCache::Reference ResolveContextMenuIcon(const std::wstring& iconSource, UINT
 std::wstring NormalizeContextMenuIconSource(const std::wstring& iconSource);
 std::vector<std::wstring> NormalizeContextMenuPatterns(const std::vector<std::wstring>& patterns);
 std::wstring NormalizeContextMenuExtensions(const std::vector<std::wstring>& extensions); // Legacy support
+void NormalizeContextMenuItems(std::vector<ContextMenuItem>* items);
 bool MatchesContextMenuPattern(const std::wstring& filename, const std::wstring& pattern);
 bool ContextMenuItemMatchesSelection(const ContextMenuItem& item, int selectionCount,
                                      const std::vector<std::wstring>& selectedPaths,
@@ -116,6 +120,7 @@ struct CachedImageMetadata {
 struct FolderBackgroundEntry {
     std::wstring folderPath;
     CachedImageMetadata image;
+    bool applyToSubfolders = false;
 };
 
 enum class TabBandDockMode {
@@ -209,19 +214,32 @@ public:
 
     bool Load(std::wstring* errorContext = nullptr);
     bool Save() const;
+    // Loads the file only if nothing has been loaded yet in this process.
+    bool EnsureLoaded(std::wstring* errorContext = nullptr) const;
 
-    const ShellTabsOptions& Get() const noexcept { return m_options; }
-    void Set(const ShellTabsOptions& options) { m_options = options; m_loaded = true; }
+    // The configuration monitor reloads on its own thread, so readers get an
+    // immutable snapshot that stays valid for as long as they hold it.
+    std::shared_ptr<const ShellTabsOptions> Get() const;
+    void Set(const ShellTabsOptions& options);
+    uint64_t ChangeGeneration() const;
 
 private:
     OptionsStore() = default;
 
-    bool EnsureLoaded(std::wstring* errorContext = nullptr) const;
     std::wstring ResolveStoragePath() const;
-
-    mutable bool m_loaded = false;
+    // Swaps in the options and bumps ChangeGeneration when they differ from
+    // the published ones. The caller holds m_mutex.
+    void PublishLocked(std::shared_ptr<const ShellTabsOptions> options);
+
+    // m_writeMutex serializes Load, Set and Save end to end so an older read
+    // never overwrites a newer write; m_mutex guards the published state and
+    // is only held to swap or copy it.
+    mutable std::mutex m_writeMutex;
+    mutable std::mutex m_mutex;
+    bool m_loaded = false;
     mutable std::wstring m_storagePath;
-    mutable ShellTabsOptions m_options;
+    mutable std::shared_ptr<const ShellTabsOptions> m_options = std::make_shared<const ShellTabsOptions>();
+    uint64_t m_changeGeneration = 0;
 };
 
 bool operator==(const ShellTabsOptions& left, const ShellTabsOptions& right) noexcept;
@@ -1,16 +1,13 @@
 #pragma once
 
 #include <atomic>
-#include <condition_variable>
 #include <deque>
 #include <cstdint>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
 #include <string_view>
-#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -27,6 +24,12 @@
 
 #include <shlobj.h>
 
+#include "GdiResourceBudget.h"
+#include "PreviewDiskStore.h"
+#include "PreviewKey.h"
+#include "PreviewTierCache.h"
+#include "PreviewWorkQueue.h"
+
 namespace shelltabs {
 
 struct PreviewImage {
@@ -37,14 +40,28 @@ struct PreviewImage {
 inline constexpr SIZE kPreviewImageSize{192, 128};
 
 // Provides cached previews for PIDLs captured from Explorer folder views.
+// Previews are generated by a small worker pool that serves hover requests
+// ahead of prefetches and background captures, and kept in two tiers: a few
+// ready-to-draw bitmaps and many compressed pixel buffers. Generated previews
+// are also written to an on-disk store so they survive Explorer restarts.
 class PreviewCache {
 public:
+    static constexpr size_t kWorkerCount = 2;
+
     static PreviewCache& Instance();
 
     std::optional<PreviewImage> GetPreview(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize);
+    // True if the item has a preview in the hot or cold tier. Never touches
+    // the file system, so it is cheap enough for pointer moves; previews that
+    // are only on disk are restored by the worker serving a request.
+    bool HasPreviewInMemory(PCIDLIST_ABSOLUTE pidl);
     void StorePreviewFromWindow(PCIDLIST_ABSOLUTE pidl, HWND window, const SIZE& desiredSize,
-                                std::wstring_view ownerToken = {});
-    uint64_t RequestPreviewAsync(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize, HWND notifyHwnd, UINT message);
+                                std::wstring_view ownerToken = {},
+                                PreviewPriority priority = PreviewPriority::kBackground);
+    // Joins a pending request for the same item, raising its priority if the
+    // new caller is more urgent.
+    uint64_t RequestPreviewAsync(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize, HWND notifyHwnd, UINT message,
+                                 PreviewPriority priority = PreviewPriority::kInteractive);
     void CancelRequest(uint64_t requestId);
     void CancelPendingCapturesForKey(PCIDLIST_ABSOLUTE pidl);
     void CancelPendingCapturesForOwner(std::wstring_view ownerToken);
@@ -67,48 +84,58 @@ private:
         }
     };
 
-    PreviewCache() = default;
+    PreviewCache();
     ~PreviewCache();
 
     PreviewCache(const PreviewCache&) = delete;
     PreviewCache& operator=(const PreviewCache&) = delete;
 
-    struct Entry {
+    struct HotPreview {
         HBITMAP bitmap = nullptr;
         SIZE size{};
-        std::list<std::wstring>::iterator lruPosition{};
-        bool inLruList = false;
+        GdiResourceCost cost;
     };
-
-    void EnsureWorkerThread();
-    void ProcessRequests();
-    void StoreBitmapForKey(const std::wstring& key, HBITMAP bitmap, const SIZE& size);
-    void TouchEntryLocked(Entry& entry, const std::wstring& key);
-    void TrimCacheLocked();
-    static std::wstring BuildCacheKey(PCIDLIST_ABSOLUTE pidl);
-    uint64_t GetPendingRequestIdLocked(const std::wstring& key, RequestKind kind);
-    void SetPendingRequestIdLocked(const std::wstring& key, RequestKind kind, uint64_t requestId);
-    void ClearPendingRequestIdLocked(const std::wstring& key, RequestKind kind, uint64_t requestId);
+    using PreviewTiers = PreviewTierCache<HotPreview, PreviewKey, PreviewKeyHasher>;
+
+    void RunRequest(const std::shared_ptr<AsyncRequest>& request);
+    void MarkDequeuedLocked(AsyncRequest& request);
+    void StoreBitmapForKey(const PreviewKey& key, PCIDLIST_ABSOLUTE pidl, HBITMAP bitmap, const SIZE& size);
+    std::optional<PreviewImage> RestoreFromDisk(PCIDLIST_ABSOLUTE pidl, const PreviewKey& key);
+    void PersistToDisk(PCIDLIST_ABSOLUTE pidl, const PreviewKey& key, HBITMAP bitmap, const SIZE& size);
+    PreviewTiers::Hooks BuildTierHooks();
+    std::optional<HotPreview> CreateHotPreview(const PreviewPixels& pixels);
+    void DestroyHotPreview(HotPreview& preview);
+    GdiBudgetShedResult ShedColdEntries(const GdiResourceCost& excess);
+    static PreviewKey BuildCacheKey(PCIDLIST_ABSOLUTE pidl);
+    static PreviewDiskKey BuildDiskKey(PCIDLIST_ABSOLUTE pidl, const PreviewKey& key);
+    bool IsKeyOwnerLocked(const PreviewKey& key, PCIDLIST_ABSOLUTE pidl);
+    uint64_t GetPendingRequestIdLocked(const PreviewKey& key, RequestKind kind);
+    void SetPendingRequestIdLocked(const PreviewKey& key, RequestKind kind, uint64_t requestId);
+    void ClearPendingRequestIdLocked(const PreviewKey& key, RequestKind kind, uint64_t requestId);
     void RegisterCaptureRequestLocked(const std::shared_ptr<AsyncRequest>& request);
     void UnregisterCaptureRequestLocked(const std::shared_ptr<AsyncRequest>& request);
     void CancelCaptureRequestLocked(uint64_t requestId);
 
     std::mutex m_mutex;
-    std::unordered_map<std::wstring, Entry> m_entries;
-    std::list<std::wstring> m_lruList;
-    static constexpr size_t kMaxEntries = 64;
+    GdiResourceBudget::ClientHandle m_budgetClient;
+    // Under GDI pressure the budget demotes hot previews rather than dropping
+    // them.
+    PreviewTiers m_tiers;
+    // PIDL bytes behind each cached key, to tell a hash collision from a hit.
+    std::unordered_map<PreviewKey, std::string, PreviewKeyHasher> m_keyPidls;
+    uint64_t m_keyCollisions = 0;
+    PreviewDiskStore m_diskStore;
 
     std::mutex m_requestMutex;
-    std::condition_variable m_requestCv;
-    std::deque<std::shared_ptr<AsyncRequest>> m_requestQueue;
     std::unordered_map<uint64_t, std::shared_ptr<AsyncRequest>> m_requestMap;
-    std::unordered_map<std::wstring, PendingKeyEntry> m_requestsByKey;
-    std::unordered_map<std::wstring, uint64_t> m_captureRequestsByKey;
+    std::unordered_map<PreviewKey, PendingKeyEntry, PreviewKeyHasher> m_requestsByKey;
+    std::unordered_map<PreviewKey, uint64_t, PreviewKeyHasher> m_captureRequestsByKey;
     std::unordered_map<std::wstring, uint64_t> m_captureRequestsByOwner;
-    std::thread m_workerThread;
-    bool m_shutdown = false;
+    // Ids of captures still waiting for a worker, oldest first.
+    std::deque<uint64_t> m_queuedCaptureIds;
     uint64_t m_nextRequestId = 1;
-    size_t m_pendingCaptureCount = 0;
+    // Declared last so its workers stop before the state they use is torn down.
+    PreviewWorkQueue m_workQueue;
 };
 
 }  // namespace shelltabs
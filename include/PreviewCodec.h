@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace shelltabs {
+
+// Uncompressed preview pixels, 32bpp BGRA, top-down rows with no padding.
+struct PreviewPixels {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> bgra;
+};
+
+// Lossless byte-oriented codec for preview pixels. Window captures are mostly
+// flat fills, gradients and text, so each pixel is coded as a run, a hit in a
+// small table of recent colours, or a small delta from the previous pixel,
+// with a literal fallback (the scheme popularised by the QOI format). Encoding
+// and decoding are single linear passes with no allocation beyond the output.
+//
+// The stream is headerless; callers keep the dimensions alongside it.
+void EncodePreviewPixels(const PreviewPixels& pixels, std::vector<uint8_t>* encoded);
+
+// Returns false if the stream is malformed or does not fill exactly
+// width * height pixels.
+bool DecodePreviewPixels(const uint8_t* data, size_t size, uint32_t width, uint32_t height, PreviewPixels* pixels);
+
+// Worst-case encoded size, for reserving output.
+size_t MaxEncodedPreviewSize(size_t pixelCount) noexcept;
+
+}  // namespace shelltabs
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+#include "PreviewCodec.h"
+#include "PreviewKey.h"
+
+namespace shelltabs {
+
+// Identifies a stored preview: the full 128-bit hash of the item's serialized
+// PIDL and the folder's last-write time. A preview stored under an older
+// stamp is stale and reads as a miss.
+struct PreviewDiskKey {
+    PreviewKey item;
+    uint64_t folderStamp = 0;
+};
+
+struct PreviewDiskRecordHeader {
+    uint32_t magic = 0;
+    uint32_t payloadSize = 0;
+    // Both halves of the item hash, so a record is never read back for
+    // another item that shares the low half.
+    uint64_t itemLow = 0;
+    uint64_t itemHigh = 0;
+    uint64_t folderStamp = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // Covers the other header fields; a torn or garbled header ends the log.
+    uint32_t headerChecksum = 0;
+    // Covers the payload; checked when the record is read.
+    uint32_t payloadChecksum = 0;
+};
+static_assert(sizeof(PreviewDiskRecordHeader) == 48, "PreviewDiskRecordHeader is a fixed on-disk layout");
+
+struct PreviewDiskFileHeader {
+    char magic[8] = {'S', 'T', 'P', 'R', 'E', 'V', 'W', '1'};
+    // Version 1 records keyed on the low half of the item hash only.
+    uint32_t version = 2;
+    uint32_t recordHeaderSize = sizeof(PreviewDiskRecordHeader);
+};
+static_assert(sizeof(PreviewDiskFileHeader) == 16, "PreviewDiskFileHeader is a fixed on-disk layout");
+
+struct PreviewDiskStoreStats {
+    size_t entries = 0;
+    size_t fileBytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Hits rejected because the folder changed since the preview was stored.
+    uint64_t staleMisses = 0;
+    // Records dropped because their payload failed its checksum.
+    uint64_t corruptRecords = 0;
+    uint64_t compactions = 0;
+};
+
+// Persistent preview store that survives Explorer restarts. The file is an
+// append-only log of encoded previews that is memory-mapped for reads; later
+// records for the same item supersede earlier ones. Opening the store scans
+// the record headers and truncates the log at the first incomplete or garbled
+// record, so a crash mid-write loses at most that record. When the file
+// outgrows its cap it is compacted into a new file holding the most recently
+// used previews, which then replaces the old one by rename.
+//
+// Thread safe; lookups and stores from different threads serialize on one
+// lock. Compaction holds that lock only to snapshot the kept records and to
+// swap the new file in, so lookups keep running while the copy is written.
+class PreviewDiskStore {
+public:
+    static constexpr size_t kDefaultMaxBytes = 32u * 1024u * 1024u;
+    // Compaction keeps previews up to this share of the cap so it does not
+    // run again on the next few stores.
+    static constexpr size_t kCompactTargetPercent = 75;
+
+    explicit PreviewDiskStore(size_t maxBytes = kDefaultMaxBytes);
+    ~PreviewDiskStore();
+
+    PreviewDiskStore(const PreviewDiskStore&) = delete;
+    PreviewDiskStore& operator=(const PreviewDiskStore&) = delete;
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+    bool IsOpen() const;
+
+    std::optional<PreviewPixels> Load(const PreviewDiskKey& key);
+    bool Contains(const PreviewDiskKey& key) const;
+    bool Store(const PreviewDiskKey& key, const PreviewPixels& pixels);
+    // Rewrites the log keeping the most recently used previews that fit in
+    // targetBytes.
+    bool Compact(size_t targetBytes);
+
+    PreviewDiskStoreStats Stats() const;
+
+    // Runs after compaction has written its copy and before it swaps the copy
+    // in, with no lock held.
+    void SetCompactionWrittenHookForTest(std::function<void()> hook) { m_compactionWrittenHookForTest = std::move(hook); }
+
+private:
+    struct Slot {
+        uint64_t offset = 0;
+        uint32_t payloadSize = 0;
+        uint64_t folderStamp = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint64_t lastUse = 0;
+    };
+
+    struct FileState;
+
+    bool OpenLocked();
+    void CloseLocked();
+    bool ScanLocked();
+    bool EnsureMappedLocked(uint64_t end);
+    // Caller holds m_compactMutex but not m_mutex.
+    bool CompactExclusive(size_t targetBytes);
+
+    mutable std::mutex m_mutex;
+    // Serializes compactions; taken before m_mutex, never while holding it.
+    std::mutex m_compactMutex;
+    std::filesystem::path m_path;
+    size_t m_maxBytes = kDefaultMaxBytes;
+    std::unique_ptr<FileState> m_file;
+    // Bumped whenever m_file is opened or closed, so a compaction notices the
+    // log it copied was replaced while it wrote.
+    uint64_t m_fileEpoch = 0;
+    uint64_t m_fileBytes = 0;
+    std::unordered_map<PreviewKey, Slot, PreviewKeyHasher> m_slots;
+    uint64_t m_useClock = 0;
+    PreviewDiskStoreStats m_stats;
+    std::function<void()> m_compactionWrittenHookForTest;
+};
+
+}  // namespace shelltabs
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace shelltabs {
+
+// 128-bit hash of an item's serialized PIDL, used to key previews without
+// building a display string per lookup. Caches that keep the PIDL bytes beside
+// an entry compare them to catch the rare collision; the all-zero key means
+// "no item".
+struct PreviewKey {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    [[nodiscard]] bool Empty() const noexcept { return low == 0 && high == 0; }
+
+    friend bool operator==(const PreviewKey& left, const PreviewKey& right) noexcept {
+        return left.low == right.low && left.high == right.high;
+    }
+    friend bool operator!=(const PreviewKey& left, const PreviewKey& right) noexcept { return !(left == right); }
+};
+
+struct PreviewKeyHasher {
+    // Both halves are already well mixed.
+    size_t operator()(const PreviewKey& key) const noexcept { return static_cast<size_t>(key.low); }
+};
+
+// Hashes size bytes with two 64-bit lanes mixed 16 bytes at a time. Not
+// cryptographic; the length is folded in so trailing zero bytes matter.
+PreviewKey HashPreviewKey(const void* data, size_t size) noexcept;
+
+}  // namespace shelltabs
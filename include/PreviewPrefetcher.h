@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+namespace shelltabs {
+
+struct PrefetchRect {
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+};
+
+// One tab as the prefetcher sees it, in tab-band order.
+struct PrefetchTab {
+    uint64_t id = 0;
+    PrefetchRect bounds;
+    // Larger is more recently used; 0 means never activated.
+    uint64_t lastActivated = 0;
+    // False for tabs whose preview is produced some other way, e.g. the
+    // selected tab, which is captured from its live window.
+    bool eligible = true;
+};
+
+struct PreviewPrefetchOptions {
+    // Prefetches in flight at once; kept below the preview worker count so a
+    // hover that does land still finds a worker.
+    size_t maxOutstanding = 2;
+    // Prefetches per visit of the pointer to the band.
+    size_t sessionBudget = 6;
+    // How far ahead the pointer position is extrapolated.
+    std::chrono::milliseconds lookahead{200};
+    // Most recently used tabs considered regardless of the pointer.
+    size_t mruCandidates = 2;
+    // Below this speed, in pixels per second, the pointer is treated as
+    // resting and trajectory is ignored.
+    double restingSpeed = 60.0;
+    // Candidates scoring less than this are never prefetched.
+    double minScore = 15.0;
+};
+
+struct PreviewPrefetchStats {
+    uint64_t issued = 0;
+    uint64_t finished = 0;
+    uint64_t cancelled = 0;
+    // Candidates skipped because their preview was already cached.
+    uint64_t alreadyCached = 0;
+};
+
+// Decides which tab previews to request before the user hovers them. Each
+// pointer move scores tabs by where the pointer is headed, whether they sit
+// next to the hovered tab and how recently they were used, and returns the
+// best ones that fit the outstanding limit and the per-visit budget. Not
+// thread safe; the tab band drives it from its window thread.
+class PreviewPrefetchPlanner {
+public:
+    using Clock = std::chrono::steady_clock;
+    using CachedPredicate = std::function<bool(uint64_t id)>;
+
+    explicit PreviewPrefetchPlanner(PreviewPrefetchOptions options = {});
+
+    void SetTabs(std::vector<PrefetchTab> tabs);
+
+    // Returns the ids to request now, most useful first. isCached is only
+    // consulted for candidates that would otherwise be requested.
+    std::vector<uint64_t> OnPointerMove(int x, int y, Clock::time_point time, const CachedPredicate& isCached);
+    void OnPrefetchFinished(uint64_t id);
+    // Ends the visit and returns the prefetches still in flight, which the
+    // caller should cancel.
+    std::vector<uint64_t> OnPointerLeave();
+
+    bool IsOutstanding(uint64_t id) const { return m_outstanding.count(id) != 0; }
+    size_t Outstanding() const { return m_outstanding.size(); }
+    const PreviewPrefetchStats& Stats() const { return m_stats; }
+
+private:
+    struct Candidate {
+        size_t index = 0;
+        double score = 0.0;
+    };
+
+    size_t FindTabAt(double x, double y) const;
+    void UpdateVelocity(int x, int y, Clock::time_point time);
+
+    PreviewPrefetchOptions m_options;
+    std::vector<PrefetchTab> m_tabs;
+    // Tab indices ordered most recently used first.
+    std::vector<size_t> m_mruOrder;
+    std::unordered_set<uint64_t> m_outstanding;
+    // Everything requested during the current visit, finished or not.
+    std::unordered_set<uint64_t> m_requested;
+    // Value of m_stats.issued when the current visit began.
+    uint64_t m_sessionStartIssued = 0;
+    bool m_hasPointer = false;
+    int m_lastX = 0;
+    int m_lastY = 0;
+    Clock::time_point m_lastTime{};
+    // Smoothed pointer velocity in pixels per second.
+    double m_velocityX = 0.0;
+    double m_velocityY = 0.0;
+    PreviewPrefetchStats m_stats;
+};
+
+}  // namespace shelltabs
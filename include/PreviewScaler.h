@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace shelltabs {
+
+enum class PreviewScaleFilter : uint8_t {
+    // Each output pixel averages the source area it covers.
+    kBox,
+    // Triangle filter widened to the scale factor, so downscaling stays
+    // antialiased; slightly softer than kBox.
+    kBilinear,
+};
+
+enum class PreviewScalerPath : uint8_t {
+    // The fastest path this CPU supports.
+    kAuto,
+    kScalar,
+    kSse2,
+    kAvx2,
+};
+
+// Read-only 32bpp BGRA pixels, top-down; stride is in pixels.
+struct PreviewPixelView {
+    const uint32_t* bgra = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t stride = 0;
+};
+
+// Resamples premultiplied BGRA into dest, destWidth * destHeight pixels with
+// no row padding. Filtering is separable in 14-bit fixed point and every path
+// produces identical output. Returns false for empty images, or when the
+// requested path is not available on this CPU.
+bool ScalePreviewPixels(const PreviewPixelView& source, uint32_t* dest, uint32_t destWidth, uint32_t destHeight,
+                        PreviewScaleFilter filter = PreviewScaleFilter::kBox,
+                        PreviewScalerPath path = PreviewScalerPath::kAuto);
+
+bool IsPreviewScalerPathSupported(PreviewScalerPath path) noexcept;
+
+}  // namespace shelltabs
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "PreviewCodec.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace shelltabs {
+
+struct PreviewTierLimits {
+    // Ready-to-draw images; each pins GDI memory and handles.
+    size_t hotEntries = 32;
+    // Total encoded bytes kept in the cold tier.
+    size_t coldBytes = 16u * 1024u * 1024u;
+};
+
+struct PreviewTierStats {
+    uint64_t hotHits = 0;
+    // Cold hits decoded and promoted back to the hot tier.
+    uint64_t promotions = 0;
+    uint64_t misses = 0;
+    uint64_t demotions = 0;
+    uint64_t coldEvictions = 0;
+    size_t hotEntries = 0;
+    size_t coldEntries = 0;
+    size_t coldBytes = 0;
+    // What the cold entries would occupy uncompressed.
+    size_t coldRawBytes = 0;
+};
+
+enum class PreviewTierEvent : uint8_t {
+    kDemoted,
+    kEvicted,
+};
+
+// Two-tier preview store: a small LRU hot tier of ready-to-draw images and a
+// larger LRU cold tier of encoded pixels. Hot entries pushed out of their
+// tier are read back and encoded into the cold tier; cold hits are decoded and
+// promoted. Hot is the platform image type, created and destroyed only
+// through the hooks. Not thread safe; the owner serializes access.
+template <typename Hot, typename Key = std::wstring, typename KeyHash = std::hash<Key>>
+class PreviewTierCache {
+public:
+    struct Hooks {
+        // Reads an image back for demotion; nullopt drops it instead.
+        std::function<std::optional<PreviewPixels>(const Hot& image)> readPixels;
+        // Builds an image for promotion; nullopt leaves the entry cold.
+        std::function<std::optional<Hot>(const PreviewPixels& pixels)> createImage;
+        std::function<void(Hot& image)> destroyImage;
+        // Optional; reports entries leaving a tier.
+        std::function<void(const Key& key, PreviewTierEvent event, size_t bytes)> observer;
+    };
+
+    PreviewTierCache(Hooks hooks, PreviewTierLimits limits) : m_hooks(std::move(hooks)) { SetLimits(limits); }
+    ~PreviewTierCache() { Clear(); }
+
+    PreviewTierCache(const PreviewTierCache&) = delete;
+    PreviewTierCache& operator=(const PreviewTierCache&) = delete;
+
+    // Returns the hot image for key, promoting it from the cold tier if
+    // needed, or null on a miss. The pointer is valid until the next call.
+    Hot* Find(const Key& key) {
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            ++m_stats.misses;
+            return nullptr;
+        }
+        Entry& entry = it->second;
+        if (entry.hot) {
+            ++m_stats.hotHits;
+            m_hotLru.splice(m_hotLru.begin(), m_hotLru, entry.lruPosition);
+            return &*entry.hot;
+        }
+
+        PreviewPixels pixels;
+        std::optional<Hot> image;
+        if (DecodePreviewPixels(entry.encoded.data(), entry.encoded.size(), entry.width, entry.height, &pixels)) {
+            image = m_hooks.createImage(pixels);
+        }
+        if (!image) {
+            // Corrupt or unusable; forget it so the caller regenerates.
+            ++m_stats.misses;
+            EraseEntry(it);
+            return nullptr;
+        }
+
+        ++m_stats.promotions;
+        m_coldBytes -= entry.encoded.size();
+        m_coldRawBytes -= RawBytes(entry);
+        m_coldLru.erase(entry.lruPosition);
+        entry.encoded.clear();
+        entry.encoded.shrink_to_fit();
+        entry.hot = std::move(image);
+        m_hotLru.push_front(it->first);
+        entry.lruPosition = m_hotLru.begin();
+        // Promotion may push the coldest hot entry out; it is never this one.
+        TrimHot();
+        return &*entry.hot;
+    }
+
+    bool Contains(const Key& key) const { return m_entries.count(key) != 0; }
+
+    std::vector<Key> Keys() const {
+        std::vector<Key> keys;
+        keys.reserve(m_entries.size());
+        for (const auto& entry : m_entries) {
+            keys.push_back(entry.first);
+        }
+        return keys;
+    }
+
+    // Inserts or replaces key in the hot tier and takes ownership of image.
+    void Store(const Key& key, Hot image) {
+        auto existing = m_entries.find(key);
+        if (existing != m_entries.end()) {
+            EraseEntry(existing);
+        }
+        auto [it, inserted] = m_entries.try_emplace(key);
+        (void)inserted;
+        Entry& entry = it->second;
+        entry.hot = std::move(image);
+        m_hotLru.push_front(it->first);
+        entry.lruPosition = m_hotLru.begin();
+        TrimHot();
+    }
+
+    bool Erase(const Key& key) {
+        auto it = m_entries.find(key);
+        if (it == m_entries.end()) {
+            return false;
+        }
+        EraseEntry(it);
+        return true;
+    }
+
+    void Clear() {
+        while (!m_entries.empty()) {
+            EraseEntry(m_entries.begin());
+        }
+    }
+
+    // Moves up to count of the coldest hot entries to the cold tier, e.g.
+    // under GDI pressure. Returns how many left the hot tier.
+    size_t DemoteColdest(size_t count) {
+        size_t demoted = 0;
+        while (demoted < count && !m_hotLru.empty()) {
+            DemoteLeastRecent();
+            ++demoted;
+        }
+        return demoted;
+    }
+
+    void SetLimits(const PreviewTierLimits& limits) {
+        m_limits = limits;
+        // Find hands out a pointer to the image it just promoted.
+        m_limits.hotEntries = std::max<size_t>(1, m_limits.hotEntries);
+        TrimHot();
+        TrimCold();
+    }
+
+    const PreviewTierLimits& Limits() const noexcept { return m_limits; }
+
+    PreviewTierStats Stats() const {
+        PreviewTierStats stats = m_stats;
+        stats.hotEntries = m_hotLru.size();
+        stats.coldEntries = m_coldLru.size();
+        stats.coldBytes = m_coldBytes;
+        stats.coldRawBytes = m_coldRawBytes;
+        return stats;
+    }
+
+private:
+    struct Entry {
+        std::optional<Hot> hot;
+        std::vector<uint8_t> encoded;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::list<Key>::iterator lruPosition{};
+    };
+    using EntryMap = std::unordered_map<Key, Entry, KeyHash>;
+
+    static size_t RawBytes(const Entry& entry) noexcept {
+        return static_cast<size_t>(entry.width) * entry.height * sizeof(uint32_t);
+    }
+
+    void EraseEntry(typename EntryMap::iterator it) {
+        Entry& entry = it->second;
+        if (entry.hot) {
+            m_hooks.destroyImage(*entry.hot);
+            m_hotLru.erase(entry.lruPosition);
+        } else {
+            m_coldBytes -= entry.encoded.size();
+            m_coldRawBytes -= RawBytes(entry);
+            m_coldLru.erase(entry.lruPosition);
+        }
+        m_entries.erase(it);
+    }
+
+    void TrimHot() {
+        while (m_hotLru.size() > m_limits.hotEntries) {
+            DemoteLeastRecent();
+        }
+    }
+
+    void TrimCold() {
+        while (m_coldBytes > m_limits.coldBytes && !m_coldLru.empty()) {
+            auto it = m_entries.find(m_coldLru.back());
+            const size_t bytes = it->second.encoded.size();
+            const Key key = it->first;
+            EraseEntry(it);
+            ++m_stats.coldEvictions;
+            if (m_hooks.observer) {
+                m_hooks.observer(key, PreviewTierEvent::kEvicted, bytes);
+            }
+        }
+    }
+
+    void DemoteLeastRecent() {
+        auto it = m_entries.find(m_hotLru.back());
+        Entry& entry = it->second;
+        std::optional<PreviewPixels> pixels = m_hooks.readPixels(*entry.hot);
+        std::vector<uint8_t> encoded;
+        if (pixels) {
+            EncodePreviewPixels(*pixels, &encoded);
+        }
+        if (encoded.empty() || encoded.size() > m_limits.coldBytes) {
+            const Key key = it->first;
+            EraseEntry(it);
+            if (m_hooks.observer) {
+                m_hooks.observer(key, PreviewTierEvent::kEvicted, 0);
+            }
+            return;
+        }
+
+        m_hooks.destroyImage(*entry.hot);
+        entry.hot.reset();
+        m_hotLru.erase(entry.lruPosition);
+        entry.width = pixels->width;
+        entry.height = pixels->height;
+        entry.encoded = std::move(encoded);
+        m_coldBytes += entry.encoded.size();
+        m_coldRawBytes += RawBytes(entry);
+        m_coldLru.push_front(it->first);
+        entry.lruPosition = m_coldLru.begin();
+        ++m_stats.demotions;
+        if (m_hooks.observer) {
+            m_hooks.observer(it->first, PreviewTierEvent::kDemoted, entry.encoded.size());
+        }
+        TrimCold();
+    }
+
+    Hooks m_hooks;
+    PreviewTierLimits m_limits;
+    EntryMap m_entries;
+    // Keys, most recently used first.
+    std::list<Key> m_hotLru;
+    std::list<Key> m_coldLru;
+    size_t m_coldBytes = 0;
+    size_t m_coldRawBytes = 0;
+    PreviewTierStats m_stats;
+};
+
+}  // namespace shelltabs
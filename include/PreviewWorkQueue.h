@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace shelltabs {
+
+// Lower values run first.
+enum class PreviewPriority : uint8_t {
+    // The user is hovering a tab and waiting for its preview.
+    kInteractive = 0,
+    // Tabs on screen that may be hovered next.
+    kPrefetch,
+    // Captures refreshing previews nobody is looking at yet.
+    kBackground,
+};
+
+inline constexpr size_t kPreviewPriorityCount = 3;
+
+struct PreviewWorkQueueOptions {
+    size_t workers = 2;
+    // Work waiting this long is treated as one class more urgent, so a steady
+    // stream of interactive work cannot starve background captures forever.
+    std::chrono::milliseconds agingStep{750};
+    // When there is more than one worker, this many are held back for
+    // interactive work so a capture burst cannot occupy the whole pool.
+    size_t reservedInteractiveWorkers = 1;
+    // Run on each worker before its first task and after its last, e.g. to
+    // initialize COM.
+    std::function<void()> threadStart;
+    std::function<void()> threadStop;
+};
+
+struct PreviewPriorityStats {
+    uint64_t submitted = 0;
+    uint64_t started = 0;
+    // Removed from the queue before a worker picked them up.
+    uint64_t cancelled = 0;
+    std::chrono::steady_clock::duration totalWait{};
+    std::chrono::steady_clock::duration maxWait{};
+};
+
+// Fixed pool of workers running queued tasks by priority class. Within a
+// class tasks run in submission order. Cancel removes queued tasks outright;
+// a task that already started runs to completion.
+class PreviewWorkQueue {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    explicit PreviewWorkQueue(PreviewWorkQueueOptions options = {});
+    ~PreviewWorkQueue();
+
+    PreviewWorkQueue(const PreviewWorkQueue&) = delete;
+    PreviewWorkQueue& operator=(const PreviewWorkQueue&) = delete;
+
+    // Returns an id for Cancel and Reprioritize, or 0 after Shutdown. Workers
+    // start on first submission.
+    uint64_t Submit(PreviewPriority priority, Task task);
+    // Returns true if the task was still queued and will never run.
+    bool Cancel(uint64_t id);
+    // Moves a queued task to another class, keeping its original submission
+    // time for aging. Returns false if it already started.
+    bool Reprioritize(uint64_t id, PreviewPriority priority);
+
+    // Stops accepting work, drops whatever is still queued and joins the
+    // workers after their current tasks.
+    void Shutdown();
+
+    size_t Pending() const;
+    std::array<PreviewPriorityStats, kPreviewPriorityCount> Stats() const;
+
+private:
+    struct QueuedTask {
+        uint64_t id = 0;
+        Clock::time_point submitted;
+        Task task;
+    };
+
+    void EnsureWorkersLocked();
+    void WorkerMain();
+    // Picks the queue to serve next, or kPreviewPriorityCount if nothing may
+    // run right now.
+    size_t SelectQueueLocked(Clock::time_point now) const;
+
+    PreviewWorkQueueOptions m_options;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::array<std::deque<QueuedTask>, kPreviewPriorityCount> m_queues;
+    // Queue index of every task that has not started yet.
+    std::unordered_map<uint64_t, size_t> m_queuedIndex;
+    std::array<PreviewPriorityStats, kPreviewPriorityCount> m_stats{};
+    std::vector<std::thread> m_workers;
+    size_t m_runningNonInteractive = 0;
+    uint64_t m_nextId = 1;
+    bool m_shutdown = false;
+};
+
+}  // namespace shelltabs
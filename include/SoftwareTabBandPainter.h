@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "TabBandPaint.h"
+
+namespace shelltabs {
+
+// Paints the tab band into opaque 32bpp BGRA pixels, top-down, without any
+// platform API, so painting can be benchmarked and compared against golden
+// images anywhere. Coverage follows the GDI rules TabBandPainter describes.
+// Text is a solid block per character on a fixed advance (lowercase letters
+// are shorter, periods a dot) fitted with FitTabLabel, icons a framed grey
+// square, and dashed lines use their own pattern rather than GDI's.
+class SoftwareTabBandPainter final : public TabBandPainter {
+public:
+    static constexpr int32_t kGlyphWidth = 5;
+    static constexpr int32_t kGlyphHeight = 7;
+    static constexpr int32_t kGlyphAdvance = 6;
+
+    SoftwareTabBandPainter(uint32_t width, uint32_t height);
+
+    uint32_t Width() const noexcept { return m_width; }
+    uint32_t Height() const noexcept { return m_height; }
+    const std::vector<uint32_t>& Pixels() const noexcept { return m_pixels; }
+    void Clear(PaintColor color);
+
+    void FillRect(const PaintRect& rect, PaintColor color) override;
+    void FillGradient(const PaintRect& rect, PaintColor start, PaintColor end, bool horizontal) override;
+    void FillPolygon(const PaintPoint* points, size_t count, PaintColor color) override;
+    void StrokePolygon(const PaintPoint* points, size_t count, PaintColor color) override;
+    void FillEllipse(const PaintRect& bounds, PaintColor color) override;
+    void DrawLine(PaintPoint from, PaintPoint to, PaintColor color, int width = 1,
+                  PaintLineStyle style = PaintLineStyle::kSolid) override;
+    void DrawString(const PaintRect& bounds, std::wstring_view text, PaintColor color,
+                    PaintTextAlign align) override;
+    void DrawIcon(const void* icon, const PaintRect& bounds) override;
+
+private:
+    // Fills [left, right) of row y, clipped to the image and to clip.
+    void Span(int32_t y, int32_t left, int32_t right, uint32_t pixel, const PaintRect& clip);
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    PaintRect m_bounds;
+    std::vector<uint32_t> m_pixels;
+};
+
+}  // namespace shelltabs
@@ -23,6 +23,7 @@
 #include "OptionsStore.h"
 #include "GroupStore.h"
 #include "OptionsDialog.h"
+#include "PreviewWorkQueue.h"
 #include "ShellTabsMessages.h"
 
 namespace shelltabs {
@@ -149,6 +150,7 @@ public:
                              const std::wstring& focusGroupId = std::wstring(),
                              bool editFocusedGroup = false);
     void OnSavedGroupsChanged();
+    void OnOptionsChanged(uint64_t generation, DWORD sourceProcessId);
     void OnDeferredNavigate();
     void OnDockingModeChanged(TabBandDockMode mode);
     std::wstring GetSavedGroupId(int groupIndex) const;
@@ -206,6 +208,7 @@ private:
     TabBandDockMode m_requestedDockMode = TabBandDockMode::kAutomatic;
     mutable bool m_skipSavedGroupSync = false;
     uint64_t m_processedGroupStoreGeneration = 0;
+    uint64_t m_appliedOptionsGeneration = 0;
 
     struct ClosedGroupMetadata {
         std::wstring name;
@@ -276,7 +279,7 @@ private:
     TabManager::ExplorerWindowId BuildWindowId() const;
     std::wstring ResolveWindowToken();
     void ReleaseWindowToken();
-    void CaptureActiveTabPreview();
+    void CaptureActiveTabPreview(PreviewPriority priority = PreviewPriority::kBackground);
 };
 
 }  // namespace shelltabs
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "TabBandPaint.h"
+
+namespace shelltabs {
+
+inline constexpr size_t kNoTabLayoutEntry = std::numeric_limits<size_t>::max();
+
+enum class TabLayoutEntryKind : uint8_t {
+    kGroupHeader,
+    kTab,
+};
+
+// What the row wrapping needs to know about one TabViewItem.
+struct TabLayoutEntry {
+    TabLayoutEntryKind kind = TabLayoutEntryKind::kTab;
+    int32_t groupIndex = -1;
+    // Tabs: the measured width with padding, badge, icon and close button,
+    // before wrapping clamps it.
+    int32_t width = 0;
+    // Group headers.
+    bool headerVisible = false;
+    bool collapsed = false;
+    bool hasVisibleTabs = false;
+
+    friend bool operator==(const TabLayoutEntry& left, const TabLayoutEntry& right) noexcept {
+        return left.kind == right.kind && left.groupIndex == right.groupIndex && left.width == right.width &&
+               left.headerVisible == right.headerVisible && left.collapsed == right.collapsed &&
+               left.hasVisibleTabs == right.hasVisibleTabs;
+    }
+};
+
+struct TabLayoutMetrics {
+    int32_t boundsLeft = 0;
+    // Where every row starts.
+    int32_t originX = 0;
+    // Items wrap to the next row rather than end past maxX.
+    int32_t maxX = 0;
+    int32_t top = 0;
+    int32_t rowHeight = 0;
+    int32_t rowGap = 0;
+    int32_t maxRows = 1;
+    int32_t tabGap = 0;
+    int32_t groupGap = 0;
+    int32_t indicatorWidth = 0;
+    int32_t emptyBodyMaxWidth = 0;
+    int32_t minTabWidth = 40;
+
+    friend bool operator==(const TabLayoutMetrics& left, const TabLayoutMetrics& right) noexcept {
+        return left.boundsLeft == right.boundsLeft && left.originX == right.originX && left.maxX == right.maxX &&
+               left.top == right.top && left.rowHeight == right.rowHeight && left.rowGap == right.rowGap &&
+               left.maxRows == right.maxRows && left.tabGap == right.tabGap && left.groupGap == right.groupGap &&
+               left.indicatorWidth == right.indicatorWidth && left.emptyBodyMaxWidth == right.emptyBodyMaxWidth &&
+               left.minTabWidth == right.minTabWidth;
+    }
+};
+
+enum class TabLayoutSlotKind : uint8_t {
+    // A group header's island handle.
+    kIndicator,
+    // The body of a visible group with no visible tabs.
+    kEmptyBody,
+    kTab,
+};
+
+// One laid out VisualItem.
+struct TabLayoutSlot {
+    TabLayoutSlotKind kind = TabLayoutSlotKind::kTab;
+    size_t entry = kNoTabLayoutEntry;
+    PaintRect bounds;
+    int32_t row = 0;
+    bool firstInGroup = false;
+    bool collapsedPlaceholder = false;
+    bool indicatorHandle = false;
+    // The group header entry the slot carries; kNoTabLayoutEntry when none.
+    size_t header = kNoTabLayoutEntry;
+};
+
+// What the last TabBandLayout::Update re-laid out. Slots before firstSlot are
+// untouched; slots from endSlot on are the old ones from oldEndSlot on, moved
+// by endSlot - oldEndSlot.
+struct TabLayoutUpdate {
+    bool full = false;
+    size_t firstEntry = 0;
+    size_t firstSlot = 0;
+    size_t endSlot = 0;
+    size_t oldEndSlot = 0;
+    // Sorted groups with a slot in either re-laid range.
+    std::vector<int32_t> groups;
+
+    bool Changed() const noexcept { return full || firstSlot != endSlot || firstSlot != oldEndSlot; }
+};
+
+struct TabBandLayoutStats {
+    uint64_t updates = 0;
+    uint64_t fullLayouts = 0;
+    // Entries placed, and entries whose slots were carried over once the
+    // wrapping came back in step with the previous layout.
+    uint64_t placedEntries = 0;
+    uint64_t reusedEntries = 0;
+};
+
+// Wraps tab band items into rows. Each update restarts at the first entry
+// that differs from the previous one and stops once the wrapping state
+// matches the previous layout again over an unchanged tail, so renaming,
+// inserting or closing a tab re-wraps the rows from that tab on instead of
+// the whole band. Changing the metrics lays out everything.
+class TabBandLayout {
+public:
+    const TabLayoutUpdate& Update(std::vector<TabLayoutEntry> entries, const TabLayoutMetrics& metrics);
+    void Reset();
+
+    const std::vector<TabLayoutEntry>& Entries() const noexcept { return m_entries; }
+    const std::vector<TabLayoutSlot>& Slots() const noexcept { return m_slots; }
+    const TabLayoutUpdate& LastUpdate() const noexcept { return m_update; }
+    const TabBandLayoutStats& Stats() const noexcept { return m_stats; }
+
+    // Where the next item would go.
+    int32_t EndX() const noexcept { return m_end.x; }
+    int32_t EndRow() const noexcept { return m_end.row; }
+    int32_t MaxRowUsed() const noexcept { return m_end.maxRowUsed; }
+    // Whether a header ran out of rows, leaving later entries without slots.
+    bool Truncated() const noexcept { return m_truncated; }
+
+    int32_t RowTop(int32_t row) const noexcept { return m_metrics.top + row * (m_metrics.rowHeight + m_metrics.rowGap); }
+    int32_t RowBottom(int32_t row) const noexcept { return RowTop(row) + m_metrics.rowHeight; }
+
+private:
+    // The wrapping state before an entry.
+    struct Cursor {
+        int32_t x = 0;
+        int32_t row = 0;
+        int32_t maxRowUsed = 0;
+        int32_t group = -1;
+        size_t header = kNoTabLayoutEntry;
+        size_t indicator = kNoTabLayoutEntry;
+        bool headerMetadata = false;
+        bool expectFirstTab = false;
+        bool pendingIndicator = false;
+        size_t slots = 0;
+    };
+
+    bool TryWrap(Cursor& cursor) const noexcept;
+    // Appends the entry's slots; false when it no longer fits. cursor.slots
+    // counts the slots before the entry.
+    bool Place(size_t index, Cursor& cursor, std::vector<TabLayoutSlot>& slots);
+
+    TabLayoutMetrics m_metrics;
+    bool m_laidOut = false;
+    std::vector<TabLayoutEntry> m_entries;
+    std::vector<TabLayoutSlot> m_slots;
+    // m_cursors[i] is the state before entry i, for every entry placed.
+    std::vector<Cursor> m_cursors;
+    Cursor m_end;
+    bool m_truncated = false;
+    TabLayoutUpdate m_update;
+    TabBandLayoutStats m_stats;
+    // Scratch for the range an update lays out again.
+    std::vector<TabLayoutSlot> m_placedSlots;
+    std::vector<Cursor> m_placedCursors;
+};
+
+}  // namespace shelltabs
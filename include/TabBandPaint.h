@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shelltabs {
+
+// 0x00BBGGRR, the COLORREF layout.
+using PaintColor = uint32_t;
+
+constexpr PaintColor MakePaintColor(uint8_t r, uint8_t g, uint8_t b) noexcept {
+    return static_cast<PaintColor>(r) | (static_cast<PaintColor>(g) << 8) | (static_cast<PaintColor>(b) << 16);
+}
+constexpr uint8_t PaintColorRed(PaintColor color) noexcept { return static_cast<uint8_t>(color & 0xFF); }
+constexpr uint8_t PaintColorGreen(PaintColor color) noexcept { return static_cast<uint8_t>((color >> 8) & 0xFF); }
+constexpr uint8_t PaintColorBlue(PaintColor color) noexcept { return static_cast<uint8_t>((color >> 16) & 0xFF); }
+
+// Half-open, like RECT.
+struct PaintRect {
+    int32_t left = 0;
+    int32_t top = 0;
+    int32_t right = 0;
+    int32_t bottom = 0;
+
+    bool Empty() const noexcept { return right <= left || bottom <= top; }
+    int32_t Width() const noexcept { return right - left; }
+    int32_t Height() const noexcept { return bottom - top; }
+};
+
+struct PaintPoint {
+    int32_t x = 0;
+    int32_t y = 0;
+};
+
+enum class PaintLineStyle : uint8_t {
+    kSolid,
+    kDashed,
+    kDotted,
+};
+
+enum class PaintTextAlign : uint8_t {
+    // Left aligned, vertically centred, "..." where it does not fit.
+    kLeftEllipsis,
+    // kLeftEllipsis, but "..." goes before the last path component.
+    kLeftPathEllipsis,
+    kCenter,
+};
+
+enum class TabCloseState : uint8_t {
+    kNormal,
+    kHot,
+    kPressed,
+};
+
+// Where the tab band's pixels go. Coordinates and pixel coverage follow GDI:
+// lines leave out their last pixel, fills leave out the right and bottom
+// edges. The native hooks let a backend draw a part with the system theme;
+// returning false paints the flat version instead.
+class TabBandPainter {
+public:
+    virtual ~TabBandPainter() = default;
+
+    virtual bool DrawNativeBackground(const PaintRect& bounds);
+    // May replace *textColor with the theme's.
+    virtual bool DrawNativeTab(const PaintRect& bounds, bool selected, PaintColor* textColor);
+    virtual bool DrawNativeCloseButton(const PaintRect& bounds, TabCloseState state);
+
+    virtual void FillRect(const PaintRect& rect, PaintColor color) = 0;
+    virtual void FillGradient(const PaintRect& rect, PaintColor start, PaintColor end, bool horizontal) = 0;
+    virtual void FillPolygon(const PaintPoint* points, size_t count, PaintColor color) = 0;
+    // The closed outline of a polygon, one pixel wide.
+    virtual void StrokePolygon(const PaintPoint* points, size_t count, PaintColor color) = 0;
+    virtual void FillEllipse(const PaintRect& bounds, PaintColor color) = 0;
+    virtual void DrawLine(PaintPoint from, PaintPoint to, PaintColor color, int width = 1,
+                          PaintLineStyle style = PaintLineStyle::kSolid) = 0;
+    virtual void DrawString(const PaintRect& bounds, std::wstring_view text, PaintColor color,
+                            PaintTextAlign align) = 0;
+    // icon is the backend's own handle (an HICON for GDI).
+    virtual void DrawIcon(const void* icon, const PaintRect& bounds) = 0;
+};
+
+struct TabProgressVisual {
+    bool visible = false;
+    bool indeterminate = false;
+    double fraction = 0.0;
+    // Drives the indeterminate segment's position.
+    uint64_t tickMs = 0;
+    PaintRect bounds;
+    PaintColor track = 0;
+    PaintColor border = 0;
+    PaintColor fillStart = 0;
+    PaintColor fillEnd = 0;
+};
+
+struct TabCloseVisual {
+    // Empty when the tab has no close button.
+    PaintRect bounds;
+    TabCloseState state = TabCloseState::kNormal;
+    PaintColor background = 0;
+    PaintColor border = 0;
+    PaintColor glyph = 0;
+};
+
+enum class TabVisualKind : uint8_t {
+    kTab,
+    kGroupHeader,
+};
+
+// One tab or group header with every color and rectangle resolved.
+struct TabVisual {
+    TabVisualKind kind = TabVisualKind::kTab;
+    PaintRect bounds;
+    // bounds without the island indicator strip.
+    PaintRect tabBounds;
+    bool selected = false;
+    // A plain outlined rectangle instead of the rounded tab shape.
+    bool highContrast = false;
+    int32_t cornerRadius = 0;
+    PaintColor background = 0;
+    PaintColor border = 0;
+    PaintColor bottomLine = 0;
+    PaintColor text = 0;
+
+    bool hasIndicator = false;
+    PaintRect indicator;
+    PaintColor indicatorColor = 0;
+
+    bool pinned = false;
+    int32_t pinnedGlyphLeft = 0;
+    int32_t pinnedGlyphWidth = 0;
+
+    const void* icon = nullptr;
+    PaintRect iconBounds;
+
+    std::wstring name;
+    // After the pinned glyph, when there is one.
+    int32_t textLeft = 0;
+    int32_t textRight = 0;
+
+    TabProgressVisual progress;
+    TabCloseVisual close;
+};
+
+struct GroupOutlineVisual {
+    // Inclusive of the right and bottom lines, as GroupOutline bounds are.
+    PaintRect bounds;
+    PaintColor color = 0;
+    PaintLineStyle style = PaintLineStyle::kSolid;
+    int thickness = 1;
+};
+
+// Everything TabBandWindow paints, in painting order.
+struct TabBandScene {
+    // The area the background covers.
+    PaintRect surface;
+    // Clips the group outlines and the drop indicator.
+    PaintRect client;
+    // The flat background, used when the painter has no native one.
+    PaintColor backgroundTop = 0;
+    PaintColor backgroundBottom = 0;
+    std::vector<TabVisual> items;
+    std::vector<GroupOutlineVisual> outlines;
+    // -1 for none.
+    int32_t dropIndicatorX = -1;
+    PaintColor dropIndicatorColor = 0;
+    std::vector<PaintRect> emptyIslandPluses;
+    PaintColor plusColor = 0;
+};
+
+void PaintTabVisual(const TabVisual& visual, TabBandPainter& painter);
+// Background, items, group outlines and the drop indicator.
+void PaintTabBandContent(const TabBandScene& scene, TabBandPainter& painter);
+void PaintEmptyIslandPluses(const TabBandScene& scene, TabBandPainter& painter);
+void PaintTabBand(const TabBandScene& scene, TabBandPainter& painter);
+
+}  // namespace shelltabs
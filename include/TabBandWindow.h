@@ -16,6 +16,7 @@
 
 #include <limits>
 #include <memory>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
@@ -29,6 +30,12 @@
 
 #include "OptionsStore.h"
 #include "PreviewOverlay.h"
+#include "PreviewPrefetcher.h"
+#include "TabBandLayout.h"
+#include "TabBandPaint.h"
+#include "TabHitIndex.h"
+#include "TabLayoutDiff.h"
+#include "TabLabelCache.h"
 #include "IconCache.h"
 #include "TabManager.h"
 #include "resource.h"
@@ -117,6 +124,9 @@ private:
         int row = 0;
         size_t reuseSourceIndex = std::numeric_limits<size_t>::max();
         bool reusedIconMetrics = false;
+        // Tab width before wrapping clamped it; reused while the tab and the
+        // font stay the same.
+        int measuredWidth = 0;
     };
 
     struct TabLocationHash {
@@ -133,6 +143,10 @@ private:
         }
     };
 
+    // Paints the tab band model onto an HDC, with uxtheme parts as the
+    // native hooks.
+    class GdiPainter;
+
     struct TabPaintMetrics {
         RECT itemBounds{};
         RECT tabBounds{};
@@ -160,6 +174,8 @@ private:
         int rowCount = 0;
         RECT newTabBounds{};
         bool newTabVisible = false;
+        // The slots and groups the wrapping moved.
+        TabLayoutUpdate update;
     };
 
     struct VisualItemReuseContext {
@@ -171,11 +187,18 @@ private:
     struct LayoutDiffStats {
         size_t inserted = 0;
         size_t removed = 0;
+        // Matched items whose bounds changed, and those that changed places
+        // with their neighbours.
         size_t moved = 0;
+        size_t reordered = 0;
         size_t updated = 0;
         std::vector<RECT> invalidRects;
         std::vector<size_t> removedIndices;
-        std::vector<size_t> matchedOldIndices;
+        // Views into m_layoutDiffer's buffers, valid until the next diff, so
+        // a relayout does not copy them.
+        std::span<const size_t> matchedOldIndices;
+        // Remove, move and insert ops taking the old items to the new order.
+        std::span<const TabLayoutDiffOp> ops;
     };
 
     struct RedrawMetrics {
@@ -196,6 +219,18 @@ private:
         UINT idLast = 0;
     };
 
+    // The hit index cell under the pointer; mouse moves that stay in it
+    // change nothing.
+    struct PointerCell {
+        uint64_t generation = 0;
+        bool inside = false;
+        TabHitCell cell;
+
+        friend bool operator==(const PointerCell& left, const PointerCell& right) noexcept {
+            return left.generation == right.generation && left.inside == right.inside && left.cell == right.cell;
+        }
+    };
+
     struct DragState {
         bool tracking = false;
         bool dragging = false;
@@ -212,6 +247,7 @@ private:
         bool overlayVisible = false;
         RECT indicatorRect{};
         RECT previewRect{};
+        std::optional<PointerCell> dropCell;
     };
 
     struct ExternalDropState {
@@ -347,6 +383,9 @@ private:
     uint32_t m_tabLayoutVersion = 0;
     std::vector<VisualItem> m_items;
     std::vector<RECT> m_progressRects;
+    TabBandLayout m_layout;
+    mutable TabLayoutDiffer m_layoutDiffer;
+    TabLabelFont m_layoutFont;
     std::vector<size_t> m_activeProgressIndices;
     size_t m_activeProgressCount = 0;
     DragState m_drag;
@@ -375,6 +414,7 @@ private:
     ThemePalette m_themePalette;
     int m_toolbarGripWidth = 14;
     size_t m_hotCloseIndex = std::numeric_limits<size_t>::max();
+    std::optional<PointerCell> m_closeHoverCell;
     bool m_mouseTracking = false;
     int m_rebarBandIndex = -1;
     bool m_rebarZOrderTop = false;
@@ -390,6 +430,12 @@ private:
     size_t m_previewItemIndex = std::numeric_limits<size_t>::max();
     bool m_previewVisible = false;
     uint64_t m_previewRequestId = 0;
+    PreviewPrefetchPlanner m_previewPrefetcher;
+    // Preview request behind each prefetched tab, by stable id.
+    std::unordered_map<uint64_t, uint64_t> m_prefetchRequests;
+    // Index into m_items of each tab by stable id, rebuilt with the prefetch
+    // tabs so pointer moves do not scan the band.
+    std::unordered_map<uint64_t, size_t> m_tabIndexByStableId;
     POINT m_previewAnchorPoint{};
     UINT m_shellNotifyMessage = 0;
     ULONG m_shellNotifyId = 0;
@@ -433,15 +479,19 @@ private:
         UINT m_cachedCloseButtonDpi = 0;
 
         mutable CachedGroupOutlines m_groupOutlineCache;
+        mutable TabHitIndex m_hitIndex;
+        mutable bool m_hitIndexValid = false;
         mutable std::unordered_map<COLORREF, BrushHandle> m_brushCache;
         mutable std::unordered_map<PenKey, PenHandle, PenKeyHash> m_penCache;
 
         // Utilities
         // Helpers
         bool FindEmptyIslandPlusAt(POINT pt, int* outGroupIndex) const;
-        void DrawEmptyIslandPluses(HDC dc) const;
         LayoutResult BuildLayoutItems(const std::vector<TabViewItem>& items,
                                       VisualItemReuseContext* reuseContext = nullptr);
+        // Null when source is empty.
+        VisualItemReuseContext* PrepareReuseContext(std::vector<VisualItem>& source,
+                                                    VisualItemReuseContext* context) const;
         LayoutDiffStats ComputeLayoutDiff(std::vector<VisualItem>& oldItems,
                                           std::vector<VisualItem>& newItems) const;
         void ApplyPreservedVisualItems(const std::vector<VisualItem>& preserved,
@@ -455,19 +505,20 @@ private:
 	static LRESULT CALLBACK RebarSubclassProc(HWND, UINT, WPARAM, LPARAM, UINT_PTR, DWORD_PTR);
 
     void Layout(int width, int height);
-    void RebuildLayout();
+    // reuseVisuals keeps the icons and measured widths of unchanged tabs, for
+    // relayouts that change neither the theme nor the DPI.
+    void RebuildLayout(bool reuseVisuals = false);
     void Draw(HDC dc);
     void PaintSurface(HDC dc, const RECT& windowRect) const;
     void DrawBackground(HDC dc, const RECT& bounds) const;
     bool DrawRebarThemePart(HDC dc, const RECT& bounds, int partId, int stateId, bool suppressFallback,
                             const GlowColorSet* overrideColors = nullptr) const;
     GlowColorSet BuildRebarGlowColors(const ThemePalette& palette) const;
+    TabBandScene BuildTabBandScene(const RECT& windowRect) const;
+    TabVisual BuildGroupHeaderVisual(const VisualItem& item) const;
+    TabVisual BuildTabVisual(const VisualItem& item) const;
     void DrawGroupHeader(HDC dc, const VisualItem& item) const;
     void DrawTab(HDC dc, const VisualItem& item) const;
-    void DrawGroupOutlines(HDC dc, const std::vector<GroupOutline>& outlines) const;
-    void DrawTabProgress(HDC dc, const VisualItem& item, const TabPaintMetrics& metrics,
-                         COLORREF background) const;
-    void DrawDropIndicator(HDC dc) const;
     void DrawDragVisual(HDC dc) const;
     void ClearVisualItems();
     void ReleaseBackBuffer();
@@ -482,6 +533,10 @@ private:
     void PositionPreviewWindow(const VisualItem& item, const POINT& screenPt);
     void HandlePreviewReady(uint64_t requestId);
     void CancelPreviewRequest();
+    void SyncPreviewPrefetchTabs();
+    void UpdatePreviewPrefetch(const POINT& pt);
+    void CancelPreviewPrefetch();
+    const VisualItem* FindTabByStableId(uint64_t stableId) const;
     void RefreshProgressState();
     void RefreshProgressState(const std::vector<TabLocation>& prioritizedTabs);
     void RefreshProgressState(const TabProgressUpdatePayload* payload);
@@ -540,6 +595,10 @@ private:
     void HandleExternalDropExecute();
     void RequestSelection(const HitInfo& hit);
     HitInfo HitTest(const POINT& pt) const;
+    // Built from m_items and the close button metrics on first use.
+    const TabHitIndex& EnsureHitIndex() const;
+    void InvalidateHitIndex();
+    PointerCell PointerCellAt(const POINT& pt) const;
     void ShowContextMenu(const POINT& pt);
     void PopulateHiddenTabsMenu(HMENU menu, int groupIndex);
     void PopulateSavedGroupsMenu(HMENU parent, bool addSeparator);
@@ -550,11 +609,17 @@ private:
     const VisualItem* FindVisualForHit(const HitInfo& hit) const;
     size_t FindTabDataIndex(TabLocation location) const;
     size_t FindGroupHeaderIndex(int groupIndex) const;
-    void RebuildTabLocationIndex();
+    // Re-indexes m_tabData from the first tab whose location moved since
+    // previous.
+    void UpdateTabLocationIndex(const std::vector<TabViewItem>& previous);
     TabPaintMetrics ComputeTabPaintMetrics(const VisualItem& item) const;
     bool ComputeProgressBounds(const VisualItem& item, const TabPaintMetrics& metrics, RECT* out) const;
     void EnsureProgressRectCache();
     void RebuildProgressRectCache();
+    // Recomputes the rects of items in groups (sorted) and items without a
+    // previous match; the rest come from previous by the diff's matching.
+    void UpdateProgressRectCache(const std::vector<RECT>& previous, const LayoutDiffStats& diff,
+                                 const std::vector<int>& groups);
     void RecomputeActiveProgressCount();
     void InvalidateProgressForIndices(const std::vector<size_t>& indices);
     void InvalidateActiveProgress();
@@ -567,7 +632,13 @@ private:
     const std::vector<GroupOutline>& BuildGroupOutlines() const;
     void InvalidateGroupOutlineCache();
     void RebuildGroupOutlineCache() const;
-    std::vector<GroupOutline> ComputeGroupOutlines() const;
+    void UpdateGroupOutlineCache(const std::vector<int>& groups) const;
+    // Only the sorted groups when given.
+    std::vector<GroupOutline> ComputeGroupOutlines(const std::vector<int>* groups = nullptr) const;
+    // Groups whose items moved, changed, appeared or went away in a SetTabs.
+    std::vector<int> CollectAffectedGroups(const std::vector<VisualItem>& oldItems,
+                                           const std::vector<VisualItem>& newItems, const LayoutDiffStats& diff,
+                                           const TabLayoutUpdate& update) const;
     bool DropPreviewAffectsIndicators(const DropTarget& target) const;
     void OnDropPreviewTargetChanged(const DropTarget& previous, const DropTarget& current);
     RECT ComputeCloseButtonRect(const VisualItem& item) const;
@@ -592,7 +663,6 @@ private:
     bool IsSystemDarkMode() const;
     void UpdateAccentColor();
     void ResetThemePalette();
-    void DrawPinnedGlyph(HDC dc, const RECT& tabRect, int x, COLORREF color) const;
     void UpdateThemePalette();
     void UpdateToolbarMetrics();
     void HandleDpiChanged(UINT dpiX, UINT dpiY, const RECT* suggestedRect);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "TabBandPaint.h"
+
+namespace shelltabs {
+
+inline constexpr size_t kNoTabHit = std::numeric_limits<size_t>::max();
+
+// One hit-testable VisualItem. closeButton is empty when the item has none.
+struct TabHitEntry {
+    PaintRect bounds;
+    PaintRect closeButton;
+};
+
+// Everything a pointer position resolves to. Two points in the same cell hit
+// the same item, button and half, and insert at the same gap.
+struct TabHitCell {
+    size_t item = kNoTabHit;
+    bool closeButton = false;
+    // Left of the item's midpoint.
+    bool before = false;
+    // The entry an item dropped here goes in front of: the hit item or the one
+    // after it by side, otherwise the next item along the row, or one past the
+    // row's last item. kNoTabHit outside every row.
+    size_t gap = kNoTabHit;
+    // Missed every item but lies between two items of the same row.
+    bool between = false;
+
+    friend bool operator==(const TabHitCell& left, const TabHitCell& right) noexcept {
+        return left.item == right.item && left.closeButton == right.closeButton && left.before == right.before &&
+               left.gap == right.gap && left.between == right.between;
+    }
+};
+
+// Per-row interval index over the tab band's items. Rows are the distinct
+// vertical spans, sorted by top; each keeps its items sorted by left edge, so
+// a point finds its row and then its item by binary search. Containment
+// follows PtInRect, and where items overlap the lowest index wins, matching a
+// front-to-back scan.
+class TabHitIndex {
+public:
+    void Build(const std::vector<TabHitEntry>& entries);
+    void Clear();
+
+    bool Empty() const noexcept { return m_entries.empty(); }
+    size_t RowCount() const noexcept { return m_rows.size(); }
+    // Bumped by every Build and Clear, so a cell remembered with it goes stale
+    // with the layout.
+    uint64_t Generation() const noexcept { return m_generation; }
+
+    size_t ItemAt(int32_t x, int32_t y) const noexcept;
+    // kNoTabHit unless the point is on the item's close button.
+    size_t CloseButtonAt(int32_t x, int32_t y) const noexcept;
+    size_t GapAt(int32_t x, int32_t y) const noexcept { return CellAt(x, y).gap; }
+    TabHitCell CellAt(int32_t x, int32_t y) const noexcept;
+
+private:
+    struct Interval {
+        int32_t left = 0;
+        int32_t right = 0;
+        size_t item = kNoTabHit;
+    };
+
+    struct Row {
+        int32_t top = 0;
+        int32_t bottom = 0;
+        // m_intervals[first, end), sorted by left.
+        size_t first = 0;
+        size_t end = 0;
+        int32_t maxWidth = 0;
+    };
+
+    // The first row, by top, whose span holds y; nullptr when none does.
+    const Row* RowAt(int32_t y) const noexcept;
+    size_t ItemInRow(const Row& row, int32_t x, int32_t y) const noexcept;
+
+    std::vector<TabHitEntry> m_entries;
+    std::vector<Interval> m_intervals;
+    std::vector<Row> m_rows;
+    int32_t m_maxRowHeight = 0;
+    uint64_t m_generation = 0;
+};
+
+}  // namespace shelltabs
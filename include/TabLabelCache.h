@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace shelltabs {
+
+// Everything that changes advance widths: the font as realised and the DPI
+// it was realised at.
+struct TabLabelFont {
+    // HashTabLabelFace of the face name. Two faces can share every metric
+    // below and still differ in their advances.
+    uint64_t faceHash = 0;
+    int32_t height = 0;
+    int32_t aveCharWidth = 0;
+    int32_t weight = 0;
+    uint8_t italic = 0;
+    uint8_t pitchAndFamily = 0;
+    uint8_t charSet = 0;
+    uint32_t dpi = 96;
+
+    friend bool operator==(const TabLabelFont& left, const TabLabelFont& right) noexcept {
+        return left.faceHash == right.faceHash && left.height == right.height &&
+               left.aveCharWidth == right.aveCharWidth && left.weight == right.weight &&
+               left.italic == right.italic && left.pitchAndFamily == right.pitchAndFamily &&
+               left.charSet == right.charSet && left.dpi == right.dpi;
+    }
+};
+
+// Case-insensitive, as GDI matches face names.
+uint64_t HashTabLabelFace(std::wstring_view face) noexcept;
+
+// Measures text in one font. TabBandWindow wraps an HDC; tests use fixed
+// advances.
+class TabTextMeasurer {
+public:
+    virtual ~TabTextMeasurer() = default;
+
+    virtual TabLabelFont Font() const = 0;
+    // extents[i] is the width of text[0..i], as GetTextExtentExPoint reports
+    // it; text.size() values.
+    virtual bool MeasureExtents(std::wstring_view text, int32_t* extents) = 0;
+};
+
+enum class TabLabelEllipsis : uint8_t {
+    // "Long folder na..."
+    kEnd,
+    // "C:\Users\so...\Projects": the last path component stays whole while
+    // it fits, and is cut at its end when it does not.
+    kPath,
+};
+
+inline constexpr std::wstring_view kTabLabelEllipsis = L"...";
+
+// Whether text looks like a path worth TabLabelEllipsis::kPath.
+bool IsPathLabel(std::wstring_view text) noexcept;
+
+// The longest label for text that fits in maxWidth, given text's extents (as
+// MeasureExtents) and the width of kTabLabelEllipsis. Text that fits comes
+// back unchanged; surrogate pairs are never split.
+std::wstring FitTabLabel(std::wstring_view text, const int32_t* extents, int32_t ellipsisWidth, int32_t maxWidth,
+                         TabLabelEllipsis mode);
+
+struct TabLabelCacheStats {
+    size_t labels = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // UTF-16 units passed to MeasureExtents.
+    uint64_t measuredUnits = 0;
+    uint64_t fitHits = 0;
+    uint64_t fitMisses = 0;
+};
+
+// Tab label extents keyed by (font, DPI, text), with the last few ellipsised
+// labels computed from them, so a relayout or repaint only measures names it
+// has not seen in this font. Least recently used labels go first past the
+// capacity. Thread safe; every Explorer window's band shares one.
+class TabLabelCache {
+public:
+    static constexpr size_t kDefaultCapacity = 512;
+    // Fitted widths remembered per label; a label is usually drawn at one or
+    // two widths between resizes.
+    static constexpr size_t kFitsPerLabel = 4;
+
+    explicit TabLabelCache(size_t capacity = kDefaultCapacity);
+
+    TabLabelCache(const TabLabelCache&) = delete;
+    TabLabelCache& operator=(const TabLabelCache&) = delete;
+
+    // Width of the whole text; 0 when it cannot be measured.
+    int32_t Width(TabTextMeasurer& measurer, std::wstring_view text);
+    // FitTabLabel through the cache.
+    std::wstring Fit(TabTextMeasurer& measurer, std::wstring_view text, int32_t maxWidth, TabLabelEllipsis mode);
+
+    void Clear();
+    TabLabelCacheStats Stats() const;
+
+private:
+    struct Fitted {
+        int32_t maxWidth = 0;
+        TabLabelEllipsis mode = TabLabelEllipsis::kEnd;
+        std::wstring label;
+    };
+
+    struct Entry {
+        TabLabelFont font;
+        std::wstring text;
+        size_t hash = 0;
+        std::vector<int32_t> extents;
+        // Most recently used first.
+        std::vector<Fitted> fits;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    EntryList::iterator FindLocked(const TabLabelFont& font, size_t hash, std::wstring_view text);
+    // Returns text's entry with lock held, measuring outside the lock on a
+    // miss; m_entries.end() when text cannot be measured.
+    EntryList::iterator Acquire(TabTextMeasurer& measurer, std::wstring_view text, std::unique_lock<std::mutex>& lock);
+
+    size_t m_capacity = kDefaultCapacity;
+    mutable std::mutex m_mutex;
+    // Most recently used first.
+    EntryList m_entries;
+    std::unordered_multimap<size_t, EntryList::iterator> m_lookup;
+    TabLabelCacheStats m_stats;
+};
+
+TabLabelCache& GetTabLabelCache();
+
+}  // namespace shelltabs
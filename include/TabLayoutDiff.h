@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace shelltabs {
+
+inline constexpr size_t kNoTabLayoutMatch = std::numeric_limits<size_t>::max();
+
+enum class TabLayoutDiffOpKind : uint8_t {
+    kRemove,
+    kMove,
+    kInsert,
+};
+
+// kRemove carries only oldIndex, kInsert only newIndex.
+struct TabLayoutDiffOp {
+    TabLayoutDiffOpKind kind = TabLayoutDiffOpKind::kInsert;
+    size_t oldIndex = kNoTabLayoutMatch;
+    size_t newIndex = kNoTabLayoutMatch;
+
+    friend bool operator==(const TabLayoutDiffOp& left, const TabLayoutDiffOp& right) noexcept {
+        return left.kind == right.kind && left.oldIndex == right.oldIndex && left.newIndex == right.newIndex;
+    }
+};
+
+struct TabLayoutDiffResult {
+    // matchedOld[i] is the old item new item i continues, or kNoTabLayoutMatch.
+    std::vector<size_t> matchedOld;
+    // Removes by ascending old index, then moves and inserts by ascending new
+    // index. Matched items outside the moves keep their relative order.
+    std::vector<TabLayoutDiffOp> ops;
+    size_t inserted = 0;
+    size_t removed = 0;
+    size_t moved = 0;
+};
+
+// Matches old items to new ones by key and works out the fewest moves that
+// turn one order into the other: the matched items in the longest increasing
+// run of old indices stay, the rest move. Old keys go into an open-addressed
+// table of index chains rather than a map of vectors, and every buffer is kept
+// between calls, so a warm differ does not allocate.
+class TabLayoutDiffer {
+public:
+    // hint(newIndex) names a preferred old index, or kNoTabLayoutMatch.
+    // rank(oldIndex, newIndex) orders old items sharing the new item's key,
+    // lower first; 0 ends the search. Ties go to the lowest old index.
+    template <typename OldKey, typename NewKey, typename Hint, typename Rank>
+    const TabLayoutDiffResult& Compute(size_t oldCount, size_t newCount, OldKey&& oldKey, NewKey&& newKey,
+                                       Hint&& hint, Rank&& rank);
+
+    const TabLayoutDiffResult& Result() const noexcept { return m_result; }
+
+private:
+    // Chains m_oldKeys into m_buckets and resets the result for the counts.
+    void Begin(size_t newCount);
+    // Emits the ops once matchedOld is filled in.
+    void Finish();
+    size_t Bucket(uint64_t key) const noexcept;
+
+    TabLayoutDiffResult m_result;
+    std::vector<uint64_t> m_oldKeys;
+    // m_buckets holds the lowest old index per bucket, m_chain the next one
+    // up in the same bucket.
+    std::vector<size_t> m_buckets;
+    std::vector<size_t> m_chain;
+    std::vector<uint8_t> m_consumed;
+    // Longest increasing subsequence scratch.
+    std::vector<size_t> m_tails;
+    std::vector<size_t> m_previous;
+    std::vector<uint8_t> m_stays;
+};
+
+template <typename OldKey, typename NewKey, typename Hint, typename Rank>
+const TabLayoutDiffResult& TabLayoutDiffer::Compute(size_t oldCount, size_t newCount, OldKey&& oldKey,
+                                                    NewKey&& newKey, Hint&& hint, Rank&& rank) {
+    m_oldKeys.clear();
+    for (size_t i = 0; i < oldCount; ++i) {
+        m_oldKeys.push_back(oldKey(i));
+    }
+    Begin(newCount);
+
+    for (size_t newIndex = 0; newIndex < newCount; ++newIndex) {
+        const uint64_t key = newKey(newIndex);
+        size_t selected = kNoTabLayoutMatch;
+        const size_t preferred = hint(newIndex);
+        if (preferred < oldCount && !m_consumed[preferred] && m_oldKeys[preferred] == key) {
+            selected = preferred;
+        } else if (!m_buckets.empty()) {
+            int bestRank = std::numeric_limits<int>::max();
+            for (size_t oldIndex = m_buckets[Bucket(key)]; oldIndex != kNoTabLayoutMatch;
+                 oldIndex = m_chain[oldIndex]) {
+                if (m_oldKeys[oldIndex] != key || m_consumed[oldIndex]) {
+                    continue;
+                }
+                const int candidateRank = rank(oldIndex, newIndex);
+                if (candidateRank < bestRank) {
+                    bestRank = candidateRank;
+                    selected = oldIndex;
+                    if (candidateRank <= 0) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (selected != kNoTabLayoutMatch) {
+            m_consumed[selected] = 1;
+            m_result.matchedOld[newIndex] = selected;
+        }
+    }
+
+    Finish();
+    return m_result;
+}
+
+}  // namespace shelltabs
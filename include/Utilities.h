@@ -63,6 +63,8 @@ std::vector<UniquePidl> GetSelectedItemsPidL(const Microsoft::WRL::ComPtr<IShell
 
 std::wstring Utf8ToWide(std::string_view utf8);
 std::string WideToUtf8(std::wstring_view wide);
+bool ReadFileBytes(const std::wstring& path, std::string* contents, bool* fileExists = nullptr);
+bool WriteFileBytes(const std::wstring& path, std::string_view contents);
 bool ReadUtf8File(const std::wstring& path, std::wstring* contents, bool* fileExists = nullptr);
 bool WriteUtf8File(const std::wstring& path, std::wstring_view contents);
 
@@ -1,18 +1,20 @@
 #include "BackgroundCache.h"
 
+#include "BackgroundImageStore.h"
 #include "Logging.h"
 #include "Utilities.h"
 
 #include <Shlwapi.h>
-#include <objbase.h>
 
 #include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cwctype>
+#include <filesystem>
 #include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
 #include <system_error>
 #include <utility>
@@ -24,12 +26,16 @@ namespace shelltabs {
 namespace {
 
 constexpr auto kUnusedCacheExpiration = std::chrono::hours(24 * 30);
+// Unreferenced images beyond this are evicted oldest first before they expire.
+constexpr uint64_t kUnusedCacheByteBudget = 256ull * 1024 * 1024;
 constexpr auto kCacheMaintenanceThrottle = std::chrono::minutes(5);
 
 std::atomic<ULONGLONG> g_lastCachePurgeTick{0};
 std::atomic<bool> g_cachePurgeInFlight{false};
 std::mutex g_cachePurgeMutex;
 
+thread_local ULONG_PTR t_surfaceWorkerGdiplusToken = 0;
+
 struct CacheMaintenanceTask {
     std::unordered_set<std::wstring> referenced;
     ULONGLONG expirationTicks = 0;
@@ -170,71 +176,65 @@ ULONGLONG ExpirationToTicks(const std::chrono::hours& expiration) {
     return DurationToFileTimeTicks(std::chrono::duration_cast<std::chrono::milliseconds>(expiration));
 }
 
-void PurgeUnusedCacheEntries(const std::unordered_set<std::wstring>& referenced,
-                             ULONGLONG expirationTicks) {
-    std::wstring cacheDirectory = EnsureBackgroundCacheDirectory();
-    if (cacheDirectory.empty()) {
-        return;
-    }
-
-    std::wstring normalizedDirectory = NormalizeAndEnsureTrailingSlash(cacheDirectory);
-    if (normalizedDirectory.empty()) {
-        return;
-    }
-
-    std::wstring searchPattern = normalizedDirectory + L"*";
-
-    WIN32_FIND_DATAW findData{};
-    HANDLE find = FindFirstFileW(searchPattern.c_str(), &findData);
-    if (find == INVALID_HANDLE_VALUE) {
-        return;
+bool IsPathInDirectory(const std::wstring& path, const std::wstring& directory) {
+    if (path.size() < directory.size()) {
+        return false;
     }
+    return _wcsnicmp(path.c_str(), directory.c_str(), directory.size()) == 0;
+}
 
-    FILETIME nowFileTime{};
-    GetSystemTimeAsFileTime(&nowFileTime);
-    ULARGE_INTEGER now{};
-    now.LowPart = nowFileTime.dwLowDateTime;
-    now.HighPart = nowFileTime.dwHighDateTime;
-
-    do {
-        if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-            continue;
-        }
-
-        std::wstring filePath = normalizedDirectory + findData.cFileName;
-        std::wstring key = ToCaseInsensitiveKey(filePath);
-        if (key.empty() || referenced.find(key) != referenced.end()) {
-            continue;
-        }
-
-        ULARGE_INTEGER lastWrite{};
-        lastWrite.LowPart = findData.ftLastWriteTime.dwLowDateTime;
-        lastWrite.HighPart = findData.ftLastWriteTime.dwHighDateTime;
+uint64_t CurrentUnixSeconds() {
+    const auto seconds =
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch());
+    return static_cast<uint64_t>(seconds.count());
+}
 
-        bool expired = expirationTicks == 0;
-        if (!expired && now.QuadPart >= lastWrite.QuadPart) {
-            expired = (now.QuadPart - lastWrite.QuadPart) >= expirationTicks;
+BackgroundImageStore& GetBackgroundImageStore() {
+    static BackgroundImageStore store;
+    static std::once_flag opened;
+    std::call_once(opened, [] {
+        const std::wstring directory = EnsureBackgroundCacheDirectory();
+        if (!directory.empty() && !store.Open(directory, CurrentUnixSeconds())) {
+            LogMessage(LogLevel::Warning, L"Unable to open the background image store in %ls", directory.c_str());
         }
+    });
+    return store;
+}
 
-        if (!expired) {
-            continue;
+// Keeps only the paths that point into the store, so an image elsewhere that
+// happens to share a stored file's name does not pin it.
+std::vector<std::filesystem::path> ToStoreReferences(const std::unordered_set<std::wstring>& referenced,
+                                                     const BackgroundImageStore& store) {
+    const std::wstring directory = NormalizeAndEnsureTrailingSlash(store.Directory().wstring());
+    std::vector<std::filesystem::path> paths;
+    paths.reserve(referenced.size());
+    for (const auto& path : referenced) {
+        if (!directory.empty() && IsPathInDirectory(path, directory)) {
+            paths.emplace_back(path);
         }
+    }
+    return paths;
+}
 
-        if (DeleteFileW(filePath.c_str())) {
-            LogMessage(LogLevel::Info, L"Removed stale cached background image %ls", filePath.c_str());
-        } else {
-            LogLastError(L"DeleteFileW(background cache purge)", GetLastError());
-        }
-    } while (FindNextFileW(find, &findData));
+void PurgeUnusedCacheEntries(const std::unordered_set<std::wstring>& referenced,
+                             ULONGLONG expirationTicks) {
+    BackgroundImageStore& store = GetBackgroundImageStore();
+    if (!store.IsOpen()) {
+        return;
+    }
 
-    FindClose(find);
-}
+    const uint64_t now = CurrentUnixSeconds();
+    store.SetReferences(ToStoreReferences(referenced, store), now);
 
-bool IsPathInDirectory(const std::wstring& path, const std::wstring& directory) {
-    if (path.size() < directory.size()) {
-        return false;
+    // FILETIME ticks are 100ns; zero removes every unreferenced image in both.
+    const BackgroundImageRemoval removal =
+        store.RemoveUnreferenced(now, expirationTicks / 10'000'000ULL, kUnusedCacheByteBudget);
+    for (const auto& path : removal.removed) {
+        LogMessage(LogLevel::Info, L"Removed stale cached background image %ls", path.c_str());
+    }
+    for (const auto& [path, error] : removal.failures) {
+        LogLastError(L"DeleteFileW(background cache purge)", static_cast<DWORD>(error.value()));
     }
-    return _wcsnicmp(path.c_str(), directory.c_str(), directory.size()) == 0;
 }
 
 }  // namespace
@@ -301,47 +301,25 @@ bool CopyImageToBackgroundCache(const std::wstring& sourcePath,
     bool copiedIntoCache = false;
 
     if (!IsPathInDirectory(targetPath, normalizedCacheDirectory)) {
-        GUID guid{};
-        if (FAILED(CoCreateGuid(&guid))) {
-            if (errorMessage) {
-                *errorMessage = L"Unable to create a cache identifier for the image.";
-            }
-            return false;
-        }
-
-        wchar_t guidBuffer[64];
-        if (StringFromGUID2(guid, guidBuffer, ARRAYSIZE(guidBuffer)) <= 0) {
+        BackgroundImageStore& store = GetBackgroundImageStore();
+        std::error_code importError;
+        const auto imported = store.Import(normalizedSource, CurrentUnixSeconds(), &importError);
+        if (!imported) {
+            const DWORD error = importError.category() == std::system_category()
+                                    ? static_cast<DWORD>(importError.value())
+                                    : static_cast<DWORD>(ERROR_PATH_NOT_FOUND);
             if (errorMessage) {
-                *errorMessage = L"Unable to create a cache filename for the image.";
+                *errorMessage = FormatSystemErrorMessage(error);
             }
+            LogLastError(L"BackgroundImageStore::Import", error);
             return false;
         }
 
-        std::wstring fileName(guidBuffer);
-        fileName.erase(std::remove(fileName.begin(), fileName.end(), L'{'), fileName.end());
-        fileName.erase(std::remove(fileName.begin(), fileName.end(), L'}'), fileName.end());
-        fileName.erase(std::remove(fileName.begin(), fileName.end(), L'-'), fileName.end());
-
-        const wchar_t* extension = PathFindExtensionW(normalizedSource.c_str());
-        std::wstring ext = (extension && *extension) ? extension : L".img";
-
-        if (normalizedCacheDirectory.back() != L'\\') {
-            normalizedCacheDirectory.push_back(L'\\');
-        }
-        targetPath = normalizedCacheDirectory + fileName + ext;
-
-        if (!CopyFileW(normalizedSource.c_str(), targetPath.c_str(), FALSE)) {
-            DWORD copyError = GetLastError();
-            DeleteFileW(targetPath.c_str());
-            if (errorMessage) {
-                *errorMessage = FormatSystemErrorMessage(copyError);
-            }
-            LogLastError(L"CopyFileW(background cache)", copyError);
-            return false;
-        }
-
-        copiedIntoCache = true;
-        if (createdPath) {
+        targetPath = imported->path.wstring();
+        // An image with the same content may already back other folders;
+        // only a fresh copy is reported so callers never delete a shared file.
+        copiedIntoCache = imported->created;
+        if (createdPath && copiedIntoCache) {
             *createdPath = targetPath;
         }
     }
@@ -385,22 +363,71 @@ std::unique_ptr<Gdiplus::Bitmap> LoadBackgroundBitmap(const std::wstring& path)
     return bitmap;
 }
 
+std::optional<BackgroundPixels> DecodeBackgroundPixels(const std::wstring& path) {
+    auto bitmap = LoadBackgroundBitmap(path);
+    if (!bitmap) {
+        return std::nullopt;
+    }
+
+    const UINT width = bitmap->GetWidth();
+    const UINT height = bitmap->GetHeight();
+    if (width == 0 || height == 0) {
+        return std::nullopt;
+    }
+
+    BackgroundPixels pixels;
+    pixels.width = width;
+    pixels.height = height;
+    pixels.bgra.resize(static_cast<size_t>(width) * height);
+
+    // Let GDI+ convert straight into our buffer instead of an intermediate copy.
+    Gdiplus::BitmapData data{};
+    data.Width = width;
+    data.Height = height;
+    data.Stride = static_cast<INT>(width * sizeof(uint32_t));
+    data.PixelFormat = PixelFormat32bppPARGB;
+    data.Scan0 = pixels.bgra.data();
+    Gdiplus::Rect rect(0, 0, static_cast<INT>(width), static_cast<INT>(height));
+    if (bitmap->LockBits(&rect, Gdiplus::ImageLockModeRead | Gdiplus::ImageLockModeUserInputBuf,
+                         PixelFormat32bppPARGB, &data) != Gdiplus::Ok) {
+        return std::nullopt;
+    }
+    bitmap->UnlockBits(&data);
+    return pixels;
+}
+
+BackgroundSurfaceCache& GetBackgroundSurfaceCache() {
+    static BackgroundSurfaceCache cache(&DecodeBackgroundPixels, [] {
+        PreviewWorkQueueOptions options;
+        options.workers = 1;
+        // Explorer windows start and stop GDI+ on their own threads, so the
+        // worker holds a reference of its own while it decodes.
+        options.threadStart = [] {
+            Gdiplus::GdiplusStartupInput input;
+            if (Gdiplus::GdiplusStartup(&t_surfaceWorkerGdiplusToken, &input, nullptr) != Gdiplus::Ok) {
+                t_surfaceWorkerGdiplusToken = 0;
+            }
+        };
+        options.threadStop = [] {
+            if (t_surfaceWorkerGdiplusToken != 0) {
+                Gdiplus::GdiplusShutdown(t_surfaceWorkerGdiplusToken);
+                t_surfaceWorkerGdiplusToken = 0;
+            }
+        };
+        return options;
+    }());
+    return cache;
+}
+
 void TouchCachedImage(const std::wstring& path) noexcept {
     if (path.empty()) {
         return;
     }
 
-    HANDLE file = CreateFileW(path.c_str(), FILE_WRITE_ATTRIBUTES,
-                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
-                              FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (file == INVALID_HANDLE_VALUE) {
-        return;
+    try {
+        GetBackgroundImageStore().Touch(path, CurrentUnixSeconds());
+    } catch (...) {
     }
-
-    FILETIME now{};
-    GetSystemTimeAsFileTime(&now);
-    SetFileTime(file, nullptr, &now, &now);
-    CloseHandle(file);
 }
 
 std::vector<std::wstring> CollectCachedImageReferences(const ShellTabsOptions& options) {
@@ -454,45 +481,27 @@ CacheMaintenanceResult RemoveOrphanedCacheEntries(const ShellTabsOptions& option
         }
     }
 
-    std::wstring cacheDirectory = EnsureBackgroundCacheDirectory();
-    if (cacheDirectory.empty()) {
+    BackgroundImageStore& store = GetBackgroundImageStore();
+    if (!store.IsOpen()) {
         return result;
     }
 
-    std::wstring normalizedDirectory = NormalizeAndEnsureTrailingSlash(cacheDirectory);
-    if (normalizedDirectory.empty()) {
-        return result;
-    }
-
-    std::wstring searchPattern = normalizedDirectory + L"*";
-    WIN32_FIND_DATAW findData{};
-    HANDLE find = FindFirstFileW(searchPattern.c_str(), &findData);
-    if (find == INVALID_HANDLE_VALUE) {
-        return result;
+    // An explicit cleanup also picks up files added or deleted behind the
+    // manifest; routine maintenance trusts it.
+    std::lock_guard<std::mutex> lock(g_cachePurgeMutex);
+    store.Rescan(CurrentUnixSeconds());
+    store.SetReferences(ToStoreReferences(referencedKeys, store), CurrentUnixSeconds());
+    const BackgroundImageRemoval removal = store.RemoveUnreferenced(CurrentUnixSeconds(), 0);
+    for (const auto& path : removal.removed) {
+        result.removedPaths.push_back(path.wstring());
+    }
+    for (const auto& [path, error] : removal.failures) {
+        CacheMaintenanceFailure failure;
+        failure.path = path.wstring();
+        failure.error = static_cast<DWORD>(error.value());
+        failure.message = FormatSystemErrorMessage(failure.error);
+        result.failures.push_back(std::move(failure));
     }
-
-    do {
-        if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-            continue;
-        }
-        std::wstring filePath = normalizedDirectory + findData.cFileName;
-        std::wstring key = ToCaseInsensitiveKey(filePath);
-        if (key.empty() || referencedKeys.find(key) != referencedKeys.end()) {
-            continue;
-        }
-
-        if (DeleteFileW(filePath.c_str())) {
-            result.removedPaths.push_back(filePath);
-        } else {
-            CacheMaintenanceFailure failure;
-            failure.path = filePath;
-            failure.error = GetLastError();
-            failure.message = FormatSystemErrorMessage(failure.error);
-            result.failures.push_back(std::move(failure));
-        }
-    } while (FindNextFileW(find, &findData));
-
-    FindClose(find);
     return result;
 }
 
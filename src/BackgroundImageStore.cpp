@@ -0,0 +1,633 @@
+#include "BackgroundImageStore.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cwctype>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace shelltabs {
+namespace {
+
+constexpr char kManifestHeader[] = "shelltabs-background-manifest 1";
+constexpr wchar_t kManifestFileName[] = L"backgrounds.manifest";
+constexpr wchar_t kLockFileName[] = L"backgrounds.lock";
+constexpr wchar_t kTempSuffix[] = L".tmp";
+constexpr size_t kHashChunkBytes = 1u << 20;
+
+bool HashFile(const std::filesystem::path& path, ContentDigest* digest, uint64_t* bytes, std::error_code& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = std::make_error_code(std::errc::no_such_file_or_directory);
+        return false;
+    }
+
+    ContentHasher hasher;
+    std::vector<char> buffer(kHashChunkBytes);
+    while (file) {
+        file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        const std::streamsize read = file.gcount();
+        if (read > 0) {
+            hasher.Update(buffer.data(), static_cast<size_t>(read));
+        }
+    }
+    if (file.bad()) {
+        error = std::make_error_code(std::errc::io_error);
+        return false;
+    }
+
+    *digest = hasher.Finish();
+    *bytes = hasher.BytesHashed();
+    return true;
+}
+
+uint64_t LastWriteSeconds(const std::filesystem::path& path, uint64_t fallback) {
+    std::error_code error;
+    const auto written = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return fallback;
+    }
+    // file_time_type's epoch differs between standard libraries; rebase it
+    // on the system clock through the current time of both clocks.
+    const auto system = std::chrono::system_clock::now() +
+                        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                            written - std::filesystem::file_time_type::clock::now());
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(system.time_since_epoch()).count();
+    return seconds > 0 ? static_cast<uint64_t>(seconds) : 0;
+}
+
+std::string ToUtf8(const std::filesystem::path& path) {
+    const std::u8string text = path.u8string();
+    return std::string(reinterpret_cast<const char*>(text.data()), text.size());
+}
+
+std::filesystem::path FromUtf8(const std::string& text) {
+    return std::filesystem::path(std::u8string(reinterpret_cast<const char8_t*>(text.data()), text.size()));
+}
+
+bool IsStoreBookkeeping(const std::filesystem::path& fileName) {
+    const std::wstring name = fileName.wstring();
+    const std::wstring suffix(kTempSuffix);
+    return name == kManifestFileName || name == kLockFileName ||
+           (name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0);
+}
+
+// Exclusive lock on a file beside the manifest, held while one Explorer
+// process merges and rewrites the manifest so another cannot do the same in
+// between. Without the lock file the store still works, just unguarded.
+class ManifestLock {
+public:
+    explicit ManifestLock(const std::filesystem::path& path) {
+#if defined(_WIN32)
+        m_file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+        OVERLAPPED overlapped{};
+        if (m_file != INVALID_HANDLE_VALUE &&
+            !LockFileEx(m_file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (m_fd >= 0 && flock(m_fd, LOCK_EX) != 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+#endif
+    }
+    ~ManifestLock() {
+#if defined(_WIN32)
+        if (m_file != INVALID_HANDLE_VALUE) {
+            OVERLAPPED overlapped{};
+            UnlockFileEx(m_file, 0, MAXDWORD, MAXDWORD, &overlapped);
+            CloseHandle(m_file);
+        }
+#else
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+#endif
+    }
+
+    ManifestLock(const ManifestLock&) = delete;
+    ManifestLock& operator=(const ManifestLock&) = delete;
+
+private:
+#if defined(_WIN32)
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+#else
+    int m_fd = -1;
+#endif
+};
+
+enum class ManifestRead {
+    kMissing,
+    kClean,
+    // Readable, but some lines were skipped or repeated a file.
+    kDamaged,
+};
+
+ManifestRead ReadManifest(const std::filesystem::path& path, std::vector<BackgroundImageRecord>* records) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return ManifestRead::kMissing;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != kManifestHeader) {
+        return ManifestRead::kDamaged;
+    }
+
+    bool clean = true;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string digestText;
+        BackgroundImageRecord record;
+        std::string fileName;
+        if (!(fields >> digestText >> record.bytes >> record.lastUse >> record.references) || fields.get() != ' ' ||
+            !std::getline(fields, fileName) || fileName.empty()) {
+            clean = false;
+            continue;
+        }
+        const auto digest = ParseContentDigest(std::wstring(digestText.begin(), digestText.end()));
+        if (!digest) {
+            clean = false;
+            continue;
+        }
+        record.digest = *digest;
+        record.fileName = FromUtf8(fileName);
+        records->push_back(std::move(record));
+    }
+    return clean ? ManifestRead::kClean : ManifestRead::kDamaged;
+}
+
+std::optional<std::pair<std::filesystem::file_time_type, uintmax_t>> QueryManifestStamp(
+    const std::filesystem::path& path) {
+    std::error_code error;
+    const auto written = std::filesystem::last_write_time(path, error);
+    const auto size = error ? 0 : std::filesystem::file_size(path, error);
+    if (error) {
+        return std::nullopt;
+    }
+    return std::make_pair(written, size);
+}
+
+}  // namespace
+
+bool BackgroundImageStore::Open(const std::filesystem::path& directory, uint64_t now) {
+    std::scoped_lock lock(m_mutex);
+    m_open = false;
+    m_records.clear();
+    m_byDigest.clear();
+    m_idle.clear();
+    m_referenced.clear();
+    m_totalBytes = 0;
+    m_manifestStamp.reset();
+    m_directory = directory;
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (!std::filesystem::is_directory(m_directory, error)) {
+        return false;
+    }
+
+    // A readable manifest naming exactly the files in the directory is
+    // trusted as is; a missing or damaged one, or one that another process
+    // or a crash left out of step with the directory, costs a scan, after
+    // which it is rewritten.
+    const bool loaded = LoadManifestLocked() && ManifestMatchesDirectoryLocked();
+    if (!loaded) {
+        RescanLocked(now);
+    }
+    m_open = true;
+    if (!loaded) {
+        SaveManifestLocked();
+    }
+    return true;
+}
+
+bool BackgroundImageStore::IsOpen() const {
+    std::scoped_lock lock(m_mutex);
+    return m_open;
+}
+
+std::filesystem::path BackgroundImageStore::Directory() const {
+    std::scoped_lock lock(m_mutex);
+    return m_directory;
+}
+
+void BackgroundImageStore::Rescan(uint64_t now) {
+    std::scoped_lock lock(m_mutex);
+    if (m_open && RescanLocked(now)) {
+        SaveManifestLocked();
+    }
+}
+
+std::optional<BackgroundImageImport> BackgroundImageStore::Import(const std::filesystem::path& source, uint64_t now,
+                                                                  std::error_code* error) {
+    std::error_code localError;
+    std::error_code& status = error ? *error : localError;
+    status.clear();
+
+    if (!IsOpen()) {
+        status = std::make_error_code(std::errc::not_connected);
+        return std::nullopt;
+    }
+
+    // Hash outside the lock; large images take a while to read.
+    ContentDigest digest;
+    uint64_t bytes = 0;
+    if (!HashFile(source, &digest, &bytes, status)) {
+        return std::nullopt;
+    }
+
+    std::scoped_lock lock(m_mutex);
+    std::vector<std::wstring> candidates;
+    for (auto [it, end] = m_byDigest.equal_range(digest); it != end; ++it) {
+        candidates.push_back(it->second);
+    }
+    for (const std::wstring& key : candidates) {
+        const BackgroundImageRecord& record = m_records.at(key);
+        std::error_code ignored;
+        if (record.bytes != bytes) {
+            continue;
+        }
+        if (!std::filesystem::is_regular_file(m_directory / record.fileName, ignored)) {
+            // Deleted behind the manifest's back.
+            EraseLocked(key);
+            continue;
+        }
+        const std::filesystem::path path = m_directory / record.fileName;
+        if (UpdateUsageLocked(key, std::max(record.lastUse, now), record.references)) {
+            SaveManifestLocked();
+        }
+        return BackgroundImageImport{path, false};
+    }
+
+    std::wstring extension = source.extension().wstring();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(ch)); });
+    if (extension.empty()) {
+        extension = L".img";
+    }
+
+    const std::filesystem::path fileName = FormatContentDigest(digest) + extension;
+    const std::filesystem::path target = m_directory / fileName;
+    std::filesystem::path temp = target;
+    temp += kTempSuffix;
+
+    // Copy beside the target and rename so a partial copy never carries the
+    // content name.
+    std::error_code ignored;
+    if (!std::filesystem::copy_file(source, temp, std::filesystem::copy_options::overwrite_existing, status)) {
+        std::filesystem::remove(temp, ignored);
+        return std::nullopt;
+    }
+    std::filesystem::rename(temp, target, status);
+    if (status) {
+        std::filesystem::remove(temp, ignored);
+        return std::nullopt;
+    }
+
+    BackgroundImageRecord record;
+    record.digest = digest;
+    record.fileName = fileName;
+    record.bytes = bytes;
+    record.lastUse = now;
+    InsertLocked(std::move(record));
+    SaveManifestLocked();
+    return BackgroundImageImport{target, true};
+}
+
+bool BackgroundImageStore::Touch(const std::filesystem::path& path, uint64_t now) {
+    std::scoped_lock lock(m_mutex);
+    const std::wstring key = KeyFor(path);
+    auto it = m_records.find(key);
+    if (it == m_records.end()) {
+        return false;
+    }
+    if (now >= it->second.lastUse + kTouchResolutionSeconds) {
+        UpdateUsageLocked(key, now, it->second.references);
+        SaveManifestLocked();
+    }
+    return true;
+}
+
+void BackgroundImageStore::SetReferences(const std::vector<std::filesystem::path>& paths, uint64_t now) {
+    std::scoped_lock lock(m_mutex);
+    std::unordered_map<std::wstring, uint32_t> counts;
+    for (const auto& path : paths) {
+        ++counts[KeyFor(path)];
+    }
+
+    // Only images referenced before or now can change, so this never walks
+    // the whole store.
+    std::vector<std::wstring> released;
+    for (const std::wstring& key : m_referenced) {
+        if (counts.find(key) == counts.end()) {
+            released.push_back(key);
+        }
+    }
+
+    bool changed = false;
+    for (const std::wstring& key : released) {
+        changed = UpdateUsageLocked(key, m_records.at(key).lastUse, 0) || changed;
+    }
+    for (const auto& [key, references] : counts) {
+        auto it = m_records.find(key);
+        if (it == m_records.end()) {
+            continue;
+        }
+        const uint64_t lastUse =
+            now >= it->second.lastUse + kTouchResolutionSeconds ? now : it->second.lastUse;
+        changed = UpdateUsageLocked(key, lastUse, references) || changed;
+    }
+    if (changed) {
+        SaveManifestLocked();
+    }
+}
+
+BackgroundImageRemoval BackgroundImageStore::RemoveUnreferenced(uint64_t now, uint64_t maxIdleSeconds,
+                                                                uint64_t maxTotalBytes) {
+    std::scoped_lock lock(m_mutex);
+    BackgroundImageRemoval result;
+
+    // m_idle is ordered by last use, so the walk stops at the first image
+    // that is neither expired nor needed to get under the byte cap.
+    std::vector<std::wstring> victims;
+    uint64_t remainingBytes = m_totalBytes;
+    for (const auto& [lastUse, key] : m_idle) {
+        const uint64_t idle = now > lastUse ? now - lastUse : 0;
+        const bool expired = maxIdleSeconds == 0 || idle >= maxIdleSeconds;
+        if (!expired && remainingBytes <= maxTotalBytes) {
+            break;
+        }
+        victims.push_back(key);
+        remainingBytes -= m_records.at(key).bytes;
+    }
+
+    for (const std::wstring& key : victims) {
+        const std::filesystem::path path = m_directory / m_records.at(key).fileName;
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        if (error) {
+            result.failures.emplace_back(path, error);
+            continue;
+        }
+        EraseLocked(key);
+        result.removed.push_back(path);
+    }
+
+    if (!result.removed.empty()) {
+        SaveManifestLocked();
+    }
+    return result;
+}
+
+std::optional<BackgroundImageRecord> BackgroundImageStore::Find(const std::filesystem::path& path) const {
+    std::scoped_lock lock(m_mutex);
+    auto it = m_records.find(KeyFor(path));
+    if (it == m_records.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::vector<BackgroundImageRecord> BackgroundImageStore::Records() const {
+    std::scoped_lock lock(m_mutex);
+    std::vector<BackgroundImageRecord> records;
+    records.reserve(m_records.size());
+    for (const auto& entry : m_records) {
+        records.push_back(entry.second);
+    }
+    return records;
+}
+
+uint64_t BackgroundImageStore::TotalBytes() const {
+    std::scoped_lock lock(m_mutex);
+    return m_totalBytes;
+}
+
+std::wstring BackgroundImageStore::KeyFor(const std::filesystem::path& path) {
+    std::wstring key = path.filename().wstring();
+    std::transform(key.begin(), key.end(), key.begin(),
+                   [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(ch)); });
+    return key;
+}
+
+bool BackgroundImageStore::LoadManifestLocked() {
+    const std::filesystem::path path = m_directory / kManifestFileName;
+    // Stamped before reading, so a write racing the read forces a merge.
+    m_manifestStamp = QueryManifestStamp(path);
+    std::vector<BackgroundImageRecord> records;
+    bool clean = ReadManifest(path, &records) == ManifestRead::kClean;
+    for (BackgroundImageRecord& record : records) {
+        if (m_records.count(KeyFor(record.fileName)) != 0) {
+            clean = false;
+        }
+        InsertLocked(std::move(record));
+    }
+    return clean;
+}
+
+bool BackgroundImageStore::ManifestMatchesDirectoryLocked() const {
+    // Names only; nothing is hashed or stat'ed beyond what the listing holds.
+    size_t files = 0;
+    std::error_code error;
+    for (std::filesystem::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error)) {
+        std::error_code statusError;
+        if (!it->is_regular_file(statusError)) {
+            continue;
+        }
+        const std::filesystem::path fileName = it->path().filename();
+        if (IsStoreBookkeeping(fileName)) {
+            continue;
+        }
+        if (m_records.count(KeyFor(fileName)) == 0) {
+            return false;
+        }
+        ++files;
+    }
+    return !error && files == m_records.size();
+}
+
+void BackgroundImageStore::MergeManifestLocked() {
+    const std::filesystem::path path = m_directory / kManifestFileName;
+    const auto stamp = QueryManifestStamp(path);
+    if (stamp && stamp == m_manifestStamp) {
+        // Nobody has written the manifest since we last read or wrote it.
+        return;
+    }
+
+    std::vector<BackgroundImageRecord> onDisk;
+    const bool readable = ReadManifest(path, &onDisk) != ManifestRead::kMissing;
+
+    std::error_code error;
+    std::unordered_set<std::wstring> seen;
+    for (BackgroundImageRecord& record : onDisk) {
+        const std::wstring key = KeyFor(record.fileName);
+        seen.insert(key);
+        auto it = m_records.find(key);
+        if (it != m_records.end()) {
+            // References come from the shared options, so ours are as good as
+            // anyone's; the latest use wins.
+            if (record.lastUse > it->second.lastUse) {
+                UpdateUsageLocked(key, record.lastUse, it->second.references);
+            }
+        } else if (std::filesystem::is_regular_file(m_directory / record.fileName, error)) {
+            // Imported by another process since we last looked.
+            InsertLocked(std::move(record));
+        }
+    }
+    if (!readable) {
+        return;
+    }
+
+    // Records the other writer dropped are gone for good once their file is.
+    std::vector<std::wstring> removed;
+    for (const auto& [key, record] : m_records) {
+        if (seen.count(key) == 0 && !std::filesystem::is_regular_file(m_directory / record.fileName, error)) {
+            removed.push_back(key);
+        }
+    }
+    for (const std::wstring& key : removed) {
+        EraseLocked(key);
+    }
+}
+
+bool BackgroundImageStore::SaveManifestLocked() {
+    // Other Explorer processes write the same manifest; fold in what they
+    // recorded so the last writer does not drop their images.
+    ManifestLock lock(m_directory / kLockFileName);
+    MergeManifestLocked();
+
+    std::ostringstream text;
+    text << kManifestHeader << '\n';
+    for (const auto& entry : m_records) {
+        const BackgroundImageRecord& record = entry.second;
+        const std::wstring digest = FormatContentDigest(record.digest);
+        text << std::string(digest.begin(), digest.end()) << ' ' << record.bytes << ' ' << record.lastUse << ' '
+             << record.references << ' ' << ToUtf8(record.fileName) << '\n';
+    }
+
+    const std::filesystem::path path = m_directory / kManifestFileName;
+    std::filesystem::path temp = path;
+    temp += kTempSuffix;
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        const std::string bytes = text.str();
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!file) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    if (error) {
+        std::filesystem::remove(temp, error);
+        return false;
+    }
+    m_manifestStamp = QueryManifestStamp(path);
+    return true;
+}
+
+bool BackgroundImageStore::RescanLocked(uint64_t now) {
+    bool changed = false;
+    std::error_code error;
+    std::vector<std::wstring> missing;
+    for (const auto& [key, record] : m_records) {
+        if (!std::filesystem::is_regular_file(m_directory / record.fileName, error)) {
+            missing.push_back(key);
+        }
+    }
+    for (const std::wstring& key : missing) {
+        EraseLocked(key);
+        changed = true;
+    }
+
+    for (std::filesystem::directory_iterator it(m_directory, error), end; !error && it != end; it.increment(error)) {
+        std::error_code statusError;
+        if (!it->is_regular_file(statusError)) {
+            continue;
+        }
+        const std::filesystem::path fileName = it->path().filename();
+        if (IsStoreBookkeeping(fileName) || m_records.count(KeyFor(fileName)) != 0) {
+            continue;
+        }
+
+        BackgroundImageRecord record;
+        std::error_code hashError;
+        if (!HashFile(it->path(), &record.digest, &record.bytes, hashError)) {
+            continue;
+        }
+        record.fileName = fileName;
+        record.lastUse = LastWriteSeconds(it->path(), now);
+        InsertLocked(std::move(record));
+        changed = true;
+    }
+    return changed;
+}
+
+void BackgroundImageStore::InsertLocked(BackgroundImageRecord record) {
+    const std::wstring key = KeyFor(record.fileName);
+    EraseLocked(key);
+    m_byDigest.emplace(record.digest, key);
+    if (record.references == 0) {
+        m_idle.emplace(record.lastUse, key);
+    } else {
+        m_referenced.insert(key);
+    }
+    m_totalBytes += record.bytes;
+    m_records.emplace(key, std::move(record));
+}
+
+void BackgroundImageStore::EraseLocked(const std::wstring& key) {
+    auto it = m_records.find(key);
+    if (it == m_records.end()) {
+        return;
+    }
+    const BackgroundImageRecord& record = it->second;
+    for (auto [digest, end] = m_byDigest.equal_range(record.digest); digest != end; ++digest) {
+        if (digest->second == key) {
+            m_byDigest.erase(digest);
+            break;
+        }
+    }
+    m_idle.erase({record.lastUse, key});
+    m_referenced.erase(key);
+    m_totalBytes -= record.bytes;
+    m_records.erase(it);
+}
+
+bool BackgroundImageStore::UpdateUsageLocked(const std::wstring& key, uint64_t lastUse, uint32_t references) {
+    BackgroundImageRecord& record = m_records.at(key);
+    if (record.lastUse == lastUse && record.references == references) {
+        return false;
+    }
+    if (record.references == 0) {
+        m_idle.erase({record.lastUse, key});
+    } else {
+        m_referenced.erase(key);
+    }
+    record.lastUse = lastUse;
+    record.references = references;
+    if (references == 0) {
+        m_idle.emplace(lastUse, key);
+    } else {
+        m_referenced.insert(key);
+    }
+    return true;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,267 @@
+#include "BackgroundSurfaceCache.h"
+
+#include "PreviewScaler.h"
+
+#include <utility>
+
+namespace shelltabs {
+namespace {
+
+size_t CombineHash(size_t seed, size_t value) noexcept {
+    return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+}
+
+bool IsValid(const BackgroundPixels& pixels) noexcept {
+    return pixels.width > 0 && pixels.height > 0 &&
+           pixels.bgra.size() == static_cast<size_t>(pixels.width) * pixels.height;
+}
+
+}  // namespace
+
+size_t BackgroundSurfaceKeyHasher::operator()(const BackgroundSurfaceKey& key) const noexcept {
+    size_t hash = std::hash<std::wstring>{}(key.imagePath);
+    hash = CombineHash(hash, key.width);
+    hash = CombineHash(hash, key.height);
+    return CombineHash(hash, key.dpi);
+}
+
+BackgroundSurfaceCache::BackgroundSurfaceCache(Decoder decoder, PreviewWorkQueueOptions workerOptions,
+                                               size_t budgetBytes)
+    : m_decoder(std::move(decoder)), m_budgetBytes(budgetBytes), m_workQueue(std::move(workerOptions)) {}
+
+BackgroundSurfaceCache::~BackgroundSurfaceCache() { m_workQueue.Shutdown(); }
+
+BackgroundSurfaceKey BackgroundSurfaceCache::SourceKey(const std::wstring& imagePath) {
+    BackgroundSurfaceKey key;
+    key.imagePath = imagePath;
+    key.dpi = 0;
+    return key;
+}
+
+BackgroundSurfaceCache::Surface BackgroundSurfaceCache::Acquire(const BackgroundSurfaceKey& key,
+                                                                ReadyCallback onReady, bool* queued) {
+    if (queued) {
+        *queued = false;
+    }
+    if (key.imagePath.empty() || key.width == 0 || key.height == 0) {
+        return nullptr;
+    }
+
+    uint64_t generation = 0;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (Surface surface = FindLocked(key)) {
+            ++m_stats.hits;
+            return surface;
+        }
+        ++m_stats.misses;
+        if (m_failedImages.count(key.imagePath) != 0) {
+            return nullptr;
+        }
+
+        auto [pending, inserted] = m_pending.try_emplace(key);
+        if (onReady) {
+            pending->second.push_back(std::move(onReady));
+        }
+        if (queued) {
+            *queued = true;
+        }
+        if (!inserted) {
+            return nullptr;
+        }
+        generation = m_generation;
+    }
+
+    const uint64_t id = m_workQueue.Submit(PreviewPriority::kInteractive,
+                                           [this, key, generation]() { Build(key, generation); });
+    if (id == 0) {
+        std::scoped_lock lock(m_mutex);
+        m_pending.erase(key);
+        if (queued) {
+            *queued = false;
+        }
+    }
+    return nullptr;
+}
+
+BackgroundSurfaceCache::Surface BackgroundSurfaceCache::Find(const BackgroundSurfaceKey& key) {
+    std::scoped_lock lock(m_mutex);
+    return FindLocked(key);
+}
+
+std::wstring BackgroundSurfaceCache::ResolveImagePath(const std::wstring& imagePath,
+                                                      const std::wstring& fallbackPath) const {
+    std::scoped_lock lock(m_mutex);
+    return m_failedImages.count(imagePath) != 0 ? fallbackPath : imagePath;
+}
+
+void BackgroundSurfaceCache::Invalidate(const std::wstring& imagePath) {
+    std::scoped_lock lock(m_mutex);
+    ++m_generation;
+    m_failedImages.erase(imagePath);
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        auto next = std::next(it);
+        if (it->first.imagePath == imagePath) {
+            EraseLocked(it);
+        }
+        it = next;
+    }
+}
+
+void BackgroundSurfaceCache::Clear() {
+    std::scoped_lock lock(m_mutex);
+    ++m_generation;
+    m_entries.clear();
+    m_sourceLru.clear();
+    m_surfaceLru.clear();
+    m_failedImages.clear();
+    m_stats.residentBytes = 0;
+    m_stats.surfaces = 0;
+    m_stats.decodedImages = 0;
+}
+
+void BackgroundSurfaceCache::SetBudget(size_t budgetBytes) {
+    std::scoped_lock lock(m_mutex);
+    m_budgetBytes = budgetBytes;
+    TrimLocked();
+}
+
+BackgroundSurfaceCacheStats BackgroundSurfaceCache::Stats() const {
+    std::scoped_lock lock(m_mutex);
+    return m_stats;
+}
+
+void BackgroundSurfaceCache::Build(const BackgroundSurfaceKey& key, uint64_t generation) {
+    const BackgroundSurfaceKey sourceKey = SourceKey(key.imagePath);
+    Surface source;
+    {
+        std::scoped_lock lock(m_mutex);
+        source = FindLocked(sourceKey);
+    }
+
+    bool decoded = false;
+    if (!source && m_decoder) {
+        std::optional<BackgroundPixels> pixels = m_decoder(key.imagePath);
+        if (pixels && IsValid(*pixels)) {
+            source = std::make_shared<const BackgroundPixels>(std::move(*pixels));
+            decoded = true;
+        }
+    }
+
+    Surface surface;
+    if (source && source->width == key.width && source->height == key.height) {
+        surface = source;
+    } else if (source) {
+        auto scaled = std::make_shared<BackgroundPixels>();
+        scaled->width = key.width;
+        scaled->height = key.height;
+        scaled->bgra.resize(static_cast<size_t>(key.width) * key.height);
+        // Box averaging keeps downscaled photos free of aliasing; it would
+        // produce blocky output when stretching up.
+        const PreviewScaleFilter filter = (key.width > source->width || key.height > source->height)
+                                              ? PreviewScaleFilter::kBilinear
+                                              : PreviewScaleFilter::kBox;
+        const PreviewPixelView view{source->bgra.data(), source->width, source->height, source->width};
+        if (ScalePreviewPixels(view, scaled->bgra.data(), key.width, key.height, filter)) {
+            surface = std::move(scaled);
+        }
+    }
+
+    std::vector<ReadyCallback> callbacks;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (decoded) {
+            ++m_stats.decodes;
+        }
+        if (surface && surface != source) {
+            ++m_stats.scales;
+        }
+        if (generation == m_generation) {
+            if (surface && surface == source) {
+                // The image already has the requested size, so the surface is
+                // the decoded buffer itself; keeping it under both keys would
+                // count its bytes twice.
+                auto cached = m_entries.find(sourceKey);
+                if (cached != m_entries.end() && cached->second.pixels == source) {
+                    EraseLocked(cached);
+                }
+            } else if (decoded) {
+                InsertLocked(sourceKey, source);
+            }
+            if (surface) {
+                InsertLocked(key, surface);
+            } else {
+                ++m_stats.failures;
+                if (!source) {
+                    m_failedImages.insert(key.imagePath);
+                }
+            }
+        }
+        auto pending = m_pending.find(key);
+        if (pending != m_pending.end()) {
+            callbacks = std::move(pending->second);
+            m_pending.erase(pending);
+        }
+    }
+
+    for (const ReadyCallback& callback : callbacks) {
+        callback(surface);
+    }
+}
+
+BackgroundSurfaceCache::Surface BackgroundSurfaceCache::FindLocked(const BackgroundSurfaceKey& key) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return nullptr;
+    }
+    std::list<BackgroundSurfaceKey>& lru = LruFor(key);
+    lru.splice(lru.begin(), lru, it->second.lru);
+    return it->second.pixels;
+}
+
+void BackgroundSurfaceCache::InsertLocked(const BackgroundSurfaceKey& key, Surface pixels) {
+    auto existing = m_entries.find(key);
+    if (existing != m_entries.end()) {
+        EraseLocked(existing);
+    }
+
+    std::list<BackgroundSurfaceKey>& lru = LruFor(key);
+    lru.push_front(key);
+    m_stats.residentBytes += pixels->Bytes();
+    if (IsSourceKey(key)) {
+        ++m_stats.decodedImages;
+    } else {
+        ++m_stats.surfaces;
+    }
+    m_entries.emplace(key, Entry{std::move(pixels), lru.begin()});
+    TrimLocked();
+}
+
+void BackgroundSurfaceCache::EraseLocked(
+    std::unordered_map<BackgroundSurfaceKey, Entry, BackgroundSurfaceKeyHasher>::iterator it) {
+    m_stats.residentBytes -= it->second.pixels->Bytes();
+    if (IsSourceKey(it->first)) {
+        --m_stats.decodedImages;
+    } else {
+        --m_stats.surfaces;
+    }
+    LruFor(it->first).erase(it->second.lru);
+    m_entries.erase(it);
+}
+
+void BackgroundSurfaceCache::TrimLocked() {
+    // Originals only speed up the next resize; painted surfaces are what
+    // windows are waiting on.
+    while (m_stats.residentBytes > m_budgetBytes && !m_sourceLru.empty()) {
+        EraseLocked(m_entries.find(m_sourceLru.back()));
+        ++m_stats.evictions;
+    }
+    // The newest surface stays even when it alone exceeds the budget, so the
+    // window that asked for it can still paint.
+    while (m_stats.residentBytes > m_budgetBytes && m_surfaceLru.size() > 1) {
+        EraseLocked(m_entries.find(m_surfaceLru.back()));
+        ++m_stats.evictions;
+    }
+}
+
+}  // namespace shelltabs
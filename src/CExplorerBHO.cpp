@@ -42,6 +42,7 @@
 #include "BreadcrumbGradient.h"
 #include "ColorUtils.h"
 #include "ComUtils.h"
+#include "ConfigurationService.h"
 #include "Guids.h"
 #include "Logging.h"
 #include "Module.h"
@@ -384,19 +385,30 @@ HWND FindDirectUIHWND(HWND listView) {
     return nullptr;
 }
 
-// Convert GDI+ Bitmap to HBITMAP for use with LVM_SETBKIMAGE
-HBITMAP BitmapToHBITMAP(Gdiplus::Bitmap* bitmap) {
-    if (!bitmap) {
+// Copy cached background pixels into a DIB section for use with LVM_SETBKIMAGE
+HBITMAP CreateBackgroundHBITMAP(const BackgroundPixels& pixels) {
+    if (pixels.width == 0 || pixels.height == 0) {
         return nullptr;
     }
 
-    HBITMAP hBitmap = nullptr;
-    Gdiplus::Color transparentColor(0, 0, 0, 0);  // Transparent black
+    BITMAPINFO info{};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = static_cast<LONG>(pixels.width);
+    info.bmiHeader.biHeight = -static_cast<LONG>(pixels.height);  // Top-down
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
 
-    if (bitmap->GetHBITMAP(transparentColor, &hBitmap) != Gdiplus::Ok) {
+    void* bits = nullptr;
+    HBITMAP hBitmap = CreateDIBSection(nullptr, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (!hBitmap || !bits) {
+        if (hBitmap) {
+            DeleteObject(hBitmap);
+        }
         return nullptr;
     }
 
+    memcpy(bits, pixels.bgra.data(), pixels.Bytes());
     return hBitmap;
 }
 
@@ -433,7 +445,7 @@ void ClearListViewBackgroundImage(HWND hwnd, HBITMAP* trackedBitmap = nullptr,
 }
 
 // Set ListView background image using LVM_SETBKIMAGE (QTTabBar approach)
-bool SetListViewBackgroundImage(HWND listView, Gdiplus::Bitmap* bitmap, HBITMAP* trackedBitmap = nullptr,
+bool SetListViewBackgroundImage(HWND listView, const BackgroundPixels* pixels, HBITMAP* trackedBitmap = nullptr,
                                 bool useWatermarkMode = false, IVisualProperties* visualProperties = nullptr) {
     if (!listView || !IsWindow(listView)) {
         return false;
@@ -451,13 +463,12 @@ bool SetListViewBackgroundImage(HWND listView, Gdiplus::Bitmap* bitmap, HBITMAP*
     // Clear any existing background image and delete the old bitmap
     ClearListViewBackgroundImage(targetWindow, trackedBitmap, visualProperties);
 
-    // If no bitmap provided, we're just clearing
-    if (!bitmap) {
+    // If no pixels provided, we're just clearing
+    if (!pixels) {
         return true;
     }
 
-    // Convert GDI+ Bitmap to HBITMAP
-    HBITMAP hBitmap = BitmapToHBITMAP(bitmap);
+    HBITMAP hBitmap = CreateBackgroundHBITMAP(*pixels);
     if (!hBitmap) {
         LogMessage(LogLevel::Warning, L"Failed to convert bitmap to HBITMAP for background image");
         return false;
@@ -1099,7 +1110,7 @@ std::unordered_map<UINT_PTR, CExplorerBHO*> CExplorerBHO::s_openInNewTabTimers;
 CExplorerBHO::CExplorerBHO() : m_refCount(1), m_paneHooks() {
     ModuleAddRef();
     m_bufferedPaintInitialized = SUCCEEDED(BufferedPaintInit());
-    m_glowCoordinator.Configure(OptionsStore::Instance().Get());
+    m_glowCoordinator.Configure(*OptionsStore::Instance().Get());
 
     // Initialize DirectUI replacement system
     if (!DirectUIReplacementIntegration::Initialize()) {
@@ -4324,10 +4335,11 @@ void CExplorerBHO::InvalidateNamespaceTreeControl() const {
 
 void CExplorerBHO::ClearFolderBackgrounds() {
     m_folderBackgroundEntries.clear();
-    m_folderBackgroundBitmaps.clear();
+    m_folderBackgroundRuleKeys.clear();
+    m_folderBackgroundIndex.Clear();
+    m_folderBackgroundLookupMemo.Clear();
+    m_folderBackgroundOptionsGeneration = 0;
     m_universalBackgroundImagePath.clear();
-    m_universalBackgroundBitmap.reset();
-    m_failedBackgroundKeys.clear();
     m_folderBackgroundsEnabled = false;
 
     // Delete the tracked background bitmap
@@ -4351,7 +4363,25 @@ std::wstring CExplorerBHO::NormalizeBackgroundKey(const std::wstring& path) cons
     return normalized;
 }
 
-void CExplorerBHO::ReloadFolderBackgrounds(const ShellTabsOptions& options) {
+std::wstring CExplorerBHO::ResolveFolderBackgroundRuleKey(const std::wstring& folderKey) const {
+    if (folderKey.empty()) {
+        return {};
+    }
+
+    const auto match = m_folderBackgroundIndex.Resolve(folderKey, &m_folderBackgroundLookupMemo);
+    if (!match || match->ruleIndex >= m_folderBackgroundRuleKeys.size()) {
+        return folderKey;
+    }
+    return m_folderBackgroundRuleKeys[match->ruleIndex];
+}
+
+void CExplorerBHO::ReloadFolderBackgrounds(const ShellTabsOptions& options, uint64_t optionsGeneration) {
+    // The rule index and decoded bitmaps only depend on the options snapshot, so
+    // repeated option broadcasts that did not change anything keep them intact.
+    if (optionsGeneration != 0 && optionsGeneration == m_folderBackgroundOptionsGeneration) {
+        return;
+    }
+
     ClearFolderBackgrounds();
 
     if (!m_gdiplusInitialized) {
@@ -4359,6 +4389,7 @@ void CExplorerBHO::ReloadFolderBackgrounds(const ShellTabsOptions& options) {
     }
 
     if (!options.enableFolderBackgrounds) {
+        m_folderBackgroundOptionsGeneration = optionsGeneration;
         InvalidateFolderBackgroundTargets();
         return;
     }
@@ -4367,7 +4398,6 @@ void CExplorerBHO::ReloadFolderBackgrounds(const ShellTabsOptions& options) {
 
     if (!options.universalFolderBackgroundImage.cachedImagePath.empty()) {
         m_universalBackgroundImagePath = options.universalFolderBackgroundImage.cachedImagePath;
-        m_universalBackgroundBitmap.reset();
     }
 
     for (const auto& entry : options.folderBackgroundEntries) {
@@ -4384,90 +4414,39 @@ void CExplorerBHO::ReloadFolderBackgrounds(const ShellTabsOptions& options) {
         data.imagePath = entry.image.cachedImagePath;
         data.folderDisplayPath = entry.folderPath;
 
-        auto [it, inserted] = m_folderBackgroundEntries.try_emplace(std::move(key), std::move(data));
+        auto [it, inserted] = m_folderBackgroundEntries.try_emplace(key, std::move(data));
         if (!inserted) {
             it->second.imagePath = entry.image.cachedImagePath;
             it->second.folderDisplayPath = entry.folderPath;
         }
+
+        const uint32_t ruleIndex = static_cast<uint32_t>(m_folderBackgroundRuleKeys.size());
+        if (m_folderBackgroundIndex.Insert(key, ruleIndex, entry.applyToSubfolders)) {
+            m_folderBackgroundRuleKeys.emplace_back(std::move(key));
+        }
     }
 
+    m_folderBackgroundOptionsGeneration = optionsGeneration;
     InvalidateFolderBackgroundTargets();
     RefreshListViewControlBackground();
 }
 
-bool CExplorerBHO::EnsureFolderBackgroundBitmap(const std::wstring& key) const {
-    if (key.empty() || !m_gdiplusInitialized || !m_folderBackgroundsEnabled) {
-        return false;
-    }
-
-    auto existing = m_folderBackgroundBitmaps.find(key);
-    if (existing != m_folderBackgroundBitmaps.end()) {
-        return existing->second != nullptr;
-    }
-
-    if (m_failedBackgroundKeys.find(key) != m_failedBackgroundKeys.end()) {
-        return false;
-    }
-
-    auto entryIt = m_folderBackgroundEntries.find(key);
-    if (entryIt == m_folderBackgroundEntries.end() || entryIt->second.imagePath.empty()) {
-        return false;
-    }
-
-    auto bitmap = LoadBackgroundBitmap(entryIt->second.imagePath);
-    if (!bitmap) {
-        m_failedBackgroundKeys.insert(key);
-        LogMessage(LogLevel::Warning, L"Failed to load background for %ls from %ls",
-                   entryIt->second.folderDisplayPath.c_str(), entryIt->second.imagePath.c_str());
-        return false;
-    }
-
-    m_folderBackgroundBitmaps.emplace(key, std::move(bitmap));
-    return true;
-}
-
-bool CExplorerBHO::EnsureUniversalBackgroundBitmap() const {
+std::wstring CExplorerBHO::ResolveCurrentBackgroundImagePath() const {
     if (!m_folderBackgroundsEnabled || !m_gdiplusInitialized) {
-        return false;
-    }
-
-    if (m_universalBackgroundBitmap) {
-        return true;
-    }
-
-    if (m_universalBackgroundImagePath.empty()) {
-        return false;
-    }
-
-    auto bitmap = LoadBackgroundBitmap(m_universalBackgroundImagePath);
-    if (!bitmap) {
-        LogMessage(LogLevel::Warning, L"Failed to load universal folder background from %ls",
-                   m_universalBackgroundImagePath.c_str());
-        m_universalBackgroundImagePath.clear();
-        return false;
-    }
-
-    m_universalBackgroundBitmap = std::move(bitmap);
-    return true;
-}
-
-Gdiplus::Bitmap* CExplorerBHO::ResolveCurrentFolderBackground() const {
-    if (!m_folderBackgroundsEnabled || !m_gdiplusInitialized) {
-        return nullptr;
+        return {};
     }
 
-    if (EnsureFolderBackgroundBitmap(m_currentFolderKey)) {
-        auto it = m_folderBackgroundBitmaps.find(m_currentFolderKey);
-        if (it != m_folderBackgroundBitmaps.end()) {
-            return it->second.get();
+    if (!m_currentFolderKey.empty()) {
+        auto entryIt = m_folderBackgroundEntries.find(m_currentFolderKey);
+        if (entryIt != m_folderBackgroundEntries.end() && !entryIt->second.imagePath.empty()) {
+            // The failed decode posts a refresh, which lands here again and
+            // switches to the universal background.
+            return GetBackgroundSurfaceCache().ResolveImagePath(entryIt->second.imagePath,
+                                                                m_universalBackgroundImagePath);
         }
     }
 
-    if (EnsureUniversalBackgroundBitmap()) {
-        return m_universalBackgroundBitmap.get();
-    }
-
-    return nullptr;
+    return m_universalBackgroundImagePath;
 }
 
 std::wstring CExplorerBHO::ResolveBackgroundCacheKey() const {
@@ -4475,7 +4454,7 @@ std::wstring CExplorerBHO::ResolveBackgroundCacheKey() const {
         return m_currentFolderKey;
     }
 
-    if (m_universalBackgroundBitmap) {
+    if (!m_universalBackgroundImagePath.empty()) {
         return std::wstring(kUniversalBackgroundCacheKey);
     }
 
@@ -4504,7 +4483,44 @@ void CExplorerBHO::RefreshListViewControlBackground() {
 
     // If backgrounds are enabled, set the background image using LVM_SETBKIMAGE
     if (m_folderBackgroundsEnabled) {
-        Gdiplus::Bitmap* background = ResolveCurrentFolderBackground();
+        BackgroundSurfaceCache::Surface background;
+        const std::wstring imagePath = ResolveCurrentBackgroundImagePath();
+        RECT client{};
+        if (!imagePath.empty() && GetClientRect(m_listView, &client) && client.right > 0 && client.bottom > 0) {
+            BackgroundSurfaceKey key;
+            key.imagePath = imagePath;
+            key.width = static_cast<uint32_t>(client.right);
+            key.height = static_cast<uint32_t>(client.bottom);
+            key.dpi = GetWindowDpi(m_listView);
+
+            // The surface is decoded and scaled to the view size off the UI
+            // thread. Until it arrives the previous image stays up, and only one
+            // request is outstanding per view so a resize drag does not queue a
+            // scale for every intermediate size.
+            if (m_backgroundSurfaceRequestView == m_listView) {
+                background = GetBackgroundSurfaceCache().Find(key);
+                if (!background) {
+                    return;
+                }
+            } else {
+                const HWND listView = m_listView;
+                bool queued = false;
+                background = GetBackgroundSurfaceCache().Acquire(
+                    key,
+                    [listView, imagePath](const BackgroundSurfaceCache::Surface& surface) {
+                        if (!surface) {
+                            LogMessage(LogLevel::Warning, L"Failed to load folder background from %ls",
+                                       imagePath.c_str());
+                        }
+                        PostMessageW(listView, WM_SHELLTABS_LISTVIEW_BACKGROUND_READY, 0, 0);
+                    },
+                    &queued);
+                if (!background && queued) {
+                    m_backgroundSurfaceRequestView = m_listView;
+                    return;
+                }
+            }
+        }
 
         // Set ListView background to transparent for better image rendering
         ListView_SetBkColor(m_listView, CLR_NONE);
@@ -4512,7 +4528,7 @@ void CExplorerBHO::RefreshListViewControlBackground() {
 
         // Set the background image using native ListView API (QTTabBar approach)
         // Use watermark mode for better alpha blending on Vista+
-        SetListViewBackgroundImage(m_listView, background, &m_currentBackgroundBitmap, true,
+        SetListViewBackgroundImage(m_listView, background.get(), &m_currentBackgroundBitmap, true,
                                    visualProperties.Get());
     } else {
         // Clear background image and restore default colors
@@ -4544,7 +4560,7 @@ void CExplorerBHO::UpdateCurrentFolderBackground() {
             resolvedKey = true;
             PWSTR path = nullptr;
             if (SUCCEEDED(SHGetNameFromIDList(current.get(), SIGDN_FILESYSPATH, &path)) && path && path[0] != L'\0') {
-                newKey = NormalizeBackgroundKey(path);
+                newKey = ResolveFolderBackgroundRuleKey(NormalizeBackgroundKey(path));
             }
             if (path) {
                 CoTaskMemFree(path);
@@ -4557,18 +4573,11 @@ void CExplorerBHO::UpdateCurrentFolderBackground() {
     }
 
     if (newKey == m_currentFolderKey) {
-        if (!EnsureFolderBackgroundBitmap(m_currentFolderKey)) {
-            EnsureUniversalBackgroundBitmap();
-        }
         return;
     }
 
     m_currentFolderKey = std::move(newKey);
 
-    if (!EnsureFolderBackgroundBitmap(m_currentFolderKey)) {
-        EnsureUniversalBackgroundBitmap();
-    }
-
     InvalidateFolderBackgroundTargets();
     RefreshListViewControlBackground();
 }
@@ -4896,9 +4905,18 @@ bool CExplorerBHO::HandleExplorerViewMessage(HWND hwnd, UINT msg, WPARAM wParam,
             }
             break;
         }
+        case WM_SHELLTABS_LISTVIEW_BACKGROUND_READY: {
+            if (isListView) {
+                m_backgroundSurfaceRequestView = nullptr;
+                RefreshListViewControlBackground();
+                *result = 0;
+                return true;
+            }
+            break;
+        }
         case WM_SIZE: {
             if (isListView) {
-                // Surface caching removed with LVM_SETBKIMAGE approach
+                // Rescaled surfaces come from the shared background cache
                 RefreshListViewControlBackground();
             }
             // DirectUI background no longer needs manual surface management
@@ -7276,7 +7294,9 @@ void CExplorerBHO::UpdateBreadcrumbSubclass() {
     auto& store = OptionsStore::Instance();
     static bool loggedOptionsLoadFailure = false;
     std::wstring errorContext;
-    if (!store.Load(&errorContext)) {
+    const bool loaded = ConfigurationService::Instance().IsRunning() ? store.EnsureLoaded(&errorContext)
+                                                                     : store.Load(&errorContext);
+    if (!loaded) {
         if (!loggedOptionsLoadFailure) {
             if (!errorContext.empty()) {
                 LogMessage(LogLevel::Warning,
@@ -7291,7 +7311,7 @@ void CExplorerBHO::UpdateBreadcrumbSubclass() {
     } else if (loggedOptionsLoadFailure) {
         loggedOptionsLoadFailure = false;
     }
-    const ShellTabsOptions options = store.Get();
+    const ShellTabsOptions options = *store.Get();
     const bool previousBreadcrumbFontGradientEnabled = m_breadcrumbFontGradientEnabled;
     const int previousBreadcrumbFontBrightness = m_breadcrumbFontBrightness;
     const bool previousUseCustomFontColors = m_useCustomBreadcrumbFontColors;
@@ -7338,7 +7358,7 @@ void CExplorerBHO::UpdateBreadcrumbSubclass() {
 
     m_cachedContextMenuItems = options.contextMenuItems;
 
-    ReloadFolderBackgrounds(options);
+    ReloadFolderBackgrounds(options, store.ChangeGeneration());
     UpdateCurrentFolderBackground();
 
     UpdateProgressSubclass();
@@ -8743,7 +8763,8 @@ bool CExplorerBHO::HandleListViewGradientCustomDraw(NMLVCUSTOMDRAW* customDraw,
         return false;
     }
 
-    const ShellTabsOptions& options = OptionsStore::Instance().Get();
+    const auto optionsSnapshot = OptionsStore::Instance().Get();
+    const ShellTabsOptions& options = *optionsSnapshot;
     BreadcrumbGradientConfig gradientConfig{};
     gradientConfig.enabled = true;
     gradientConfig.brightness = options.breadcrumbFontBrightness;
@@ -8867,7 +8888,8 @@ bool CExplorerBHO::HandleTreeViewGradientCustomDraw(NMTVCUSTOMDRAW* customDraw,
         return false;
     }
 
-    const ShellTabsOptions& options = OptionsStore::Instance().Get();
+    const auto optionsSnapshot = OptionsStore::Instance().Get();
+    const ShellTabsOptions& options = *optionsSnapshot;
     BreadcrumbGradientConfig gradientConfig{};
     gradientConfig.enabled = true;
     gradientConfig.brightness = options.breadcrumbFontBrightness;
@@ -9030,7 +9052,8 @@ void CExplorerBHO::UpdateListViewDescriptor() {
     descriptor.backgroundPaintContext = nullptr;
 
     // Configure gradient text - FORCED ALWAYS ENABLED
-    const ShellTabsOptions& options = OptionsStore::Instance().Get();
+    const auto optionsSnapshot = OptionsStore::Instance().Get();
+    const ShellTabsOptions& options = *optionsSnapshot;
     descriptor.gradientTextEnabled = true;  // FORCED: Always enable gradient text for files/folders
     descriptor.forcedHooks = true;  // Required for ExtTextOutWDetour to activate
     BreadcrumbGradientConfig gradientConfig{};
@@ -9064,7 +9087,8 @@ void CExplorerBHO::UpdateTreeViewDescriptor() {
     descriptor.forceOpaqueBackground = false;
 
     // Configure gradient text - FORCED ALWAYS ENABLED
-    const ShellTabsOptions& options = OptionsStore::Instance().Get();
+    const auto optionsSnapshot = OptionsStore::Instance().Get();
+    const ShellTabsOptions& options = *optionsSnapshot;
     descriptor.gradientTextEnabled = true;  // FORCED: Always enable gradient text for TreeView items
     descriptor.forcedHooks = true;  // Required for ExtTextOutWDetour to activate
     BreadcrumbGradientConfig gradientConfig{};
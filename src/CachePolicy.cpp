@@ -0,0 +1,311 @@
+#include "CachePolicy.h"
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+namespace shelltabs {
+namespace {
+
+enum TwoQueueSlot : uint8_t {
+    kNotQueued = 0,
+    kRecentQueue,
+    kFrequentQueue,
+};
+
+class LruPolicy final : public CachePolicy {
+public:
+    void OnInsert(CachePolicyNode* node) override { m_list.PushFront(node); }
+    void OnAccess(CachePolicyNode* node) noexcept override { m_list.MoveToFront(node); }
+    void OnRemove(CachePolicyNode* node, bool) override { m_list.Remove(node); }
+
+    CachePolicyNode* SelectVictim(EvictablePredicate evictable) noexcept override {
+        for (CachePolicyNode* node = m_list.Back(); node; node = m_list.Prev(node)) {
+            if (evictable(*node)) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    CachePolicyList m_list;
+};
+
+// Second-chance clock: hits only set a bit, so the hot path never relinks.
+class ClockPolicy final : public CachePolicy {
+public:
+    void OnInsert(CachePolicyNode* node) override {
+        node->referenced = false;
+        // Just behind the hand, so a new entry is the last one it reaches.
+        m_ring.InsertBefore(m_hand, node);
+        if (!m_hand) {
+            m_hand = node;
+        }
+    }
+
+    void OnAccess(CachePolicyNode* node) noexcept override { node->referenced = true; }
+
+    void OnRemove(CachePolicyNode* node, bool) override {
+        if (m_hand == node) {
+            m_hand = m_ring.Size() > 1 ? Advance(node) : nullptr;
+        }
+        m_ring.Remove(node);
+    }
+
+    CachePolicyNode* SelectVictim(EvictablePredicate evictable) noexcept override {
+        // Two turns clear every reference bit once; anything still skipped
+        // after that is pinned.
+        const size_t limit = m_ring.Size() * 2;
+        for (size_t step = 0; m_hand && step < limit; ++step) {
+            CachePolicyNode* candidate = m_hand;
+            m_hand = Advance(candidate);
+            if (!evictable(*candidate)) {
+                continue;
+            }
+            if (candidate->referenced) {
+                candidate->referenced = false;
+                continue;
+            }
+            return candidate;
+        }
+        return nullptr;
+    }
+
+private:
+    CachePolicyNode* Advance(const CachePolicyNode* node) const noexcept {
+        CachePolicyNode* next = m_ring.Next(node);
+        return next ? next : m_ring.Front();
+    }
+
+    CachePolicyList m_ring;
+    CachePolicyNode* m_hand = nullptr;
+};
+
+// 2Q after Johnson and Shasha. The recent queue is a FIFO holding a quarter
+// of the capacity; keys evicted from it are remembered in a ghost list, and a
+// key that returns while still ghosted goes straight to the frequent LRU.
+class TwoQueuePolicy final : public CachePolicy {
+public:
+    explicit TwoQueuePolicy(size_t capacity) { SetCapacity(capacity); }
+
+    void SetCapacity(size_t capacity) noexcept override {
+        m_recentTarget = std::max<size_t>(1, capacity / 4);
+        m_ghostLimit = std::max<size_t>(1, capacity / 2);
+    }
+
+    void OnInsert(CachePolicyNode* node) override {
+        auto ghost = m_ghosts.find(node->key);
+        if (ghost != m_ghosts.end()) {
+            m_ghosts.erase(ghost);
+            node->queue = kFrequentQueue;
+            m_frequent.PushFront(node);
+            return;
+        }
+        node->queue = kRecentQueue;
+        m_recent.PushFront(node);
+    }
+
+    void OnAccess(CachePolicyNode* node) noexcept override {
+        // Re-hits inside the FIFO are deliberately ignored; correlated
+        // references right after a load should not earn promotion.
+        if (node->queue == kFrequentQueue) {
+            m_frequent.MoveToFront(node);
+        }
+    }
+
+    void OnRemove(CachePolicyNode* node, bool evicted) override {
+        if (node->queue == kRecentQueue) {
+            m_recent.Remove(node);
+            if (evicted) {
+                RememberGhost(node->key);
+            }
+        } else if (node->queue == kFrequentQueue) {
+            m_frequent.Remove(node);
+        }
+        node->queue = kNotQueued;
+    }
+
+    CachePolicyNode* SelectVictim(EvictablePredicate evictable) noexcept override {
+        const bool preferRecent = m_recent.Size() > m_recentTarget || m_frequent.Empty();
+        CachePolicyList& first = preferRecent ? m_recent : m_frequent;
+        CachePolicyList& second = preferRecent ? m_frequent : m_recent;
+        if (CachePolicyNode* victim = OldestEvictable(first, evictable)) {
+            return victim;
+        }
+        return OldestEvictable(second, evictable);
+    }
+
+private:
+    static CachePolicyNode* OldestEvictable(const CachePolicyList& list, EvictablePredicate evictable) noexcept {
+        for (CachePolicyNode* node = list.Back(); node; node = list.Prev(node)) {
+            if (evictable(*node)) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    void RememberGhost(uint64_t key) {
+        const uint64_t stamp = ++m_ghostStamp;
+        m_ghosts[key] = stamp;
+        m_ghostOrder.emplace_back(key, stamp);
+        while (m_ghosts.size() > m_ghostLimit && !m_ghostOrder.empty()) {
+            const auto [oldKey, oldStamp] = m_ghostOrder.front();
+            m_ghostOrder.pop_front();
+            auto it = m_ghosts.find(oldKey);
+            if (it != m_ghosts.end() && it->second == oldStamp) {
+                m_ghosts.erase(it);
+            }
+        }
+        // Promotions leave stale order records behind; drop them once they
+        // dominate so the deque stays bounded.
+        if (m_ghostOrder.size() > m_ghostLimit * 2) {
+            std::deque<std::pair<uint64_t, uint64_t>> live;
+            for (const auto& record : m_ghostOrder) {
+                auto it = m_ghosts.find(record.first);
+                if (it != m_ghosts.end() && it->second == record.second) {
+                    live.push_back(record);
+                }
+            }
+            m_ghostOrder.swap(live);
+        }
+    }
+
+    CachePolicyList m_recent;
+    CachePolicyList m_frequent;
+    std::unordered_map<uint64_t, uint64_t> m_ghosts;
+    std::deque<std::pair<uint64_t, uint64_t>> m_ghostOrder;
+    uint64_t m_ghostStamp = 0;
+    size_t m_recentTarget = 1;
+    size_t m_ghostLimit = 1;
+};
+
+bool AlwaysEvictable(const CachePolicyNode&) { return true; }
+
+}  // namespace
+
+const char* CacheEvictionPolicyName(CacheEvictionPolicy policy) noexcept {
+    switch (policy) {
+        case CacheEvictionPolicy::kLru:
+            return "lru";
+        case CacheEvictionPolicy::kClock:
+            return "clock";
+        case CacheEvictionPolicy::kTwoQueue:
+            return "2q";
+    }
+    return "unknown";
+}
+
+CachePolicyList::CachePolicyList() noexcept {
+    m_head.prev = &m_head;
+    m_head.next = &m_head;
+}
+
+CachePolicyNode* CachePolicyList::Next(const CachePolicyNode* node) const noexcept {
+    return node->next == &m_head ? nullptr : node->next;
+}
+
+CachePolicyNode* CachePolicyList::Prev(const CachePolicyNode* node) const noexcept {
+    return node->prev == &m_head ? nullptr : node->prev;
+}
+
+void CachePolicyList::PushFront(CachePolicyNode* node) noexcept { InsertBefore(Front(), node); }
+
+void CachePolicyList::PushBack(CachePolicyNode* node) noexcept { InsertBefore(nullptr, node); }
+
+void CachePolicyList::InsertBefore(CachePolicyNode* position, CachePolicyNode* node) noexcept {
+    CachePolicyNode* after = position ? position : &m_head;
+    node->next = after;
+    node->prev = after->prev;
+    after->prev->next = node;
+    after->prev = node;
+    ++m_size;
+}
+
+void CachePolicyList::Remove(CachePolicyNode* node) noexcept {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = nullptr;
+    node->next = nullptr;
+    --m_size;
+}
+
+void CachePolicyList::MoveToFront(CachePolicyNode* node) noexcept {
+    if (m_head.next == node) {
+        return;
+    }
+    Remove(node);
+    PushFront(node);
+}
+
+std::unique_ptr<CachePolicy> CreateCachePolicy(CacheEvictionPolicy policy, size_t capacity) {
+    switch (policy) {
+        case CacheEvictionPolicy::kClock:
+            return std::make_unique<ClockPolicy>();
+        case CacheEvictionPolicy::kTwoQueue:
+            return std::make_unique<TwoQueuePolicy>(capacity);
+        case CacheEvictionPolicy::kLru:
+            break;
+    }
+    return std::make_unique<LruPolicy>();
+}
+
+uint64_t HashCacheKey(std::string_view bytes) noexcept {
+    uint64_t hash = 1469598103934665603ull;
+    for (const char byte : bytes) {
+        hash ^= static_cast<unsigned char>(byte);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+CachePolicySimulator::CachePolicySimulator(CacheEvictionPolicy policy, size_t capacity)
+    : m_policy(CreateCachePolicy(policy, capacity)), m_capacity(std::max<size_t>(1, capacity)) {}
+
+bool CachePolicySimulator::Access(uint64_t key, size_t bytes) {
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        ++m_hits;
+        m_policy->OnAccess(it->second.get());
+        return true;
+    }
+
+    ++m_misses;
+    while (m_entries.size() >= m_capacity) {
+        CachePolicyNode* victim = m_policy->SelectVictim(&AlwaysEvictable);
+        if (!victim) {
+            break;
+        }
+        Erase(static_cast<Node*>(victim), true);
+    }
+    auto node = std::make_unique<Node>();
+    node->key = key;
+    node->bytes = bytes;
+    m_policy->OnInsert(node.get());
+    m_entries.emplace(key, std::move(node));
+    m_bytes += bytes;
+    m_peakBytes = std::max(m_peakBytes, m_bytes);
+    return false;
+}
+
+void CachePolicySimulator::Invalidate(uint64_t key) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+    Erase(it->second.get(), false);
+}
+
+void CachePolicySimulator::Erase(Node* node, bool evicted) {
+    m_policy->OnRemove(node, evicted);
+    m_bytes -= node->bytes;
+    m_entries.erase(node->key);
+}
+
+double CachePolicySimulator::HitRate() const noexcept {
+    const uint64_t total = m_hits + m_misses;
+    return total == 0 ? 0.0 : static_cast<double>(m_hits) / static_cast<double>(total);
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,211 @@
+#include "CacheTraceRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <system_error>
+#include <utility>
+
+namespace shelltabs {
+
+const char* CacheTraceSourceName(CacheTraceSource source) noexcept {
+    switch (source) {
+        case CacheTraceSource::kIcon:
+            return "icon";
+        case CacheTraceSource::kPreview:
+            return "preview";
+        case CacheTraceSource::kListView:
+            return "listview";
+    }
+    return "unknown";
+}
+
+CacheTraceRecorder& CacheTraceRecorder::Instance() {
+    static CacheTraceRecorder recorder;
+    return recorder;
+}
+
+CacheTraceRecorder::~CacheTraceRecorder() { Stop(); }
+
+bool CacheTraceRecorder::Start(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> fileLock(m_fileMutex);
+    if (m_file.is_open()) {
+        return false;
+    }
+
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file) {
+        m_file = std::ofstream();
+        return false;
+    }
+    const CacheTraceFileHeader header;
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    try {
+        m_writer = std::thread(&CacheTraceRecorder::WriterMain, this);
+    } catch (const std::system_error&) {
+        m_file.close();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> bufferLock(m_bufferMutex);
+    m_pending.clear();
+    m_pending.reserve(kFlushThreshold);
+    m_fullBatches.clear();
+    m_start = std::chrono::steady_clock::now();
+    m_enabled.store(true, std::memory_order_release);
+    return true;
+}
+
+void CacheTraceRecorder::Stop() {
+    std::thread writer;
+    {
+        std::lock_guard<std::mutex> fileLock(m_fileMutex);
+        std::lock_guard<std::mutex> bufferLock(m_bufferMutex);
+        m_enabled.store(false, std::memory_order_release);
+        m_stopWriter = true;
+        writer = std::move(m_writer);
+    }
+    m_writerWake.notify_all();
+    // The writer needs m_fileMutex for its last batch, so join without it.
+    if (writer.joinable()) {
+        writer.join();
+    }
+
+    std::lock_guard<std::mutex> fileLock(m_fileMutex);
+    {
+        std::lock_guard<std::mutex> bufferLock(m_bufferMutex);
+        m_stopWriter = false;
+    }
+    if (!m_file.is_open()) {
+        return;
+    }
+    WriteQueuedLocked(true);
+    m_file.close();
+}
+
+void CacheTraceRecorder::Flush() {
+    std::lock_guard<std::mutex> fileLock(m_fileMutex);
+    WriteQueuedLocked(true);
+    m_file.flush();
+}
+
+void CacheTraceRecorder::Record(CacheTraceSource source, CacheTraceEvent event, uint64_t keyHash,
+                                size_t sizeBytes) noexcept {
+    if (!IsEnabled()) {
+        return;
+    }
+
+    CacheTraceRecord record;
+    record.keyHash = keyHash;
+    record.sizeBytes = static_cast<uint32_t>(std::min<size_t>(sizeBytes, std::numeric_limits<uint32_t>::max()));
+    record.source = static_cast<uint8_t>(source);
+    record.event = static_cast<uint8_t>(event);
+
+    bool batchFull = false;
+    {
+        std::lock_guard<std::mutex> lock(m_bufferMutex);
+        if (!m_enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        record.timestampMicros = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start)
+                .count());
+        try {
+            m_pending.push_back(record);
+        } catch (const std::bad_alloc&) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (m_pending.size() >= kFlushThreshold) {
+            // If the batch cannot be queued it stays pending and the next
+            // record tries again.
+            try {
+                m_fullBatches.push_back(std::move(m_pending));
+                m_pending = {};
+                batchFull = true;
+                m_pending.reserve(kFlushThreshold);
+            } catch (const std::bad_alloc&) {
+            }
+        }
+    }
+    m_recorded.fetch_add(1, std::memory_order_relaxed);
+
+    if (batchFull) {
+        m_writerWake.notify_one();
+    }
+}
+
+void CacheTraceRecorder::WriterMain() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_bufferMutex);
+            m_writerWake.wait(lock, [this]() { return m_stopWriter || !m_fullBatches.empty(); });
+            if (m_fullBatches.empty()) {
+                return;
+            }
+        }
+        try {
+            std::lock_guard<std::mutex> fileLock(m_fileMutex);
+            WriteQueuedLocked(false);
+            m_file.flush();
+        } catch (...) {
+        }
+    }
+}
+
+void CacheTraceRecorder::WriteQueuedLocked(bool includePending) {
+    std::deque<std::vector<CacheTraceRecord>> batches;
+    {
+        std::lock_guard<std::mutex> bufferLock(m_bufferMutex);
+        batches.swap(m_fullBatches);
+        if (includePending && !m_pending.empty()) {
+            batches.push_back(std::move(m_pending));
+            m_pending = {};
+        }
+    }
+    for (auto& batch : batches) {
+        WriteBatch(batch);
+    }
+}
+
+void CacheTraceRecorder::WriteBatch(std::vector<CacheTraceRecord>& batch) {
+    if (batch.empty() || !m_file.is_open()) {
+        return;
+    }
+    m_file.write(reinterpret_cast<const char*>(batch.data()),
+                 static_cast<std::streamsize>(batch.size() * sizeof(CacheTraceRecord)));
+    if (!m_file) {
+        // A full disk should not turn every lookup into a failed write.
+        m_dropped.fetch_add(batch.size(), std::memory_order_relaxed);
+        m_enabled.store(false, std::memory_order_relaxed);
+    }
+    batch.clear();
+}
+
+bool ReadCacheTrace(const std::filesystem::path& path, std::vector<CacheTraceRecord>* records) {
+    if (!records) {
+        return false;
+    }
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+
+    CacheTraceFileHeader header;
+    const CacheTraceFileHeader expected;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+        header.recordSize != sizeof(CacheTraceRecord)) {
+        return false;
+    }
+
+    CacheTraceRecord record;
+    while (stream.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        records->push_back(record);
+    }
+    return true;
+}
+
+}  // namespace shelltabs
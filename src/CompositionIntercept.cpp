@@ -15,6 +15,7 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "GradientDamage.h"
 #include "Logging.h"
 
 namespace shelltabs {
@@ -125,8 +126,15 @@ struct ExplorerTargetContext : public std::enable_shared_from_this<ExplorerTarge
     ComPtr<IDCompositionVisual2> container;
     ComPtr<IDCompositionVisual2> backgroundVisual;
     ComPtr<IDCompositionVisual2> foregroundVisual;
-    ComPtr<IDCompositionSurface> backgroundSurface;
-    ComPtr<IDCompositionSurface> foregroundSurface;
+    ComPtr<IDCompositionVirtualSurface> backgroundSurface;
+    ComPtr<IDCompositionVirtualSurface> foregroundSurface;
+    // What the surfaces and the overlay bitmaps hold. The bitmaps have room
+    // to grow, so a resize repaints only what it exposes.
+    VerticalGradientState surfaceState;
+    VerticalGradientState bitmapState;
+    SIZE bitmapCapacity{0, 0};
+    // Bumped whenever the overlay bitmaps change.
+    uint64_t overlayGeneration = 1;
     GlowColorSet lastColors{};
     SIZE lastSize{0, 0};
     bool surfacesDirty = true;
@@ -143,6 +151,11 @@ struct ExplorerTargetContext : public std::enable_shared_from_this<ExplorerTarge
     HGDIOBJ scratchOldBitmap = nullptr;
     void* scratchBits = nullptr;
     SIZE scratchSize{0, 0};
+    // The scratch bitmap holds the overlay of scratchGeneration (0: nothing)
+    // read at scratchOrigin, except where blits drew over it since.
+    uint64_t scratchGeneration = 0;
+    POINT scratchOrigin{0, 0};
+    DirtyRegion scratchDamage;
 
     ~ExplorerTargetContext() {
         if (backgroundBitmap) {
@@ -393,15 +406,16 @@ bool EnsureScratchSurfaceLocked(const std::shared_ptr<ExplorerTargetContext>& co
     context->scratchBits = bits;
     context->scratchSize.cx = width;
     context->scratchSize.cy = height;
+    context->scratchGeneration = 0;
+    context->scratchDamage.Clear();
     return true;
 }
 
-bool CopyDcRegionToScratchLocked(const InterceptParams& params, HDC dc) {
-    if (!params.context || !dc || !g_originalBitBlt) {
-        return false;
+// The intercepted blit drew into the scratch bitmap, over the overlay.
+void MarkScratchDrawnLocked(const InterceptParams& params) {
+    if (params.context) {
+        params.context->scratchDamage.Add({0, 0, params.width, params.height});
     }
-    return g_originalBitBlt(params.context->scratchDc, 0, 0, params.width, params.height, dc, params.x, params.y,
-                            SRCCOPY) != FALSE;
 }
 
 bool FlushScratchToDcLocked(const InterceptParams& params, HDC dc) {
@@ -412,43 +426,73 @@ bool FlushScratchToDcLocked(const InterceptParams& params, HDC dc) {
                             SRCCOPY) != FALSE;
 }
 
+// The overlay replaces every pixel of the scratch region, so the scratch is
+// not filled from the DC first, and only what changed since the last overlay
+// is copied: everything when the overlay, the origin or the scratch bitmap
+// changed, otherwise just what blits drew over. The foreground bitmap holds
+// the same pixels as the background one and used to be copied over it, so
+// only the topmost is copied.
 void ApplyGradientOverlayLocked(const InterceptParams& params) {
     auto context = params.context;
     if (!context || params.width <= 0 || params.height <= 0) {
         return;
     }
 
-    bool applied = false;
-    if (context->backgroundBitmap && g_originalBitBlt && params.bounds.left >= 0 && params.bounds.top >= 0 &&
-        params.bounds.right <= context->lastSize.cx && params.bounds.bottom <= context->lastSize.cy) {
+    const HBITMAP overlay = context->foregroundBitmap ? context->foregroundBitmap : context->backgroundBitmap;
+    if (overlay && g_originalBitBlt && params.bounds.left >= 0 && params.bounds.top >= 0 &&
+        params.bounds.right <= static_cast<LONG>(context->bitmapState.width) &&
+        params.bounds.bottom <= static_cast<LONG>(context->bitmapState.height)) {
+        const DirtyRect scratchRect{0, 0, params.width, params.height};
+        DirtyRegion copy;
+        if (context->scratchGeneration == context->overlayGeneration &&
+            context->scratchOrigin.x == params.bounds.left && context->scratchOrigin.y == params.bounds.top) {
+            copy = context->scratchDamage;
+            copy.Clip(scratchRect);
+        } else {
+            copy.Add(scratchRect);
+        }
+
+        bool applied = false;
         HDC gradientDc = CreateCompatibleDC(nullptr);
         if (gradientDc) {
-            HGDIOBJ old = SelectObject(gradientDc, context->backgroundBitmap);
+            HGDIOBJ old = SelectObject(gradientDc, overlay);
             if (old) {
-                applied = g_originalBitBlt(context->scratchDc, 0, 0, params.width, params.height, gradientDc,
-                                           params.bounds.left, params.bounds.top, SRCCOPY) != FALSE;
-                if (context->foregroundBitmap) {
-                    HGDIOBJ foregroundOld = SelectObject(gradientDc, context->foregroundBitmap);
-                    if (foregroundOld) {
-                        g_originalBitBlt(context->scratchDc, 0, 0, params.width, params.height, gradientDc,
-                                         params.bounds.left, params.bounds.top, SRCCOPY);
-                        SelectObject(gradientDc, foregroundOld);
+                applied = true;
+                for (const DirtyRect& rect : copy.Rects()) {
+                    if (!g_originalBitBlt(context->scratchDc, rect.left, rect.top, rect.right - rect.left,
+                                          rect.bottom - rect.top, gradientDc, params.bounds.left + rect.left,
+                                          params.bounds.top + rect.top, SRCCOPY)) {
+                        applied = false;
+                        break;
                     }
                 }
                 SelectObject(gradientDc, old);
             }
             DeleteDC(gradientDc);
         }
+        if (applied) {
+            context->scratchGeneration = context->overlayGeneration;
+            context->scratchOrigin = {params.bounds.left, params.bounds.top};
+            context->scratchDamage.Clear();
+            return;
+        }
     }
 
-    if (!applied && context->scratchBits) {
+    context->scratchGeneration = 0;
+    if (context->scratchBits) {
         FillGradientPixels(static_cast<uint32_t*>(context->scratchBits), params.width, params.height,
                            context->lastColors);
     }
 }
 
-uint32_t PremultiplyChannel(uint8_t value, uint8_t alpha) noexcept {
-    return static_cast<uint32_t>(value) * static_cast<uint32_t>(alpha) / 255u;
+VerticalGradientState GradientStateFor(int width, int height, const GlowColorSet& colors) {
+    VerticalGradientState state;
+    state.width = static_cast<uint32_t>(std::max(0, width));
+    state.height = static_cast<uint32_t>(std::max(0, height));
+    state.start = {GetRValue(colors.start), GetGValue(colors.start), GetBValue(colors.start), 0xFF};
+    state.end = colors.gradient ? GradientColor{GetRValue(colors.end), GetGValue(colors.end), GetBValue(colors.end), 0xFF}
+                                : state.start;
+    return state;
 }
 
 void FillGradientPixels(uint32_t* pixels, int width, int height, const GlowColorSet& colors) {
@@ -456,37 +500,26 @@ void FillGradientPixels(uint32_t* pixels, int width, int height, const GlowColor
         return;
     }
 
-    const uint8_t alpha = 0xFF;
-    const uint8_t startR = GetRValue(colors.start);
-    const uint8_t startG = GetGValue(colors.start);
-    const uint8_t startB = GetBValue(colors.start);
-    const uint8_t endR = GetRValue(colors.end);
-    const uint8_t endG = GetGValue(colors.end);
-    const uint8_t endB = GetBValue(colors.end);
-
-    for (int y = 0; y < height; ++y) {
-        double ratio = static_cast<double>(y) / static_cast<double>(std::max(1, height - 1));
-        uint8_t r = startR;
-        uint8_t g = startG;
-        uint8_t b = startB;
-        if (colors.gradient) {
-            r = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(startR + (endR - startR) * ratio)), 0, 255));
-            g = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(startG + (endG - startG) * ratio)), 0, 255));
-            b = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(startB + (endB - startB) * ratio)), 0, 255));
-        }
-        const uint32_t pixel = (alpha << 24) | (PremultiplyChannel(r, alpha) << 16) |
-                               (PremultiplyChannel(g, alpha) << 8) | PremultiplyChannel(b, alpha);
-        for (int x = 0; x < width; ++x) {
-            pixels[y * width + x] = pixel;
-        }
+    const VerticalGradientState state = GradientStateFor(width, height, colors);
+    GetGradientSpanCache().Fill(pixels, state.width, state.height, state.width,
+                                GradientSpec{state.start, state.end, GradientDirection::kVertical});
+}
+
+// Bitmaps grow by at least a quarter, in 64 pixel steps, so dragging a window
+// edge does not reallocate them on every step.
+LONG GrowBitmapExtent(LONG current, int needed) {
+    if (needed <= current) {
+        return current;
     }
+    const LONG grown = std::max<LONG>(needed, current + current / 4);
+    return (grown + 63) & ~LONG{63};
 }
 
-HBITMAP CreateGradientBitmap(int width, int height, const GlowColorSet& colors) {
+HBITMAP CreateOverlayBitmap(SIZE capacity) {
     BITMAPINFO info{};
     info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    info.bmiHeader.biWidth = width;
-    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biWidth = capacity.cx;
+    info.bmiHeader.biHeight = -capacity.cy;
     info.bmiHeader.biPlanes = 1;
     info.bmiHeader.biBitCount = 32;
     info.bmiHeader.biCompression = BI_RGB;
@@ -499,33 +532,55 @@ HBITMAP CreateGradientBitmap(int width, int height, const GlowColorSet& colors)
         }
         return nullptr;
     }
-    FillGradientPixels(static_cast<uint32_t*>(bits), width, height, colors);
     return bitmap;
 }
 
-void UpdateGradientBitmap(HBITMAP bitmap, int width, int height, const GlowColorSet& colors) {
+bool RepaintOverlayBitmap(HBITMAP bitmap, const VerticalGradientState& state, const DirtyRegion& damage) {
     if (!bitmap) {
-        return;
+        return false;
     }
     DIBSECTION section{};
-    if (GetObjectW(bitmap, sizeof(section), &section) != sizeof(section)) {
-        return;
+    if (GetObjectW(bitmap, sizeof(section), &section) != sizeof(section) || !section.dsBm.bmBits) {
+        return false;
     }
-    if (!section.dsBm.bmBits || section.dsBm.bmWidth != width || section.dsBm.bmHeight != -height) {
-        return;
+    if (section.dsBm.bmWidth < static_cast<LONG>(state.width) ||
+        std::abs(section.dsBm.bmHeight) < static_cast<LONG>(state.height)) {
+        return false;
+    }
+    const size_t stride = static_cast<size_t>(section.dsBm.bmWidthBytes) / sizeof(uint32_t);
+    return RepaintVerticalGradient(static_cast<uint32_t*>(section.dsBm.bmBits), stride, state, damage,
+                                   GetGradientSpanCache());
+}
+
+void ReleaseOverlayBitmapsLocked(const std::shared_ptr<ExplorerTargetContext>& context) {
+    for (HBITMAP* bitmap : {&context->backgroundBitmap, &context->foregroundBitmap}) {
+        if (*bitmap) {
+            UntrackBitmap(*bitmap);
+            DeleteObject(*bitmap);
+            *bitmap = nullptr;
+        }
     }
-    FillGradientPixels(static_cast<uint32_t*>(section.dsBm.bmBits), width, height, colors);
+    context->bitmapCapacity = {0, 0};
+    context->bitmapState = {};
 }
 
-HRESULT DrawGradientToSurface(IDCompositionSurface* surface, int width, int height, const GlowColorSet& colors) {
-    if (!surface || width <= 0 || height <= 0) {
+// Draws rect of the gradient into surface. The ramp is opaque, so the rows
+// of rect are uploaded as a one pixel wide column and stretched across.
+HRESULT DrawGradientToSurface(IDCompositionSurface* surface, const VerticalGradientState& state,
+                              const DirtyRect& rect) {
+    if (!surface || state.Empty() || rect.Empty()) {
         return E_INVALIDARG;
     }
     if (!EnsureD2DFactory()) {
         return E_FAIL;
     }
 
-    RECT updateRect{0, 0, width, height};
+    const GradientSpanCache::Span ramp = GetGradientSpanCache().Acquire(state.start, state.end, state.height);
+    if (!ramp) {
+        return E_OUTOFMEMORY;
+    }
+
+    RECT updateRect{rect.left, rect.top, rect.right, rect.bottom};
     POINT offset{};
     ComPtr<ID2D1DeviceContext> dc;
     HRESULT hr = surface->BeginDraw(&updateRect, __uuidof(ID2D1DeviceContext),
@@ -534,35 +589,21 @@ HRESULT DrawGradientToSurface(IDCompositionSurface* surface, int width, int heig
         return hr;
     }
 
-    dc->Clear(D2D1::ColorF(D2D1::ColorF::Black, 0.0f));
-
-    D2D1_GRADIENT_STOP stops[2];
-    stops[0].position = 0.0f;
-    stops[0].color = D2D1::ColorF(static_cast<float>(GetRValue(colors.start)) / 255.f,
-                                  static_cast<float>(GetGValue(colors.start)) / 255.f,
-                                  static_cast<float>(GetBValue(colors.start)) / 255.f, 1.f);
-    stops[1].position = 1.0f;
-    stops[1].color = D2D1::ColorF(static_cast<float>(GetRValue(colors.end)) / 255.f,
-                                  static_cast<float>(GetGValue(colors.end)) / 255.f,
-                                  static_cast<float>(GetBValue(colors.end)) / 255.f, 1.f);
-
-    ComPtr<ID2D1GradientStopCollection> collection;
-    hr = dc->CreateGradientStopCollection(stops, 2, D2D1_GAMMA_2_2, D2D1_EXTEND_MODE_CLAMP, &collection);
-    if (FAILED(hr)) {
-        surface->EndDraw();
-        return hr;
-    }
-
-    ComPtr<ID2D1LinearGradientBrush> brush;
-    hr = dc->CreateLinearGradientBrush(D2D1::LinearGradientBrushProperties(D2D1::Point2F(0.f, 0.f),
-                                                                          D2D1::Point2F(0.f, static_cast<float>(height))),
-                                       collection.Get(), &brush);
+    // The update rect starts at offset in the surface's backing store.
+    const UINT32 rows = static_cast<UINT32>(rect.bottom - rect.top);
+    const D2D1_BITMAP_PROPERTIES1 properties = D2D1::BitmapProperties1(
+        D2D1_BITMAP_OPTIONS_NONE, D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED));
+    ComPtr<ID2D1Bitmap1> column;
+    hr = dc->CreateBitmap(D2D1::SizeU(1, rows), ramp->data() + rect.top, sizeof(uint32_t), &properties, &column);
     if (FAILED(hr)) {
         surface->EndDraw();
         return hr;
     }
 
-    dc->FillRectangle(D2D1::RectF(0.f, 0.f, static_cast<float>(width), static_cast<float>(height)), brush.Get());
+    const D2D1_RECT_F destination =
+        D2D1::RectF(static_cast<float>(offset.x), static_cast<float>(offset.y),
+                    static_cast<float>(offset.x + rect.right - rect.left), static_cast<float>(offset.y + rows));
+    dc->DrawBitmap(column.Get(), &destination, 1.0f, D2D1_INTERPOLATION_MODE_NEAREST_NEIGHBOR, nullptr, nullptr);
     hr = dc->EndDraw();
     surface->EndDraw();
     return hr;
@@ -574,23 +615,33 @@ void UpdateTrackedBitmapsLocked(const std::shared_ptr<ExplorerTargetContext>& co
         return;
     }
 
-    if (context->backgroundBitmap) {
-        UpdateGradientBitmap(context->backgroundBitmap, width, height, colors);
-    } else {
-        context->backgroundBitmap = CreateGradientBitmap(width, height, colors);
-        if (context->backgroundBitmap) {
-            TrackBitmap(context->backgroundBitmap, context);
+    const VerticalGradientState next = GradientStateFor(width, height, colors);
+    if (!context->backgroundBitmap || !context->foregroundBitmap || width > context->bitmapCapacity.cx ||
+        height > context->bitmapCapacity.cy) {
+        const SIZE capacity{GrowBitmapExtent(context->bitmapCapacity.cx, width),
+                            GrowBitmapExtent(context->bitmapCapacity.cy, height)};
+        ReleaseOverlayBitmapsLocked(context);
+        ++context->overlayGeneration;
+        context->backgroundBitmap = CreateOverlayBitmap(capacity);
+        context->foregroundBitmap = CreateOverlayBitmap(capacity);
+        if (!context->backgroundBitmap || !context->foregroundBitmap) {
+            ReleaseOverlayBitmapsLocked(context);
+            return;
         }
+        TrackBitmap(context->backgroundBitmap, context);
+        TrackBitmap(context->foregroundBitmap, context);
+        context->bitmapCapacity = capacity;
     }
 
-    if (context->foregroundBitmap) {
-        UpdateGradientBitmap(context->foregroundBitmap, width, height, colors);
-    } else {
-        context->foregroundBitmap = CreateGradientBitmap(width, height, colors);
-        if (context->foregroundBitmap) {
-            TrackBitmap(context->foregroundBitmap, context);
-        }
+    const DirtyRegion damage = VerticalGradientDamage(context->bitmapState, next);
+    if (damage.Empty()) {
+        context->bitmapState = next;
+        return;
     }
+    ++context->overlayGeneration;
+    const bool painted = RepaintOverlayBitmap(context->backgroundBitmap, next, damage) &&
+                         RepaintOverlayBitmap(context->foregroundBitmap, next, damage);
+    context->bitmapState = painted ? next : VerticalGradientState{};
 }
 
 void UpdateGradientSurfacesLocked(const std::shared_ptr<ExplorerTargetContext>& context) {
@@ -612,11 +663,12 @@ void UpdateGradientSurfacesLocked(const std::shared_ptr<ExplorerTargetContext>&
         return;
     }
 
-    bool recreate = !context->backgroundSurface || context->lastSize.cx != width || context->lastSize.cy != height;
-
-    if (recreate) {
+    // Virtual surfaces keep their pixels across a resize, so only the damage
+    // between what they hold and what they should show is drawn.
+    if (!context->backgroundSurface || !context->foregroundSurface) {
         context->backgroundSurface.Reset();
         context->foregroundSurface.Reset();
+        context->surfaceState = {};
         ComPtr<IDCompositionDevice3> device = context->deviceV3;
         if (!device && context->deviceV2) {
             context->deviceV2.As(&device);
@@ -627,30 +679,50 @@ void UpdateGradientSurfacesLocked(const std::shared_ptr<ExplorerTargetContext>&
         if (!device) {
             return;
         }
-        HRESULT hr = device->CreateSurface(width, height, DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_ALPHA_MODE_PREMULTIPLIED,
-                                            &context->backgroundSurface);
+        HRESULT hr = device->CreateVirtualSurface(width, height, DXGI_FORMAT_B8G8R8A8_UNORM,
+                                                  DXGI_ALPHA_MODE_PREMULTIPLIED, &context->backgroundSurface);
+        if (FAILED(hr)) {
+            LogHrFailure(L"CompositionIntercept: CreateVirtualSurface(background)", hr);
+            return;
+        }
+        hr = device->CreateVirtualSurface(width, height, DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_ALPHA_MODE_PREMULTIPLIED,
+                                          &context->foregroundSurface);
         if (FAILED(hr)) {
-            LogHrFailure(L"CompositionIntercept: CreateSurface(background)", hr);
+            LogHrFailure(L"CompositionIntercept: CreateVirtualSurface(foreground)", hr);
+            context->backgroundSurface.Reset();
             return;
         }
-        hr = device->CreateSurface(width, height, DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_ALPHA_MODE_PREMULTIPLIED,
-                                   &context->foregroundSurface);
+    } else if (context->lastSize.cx != width || context->lastSize.cy != height) {
+        HRESULT hr = context->backgroundSurface->Resize(width, height);
+        if (SUCCEEDED(hr)) {
+            hr = context->foregroundSurface->Resize(width, height);
+        }
         if (FAILED(hr)) {
-            LogHrFailure(L"CompositionIntercept: CreateSurface(foreground)", hr);
+            LogHrFailure(L"CompositionIntercept: IDCompositionVirtualSurface::Resize", hr);
+            context->backgroundSurface.Reset();
+            context->foregroundSurface.Reset();
             return;
         }
     }
+    context->lastSize.cx = width;
+    context->lastSize.cy = height;
 
-    HRESULT hr = DrawGradientToSurface(context->backgroundSurface.Get(), width, height, colors);
-    if (FAILED(hr)) {
-        LogHrFailure(L"CompositionIntercept: DrawGradientToSurface(background)", hr);
-        return;
-    }
-    hr = DrawGradientToSurface(context->foregroundSurface.Get(), width, height, colors);
-    if (FAILED(hr)) {
-        LogHrFailure(L"CompositionIntercept: DrawGradientToSurface(foreground)", hr);
-        return;
+    const VerticalGradientState next = GradientStateFor(width, height, colors);
+    const DirtyRegion damage = VerticalGradientDamage(context->surfaceState, next);
+    context->surfaceState = {};
+    for (const DirtyRect& dirty : damage.Rects()) {
+        HRESULT hr = DrawGradientToSurface(context->backgroundSurface.Get(), next, dirty);
+        if (FAILED(hr)) {
+            LogHrFailure(L"CompositionIntercept: DrawGradientToSurface(background)", hr);
+            return;
+        }
+        hr = DrawGradientToSurface(context->foregroundSurface.Get(), next, dirty);
+        if (FAILED(hr)) {
+            LogHrFailure(L"CompositionIntercept: DrawGradientToSurface(foreground)", hr);
+            return;
+        }
     }
+    context->surfaceState = next;
 
     if (context->backgroundVisual) {
         context->backgroundVisual->SetContent(context->backgroundSurface.Get());
@@ -660,8 +732,6 @@ void UpdateGradientSurfacesLocked(const std::shared_ptr<ExplorerTargetContext>&
     }
 
     context->lastColors = colors;
-    context->lastSize.cx = width;
-    context->lastSize.cy = height;
     context->surfacesDirty = false;
     context->hasCachedPaintBounds = false;
     context->hasCachedClipBounds = false;
@@ -936,8 +1006,7 @@ BOOL HandleAlphaBlendCall(GdiAlphaBlendFn original, HDC dest, int destX, int des
     InterceptParams srcParams;
     std::unique_lock<std::mutex> srcLock;
     const bool srcReady = PrepareIntercept(src, srcX, srcY, srcW, srcH, true, srcParams, srcLock) &&
-                          EnsureScratchSurfaceLocked(srcParams.context, srcParams.width, srcParams.height) &&
-                          CopyDcRegionToScratchLocked(srcParams, src);
+                          EnsureScratchSurfaceLocked(srcParams.context, srcParams.width, srcParams.height);
 
     if (srcReady) {
         ApplyGradientOverlayLocked(srcParams);
@@ -946,8 +1015,7 @@ BOOL HandleAlphaBlendCall(GdiAlphaBlendFn original, HDC dest, int destX, int des
     InterceptParams destParams;
     std::unique_lock<std::mutex> destLock;
     const bool destReady = PrepareIntercept(dest, destX, destY, destW, destH, false, destParams, destLock) &&
-                           EnsureScratchSurfaceLocked(destParams.context, destParams.width, destParams.height) &&
-                           CopyDcRegionToScratchLocked(destParams, dest);
+                           EnsureScratchSurfaceLocked(destParams.context, destParams.width, destParams.height);
 
     if (destReady) {
         ApplyGradientOverlayLocked(destParams);
@@ -966,6 +1034,9 @@ BOOL HandleAlphaBlendCall(GdiAlphaBlendFn original, HDC dest, int destX, int des
     BOOL result = original(effectiveDest, effectiveDestX, effectiveDestY, destW, destH, effectiveSrc, effectiveSrcX,
                            effectiveSrcY, effectiveSrcW, effectiveSrcH, blend);
 
+    if (destReady) {
+        MarkScratchDrawnLocked(destParams);
+    }
     if (result && destReady) {
         FlushScratchToDcLocked(destParams, dest);
     }
@@ -1002,8 +1073,7 @@ BOOL HandleBitBltCall(BitBltFn original, HDC dest, int destX, int destY, int wid
     InterceptParams srcParams;
     std::unique_lock<std::mutex> srcLock;
     const bool srcReady = PrepareIntercept(src, srcX, srcY, width, height, true, srcParams, srcLock) &&
-                          EnsureScratchSurfaceLocked(srcParams.context, srcParams.width, srcParams.height) &&
-                          CopyDcRegionToScratchLocked(srcParams, src);
+                          EnsureScratchSurfaceLocked(srcParams.context, srcParams.width, srcParams.height);
 
     if (srcReady) {
         ApplyGradientOverlayLocked(srcParams);
@@ -1012,8 +1082,7 @@ BOOL HandleBitBltCall(BitBltFn original, HDC dest, int destX, int destY, int wid
     InterceptParams destParams;
     std::unique_lock<std::mutex> destLock;
     const bool destReady = PrepareIntercept(dest, destX, destY, width, height, false, destParams, destLock) &&
-                           EnsureScratchSurfaceLocked(destParams.context, destParams.width, destParams.height) &&
-                           CopyDcRegionToScratchLocked(destParams, dest);
+                           EnsureScratchSurfaceLocked(destParams.context, destParams.width, destParams.height);
 
     if (destReady) {
         ApplyGradientOverlayLocked(destParams);
@@ -1030,6 +1099,9 @@ BOOL HandleBitBltCall(BitBltFn original, HDC dest, int destX, int destY, int wid
     BOOL result = original(effectiveDest, effectiveDestX, effectiveDestY, width, height, effectiveSrc, effectiveSrcX,
                            effectiveSrcY, rop);
 
+    if (destReady) {
+        MarkScratchDrawnLocked(destParams);
+    }
     if (result && destReady) {
         FlushScratchToDcLocked(destParams, dest);
     }
@@ -1062,8 +1134,7 @@ BOOL HandleStretchBltCall(StretchBltFn original, HDC dest, int destX, int destY,
     InterceptParams srcParams;
     std::unique_lock<std::mutex> srcLock;
     const bool srcReady = PrepareIntercept(src, srcX, srcY, srcW, srcH, true, srcParams, srcLock) &&
-                          EnsureScratchSurfaceLocked(srcParams.context, srcParams.width, srcParams.height) &&
-                          CopyDcRegionToScratchLocked(srcParams, src);
+                          EnsureScratchSurfaceLocked(srcParams.context, srcParams.width, srcParams.height);
 
     if (srcReady) {
         ApplyGradientOverlayLocked(srcParams);
@@ -1072,8 +1143,7 @@ BOOL HandleStretchBltCall(StretchBltFn original, HDC dest, int destX, int destY,
     InterceptParams destParams;
     std::unique_lock<std::mutex> destLock;
     const bool destReady = PrepareIntercept(dest, destX, destY, destW, destH, false, destParams, destLock) &&
-                           EnsureScratchSurfaceLocked(destParams.context, destParams.width, destParams.height) &&
-                           CopyDcRegionToScratchLocked(destParams, dest);
+                           EnsureScratchSurfaceLocked(destParams.context, destParams.width, destParams.height);
 
     if (destReady) {
         ApplyGradientOverlayLocked(destParams);
@@ -1092,6 +1162,9 @@ BOOL HandleStretchBltCall(StretchBltFn original, HDC dest, int destX, int destY,
     BOOL result = original(effectiveDest, effectiveDestX, effectiveDestY, destW, destH, effectiveSrc, effectiveSrcX,
                            effectiveSrcY, effectiveSrcW, effectiveSrcH, rop);
 
+    if (destReady) {
+        MarkScratchDrawnLocked(destParams);
+    }
     if (result && destReady) {
         FlushScratchToDcLocked(destParams, dest);
     }
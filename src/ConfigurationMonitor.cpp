@@ -0,0 +1,204 @@
+#include "ConfigurationMonitor.h"
+
+#include "ConfigurationService.h"
+#include "GroupStore.h"
+#include "Logging.h"
+#include "OptionsStore.h"
+#include "ShellTabsMessages.h"
+#include "Utilities.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace shelltabs {
+namespace {
+
+constexpr wchar_t kOptionsFileName[] = L"options.db";
+constexpr wchar_t kGroupsFileName[] = L"groups.db";
+constexpr DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+constexpr size_t kNotifyBufferSize = 16 * 1024;
+
+// Watches a single directory with overlapped ReadDirectoryChangesW on a
+// dedicated thread.
+class DirectoryChangeWatcher : public ConfigurationWatcher {
+public:
+    ~DirectoryChangeWatcher() override { Stop(); }
+
+    bool Start(const std::wstring& directory, ChangeCallback callback) override {
+        if (m_directory != INVALID_HANDLE_VALUE || directory.empty() || !callback) {
+            return false;
+        }
+
+        m_directory = CreateFileW(directory.c_str(), FILE_LIST_DIRECTORY,
+                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (m_directory == INVALID_HANDLE_VALUE) {
+            LogLastError(L"DirectoryChangeWatcher CreateFileW", GetLastError());
+            return false;
+        }
+
+        m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        m_ioEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!m_stopEvent || !m_ioEvent) {
+            LogLastError(L"DirectoryChangeWatcher CreateEventW", GetLastError());
+            Stop();
+            return false;
+        }
+
+        m_callback = std::move(callback);
+        m_thread = std::thread([this]() { WatchLoop(); });
+        return true;
+    }
+
+    void Stop() override {
+        if (m_stopEvent) {
+            SetEvent(m_stopEvent);
+        }
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        if (m_directory != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_directory);
+            m_directory = INVALID_HANDLE_VALUE;
+        }
+        if (m_ioEvent) {
+            CloseHandle(m_ioEvent);
+            m_ioEvent = nullptr;
+        }
+        if (m_stopEvent) {
+            CloseHandle(m_stopEvent);
+            m_stopEvent = nullptr;
+        }
+        m_callback = nullptr;
+    }
+
+private:
+    void WatchLoop() {
+        alignas(DWORD) std::array<BYTE, kNotifyBufferSize> buffer{};
+        for (;;) {
+            OVERLAPPED overlapped{};
+            overlapped.hEvent = m_ioEvent;
+            ResetEvent(m_ioEvent);
+            if (!ReadDirectoryChangesW(m_directory, buffer.data(), static_cast<DWORD>(buffer.size()), FALSE,
+                                       kNotifyFilter, nullptr, &overlapped, nullptr)) {
+                LogLastError(L"DirectoryChangeWatcher ReadDirectoryChangesW", GetLastError());
+                return;
+            }
+
+            const HANDLE handles[] = {m_stopEvent, m_ioEvent};
+            const DWORD wait = WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE);
+            DWORD bytes = 0;
+            if (wait != WAIT_OBJECT_0 + 1) {
+                CancelIoEx(m_directory, &overlapped);
+                GetOverlappedResult(m_directory, &overlapped, &bytes, TRUE);
+                return;
+            }
+            if (!GetOverlappedResult(m_directory, &overlapped, &bytes, FALSE)) {
+                LogLastError(L"DirectoryChangeWatcher GetOverlappedResult", GetLastError());
+                return;
+            }
+
+            if (bytes == 0) {
+                // The notification buffer overflowed; re-check every document.
+                m_callback(kOptionsFileName);
+                m_callback(kGroupsFileName);
+                continue;
+            }
+
+            size_t offset = 0;
+            for (;;) {
+                const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer.data() + offset);
+                m_callback(std::wstring_view(info->FileName, info->FileNameLength / sizeof(wchar_t)));
+                if (info->NextEntryOffset == 0) {
+                    break;
+                }
+                offset += info->NextEntryOffset;
+            }
+        }
+    }
+
+    HANDLE m_directory = INVALID_HANDLE_VALUE;
+    HANDLE m_stopEvent = nullptr;
+    HANDLE m_ioEvent = nullptr;
+    ChangeCallback m_callback;
+    std::thread m_thread;
+};
+
+bool ReloadOptions() {
+    auto& store = OptionsStore::Instance();
+    const uint64_t before = store.ChangeGeneration();
+    std::wstring errorContext;
+    if (!store.Load(&errorContext)) {
+        LogMessage(LogLevel::Warning, L"Configuration monitor failed to reload options: %ls", errorContext.c_str());
+        return false;
+    }
+    return store.ChangeGeneration() != before;
+}
+
+bool ReloadSavedGroups() {
+    auto& store = GroupStore::Instance();
+    const uint64_t before = store.ChangeGeneration();
+    std::wstring errorContext;
+    if (!store.Reload(&errorContext)) {
+        LogMessage(LogLevel::Warning, L"Configuration monitor failed to reload saved groups: %ls",
+                   errorContext.c_str());
+        return false;
+    }
+    return store.ChangeGeneration() != before;
+}
+
+void BroadcastUpdate(ConfigurationDocument document, uint64_t generation) {
+    const UINT message = document == ConfigurationDocument::kOptions ? GetOptionsChangedMessage()
+                                                                     : GetSavedGroupsChangedMessage();
+    if (message != 0) {
+        // Generations are counted per process, so the sender's pid rides along
+        // for receivers to tell their own stamps from another Explorer's.
+        SendNotifyMessageW(HWND_BROADCAST, message, static_cast<WPARAM>(generation),
+                           static_cast<LPARAM>(GetCurrentProcessId()));
+    }
+}
+
+std::mutex g_monitorMutex;
+bool g_monitorConfigured = false;
+
+}  // namespace
+
+void EnsureConfigurationMonitorStarted() {
+    std::lock_guard<std::mutex> lock(g_monitorMutex);
+    auto& service = ConfigurationService::Instance();
+    if (!g_monitorConfigured) {
+        service.RegisterDocument(ConfigurationDocument::kOptions, kOptionsFileName, &ReloadOptions);
+        service.RegisterDocument(ConfigurationDocument::kSavedGroups, kGroupsFileName, &ReloadSavedGroups);
+        service.Subscribe(&BroadcastUpdate);
+        g_monitorConfigured = true;
+    }
+    if (service.IsRunning()) {
+        return;
+    }
+
+    const std::wstring directory = GetShellTabsDataDirectory();
+    if (directory.empty()) {
+        return;
+    }
+    if (!service.Start(std::make_unique<DirectoryChangeWatcher>(), directory)) {
+        LogMessage(LogLevel::Warning, L"Configuration monitor could not watch %ls", directory.c_str());
+    }
+}
+
+void StopConfigurationMonitor() {
+    std::lock_guard<std::mutex> lock(g_monitorMutex);
+    ConfigurationService::Instance().Stop();
+}
+
+void AbandonConfigurationMonitor() {
+    // g_monitorMutex is skipped: at process exit its owner may already have
+    // been terminated while holding it.
+    ConfigurationService::Instance().Abandon();
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,259 @@
+#include "ConfigurationService.h"
+
+#include <cwctype>
+
+namespace shelltabs {
+namespace {
+
+bool FileNamesEqual(std::wstring_view left, std::wstring_view right) noexcept {
+    if (left.size() != right.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < left.size(); ++i) {
+        if (std::towlower(left[i]) != std::towlower(right[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Watchers may report a path relative to the watched directory.
+std::wstring_view LeafName(std::wstring_view path) noexcept {
+    const size_t separator = path.find_last_of(L"\\/");
+    return separator == std::wstring_view::npos ? path : path.substr(separator + 1);
+}
+
+size_t DocumentIndex(ConfigurationDocument document) noexcept { return static_cast<size_t>(document); }
+
+}  // namespace
+
+ConfigurationService& ConfigurationService::Instance() {
+    static ConfigurationService service;
+    return service;
+}
+
+ConfigurationService::ConfigurationService(std::chrono::milliseconds debounce) : m_debounce(debounce) {}
+
+ConfigurationService::~ConfigurationService() { Abandon(); }
+
+void ConfigurationService::RegisterDocument(ConfigurationDocument document, std::wstring fileName, Loader loader) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    DocumentState& state = m_documents[DocumentIndex(document)];
+    state.fileName = std::move(fileName);
+    state.loader = std::move(loader);
+    state.deadline.reset();
+}
+
+uint64_t ConfigurationService::Subscribe(Listener listener) {
+    if (!listener) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t token = m_nextListenerToken++;
+    m_listeners.emplace_back(token, std::move(listener));
+    return token;
+}
+
+void ConfigurationService::Unsubscribe(uint64_t token) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_listeners.begin(); it != m_listeners.end(); ++it) {
+        if (it->first == token) {
+            m_listeners.erase(it);
+            return;
+        }
+    }
+}
+
+bool ConfigurationService::Start(std::unique_ptr<ConfigurationWatcher> watcher, const std::wstring& directory,
+                                 bool runDispatcher) {
+    if (!watcher) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_running) {
+            return true;
+        }
+        m_stopRequested = false;
+    }
+
+    const bool started = watcher->Start(directory, [this](std::wstring_view fileName) {
+        NotifyFileChanged(fileName, Clock::now());
+    });
+    if (!started) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_watcher = std::move(watcher);
+    m_running = true;
+    if (runDispatcher) {
+        m_dispatcher = std::thread(&ConfigurationService::DispatcherMain, this);
+    }
+    return true;
+}
+
+void ConfigurationService::Stop() {
+    std::unique_ptr<ConfigurationWatcher> watcher;
+    std::thread dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+        m_stopRequested = true;
+        watcher = std::move(m_watcher);
+        dispatcher = std::move(m_dispatcher);
+        for (auto& state : m_documents) {
+            state.deadline.reset();
+        }
+    }
+    m_wake.notify_all();
+
+    if (watcher) {
+        watcher->Stop();
+    }
+    if (dispatcher.joinable()) {
+        dispatcher.join();
+    }
+}
+
+void ConfigurationService::Abandon() {
+    std::unique_ptr<ConfigurationWatcher> watcher;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+        m_stopRequested = true;
+        watcher = std::move(m_watcher);
+        if (m_dispatcher.joinable()) {
+            m_dispatcher.detach();
+        }
+        for (auto& state : m_documents) {
+            state.deadline.reset();
+        }
+    }
+    m_wake.notify_all();
+    // Destroying the watcher would stop and join its thread.
+    static_cast<void>(watcher.release());
+}
+
+bool ConfigurationService::IsRunning() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_running;
+}
+
+void ConfigurationService::NotifyFileChanged(std::wstring_view fileName, Clock::time_point now) {
+    const std::wstring_view leaf = LeafName(fileName);
+    bool scheduled = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& state : m_documents) {
+            if (!state.loader || !FileNamesEqual(state.fileName, leaf)) {
+                continue;
+            }
+            // Each event pushes the deadline out so a burst of writes from one
+            // save collapses into a single reload.
+            state.deadline = now + m_debounce;
+            scheduled = true;
+        }
+    }
+    if (scheduled) {
+        m_wake.notify_all();
+    }
+}
+
+std::optional<ConfigurationService::Clock::time_point> ConfigurationService::ProcessPendingChanges(
+    Clock::time_point now) {
+    std::lock_guard<std::mutex> reloadLock(m_reloadMutex);
+
+    std::array<Loader, kConfigurationDocumentCount> due{};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_documents.size(); ++i) {
+            DocumentState& state = m_documents[i];
+            if (state.deadline && *state.deadline <= now) {
+                state.deadline.reset();
+                due[i] = state.loader;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < due.size(); ++i) {
+        if (!due[i] || !due[i]()) {
+            continue;
+        }
+        uint64_t generation = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            generation = ++m_documents[i].generation;
+        }
+        NotifyListeners(static_cast<ConfigurationDocument>(i), generation);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return NextDeadlineLocked();
+}
+
+uint64_t ConfigurationService::Publish(ConfigurationDocument document) {
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        generation = ++m_documents[DocumentIndex(document)].generation;
+    }
+    NotifyListeners(document, generation);
+    return generation;
+}
+
+uint64_t ConfigurationService::Generation(ConfigurationDocument document) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_documents[DocumentIndex(document)].generation;
+}
+
+void ConfigurationService::DispatcherMain() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopRequested) {
+        const std::optional<Clock::time_point> deadline = NextDeadlineLocked();
+        if (!deadline) {
+            m_wake.wait(lock);
+            continue;
+        }
+        if (m_wake.wait_until(lock, *deadline) != std::cv_status::timeout && Clock::now() < *deadline) {
+            // Woken early by a new event or Stop; recompute the deadline.
+            continue;
+        }
+        lock.unlock();
+        ProcessPendingChanges(Clock::now());
+        lock.lock();
+    }
+}
+
+void ConfigurationService::NotifyListeners(ConfigurationDocument document, uint64_t generation) {
+    std::vector<Listener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        listeners.reserve(m_listeners.size());
+        for (const auto& entry : m_listeners) {
+            listeners.push_back(entry.second);
+        }
+    }
+    for (const auto& listener : listeners) {
+        listener(document, generation);
+    }
+}
+
+std::optional<ConfigurationService::Clock::time_point> ConfigurationService::NextDeadlineLocked() const {
+    std::optional<Clock::time_point> next;
+    for (const auto& state : m_documents) {
+        if (state.deadline && (!next || *state.deadline < *next)) {
+            next = state.deadline;
+        }
+    }
+    return next;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,353 @@
+#include "ContentHash.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHELLTABS_HASH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SHELLTABS_HASH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SHELLTABS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SHELLTABS_TARGET_AVX2
+#endif
+
+namespace shelltabs {
+namespace {
+
+constexpr uint32_t kPrime32_1 = 0x9E3779B1u;
+constexpr uint32_t kPrime32_2 = 0x85EBCA77u;
+constexpr uint32_t kPrime32_3 = 0xC2B2AE3Du;
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ull;
+
+constexpr size_t kLanes = 8;
+// Stripe n of a block is keyed by kKeys[n..n+7]; the scramble and the two
+// output halves each take eight keys of their own after those.
+constexpr size_t kStripeKeyCount = ContentHasher::kStripesPerBlock + kLanes - 1;
+constexpr size_t kScrambleKeys = kStripeKeyCount;
+constexpr size_t kLowMergeKeys = kScrambleKeys + kLanes;
+constexpr size_t kHighMergeKeys = kLowMergeKeys + kLanes;
+constexpr size_t kKeyCount = kHighMergeKeys + kLanes;
+
+constexpr std::array<uint64_t, kKeyCount> MakeKeys() {
+    std::array<uint64_t, kKeyCount> keys{};
+    uint64_t state = kPrime64_3;
+    for (uint64_t& key : keys) {
+        state += 0x9E3779B97F4A7C15ull;
+        uint64_t value = state;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        key = value ^ (value >> 31);
+    }
+    return keys;
+}
+
+constexpr std::array<uint64_t, kKeyCount> kKeys = MakeKeys();
+
+uint64_t ReadWord(const uint8_t* bytes) noexcept {
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+uint64_t FoldedMultiply(uint64_t left, uint64_t right) noexcept {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = static_cast<unsigned __int128>(left) * right;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high = 0;
+    const uint64_t low = _umul128(left, right, &high);
+    return low ^ high;
+#else
+    const uint64_t leftLow = left & 0xFFFFFFFFu;
+    const uint64_t leftHigh = left >> 32;
+    const uint64_t rightLow = right & 0xFFFFFFFFu;
+    const uint64_t rightHigh = right >> 32;
+    const uint64_t lowLow = leftLow * rightLow;
+    const uint64_t highLow = leftHigh * rightLow;
+    const uint64_t lowHigh = leftLow * rightHigh;
+    const uint64_t highHigh = leftHigh * rightHigh;
+    const uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFFu) + lowHigh;
+    const uint64_t high = (highLow >> 32) + (cross >> 32) + highHigh;
+    const uint64_t low = (cross << 32) | (lowLow & 0xFFFFFFFFu);
+    return low ^ high;
+#endif
+}
+
+uint64_t Avalanche(uint64_t value) noexcept {
+    value ^= value >> 37;
+    value *= 0x165667919E3779F9ull;
+    value ^= value >> 32;
+    return value;
+}
+
+// Each lane gains the product of its keyed word's halves, plus the neighbouring
+// lane's raw word so no input bit is lost when a product is zero.
+void AccumulateScalar(uint64_t* lanes, const uint8_t* stripe, const uint64_t* keys) noexcept {
+    for (size_t i = 0; i < kLanes; ++i) {
+        const uint64_t word = ReadWord(stripe + i * 8);
+        const uint64_t keyed = word ^ keys[i];
+        lanes[i ^ 1] += word;
+        lanes[i] += (keyed & 0xFFFFFFFFu) * (keyed >> 32);
+    }
+}
+
+void ScrambleScalar(uint64_t* lanes) noexcept {
+    for (size_t i = 0; i < kLanes; ++i) {
+        uint64_t lane = lanes[i];
+        lane ^= lane >> 47;
+        lane ^= kKeys[kScrambleKeys + i];
+        lanes[i] = lane * kPrime32_1;
+    }
+}
+
+void ProcessBlockScalar(uint64_t* lanes, const uint8_t* block) noexcept {
+    for (size_t n = 0; n < ContentHasher::kStripesPerBlock; ++n) {
+        AccumulateScalar(lanes, block + n * ContentHasher::kStripeBytes, kKeys.data() + n);
+    }
+    ScrambleScalar(lanes);
+}
+
+#if defined(SHELLTABS_HASH_X86)
+
+void ProcessBlockSse2(uint64_t* lanes, const uint8_t* block) noexcept {
+    __m128i acc[4];
+    for (size_t i = 0; i < 4; ++i) {
+        acc[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(lanes) + i);
+    }
+    for (size_t n = 0; n < ContentHasher::kStripesPerBlock; ++n) {
+        const uint8_t* stripe = block + n * ContentHasher::kStripeBytes;
+        for (size_t i = 0; i < 4; ++i) {
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stripe) + i);
+            const __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i*>(kKeys.data() + n + i * 2));
+            const __m128i keyed = _mm_xor_si128(data, key);
+            const __m128i keyedHigh = _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1));
+            const __m128i product = _mm_mul_epu32(keyed, keyedHigh);
+            const __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+        }
+    }
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(kPrime32_1));
+    for (size_t i = 0; i < 4; ++i) {
+        __m128i lane = _mm_xor_si128(acc[i], _mm_srli_epi64(acc[i], 47));
+        lane = _mm_xor_si128(lane, _mm_loadu_si128(
+                                       reinterpret_cast<const __m128i*>(kKeys.data() + kScrambleKeys + i * 2)));
+        const __m128i low = _mm_mul_epu32(lane, prime);
+        const __m128i high = _mm_mul_epu32(_mm_srli_epi64(lane, 32), prime);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes) + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+}
+
+SHELLTABS_TARGET_AVX2 void ProcessBlockAvx2(uint64_t* lanes, const uint8_t* block) noexcept {
+    __m256i acc[2];
+    for (size_t i = 0; i < 2; ++i) {
+        acc[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes) + i);
+    }
+    for (size_t n = 0; n < ContentHasher::kStripesPerBlock; ++n) {
+        const uint8_t* stripe = block + n * ContentHasher::kStripeBytes;
+        for (size_t i = 0; i < 2; ++i) {
+            const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(stripe) + i);
+            const __m256i key = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(kKeys.data() + n + i * 4));
+            const __m256i keyed = _mm256_xor_si256(data, key);
+            const __m256i keyedHigh = _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1));
+            const __m256i product = _mm256_mul_epu32(keyed, keyedHigh);
+            const __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            acc[i] = _mm256_add_epi64(acc[i], _mm256_add_epi64(product, swapped));
+        }
+    }
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(kPrime32_1));
+    for (size_t i = 0; i < 2; ++i) {
+        __m256i lane = _mm256_xor_si256(acc[i], _mm256_srli_epi64(acc[i], 47));
+        lane = _mm256_xor_si256(lane, _mm256_loadu_si256(
+                                          reinterpret_cast<const __m256i*>(kKeys.data() + kScrambleKeys + i * 4)));
+        const __m256i low = _mm256_mul_epu32(lane, prime);
+        const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(lane, 32), prime);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes) + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+}
+
+bool DetectAvx2() noexcept {
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if (!osSavesYmm) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif  // SHELLTABS_HASH_X86
+
+ContentHashPath ResolvePath(ContentHashPath path) noexcept {
+    if (path != ContentHashPath::kAuto) {
+        return IsContentHashPathSupported(path) ? path : ContentHashPath::kScalar;
+    }
+    if (IsContentHashPathSupported(ContentHashPath::kAvx2)) {
+        return ContentHashPath::kAvx2;
+    }
+    if (IsContentHashPathSupported(ContentHashPath::kSse2)) {
+        return ContentHashPath::kSse2;
+    }
+    return ContentHashPath::kScalar;
+}
+
+void ProcessBlock(ContentHashPath path, uint64_t* lanes, const uint8_t* block) noexcept {
+    switch (path) {
+#if defined(SHELLTABS_HASH_X86)
+        case ContentHashPath::kAvx2:
+            ProcessBlockAvx2(lanes, block);
+            return;
+        case ContentHashPath::kSse2:
+            ProcessBlockSse2(lanes, block);
+            return;
+#endif
+        default:
+            ProcessBlockScalar(lanes, block);
+            return;
+    }
+}
+
+uint64_t MergeLanes(const uint64_t* lanes, size_t keyOffset, uint64_t seed) noexcept {
+    uint64_t result = seed;
+    for (size_t i = 0; i < kLanes; i += 2) {
+        result += FoldedMultiply(lanes[i] ^ kKeys[keyOffset + i], lanes[i + 1] ^ kKeys[keyOffset + i + 1]);
+    }
+    return Avalanche(result);
+}
+
+}  // namespace
+
+ContentHasher::ContentHasher(ContentHashPath path) noexcept
+    : m_lanes{kPrime32_3, kPrime64_1, kPrime64_2, kPrime64_3, kPrime64_4, kPrime32_2, kPrime64_5, kPrime32_1},
+      m_buffer{},
+      m_path(ResolvePath(path)) {}
+
+void ContentHasher::Update(const void* data, size_t size) noexcept {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    m_total += size;
+
+    if (m_buffered > 0) {
+        const size_t take = std::min(size, kBlockBytes - m_buffered);
+        std::memcpy(m_buffer + m_buffered, bytes, take);
+        m_buffered += take;
+        bytes += take;
+        size -= take;
+        if (m_buffered < kBlockBytes) {
+            return;
+        }
+        ProcessBlock(m_path, m_lanes, m_buffer);
+        m_buffered = 0;
+    }
+
+    // Blocks are folded as soon as they are complete, whether they arrive
+    // whole or piecemeal, so chunking never changes the digest.
+    while (size >= kBlockBytes) {
+        ProcessBlock(m_path, m_lanes, bytes);
+        bytes += kBlockBytes;
+        size -= kBlockBytes;
+    }
+    if (size > 0) {
+        std::memcpy(m_buffer, bytes, size);
+        m_buffered = size;
+    }
+}
+
+ContentDigest ContentHasher::Finish() const noexcept {
+    uint64_t lanes[kLanes];
+    std::memcpy(lanes, m_lanes, sizeof(lanes));
+
+    const size_t fullStripes = m_buffered / kStripeBytes;
+    for (size_t n = 0; n < fullStripes; ++n) {
+        AccumulateScalar(lanes, m_buffer + n * kStripeBytes, kKeys.data() + n);
+    }
+    const size_t remainder = m_buffered % kStripeBytes;
+    if (remainder > 0) {
+        // Zero padding is told apart from real zeros by the length below.
+        uint8_t stripe[kStripeBytes] = {};
+        std::memcpy(stripe, m_buffer + fullStripes * kStripeBytes, remainder);
+        AccumulateScalar(lanes, stripe, kKeys.data() + fullStripes);
+    }
+
+    ContentDigest digest;
+    digest.low = MergeLanes(lanes, kLowMergeKeys, m_total * kPrime64_1);
+    digest.high = MergeLanes(lanes, kHighMergeKeys, ~(m_total * kPrime64_2));
+    return digest;
+}
+
+ContentDigest HashContent(const void* data, size_t size, ContentHashPath path) noexcept {
+    ContentHasher hasher(path);
+    hasher.Update(data, size);
+    return hasher.Finish();
+}
+
+bool IsContentHashPathSupported(ContentHashPath path) noexcept {
+    switch (path) {
+        case ContentHashPath::kAuto:
+        case ContentHashPath::kScalar:
+            return true;
+#if defined(SHELLTABS_HASH_X86)
+        case ContentHashPath::kSse2:
+            return true;
+        case ContentHashPath::kAvx2: {
+            static const bool supported = DetectAvx2();
+            return supported;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+std::wstring FormatContentDigest(const ContentDigest& digest) {
+    static constexpr wchar_t kDigits[] = L"0123456789abcdef";
+    std::wstring text(32, L'0');
+    for (size_t i = 0; i < 16; ++i) {
+        text[15 - i] = kDigits[(digest.high >> (i * 4)) & 0xF];
+        text[31 - i] = kDigits[(digest.low >> (i * 4)) & 0xF];
+    }
+    return text;
+}
+
+std::optional<ContentDigest> ParseContentDigest(std::wstring_view text) {
+    if (text.size() != 32) {
+        return std::nullopt;
+    }
+    ContentDigest digest;
+    for (size_t i = 0; i < 32; ++i) {
+        const wchar_t ch = text[i];
+        uint64_t nibble = 0;
+        if (ch >= L'0' && ch <= L'9') {
+            nibble = static_cast<uint64_t>(ch - L'0');
+        } else if (ch >= L'a' && ch <= L'f') {
+            nibble = static_cast<uint64_t>(ch - L'a' + 10);
+        } else if (ch >= L'A' && ch <= L'F') {
+            nibble = static_cast<uint64_t>(ch - L'A' + 10);
+        } else {
+            return std::nullopt;
+        }
+        uint64_t& half = i < 16 ? digest.high : digest.low;
+        half = (half << 4) | nibble;
+    }
+    return digest;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,181 @@
+#include "DirtyRegion.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace shelltabs {
+namespace {
+
+bool Overlaps(const DirtyRect& first, const DirtyRect& second) noexcept {
+    return first.left < second.right && second.left < first.right && first.top < second.bottom &&
+           second.top < first.bottom;
+}
+
+DirtyRect BoundingRect(const DirtyRect& first, const DirtyRect& second) noexcept {
+    return {std::min(first.left, second.left), std::min(first.top, second.top), std::max(first.right, second.right),
+            std::max(first.bottom, second.bottom)};
+}
+
+// Appends the parts of rect outside hole: full-width bands above and below
+// it, then the pieces left and right of it.
+void AppendDifference(const DirtyRect& rect, const DirtyRect& hole, std::vector<DirtyRect>& out) {
+    if (!Overlaps(rect, hole)) {
+        out.push_back(rect);
+        return;
+    }
+    if (hole.top > rect.top) {
+        out.push_back({rect.left, rect.top, rect.right, hole.top});
+    }
+    if (hole.bottom < rect.bottom) {
+        out.push_back({rect.left, hole.bottom, rect.right, rect.bottom});
+    }
+    const int32_t top = std::max(rect.top, hole.top);
+    const int32_t bottom = std::min(rect.bottom, hole.bottom);
+    if (hole.left > rect.left) {
+        out.push_back({rect.left, top, hole.left, bottom});
+    }
+    if (hole.right < rect.right) {
+        out.push_back({hole.right, top, rect.right, bottom});
+    }
+}
+
+bool Joinable(const DirtyRect& first, const DirtyRect& second) noexcept {
+    if (first.top == second.top && first.bottom == second.bottom) {
+        return first.right == second.left || second.right == first.left;
+    }
+    if (first.left == second.left && first.right == second.right) {
+        return first.bottom == second.top || second.bottom == first.top;
+    }
+    return false;
+}
+
+}  // namespace
+
+DirtyRegion::DirtyRegion(size_t maxRects) : m_maxRects(std::max<size_t>(1, maxRects)) {}
+
+void DirtyRegion::Add(const DirtyRect& rect) {
+    if (rect.Empty()) {
+        return;
+    }
+    Insert(rect);
+    JoinNeighbours();
+    while (m_rects.size() > m_maxRects) {
+        MergeCheapestPair();
+        JoinNeighbours();
+    }
+}
+
+void DirtyRegion::Add(const DirtyRegion& region) {
+    for (const DirtyRect& rect : region.m_rects) {
+        Add(rect);
+    }
+}
+
+void DirtyRegion::Clip(const DirtyRect& bounds) {
+    std::vector<DirtyRect> clipped;
+    clipped.reserve(m_rects.size());
+    for (const DirtyRect& rect : m_rects) {
+        const DirtyRect inside{std::max(rect.left, bounds.left), std::max(rect.top, bounds.top),
+                               std::min(rect.right, bounds.right), std::min(rect.bottom, bounds.bottom)};
+        if (!inside.Empty()) {
+            clipped.push_back(inside);
+        }
+    }
+    m_rects = std::move(clipped);
+}
+
+int64_t DirtyRegion::Area() const noexcept {
+    int64_t area = 0;
+    for (const DirtyRect& rect : m_rects) {
+        area += rect.Area();
+    }
+    return area;
+}
+
+DirtyRect DirtyRegion::Bounds() const noexcept {
+    if (m_rects.empty()) {
+        return {};
+    }
+    DirtyRect bounds = m_rects.front();
+    for (const DirtyRect& rect : m_rects) {
+        bounds = BoundingRect(bounds, rect);
+    }
+    return bounds;
+}
+
+void DirtyRegion::Insert(const DirtyRect& rect) {
+    std::vector<DirtyRect> pieces{rect};
+    std::vector<DirtyRect> remaining;
+    for (const DirtyRect& existing : m_rects) {
+        remaining.clear();
+        for (const DirtyRect& piece : pieces) {
+            AppendDifference(piece, existing, remaining);
+        }
+        pieces.swap(remaining);
+        if (pieces.empty()) {
+            return;
+        }
+    }
+    m_rects.insert(m_rects.end(), pieces.begin(), pieces.end());
+}
+
+void DirtyRegion::JoinNeighbours() {
+    bool joined = true;
+    while (joined) {
+        joined = false;
+        for (size_t i = 0; i < m_rects.size() && !joined; ++i) {
+            for (size_t j = i + 1; j < m_rects.size(); ++j) {
+                if (Joinable(m_rects[i], m_rects[j])) {
+                    m_rects[i] = BoundingRect(m_rects[i], m_rects[j]);
+                    m_rects.erase(m_rects.begin() + static_cast<std::ptrdiff_t>(j));
+                    joined = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void DirtyRegion::MergeCheapestPair() {
+    size_t bestFirst = 0;
+    size_t bestSecond = 1;
+    int64_t bestCost = std::numeric_limits<int64_t>::max();
+    for (size_t i = 0; i < m_rects.size(); ++i) {
+        for (size_t j = i + 1; j < m_rects.size(); ++j) {
+            const int64_t cost =
+                BoundingRect(m_rects[i], m_rects[j]).Area() - m_rects[i].Area() - m_rects[j].Area();
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestFirst = i;
+                bestSecond = j;
+            }
+        }
+    }
+
+    // Anything the bounding box reaches into joins it, so every merge leaves
+    // fewer, still disjoint, rectangles.
+    DirtyRect merged = BoundingRect(m_rects[bestFirst], m_rects[bestSecond]);
+    std::vector<DirtyRect> rects;
+    rects.reserve(m_rects.size());
+    for (size_t i = 0; i < m_rects.size(); ++i) {
+        if (i != bestFirst && i != bestSecond) {
+            rects.push_back(m_rects[i]);
+        }
+    }
+    bool grew = true;
+    while (grew) {
+        grew = false;
+        for (size_t i = 0; i < rects.size(); ++i) {
+            if (Overlaps(rects[i], merged)) {
+                merged = BoundingRect(merged, rects[i]);
+                rects.erase(rects.begin() + static_cast<std::ptrdiff_t>(i));
+                grew = true;
+                break;
+            }
+        }
+    }
+    rects.push_back(merged);
+    m_rects = std::move(rects);
+}
+
+}  // namespace shelltabs
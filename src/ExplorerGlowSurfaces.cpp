@@ -4,6 +4,7 @@
 #include "EditGradientRenderer.h"
 
 #include "ExplorerThemeUtils.h"
+#include "GradientSpanCache.h"
 #include "ShellTabsListView.h"
 
 #include <algorithm>
@@ -323,6 +324,31 @@ void FillGradientRect(Gdiplus::Graphics& graphics, const GlowColorSet& colors,
         return;
     }
 
+    // Vertical and horizontal gradients tile a ramp from the shared cache, so
+    // the glow lines down every column and row reuse one precomputed span.
+    const bool vertical = angle == 90.0f;
+    if (vertical || angle == 0.0f) {
+        const GradientColor rampStart{GetRValue(colors.start), GetGValue(colors.start), GetBValue(colors.start),
+                                      alpha};
+        const GradientColor rampEnd{GetRValue(colors.end), GetGValue(colors.end), GetBValue(colors.end), alpha};
+        const INT length = vertical ? rect.Height : rect.Width;
+        const GradientSpanCache::Span ramp =
+            GetGradientSpanCache().Acquire(rampStart, rampEnd, static_cast<uint32_t>(length));
+        if (ramp) {
+            // GDI+ only reads the pixels; the texture brush takes a copy.
+            const INT columns = vertical ? 1 : length;
+            Gdiplus::Bitmap bitmap(columns, vertical ? length : 1, columns * static_cast<INT>(sizeof(uint32_t)),
+                                   PixelFormat32bppPARGB,
+                                   reinterpret_cast<BYTE*>(const_cast<uint32_t*>(ramp->data())));
+            Gdiplus::TextureBrush brush(&bitmap, Gdiplus::WrapModeTile);
+            if (brush.GetLastStatus() == Gdiplus::Ok) {
+                brush.TranslateTransform(static_cast<Gdiplus::REAL>(rect.X), static_cast<Gdiplus::REAL>(rect.Y));
+                graphics.FillRectangle(&brush, rect);
+                return;
+            }
+        }
+    }
+
     Gdiplus::LinearGradientBrush brush(rect, start, end, angle);
     graphics.FillRectangle(&brush, rect);
 }
@@ -0,0 +1,210 @@
+#include "FolderBackgroundIndex.h"
+
+#include <cwctype>
+#include <utility>
+
+namespace shelltabs {
+namespace {
+
+constexpr uint64_t kFnvOffset = 1469598103934665603ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+bool IsPathSeparator(wchar_t ch) noexcept { return ch == L'\\' || ch == L'/'; }
+
+wchar_t FoldCase(wchar_t ch) noexcept { return static_cast<wchar_t>(std::towlower(ch)); }
+
+uint64_t HashComponent(std::wstring_view component) noexcept {
+    uint64_t hash = kFnvOffset;
+    for (wchar_t ch : component) {
+        hash ^= static_cast<uint64_t>(FoldCase(ch));
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+uint64_t MakeEdgeKey(uint32_t parent, uint64_t componentHash) noexcept {
+    uint64_t key = componentHash ^ (static_cast<uint64_t>(parent) * 0x9E3779B97F4A7C15ull);
+    key ^= key >> 29;
+    return key;
+}
+
+bool ComponentsEqual(std::wstring_view left, std::wstring_view right) noexcept {
+    if (left.size() != right.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < left.size(); ++i) {
+        if (left[i] != right[i] && FoldCase(left[i]) != FoldCase(right[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Yields successive non-empty components so that drive roots, UNC prefixes and
+// trailing separators all collapse to the same component sequence.
+class ComponentCursor {
+public:
+    explicit ComponentCursor(std::wstring_view path) noexcept : m_path(path) {}
+
+    bool Next(std::wstring_view* component) noexcept {
+        while (m_offset < m_path.size() && IsPathSeparator(m_path[m_offset])) {
+            ++m_offset;
+        }
+        if (m_offset >= m_path.size()) {
+            return false;
+        }
+        const size_t start = m_offset;
+        while (m_offset < m_path.size() && !IsPathSeparator(m_path[m_offset])) {
+            ++m_offset;
+        }
+        *component = m_path.substr(start, m_offset - start);
+        return true;
+    }
+
+private:
+    std::wstring_view m_path;
+    size_t m_offset = 0;
+};
+
+}  // namespace
+
+void FolderBackgroundIndex::LookupMemo::Clear() noexcept {
+    for (auto& slot : m_slots) {
+        slot.generation = 0;
+        slot.match.reset();
+    }
+    m_nextSlot = 0;
+}
+
+void FolderBackgroundIndex::Clear() {
+    m_nodes.clear();
+    m_edges.clear();
+    m_ruleCount = 0;
+    ++m_generation;
+}
+
+uint64_t FolderBackgroundIndex::EdgeKey(uint32_t parent, uint64_t componentHash) const noexcept {
+    return m_edgeKeyForTest ? m_edgeKeyForTest(parent, componentHash) : MakeEdgeKey(parent, componentHash);
+}
+
+uint32_t FolderBackgroundIndex::FindChild(uint32_t parent, std::wstring_view component,
+                                          uint64_t componentHash) const {
+    uint64_t key = EdgeKey(parent, componentHash);
+    for (;;) {
+        auto it = m_edges.find(key);
+        if (it == m_edges.end()) {
+            return kNoNode;
+        }
+        const Node& candidate = m_nodes[it->second];
+        if (candidate.parent == parent && ComponentsEqual(candidate.component, component)) {
+            return it->second;
+        }
+        // Another edge hashed onto this key; continue probing.
+        ++key;
+    }
+}
+
+uint32_t FolderBackgroundIndex::FindOrAddChild(uint32_t parent, std::wstring_view component,
+                                               uint64_t componentHash) {
+    uint64_t key = EdgeKey(parent, componentHash);
+    for (;;) {
+        auto it = m_edges.find(key);
+        if (it == m_edges.end()) {
+            break;
+        }
+        const Node& candidate = m_nodes[it->second];
+        if (candidate.parent == parent && ComponentsEqual(candidate.component, component)) {
+            return it->second;
+        }
+        ++key;
+    }
+
+    const uint32_t child = static_cast<uint32_t>(m_nodes.size());
+    Node node;
+    node.parent = parent;
+    node.component.assign(component.begin(), component.end());
+    m_nodes.emplace_back(std::move(node));
+    m_edges.emplace(key, child);
+    return child;
+}
+
+bool FolderBackgroundIndex::Insert(std::wstring_view path, uint32_t ruleIndex, bool inheritToSubfolders) {
+    if (m_nodes.empty()) {
+        m_nodes.emplace_back();
+    }
+
+    uint32_t current = kRootNode;
+    bool anyComponent = false;
+    ComponentCursor cursor(path);
+    std::wstring_view component;
+    while (cursor.Next(&component)) {
+        current = FindOrAddChild(current, component, HashComponent(component));
+        anyComponent = true;
+    }
+
+    if (!anyComponent) {
+        return false;
+    }
+
+    Node& node = m_nodes[current];
+    if (node.rule == kNoRule) {
+        ++m_ruleCount;
+    }
+    node.rule = ruleIndex;
+    node.inherit = inheritToSubfolders;
+    ++m_generation;
+    return true;
+}
+
+std::optional<FolderBackgroundIndex::Match> FolderBackgroundIndex::FindMostSpecific(
+    std::wstring_view path) const {
+    if (m_ruleCount == 0) {
+        return std::nullopt;
+    }
+
+    std::optional<Match> best;
+    uint32_t current = kRootNode;
+    ComponentCursor cursor(path);
+    std::wstring_view component;
+    bool walkedAll = true;
+    while (cursor.Next(&component)) {
+        const uint32_t child = FindChild(current, component, HashComponent(component));
+        if (child == kNoNode) {
+            walkedAll = false;
+            break;
+        }
+        current = child;
+        const Node& node = m_nodes[current];
+        if (node.rule != kNoRule && node.inherit) {
+            best = Match{node.rule, false};
+        }
+    }
+
+    if (walkedAll && current != kRootNode && m_nodes[current].rule != kNoRule) {
+        return Match{m_nodes[current].rule, true};
+    }
+    return best;
+}
+
+std::optional<FolderBackgroundIndex::Match> FolderBackgroundIndex::Resolve(std::wstring_view path,
+                                                                           LookupMemo* memo) const {
+    if (!memo) {
+        return FindMostSpecific(path);
+    }
+
+    for (const auto& slot : memo->m_slots) {
+        if (slot.generation == m_generation && slot.path == path) {
+            return slot.match;
+        }
+    }
+
+    std::optional<Match> match = FindMostSpecific(path);
+    auto& slot = memo->m_slots[memo->m_nextSlot];
+    memo->m_nextSlot = (memo->m_nextSlot + 1) % LookupMemo::kCapacity;
+    slot.generation = m_generation;
+    slot.path.assign(path.begin(), path.end());
+    slot.match = match;
+    return match;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,285 @@
+#include "GdiResourceBudget.h"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace shelltabs {
+namespace {
+
+// Shedding aims a tenth below the limit so the next few inserts do not
+// immediately trigger another round.
+size_t ShedTarget(size_t limit) noexcept { return limit - limit / 10; }
+
+void SubtractSaturating(std::atomic<size_t>& counter, size_t amount) noexcept {
+    size_t current = counter.load(std::memory_order_relaxed);
+    while (!counter.compare_exchange_weak(current, current > amount ? current - amount : 0,
+                                          std::memory_order_relaxed)) {
+    }
+}
+
+size_t QueryProcessGdiHandles() {
+#if defined(_WIN32)
+    return static_cast<size_t>(GetGuiResources(GetCurrentProcess(), GR_GDIOBJECTS));
+#else
+    return 0;
+#endif
+}
+
+}  // namespace
+
+GdiResourceCost EstimateBitmapCost(long width, long height, bool withMask) noexcept {
+    GdiResourceCost cost;
+    cost.handles = withMask ? 2 : 1;
+    if (width <= 0 || height <= 0) {
+        return cost;
+    }
+    const size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    cost.bytes = pixels * 4;
+    if (withMask) {
+        // Mask rows are padded to 16 bits.
+        cost.bytes += ((static_cast<size_t>(width) + 15) / 16) * 2 * static_cast<size_t>(height);
+    }
+    return cost;
+}
+
+struct GdiResourceBudget::Client {
+    std::wstring name;
+    Shedder shedder;
+    std::atomic<bool> registered{true};
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> handles{0};
+};
+
+GdiResourceBudget& GdiResourceBudget::Instance() {
+    static GdiResourceBudget budget;
+    return budget;
+}
+
+GdiResourceBudget::GdiResourceBudget() : m_handleCountProvider(&QueryProcessGdiHandles) {
+    m_handleLimit = m_limits.maxHandles;
+}
+
+GdiResourceBudget::ClientHandle GdiResourceBudget::RegisterClient(std::wstring name, Shedder shedder) {
+    auto client = std::make_shared<Client>();
+    client->name = std::move(name);
+    client->shedder = std::move(shedder);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_clients.push_back(client);
+    return client;
+}
+
+void GdiResourceBudget::UnregisterClient(const ClientHandle& client) {
+    if (!client) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::find(m_clients.begin(), m_clients.end(), client);
+        if (it == m_clients.end()) {
+            return;
+        }
+        m_clients.erase(it);
+        client->registered.store(false, std::memory_order_relaxed);
+    }
+    SubtractSaturating(m_bytes, client->bytes.load(std::memory_order_relaxed));
+    SubtractSaturating(m_handles, client->handles.load(std::memory_order_relaxed));
+}
+
+void GdiResourceBudget::Charge(const ClientHandle& client, const GdiResourceCost& cost) noexcept {
+    if (client && client->registered.load(std::memory_order_relaxed)) {
+        client->bytes.fetch_add(cost.bytes, std::memory_order_relaxed);
+        client->handles.fetch_add(cost.handles, std::memory_order_relaxed);
+        m_bytes.fetch_add(cost.bytes, std::memory_order_relaxed);
+        m_handles.fetch_add(cost.handles, std::memory_order_relaxed);
+    }
+}
+
+void GdiResourceBudget::Credit(const ClientHandle& client, const GdiResourceCost& cost) noexcept {
+    if (client && client->registered.load(std::memory_order_relaxed)) {
+        SubtractSaturating(client->bytes, cost.bytes);
+        SubtractSaturating(client->handles, cost.handles);
+        SubtractSaturating(m_bytes, cost.bytes);
+        SubtractSaturating(m_handles, cost.handles);
+    }
+}
+
+GdiResourceCost GdiResourceBudget::ClientUsage(const ClientHandle& client) const {
+    GdiResourceCost usage;
+    if (client) {
+        usage.bytes = client->bytes.load(std::memory_order_relaxed);
+        usage.handles = client->handles.load(std::memory_order_relaxed);
+    }
+    return usage;
+}
+
+bool GdiResourceBudget::Relieve() {
+    if (m_shedding.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+
+    const size_t processHandles = SampleProcessHandles(std::chrono::steady_clock::now());
+    size_t byteLimit = 0;
+    size_t handleLimit = 0;
+    std::vector<std::shared_ptr<Client>> clients;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        byteLimit = m_limits.maxBytes;
+        handleLimit = m_handleLimit;
+        clients = m_clients;
+    }
+
+    const size_t bytes = m_bytes.load(std::memory_order_relaxed);
+    const size_t handles = m_handles.load(std::memory_order_relaxed);
+    if (bytes <= byteLimit && handles <= handleLimit) {
+        m_shedding.store(false, std::memory_order_release);
+        return false;
+    }
+
+    GdiResourceCost remaining;
+    remaining.bytes = bytes > byteLimit ? bytes - ShedTarget(byteLimit) : 0;
+    remaining.handles = handles > handleLimit ? handles - ShedTarget(handleLimit) : 0;
+    const GdiResourceCost requested = remaining;
+
+    // Ask the heaviest handle users first; they free the most per entry.
+    std::sort(clients.begin(), clients.end(), [](const auto& left, const auto& right) {
+        const size_t leftHandles = left->handles.load(std::memory_order_relaxed);
+        const size_t rightHandles = right->handles.load(std::memory_order_relaxed);
+        if (leftHandles != rightHandles) {
+            return leftHandles > rightHandles;
+        }
+        return left->bytes.load(std::memory_order_relaxed) > right->bytes.load(std::memory_order_relaxed);
+    });
+
+    GdiBudgetShedResult total;
+    for (const auto& client : clients) {
+        if (remaining.bytes == 0 && remaining.handles == 0) {
+            break;
+        }
+        if (!client->shedder) {
+            continue;
+        }
+        const GdiBudgetShedResult result = client->shedder(remaining);
+        total.entries += result.entries;
+        total.freed.bytes += result.freed.bytes;
+        total.freed.handles += result.freed.handles;
+        remaining.bytes -= std::min(remaining.bytes, result.freed.bytes);
+        remaining.handles -= std::min(remaining.handles, result.freed.handles);
+    }
+
+    m_pressureEvents.fetch_add(1, std::memory_order_relaxed);
+    m_shedEntries.fetch_add(total.entries, std::memory_order_relaxed);
+    m_shedBytes.fetch_add(total.freed.bytes, std::memory_order_relaxed);
+    m_shedHandles.fetch_add(total.freed.handles, std::memory_order_relaxed);
+
+    std::vector<PressureListener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_listeners) {
+            listeners.push_back(entry.second);
+        }
+    }
+    const GdiBudgetPressure pressure{requested, total, processHandles, handleLimit};
+    for (const auto& listener : listeners) {
+        listener(pressure);
+    }
+
+    m_shedding.store(false, std::memory_order_release);
+    return true;
+}
+
+uint64_t GdiResourceBudget::SubscribePressure(PressureListener listener) {
+    if (!listener) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t token = m_nextToken++;
+    m_listeners.emplace_back(token, std::move(listener));
+    return token;
+}
+
+void GdiResourceBudget::UnsubscribePressure(uint64_t token) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_listeners.begin(); it != m_listeners.end(); ++it) {
+        if (it->first == token) {
+            m_listeners.erase(it);
+            return;
+        }
+    }
+}
+
+void GdiResourceBudget::SetLimits(const GdiBudgetLimits& limits) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_limits = limits;
+    m_handleLimit = HandleLimitLocked(m_processHandles);
+    m_lastSample = {};
+}
+
+GdiBudgetLimits GdiResourceBudget::Limits() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_limits;
+}
+
+void GdiResourceBudget::SetHandleCountProvider(HandleCountProvider provider) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_handleCountProvider = std::move(provider);
+    m_lastSample = {};
+    m_processHandles = 0;
+    m_handleLimit = HandleLimitLocked(m_processHandles);
+}
+
+GdiBudgetCounters GdiResourceBudget::Counters() const {
+    GdiBudgetCounters counters;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        counters.byteLimit = m_limits.maxBytes;
+        counters.handleLimit = m_handleLimit;
+        counters.processHandles = m_processHandles;
+    }
+    counters.bytes = m_bytes.load(std::memory_order_relaxed);
+    counters.handles = m_handles.load(std::memory_order_relaxed);
+    counters.pressureEvents = m_pressureEvents.load(std::memory_order_relaxed);
+    counters.shedEntries = m_shedEntries.load(std::memory_order_relaxed);
+    counters.shedBytes = m_shedBytes.load(std::memory_order_relaxed);
+    counters.shedHandles = m_shedHandles.load(std::memory_order_relaxed);
+    return counters;
+}
+
+size_t GdiResourceBudget::SampleProcessHandles(std::chrono::steady_clock::time_point now) {
+    HandleCountProvider provider;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const bool due = m_lastSample == std::chrono::steady_clock::time_point{} ||
+                         now - m_lastSample >= m_limits.sampleInterval;
+        if (!due || !m_handleCountProvider) {
+            return m_processHandles;
+        }
+        provider = m_handleCountProvider;
+        m_lastSample = now;
+    }
+
+    const size_t processHandles = provider();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_processHandles = processHandles;
+    m_handleLimit = HandleLimitLocked(m_processHandles);
+    return m_processHandles;
+}
+
+size_t GdiResourceBudget::HandleLimitLocked(size_t processHandles) const noexcept {
+    if (processHandles == 0) {
+        return m_limits.maxHandles;
+    }
+    // Handles held by the rest of the process are outside our control; give
+    // the caches what is left below the soft limit.
+    const size_t ours = m_handles.load(std::memory_order_relaxed);
+    const size_t others = processHandles > ours ? processHandles - ours : 0;
+    const size_t softLimit =
+        static_cast<size_t>(static_cast<double>(m_limits.processHandleQuota) * m_limits.softLimitFraction);
+    const size_t available = softLimit > others ? softLimit - others : 0;
+    return std::clamp(available, std::min(m_limits.minHandles, m_limits.maxHandles), m_limits.maxHandles);
+}
+
+}  // namespace shelltabs
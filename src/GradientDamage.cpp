@@ -0,0 +1,63 @@
+#include "GradientDamage.h"
+
+namespace shelltabs {
+namespace {
+
+bool SameColor(const GradientColor& first, const GradientColor& second) noexcept {
+    return first.r == second.r && first.g == second.g && first.b == second.b && first.a == second.a;
+}
+
+DirtyRect FullRect(const VerticalGradientState& state) noexcept {
+    return {0, 0, static_cast<int32_t>(state.width), static_cast<int32_t>(state.height)};
+}
+
+}  // namespace
+
+DirtyRegion VerticalGradientDamage(const VerticalGradientState& previous, const VerticalGradientState& next) {
+    DirtyRegion damage;
+    if (next.Empty()) {
+        return damage;
+    }
+    const bool flat = SameColor(next.start, next.end);
+    if (previous.Empty() || !SameColor(previous.start, next.start) || !SameColor(previous.end, next.end) ||
+        (previous.height != next.height && !flat)) {
+        damage.Add(FullRect(next));
+        return damage;
+    }
+
+    const int32_t width = static_cast<int32_t>(next.width);
+    const int32_t height = static_cast<int32_t>(next.height);
+    const int32_t keptWidth = static_cast<int32_t>(previous.width);
+    const int32_t keptHeight = static_cast<int32_t>(previous.height);
+    damage.Add({keptWidth, 0, width, height});
+    damage.Add({0, keptHeight, width, height});
+    return damage;
+}
+
+bool RepaintVerticalGradient(uint32_t* pixels, size_t stride, const VerticalGradientState& state,
+                             const DirtyRegion& region, GradientSpanCache& cache) {
+    if (!pixels || state.Empty() || stride < state.width) {
+        return false;
+    }
+    if (region.Empty()) {
+        return true;
+    }
+    const GradientSpanCache::Span ramp = cache.Acquire(state.start, state.end, state.height);
+    if (!ramp) {
+        return false;
+    }
+
+    DirtyRegion inside = region;
+    inside.Clip(FullRect(state));
+    for (const DirtyRect& rect : inside.Rects()) {
+        uint32_t* origin = pixels + static_cast<size_t>(rect.top) * stride + static_cast<size_t>(rect.left);
+        if (!FillGradientFromRamp(origin, static_cast<uint32_t>(rect.right - rect.left),
+                                  static_cast<uint32_t>(rect.bottom - rect.top), stride, GradientDirection::kVertical,
+                                  ramp->data() + rect.top)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace shelltabs
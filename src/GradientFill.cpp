@@ -0,0 +1,268 @@
+#include "GradientFill.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHELLTABS_GRADIENT_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SHELLTABS_GRADIENT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SHELLTABS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SHELLTABS_TARGET_AVX2
+#endif
+
+namespace shelltabs {
+namespace {
+
+// Value at step of span between start and end. The integer form is exact;
+// only exact halves, where the old double routine's representation error
+// decided the rounding, go through the old expression.
+uint8_t InterpolateChannel(uint8_t start, uint8_t end, int64_t step, int64_t span) noexcept {
+    const int64_t delta = static_cast<int64_t>(end) - static_cast<int64_t>(start);
+    const int64_t twice = 2 * (static_cast<int64_t>(start) * span + delta * step) + span;
+    if (twice % (2 * span) != 0) {
+        return static_cast<uint8_t>(twice / (2 * span));
+    }
+    const double ratio = static_cast<double>(step) / static_cast<double>(span);
+    return static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(start + delta * ratio)), 0, 255));
+}
+
+uint32_t PremultiplyChannel(uint8_t value, uint8_t alpha) noexcept {
+    return static_cast<uint32_t>(value) * static_cast<uint32_t>(alpha) / 255u;
+}
+
+uint32_t RampPixel(const GradientColor& start, const GradientColor& end, int64_t step, int64_t span) noexcept {
+    const uint8_t r = InterpolateChannel(start.r, end.r, step, span);
+    const uint8_t g = InterpolateChannel(start.g, end.g, step, span);
+    const uint8_t b = InterpolateChannel(start.b, end.b, step, span);
+    const uint8_t a = InterpolateChannel(start.a, end.a, step, span);
+    return (static_cast<uint32_t>(a) << 24) | (PremultiplyChannel(r, a) << 16) | (PremultiplyChannel(g, a) << 8) |
+           PremultiplyChannel(b, a);
+}
+
+using FillRow = void (*)(uint32_t* dest, size_t count, uint32_t pixel);
+using CopyRow = void (*)(uint32_t* dest, const uint32_t* source, size_t count);
+
+void FillRowScalar(uint32_t* dest, size_t count, uint32_t pixel) {
+    for (size_t i = 0; i < count; ++i) {
+        dest[i] = pixel;
+    }
+}
+
+void CopyRowScalar(uint32_t* dest, const uint32_t* source, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dest[i] = source[i];
+    }
+}
+
+#if defined(SHELLTABS_GRADIENT_X86)
+
+void FillRowSse2(uint32_t* dest, size_t count, uint32_t pixel) {
+    const __m128i value = _mm_set1_epi32(static_cast<int>(pixel));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 4), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 12), value);
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), value);
+    }
+    FillRowScalar(dest + i, count - i, pixel);
+}
+
+void CopyRowSse2(uint32_t* dest, const uint32_t* source, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 4));
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 8));
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 4), b);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8), c);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 12), d);
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    }
+    CopyRowScalar(dest + i, source + i, count - i);
+}
+
+SHELLTABS_TARGET_AVX2 void FillRowAvx2(uint32_t* dest, size_t count, uint32_t pixel) {
+    const __m256i value = _mm256_set1_epi32(static_cast<int>(pixel));
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 8), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 16), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 24), value);
+    }
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), value);
+    }
+    FillRowScalar(dest + i, count - i, pixel);
+}
+
+SHELLTABS_TARGET_AVX2 void CopyRowAvx2(uint32_t* dest, const uint32_t* source, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 8));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 16));
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 24));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 8), b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 16), c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 24), d);
+    }
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i),
+                            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i)));
+    }
+    CopyRowScalar(dest + i, source + i, count - i);
+}
+
+bool DetectAvx2() noexcept {
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if (!osSavesYmm) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif  // SHELLTABS_GRADIENT_X86
+
+GradientFillPath ResolvePath(GradientFillPath path) noexcept {
+    if (path != GradientFillPath::kAuto) {
+        return path;
+    }
+    if (IsGradientFillPathSupported(GradientFillPath::kAvx2)) {
+        return GradientFillPath::kAvx2;
+    }
+    if (IsGradientFillPathSupported(GradientFillPath::kSse2)) {
+        return GradientFillPath::kSse2;
+    }
+    return GradientFillPath::kScalar;
+}
+
+}  // namespace
+
+bool IsGradientFillPathSupported(GradientFillPath path) noexcept {
+    switch (path) {
+        case GradientFillPath::kAuto:
+        case GradientFillPath::kScalar:
+            return true;
+#if defined(SHELLTABS_GRADIENT_X86)
+        case GradientFillPath::kSse2:
+            return true;
+        case GradientFillPath::kAvx2: {
+            static const bool supported = DetectAvx2();
+            return supported;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+uint32_t GradientRampLength(GradientDirection direction, uint32_t width, uint32_t height) noexcept {
+    switch (direction) {
+        case GradientDirection::kHorizontal:
+            return width;
+        case GradientDirection::kDiagonal:
+            return width == 0 || height == 0 ? 0 : width + height - 1;
+        default:
+            return height;
+    }
+}
+
+void BuildGradientRamp(const GradientColor& start, const GradientColor& end, uint32_t length, uint32_t* ramp) {
+    const int64_t span = std::max<int64_t>(1, static_cast<int64_t>(length) - 1);
+    for (uint32_t i = 0; i < length; ++i) {
+        ramp[i] = RampPixel(start, end, i, span);
+    }
+}
+
+bool FillGradient(uint32_t* pixels, uint32_t width, uint32_t height, size_t stride, const GradientSpec& spec,
+                  GradientFillPath path) {
+    if (!pixels || width == 0 || height == 0 || stride < width || !IsGradientFillPathSupported(path)) {
+        return false;
+    }
+    std::vector<uint32_t> ramp(GradientRampLength(spec.direction, width, height));
+    BuildGradientRamp(spec.start, spec.end, static_cast<uint32_t>(ramp.size()), ramp.data());
+    return FillGradientFromRamp(pixels, width, height, stride, spec.direction, ramp.data(), path);
+}
+
+bool FillGradientFromRamp(uint32_t* pixels, uint32_t width, uint32_t height, size_t stride,
+                          GradientDirection direction, const uint32_t* ramp, GradientFillPath path) {
+    if (!pixels || !ramp || width == 0 || height == 0 || stride < width || !IsGradientFillPathSupported(path)) {
+        return false;
+    }
+
+    FillRow fill = &FillRowScalar;
+    CopyRow copy = &CopyRowScalar;
+#if defined(SHELLTABS_GRADIENT_X86)
+    switch (ResolvePath(path)) {
+        case GradientFillPath::kAvx2:
+            fill = &FillRowAvx2;
+            copy = &CopyRowAvx2;
+            break;
+        case GradientFillPath::kSse2:
+            fill = &FillRowSse2;
+            copy = &CopyRowSse2;
+            break;
+        default:
+            break;
+    }
+#endif
+
+    switch (direction) {
+        case GradientDirection::kVertical:
+            // Glow lines are a few pixels wide; a call per row would cost
+            // more than the stores.
+            if (width < 8) {
+                for (uint32_t y = 0; y < height; ++y) {
+                    FillRowScalar(pixels + static_cast<size_t>(y) * stride, width, ramp[y]);
+                }
+                break;
+            }
+            for (uint32_t y = 0; y < height; ++y) {
+                fill(pixels + static_cast<size_t>(y) * stride, width, ramp[y]);
+            }
+            break;
+        case GradientDirection::kHorizontal:
+            for (uint32_t y = 0; y < height; ++y) {
+                copy(pixels + static_cast<size_t>(y) * stride, ramp, width);
+            }
+            break;
+        case GradientDirection::kDiagonal:
+            for (uint32_t y = 0; y < height; ++y) {
+                copy(pixels + static_cast<size_t>(y) * stride, ramp + y, width);
+            }
+            break;
+    }
+    return true;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,115 @@
+#include "GradientSpanCache.h"
+
+#include <utility>
+
+namespace shelltabs {
+namespace {
+
+size_t CombineHash(size_t seed, size_t value) noexcept {
+    return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+}
+
+uint32_t PackColor(const GradientColor& color) noexcept {
+    return (static_cast<uint32_t>(color.a) << 24) | (static_cast<uint32_t>(color.r) << 16) |
+           (static_cast<uint32_t>(color.g) << 8) | color.b;
+}
+
+size_t SpanBytes(uint32_t length) noexcept { return static_cast<size_t>(length) * sizeof(uint32_t); }
+
+}  // namespace
+
+size_t GradientSpanKeyHasher::operator()(const GradientSpanKey& key) const noexcept {
+    size_t hash = PackColor(key.start);
+    hash = CombineHash(hash, PackColor(key.end));
+    return CombineHash(hash, key.length);
+}
+
+GradientSpanCache::GradientSpanCache(size_t budgetBytes) : m_budgetBytes(budgetBytes) {}
+
+GradientSpanCache::Span GradientSpanCache::Acquire(const GradientColor& start, const GradientColor& end,
+                                                   uint32_t length) {
+    if (length == 0) {
+        return nullptr;
+    }
+
+    const GradientSpanKey key{start, end, length};
+    {
+        std::scoped_lock lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end()) {
+            ++m_stats.hits;
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+            return it->second.pixels;
+        }
+        ++m_stats.misses;
+    }
+
+    // Ramps are a few kilobytes; build outside the lock and let a racing
+    // builder's copy win.
+    auto pixels = std::make_shared<std::vector<uint32_t>>(length);
+    BuildGradientRamp(start, end, length, pixels->data());
+    Span span = std::move(pixels);
+
+    std::scoped_lock lock(m_mutex);
+    if (SpanBytes(length) > m_budgetBytes) {
+        return span;
+    }
+    auto [it, inserted] = m_entries.try_emplace(key);
+    if (!inserted) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+        return it->second.pixels;
+    }
+    m_lru.push_front(key);
+    it->second.pixels = span;
+    it->second.lru = m_lru.begin();
+    m_stats.residentBytes += SpanBytes(length);
+    ++m_stats.spans;
+    TrimLocked();
+    return span;
+}
+
+bool GradientSpanCache::Fill(uint32_t* pixels, uint32_t width, uint32_t height, size_t stride,
+                             const GradientSpec& spec, GradientFillPath path) {
+    if (!pixels || width == 0 || height == 0 || stride < width) {
+        return false;
+    }
+    const Span span = Acquire(spec.start, spec.end, GradientRampLength(spec.direction, width, height));
+    return span && FillGradientFromRamp(pixels, width, height, stride, spec.direction, span->data(), path);
+}
+
+void GradientSpanCache::Clear() {
+    std::scoped_lock lock(m_mutex);
+    m_entries.clear();
+    m_lru.clear();
+    m_stats.residentBytes = 0;
+    m_stats.spans = 0;
+}
+
+void GradientSpanCache::SetBudget(size_t budgetBytes) {
+    std::scoped_lock lock(m_mutex);
+    m_budgetBytes = budgetBytes;
+    TrimLocked();
+}
+
+GradientSpanCacheStats GradientSpanCache::Stats() const {
+    std::scoped_lock lock(m_mutex);
+    return m_stats;
+}
+
+void GradientSpanCache::TrimLocked() {
+    while (m_stats.residentBytes > m_budgetBytes && !m_lru.empty()) {
+        auto it = m_entries.find(m_lru.back());
+        m_stats.residentBytes -= SpanBytes(it->first.length);
+        --m_stats.spans;
+        ++m_stats.evictions;
+        m_lru.pop_back();
+        m_entries.erase(it);
+    }
+}
+
+GradientSpanCache& GetGradientSpanCache() {
+    static GradientSpanCache cache;
+    return cache;
+}
+
+}  // namespace shelltabs
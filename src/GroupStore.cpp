@@ -16,6 +16,14 @@ constexpr wchar_t kGroupToken[] = L"group";
 constexpr wchar_t kTabToken[] = L"tab";
 constexpr wchar_t kCommentChar = L'#';
 
+bool SavedGroupsEqual(const std::vector<SavedGroup>& left, const std::vector<SavedGroup>& right) {
+    return std::equal(left.begin(), left.end(), right.begin(), right.end(),
+                      [](const SavedGroup& a, const SavedGroup& b) {
+                          return a.name == b.name && a.color == b.color && a.tabPaths == b.tabPaths &&
+                                 a.outlineStyle == b.outlineStyle;
+                      });
+}
+
 }  // namespace
 
 GroupStore& GroupStore::Instance() {
@@ -23,14 +31,20 @@ GroupStore& GroupStore::Instance() {
     return instance;
 }
 
+std::shared_ptr<const std::vector<SavedGroup>> GroupStore::Groups() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_groups;
+}
+
 std::vector<std::wstring> GroupStore::GroupNames() const {
     if (!EnsureLoaded()) {
         return {};
     }
 
+    const auto groups = Groups();
     std::vector<std::wstring> names;
-    names.reserve(m_groups.size());
-    for (const auto& group : m_groups) {
+    names.reserve(groups->size());
+    for (const auto& group : *groups) {
         names.push_back(group.name);
     }
     std::sort(names.begin(), names.end(), [](const std::wstring& a, const std::wstring& b) {
@@ -39,16 +53,17 @@ std::vector<std::wstring> GroupStore::GroupNames() const {
     return names;
 }
 
-const SavedGroup* GroupStore::Find(const std::wstring& name) const {
+std::optional<SavedGroup> GroupStore::Find(const std::wstring& name) const {
     if (!EnsureLoaded()) {
-        return nullptr;
+        return std::nullopt;
     }
-    for (const auto& group : m_groups) {
+    const auto groups = Groups();
+    for (const auto& group : *groups) {
         if (_wcsicmp(group.name.c_str(), name.c_str()) == 0) {
-            return &group;
+            return group;
         }
     }
-    return nullptr;
+    return std::nullopt;
 }
 
 namespace {
@@ -65,24 +80,29 @@ std::wstring FormatLoadError(std::wstring message, DWORD error) {
 }  // namespace
 
 bool GroupStore::Load(std::wstring* errorContext) {
-    if (m_loaded) {
-        if (errorContext) {
-            errorContext->clear();
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_loaded) {
+            if (errorContext) {
+                errorContext->clear();
+            }
+            return true;
         }
-        return true;
     }
+    return ReadLocked(errorContext);
+}
 
+bool GroupStore::ReadLocked(std::wstring* errorContext) {
     const std::wstring path = ResolveStoragePath();
     if (path.empty()) {
         if (errorContext) {
             *errorContext = L"Group store path unavailable";
         }
-        m_loaded = false;
         return false;
     }
 
     m_storagePath = path;
-    m_groups.clear();
 
     std::wstring content;
     if (!ReadUtf8File(path, &content)) {
@@ -92,18 +112,10 @@ bool GroupStore::Load(std::wstring* errorContext) {
             message += path;
             *errorContext = FormatLoadError(std::move(message), readError);
         }
-        m_loaded = false;
         return false;
     }
 
-    if (content.empty()) {
-        m_loaded = true;
-        if (errorContext) {
-            errorContext->clear();
-        }
-        return true;
-    }
-
+    auto groups = std::make_shared<GroupList>();
     SavedGroup* currentGroup = nullptr;
     int version = 1;
 
@@ -137,8 +149,8 @@ bool GroupStore::Load(std::wstring* errorContext) {
                 group.outlineStyle =
                     ParseOutlineStyle(outlineToken, TabGroupOutlineStyle::kSolid);
             }
-            m_groups.emplace_back(std::move(group));
-            currentGroup = &m_groups.back();
+            groups->emplace_back(std::move(group));
+            currentGroup = &groups->back();
             return true;
         }
 
@@ -152,7 +164,11 @@ bool GroupStore::Load(std::wstring* errorContext) {
         return true;
     });
 
-    m_loaded = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_groups = std::move(groups);
+        m_loaded = true;
+    }
     if (errorContext) {
         errorContext->clear();
     }
@@ -163,7 +179,11 @@ bool GroupStore::Save() const {
     if (!EnsureLoaded()) {
         return false;
     }
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    return WriteLocked(*Groups());
+}
 
+bool GroupStore::WriteLocked(const GroupList& groups) const {
     std::wstring path = m_storagePath;
     if (path.empty()) {
         path = ResolveStoragePath();
@@ -184,7 +204,7 @@ bool GroupStore::Save() const {
     std::wstring content;
     content += kVersionToken;
     content += L"|2\n";
-    for (const auto& group : m_groups) {
+    for (const auto& group : groups) {
         content += kGroupToken;
         content += L"|" + group.name + L"|" + ColorToString(group.color) + L"|" +
                    OutlineStyleToString(group.outlineStyle) + L"\n";
@@ -197,74 +217,118 @@ bool GroupStore::Save() const {
     return WriteUtf8File(path, content);
 }
 
-bool GroupStore::Upsert(SavedGroup group) {
+bool GroupStore::Update(const std::function<bool(GroupList& groups)>& edit) {
     if (!EnsureLoaded()) {
         return false;
     }
 
-    for (auto& existing : m_groups) {
-        if (_wcsicmp(existing.name.c_str(), group.name.c_str()) == 0) {
-            existing.name = group.name;
-            existing.color = group.color;
-            existing.tabPaths = std::move(group.tabPaths);
-            existing.outlineStyle = group.outlineStyle;
-            return Save();
-        }
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    auto groups = std::make_shared<GroupList>(*Groups());
+    if (!edit(*groups)) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_groups = groups;
     }
+    return WriteLocked(*groups);
+}
 
-    m_groups.emplace_back(std::move(group));
-    return Save();
+bool GroupStore::Upsert(SavedGroup group) {
+    return Update([&](GroupList& groups) {
+        for (auto& existing : groups) {
+            if (_wcsicmp(existing.name.c_str(), group.name.c_str()) == 0) {
+                existing.name = group.name;
+                existing.color = group.color;
+                existing.tabPaths = std::move(group.tabPaths);
+                existing.outlineStyle = group.outlineStyle;
+                return true;
+            }
+        }
+        groups.emplace_back(std::move(group));
+        return true;
+    });
 }
 
 bool GroupStore::UpdateTabs(const std::wstring& name, const std::vector<std::wstring>& tabPaths) {
-    if (!EnsureLoaded()) {
-        return false;
-    }
-
-    for (auto& group : m_groups) {
-        if (_wcsicmp(group.name.c_str(), name.c_str()) == 0) {
-            group.tabPaths = tabPaths;
-            return Save();
+    return Update([&](GroupList& groups) {
+        for (auto& group : groups) {
+            if (_wcsicmp(group.name.c_str(), name.c_str()) == 0) {
+                group.tabPaths = tabPaths;
+                return true;
+            }
         }
-    }
-    return false;
+        return false;
+    });
 }
 
 bool GroupStore::UpdateColor(const std::wstring& name, COLORREF color) {
-    if (!EnsureLoaded()) {
+    return Update([&](GroupList& groups) {
+        for (auto& group : groups) {
+            if (_wcsicmp(group.name.c_str(), name.c_str()) == 0) {
+                group.color = color;
+                return true;
+            }
+        }
         return false;
-    }
+    });
+}
 
-    for (auto& group : m_groups) {
-        if (_wcsicmp(group.name.c_str(), name.c_str()) == 0) {
-            group.color = color;
-            return Save();
+bool GroupStore::Remove(const std::wstring& name) {
+    return Update([&](GroupList& groups) {
+        auto it = std::remove_if(groups.begin(), groups.end(), [&](const SavedGroup& group) {
+            return _wcsicmp(group.name.c_str(), name.c_str()) == 0;
+        });
+        if (it == groups.end()) {
+            return false;
         }
-    }
-    return false;
+        groups.erase(it, groups.end());
+        return true;
+    });
 }
 
-bool GroupStore::Remove(const std::wstring& name) {
-    if (!EnsureLoaded()) {
-        return false;
+bool GroupStore::Reload(std::wstring* errorContext) {
+    std::lock_guard<std::mutex> writeLock(m_writeMutex);
+    bool wasLoaded = false;
+    std::shared_ptr<const GroupList> previousGroups;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        wasLoaded = m_loaded;
+        previousGroups = m_groups;
     }
-    auto it = std::remove_if(m_groups.begin(), m_groups.end(), [&](const SavedGroup& group) {
-        return _wcsicmp(group.name.c_str(), name.c_str()) == 0;
-    });
-    if (it == m_groups.end()) {
+    if (!ReadLocked(errorContext)) {
         return false;
     }
-    m_groups.erase(it, m_groups.end());
-    return Save();
+    if (wasLoaded && !SavedGroupsEqual(*previousGroups, *Groups())) {
+        // External edits carry no rename or removal history.
+        RecordChanges({}, {});
+    }
+    return true;
 }
 
 void GroupStore::RecordChanges(const std::vector<std::pair<std::wstring, std::wstring>>& renamedGroups,
                                const std::vector<std::wstring>& removedGroupIds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
     ++m_changeGeneration;
     m_lastRenamedGroups = renamedGroups;
     m_lastRemovedGroups = removedGroupIds;
 }
 
+uint64_t GroupStore::ChangeGeneration() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_changeGeneration;
+}
+
+std::vector<std::pair<std::wstring, std::wstring>> GroupStore::LastRenamedGroups() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastRenamedGroups;
+}
+
+std::vector<std::wstring> GroupStore::LastRemovedGroups() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastRemovedGroups;
+}
+
 std::wstring GroupStore::ResolveStoragePath() const {
     std::wstring base = GetShellTabsDataDirectory();
     if (base.empty()) {
@@ -279,14 +343,16 @@ std::wstring GroupStore::ResolveStoragePath() const {
 }
 
 bool GroupStore::EnsureLoaded(std::wstring* errorContext) const {
-    if (!m_loaded) {
-        if (!const_cast<GroupStore*>(this)->Load(errorContext)) {
-            return false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_loaded) {
+            if (errorContext) {
+                errorContext->clear();
+            }
+            return true;
         }
-    } else if (errorContext) {
-        errorContext->clear();
     }
-    return m_loaded;
+    return const_cast<GroupStore*>(this)->Load(errorContext);
 }
 
 }  // namespace shelltabs
@@ -1,5 +1,6 @@
 #include "IconCache.h"
 
+#include "CacheTraceRecorder.h"
 #include "Logging.h"
 #include "Utilities.h"
 
@@ -11,6 +12,14 @@ namespace shelltabs {
 
 namespace {
 constexpr uint64_t kLogInterval = 50;
+// Expired negative entries are only swept once a shard has collected this many.
+constexpr size_t kNegativeSweepThreshold = 64;
+// Assumed edge length when an icon's bitmaps cannot be inspected.
+constexpr long kFallbackIconEdge = 32;
+
+void TraceIconAccess(CacheTraceEvent event, uint64_t variantKey, size_t bytes) noexcept {
+    CacheTraceRecorder::Instance().Record(CacheTraceSource::kIcon, event, variantKey, bytes);
+}
 
 std::optional<SIZE> ExtractIconMetrics(HICON icon) {
     if (!icon) {
@@ -189,6 +198,14 @@ void IconCache::Reference::ReleaseCurrent() noexcept {
     m_icon = nullptr;
 }
 
+IconCache::IconCache() {
+    for (Shard& shard : m_shards) {
+        shard.policy = CreateCachePolicy(CacheEvictionPolicy::kLru, shard.capacity);
+    }
+    m_budgetClient = GdiResourceBudget::Instance().RegisterClient(
+        L"IconCache", [this](const GdiResourceCost& excess) { return ShedColdEntries(excess); });
+}
+
 IconCache::Reference IconCache::MakeUncachedReference(HICON icon) {
     return Reference(nullptr, nullptr, icon, false);
 }
@@ -207,54 +224,93 @@ IconCache::Reference IconCache::Acquire(const std::wstring& familyKey, UINT icon
         return MakeUncachedReference(loader());
     }
 
-    const std::wstring variantKey = BuildVariantKey(familyKey, variantFlags);
+    const bool large = (variantFlags & SHGFI_LARGEICON) != 0;
+    const uint64_t familyHash = HashFamily(familyKey);
+    const uint64_t variantKey = VariantKey(familyHash, large);
+    const size_t shardIndex = ShardIndex(familyHash);
+    Shard& shard = m_shards[shardIndex];
 
     std::vector<HICON> destroyList;
-    std::optional<StatsSnapshot> snapshot;
     Entry* entry = nullptr;
+    bool collided = false;
+    bool inserted = false;
     {
-        std::unique_lock lock(m_mutex);
-        auto it = m_entries.find(variantKey);
-        if (it != m_entries.end()) {
-            entry = it->second.get();
-            ++entry->refCount;
-            Touch(entry);
-            ++m_hits;
-            ++m_requestsSinceLog;
-            snapshot = LogStatsIfNeededLocked();
-        } else {
-            ++m_misses;
-            ++m_requestsSinceLog;
+        std::unique_lock lock(shard.mutex);
+        bool shouldLoad = false;
+        bool waited = false;
+        for (;;) {
+            auto it = shard.entries.find(variantKey);
+            if (it != shard.entries.end()) {
+                if (it->second->large != large || it->second->family != familyKey) {
+                    ++shard.collisions;
+                    collided = true;
+                    break;
+                }
+                entry = it->second.get();
+                entry->refCount.fetch_add(1, std::memory_order_relaxed);
+                shard.policy->OnAccess(entry);
+                ++(waited ? shard.coalesced : shard.hits);
+                TraceIconAccess(CacheTraceEvent::kHit, variantKey, entry->cost.bytes);
+                break;
+            }
+            if (IsNegativeLocked(shard, variantKey, familyKey, large, std::chrono::steady_clock::now())) {
+                ++(waited ? shard.coalesced : shard.negativeHits);
+                TraceIconAccess(CacheTraceEvent::kHit, variantKey, 0);
+                break;
+            }
+            auto flight = shard.inFlight.find(variantKey);
+            if (flight == shard.inFlight.end()) {
+                ++shard.misses;
+                TraceIconAccess(CacheTraceEvent::kMiss, variantKey, 0);
+                shard.inFlight.emplace(variantKey, std::make_shared<InFlightLoad>());
+                shouldLoad = true;
+                break;
+            }
+            // Another thread is loading this variant; wait for it and look
+            // again. If its icon was already trimmed we become the loader.
+            std::shared_ptr<InFlightLoad> load = flight->second;
+            shard.loadFinished.wait(lock, [&load]() { return load->done; });
+            waited = true;
+        }
+
+        if (shouldLoad) {
             lock.unlock();
-            HICON icon = loader();
-            if (!icon) {
-                return {};
+            HICON icon = nullptr;
+            try {
+                icon = loader();
+            } catch (...) {
+                lock.lock();
+                FinishLoadLocked(shard, variantKey);
+                throw;
             }
             std::optional<SIZE> metrics = ExtractIconMetrics(icon);
             lock.lock();
-            auto retry = m_entries.find(variantKey);
-            if (retry != m_entries.end()) {
-                destroyList.push_back(icon);
-                entry = retry->second.get();
-                ++entry->refCount;
-                Touch(entry);
+            if (!icon) {
+                RememberNegativeLocked(shard, variantKey, familyKey, large, std::chrono::steady_clock::now());
             } else {
                 auto newEntry = std::make_unique<Entry>();
                 newEntry->key = variantKey;
                 newEntry->family = familyKey;
+                newEntry->large = large;
                 newEntry->icon = icon;
                 if (metrics.has_value()) {
                     newEntry->metrics = *metrics;
                     newEntry->hasMetrics = true;
+                    newEntry->cost = EstimateBitmapCost(metrics->cx, metrics->cy, true);
+                } else {
+                    newEntry->cost = EstimateBitmapCost(kFallbackIconEdge, kFallbackIconEdge, true);
                 }
-                newEntry->refCount = 1;
-                newEntry->lruIt = m_lru.insert(m_lru.begin(), variantKey);
+                newEntry->refCount.store(1, std::memory_order_relaxed);
+                newEntry->shard = shardIndex;
                 entry = newEntry.get();
-                newEntry->familyIt = m_familyIndex.emplace(familyKey, entry);
-                m_entries.emplace(variantKey, std::move(newEntry));
-                TrimLocked(&destroyList);
+                shard.entries.emplace(variantKey, std::move(newEntry));
+                shard.policy->OnInsert(entry);
+                GdiResourceBudget::Instance().Charge(m_budgetClient, entry->cost);
+                TraceIconAccess(CacheTraceEvent::kInsert, variantKey, entry->cost.bytes);
+                inserted = true;
+                TrimLocked(shard, &destroyList);
             }
-            snapshot = LogStatsIfNeededLocked();
+            FinishLoadLocked(shard, variantKey);
         }
     }
 
@@ -264,14 +320,16 @@ IconCache::Reference IconCache::Acquire(const std::wstring& familyKey, UINT icon
         }
     }
 
-    if (snapshot.has_value()) {
-        const double total = static_cast<double>(snapshot->hits + snapshot->misses);
-        const double hitRate = total > 0.0 ? (static_cast<double>(snapshot->hits) / total) * 100.0 : 0.0;
-        LogMessage(LogLevel::Info,
-                   L"IconCache stats: size=%zu hits=%llu misses=%llu evictions=%llu hitRate=%.1f%%",
-                   snapshot->size, static_cast<unsigned long long>(snapshot->hits),
-                   static_cast<unsigned long long>(snapshot->misses),
-                   static_cast<unsigned long long>(snapshot->evictions), hitRate);
+    if (inserted) {
+        GdiResourceBudget::Instance().Relieve();
+    }
+
+    if (const std::optional<Stats> stats = CountRequest()) {
+        LogStats(*stats);
+    }
+
+    if (collided) {
+        return MakeUncachedReference(loader());
     }
 
     if (!entry) {
@@ -286,53 +344,40 @@ void IconCache::InvalidateFamily(const std::wstring& familyKey) {
         return;
     }
 
+    const uint64_t familyHash = HashFamily(familyKey);
+    Shard& shard = m_shards[ShardIndex(familyHash)];
     std::vector<HICON> destroyList;
-    std::vector<Entry*> toInvalidate;
     {
-        std::unique_lock lock(m_mutex);
-        auto range = m_familyIndex.equal_range(familyKey);
-        for (auto it = range.first; it != range.second; ++it) {
-            if (it->second) {
-                toInvalidate.push_back(it->second);
+        std::unique_lock lock(shard.mutex);
+        size_t touched = 0;
+        for (const bool large : {false, true}) {
+            const uint64_t variantKey = VariantKey(familyHash, large);
+            auto negative = shard.negative.find(variantKey);
+            if (negative != shard.negative.end() && negative->second.family == familyKey) {
+                shard.negative.erase(negative);
             }
-        }
-#if defined(SHELLTABS_BUILD_TESTS)
-        m_debugLastFamilyInvalidationCount = toInvalidate.size();
-#endif
 
-        for (Entry* entry : toInvalidate) {
-            if (!entry) {
-                continue;
-            }
-            auto mapIt = m_entries.find(entry->key);
-            if (mapIt == m_entries.end() || mapIt->second.get() != entry) {
+            auto mapIt = shard.entries.find(variantKey);
+            if (mapIt == shard.entries.end() || mapIt->second->family != familyKey) {
                 continue;
             }
-            if (entry->refCount > 0) {
-                entry->stale = true;
-                std::wstring newKey = entry->key + L"#stale" + std::to_wstring(m_nextToken++);
-                if (entry->lruIt != m_lru.end()) {
-                    *entry->lruIt = newKey;
-                }
-                auto node = m_entries.extract(mapIt);
-                entry->key = std::move(newKey);
-                node.key() = entry->key;
-                m_entries.insert(std::move(node));
+            Entry* entry = mapIt->second.get();
+            ++touched;
+            if (entry->refCount.load(std::memory_order_acquire) == 0) {
+                EraseLocked(shard, entry, false, &destroyList);
                 continue;
             }
 
-            entry->stale = false;
-            destroyList.push_back(entry->icon);
-            if (entry->lruIt != m_lru.end()) {
-                m_lru.erase(entry->lruIt);
-            }
-            auto familyIt = entry->familyIt;
-            if (familyIt != m_familyIndex.end()) {
-                m_familyIndex.erase(familyIt);
-            }
-            m_entries.erase(mapIt);
-            ++m_evictions;
+            // Still on screen somewhere: unlink it so the next Acquire loads a
+            // fresh icon, and let the last Release destroy the old handle.
+            shard.policy->OnRemove(entry, false);
+            TraceIconAccess(CacheTraceEvent::kInvalidate, variantKey, entry->cost.bytes);
+            shard.stale.emplace(entry, std::move(mapIt->second));
+            shard.entries.erase(mapIt);
         }
+#if defined(SHELLTABS_BUILD_TESTS)
+        m_debugLastFamilyInvalidationCount.store(touched, std::memory_order_relaxed);
+#endif
     }
 
     for (HICON icon : destroyList) {
@@ -350,30 +395,51 @@ void IconCache::InvalidatePath(const std::wstring& path) {
     InvalidateFamily(BuildIconCacheFamilyKey(nullptr, path));
 }
 
-void IconCache::LogStatsNow() {
-    StatsSnapshot snapshot;
-    {
-        std::unique_lock lock(m_mutex);
-        snapshot.hits = m_hits;
-        snapshot.misses = m_misses;
-        snapshot.evictions = m_evictions;
-        snapshot.size = m_entries.size();
+void IconCache::LogStatsNow() { LogStats(GetStats()); }
+
+IconCache::Stats IconCache::GetStats() {
+    Stats stats;
+    for (Shard& shard : m_shards) {
+        std::unique_lock lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.coalesced += shard.coalesced;
+        stats.negativeHits += shard.negativeHits;
+        stats.collisions += shard.collisions;
+        stats.evictions += shard.evictions;
+        stats.size += shard.entries.size();
+        stats.largestShard = std::max(stats.largestShard, shard.entries.size());
+    }
+    return stats;
+}
+
+void IconCache::SetEvictionPolicy(CacheEvictionPolicy policy) {
+    std::vector<HICON> destroyList;
+    for (Shard& shard : m_shards) {
+        std::unique_lock lock(shard.mutex);
+        shard.policy = CreateCachePolicy(policy, shard.capacity);
+        // Recency is not carried over; the new policy sees the current
+        // entries as freshly inserted.
+        for (auto& [key, entry] : shard.entries) {
+            shard.policy->OnInsert(entry.get());
+        }
+        TrimLocked(shard, &destroyList);
+    }
+    for (HICON icon : destroyList) {
+        if (icon) {
+            DestroyIcon(icon);
+        }
     }
-    const double total = static_cast<double>(snapshot.hits + snapshot.misses);
-    const double hitRate = total > 0.0 ? (static_cast<double>(snapshot.hits) / total) * 100.0 : 0.0;
-    LogMessage(LogLevel::Info, L"IconCache stats: size=%zu hits=%llu misses=%llu evictions=%llu hitRate=%.1f%%",
-               snapshot.size, static_cast<unsigned long long>(snapshot.hits),
-               static_cast<unsigned long long>(snapshot.misses),
-               static_cast<unsigned long long>(snapshot.evictions), hitRate);
 }
 
 #if defined(SHELLTABS_BUILD_TESTS)
 void IconCache::DebugSetCapacity(size_t capacity) {
     std::vector<HICON> destroyList;
-    {
-        std::unique_lock lock(m_mutex);
-        m_capacity = capacity;
-        TrimLocked(&destroyList);
+    for (Shard& shard : m_shards) {
+        std::unique_lock lock(shard.mutex);
+        shard.capacity = ShardCapacity(capacity);
+        shard.policy->SetCapacity(shard.capacity);
+        TrimLocked(shard, &destroyList);
     }
     for (HICON icon : destroyList) {
         if (icon) {
@@ -382,111 +448,189 @@ void IconCache::DebugSetCapacity(size_t capacity) {
     }
 }
 
+void IconCache::DebugSetNegativeTtl(std::chrono::milliseconds ttl) {
+    m_negativeTtlMs.store(ttl.count(), std::memory_order_relaxed);
+}
+
 size_t IconCache::DebugGetLastFamilyInvalidationCount() {
-    std::unique_lock lock(m_mutex);
-    return m_debugLastFamilyInvalidationCount;
+    return m_debugLastFamilyInvalidationCount.load(std::memory_order_relaxed);
 }
 
 void IconCache::DebugResetLastFamilyInvalidationCount() {
-    std::unique_lock lock(m_mutex);
-    m_debugLastFamilyInvalidationCount = 0;
+    m_debugLastFamilyInvalidationCount.store(0, std::memory_order_relaxed);
 }
 #endif
 
-std::wstring IconCache::BuildVariantKey(const std::wstring& familyKey, UINT iconFlags) {
-    std::wstring result = familyKey;
-    result.push_back(L'|');
-    if ((iconFlags & SHGFI_LARGEICON) != 0) {
-        result.push_back(L'L');
-    } else {
-        result.push_back(L'S');
-    }
-    return result;
+uint64_t IconCache::HashFamily(const std::wstring& familyKey) noexcept {
+    return HashCacheKey(std::string_view(reinterpret_cast<const char*>(familyKey.data()),
+                                         familyKey.size() * sizeof(wchar_t)));
 }
 
-void IconCache::Touch(Entry* entry) {
-    if (!entry) {
+uint64_t IconCache::VariantKey(uint64_t familyHash, bool large) noexcept {
+    return large ? familyHash ^ 0x9E3779B97F4A7C15ull : familyHash;
+}
+
+size_t IconCache::ShardIndex(uint64_t familyHash) noexcept {
+    // High bits, so the shard does not correlate with the bucket index the
+    // shard's own hash map derives from the low bits.
+    return static_cast<size_t>(familyHash >> 32) % kShardCount;
+}
+
+size_t IconCache::ShardCapacity(size_t capacity) noexcept {
+    return std::max<size_t>(1, (capacity + kShardCount - 1) / kShardCount);
+}
+
+bool IconCache::IsEvictable(const CachePolicyNode& node) {
+    return static_cast<const Entry&>(node).refCount.load(std::memory_order_acquire) == 0;
+}
+
+void IconCache::EraseLocked(Shard& shard, Entry* entry, bool evicted, std::vector<HICON>* destroyList) {
+    destroyList->push_back(entry->icon);
+    GdiResourceBudget::Instance().Credit(m_budgetClient, entry->cost);
+    shard.policy->OnRemove(entry, evicted);
+    TraceIconAccess(evicted ? CacheTraceEvent::kEvict : CacheTraceEvent::kInvalidate, entry->key, entry->cost.bytes);
+    shard.entries.erase(entry->key);
+    ++shard.evictions;
+}
+
+void IconCache::TrimLocked(Shard& shard, std::vector<HICON>* destroyList) {
+    if (!destroyList) {
         return;
     }
-    if (entry->lruIt != m_lru.begin()) {
-        m_lru.splice(m_lru.begin(), m_lru, entry->lruIt);
+    while (shard.entries.size() > shard.capacity) {
+        CachePolicyNode* victim = shard.policy->SelectVictim(&IsEvictable);
+        if (!victim) {
+            break;
+        }
+        EraseLocked(shard, static_cast<Entry*>(victim), true, destroyList);
     }
 }
 
-std::optional<IconCache::StatsSnapshot> IconCache::LogStatsIfNeededLocked() {
-    if (m_requestsSinceLog < kLogInterval) {
-        return std::nullopt;
+GdiBudgetShedResult IconCache::ShedColdEntries(const GdiResourceCost& excess) {
+    GdiBudgetShedResult result;
+    std::vector<HICON> destroyList;
+    // Take one victim per shard per pass so every shard gives up its coldest
+    // entries rather than emptying whichever shard comes first.
+    bool progress = true;
+    while (progress && (result.freed.bytes < excess.bytes || result.freed.handles < excess.handles)) {
+        progress = false;
+        for (Shard& shard : m_shards) {
+            std::unique_lock lock(shard.mutex);
+            CachePolicyNode* victim = shard.policy->SelectVictim(&IsEvictable);
+            if (!victim) {
+                continue;
+            }
+            Entry* entry = static_cast<Entry*>(victim);
+            result.freed.bytes += entry->cost.bytes;
+            result.freed.handles += entry->cost.handles;
+            ++result.entries;
+            EraseLocked(shard, entry, true, &destroyList);
+            progress = true;
+        }
+    }
+    for (HICON icon : destroyList) {
+        if (icon) {
+            DestroyIcon(icon);
+        }
     }
-    StatsSnapshot snapshot;
-    snapshot.hits = m_hits;
-    snapshot.misses = m_misses;
-    snapshot.evictions = m_evictions;
-    snapshot.size = m_entries.size();
-    m_requestsSinceLog = 0;
-    return snapshot;
+    return result;
 }
 
-void IconCache::TrimLocked(std::vector<HICON>* destroyList) {
-    if (!destroyList) {
+void IconCache::FinishLoadLocked(Shard& shard, uint64_t variantKey) {
+    auto flight = shard.inFlight.find(variantKey);
+    if (flight != shard.inFlight.end()) {
+        flight->second->done = true;
+        shard.inFlight.erase(flight);
+    }
+    shard.loadFinished.notify_all();
+}
+
+bool IconCache::IsNegativeLocked(Shard& shard, uint64_t variantKey, const std::wstring& familyKey, bool large,
+                                 std::chrono::steady_clock::time_point now) {
+    auto it = shard.negative.find(variantKey);
+    if (it == shard.negative.end() || it->second.large != large || it->second.family != familyKey) {
+        return false;
+    }
+    if (it->second.expiry > now) {
+        return true;
+    }
+    shard.negative.erase(it);
+    return false;
+}
+
+void IconCache::RememberNegativeLocked(Shard& shard, uint64_t variantKey, const std::wstring& familyKey, bool large,
+                                       std::chrono::steady_clock::time_point now) {
+    const std::chrono::milliseconds ttl(m_negativeTtlMs.load(std::memory_order_relaxed));
+    if (ttl.count() <= 0) {
         return;
     }
-    while (m_entries.size() > m_capacity && !m_lru.empty()) {
-        auto listIt = std::prev(m_lru.end());
-        auto mapIt = m_entries.find(*listIt);
-        if (mapIt == m_entries.end()) {
-            m_lru.erase(listIt);
-            continue;
-        }
-        Entry* entry = mapIt->second.get();
-        if (!entry || entry->refCount > 0) {
-            break;
-        }
-        entry->stale = false;
-        destroyList->push_back(entry->icon);
-        auto familyIt = entry->familyIt;
-        if (familyIt != m_familyIndex.end()) {
-            m_familyIndex.erase(familyIt);
+    if (shard.negative.size() >= kNegativeSweepThreshold) {
+        for (auto it = shard.negative.begin(); it != shard.negative.end();) {
+            it = it->second.expiry <= now ? shard.negative.erase(it) : std::next(it);
         }
-        m_entries.erase(mapIt);
-        m_lru.erase(listIt);
-        ++m_evictions;
     }
+    shard.negative[variantKey] = NegativeEntry{familyKey, large, now + ttl};
+}
+
+std::optional<IconCache::Stats> IconCache::CountRequest() {
+    uint64_t requests = m_requestsSinceLog.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (requests < kLogInterval) {
+        return std::nullopt;
+    }
+    // Only the thread that resets the counter logs this interval.
+    if (!m_requestsSinceLog.compare_exchange_strong(requests, 0, std::memory_order_relaxed)) {
+        return std::nullopt;
+    }
+    return GetStats();
+}
+
+void IconCache::LogStats(const Stats& stats) {
+    const double total =
+        static_cast<double>(stats.hits + stats.misses + stats.coalesced + stats.negativeHits);
+    const double hitRate = total > 0.0 ? (static_cast<double>(stats.hits) / total) * 100.0 : 0.0;
+    LogMessage(LogLevel::Info,
+               L"IconCache stats: size=%zu largestShard=%zu hits=%llu misses=%llu coalesced=%llu "
+               L"negativeHits=%llu collisions=%llu evictions=%llu hitRate=%.1f%%",
+               stats.size, stats.largestShard, static_cast<unsigned long long>(stats.hits),
+               static_cast<unsigned long long>(stats.misses), static_cast<unsigned long long>(stats.coalesced),
+               static_cast<unsigned long long>(stats.negativeHits),
+               static_cast<unsigned long long>(stats.collisions),
+               static_cast<unsigned long long>(stats.evictions), hitRate);
 }
 
-void IconCache::AddRef(Entry* entry) {
+void IconCache::AddRef(Entry* entry) noexcept {
     if (!entry) {
         return;
     }
-    std::unique_lock lock(m_mutex);
-    ++entry->refCount;
-    Touch(entry);
+    // Callers already hold a reference, so the entry cannot be reclaimed
+    // underneath us and no lock is needed.
+    entry->refCount.fetch_add(1, std::memory_order_relaxed);
 }
 
-void IconCache::Release(Entry* entry) {
+void IconCache::Release(Entry* entry) noexcept {
     if (!entry) {
         return;
     }
+    // Read before dropping our reference; the entry may be freed afterwards.
+    Shard& shard = m_shards[entry->shard];
+    if (entry->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
     std::vector<HICON> destroyList;
     {
-        std::unique_lock lock(m_mutex);
-        if (entry->refCount > 0) {
-            --entry->refCount;
-        }
-        if (entry->refCount == 0) {
-            if (entry->stale) {
-                auto it = m_entries.find(entry->key);
-                if (it != m_entries.end()) {
-                    destroyList.push_back(entry->icon);
-                    m_lru.erase(entry->lruIt);
-                    if (entry->familyIt != m_familyIndex.end()) {
-                        m_familyIndex.erase(entry->familyIt);
-                    }
-                    m_entries.erase(it);
-                    ++m_evictions;
-                }
-            } else {
-                TrimLocked(&destroyList);
+        std::unique_lock lock(shard.mutex);
+        // Only dereference the entry if the shard still owns it as stale.
+        auto staleIt = shard.stale.find(entry);
+        if (staleIt != shard.stale.end()) {
+            if (entry->refCount.load(std::memory_order_acquire) == 0) {
+                destroyList.push_back(entry->icon);
+                GdiResourceBudget::Instance().Credit(m_budgetClient, entry->cost);
+                shard.stale.erase(staleIt);
+                ++shard.evictions;
             }
+        } else {
+            TrimLocked(shard, &destroyList);
         }
     }
     for (HICON icon : destroyList) {
@@ -497,4 +641,3 @@ void IconCache::Release(Entry* entry) {
 }
 
 }  // namespace shelltabs
-
@@ -1,5 +1,6 @@
 #include "Logging.h"
 
+#include "CacheTraceRecorder.h"
 #include "Utilities.h"
 
 #ifndef WIN32_LEAN_AND_MEAN
@@ -50,6 +51,9 @@ std::vector<FaultMitigationHandlerEntry> g_faultHandlers;
 bool g_symbolHandlerReady = false;
 
 constexpr wchar_t kMinidumpOptInEnvironmentVariable[] = L"SHELLTABS_WRITE_MINIDUMPS";
+// "1" traces cache accesses to the log directory; any other non-boolean value
+// is taken as the trace file path.
+constexpr wchar_t kCacheTraceEnvironmentVariable[] = L"SHELLTABS_CACHE_TRACE";
 
 constexpr wchar_t kLogDirectory[] = L"ShellTabs\\Logs";
 constexpr USHORT kMaxStackFrames = 64;
@@ -213,6 +217,45 @@ std::wstring BuildLogFilePath() {
     return directory;
 }
 
+std::wstring BuildCacheTracePath() {
+    std::wstring value = GetEnvironmentValue(kCacheTraceEnvironmentVariable);
+    if (value.empty()) {
+        return {};
+    }
+    std::wstring lowered = value;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](wchar_t ch) { return std::towlower(ch); });
+    if (lowered == L"0" || lowered == L"false" || lowered == L"no" || lowered == L"off") {
+        return {};
+    }
+    if (!ParseBooleanEnvironmentValue(value)) {
+        return value;
+    }
+
+    std::wstring directory = BuildLogDirectory();
+    if (directory.empty() || !EnsureDirectoryExists(directory)) {
+        return {};
+    }
+    wchar_t fileName[64];
+    swprintf(fileName, ARRAYSIZE(fileName), L"cachetrace-%lu.bin", GetCurrentProcessId());
+    if (directory.back() != L'\\' && directory.back() != L'/') {
+        directory.push_back(L'\\');
+    }
+    directory.append(fileName);
+    return directory;
+}
+
+void StartCacheTraceIfRequested() {
+    const std::wstring path = BuildCacheTracePath();
+    if (path.empty()) {
+        return;
+    }
+    if (CacheTraceRecorder::Instance().Start(std::filesystem::path(path))) {
+        LogMessage(LogLevel::Info, L"Recording cache accesses to %ls", path.c_str());
+    } else {
+        LogMessage(LogLevel::Warning, L"Failed to start cache trace at %ls", path.c_str());
+    }
+}
+
 BOOL CALLBACK InitializeSymbolsOnce(PINIT_ONCE, PVOID, PVOID*) {
     HANDLE process = GetCurrentProcess();
     SymSetOptions(SYMOPT_DEFERRED_LOADS | SYMOPT_UNDNAME | SYMOPT_LOAD_LINES | SYMOPT_FAIL_CRITICAL_ERRORS);
@@ -589,6 +632,7 @@ std::wstring BuildLogLine(LogLevel level, const std::wstring& message) {
 void InitializeLoggingEarly(HMODULE module) noexcept {
     g_hostModule = module;
     EnsureLoggingInitialized();
+    StartCacheTraceIfRequested();
 }
 
 void ShutdownLogging() noexcept {
@@ -597,6 +641,13 @@ void ShutdownLogging() noexcept {
     }
 
     LogMessage(LogLevel::Info, L"Logging shutting down");
+    CacheTraceRecorder& cacheTrace = CacheTraceRecorder::Instance();
+    if (cacheTrace.IsEnabled()) {
+        cacheTrace.Stop();
+        LogMessage(LogLevel::Info, L"Cache trace stopped after %llu records (%llu dropped)",
+                   static_cast<unsigned long long>(cacheTrace.RecordedCount()),
+                   static_cast<unsigned long long>(cacheTrace.DroppedCount()));
+    }
     g_loggingShutdown = true;
 
     if (g_vectoredExceptionHandler) {
@@ -0,0 +1,1116 @@
+#include "OptionsCodec.h"
+
+#include "StringUtils.h"
+#include "Utilities.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cwchar>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace shelltabs {
+namespace {
+
+constexpr int kCurrentOptionsVersion = 3;
+constexpr char kCommentChar = '#';
+constexpr char kFieldDelimiter = '|';
+constexpr std::string_view kWhitespace = " \t\r\n";
+constexpr std::string_view kUtf8Bom = "\xEF\xBB\xBF";
+constexpr wchar_t kContextMenuExtensionDelimiter = L';';
+constexpr int kMaxSelectionCount = 4096;
+
+// A UTF-16 code unit never needs more than three UTF-8 bytes.
+constexpr size_t kMaxUtf8BytesPerUnit = 3;
+
+enum class FieldKind : uint8_t {
+    kVersion,
+    kBool,
+    kIntRange,
+    kText,
+    kNewTabTemplate,
+    kToggleColor,
+    kToggleColorPair,
+    kLegacyFontTransparency,
+    kGlowSurface,
+    kUniversalBackground,
+    kFolderBackgroundEntry,
+    kContextMenuCommand,
+    kContextMenuSubmenu,
+    kContextMenuSeparator,
+    kContextMenuEnd,
+    kDockMode,
+};
+
+struct OptionsField {
+    std::string_view key;
+    FieldKind kind = FieldKind::kBool;
+    // Keys that are only read for migration, or whose records are emitted by
+    // another entry (the context menu tree), are skipped by the writer.
+    bool write = true;
+    bool ShellTabsOptions::*flag = nullptr;
+    int ShellTabsOptions::*number = nullptr;
+    std::wstring ShellTabsOptions::*text = nullptr;
+    COLORREF ShellTabsOptions::*firstColor = nullptr;
+    COLORREF ShellTabsOptions::*secondColor = nullptr;
+    int minimum = 0;
+    int maximum = 0;
+};
+
+constexpr OptionsField SpecialField(std::string_view key, FieldKind kind, bool write = true) {
+    OptionsField field;
+    field.key = key;
+    field.kind = kind;
+    field.write = write;
+    return field;
+}
+
+constexpr OptionsField BoolField(std::string_view key, bool ShellTabsOptions::*flag) {
+    OptionsField field = SpecialField(key, FieldKind::kBool);
+    field.flag = flag;
+    return field;
+}
+
+constexpr OptionsField RangeField(std::string_view key, int ShellTabsOptions::*number, int minimum, int maximum) {
+    OptionsField field = SpecialField(key, FieldKind::kIntRange);
+    field.number = number;
+    field.minimum = minimum;
+    field.maximum = maximum;
+    return field;
+}
+
+constexpr OptionsField TextField(std::string_view key, std::wstring ShellTabsOptions::*text) {
+    OptionsField field = SpecialField(key, FieldKind::kText);
+    field.text = text;
+    return field;
+}
+
+constexpr OptionsField ToggleColorField(std::string_view key, bool ShellTabsOptions::*flag,
+                                        COLORREF ShellTabsOptions::*color) {
+    OptionsField field = SpecialField(key, FieldKind::kToggleColor);
+    field.flag = flag;
+    field.firstColor = color;
+    return field;
+}
+
+constexpr OptionsField ToggleColorPairField(std::string_view key, bool ShellTabsOptions::*flag,
+                                            COLORREF ShellTabsOptions::*first, COLORREF ShellTabsOptions::*second) {
+    OptionsField field = SpecialField(key, FieldKind::kToggleColorPair);
+    field.flag = flag;
+    field.firstColor = first;
+    field.secondColor = second;
+    return field;
+}
+
+// Table order is the on-disk record order.
+constexpr std::array kOptionsFields = {
+    SpecialField("version", FieldKind::kVersion),
+    BoolField("reopen_on_crash", &ShellTabsOptions::reopenOnCrash),
+    BoolField("persist_group_paths", &ShellTabsOptions::persistGroupPaths),
+    SpecialField("new_tab_template", FieldKind::kNewTabTemplate),
+    TextField("new_tab_custom_path", &ShellTabsOptions::newTabCustomPath),
+    TextField("new_tab_saved_group", &ShellTabsOptions::newTabSavedGroup),
+    BoolField("breadcrumb_gradient", &ShellTabsOptions::enableBreadcrumbGradient),
+    BoolField("breadcrumb_font_gradient", &ShellTabsOptions::enableBreadcrumbFontGradient),
+    RangeField("breadcrumb_gradient_transparency", &ShellTabsOptions::breadcrumbGradientTransparency, 0, 100),
+    RangeField("breadcrumb_font_brightness", &ShellTabsOptions::breadcrumbFontBrightness, 0, 100),
+    SpecialField("breadcrumb_font_transparency", FieldKind::kLegacyFontTransparency, false),
+    RangeField("breadcrumb_highlight_alpha_multiplier", &ShellTabsOptions::breadcrumbHighlightAlphaMultiplier, 0,
+               200),
+    RangeField("breadcrumb_dropdown_alpha_multiplier", &ShellTabsOptions::breadcrumbDropdownAlphaMultiplier, 0,
+               200),
+    ToggleColorPairField("breadcrumb_gradient_colors", &ShellTabsOptions::useCustomBreadcrumbGradientColors,
+                         &ShellTabsOptions::breadcrumbGradientStartColor,
+                         &ShellTabsOptions::breadcrumbGradientEndColor),
+    ToggleColorPairField("breadcrumb_font_gradient_colors", &ShellTabsOptions::useCustomBreadcrumbFontColors,
+                         &ShellTabsOptions::breadcrumbFontGradientStartColor,
+                         &ShellTabsOptions::breadcrumbFontGradientEndColor),
+    ToggleColorPairField("progress_gradient_colors", &ShellTabsOptions::useCustomProgressBarGradientColors,
+                         &ShellTabsOptions::progressBarGradientStartColor,
+                         &ShellTabsOptions::progressBarGradientEndColor),
+    BoolField("neon_glow_enabled", &ShellTabsOptions::enableNeonGlow),
+    BoolField("neon_glow_gradient", &ShellTabsOptions::useNeonGlowGradient),
+    ToggleColorPairField("neon_glow_colors", &ShellTabsOptions::useCustomNeonGlowColors,
+                         &ShellTabsOptions::neonGlowPrimaryColor, &ShellTabsOptions::neonGlowSecondaryColor),
+    BoolField("glow_bitmap_intercept", &ShellTabsOptions::enableBitmapIntercept),
+    BoolField("file_gradient_font", &ShellTabsOptions::enableFileGradientFont),
+    SpecialField("glow_surface", FieldKind::kGlowSurface),
+    ToggleColorField("tab_selected_color", &ShellTabsOptions::useCustomTabSelectedColor,
+                     &ShellTabsOptions::customTabSelectedColor),
+    ToggleColorField("tab_unselected_color", &ShellTabsOptions::useCustomTabUnselectedColor,
+                     &ShellTabsOptions::customTabUnselectedColor),
+    BoolField("explorer_listview_accents", &ShellTabsOptions::useExplorerAccentColors),
+    BoolField("folder_backgrounds_enabled", &ShellTabsOptions::enableFolderBackgrounds),
+    SpecialField("folder_background_universal", FieldKind::kUniversalBackground),
+    SpecialField("folder_background_entry", FieldKind::kFolderBackgroundEntry),
+    SpecialField("context_menu_command", FieldKind::kContextMenuCommand),
+    SpecialField("context_menu_submenu", FieldKind::kContextMenuSubmenu, false),
+    SpecialField("context_menu_separator", FieldKind::kContextMenuSeparator, false),
+    SpecialField("context_menu_end", FieldKind::kContextMenuEnd, false),
+    SpecialField("tab_docking", FieldKind::kDockMode),
+};
+
+// Tokens a record of the kind is read up to, key included. The readers below
+// ignore anything past this, so lines keep only this many tokens.
+constexpr size_t FieldTokenCount(FieldKind kind) {
+    switch (kind) {
+        case FieldKind::kContextMenuEnd:
+            return 1;
+        case FieldKind::kVersion:
+        case FieldKind::kBool:
+        case FieldKind::kIntRange:
+        case FieldKind::kText:
+        case FieldKind::kNewTabTemplate:
+        case FieldKind::kLegacyFontTransparency:
+        case FieldKind::kDockMode:
+            return 2;
+        case FieldKind::kToggleColor:
+        case FieldKind::kUniversalBackground:
+        case FieldKind::kContextMenuSeparator:
+            return 3;
+        case FieldKind::kToggleColorPair:
+            return 4;
+        case FieldKind::kFolderBackgroundEntry:
+            return 5;
+        case FieldKind::kGlowSurface:
+            return 7;
+        case FieldKind::kContextMenuSubmenu:
+            return 14;
+        case FieldKind::kContextMenuCommand:
+            return 20;
+    }
+    return 0;
+}
+
+constexpr size_t MaxFieldTokenCount() {
+    size_t count = 0;
+    for (const auto& field : kOptionsFields) {
+        count = std::max(count, FieldTokenCount(field.kind));
+    }
+    return count;
+}
+
+constexpr size_t kMaxLineTokens = MaxFieldTokenCount();
+
+// Keys are dispatched through a seeded FNV-1a hash that is collision free for
+// the table above. Adding a key may require a new seed; the static_assert below
+// reports it at compile time.
+constexpr uint32_t kFieldHashSeed = 22;
+constexpr uint32_t kFieldBucketBits = 7;
+constexpr uint8_t kNoField = 0xFF;
+
+constexpr uint32_t HashFieldKey(std::string_view key) {
+    uint32_t hash = 2166136261u ^ kFieldHashSeed;
+    for (char ch : key) {
+        hash ^= static_cast<uint8_t>(ch);
+        hash *= 16777619u;
+    }
+    return hash >> (32 - kFieldBucketBits);
+}
+
+constexpr std::array<uint8_t, (1u << kFieldBucketBits)> BuildFieldBuckets() {
+    std::array<uint8_t, (1u << kFieldBucketBits)> buckets{};
+    for (auto& bucket : buckets) {
+        bucket = kNoField;
+    }
+    for (size_t i = 0; i < kOptionsFields.size(); ++i) {
+        buckets[HashFieldKey(kOptionsFields[i].key)] = static_cast<uint8_t>(i);
+    }
+    return buckets;
+}
+
+constexpr auto kFieldBuckets = BuildFieldBuckets();
+
+constexpr bool FieldHashIsPerfect() {
+    for (size_t i = 0; i < kOptionsFields.size(); ++i) {
+        if (kFieldBuckets[HashFieldKey(kOptionsFields[i].key)] != i) {
+            return false;
+        }
+    }
+    return kOptionsFields.size() < kNoField;
+}
+
+static_assert(FieldHashIsPerfect(), "Options field keys collide; choose a different kFieldHashSeed");
+
+const OptionsField* FindOptionsField(std::string_view key) {
+    const uint8_t index = kFieldBuckets[HashFieldKey(key)];
+    if (index == kNoField || kOptionsFields[index].key != key) {
+        return nullptr;
+    }
+    return &kOptionsFields[index];
+}
+
+struct GlowSurfaceMapping {
+    const wchar_t* token;
+    GlowSurfaceOptions GlowSurfacePalette::*member;
+    bool supportsExplorerAccent;
+};
+
+constexpr std::array<GlowSurfaceMapping, 9> kGlowSurfaceMappings = {{{L"header", &GlowSurfacePalette::header, false},
+                                                                     {L"list_view", &GlowSurfacePalette::listView, true},
+                                                                     {L"direct_ui", &GlowSurfacePalette::directUi, true},
+                                                                     {L"toolbar", &GlowSurfacePalette::toolbar, false},
+                                                                     {L"rebar", &GlowSurfacePalette::rebar, false},
+                                                                     {L"edits", &GlowSurfacePalette::edits, false},
+                                                                     {L"scrollbar", &GlowSurfacePalette::scrollbars, true},
+                                                                     {L"popup_menu", &GlowSurfacePalette::popupMenus, true},
+                                                                     {L"tooltip", &GlowSurfacePalette::tooltips, true}}};
+
+const GlowSurfaceMapping* FindGlowSurfaceMapping(std::wstring_view token, size_t* index) {
+    if (token.empty()) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < kGlowSurfaceMappings.size(); ++i) {
+        if (EqualsIgnoreCase(token, kGlowSurfaceMappings[i].token)) {
+            if (index) {
+                *index = i;
+            }
+            return &kGlowSurfaceMappings[i];
+        }
+    }
+    return nullptr;
+}
+
+GlowSurfaceOptions* GetGlowSurfaceOptions(ShellTabsOptions* options, const GlowSurfaceMapping& mapping) {
+    if (!options) {
+        return nullptr;
+    }
+    return &(options->glowPalette.*(mapping.member));
+}
+
+const GlowSurfaceOptions* GetGlowSurfaceOptions(const ShellTabsOptions* options,
+                                                const GlowSurfaceMapping& mapping) {
+    if (!options) {
+        return nullptr;
+    }
+    return &(options->glowPalette.*(mapping.member));
+}
+
+GlowSurfaceMode ParseGlowMode(std::wstring_view token, GlowSurfaceMode fallback) {
+    if (token.empty()) {
+        return fallback;
+    }
+    if (EqualsIgnoreCase(token, L"accent")) {
+        return GlowSurfaceMode::kExplorerAccent;
+    }
+    if (EqualsIgnoreCase(token, L"solid")) {
+        return GlowSurfaceMode::kSolid;
+    }
+    if (EqualsIgnoreCase(token, L"gradient")) {
+        return GlowSurfaceMode::kGradient;
+    }
+    return fallback;
+}
+
+const wchar_t* GlowModeToString(GlowSurfaceMode mode) {
+    switch (mode) {
+        case GlowSurfaceMode::kExplorerAccent:
+            return L"accent";
+        case GlowSurfaceMode::kSolid:
+            return L"solid";
+        case GlowSurfaceMode::kGradient:
+            return L"gradient";
+        default:
+            return L"gradient";
+    }
+}
+
+ContextMenuInsertionAnchor ParseContextMenuAnchor(std::wstring_view token) {
+    if (token.empty()) {
+        return ContextMenuInsertionAnchor::kDefault;
+    }
+    if (EqualsIgnoreCase(token, L"top")) {
+        return ContextMenuInsertionAnchor::kTop;
+    }
+    if (EqualsIgnoreCase(token, L"bottom")) {
+        return ContextMenuInsertionAnchor::kBottom;
+    }
+    if (EqualsIgnoreCase(token, L"before_shell")) {
+        return ContextMenuInsertionAnchor::kBeforeShellItems;
+    }
+    if (EqualsIgnoreCase(token, L"after_shell")) {
+        return ContextMenuInsertionAnchor::kAfterShellItems;
+    }
+    return ContextMenuInsertionAnchor::kDefault;
+}
+
+const wchar_t* ContextMenuAnchorToString(ContextMenuInsertionAnchor anchor) {
+    switch (anchor) {
+        case ContextMenuInsertionAnchor::kTop:
+            return L"top";
+        case ContextMenuInsertionAnchor::kBottom:
+            return L"bottom";
+        case ContextMenuInsertionAnchor::kBeforeShellItems:
+            return L"before_shell";
+        case ContextMenuInsertionAnchor::kAfterShellItems:
+            return L"after_shell";
+        default:
+            return L"default";
+    }
+}
+
+std::vector<std::wstring> ParseContextMenuExtensions(std::wstring_view token) {
+    std::vector<std::wstring> extensions;
+    if (token.empty()) {
+        return extensions;
+    }
+
+    for (std::wstring_view part : Split(token, kContextMenuExtensionDelimiter)) {
+        std::wstring trimmed = Trim(part);
+        if (trimmed.empty()) {
+            continue;
+        }
+        extensions.emplace_back(std::move(trimmed));
+    }
+
+    return NormalizeContextMenuPatterns(extensions);
+}
+
+int ParseSelectionCount(std::wstring_view token) {
+    if (token.empty()) {
+        return 0;
+    }
+    int value = ParseInt(token);
+    if (value <= 0) {
+        return 0;
+    }
+    if (value > kMaxSelectionCount) {
+        return kMaxSelectionCount;
+    }
+    return value;
+}
+
+int ParseIntInRange(std::wstring_view token, int minimum, int maximum, int fallback) {
+    if (token.empty()) {
+        return fallback;
+    }
+    return std::clamp(ParseInt(token), minimum, maximum);
+}
+
+bool IsHexDigit(char ch) noexcept {
+    return (ch >= '0' && ch <= '9') || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+}
+
+unsigned int HexDigitValue(char ch) noexcept {
+    if (ch >= '0' && ch <= '9') {
+        return static_cast<unsigned int>(ch - '0');
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return static_cast<unsigned int>(ch - 'a' + 10);
+    }
+    return static_cast<unsigned int>(ch - 'A' + 10);
+}
+
+// Accepts the same "%x" shapes the store has always written or read: an
+// optional sign, an optional 0x prefix and a run of hex digits.
+COLORREF ParseColorValue(std::string_view token, COLORREF fallback) {
+    size_t index = 0;
+    bool negative = false;
+    if (index < token.size() && (token[index] == '+' || token[index] == '-')) {
+        negative = token[index] == '-';
+        ++index;
+    }
+
+    bool anyDigit = false;
+    if (index + 1 < token.size() && token[index] == '0' && (token[index + 1] == 'x' || token[index + 1] == 'X')) {
+        index += 2;
+        anyDigit = true;
+    }
+
+    unsigned int parsed = 0;
+    for (; index < token.size() && IsHexDigit(token[index]); ++index) {
+        parsed = (parsed << 4) | HexDigitValue(token[index]);
+        anyDigit = true;
+    }
+    if (!anyDigit) {
+        return fallback;
+    }
+    if (negative) {
+        parsed = 0u - parsed;
+    }
+
+    return RGB((parsed >> 16) & 0xFF, (parsed >> 8) & 0xFF, parsed & 0xFF);
+}
+
+bool HasDirectoryPrefix(const std::wstring& path, const std::wstring& directory) {
+    if (path.size() < directory.size()) {
+        return false;
+    }
+    if (!EqualsIgnoreCase(std::wstring_view(path).substr(0, directory.size()), directory)) {
+        return false;
+    }
+    if (path.size() == directory.size()) {
+        return true;
+    }
+    const wchar_t separator = path[directory.size()];
+    return separator == L'\\';
+}
+
+std::wstring NormalizeCachePath(const std::wstring& path, const std::wstring& directory) {
+    if (path.empty() || directory.empty()) {
+        return {};
+    }
+
+    std::wstring normalized = NormalizeFileSystemPath(path);
+    if (normalized.empty()) {
+        return {};
+    }
+
+    if (!HasDirectoryPrefix(normalized, directory)) {
+        return {};
+    }
+
+    return normalized;
+}
+
+std::string_view TrimUtf8(std::string_view value) {
+    const size_t begin = value.find_first_not_of(kWhitespace);
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+    const size_t end = value.find_last_not_of(kWhitespace);
+    return value.substr(begin, end - begin + 1);
+}
+
+// Tokens of a single record, as views into the document bytes. Tokens past
+// kMaxLineTokens are never read by any field, so they are not split out.
+class LineTokens {
+public:
+    explicit LineTokens(std::string_view line) {
+        size_t start = 0;
+        while (m_count < m_values.size()) {
+            const size_t pos = line.find(kFieldDelimiter, start);
+            if (pos == std::string_view::npos) {
+                m_values[m_count++] = TrimUtf8(line.substr(start));
+                break;
+            }
+            m_values[m_count++] = TrimUtf8(line.substr(start, pos - start));
+            start = pos + 1;
+        }
+    }
+
+    size_t size() const noexcept { return m_count; }
+    std::string_view operator[](size_t index) const noexcept { return m_values[index]; }
+
+private:
+    std::array<std::string_view, kMaxLineTokens> m_values{};
+    size_t m_count = 0;
+};
+
+class TokenCursor {
+public:
+    TokenCursor(const LineTokens& tokens, size_t start) noexcept : m_tokens(tokens), m_index(start) {}
+
+    bool Next(std::string_view* token) noexcept {
+        if (m_index >= m_tokens.size()) {
+            return false;
+        }
+        *token = m_tokens[m_index++];
+        return true;
+    }
+
+private:
+    const LineTokens& m_tokens;
+    size_t m_index;
+};
+
+std::wstring ToWide(std::string_view utf8) { return Utf8ToWide(utf8); }
+
+// Widens short ASCII tokens into an inline buffer so keyword and number
+// parsing can reuse the wide helpers without allocating. The returned view is
+// valid until the next call.
+class WideScratch {
+public:
+    std::wstring_view Widen(std::string_view utf8) {
+        if (utf8.size() <= m_inline.size()) {
+            bool ascii = true;
+            for (size_t i = 0; i < utf8.size(); ++i) {
+                const unsigned char ch = static_cast<unsigned char>(utf8[i]);
+                if (ch >= 0x80) {
+                    ascii = false;
+                    break;
+                }
+                m_inline[i] = static_cast<wchar_t>(ch);
+            }
+            if (ascii) {
+                return std::wstring_view(m_inline.data(), utf8.size());
+            }
+        }
+        m_fallback = Utf8ToWide(utf8);
+        return m_fallback;
+    }
+
+private:
+    std::array<wchar_t, 64> m_inline{};
+    std::wstring m_fallback;
+};
+
+struct ParseState {
+    const std::wstring* storageDirectory = nullptr;
+    ShellTabsOptions options;
+    int version = 1;
+    std::array<bool, kGlowSurfaceMappings.size()> glowSurfaceSpecified{};
+    bool anyGlowSurfaceToken = false;
+    std::vector<std::vector<ContextMenuItem>*> contextMenuStack;
+    WideScratch scratch;
+};
+
+void ParseContextMenuCommand(const LineTokens& tokens, ParseState& state) {
+    ContextMenuItem item;
+    item.type = ContextMenuItemType::kCommand;
+    TokenCursor cursor(tokens, 1);
+    std::string_view token;
+
+    if (cursor.Next(&token)) item.label = ToWide(token);
+    if (cursor.Next(&token)) item.executable = ToWide(token);
+    if (cursor.Next(&token)) item.arguments = ToWide(token);
+    if (cursor.Next(&token)) item.iconSource = ToWide(token);
+    if (cursor.Next(&token)) item.workingDirectory = ToWide(token);
+    if (cursor.Next(&token)) item.windowState = static_cast<ContextMenuWindowState>(ParseInt(state.scratch.Widen(token)));
+    if (cursor.Next(&token)) item.runAsAdmin = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.waitForCompletion = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.anchor = ParseContextMenuAnchor(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.enabled = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.visibility.minimumSelection = ParseSelectionCount(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.visibility.maximumSelection = ParseSelectionCount(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.visibility.showForFiles = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.visibility.showForFolders = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.visibility.showForMultiple = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.visibility.filePatterns = ParseContextMenuExtensions(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.visibility.excludePatterns = ParseContextMenuExtensions(state.scratch.Widen(token));
+    if (cursor.Next(&token)) item.description = ToWide(token);
+    if (cursor.Next(&token)) item.id = ToWide(token);
+
+    state.contextMenuStack.back()->push_back(std::move(item));
+}
+
+void ParseContextMenuSubmenu(const LineTokens& tokens, ParseState& state) {
+    ContextMenuItem submenu;
+    submenu.type = ContextMenuItemType::kSubmenu;
+    TokenCursor cursor(tokens, 1);
+    std::string_view token;
+
+    if (cursor.Next(&token)) submenu.label = ToWide(token);
+    if (cursor.Next(&token)) submenu.iconSource = ToWide(token);
+    if (cursor.Next(&token)) submenu.anchor = ParseContextMenuAnchor(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.enabled = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.visibility.minimumSelection = ParseSelectionCount(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.visibility.maximumSelection = ParseSelectionCount(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.visibility.showForFiles = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.visibility.showForFolders = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.visibility.showForMultiple = ParseBool(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.visibility.filePatterns = ParseContextMenuExtensions(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.visibility.excludePatterns = ParseContextMenuExtensions(state.scratch.Widen(token));
+    if (cursor.Next(&token)) submenu.description = ToWide(token);
+    if (cursor.Next(&token)) submenu.id = ToWide(token);
+
+    state.contextMenuStack.back()->push_back(std::move(submenu));
+    ContextMenuItem& inserted = state.contextMenuStack.back()->back();
+    state.contextMenuStack.push_back(&inserted.children);
+}
+
+void ParseGlowSurface(const LineTokens& tokens, ParseState& state) {
+    if (tokens.size() < 2) {
+        return;
+    }
+    size_t surfaceIndex = 0;
+    const GlowSurfaceMapping* mapping = FindGlowSurfaceMapping(state.scratch.Widen(tokens[1]), &surfaceIndex);
+    if (!mapping) {
+        return;
+    }
+    GlowSurfaceOptions* surface = GetGlowSurfaceOptions(&state.options, *mapping);
+    if (!surface) {
+        return;
+    }
+
+    state.anyGlowSurfaceToken = true;
+    state.glowSurfaceSpecified[surfaceIndex] = true;
+    if (tokens.size() >= 3) {
+        surface->mode = ParseGlowMode(state.scratch.Widen(tokens[2]), surface->mode);
+    }
+    if (tokens.size() >= 4) {
+        surface->solidColor = ParseColorValue(tokens[3], surface->solidColor);
+    }
+    if (tokens.size() >= 5) {
+        surface->gradientStartColor = ParseColorValue(tokens[4], surface->gradientStartColor);
+    }
+    if (tokens.size() >= 6) {
+        surface->gradientEndColor = ParseColorValue(tokens[5], surface->gradientEndColor);
+    }
+    if (tokens.size() >= 7) {
+        surface->enabled = ParseBool(state.scratch.Widen(tokens[6]));
+    }
+}
+
+void ParseFolderBackgroundEntry(const LineTokens& tokens, ParseState& state) {
+    if (tokens.size() < 3) {
+        return;
+    }
+    FolderBackgroundEntry entry;
+    entry.folderPath = NormalizeFileSystemPath(ToWide(tokens[1]));
+    if (entry.folderPath.empty()) {
+        return;
+    }
+    entry.image.cachedImagePath = NormalizeCachePath(ToWide(tokens[2]), *state.storageDirectory);
+    if (entry.image.cachedImagePath.empty()) {
+        return;
+    }
+    if (tokens.size() >= 4) {
+        entry.image.displayName = ToWide(tokens[3]);
+    }
+    if (tokens.size() >= 5) {
+        entry.applyToSubfolders = ParseBool(state.scratch.Widen(tokens[4]));
+    }
+    state.options.folderBackgroundEntries.emplace_back(std::move(entry));
+}
+
+void ApplyField(const OptionsField& field, const LineTokens& tokens, ParseState& state) {
+    ShellTabsOptions& options = state.options;
+    switch (field.kind) {
+        case FieldKind::kVersion:
+            if (tokens.size() >= 2) {
+                state.version = std::max(ParseInt(state.scratch.Widen(tokens[1])), 1);
+            }
+            break;
+        case FieldKind::kBool:
+            if (tokens.size() >= 2) {
+                options.*(field.flag) = ParseBool(state.scratch.Widen(tokens[1]));
+            }
+            break;
+        case FieldKind::kIntRange:
+            if (tokens.size() >= 2) {
+                options.*(field.number) = ParseIntInRange(state.scratch.Widen(tokens[1]), field.minimum,
+                                                          field.maximum, options.*(field.number));
+            }
+            break;
+        case FieldKind::kText:
+            if (tokens.size() >= 2) {
+                options.*(field.text) = ToWide(tokens[1]);
+            }
+            break;
+        case FieldKind::kNewTabTemplate:
+            if (tokens.size() >= 2) {
+                options.newTabTemplate = ParseNewTabTemplate(state.scratch.Widen(tokens[1]));
+            }
+            break;
+        case FieldKind::kToggleColor:
+        case FieldKind::kToggleColorPair:
+            if (tokens.size() >= 2) {
+                options.*(field.flag) = ParseBool(state.scratch.Widen(tokens[1]));
+            }
+            if (tokens.size() >= 3) {
+                options.*(field.firstColor) = ParseColorValue(tokens[2], options.*(field.firstColor));
+            }
+            if (field.secondColor && tokens.size() >= 4) {
+                options.*(field.secondColor) = ParseColorValue(tokens[3], options.*(field.secondColor));
+            }
+            break;
+        case FieldKind::kLegacyFontTransparency:
+            if (tokens.size() >= 2) {
+                const int defaultBrightness = options.breadcrumbFontBrightness;
+                const int legacyTransparency =
+                    ParseIntInRange(state.scratch.Widen(tokens[1]), 0, 100, 100 - defaultBrightness);
+                const int legacyOpacity = 100 - legacyTransparency;
+                options.breadcrumbFontBrightness = std::clamp(legacyOpacity * defaultBrightness / 100, 0, 100);
+            }
+            break;
+        case FieldKind::kGlowSurface:
+            ParseGlowSurface(tokens, state);
+            break;
+        case FieldKind::kUniversalBackground:
+            if (tokens.size() >= 2) {
+                std::wstring cachePath = NormalizeCachePath(ToWide(tokens[1]), *state.storageDirectory);
+                if (!cachePath.empty()) {
+                    options.universalFolderBackgroundImage.cachedImagePath = std::move(cachePath);
+                    if (tokens.size() >= 3) {
+                        options.universalFolderBackgroundImage.displayName = ToWide(tokens[2]);
+                    }
+                }
+            }
+            break;
+        case FieldKind::kFolderBackgroundEntry:
+            ParseFolderBackgroundEntry(tokens, state);
+            break;
+        case FieldKind::kContextMenuCommand:
+            ParseContextMenuCommand(tokens, state);
+            break;
+        case FieldKind::kContextMenuSubmenu:
+            ParseContextMenuSubmenu(tokens, state);
+            break;
+        case FieldKind::kContextMenuSeparator: {
+            ContextMenuItem separator;
+            separator.type = ContextMenuItemType::kSeparator;
+            TokenCursor cursor(tokens, 1);
+            std::string_view token;
+            if (cursor.Next(&token)) separator.anchor = ParseContextMenuAnchor(state.scratch.Widen(token));
+            if (cursor.Next(&token)) separator.enabled = ParseBool(state.scratch.Widen(token));
+            state.contextMenuStack.back()->push_back(std::move(separator));
+            break;
+        }
+        case FieldKind::kContextMenuEnd:
+            if (state.contextMenuStack.size() > 1) {
+                state.contextMenuStack.pop_back();
+            }
+            break;
+        case FieldKind::kDockMode:
+            if (tokens.size() >= 2) {
+                options.tabDockMode = ParseDockMode(state.scratch.Widen(tokens[1]));
+            }
+            break;
+    }
+}
+
+void ApplyGlowSurfaceFallbacks(ParseState& state) {
+    ShellTabsOptions& options = state.options;
+    if (!state.anyGlowSurfaceToken) {
+        UpdateGlowPaletteFromLegacySettings(options);
+        return;
+    }
+
+    ShellTabsOptions fallbackOptions = options;
+    UpdateLegacyGlowSettingsFromPalette(fallbackOptions);
+    UpdateGlowPaletteFromLegacySettings(fallbackOptions);
+
+    for (size_t i = 0; i < state.glowSurfaceSpecified.size(); ++i) {
+        if (state.glowSurfaceSpecified[i]) {
+            continue;
+        }
+        const GlowSurfaceMapping& mapping = kGlowSurfaceMappings[i];
+        GlowSurfaceOptions* target = GetGlowSurfaceOptions(&options, mapping);
+        const GlowSurfaceOptions* fallback = GetGlowSurfaceOptions(&fallbackOptions, mapping);
+        if (target && fallback) {
+            *target = *fallback;
+        }
+    }
+
+    UpdateLegacyGlowSettingsFromPalette(options);
+}
+
+class OptionsWriter {
+public:
+    explicit OptionsWriter(size_t capacity) { m_buffer.reserve(capacity); }
+
+    void Key(std::string_view key) { m_buffer.append(key); }
+    void Raw(std::string_view value) {
+        m_buffer.push_back(kFieldDelimiter);
+        m_buffer.append(value);
+    }
+    void Text(std::wstring_view value) {
+        m_buffer.push_back(kFieldDelimiter);
+        AppendWide(value);
+    }
+    void Bool(bool value) { Raw(value ? "1" : "0"); }
+    void Int(int value) {
+        std::array<char, 16> digits{};
+        const auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+        Raw(std::string_view(digits.data(), static_cast<size_t>(result.ptr - digits.data())));
+    }
+    void Color(COLORREF color) {
+        static constexpr char kHexDigits[] = "0123456789ABCDEF";
+        const unsigned int packed = (static_cast<unsigned int>(GetRValue(color)) << 16) |
+                                    (static_cast<unsigned int>(GetGValue(color)) << 8) |
+                                    static_cast<unsigned int>(GetBValue(color));
+        std::array<char, 6> digits{};
+        for (size_t i = 0; i < digits.size(); ++i) {
+            digits[digits.size() - 1 - i] = kHexDigits[(packed >> (i * 4)) & 0xF];
+        }
+        Raw(std::string_view(digits.data(), digits.size()));
+    }
+    void Patterns(const std::vector<std::wstring>& patterns) {
+        m_buffer.push_back(kFieldDelimiter);
+        for (size_t i = 0; i < patterns.size(); ++i) {
+            if (i > 0) {
+                AppendWide(std::wstring_view(&kContextMenuExtensionDelimiter, 1));
+            }
+            AppendWide(patterns[i]);
+        }
+    }
+    void EndLine() { m_buffer.push_back('\n'); }
+
+    std::string Release() { return std::move(m_buffer); }
+
+private:
+    void AppendCodePoint(uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            m_buffer.push_back(static_cast<char>(codePoint));
+        } else if (codePoint < 0x800) {
+            m_buffer.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            m_buffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        } else if (codePoint < 0x10000) {
+            m_buffer.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            m_buffer.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            m_buffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        } else {
+            m_buffer.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+            m_buffer.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+            m_buffer.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            m_buffer.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+    }
+
+    // Encodes UTF-16 the way WideCharToMultiByte does: surrogate pairs are
+    // combined and unpaired surrogates become U+FFFD.
+    void AppendWide(std::wstring_view value) {
+        for (size_t i = 0; i < value.size(); ++i) {
+            uint32_t unit = static_cast<uint32_t>(value[i]);
+            if (unit < 0x80) {
+                m_buffer.push_back(static_cast<char>(unit));
+                continue;
+            }
+            if (unit >= 0xD800 && unit <= 0xDBFF && i + 1 < value.size()) {
+                const uint32_t low = static_cast<uint32_t>(value[i + 1]);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    AppendCodePoint(0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                    ++i;
+                    continue;
+                }
+            }
+            if (unit >= 0xD800 && unit <= 0xDFFF) {
+                unit = 0xFFFD;
+            }
+            AppendCodePoint(unit);
+        }
+    }
+
+    std::string m_buffer;
+};
+
+size_t EstimateContextMenuSize(const std::vector<ContextMenuItem>& items) {
+    constexpr size_t kRecordOverhead = 96;
+    size_t units = 0;
+    size_t records = 0;
+    for (const auto& item : items) {
+        ++records;
+        units += item.label.size() + item.executable.size() + item.arguments.size() + item.iconSource.size() +
+                 item.workingDirectory.size() + item.description.size() + item.id.size();
+        for (const auto& pattern : item.visibility.filePatterns) {
+            units += pattern.size() + 1;
+        }
+        for (const auto& pattern : item.visibility.excludePatterns) {
+            units += pattern.size() + 1;
+        }
+        if (item.type == ContextMenuItemType::kSubmenu) {
+            ++records;
+            units += EstimateContextMenuSize(item.children);
+        }
+    }
+    return units * kMaxUtf8BytesPerUnit + records * kRecordOverhead;
+}
+
+// Upper bound for the serialized document so the writer never reallocates.
+size_t EstimateDocumentSize(const ShellTabsOptions& options) {
+    constexpr size_t kFixedRecordsBytes = 2048;
+    constexpr size_t kRecordOverhead = 64;
+    size_t units = options.newTabCustomPath.size() + options.newTabSavedGroup.size() +
+                   options.universalFolderBackgroundImage.cachedImagePath.size() +
+                   options.universalFolderBackgroundImage.displayName.size();
+    size_t size = kFixedRecordsBytes;
+    for (const auto& entry : options.folderBackgroundEntries) {
+        units += entry.folderPath.size() + entry.image.cachedImagePath.size() + entry.image.displayName.size();
+        size += kRecordOverhead;
+    }
+    size += units * kMaxUtf8BytesPerUnit;
+    size += EstimateContextMenuSize(options.contextMenuItems);
+    return size;
+}
+
+void WriteVisibility(OptionsWriter& writer, const ContextMenuItem& item) {
+    writer.Int(std::max(item.visibility.minimumSelection, 0));
+    writer.Int(item.visibility.maximumSelection > 0 ? item.visibility.maximumSelection : 0);
+    writer.Bool(item.visibility.showForFiles);
+    writer.Bool(item.visibility.showForFolders);
+    writer.Bool(item.visibility.showForMultiple);
+    writer.Patterns(item.visibility.filePatterns);
+    writer.Patterns(item.visibility.excludePatterns);
+    writer.Text(item.description);
+    writer.Text(item.id);
+}
+
+void WriteContextMenuItems(OptionsWriter& writer, const std::vector<ContextMenuItem>& items) {
+    for (const auto& item : items) {
+        switch (item.type) {
+            case ContextMenuItemType::kCommand:
+                writer.Key("context_menu_command");
+                writer.Text(item.label);
+                writer.Text(item.executable);
+                writer.Text(item.arguments);
+                writer.Text(NormalizeContextMenuIconSource(item.iconSource));
+                writer.Text(item.workingDirectory);
+                writer.Int(static_cast<int>(item.windowState));
+                writer.Bool(item.runAsAdmin);
+                writer.Bool(item.waitForCompletion);
+                writer.Text(ContextMenuAnchorToString(item.anchor));
+                writer.Bool(item.enabled);
+                WriteVisibility(writer, item);
+                writer.EndLine();
+                break;
+            case ContextMenuItemType::kSubmenu:
+                writer.Key("context_menu_submenu");
+                writer.Text(item.label);
+                writer.Text(NormalizeContextMenuIconSource(item.iconSource));
+                writer.Text(ContextMenuAnchorToString(item.anchor));
+                writer.Bool(item.enabled);
+                WriteVisibility(writer, item);
+                writer.EndLine();
+                WriteContextMenuItems(writer, item.children);
+                writer.Key("context_menu_end");
+                writer.EndLine();
+                break;
+            case ContextMenuItemType::kSeparator:
+                writer.Key("context_menu_separator");
+                writer.Text(ContextMenuAnchorToString(item.anchor));
+                writer.Bool(item.enabled);
+                writer.EndLine();
+                break;
+        }
+    }
+}
+
+void WriteField(OptionsWriter& writer, const OptionsField& field, const ShellTabsOptions& options,
+                const std::wstring& storageDirectory) {
+    switch (field.kind) {
+        case FieldKind::kVersion:
+            writer.Key(field.key);
+            writer.Int(kCurrentOptionsVersion);
+            writer.EndLine();
+            break;
+        case FieldKind::kBool:
+            writer.Key(field.key);
+            writer.Bool(options.*(field.flag));
+            writer.EndLine();
+            break;
+        case FieldKind::kIntRange:
+            writer.Key(field.key);
+            writer.Int(std::clamp(options.*(field.number), field.minimum, field.maximum));
+            writer.EndLine();
+            break;
+        case FieldKind::kText:
+            writer.Key(field.key);
+            writer.Text(TrimView(options.*(field.text)));
+            writer.EndLine();
+            break;
+        case FieldKind::kNewTabTemplate:
+            writer.Key(field.key);
+            writer.Text(NewTabTemplateToString(options.newTabTemplate));
+            writer.EndLine();
+            break;
+        case FieldKind::kToggleColor:
+        case FieldKind::kToggleColorPair:
+            writer.Key(field.key);
+            writer.Bool(options.*(field.flag));
+            writer.Color(options.*(field.firstColor));
+            if (field.secondColor) {
+                writer.Color(options.*(field.secondColor));
+            }
+            writer.EndLine();
+            break;
+        case FieldKind::kGlowSurface:
+            for (const auto& mapping : kGlowSurfaceMappings) {
+                const GlowSurfaceOptions* surface = GetGlowSurfaceOptions(&options, mapping);
+                if (!surface) {
+                    continue;
+                }
+                writer.Key(field.key);
+                writer.Text(mapping.token);
+                writer.Text(GlowModeToString(surface->mode));
+                writer.Color(surface->solidColor);
+                writer.Color(surface->gradientStartColor);
+                writer.Color(surface->gradientEndColor);
+                writer.Bool(surface->enabled);
+                writer.EndLine();
+            }
+            break;
+        case FieldKind::kUniversalBackground: {
+            const std::wstring normalizedPath =
+                NormalizeCachePath(options.universalFolderBackgroundImage.cachedImagePath, storageDirectory);
+            if (normalizedPath.empty()) {
+                break;
+            }
+            writer.Key(field.key);
+            writer.Text(normalizedPath);
+            writer.Text(options.universalFolderBackgroundImage.displayName);
+            writer.EndLine();
+            break;
+        }
+        case FieldKind::kFolderBackgroundEntry:
+            for (const auto& entry : options.folderBackgroundEntries) {
+                const std::wstring normalizedFolder = NormalizeFileSystemPath(entry.folderPath);
+                const std::wstring normalizedCache = NormalizeCachePath(entry.image.cachedImagePath, storageDirectory);
+                if (normalizedFolder.empty() || normalizedCache.empty()) {
+                    continue;
+                }
+                writer.Key(field.key);
+                writer.Text(normalizedFolder);
+                writer.Text(normalizedCache);
+                writer.Text(entry.image.displayName);
+                if (entry.applyToSubfolders) {
+                    writer.Bool(true);
+                }
+                writer.EndLine();
+            }
+            break;
+        case FieldKind::kContextMenuCommand:
+            WriteContextMenuItems(writer, options.contextMenuItems);
+            break;
+        case FieldKind::kDockMode:
+            writer.Key(field.key);
+            writer.Text(DockModeToString(options.tabDockMode));
+            writer.EndLine();
+            break;
+        case FieldKind::kLegacyFontTransparency:
+        case FieldKind::kContextMenuSubmenu:
+        case FieldKind::kContextMenuSeparator:
+        case FieldKind::kContextMenuEnd:
+            break;
+    }
+}
+
+}  // namespace
+
+ShellTabsOptions ParseOptionsDocument(std::string_view utf8, const std::wstring& storageDirectory) {
+    ParseState state;
+    state.storageDirectory = &storageDirectory;
+    state.contextMenuStack.push_back(&state.options.contextMenuItems);
+
+    if (utf8.substr(0, kUtf8Bom.size()) == kUtf8Bom) {
+        utf8.remove_prefix(kUtf8Bom.size());
+    }
+
+    size_t lineStart = 0;
+    while (lineStart < utf8.size()) {
+        const size_t lineEnd = utf8.find('\n', lineStart);
+        std::string_view line = utf8.substr(
+            lineStart, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - lineStart);
+        lineStart = lineEnd == std::string_view::npos ? utf8.size() : lineEnd + 1;
+
+        line = TrimUtf8(line);
+        if (line.empty() || line.front() == kCommentChar) {
+            continue;
+        }
+
+        const LineTokens tokens(line);
+        if (const OptionsField* field = FindOptionsField(tokens[0])) {
+            ApplyField(*field, tokens, state);
+        }
+    }
+
+    NormalizeContextMenuItems(&state.options.contextMenuItems);
+    ApplyGlowSurfaceFallbacks(state);
+    return std::move(state.options);
+}
+
+std::string SerializeOptionsDocument(const ShellTabsOptions& options, const std::wstring& storageDirectory) {
+    OptionsWriter writer(EstimateDocumentSize(options));
+    for (const auto& field : kOptionsFields) {
+        if (field.write) {
+            WriteField(writer, field, options, storageDirectory);
+        }
+    }
+    return writer.Release();
+}
+
+}  // namespace shelltabs
@@ -2459,14 +2459,14 @@ OptionsDialogResult ShowOptionsDialog(HWND parent, OptionsDialogPage initialPage
 
     // Initialize data
     auto data = std::make_unique<OptionsDialogData>();
-    data->originalOptions = store.Get();
+    data->originalOptions = *store.Get();
     data->workingOptions = data->originalOptions;
     data->initialTab = static_cast<int>(initialPage);
 
     // Load groups
     GroupStore& groupStore = GroupStore::Instance();
     if (groupStore.Load()) {
-        data->originalGroups = groupStore.Groups();
+        data->originalGroups = *groupStore.Groups();
         data->workingGroups = data->originalGroups;
         for (const auto& group : data->originalGroups) {
             data->workingGroupIds.push_back(group.name);
@@ -0,0 +1,135 @@
+#include "OptionsStore.h"
+
+#include "StringUtils.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace shelltabs {
+namespace {
+
+constexpr COLORREF kDefaultGlowPrimaryColor = RGB(0, 120, 215);
+constexpr COLORREF kDefaultGlowSecondaryColor = RGB(0, 153, 255);
+
+void NormalizeContextMenuItem(ContextMenuItem* item) {
+    if (!item) {
+        return;
+    }
+
+    if (item->type == ContextMenuItemType::kSeparator) {
+        item->label.clear();
+        item->executable.clear();
+        item->arguments.clear();
+    } else {
+        item->label = Trim(item->label);
+        item->executable = Trim(item->executable);
+        item->arguments = Trim(item->arguments);
+    }
+
+    item->iconSource = NormalizeContextMenuIconSource(item->iconSource);
+    item->workingDirectory = Trim(item->workingDirectory);
+    item->description = Trim(item->description);
+    item->id = Trim(item->id);
+
+    // Normalize visibility patterns
+    item->visibility.filePatterns = NormalizeContextMenuPatterns(item->visibility.filePatterns);
+    item->visibility.excludePatterns = NormalizeContextMenuPatterns(item->visibility.excludePatterns);
+
+    if (item->visibility.minimumSelection < 0) {
+        item->visibility.minimumSelection = 0;
+    }
+    if (item->visibility.maximumSelection < 0) {
+        item->visibility.maximumSelection = 0;
+    }
+    if (item->visibility.maximumSelection > 0 &&
+        item->visibility.maximumSelection < item->visibility.minimumSelection) {
+        item->visibility.maximumSelection = item->visibility.minimumSelection;
+    }
+}
+
+}  // namespace
+
+void NormalizeContextMenuItems(std::vector<ContextMenuItem>* items) {
+    if (!items) {
+        return;
+    }
+    for (auto& item : *items) {
+        NormalizeContextMenuItem(&item);
+        NormalizeContextMenuItems(&item.children);
+    }
+}
+
+// Normalize file patterns (convert to lowercase, remove duplicates)
+std::vector<std::wstring> NormalizeContextMenuPatterns(const std::vector<std::wstring>& patterns) {
+    std::vector<std::wstring> normalized;
+    normalized.reserve(patterns.size());
+
+    for (const auto& pattern : patterns) {
+        std::wstring trimmed = Trim(pattern);
+        if (trimmed.empty()) {
+            continue;
+        }
+
+        // Convert to lowercase
+        std::transform(trimmed.begin(), trimmed.end(), trimmed.begin(),
+                      [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+
+        // Add if not already present
+        if (std::find(normalized.begin(), normalized.end(), trimmed) == normalized.end()) {
+            normalized.emplace_back(std::move(trimmed));
+        }
+    }
+
+    std::sort(normalized.begin(), normalized.end());
+    return normalized;
+}
+
+void UpdateGlowPaletteFromLegacySettings(ShellTabsOptions& options) {
+    const bool gradient = options.useNeonGlowGradient;
+    const COLORREF primary = options.neonGlowPrimaryColor;
+    const COLORREF secondary = options.useNeonGlowGradient ? options.neonGlowSecondaryColor : primary;
+
+    const auto applyLegacy = [&](GlowSurfaceOptions& surface, bool allowAccent) {
+        if (allowAccent && options.useExplorerAccentColors) {
+            surface.mode = GlowSurfaceMode::kExplorerAccent;
+        } else if (gradient) {
+            surface.mode = GlowSurfaceMode::kGradient;
+        } else {
+            surface.mode = GlowSurfaceMode::kSolid;
+        }
+        surface.solidColor = primary;
+        surface.gradientStartColor = primary;
+        surface.gradientEndColor = gradient ? secondary : primary;
+    };
+
+    applyLegacy(options.glowPalette.header, false);
+    applyLegacy(options.glowPalette.toolbar, false);
+    applyLegacy(options.glowPalette.rebar, false);
+    applyLegacy(options.glowPalette.edits, false);
+    applyLegacy(options.glowPalette.listView, true);
+    applyLegacy(options.glowPalette.directUi, true);
+    applyLegacy(options.glowPalette.scrollbars, true);
+    applyLegacy(options.glowPalette.popupMenus, true);
+    applyLegacy(options.glowPalette.tooltips, true);
+}
+
+void UpdateLegacyGlowSettingsFromPalette(ShellTabsOptions& options) {
+    const GlowSurfaceOptions& header = options.glowPalette.header;
+
+    options.useExplorerAccentColors =
+        options.glowPalette.listView.mode == GlowSurfaceMode::kExplorerAccent;
+
+    options.useNeonGlowGradient = (header.mode == GlowSurfaceMode::kGradient);
+    options.neonGlowPrimaryColor = header.solidColor;
+    options.neonGlowSecondaryColor = options.useNeonGlowGradient ? header.gradientEndColor : header.solidColor;
+
+    options.useCustomNeonGlowColors =
+        header.solidColor != kDefaultGlowPrimaryColor ||
+        header.gradientStartColor != kDefaultGlowPrimaryColor ||
+        header.gradientEndColor != kDefaultGlowSecondaryColor;
+}
+
+}  // namespace shelltabs
@@ -2,16 +2,20 @@
 
 #include <algorithm>
 #include <atomic>
-#include <cassert>
 #include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <mutex>
 #include <optional>
 #include <string_view>
 #include <utility>
 #include <vector>
 
+#include <shlwapi.h>
+
+#include "CacheTraceRecorder.h"
 #include "Logging.h"
+#include "PreviewScaler.h"
 #include "Utilities.h"
 
 namespace shelltabs {
@@ -23,7 +27,7 @@ struct PreviewCache::AsyncRequest {
     };
 
     uint64_t id = 0;
-    std::wstring key;
+    PreviewKey key;
     UniquePidl pidl;
     SIZE size{};
     std::vector<Listener> listeners;
@@ -31,59 +35,48 @@ struct PreviewCache::AsyncRequest {
     RequestKind kind = RequestKind::kShellPreview;
     HWND window = nullptr;
     std::wstring ownerToken;
+    PreviewPriority priority = PreviewPriority::kInteractive;
+    // Work queue id; queued stays set until a worker picks the request up or
+    // it is cancelled.
+    uint64_t taskId = 0;
+    bool queued = false;
 };
 
 namespace {
 constexpr size_t kMaxPendingCaptureRequests = 8;
+constexpr wchar_t kPreviewStoreFileName[] = L"PreviewStore.bin";
 
-HBITMAP LoadShellItemPreview(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize, SIZE* outSize) {
-    if (!pidl) {
-        return nullptr;
-    }
-
-    Microsoft::WRL::ComPtr<IShellItem> item;
-    if (FAILED(SHCreateItemFromIDList(pidl, IID_PPV_ARGS(&item))) || !item) {
-        return nullptr;
-    }
-    Microsoft::WRL::ComPtr<IShellItemImageFactory> factory;
-    if (FAILED(item.As(&factory)) || !factory) {
-        return nullptr;
-    }
-
-    SIZE requestSize = desiredSize;
-    if (requestSize.cx <= 0 || requestSize.cy <= 0) {
-        requestSize = kPreviewImageSize;
-    }
+thread_local HRESULT t_workerCoInit = E_FAIL;
 
-    HBITMAP bitmap = nullptr;
-    HRESULT hr = factory->GetImage(requestSize,
-                                   SIIGBF_RESIZETOFIT | SIIGBF_BIGGERSIZEOK | SIIGBF_THUMBNAILONLY,
-                                   &bitmap);
-    if (FAILED(hr)) {
-        hr = factory->GetImage(requestSize, SIIGBF_RESIZETOFIT | SIIGBF_BIGGERSIZEOK, &bitmap);
-    }
-    if (FAILED(hr)) {
-        hr = factory->GetImage(requestSize, SIIGBF_ICONONLY, &bitmap);
-    }
-    if (FAILED(hr) || !bitmap) {
-        if (bitmap) {
-            DeleteObject(bitmap);
+PreviewWorkQueueOptions BuildWorkQueueOptions() {
+    PreviewWorkQueueOptions options;
+    options.workers = PreviewCache::kWorkerCount;
+    options.threadStart = []() { t_workerCoInit = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED); };
+    options.threadStop = []() {
+        if (SUCCEEDED(t_workerCoInit)) {
+            CoUninitialize();
         }
-        return nullptr;
-    }
+    };
+    return options;
+}
 
-    BITMAP bmp{};
-    if (GetObject(bitmap, sizeof(bmp), &bmp) <= 0) {
-        DeleteObject(bitmap);
-        return nullptr;
+void TracePreviewAccess(CacheTraceEvent event, const PreviewKey& key, size_t bytes) noexcept {
+    CacheTraceRecorder& recorder = CacheTraceRecorder::Instance();
+    if (!recorder.IsEnabled()) {
+        return;
     }
-    if (outSize) {
-        outSize->cx = bmp.bmWidth;
-        outSize->cy = bmp.bmHeight;
+    recorder.Record(CacheTraceSource::kPreview, event, key.low, bytes);
+}
+
+std::string_view PidlBytes(PCIDLIST_ABSOLUTE pidl) {
+    if (!pidl) {
+        return {};
     }
-    return bitmap;
+    return std::string_view(reinterpret_cast<const char*>(pidl), ILGetSize(pidl));
 }
 
+bool IsSamePidl(PCIDLIST_ABSOLUTE left, PCIDLIST_ABSOLUTE right) { return PidlBytes(left) == PidlBytes(right); }
+
 SIZE ComputeScaledSize(int srcWidth, int srcHeight, const SIZE& desiredSize) {
     SIZE result{srcWidth, srcHeight};
     if (srcWidth <= 0 || srcHeight <= 0) {
@@ -210,13 +203,11 @@ HBITMAP CaptureWindowPreview(HWND window, const SIZE& desiredSize, SIZE* outSize
     HDC srcDc = nullptr;
     HBITMAP srcBitmap = nullptr;
     void* srcBits = nullptr;
-    HDC destDc = nullptr;
     HBITMAP destBitmap = nullptr;
     void* destBits = nullptr;
     HBITMAP finalBitmap = nullptr;
     SIZE finalSize{0, 0};
     HGDIOBJ oldSrc = nullptr;
-    HGDIOBJ oldDest = nullptr;
     bool success = false;
 
     do {
@@ -242,6 +233,8 @@ HBITMAP CaptureWindowPreview(HWND window, const SIZE& desiredSize, SIZE* outSize
         if (!RenderWindowToDc(window, srcDc, srcWidth, srcHeight)) {
             break;
         }
+        // The pixels are read directly from here on.
+        GdiFlush();
 
         EnsureOpaqueAlpha(srcBits, srcWidth, srcHeight);
 
@@ -255,19 +248,13 @@ HBITMAP CaptureWindowPreview(HWND window, const SIZE& desiredSize, SIZE* outSize
                 break;
             }
 
-            destDc = CreateCompatibleDC(screenDc);
-            if (!destDc) {
+            const PreviewPixelView source{static_cast<const uint32_t*>(srcBits), static_cast<uint32_t>(srcWidth),
+                                          static_cast<uint32_t>(srcHeight), static_cast<size_t>(srcWidth)};
+            if (!ScalePreviewPixels(source, static_cast<uint32_t*>(destBits), static_cast<uint32_t>(targetSize.cx),
+                                    static_cast<uint32_t>(targetSize.cy))) {
                 break;
             }
 
-            oldDest = SelectObject(destDc, destBitmap);
-            SetStretchBltMode(destDc, HALFTONE);
-            SetBrushOrgEx(destDc, 0, 0, nullptr);
-            if (!StretchBlt(destDc, 0, 0, targetSize.cx, targetSize.cy, srcDc, 0, 0, srcWidth, srcHeight, SRCCOPY)) {
-                break;
-            }
-
-            EnsureOpaqueAlpha(destBits, targetSize.cx, targetSize.cy);
             success = true;
             finalBitmap = destBitmap;
             destBitmap = nullptr;
@@ -280,12 +267,6 @@ HBITMAP CaptureWindowPreview(HWND window, const SIZE& desiredSize, SIZE* outSize
         }
     } while (false);
 
-    if (oldDest && destDc) {
-        SelectObject(destDc, oldDest);
-    }
-    if (destDc) {
-        DeleteDC(destDc);
-    }
     if (destBitmap) {
         DeleteObject(destBitmap);
     }
@@ -313,6 +294,144 @@ HBITMAP CaptureWindowPreview(HWND window, const SIZE& desiredSize, SIZE* outSize
     return finalBitmap;
 }
 
+BITMAPINFO BuildTopDownInfo(LONG width, LONG height) {
+    BITMAPINFO info{};
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    return info;
+}
+
+std::optional<PreviewPixels> ReadBitmapPixels(HBITMAP bitmap, const SIZE& size) {
+    if (!bitmap || size.cx <= 0 || size.cy <= 0) {
+        return std::nullopt;
+    }
+    HDC screenDc = GetDC(nullptr);
+    if (!screenDc) {
+        return std::nullopt;
+    }
+    PreviewPixels pixels;
+    pixels.width = static_cast<uint32_t>(size.cx);
+    pixels.height = static_cast<uint32_t>(size.cy);
+    pixels.bgra.resize(static_cast<size_t>(size.cx) * static_cast<size_t>(size.cy));
+    BITMAPINFO info = BuildTopDownInfo(size.cx, size.cy);
+    const int lines = GetDIBits(screenDc, bitmap, 0, static_cast<UINT>(size.cy), pixels.bgra.data(), &info,
+                                DIB_RGB_COLORS);
+    ReleaseDC(nullptr, screenDc);
+    if (lines != size.cy) {
+        return std::nullopt;
+    }
+    return pixels;
+}
+
+HBITMAP CreateBitmapFromPixels(const PreviewPixels& pixels) {
+    if (pixels.width == 0 || pixels.height == 0 ||
+        pixels.bgra.size() < static_cast<size_t>(pixels.width) * pixels.height) {
+        return nullptr;
+    }
+    BITMAPINFO info = BuildTopDownInfo(static_cast<LONG>(pixels.width), static_cast<LONG>(pixels.height));
+    void* bits = nullptr;
+    HBITMAP bitmap = CreateDIBSection(nullptr, &info, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (!bitmap || !bits) {
+        if (bitmap) {
+            DeleteObject(bitmap);
+        }
+        return nullptr;
+    }
+    std::memcpy(bits, pixels.bgra.data(), static_cast<size_t>(pixels.width) * pixels.height * sizeof(uint32_t));
+    return bitmap;
+}
+
+HBITMAP DownscaleBitmap(HBITMAP bitmap, const SIZE& size, const SIZE& targetSize) {
+    std::optional<PreviewPixels> pixels = ReadBitmapPixels(bitmap, size);
+    if (!pixels) {
+        return nullptr;
+    }
+    PreviewPixels scaled;
+    scaled.width = static_cast<uint32_t>(targetSize.cx);
+    scaled.height = static_cast<uint32_t>(targetSize.cy);
+    scaled.bgra.resize(static_cast<size_t>(scaled.width) * scaled.height);
+    const PreviewPixelView source{pixels->bgra.data(), pixels->width, pixels->height, pixels->width};
+    if (!ScalePreviewPixels(source, scaled.bgra.data(), scaled.width, scaled.height)) {
+        return nullptr;
+    }
+    return CreateBitmapFromPixels(scaled);
+}
+
+HBITMAP LoadShellItemPreview(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize, SIZE* outSize) {
+    if (!pidl) {
+        return nullptr;
+    }
+
+    Microsoft::WRL::ComPtr<IShellItem> item;
+    if (FAILED(SHCreateItemFromIDList(pidl, IID_PPV_ARGS(&item))) || !item) {
+        return nullptr;
+    }
+    Microsoft::WRL::ComPtr<IShellItemImageFactory> factory;
+    if (FAILED(item.As(&factory)) || !factory) {
+        return nullptr;
+    }
+
+    SIZE requestSize = desiredSize;
+    if (requestSize.cx <= 0 || requestSize.cy <= 0) {
+        requestSize = kPreviewImageSize;
+    }
+
+    HBITMAP bitmap = nullptr;
+    HRESULT hr = factory->GetImage(requestSize,
+                                   SIIGBF_RESIZETOFIT | SIIGBF_BIGGERSIZEOK | SIIGBF_THUMBNAILONLY,
+                                   &bitmap);
+    if (FAILED(hr)) {
+        hr = factory->GetImage(requestSize, SIIGBF_RESIZETOFIT | SIIGBF_BIGGERSIZEOK, &bitmap);
+    }
+    if (FAILED(hr)) {
+        hr = factory->GetImage(requestSize, SIIGBF_ICONONLY, &bitmap);
+    }
+    if (FAILED(hr) || !bitmap) {
+        if (bitmap) {
+            DeleteObject(bitmap);
+        }
+        return nullptr;
+    }
+
+    BITMAP bmp{};
+    if (GetObject(bitmap, sizeof(bmp), &bmp) <= 0) {
+        DeleteObject(bitmap);
+        return nullptr;
+    }
+    SIZE size{bmp.bmWidth, bmp.bmHeight};
+    // BIGGERSIZEOK can hand back an image far larger than requested.
+    const SIZE targetSize = ComputeScaledSize(size.cx, size.cy, requestSize);
+    if (targetSize.cx < size.cx || targetSize.cy < size.cy) {
+        if (HBITMAP scaled = DownscaleBitmap(bitmap, size, targetSize)) {
+            DeleteObject(bitmap);
+            bitmap = scaled;
+            size = targetSize;
+        }
+    }
+    if (outSize) {
+        *outSize = size;
+    }
+    return bitmap;
+}
+
+// Last-write time of a local folder. Virtual and network items report zero,
+// so their stored previews stay valid until they are captured again.
+uint64_t QueryFolderStamp(PCIDLIST_ABSOLUTE pidl) {
+    wchar_t path[MAX_PATH] = {};
+    if (!SHGetPathFromIDListW(pidl, path) || path[0] == L'\0' || path[1] != L':' || PathIsNetworkPathW(path)) {
+        return 0;
+    }
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &data)) {
+        return 0;
+    }
+    return (static_cast<uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+
 }  // namespace
 
 PreviewCache& PreviewCache::Instance() {
@@ -320,22 +439,28 @@ PreviewCache& PreviewCache::Instance() {
     return cache;
 }
 
-PreviewCache::~PreviewCache() {
-    {
-        std::unique_lock lock(m_requestMutex);
-        m_shutdown = true;
-    }
-    m_requestCv.notify_all();
-    if (m_workerThread.joinable()) {
-        m_workerThread.join();
+PreviewCache::PreviewCache() : m_tiers(BuildTierHooks(), PreviewTierLimits{}), m_workQueue(BuildWorkQueueOptions()) {
+    m_budgetClient = GdiResourceBudget::Instance().RegisterClient(
+        L"PreviewCache", [this](const GdiResourceCost& excess) { return ShedColdEntries(excess); });
+
+    const std::wstring directory = GetShellTabsDataDirectory();
+    if (!directory.empty() && !m_diskStore.Open(directory + L"\\" + kPreviewStoreFileName)) {
+        LogMessage(LogLevel::Warning, L"PreviewCache could not open its preview store in %ls", directory.c_str());
     }
+}
+
+PreviewCache::~PreviewCache() {
+    m_workQueue.Shutdown();
     {
         std::scoped_lock lock(m_requestMutex);
+        m_requestMap.clear();
+        m_requestsByKey.clear();
         m_captureRequestsByKey.clear();
         m_captureRequestsByOwner.clear();
-        m_pendingCaptureCount = 0;
+        m_queuedCaptureIds.clear();
     }
     Clear();
+    GdiResourceBudget::Instance().UnregisterClient(m_budgetClient);
 }
 
 std::optional<PreviewImage> PreviewCache::GetPreview(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize) {
@@ -345,29 +470,50 @@ std::optional<PreviewImage> PreviewCache::GetPreview(PCIDLIST_ABSOLUTE pidl, con
 
     UNREFERENCED_PARAMETER(desiredSize);
 
-    const std::wstring key = BuildCacheKey(pidl);
-    if (key.empty()) {
+    const PreviewKey key = BuildCacheKey(pidl);
+    if (key.Empty()) {
         return std::nullopt;
     }
 
-    std::scoped_lock lock(m_mutex);
-    auto it = m_entries.find(key);
-    if (it == m_entries.end() || !it->second.bitmap) {
-        return std::nullopt;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (!IsKeyOwnerLocked(key, pidl)) {
+            // The cached preview belongs to another item with the same hash.
+            TracePreviewAccess(CacheTraceEvent::kMiss, key, 0);
+            return std::nullopt;
+        }
+        const HotPreview* preview = m_tiers.Find(key);
+        if (preview && preview->bitmap) {
+            TracePreviewAccess(CacheTraceEvent::kHit, key, preview->cost.bytes);
+            return PreviewImage{preview->bitmap, preview->size};
+        }
+        TracePreviewAccess(CacheTraceEvent::kMiss, key, 0);
     }
 
-    TouchEntryLocked(it->second, it->first);
-    return PreviewImage{it->second.bitmap, it->second.size};
+    // Previews from an earlier Explorer session are only on disk.
+    return RestoreFromDisk(pidl, key);
+}
+
+bool PreviewCache::HasPreviewInMemory(PCIDLIST_ABSOLUTE pidl) {
+    if (!pidl) {
+        return false;
+    }
+    const PreviewKey key = BuildCacheKey(pidl);
+    if (key.Empty()) {
+        return false;
+    }
+    std::scoped_lock lock(m_mutex);
+    return m_tiers.Contains(key) && IsKeyOwnerLocked(key, pidl);
 }
 
 void PreviewCache::StorePreviewFromWindow(PCIDLIST_ABSOLUTE pidl, HWND window, const SIZE& desiredSize,
-                                          std::wstring_view ownerToken) {
+                                          std::wstring_view ownerToken, PreviewPriority priority) {
     if (!pidl || !window || !IsWindow(window)) {
         return;
     }
 
-    const std::wstring key = BuildCacheKey(pidl);
-    if (key.empty()) {
+    const PreviewKey key = BuildCacheKey(pidl);
+    if (key.Empty()) {
         return;
     }
 
@@ -376,14 +522,13 @@ void PreviewCache::StorePreviewFromWindow(PCIDLIST_ABSOLUTE pidl, HWND window, c
         return;
     }
 
-    EnsureWorkerThread();
-
     auto request = std::make_shared<AsyncRequest>();
     request->kind = RequestKind::kWindowCapture;
     request->key = key;
     request->pidl = std::move(clone);
     request->size = desiredSize;
     request->window = window;
+    request->priority = priority;
     if (!ownerToken.empty()) {
         request->ownerToken.assign(ownerToken);
     }
@@ -392,8 +537,12 @@ void PreviewCache::StorePreviewFromWindow(PCIDLIST_ABSOLUTE pidl, HWND window, c
         std::scoped_lock lock(m_requestMutex);
         uint64_t cancelledId = 0;
         if (auto it = m_captureRequestsByKey.find(request->key); it != m_captureRequestsByKey.end()) {
-            cancelledId = it->second;
-            CancelCaptureRequestLocked(cancelledId);
+            auto pending = m_requestMap.find(it->second);
+            if (pending == m_requestMap.end() || !pending->second ||
+                IsSamePidl(pending->second->pidl.get(), request->pidl.get())) {
+                cancelledId = it->second;
+                CancelCaptureRequestLocked(cancelledId);
+            }
         }
         if (!request->ownerToken.empty()) {
             if (auto it = m_captureRequestsByOwner.find(request->ownerToken); it != m_captureRequestsByOwner.end()) {
@@ -404,21 +553,9 @@ void PreviewCache::StorePreviewFromWindow(PCIDLIST_ABSOLUTE pidl, HWND window, c
             }
         }
 
-        while (m_pendingCaptureCount >= kMaxPendingCaptureRequests) {
-            auto eraseIt = std::find_if(m_requestQueue.begin(), m_requestQueue.end(), [](const auto& candidate) {
-                return candidate && candidate->kind == RequestKind::kWindowCapture;
-            });
-            if (eraseIt == m_requestQueue.end()) {
-                break;
-            }
-            if (*eraseIt) {
-                CancelCaptureRequestLocked((*eraseIt)->id);
-            } else {
-                m_requestQueue.erase(eraseIt);
-                if (m_pendingCaptureCount > 0) {
-                    --m_pendingCaptureCount;
-                }
-            }
+        // Drop the oldest queued captures rather than let a burst pile up.
+        while (m_queuedCaptureIds.size() >= kMaxPendingCaptureRequests) {
+            CancelCaptureRequestLocked(m_queuedCaptureIds.front());
         }
 
         request->id = m_nextRequestId++;
@@ -426,27 +563,29 @@ void PreviewCache::StorePreviewFromWindow(PCIDLIST_ABSOLUTE pidl, HWND window, c
             m_nextRequestId = 1;
         }
 
-        m_requestQueue.push_back(request);
         m_requestMap[request->id] = request;
         RegisterCaptureRequestLocked(request);
-        ++m_pendingCaptureCount;
         SetPendingRequestIdLocked(request->key, RequestKind::kWindowCapture, request->id);
+        request->taskId = m_workQueue.Submit(priority, [this, request]() { RunRequest(request); });
+        if (request->taskId == 0) {
+            CancelCaptureRequestLocked(request->id);
+            return;
+        }
+        request->queued = true;
+        m_queuedCaptureIds.push_back(request->id);
     }
-
-    m_requestCv.notify_one();
 }
 
-uint64_t PreviewCache::RequestPreviewAsync(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize, HWND notifyHwnd, UINT message) {
+uint64_t PreviewCache::RequestPreviewAsync(PCIDLIST_ABSOLUTE pidl, const SIZE& desiredSize, HWND notifyHwnd, UINT message,
+                                           PreviewPriority priority) {
     if (!pidl) {
         return 0;
     }
-    const std::wstring key = BuildCacheKey(pidl);
-    if (key.empty()) {
+    const PreviewKey key = BuildCacheKey(pidl);
+    if (key.Empty()) {
         return 0;
     }
 
-    EnsureWorkerThread();
-
     const auto addListenerLocked = [&](const std::shared_ptr<AsyncRequest>& target) {
         if (!target || !notifyHwnd || message == 0) {
             return;
@@ -474,7 +613,15 @@ uint64_t PreviewCache::RequestPreviewAsync(PCIDLIST_ABSOLUTE pidl, const SIZE& d
             ClearPendingRequestIdLocked(key, RequestKind::kShellPreview, requestId);
             return 0;
         }
+        if (!IsSamePidl(existing->pidl.get(), pidl)) {
+            // Hash collision; the new request takes over the key.
+            return 0;
+        }
         addListenerLocked(existing);
+        if (existing->queued && priority < existing->priority &&
+            m_workQueue.Reprioritize(existing->taskId, priority)) {
+            existing->priority = priority;
+        }
         return existing->id;
     };
 
@@ -496,6 +643,7 @@ uint64_t PreviewCache::RequestPreviewAsync(PCIDLIST_ABSOLUTE pidl, const SIZE& d
     request->key = key;
     request->pidl = std::move(clone);
     request->size = desiredSize;
+    request->priority = priority;
     if (notifyHwnd && message != 0) {
         request->listeners.push_back({notifyHwnd, message});
     }
@@ -512,12 +660,15 @@ uint64_t PreviewCache::RequestPreviewAsync(PCIDLIST_ABSOLUTE pidl, const SIZE& d
             m_nextRequestId = 1;
         }
 
-        m_requestQueue.push_back(request);
+        request->taskId = m_workQueue.Submit(priority, [this, request]() { RunRequest(request); });
+        if (request->taskId == 0) {
+            return 0;
+        }
+        request->queued = true;
         m_requestMap[request->id] = request;
         SetPendingRequestIdLocked(request->key, RequestKind::kShellPreview, request->id);
     }
 
-    m_requestCv.notify_one();
     return request->id;
 }
 
@@ -535,17 +686,18 @@ void PreviewCache::CancelRequest(uint64_t requestId) {
         CancelCaptureRequestLocked(requestId);
         return;
     }
-    if (request) {
-        request->cancelled.store(true, std::memory_order_release);
-        request->listeners.clear();
-        ClearPendingRequestIdLocked(request->key, request->kind, request->id);
+    if (!request) {
+        m_requestMap.erase(it);
+        return;
     }
-    for (auto queueIt = m_requestQueue.begin(); queueIt != m_requestQueue.end(); ++queueIt) {
-        if (*queueIt && (*queueIt)->id == requestId) {
-            m_requestQueue.erase(queueIt);
-            m_requestMap.erase(it);
-            return;
-        }
+    request->cancelled.store(true, std::memory_order_release);
+    request->listeners.clear();
+    ClearPendingRequestIdLocked(request->key, request->kind, request->id);
+    // Queued work is dropped outright; a running request finishes and is
+    // discarded by its worker.
+    if (request->queued && m_workQueue.Cancel(request->taskId)) {
+        MarkDequeuedLocked(*request);
+        m_requestMap.erase(it);
     }
 }
 
@@ -553,22 +705,22 @@ void PreviewCache::CancelPendingCapturesForKey(PCIDLIST_ABSOLUTE pidl) {
     if (!pidl) {
         return;
     }
-    const std::wstring key = BuildCacheKey(pidl);
-    if (key.empty()) {
+    const PreviewKey key = BuildCacheKey(pidl);
+    if (key.Empty()) {
         return;
     }
 
     std::scoped_lock lock(m_requestMutex);
-    if (auto it = m_captureRequestsByKey.find(key); it != m_captureRequestsByKey.end()) {
-        CancelCaptureRequestLocked(it->second);
-    }
-    for (auto& [_, pending] : m_requestMap) {
-        if (pending && pending->kind == RequestKind::kWindowCapture && pending->key == key) {
-            pending->cancelled.store(true, std::memory_order_release);
-            ClearPendingRequestIdLocked(pending->key, RequestKind::kWindowCapture, pending->id);
-            UnregisterCaptureRequestLocked(pending);
+    std::vector<uint64_t> cancelled;
+    for (const auto& [id, pending] : m_requestMap) {
+        if (pending && pending->kind == RequestKind::kWindowCapture && pending->key == key &&
+            IsSamePidl(pending->pidl.get(), pidl)) {
+            cancelled.push_back(id);
         }
     }
+    for (uint64_t id : cancelled) {
+        CancelCaptureRequestLocked(id);
+    }
 }
 
 void PreviewCache::CancelPendingCapturesForOwner(std::wstring_view ownerToken) {
@@ -577,70 +729,108 @@ void PreviewCache::CancelPendingCapturesForOwner(std::wstring_view ownerToken) {
     }
 
     std::scoped_lock lock(m_requestMutex);
-    const std::wstring token{ownerToken};
-    if (auto it = m_captureRequestsByOwner.find(token); it != m_captureRequestsByOwner.end()) {
-        CancelCaptureRequestLocked(it->second);
-    }
-    for (auto& [_, pending] : m_requestMap) {
-        if (pending && pending->kind == RequestKind::kWindowCapture && pending->ownerToken == token) {
-            pending->cancelled.store(true, std::memory_order_release);
-            ClearPendingRequestIdLocked(pending->key, RequestKind::kWindowCapture, pending->id);
-            UnregisterCaptureRequestLocked(pending);
+    std::vector<uint64_t> cancelled;
+    for (const auto& [id, pending] : m_requestMap) {
+        if (pending && pending->kind == RequestKind::kWindowCapture && pending->ownerToken == ownerToken) {
+            cancelled.push_back(id);
         }
     }
+    for (uint64_t id : cancelled) {
+        CancelCaptureRequestLocked(id);
+    }
 }
 
 void PreviewCache::Clear() {
     std::scoped_lock lock(m_mutex);
-    for (auto& [_, entry] : m_entries) {
-        if (entry.bitmap) {
-            DeleteObject(entry.bitmap);
-            entry.bitmap = nullptr;
+    if (CacheTraceRecorder::Instance().IsEnabled()) {
+        for (const PreviewKey& key : m_tiers.Keys()) {
+            TracePreviewAccess(CacheTraceEvent::kInvalidate, key, 0);
         }
     }
-    m_entries.clear();
-    m_lruList.clear();
+    m_tiers.Clear();
+    m_keyPidls.clear();
 }
 
-void PreviewCache::TrimCacheLocked() {
-    while (m_entries.size() > kMaxEntries && !m_lruList.empty()) {
-        std::wstring victimKey = std::move(m_lruList.back());
-        m_lruList.pop_back();
-
-        auto it = m_entries.find(victimKey);
-        if (it == m_entries.end()) {
-            assert(false && "PreviewCache LRU list out of sync with entries");
-            LogMessage(LogLevel::Warning, L"PreviewCache lost track of %ls during eviction", victimKey.c_str());
-            continue;
+PreviewCache::PreviewTiers::Hooks PreviewCache::BuildTierHooks() {
+    PreviewTiers::Hooks hooks;
+    hooks.readPixels = [](const HotPreview& preview) { return ReadBitmapPixels(preview.bitmap, preview.size); };
+    hooks.createImage = [this](const PreviewPixels& pixels) { return CreateHotPreview(pixels); };
+    hooks.destroyImage = [this](HotPreview& preview) { DestroyHotPreview(preview); };
+    hooks.observer = [this](const PreviewKey& key, PreviewTierEvent event, size_t bytes) {
+        if (event == PreviewTierEvent::kEvicted) {
+            m_keyPidls.erase(key);
+            TracePreviewAccess(CacheTraceEvent::kEvict, key, bytes);
         }
+    };
+    return hooks;
+}
 
-        Entry& entry = it->second;
-        entry.inLruList = false;
-        if (entry.bitmap) {
-            DeleteObject(entry.bitmap);
-        }
-        LogMessage(LogLevel::Info, L"PreviewCache evicted %ls", victimKey.c_str());
-        m_entries.erase(it);
+std::optional<PreviewCache::HotPreview> PreviewCache::CreateHotPreview(const PreviewPixels& pixels) {
+    HBITMAP bitmap = CreateBitmapFromPixels(pixels);
+    if (!bitmap) {
+        return std::nullopt;
     }
+    HotPreview preview;
+    preview.bitmap = bitmap;
+    preview.size = SIZE{static_cast<LONG>(pixels.width), static_cast<LONG>(pixels.height)};
+    preview.cost = EstimateBitmapCost(preview.size.cx, preview.size.cy, false);
+    GdiResourceBudget::Instance().Charge(m_budgetClient, preview.cost);
+    return preview;
+}
 
-    assert(m_lruList.size() == m_entries.size());
+void PreviewCache::DestroyHotPreview(HotPreview& preview) {
+    if (preview.bitmap) {
+        DeleteObject(preview.bitmap);
+        preview.bitmap = nullptr;
+    }
+    GdiResourceBudget::Instance().Credit(m_budgetClient, preview.cost);
+    preview.cost = {};
 }
 
-std::wstring PreviewCache::BuildCacheKey(PCIDLIST_ABSOLUTE pidl) {
-    if (!pidl) {
+GdiBudgetShedResult PreviewCache::ShedColdEntries(const GdiResourceCost& excess) {
+    GdiBudgetShedResult result;
+    GdiResourceBudget& budget = GdiResourceBudget::Instance();
+    std::scoped_lock lock(m_mutex);
+    const GdiResourceCost before = budget.ClientUsage(m_budgetClient);
+    // Demoted previews free their bitmaps but stay available compressed.
+    while ((result.freed.bytes < excess.bytes || result.freed.handles < excess.handles) &&
+           m_tiers.DemoteColdest(1) == 1) {
+        ++result.entries;
+        const GdiResourceCost now = budget.ClientUsage(m_budgetClient);
+        result.freed.bytes = before.bytes > now.bytes ? before.bytes - now.bytes : 0;
+        result.freed.handles = before.handles > now.handles ? before.handles - now.handles : 0;
+    }
+    return result;
+}
+
+PreviewKey PreviewCache::BuildCacheKey(PCIDLIST_ABSOLUTE pidl) {
+    const std::string_view bytes = PidlBytes(pidl);
+    if (bytes.empty()) {
         return {};
     }
-    std::wstring key = GetParsingName(pidl);
-    if (!key.empty()) {
-        return key;
+    return HashPreviewKey(bytes.data(), bytes.size());
+}
+
+PreviewDiskKey PreviewCache::BuildDiskKey(PCIDLIST_ABSOLUTE pidl, const PreviewKey& key) {
+    PreviewDiskKey diskKey;
+    diskKey.item = key;
+    diskKey.folderStamp = QueryFolderStamp(pidl);
+    return diskKey;
+}
+
+bool PreviewCache::IsKeyOwnerLocked(const PreviewKey& key, PCIDLIST_ABSOLUTE pidl) {
+    auto it = m_keyPidls.find(key);
+    if (it == m_keyPidls.end() || it->second == PidlBytes(pidl)) {
+        return true;
     }
-    wchar_t buffer[32];
-    _snwprintf_s(buffer, _TRUNCATE, L"pidl:%p", pidl);
-    return buffer;
+    ++m_keyCollisions;
+    LogMessage(LogLevel::Warning, L"PreviewCache key collision (%llu so far)",
+               static_cast<unsigned long long>(m_keyCollisions));
+    return false;
 }
 
-uint64_t PreviewCache::GetPendingRequestIdLocked(const std::wstring& key, RequestKind kind) {
-    if (key.empty()) {
+uint64_t PreviewCache::GetPendingRequestIdLocked(const PreviewKey& key, RequestKind kind) {
+    if (key.Empty()) {
         return 0;
     }
     auto it = m_requestsByKey.find(key);
@@ -653,8 +843,8 @@ uint64_t PreviewCache::GetPendingRequestIdLocked(const std::wstring& key, Reques
     return it->second.windowCaptureId;
 }
 
-void PreviewCache::SetPendingRequestIdLocked(const std::wstring& key, RequestKind kind, uint64_t requestId) {
-    if (key.empty() || requestId == 0) {
+void PreviewCache::SetPendingRequestIdLocked(const PreviewKey& key, RequestKind kind, uint64_t requestId) {
+    if (key.Empty() || requestId == 0) {
         return;
     }
     PendingKeyEntry& entry = m_requestsByKey[key];
@@ -665,8 +855,8 @@ void PreviewCache::SetPendingRequestIdLocked(const std::wstring& key, RequestKin
     }
 }
 
-void PreviewCache::ClearPendingRequestIdLocked(const std::wstring& key, RequestKind kind, uint64_t requestId) {
-    if (key.empty()) {
+void PreviewCache::ClearPendingRequestIdLocked(const PreviewKey& key, RequestKind kind, uint64_t requestId) {
+    if (key.Empty()) {
         return;
     }
     auto it = m_requestsByKey.find(key);
@@ -691,7 +881,7 @@ void PreviewCache::RegisterCaptureRequestLocked(const std::shared_ptr<AsyncReque
     if (!request || request->kind != RequestKind::kWindowCapture) {
         return;
     }
-    if (!request->key.empty()) {
+    if (!request->key.Empty()) {
         m_captureRequestsByKey[request->key] = request->id;
     }
     if (!request->ownerToken.empty()) {
@@ -703,7 +893,7 @@ void PreviewCache::UnregisterCaptureRequestLocked(const std::shared_ptr<AsyncReq
     if (!request || request->kind != RequestKind::kWindowCapture) {
         return;
     }
-    if (!request->key.empty()) {
+    if (!request->key.Empty()) {
         auto it = m_captureRequestsByKey.find(request->key);
         if (it != m_captureRequestsByKey.end() && it->second == request->id) {
             m_captureRequestsByKey.erase(it);
@@ -721,145 +911,160 @@ void PreviewCache::CancelCaptureRequestLocked(uint64_t requestId) {
     if (requestId == 0) {
         return;
     }
-    std::shared_ptr<AsyncRequest> request;
-    bool removedFromQueue = false;
-    for (auto it = m_requestQueue.begin(); it != m_requestQueue.end(); ++it) {
-        const auto& pending = *it;
-        if (pending && pending->id == requestId) {
-            request = pending;
-            m_requestQueue.erase(it);
-            removedFromQueue = true;
-            break;
+    auto mapIt = m_requestMap.find(requestId);
+    if (mapIt == m_requestMap.end()) {
+        auto queuedIt = std::find(m_queuedCaptureIds.begin(), m_queuedCaptureIds.end(), requestId);
+        if (queuedIt != m_queuedCaptureIds.end()) {
+            m_queuedCaptureIds.erase(queuedIt);
         }
+        return;
     }
+    const std::shared_ptr<AsyncRequest> request = mapIt->second;
+    m_requestMap.erase(mapIt);
     if (!request) {
-        auto mapIt = m_requestMap.find(requestId);
-        if (mapIt != m_requestMap.end()) {
-            request = mapIt->second;
-        }
+        return;
     }
-    if (request && request->kind == RequestKind::kWindowCapture) {
-        request->cancelled.store(true, std::memory_order_release);
-        request->listeners.clear();
-        ClearPendingRequestIdLocked(request->key, RequestKind::kWindowCapture, request->id);
-        UnregisterCaptureRequestLocked(request);
-        if (removedFromQueue && m_pendingCaptureCount > 0) {
-            --m_pendingCaptureCount;
-        }
-    } else if (removedFromQueue && m_pendingCaptureCount > 0) {
-        --m_pendingCaptureCount;
+    if (request->queued) {
+        // A worker that already dequeued it sees the cancelled flag instead.
+        m_workQueue.Cancel(request->taskId);
+        MarkDequeuedLocked(*request);
     }
-    m_requestMap.erase(requestId);
+    request->cancelled.store(true, std::memory_order_release);
+    request->listeners.clear();
+    ClearPendingRequestIdLocked(request->key, RequestKind::kWindowCapture, request->id);
+    UnregisterCaptureRequestLocked(request);
 }
 
-void PreviewCache::EnsureWorkerThread() {
-    std::scoped_lock lock(m_requestMutex);
-    if (m_workerThread.joinable()) {
+void PreviewCache::MarkDequeuedLocked(AsyncRequest& request) {
+    if (!request.queued) {
         return;
     }
-    m_shutdown = false;
-    m_workerThread = std::thread([this]() { ProcessRequests(); });
+    request.queued = false;
+    if (request.kind == RequestKind::kWindowCapture) {
+        auto it = std::find(m_queuedCaptureIds.begin(), m_queuedCaptureIds.end(), request.id);
+        if (it != m_queuedCaptureIds.end()) {
+            m_queuedCaptureIds.erase(it);
+        }
+    }
 }
 
-void PreviewCache::ProcessRequests() {
-    const HRESULT coInit = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
-    while (true) {
-        std::shared_ptr<AsyncRequest> request;
-        {
-            std::unique_lock lock(m_requestMutex);
-            m_requestCv.wait(lock, [this]() { return m_shutdown || !m_requestQueue.empty(); });
-            if (m_shutdown && m_requestQueue.empty()) {
-                break;
-            }
-            request = m_requestQueue.front();
-            m_requestQueue.pop_front();
-            if (request && request->kind == RequestKind::kWindowCapture) {
-                if (m_pendingCaptureCount > 0) {
-                    --m_pendingCaptureCount;
-                }
-            }
-        }
-        if (!request) {
-            continue;
-        }
+void PreviewCache::RunRequest(const std::shared_ptr<AsyncRequest>& request) {
+    {
+        std::scoped_lock lock(m_requestMutex);
+        MarkDequeuedLocked(*request);
+    }
 
-        const bool cancelledBeforeWork = request->cancelled.load(std::memory_order_acquire);
+    const bool cancelledBeforeWork = request->cancelled.load(std::memory_order_acquire);
 
-        SIZE generatedSize{};
-        HBITMAP bitmap = nullptr;
-        if (!cancelledBeforeWork) {
-            if (request->kind == RequestKind::kShellPreview) {
+    SIZE generatedSize{};
+    HBITMAP bitmap = nullptr;
+    if (!cancelledBeforeWork) {
+        if (request->kind == RequestKind::kShellPreview) {
+            // Callers only check memory before asking, so a preview from an
+            // earlier session is restored here instead of regenerated.
+            if (!RestoreFromDisk(request->pidl.get(), request->key)) {
                 bitmap = LoadShellItemPreview(request->pidl.get(), request->size, &generatedSize);
-            } else {
-                bitmap = CaptureWindowPreview(request->window, request->size, &generatedSize);
             }
+        } else {
+            bitmap = CaptureWindowPreview(request->window, request->size, &generatedSize);
         }
+    }
 
-        const bool cancelledAfterWork = request->cancelled.load(std::memory_order_acquire);
-        bool stored = false;
-        if (!cancelledAfterWork && bitmap) {
-            StoreBitmapForKey(request->key, bitmap, generatedSize);
-            stored = true;
-        }
-        if (!stored && bitmap) {
-            DeleteObject(bitmap);
-            bitmap = nullptr;
-        }
-
-        const uint64_t id = request->id;
+    const bool cancelledAfterWork = request->cancelled.load(std::memory_order_acquire);
+    bool stored = false;
+    if (!cancelledAfterWork && bitmap) {
+        PersistToDisk(request->pidl.get(), request->key, bitmap, generatedSize);
+        StoreBitmapForKey(request->key, request->pidl.get(), bitmap, generatedSize);
+        stored = true;
+    }
+    if (!stored && bitmap) {
+        DeleteObject(bitmap);
+        bitmap = nullptr;
+    }
 
-        {
-            std::scoped_lock lock(m_requestMutex);
-            UnregisterCaptureRequestLocked(request);
-            ClearPendingRequestIdLocked(request->key, request->kind, id);
-            m_requestMap.erase(id);
+    const uint64_t id = request->id;
+    std::vector<AsyncRequest::Listener> listeners;
+    {
+        std::scoped_lock lock(m_requestMutex);
+        UnregisterCaptureRequestLocked(request);
+        ClearPendingRequestIdLocked(request->key, request->kind, id);
+        auto mapIt = m_requestMap.find(id);
+        if (mapIt != m_requestMap.end() && mapIt->second == request) {
+            m_requestMap.erase(mapIt);
         }
-
-        if (request->kind == RequestKind::kShellPreview && !cancelledAfterWork) {
-            for (const auto& listener : request->listeners) {
-                if (listener.notify && listener.message != 0) {
-                    PostMessageW(listener.notify, listener.message, static_cast<WPARAM>(id), 0);
-                }
-            }
+        if (request->kind == RequestKind::kShellPreview && !request->cancelled.load(std::memory_order_acquire)) {
+            listeners = request->listeners;
         }
     }
-    if (SUCCEEDED(coInit)) {
-        CoUninitialize();
+
+    for (const auto& listener : listeners) {
+        if (listener.notify && listener.message != 0) {
+            PostMessageW(listener.notify, listener.message, static_cast<WPARAM>(id), 0);
+        }
     }
 }
 
-void PreviewCache::StoreBitmapForKey(const std::wstring& key, HBITMAP bitmap, const SIZE& size) {
-    if (key.empty() || !bitmap) {
+void PreviewCache::StoreBitmapForKey(const PreviewKey& key, PCIDLIST_ABSOLUTE pidl, HBITMAP bitmap,
+                                     const SIZE& size) {
+    if (key.Empty() || !pidl || !bitmap) {
         if (bitmap) {
             DeleteObject(bitmap);
         }
         return;
     }
-    std::scoped_lock lock(m_mutex);
-    auto [it, inserted] = m_entries.try_emplace(key);
-    Entry& entry = it->second;
-    if (!inserted && entry.bitmap) {
-        DeleteObject(entry.bitmap);
-    }
-    entry.bitmap = bitmap;
-    entry.size = size;
-    TouchEntryLocked(entry, it->first);
-    TrimCacheLocked();
+    {
+        std::scoped_lock lock(m_mutex);
+        HotPreview preview;
+        preview.bitmap = bitmap;
+        preview.size = size;
+        preview.cost = EstimateBitmapCost(size.cx, size.cy, false);
+        GdiResourceBudget::Instance().Charge(m_budgetClient, preview.cost);
+        TracePreviewAccess(CacheTraceEvent::kInsert, key, preview.cost.bytes);
+        m_tiers.Store(key, preview);
+        // The newest capture owns the key if two items collide.
+        m_keyPidls[key].assign(PidlBytes(pidl));
+    }
+    GdiResourceBudget::Instance().Relieve();
 }
 
-void PreviewCache::TouchEntryLocked(Entry& entry, const std::wstring& key) {
-    if (entry.inLruList) {
-        assert(entry.lruPosition != m_lruList.end());
-        if (entry.lruPosition != m_lruList.begin()) {
-            m_lruList.splice(m_lruList.begin(), m_lruList, entry.lruPosition);
+std::optional<PreviewImage> PreviewCache::RestoreFromDisk(PCIDLIST_ABSOLUTE pidl, const PreviewKey& key) {
+    std::optional<PreviewPixels> pixels = m_diskStore.Load(BuildDiskKey(pidl, key));
+    if (!pixels) {
+        return std::nullopt;
+    }
+    std::optional<HotPreview> restored = CreateHotPreview(*pixels);
+    if (!restored) {
+        return std::nullopt;
+    }
+
+    std::optional<PreviewImage> image;
+    {
+        std::scoped_lock lock(m_mutex);
+        // A capture may have landed while the store was read; it is newer.
+        if (!m_tiers.Contains(key)) {
+            TracePreviewAccess(CacheTraceEvent::kInsert, key, restored->cost.bytes);
+            m_tiers.Store(key, *restored);
+            m_keyPidls[key].assign(PidlBytes(pidl));
+            restored.reset();
         }
-        return;
+        const HotPreview* preview = IsKeyOwnerLocked(key, pidl) ? m_tiers.Find(key) : nullptr;
+        if (preview && preview->bitmap) {
+            image = PreviewImage{preview->bitmap, preview->size};
+        }
+    }
+    if (restored) {
+        DestroyHotPreview(*restored);
     }
+    return image;
+}
 
-    m_lruList.emplace_front(key);
-    entry.lruPosition = m_lruList.begin();
-    entry.inLruList = true;
+void PreviewCache::PersistToDisk(PCIDLIST_ABSOLUTE pidl, const PreviewKey& key, HBITMAP bitmap, const SIZE& size) {
+    if (!pidl || key.Empty() || !m_diskStore.IsOpen()) {
+        return;
+    }
+    if (std::optional<PreviewPixels> pixels = ReadBitmapPixels(bitmap, size)) {
+        m_diskStore.Store(BuildDiskKey(pidl, key), *pixels);
+    }
 }
 
 }  // namespace shelltabs
-
@@ -0,0 +1,166 @@
+#include "PreviewCodec.h"
+
+namespace shelltabs {
+namespace {
+
+constexpr uint8_t kOpIndex = 0x00;
+constexpr uint8_t kOpDiff = 0x40;
+constexpr uint8_t kOpLuma = 0x80;
+constexpr uint8_t kOpRun = 0xC0;
+constexpr uint8_t kOpRgb = 0xFE;
+constexpr uint8_t kOpRgba = 0xFF;
+constexpr uint8_t kTagMask = 0xC0;
+constexpr uint32_t kMaxRun = 62;
+constexpr uint32_t kInitialPixel = 0xFF000000u;
+
+constexpr uint8_t Blue(uint32_t pixel) noexcept { return static_cast<uint8_t>(pixel); }
+constexpr uint8_t Green(uint32_t pixel) noexcept { return static_cast<uint8_t>(pixel >> 8); }
+constexpr uint8_t Red(uint32_t pixel) noexcept { return static_cast<uint8_t>(pixel >> 16); }
+constexpr uint8_t Alpha(uint32_t pixel) noexcept { return static_cast<uint8_t>(pixel >> 24); }
+
+constexpr uint32_t MakePixel(uint8_t b, uint8_t g, uint8_t r, uint8_t a) noexcept {
+    return static_cast<uint32_t>(b) | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(r) << 16) |
+           (static_cast<uint32_t>(a) << 24);
+}
+
+constexpr size_t ColorHash(uint32_t pixel) noexcept {
+    return (Red(pixel) * 3u + Green(pixel) * 5u + Blue(pixel) * 7u + Alpha(pixel) * 11u) % 64u;
+}
+
+}  // namespace
+
+size_t MaxEncodedPreviewSize(size_t pixelCount) noexcept { return pixelCount * 5; }
+
+void EncodePreviewPixels(const PreviewPixels& pixels, std::vector<uint8_t>* encoded) {
+    if (!encoded) {
+        return;
+    }
+    encoded->clear();
+    const size_t count = static_cast<size_t>(pixels.width) * pixels.height;
+    if (count == 0 || pixels.bgra.size() < count) {
+        return;
+    }
+
+    // Reserve for typical UI content; vector growth covers the worst case.
+    encoded->reserve(count / 2);
+    uint32_t index[64] = {};
+    uint32_t previous = kInitialPixel;
+    uint32_t run = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t pixel = pixels.bgra[i];
+        if (pixel == previous) {
+            ++run;
+            if (run == kMaxRun) {
+                encoded->push_back(static_cast<uint8_t>(kOpRun | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            encoded->push_back(static_cast<uint8_t>(kOpRun | (run - 1)));
+            run = 0;
+        }
+
+        const size_t hash = ColorHash(pixel);
+        if (index[hash] == pixel) {
+            encoded->push_back(static_cast<uint8_t>(kOpIndex | hash));
+            previous = pixel;
+            continue;
+        }
+        index[hash] = pixel;
+
+        if (Alpha(pixel) != Alpha(previous)) {
+            encoded->insert(encoded->end(), {kOpRgba, Red(pixel), Green(pixel), Blue(pixel), Alpha(pixel)});
+            previous = pixel;
+            continue;
+        }
+
+        const int dr = static_cast<int8_t>(Red(pixel) - Red(previous));
+        const int dg = static_cast<int8_t>(Green(pixel) - Green(previous));
+        const int db = static_cast<int8_t>(Blue(pixel) - Blue(previous));
+        const int drDg = dr - dg;
+        const int dbDg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+            encoded->push_back(static_cast<uint8_t>(kOpDiff | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+        } else if (dg >= -32 && dg <= 31 && drDg >= -8 && drDg <= 7 && dbDg >= -8 && dbDg <= 7) {
+            encoded->push_back(static_cast<uint8_t>(kOpLuma | (dg + 32)));
+            encoded->push_back(static_cast<uint8_t>(((drDg + 8) << 4) | (dbDg + 8)));
+        } else {
+            encoded->insert(encoded->end(), {kOpRgb, Red(pixel), Green(pixel), Blue(pixel)});
+        }
+        previous = pixel;
+    }
+    if (run > 0) {
+        encoded->push_back(static_cast<uint8_t>(kOpRun | (run - 1)));
+    }
+}
+
+bool DecodePreviewPixels(const uint8_t* data, size_t size, uint32_t width, uint32_t height, PreviewPixels* pixels) {
+    if (!pixels || (!data && size != 0)) {
+        return false;
+    }
+    const size_t count = static_cast<size_t>(width) * height;
+    pixels->width = width;
+    pixels->height = height;
+    pixels->bgra.resize(count);
+
+    uint32_t index[64] = {};
+    uint32_t previous = kInitialPixel;
+    size_t out = 0;
+    size_t in = 0;
+    while (out < count) {
+        if (in >= size) {
+            return false;
+        }
+        const uint8_t op = data[in++];
+        uint32_t pixel = previous;
+        if (op == kOpRgb) {
+            if (size - in < 3) {
+                return false;
+            }
+            pixel = MakePixel(data[in + 2], data[in + 1], data[in], Alpha(previous));
+            in += 3;
+        } else if (op == kOpRgba) {
+            if (size - in < 4) {
+                return false;
+            }
+            pixel = MakePixel(data[in + 2], data[in + 1], data[in], data[in + 3]);
+            in += 4;
+        } else if ((op & kTagMask) == kOpIndex) {
+            pixel = index[op & 0x3F];
+        } else if ((op & kTagMask) == kOpDiff) {
+            const int dr = ((op >> 4) & 0x03) - 2;
+            const int dg = ((op >> 2) & 0x03) - 2;
+            const int db = (op & 0x03) - 2;
+            pixel = MakePixel(static_cast<uint8_t>(Blue(previous) + db), static_cast<uint8_t>(Green(previous) + dg),
+                              static_cast<uint8_t>(Red(previous) + dr), Alpha(previous));
+        } else if ((op & kTagMask) == kOpLuma) {
+            if (in >= size) {
+                return false;
+            }
+            const uint8_t second = data[in++];
+            const int dg = (op & 0x3F) - 32;
+            const int dr = dg + ((second >> 4) & 0x0F) - 8;
+            const int db = dg + (second & 0x0F) - 8;
+            pixel = MakePixel(static_cast<uint8_t>(Blue(previous) + db), static_cast<uint8_t>(Green(previous) + dg),
+                              static_cast<uint8_t>(Red(previous) + dr), Alpha(previous));
+        } else {
+            const size_t run = static_cast<size_t>(op & 0x3F) + 1;
+            if (run > count - out) {
+                return false;
+            }
+            for (size_t i = 0; i < run; ++i) {
+                pixels->bgra[out++] = previous;
+            }
+            continue;
+        }
+
+        index[ColorHash(pixel)] = pixel;
+        pixels->bgra[out++] = pixel;
+        previous = pixel;
+    }
+    return in == size;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,513 @@
+#include "PreviewDiskStore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace shelltabs {
+namespace {
+
+// Native file handle plus a read-only view of the file's first mappedBytes.
+struct MappedFile {
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    const uint8_t* view = nullptr;
+    uint64_t mappedBytes = 0;
+};
+
+constexpr uint32_t kRecordMagic = 0x43455250u;  // "PREC"
+constexpr uint32_t kMaxDimension = 4096;
+constexpr uint64_t kFirstRecordOffset = sizeof(PreviewDiskFileHeader);
+
+uint32_t Checksum(const void* data, size_t size, uint32_t hash = 2166136261u) noexcept {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t HeaderChecksum(PreviewDiskRecordHeader header) noexcept {
+    header.headerChecksum = 0;
+    return Checksum(&header, sizeof(header));
+}
+
+bool IsPlausibleHeader(const PreviewDiskRecordHeader& header, uint64_t available) noexcept {
+    if (header.magic != kRecordMagic || header.headerChecksum != HeaderChecksum(header)) {
+        return false;
+    }
+    if (header.width == 0 || header.height == 0 || header.width > kMaxDimension || header.height > kMaxDimension) {
+        return false;
+    }
+    const size_t pixels = static_cast<size_t>(header.width) * header.height;
+    return header.payloadSize != 0 && header.payloadSize <= MaxEncodedPreviewSize(pixels) &&
+           header.payloadSize <= available;
+}
+
+std::filesystem::path CompactionPath(const std::filesystem::path& path) {
+    std::filesystem::path temp = path;
+    temp += L".compact";
+    return temp;
+}
+
+void UnmapFile(MappedFile& state) noexcept {
+#if defined(_WIN32)
+    if (state.view) {
+        UnmapViewOfFile(state.view);
+    }
+    if (state.mapping) {
+        CloseHandle(state.mapping);
+        state.mapping = nullptr;
+    }
+#else
+    if (state.view) {
+        munmap(const_cast<uint8_t*>(state.view), static_cast<size_t>(state.mappedBytes));
+    }
+#endif
+    state.view = nullptr;
+    state.mappedBytes = 0;
+}
+
+bool MapFile(MappedFile& state, uint64_t size) {
+    UnmapFile(state);
+    if (size == 0) {
+        return true;
+    }
+#if defined(_WIN32)
+    state.mapping = CreateFileMappingW(state.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!state.mapping) {
+        return false;
+    }
+    state.view = static_cast<const uint8_t*>(MapViewOfFile(state.mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!state.view) {
+        CloseHandle(state.mapping);
+        state.mapping = nullptr;
+        return false;
+    }
+#else
+    void* view = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, state.fd, 0);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    state.view = static_cast<const uint8_t*>(view);
+#endif
+    state.mappedBytes = size;
+    return true;
+}
+
+bool OpenFile(MappedFile& state, const std::filesystem::path& path) {
+#if defined(_WIN32)
+    // Another Explorer process holding the store open makes this one run
+    // without it rather than share a log it cannot coordinate writes to.
+    state.file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                             nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    return state.file != INVALID_HANDLE_VALUE;
+#else
+    state.fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    return state.fd >= 0;
+#endif
+}
+
+void CloseFile(MappedFile& state) noexcept {
+    UnmapFile(state);
+#if defined(_WIN32)
+    if (state.file != INVALID_HANDLE_VALUE) {
+        CloseHandle(state.file);
+        state.file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (state.fd >= 0) {
+        close(state.fd);
+        state.fd = -1;
+    }
+#endif
+}
+
+bool QueryFileSize(const MappedFile& state, uint64_t* size) {
+#if defined(_WIN32)
+    LARGE_INTEGER value{};
+    if (!GetFileSizeEx(state.file, &value)) {
+        return false;
+    }
+    *size = static_cast<uint64_t>(value.QuadPart);
+#else
+    struct stat info {};
+    if (fstat(state.fd, &info) != 0) {
+        return false;
+    }
+    *size = static_cast<uint64_t>(info.st_size);
+#endif
+    return true;
+}
+
+bool WriteAt(MappedFile& state, uint64_t offset, const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+#if defined(_WIN32)
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD written = 0;
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+        if (!WriteFile(state.file, bytes, chunk, &written, &overlapped) || written == 0) {
+            return false;
+        }
+#else
+        const ssize_t written = pwrite(state.fd, bytes, size, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+#endif
+        bytes += written;
+        offset += static_cast<uint64_t>(written);
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// The view must be unmapped first; Windows refuses to cut a mapped file.
+bool TruncateFile(MappedFile& state, uint64_t size) {
+#if defined(_WIN32)
+    LARGE_INTEGER position{};
+    position.QuadPart = static_cast<LONGLONG>(size);
+    return SetFilePointerEx(state.file, position, nullptr, FILE_BEGIN) && SetEndOfFile(state.file);
+#else
+    return ftruncate(state.fd, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+bool SyncFile(MappedFile& state) {
+#if defined(_WIN32)
+    return FlushFileBuffers(state.file) != FALSE;
+#else
+    return fsync(state.fd) == 0;
+#endif
+}
+
+}  // namespace
+
+struct PreviewDiskStore::FileState : MappedFile {};
+
+PreviewDiskStore::PreviewDiskStore(size_t maxBytes)
+    : m_maxBytes(std::max<size_t>(maxBytes, kFirstRecordOffset + sizeof(PreviewDiskRecordHeader))) {}
+
+PreviewDiskStore::~PreviewDiskStore() { Close(); }
+
+bool PreviewDiskStore::Open(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CloseLocked();
+    m_path = path;
+    // A compaction that never reached its rename leaves a partial copy; the
+    // original log is still intact.
+    std::error_code error;
+    std::filesystem::remove(CompactionPath(m_path), error);
+    return OpenLocked();
+}
+
+void PreviewDiskStore::Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CloseLocked();
+}
+
+bool PreviewDiskStore::IsOpen() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_file != nullptr;
+}
+
+bool PreviewDiskStore::OpenLocked() {
+    ++m_fileEpoch;
+    m_file = std::make_unique<FileState>();
+    if (!OpenFile(*m_file, m_path) || !ScanLocked()) {
+        CloseLocked();
+        return false;
+    }
+    return true;
+}
+
+void PreviewDiskStore::CloseLocked() {
+    ++m_fileEpoch;
+    if (m_file) {
+        CloseFile(*m_file);
+        m_file.reset();
+    }
+    m_slots.clear();
+    m_fileBytes = 0;
+}
+
+bool PreviewDiskStore::ScanLocked() {
+    uint64_t size = 0;
+    if (!QueryFileSize(*m_file, &size) || !MapFile(*m_file, size)) {
+        return false;
+    }
+
+    const PreviewDiskFileHeader expected;
+    if (size < kFirstRecordOffset || std::memcmp(m_file->view, &expected, sizeof(expected)) != 0) {
+        // New, foreign or from another format version: start over.
+        UnmapFile(*m_file);
+        if (!TruncateFile(*m_file, 0) || !WriteAt(*m_file, 0, &expected, sizeof(expected))) {
+            return false;
+        }
+        m_fileBytes = kFirstRecordOffset;
+        return MapFile(*m_file, m_fileBytes);
+    }
+
+    uint64_t offset = kFirstRecordOffset;
+    while (size - offset >= sizeof(PreviewDiskRecordHeader)) {
+        PreviewDiskRecordHeader header;
+        std::memcpy(&header, m_file->view + offset, sizeof(header));
+        const uint64_t payloadOffset = offset + sizeof(header);
+        if (!IsPlausibleHeader(header, size - payloadOffset)) {
+            break;
+        }
+        Slot& slot = m_slots[PreviewKey{header.itemLow, header.itemHigh}];
+        slot.offset = offset;
+        slot.payloadSize = header.payloadSize;
+        slot.folderStamp = header.folderStamp;
+        slot.width = header.width;
+        slot.height = header.height;
+        // File order is recency order, since compaction writes oldest first.
+        slot.lastUse = ++m_useClock;
+        offset = payloadOffset + header.payloadSize;
+    }
+
+    m_fileBytes = offset;
+    if (offset != size) {
+        // Drop the torn tail so the next append starts on a record boundary.
+        UnmapFile(*m_file);
+        if (!TruncateFile(*m_file, offset) || !MapFile(*m_file, offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PreviewDiskStore::EnsureMappedLocked(uint64_t end) {
+    if (m_file->mappedBytes >= end) {
+        return true;
+    }
+    // Records appended since the last mapping are outside the view.
+    return MapFile(*m_file, m_fileBytes);
+}
+
+std::optional<PreviewPixels> PreviewDiskStore::Load(const PreviewDiskKey& key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_file ? m_slots.find(key.item) : m_slots.end();
+    if (it == m_slots.end()) {
+        ++m_stats.misses;
+        return std::nullopt;
+    }
+    Slot& slot = it->second;
+    if (slot.folderStamp != key.folderStamp) {
+        // Forget it so compaction does not carry it forward.
+        ++m_stats.misses;
+        ++m_stats.staleMisses;
+        m_slots.erase(it);
+        return std::nullopt;
+    }
+
+    const uint64_t payloadOffset = slot.offset + sizeof(PreviewDiskRecordHeader);
+    PreviewPixels pixels;
+    bool valid = EnsureMappedLocked(payloadOffset + slot.payloadSize);
+    if (valid) {
+        const uint8_t* payload = m_file->view + payloadOffset;
+        PreviewDiskRecordHeader header;
+        std::memcpy(&header, m_file->view + slot.offset, sizeof(header));
+        valid = header.itemLow == key.item.low && header.itemHigh == key.item.high &&
+                Checksum(payload, slot.payloadSize) == header.payloadChecksum &&
+                DecodePreviewPixels(payload, slot.payloadSize, slot.width, slot.height, &pixels);
+    }
+    if (!valid) {
+        ++m_stats.misses;
+        ++m_stats.corruptRecords;
+        m_slots.erase(it);
+        return std::nullopt;
+    }
+
+    ++m_stats.hits;
+    slot.lastUse = ++m_useClock;
+    return pixels;
+}
+
+bool PreviewDiskStore::Contains(const PreviewDiskKey& key) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_slots.find(key.item);
+    return it != m_slots.end() && it->second.folderStamp == key.folderStamp;
+}
+
+bool PreviewDiskStore::Store(const PreviewDiskKey& key, const PreviewPixels& pixels) {
+    if (pixels.width == 0 || pixels.height == 0 || pixels.width > kMaxDimension || pixels.height > kMaxDimension) {
+        return false;
+    }
+    std::vector<uint8_t> record(sizeof(PreviewDiskRecordHeader));
+    std::vector<uint8_t> encoded;
+    EncodePreviewPixels(pixels, &encoded);
+    if (encoded.empty()) {
+        return false;
+    }
+
+    PreviewDiskRecordHeader header;
+    header.magic = kRecordMagic;
+    header.payloadSize = static_cast<uint32_t>(encoded.size());
+    header.itemLow = key.item.low;
+    header.itemHigh = key.item.high;
+    header.folderStamp = key.folderStamp;
+    header.width = pixels.width;
+    header.height = pixels.height;
+    header.payloadChecksum = Checksum(encoded.data(), encoded.size());
+    header.headerChecksum = HeaderChecksum(header);
+    std::memcpy(record.data(), &header, sizeof(header));
+    record.insert(record.end(), encoded.begin(), encoded.end());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file || kFirstRecordOffset + record.size() > m_maxBytes) {
+            return false;
+        }
+        // One write per record keeps the window for a torn record small.
+        if (!WriteAt(*m_file, m_fileBytes, record.data(), record.size())) {
+            return false;
+        }
+
+        Slot& slot = m_slots[key.item];
+        slot.offset = m_fileBytes;
+        slot.payloadSize = header.payloadSize;
+        slot.folderStamp = key.folderStamp;
+        slot.width = pixels.width;
+        slot.height = pixels.height;
+        slot.lastUse = ++m_useClock;
+        m_fileBytes += record.size();
+        if (m_fileBytes <= m_maxBytes) {
+            return true;
+        }
+    }
+
+    // A store that finds a compaction already running leaves the log to it;
+    // the records it appends meanwhile are carried over.
+    std::unique_lock<std::mutex> compactLock(m_compactMutex, std::try_to_lock);
+    if (compactLock.owns_lock()) {
+        CompactExclusive(m_maxBytes / 100 * kCompactTargetPercent);
+    }
+    return true;
+}
+
+bool PreviewDiskStore::Compact(size_t targetBytes) {
+    std::lock_guard<std::mutex> compactLock(m_compactMutex);
+    return CompactExclusive(targetBytes);
+}
+
+bool PreviewDiskStore::CompactExclusive(size_t targetBytes) {
+    // Snapshot the records to keep, oldest first so a reopened store rebuilds
+    // the same recency order. The copy is taken under the lock because a
+    // lookup may remap the view once the lock is released.
+    std::vector<uint8_t> keptRecords;
+    std::filesystem::path path;
+    uint64_t epoch = 0;
+    uint64_t snapshotEnd = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file) {
+            return false;
+        }
+        std::vector<const Slot*> byRecency;
+        byRecency.reserve(m_slots.size());
+        for (const auto& entry : m_slots) {
+            byRecency.push_back(&entry.second);
+        }
+        std::sort(byRecency.begin(), byRecency.end(),
+                  [](const Slot* left, const Slot* right) { return left->lastUse > right->lastUse; });
+
+        uint64_t keptBytes = kFirstRecordOffset;
+        size_t kept = 0;
+        for (const Slot* slot : byRecency) {
+            const uint64_t recordBytes = sizeof(PreviewDiskRecordHeader) + slot->payloadSize;
+            if (keptBytes + recordBytes > targetBytes) {
+                break;
+            }
+            keptBytes += recordBytes;
+            ++kept;
+        }
+        if (!EnsureMappedLocked(m_fileBytes)) {
+            return false;
+        }
+
+        keptRecords.reserve(static_cast<size_t>(keptBytes - kFirstRecordOffset));
+        for (size_t i = kept; i-- > 0;) {
+            const uint8_t* record = m_file->view + byRecency[i]->offset;
+            keptRecords.insert(keptRecords.end(), record,
+                               record + sizeof(PreviewDiskRecordHeader) + byRecency[i]->payloadSize);
+        }
+        path = m_path;
+        epoch = m_fileEpoch;
+        snapshotEnd = m_fileBytes;
+    }
+
+    // Write the copy and make it durable without blocking lookups and stores.
+    const std::filesystem::path tempPath = CompactionPath(path);
+    MappedFile temp;
+    const PreviewDiskFileHeader fileHeader;
+    bool written = OpenFile(temp, tempPath) && TruncateFile(temp, 0) &&
+                   WriteAt(temp, 0, &fileHeader, sizeof(fileHeader)) &&
+                   WriteAt(temp, kFirstRecordOffset, keptRecords.data(), keptRecords.size()) && SyncFile(temp);
+    uint64_t offset = kFirstRecordOffset + keptRecords.size();
+    keptRecords = {};
+    if (written && m_compactionWrittenHookForTest) {
+        m_compactionWrittenHookForTest();
+    }
+
+    std::error_code error;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // The log was closed or reopened meanwhile, so the copy describes a file
+    // that is no longer ours to replace.
+    written = written && m_file && m_fileEpoch == epoch;
+    if (written && m_fileBytes > snapshotEnd) {
+        // Records stored while the copy was written supersede what it holds;
+        // append them in log order.
+        written = EnsureMappedLocked(m_fileBytes) &&
+                  WriteAt(temp, offset, m_file->view + snapshotEnd, static_cast<size_t>(m_fileBytes - snapshotEnd));
+        offset += m_fileBytes - snapshotEnd;
+    }
+    CloseFile(temp);
+    if (!written) {
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    CloseFile(*m_file);
+    std::filesystem::rename(tempPath, m_path, error);
+    if (error) {
+        std::filesystem::remove(tempPath, error);
+    }
+    m_slots.clear();
+    ++m_stats.compactions;
+    // Reopening rescans the log, whichever file won.
+    if (!OpenLocked()) {
+        return false;
+    }
+    return m_fileBytes == offset;
+}
+
+PreviewDiskStoreStats PreviewDiskStore::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    PreviewDiskStoreStats stats = m_stats;
+    stats.entries = m_slots.size();
+    stats.fileBytes = static_cast<size_t>(m_fileBytes);
+    return stats;
+}
+
+}  // namespace shelltabs
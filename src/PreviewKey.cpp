@@ -0,0 +1,68 @@
+#include "PreviewKey.h"
+
+#include <cstring>
+
+namespace shelltabs {
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+
+constexpr uint64_t RotateLeft(uint64_t value, int bits) noexcept { return (value << bits) | (value >> (64 - bits)); }
+
+constexpr uint64_t Round(uint64_t accumulator, uint64_t input) noexcept {
+    return RotateLeft(accumulator + input * kPrime2, 31) * kPrime1;
+}
+
+constexpr uint64_t Avalanche(uint64_t value) noexcept {
+    value ^= value >> 33;
+    value *= kPrime2;
+    value ^= value >> 29;
+    value *= kPrime3;
+    value ^= value >> 32;
+    return value;
+}
+
+uint64_t ReadWord(const uint8_t* bytes) noexcept {
+    uint64_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+}  // namespace
+
+PreviewKey HashPreviewKey(const void* data, size_t size) noexcept {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t low = kPrime3 ^ static_cast<uint64_t>(size);
+    uint64_t high = kPrime1 + static_cast<uint64_t>(size) * kPrime2;
+
+    size_t remaining = size;
+    while (remaining >= 16) {
+        low = Round(low, ReadWord(bytes));
+        high = Round(high, ReadWord(bytes + 8));
+        // Cross the lanes so a change in either word reaches both halves.
+        low += high;
+        high += low;
+        bytes += 16;
+        remaining -= 16;
+    }
+    if (remaining > 0) {
+        uint8_t tail[16] = {};
+        std::memcpy(tail, bytes, remaining);
+        low = Round(low, ReadWord(tail));
+        high = Round(high, ReadWord(tail + 8));
+        low += high;
+        high += low;
+    }
+
+    PreviewKey key;
+    key.low = Avalanche(low);
+    key.high = Avalanche(high ^ key.low);
+    if (key.Empty()) {
+        key.low = 1;
+    }
+    return key;
+}
+
+}  // namespace shelltabs
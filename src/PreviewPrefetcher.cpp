@@ -0,0 +1,162 @@
+#include "PreviewPrefetcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace shelltabs {
+namespace {
+
+constexpr size_t kNoTab = std::numeric_limits<size_t>::max();
+
+// A gap longer than this between moves starts a new trajectory.
+constexpr std::chrono::milliseconds kVelocityReset{100};
+constexpr double kVelocitySmoothing = 0.5;
+
+constexpr double kHoveredRestingScore = 100.0;
+constexpr double kHoveredMovingScore = 40.0;
+constexpr double kTrajectoryScore = 50.0;
+// Distance from the predicted point at which the trajectory score halves.
+constexpr double kTrajectoryFalloff = 32.0;
+constexpr double kAdjacentScore = 30.0;
+constexpr double kMruScore = 20.0;
+constexpr double kMruRankStep = 5.0;
+
+double DistanceToRect(double x, double y, const PrefetchRect& rect) {
+    const double dx = std::max({static_cast<double>(rect.left) - x, 0.0, x - static_cast<double>(rect.right)});
+    const double dy = std::max({static_cast<double>(rect.top) - y, 0.0, y - static_cast<double>(rect.bottom)});
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+}  // namespace
+
+PreviewPrefetchPlanner::PreviewPrefetchPlanner(PreviewPrefetchOptions options) : m_options(options) {}
+
+void PreviewPrefetchPlanner::SetTabs(std::vector<PrefetchTab> tabs) {
+    m_tabs = std::move(tabs);
+    m_mruOrder.clear();
+    for (size_t i = 0; i < m_tabs.size(); ++i) {
+        if (m_tabs[i].eligible && m_tabs[i].lastActivated != 0) {
+            m_mruOrder.push_back(i);
+        }
+    }
+    std::stable_sort(m_mruOrder.begin(), m_mruOrder.end(), [&](size_t left, size_t right) {
+        return m_tabs[left].lastActivated > m_tabs[right].lastActivated;
+    });
+}
+
+std::vector<uint64_t> PreviewPrefetchPlanner::OnPointerMove(int x, int y, Clock::time_point time,
+                                                            const CachedPredicate& isCached) {
+    UpdateVelocity(x, y, time);
+
+    std::vector<uint64_t> issued;
+    if (m_tabs.empty() || m_outstanding.size() >= m_options.maxOutstanding ||
+        m_stats.issued - m_sessionStartIssued >= m_options.sessionBudget) {
+        return issued;
+    }
+
+    const size_t hovered = FindTabAt(x, y);
+    const double speed = std::hypot(m_velocityX, m_velocityY);
+    const bool moving = speed >= m_options.restingSpeed;
+    const double lookahead = std::chrono::duration<double>(m_options.lookahead).count();
+    const double predictedX = x + m_velocityX * lookahead;
+    const double predictedY = y + m_velocityY * lookahead;
+
+    std::vector<double> scores(m_tabs.size(), 0.0);
+    if (hovered != kNoTab) {
+        scores[hovered] += moving ? kHoveredMovingScore : kHoveredRestingScore;
+        if (hovered > 0) {
+            scores[hovered - 1] += kAdjacentScore;
+        }
+        if (hovered + 1 < m_tabs.size()) {
+            scores[hovered + 1] += kAdjacentScore;
+        }
+    }
+    if (moving) {
+        for (size_t i = 0; i < m_tabs.size(); ++i) {
+            const double ahead = DistanceToRect(predictedX, predictedY, m_tabs[i].bounds);
+            // Skip tabs the pointer is moving away from.
+            if (i != hovered && ahead >= DistanceToRect(x, y, m_tabs[i].bounds)) {
+                continue;
+            }
+            scores[i] += kTrajectoryScore / (1.0 + ahead / kTrajectoryFalloff);
+        }
+    }
+    for (size_t rank = 0; rank < m_mruOrder.size() && rank < m_options.mruCandidates; ++rank) {
+        scores[m_mruOrder[rank]] += kMruScore - kMruRankStep * static_cast<double>(rank);
+    }
+
+    std::vector<Candidate> candidates;
+    for (size_t i = 0; i < m_tabs.size(); ++i) {
+        const PrefetchTab& tab = m_tabs[i];
+        if (tab.eligible && scores[i] >= m_options.minScore && m_requested.count(tab.id) == 0) {
+            candidates.push_back({i, scores[i]});
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate& left, const Candidate& right) { return left.score > right.score; });
+
+    for (const Candidate& candidate : candidates) {
+        if (m_outstanding.size() >= m_options.maxOutstanding ||
+            m_stats.issued - m_sessionStartIssued >= m_options.sessionBudget) {
+            break;
+        }
+        const uint64_t id = m_tabs[candidate.index].id;
+        m_requested.insert(id);
+        if (isCached && isCached(id)) {
+            ++m_stats.alreadyCached;
+            continue;
+        }
+        m_outstanding.insert(id);
+        ++m_stats.issued;
+        issued.push_back(id);
+    }
+    return issued;
+}
+
+void PreviewPrefetchPlanner::OnPrefetchFinished(uint64_t id) {
+    if (m_outstanding.erase(id) != 0) {
+        ++m_stats.finished;
+    }
+}
+
+std::vector<uint64_t> PreviewPrefetchPlanner::OnPointerLeave() {
+    std::vector<uint64_t> cancelled(m_outstanding.begin(), m_outstanding.end());
+    m_stats.cancelled += cancelled.size();
+    m_outstanding.clear();
+    m_requested.clear();
+    m_sessionStartIssued = m_stats.issued;
+    m_hasPointer = false;
+    m_velocityX = 0.0;
+    m_velocityY = 0.0;
+    return cancelled;
+}
+
+size_t PreviewPrefetchPlanner::FindTabAt(double x, double y) const {
+    for (size_t i = 0; i < m_tabs.size(); ++i) {
+        const PrefetchRect& rect = m_tabs[i].bounds;
+        if (x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom) {
+            return i;
+        }
+    }
+    return kNoTab;
+}
+
+void PreviewPrefetchPlanner::UpdateVelocity(int x, int y, Clock::time_point time) {
+    const auto elapsed = time - m_lastTime;
+    if (!m_hasPointer || elapsed > kVelocityReset) {
+        m_velocityX = 0.0;
+        m_velocityY = 0.0;
+    } else if (elapsed > Clock::duration::zero()) {
+        const double seconds = std::chrono::duration<double>(elapsed).count();
+        m_velocityX += kVelocitySmoothing * ((x - m_lastX) / seconds - m_velocityX);
+        m_velocityY += kVelocitySmoothing * ((y - m_lastY) / seconds - m_velocityY);
+    }
+    m_hasPointer = true;
+    m_lastX = x;
+    m_lastY = y;
+    m_lastTime = time;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,400 @@
+#include "PreviewScaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SHELLTABS_SCALER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC accepts AVX2 intrinsics anywhere; GCC and Clang need the functions
+// that use them marked.
+#if defined(SHELLTABS_SCALER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SHELLTABS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SHELLTABS_TARGET_AVX2
+#endif
+
+namespace shelltabs {
+namespace {
+
+constexpr int kWeightBits = 14;
+constexpr int kWeightOne = 1 << kWeightBits;
+// Fraction bits kept between the passes. Channels then stay below 2^15, so
+// the intermediate fits the signed 16-bit multiplies.
+constexpr int kIntermediateBits = 7;
+constexpr int kHorizontalShift = kWeightBits - kIntermediateBits;
+constexpr int kVerticalShift = kWeightBits + kIntermediateBits;
+
+struct Tap {
+    uint32_t start = 0;
+    uint32_t count = 0;
+    // Index of the first weight in FilterTaps::weights.
+    uint32_t offset = 0;
+};
+
+struct FilterTaps {
+    std::vector<Tap> taps;
+    std::vector<int16_t> weights;
+};
+
+FilterTaps BuildTaps(uint32_t sourceSize, uint32_t destSize, PreviewScaleFilter filter) {
+    FilterTaps result;
+    result.taps.resize(destSize);
+
+    const double scale = static_cast<double>(sourceSize) / static_cast<double>(destSize);
+    const double support = std::max(scale, 1.0);
+    const double radius = filter == PreviewScaleFilter::kBox ? support / 2.0 : support;
+    std::vector<double> raw;
+    for (uint32_t d = 0; d < destSize; ++d) {
+        const double center = (static_cast<double>(d) + 0.5) * scale;
+        const int64_t first = std::max<int64_t>(0, static_cast<int64_t>(std::floor(center - radius)));
+        const int64_t last =
+            std::min<int64_t>(static_cast<int64_t>(sourceSize) - 1, static_cast<int64_t>(std::ceil(center + radius)));
+
+        raw.clear();
+        for (int64_t i = first; i <= last; ++i) {
+            const double position = static_cast<double>(i);
+            double weight = 0.0;
+            if (filter == PreviewScaleFilter::kBox) {
+                weight = std::min(position + 1.0, center + radius) - std::max(position, center - radius);
+            } else {
+                weight = 1.0 - std::abs(position + 0.5 - center) / radius;
+            }
+            raw.push_back(std::max(weight, 0.0));
+        }
+        size_t low = 0;
+        size_t high = raw.size();
+        while (low < high && raw[low] <= 0.0) {
+            ++low;
+        }
+        while (high > low && raw[high - 1] <= 0.0) {
+            --high;
+        }
+
+        Tap& tap = result.taps[d];
+        tap.offset = static_cast<uint32_t>(result.weights.size());
+        if (low == high) {
+            tap.start = static_cast<uint32_t>(std::clamp<int64_t>(static_cast<int64_t>(center), 0, sourceSize - 1));
+            tap.count = 1;
+            result.weights.push_back(static_cast<int16_t>(kWeightOne));
+            continue;
+        }
+        tap.start = static_cast<uint32_t>(first) + static_cast<uint32_t>(low);
+        tap.count = static_cast<uint32_t>(high - low);
+
+        double total = 0.0;
+        for (size_t k = low; k < high; ++k) {
+            total += raw[k];
+        }
+        // Rounding error goes to the largest weight so every set sums to one.
+        int sum = 0;
+        size_t largest = result.weights.size();
+        for (size_t k = low; k < high; ++k) {
+            const int weight = static_cast<int>(std::lround(raw[k] / total * kWeightOne));
+            if (largest == result.weights.size() || weight > result.weights[largest]) {
+                largest = result.weights.size();
+            }
+            result.weights.push_back(static_cast<int16_t>(weight));
+            sum += weight;
+        }
+        result.weights[largest] = static_cast<int16_t>(result.weights[largest] + (kWeightOne - sum));
+    }
+    return result;
+}
+
+// Each pass turns one row: the horizontal pass reads source pixels and writes
+// destWidth * 4 intermediate channels, the vertical pass combines tap.count
+// intermediate rows into output bytes.
+using HorizontalPass = void (*)(const uint32_t* row, const FilterTaps& columns, int16_t* out);
+using VerticalPass = void (*)(const int16_t* rows, size_t rowStride, const Tap& tap, const int16_t* weights,
+                              size_t elements, uint8_t* out);
+
+void HorizontalScalar(const uint32_t* row, const FilterTaps& columns, int16_t* out) {
+    for (const Tap& tap : columns.taps) {
+        const int16_t* weights = columns.weights.data() + tap.offset;
+        int32_t sums[4] = {};
+        for (uint32_t k = 0; k < tap.count; ++k) {
+            const uint32_t pixel = row[tap.start + k];
+            for (int channel = 0; channel < 4; ++channel) {
+                sums[channel] += static_cast<int32_t>((pixel >> (channel * 8)) & 0xFF) * weights[k];
+            }
+        }
+        for (int channel = 0; channel < 4; ++channel) {
+            *out++ = static_cast<int16_t>((sums[channel] + (1 << (kHorizontalShift - 1))) >> kHorizontalShift);
+        }
+    }
+}
+
+void VerticalScalarRange(const int16_t* rows, size_t rowStride, const Tap& tap, const int16_t* weights,
+                         size_t begin, size_t end, uint8_t* out) {
+    for (size_t i = begin; i < end; ++i) {
+        int32_t sum = 0;
+        for (uint32_t k = 0; k < tap.count; ++k) {
+            sum += static_cast<int32_t>(rows[k * rowStride + i]) * weights[k];
+        }
+        const int32_t value = (sum + (1 << (kVerticalShift - 1))) >> kVerticalShift;
+        out[i] = static_cast<uint8_t>(std::clamp(value, 0, 255));
+    }
+}
+
+void VerticalScalar(const int16_t* rows, size_t rowStride, const Tap& tap, const int16_t* weights, size_t elements,
+                    uint8_t* out) {
+    VerticalScalarRange(rows, rowStride, tap, weights, 0, elements, out);
+}
+
+#if defined(SHELLTABS_SCALER_X86)
+
+inline __m128i WeightPair(int16_t first, int16_t second) {
+    return _mm_set1_epi32(static_cast<int>(static_cast<uint16_t>(first) |
+                                           (static_cast<uint32_t>(static_cast<uint16_t>(second)) << 16)));
+}
+
+// Weighted sum of two adjacent pixels as four 32-bit channel sums.
+inline __m128i MultiplyPixelPair(const uint32_t* pixels, const int16_t* weights) {
+    __m128i wide = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels)), _mm_setzero_si128());
+    // b0 g0 r0 a0 b1 g1 r1 a1 -> b0 b1 g0 g1 r0 r1 a0 a1
+    wide = _mm_unpacklo_epi16(wide, _mm_srli_si128(wide, 8));
+    return _mm_madd_epi16(wide, WeightPair(weights[0], weights[1]));
+}
+
+inline __m128i MultiplyPixel(uint32_t pixel, int16_t weight) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(pixel)), zero), zero);
+    return _mm_madd_epi16(wide, WeightPair(weight, 0));
+}
+
+inline void StoreHorizontal(__m128i sums, int16_t* out) {
+    sums = _mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(1 << (kHorizontalShift - 1))), kHorizontalShift);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(sums, sums));
+}
+
+void HorizontalSse2(const uint32_t* row, const FilterTaps& columns, int16_t* out) {
+    for (const Tap& tap : columns.taps) {
+        const uint32_t* pixels = row + tap.start;
+        const int16_t* weights = columns.weights.data() + tap.offset;
+        __m128i sums = _mm_setzero_si128();
+        uint32_t k = 0;
+        for (; k + 1 < tap.count; k += 2) {
+            sums = _mm_add_epi32(sums, MultiplyPixelPair(pixels + k, weights + k));
+        }
+        if (k < tap.count) {
+            sums = _mm_add_epi32(sums, MultiplyPixel(pixels[k], weights[k]));
+        }
+        StoreHorizontal(sums, out);
+        out += 4;
+    }
+}
+
+// Eight channels of output from rows interleaved pairwise with their weights.
+inline void VerticalChunkSse2(const int16_t* rows, size_t rowStride, const Tap& tap, const int16_t* weights,
+                              size_t index, uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = zero;
+    __m128i high = zero;
+    uint32_t k = 0;
+    for (; k + 1 < tap.count; k += 2) {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + k * rowStride + index));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + (k + 1) * rowStride + index));
+        const __m128i pair = WeightPair(weights[k], weights[k + 1]);
+        low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(first, second), pair));
+        high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(first, second), pair));
+    }
+    if (k < tap.count) {
+        const __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows + k * rowStride + index));
+        const __m128i single = WeightPair(weights[k], 0);
+        low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(last, zero), single));
+        high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(last, zero), single));
+    }
+    const __m128i round = _mm_set1_epi32(1 << (kVerticalShift - 1));
+    low = _mm_srai_epi32(_mm_add_epi32(low, round), kVerticalShift);
+    high = _mm_srai_epi32(_mm_add_epi32(high, round), kVerticalShift);
+    const __m128i words = _mm_packs_epi32(low, high);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + index), _mm_packus_epi16(words, words));
+}
+
+void VerticalSse2(const int16_t* rows, size_t rowStride, const Tap& tap, const int16_t* weights, size_t elements,
+                  uint8_t* out) {
+    size_t i = 0;
+    for (; i + 8 <= elements; i += 8) {
+        VerticalChunkSse2(rows, rowStride, tap, weights, i, out);
+    }
+    VerticalScalarRange(rows, rowStride, tap, weights, i, elements, out);
+}
+
+SHELLTABS_TARGET_AVX2 void HorizontalAvx2(const uint32_t* row, const FilterTaps& columns, int16_t* out) {
+    // Weights w0 w1 w2 w3 as (w0, w1) across the low lane and (w2, w3) across
+    // the high lane.
+    const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    for (const Tap& tap : columns.taps) {
+        const uint32_t* pixels = row + tap.start;
+        const int16_t* weights = columns.weights.data() + tap.offset;
+        __m256i wideSums = _mm256_setzero_si256();
+        uint32_t k = 0;
+        for (; k + 3 < tap.count; k += 4) {
+            // Pixels 0-1 in the low lane and 2-3 in the high lane.
+            __m256i wide = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + k)));
+            wide = _mm256_unpacklo_epi16(wide, _mm256_srli_si256(wide, 8));
+            const __m256i pairs = _mm256_permutevar8x32_epi32(
+                _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + k))), spread);
+            wideSums = _mm256_add_epi32(wideSums, _mm256_madd_epi16(wide, pairs));
+        }
+        __m128i sums = _mm_add_epi32(_mm256_castsi256_si128(wideSums), _mm256_extracti128_si256(wideSums, 1));
+        for (; k + 1 < tap.count; k += 2) {
+            sums = _mm_add_epi32(sums, MultiplyPixelPair(pixels + k, weights + k));
+        }
+        if (k < tap.count) {
+            sums = _mm_add_epi32(sums, MultiplyPixel(pixels[k], weights[k]));
+        }
+        StoreHorizontal(sums, out);
+        out += 4;
+    }
+}
+
+SHELLTABS_TARGET_AVX2 void VerticalAvx2(const int16_t* rows, size_t rowStride, const Tap& tap, const int16_t* weights,
+                                        size_t elements, uint8_t* out) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(1 << (kVerticalShift - 1));
+    size_t i = 0;
+    for (; i + 16 <= elements; i += 16) {
+        __m256i low = zero;
+        __m256i high = zero;
+        uint32_t k = 0;
+        for (; k + 1 < tap.count; k += 2) {
+            const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + k * rowStride + i));
+            const __m256i second =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + (k + 1) * rowStride + i));
+            const __m256i pair = _mm256_broadcastsi128_si256(WeightPair(weights[k], weights[k + 1]));
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(first, second), pair));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(first, second), pair));
+        }
+        if (k < tap.count) {
+            const __m256i last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows + k * rowStride + i));
+            const __m256i single = _mm256_broadcastsi128_si256(WeightPair(weights[k], 0));
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(last, zero), single));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(last, zero), single));
+        }
+        low = _mm256_srai_epi32(_mm256_add_epi32(low, round), kVerticalShift);
+        high = _mm256_srai_epi32(_mm256_add_epi32(high, round), kVerticalShift);
+        // The unpacks work within 128-bit lanes, so packing restores the
+        // order per lane and the permute joins the two lanes' bytes.
+        const __m256i words = _mm256_packs_epi32(low, high);
+        const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(bytes));
+    }
+    for (; i + 8 <= elements; i += 8) {
+        VerticalChunkSse2(rows, rowStride, tap, weights, i, out);
+    }
+    VerticalScalarRange(rows, rowStride, tap, weights, i, elements, out);
+}
+
+bool DetectAvx2() noexcept {
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if (!osSavesYmm) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif  // SHELLTABS_SCALER_X86
+
+PreviewScalerPath ResolvePath(PreviewScalerPath path) noexcept {
+    if (path != PreviewScalerPath::kAuto) {
+        return path;
+    }
+    if (IsPreviewScalerPathSupported(PreviewScalerPath::kAvx2)) {
+        return PreviewScalerPath::kAvx2;
+    }
+    if (IsPreviewScalerPathSupported(PreviewScalerPath::kSse2)) {
+        return PreviewScalerPath::kSse2;
+    }
+    return PreviewScalerPath::kScalar;
+}
+
+}  // namespace
+
+bool IsPreviewScalerPathSupported(PreviewScalerPath path) noexcept {
+    switch (path) {
+        case PreviewScalerPath::kAuto:
+        case PreviewScalerPath::kScalar:
+            return true;
+#if defined(SHELLTABS_SCALER_X86)
+        case PreviewScalerPath::kSse2:
+            return true;
+        case PreviewScalerPath::kAvx2: {
+            static const bool supported = DetectAvx2();
+            return supported;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool ScalePreviewPixels(const PreviewPixelView& source, uint32_t* dest, uint32_t destWidth, uint32_t destHeight,
+                        PreviewScaleFilter filter, PreviewScalerPath path) {
+    if (!source.bgra || !dest || source.width == 0 || source.height == 0 || source.stride < source.width ||
+        destWidth == 0 || destHeight == 0 || !IsPreviewScalerPathSupported(path)) {
+        return false;
+    }
+
+    HorizontalPass horizontal = &HorizontalScalar;
+    VerticalPass vertical = &VerticalScalar;
+#if defined(SHELLTABS_SCALER_X86)
+    switch (ResolvePath(path)) {
+        case PreviewScalerPath::kAvx2:
+            horizontal = &HorizontalAvx2;
+            vertical = &VerticalAvx2;
+            break;
+        case PreviewScalerPath::kSse2:
+            horizontal = &HorizontalSse2;
+            vertical = &VerticalSse2;
+            break;
+        default:
+            break;
+    }
+#endif
+
+    const FilterTaps columns = BuildTaps(source.width, destWidth, filter);
+    const FilterTaps rows = BuildTaps(source.height, destHeight, filter);
+
+    // Only the source rows some output row reads go through the first pass.
+    uint32_t firstRow = source.height;
+    uint32_t endRow = 0;
+    for (const Tap& tap : rows.taps) {
+        firstRow = std::min(firstRow, tap.start);
+        endRow = std::max(endRow, tap.start + tap.count);
+    }
+
+    const size_t elements = static_cast<size_t>(destWidth) * 4;
+    std::vector<int16_t> intermediate(elements * (endRow - firstRow));
+    for (uint32_t y = firstRow; y < endRow; ++y) {
+        horizontal(source.bgra + static_cast<size_t>(y) * source.stride, columns,
+                   intermediate.data() + (y - firstRow) * elements);
+    }
+    for (uint32_t y = 0; y < destHeight; ++y) {
+        const Tap& tap = rows.taps[y];
+        vertical(intermediate.data() + (tap.start - firstRow) * elements, elements, tap,
+                 rows.weights.data() + tap.offset, elements,
+                 reinterpret_cast<uint8_t*>(dest + static_cast<size_t>(y) * destWidth));
+    }
+    return true;
+}
+
+}  // namespace shelltabs
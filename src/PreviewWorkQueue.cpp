@@ -0,0 +1,209 @@
+#include "PreviewWorkQueue.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace shelltabs {
+
+PreviewWorkQueue::PreviewWorkQueue(PreviewWorkQueueOptions options) : m_options(std::move(options)) {
+    m_options.workers = std::max<size_t>(1, m_options.workers);
+    if (m_options.agingStep <= std::chrono::milliseconds::zero()) {
+        m_options.agingStep = std::chrono::milliseconds(1);
+    }
+}
+
+PreviewWorkQueue::~PreviewWorkQueue() { Shutdown(); }
+
+uint64_t PreviewWorkQueue::Submit(PreviewPriority priority, Task task) {
+    if (!task) {
+        return 0;
+    }
+    const size_t index = std::min(static_cast<size_t>(priority), kPreviewPriorityCount - 1);
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_shutdown) {
+            return 0;
+        }
+        EnsureWorkersLocked();
+        id = m_nextId++;
+        if (m_nextId == 0) {
+            m_nextId = 1;
+        }
+        m_queues[index].push_back({id, Clock::now(), std::move(task)});
+        m_queuedIndex.emplace(id, index);
+        ++m_stats[index].submitted;
+    }
+    m_wake.notify_one();
+    return id;
+}
+
+bool PreviewWorkQueue::Cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto indexIt = m_queuedIndex.find(id);
+    if (indexIt == m_queuedIndex.end()) {
+        return false;
+    }
+    auto& queue = m_queues[indexIt->second];
+    auto it = std::find_if(queue.begin(), queue.end(), [id](const QueuedTask& task) { return task.id == id; });
+    if (it != queue.end()) {
+        queue.erase(it);
+    }
+    ++m_stats[indexIt->second].cancelled;
+    m_queuedIndex.erase(indexIt);
+    return true;
+}
+
+bool PreviewWorkQueue::Reprioritize(uint64_t id, PreviewPriority priority) {
+    const size_t target = std::min(static_cast<size_t>(priority), kPreviewPriorityCount - 1);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto indexIt = m_queuedIndex.find(id);
+        if (indexIt == m_queuedIndex.end()) {
+            return false;
+        }
+        if (indexIt->second == target) {
+            return true;
+        }
+        auto& source = m_queues[indexIt->second];
+        auto it = std::find_if(source.begin(), source.end(), [id](const QueuedTask& task) { return task.id == id; });
+        if (it == source.end()) {
+            return false;
+        }
+        QueuedTask moved = std::move(*it);
+        source.erase(it);
+        --m_stats[indexIt->second].submitted;
+        ++m_stats[target].submitted;
+
+        // Keep each class ordered by submission time so aging stays accurate.
+        auto& destination = m_queues[target];
+        auto position = std::find_if(destination.begin(), destination.end(), [&moved](const QueuedTask& task) {
+            return task.submitted > moved.submitted;
+        });
+        destination.insert(position, std::move(moved));
+        indexIt->second = target;
+    }
+    m_wake.notify_all();
+    return true;
+}
+
+void PreviewWorkQueue::Shutdown() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+        for (size_t i = 0; i < m_queues.size(); ++i) {
+            m_stats[i].cancelled += m_queues[i].size();
+            m_queues[i].clear();
+        }
+        m_queuedIndex.clear();
+        workers.swap(m_workers);
+    }
+    m_wake.notify_all();
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+size_t PreviewWorkQueue::Pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queuedIndex.size();
+}
+
+std::array<PreviewPriorityStats, kPreviewPriorityCount> PreviewWorkQueue::Stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void PreviewWorkQueue::EnsureWorkersLocked() {
+    if (!m_workers.empty()) {
+        return;
+    }
+    m_workers.reserve(m_options.workers);
+    for (size_t i = 0; i < m_options.workers; ++i) {
+        m_workers.emplace_back(&PreviewWorkQueue::WorkerMain, this);
+    }
+}
+
+size_t PreviewWorkQueue::SelectQueueLocked(Clock::time_point now) const {
+    const size_t workers = m_options.workers;
+    const size_t nonInteractiveLimit =
+        workers > m_options.reservedInteractiveWorkers ? workers - m_options.reservedInteractiveWorkers : workers;
+
+    size_t best = kPreviewPriorityCount;
+    int64_t bestRank = 0;
+    for (size_t i = 0; i < m_queues.size(); ++i) {
+        if (m_queues[i].empty()) {
+            continue;
+        }
+        if (i != static_cast<size_t>(PreviewPriority::kInteractive) && m_runningNonInteractive >= nonInteractiveLimit) {
+            continue;
+        }
+        const auto waited = now - m_queues[i].front().submitted;
+        const int64_t rank = static_cast<int64_t>(i) - static_cast<int64_t>(waited / m_options.agingStep);
+        if (best == kPreviewPriorityCount || rank < bestRank) {
+            best = i;
+            bestRank = rank;
+        }
+    }
+    return best;
+}
+
+void PreviewWorkQueue::WorkerMain() {
+    if (m_options.threadStart) {
+        m_options.threadStart();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        size_t index = kPreviewPriorityCount;
+        m_wake.wait(lock, [&]() {
+            if (m_shutdown) {
+                return true;
+            }
+            index = SelectQueueLocked(Clock::now());
+            return index != kPreviewPriorityCount;
+        });
+        if (m_shutdown) {
+            break;
+        }
+
+        QueuedTask next = std::move(m_queues[index].front());
+        m_queues[index].pop_front();
+        m_queuedIndex.erase(next.id);
+
+        PreviewPriorityStats& stats = m_stats[index];
+        const auto waited = Clock::now() - next.submitted;
+        ++stats.started;
+        stats.totalWait += waited;
+        stats.maxWait = std::max(stats.maxWait, waited);
+
+        const bool interactive = index == static_cast<size_t>(PreviewPriority::kInteractive);
+        if (!interactive) {
+            ++m_runningNonInteractive;
+        }
+
+        lock.unlock();
+        try {
+            next.task();
+        } catch (...) {
+        }
+        next.task = nullptr;
+        lock.lock();
+
+        if (!interactive) {
+            --m_runningNonInteractive;
+            // Work held back by the reservation may now run on an idle worker.
+            m_wake.notify_all();
+        }
+    }
+    lock.unlock();
+
+    if (m_options.threadStop) {
+        m_options.threadStop();
+    }
+}
+
+}  // namespace shelltabs
@@ -15,6 +15,8 @@
 #include <utility>
 
 #include "BreadcrumbGradient.h"
+#include "CachePolicy.h"
+#include "CacheTraceRecorder.h"
 #include "ExplorerThemeUtils.h"
 #include "Module.h"
 #include "OptionsStore.h"
@@ -126,7 +128,7 @@ bool ShellTabsListView::Initialize(HWND parent,
         return false;
     }
 
-    m_cache.clear();
+    ClearCache();
 
     int count = 0;
     if (SUCCEEDED(m_folderView->ItemCount(SVGIO_ALLVIEW, &count))) {
@@ -335,7 +337,7 @@ void ShellTabsListView::HandleCacheHint(const NMLVCACHEHINT* hint) {
     }
 
     if (m_itemCount <= 0) {
-        m_cache.clear();
+        ClearCache();
         return;
     }
 
@@ -431,9 +433,11 @@ ShellTabsListView::CachedItem* ShellTabsListView::EnsureCachedItem(int index) {
 
     auto it = m_cache.find(index);
     if (it != m_cache.end()) {
+        TraceCacheAccess(CacheTraceEvent::kHit, index, &it->second);
         return &it->second;
     }
 
+    TraceCacheAccess(CacheTraceEvent::kMiss, index, nullptr);
     if (!m_folderView) {
         return nullptr;
     }
@@ -459,17 +463,19 @@ ShellTabsListView::CachedItem* ShellTabsListView::EnsureCachedItem(int index) {
     if (!inserted) {
         return nullptr;
     }
+    TraceCacheAccess(CacheTraceEvent::kInsert, index, &insertedIt->second);
     return &insertedIt->second;
 }
 
 void ShellTabsListView::PruneCache(int keepFrom, int keepTo) {
     if (keepFrom > keepTo) {
-        m_cache.clear();
+        ClearCache();
         return;
     }
 
     for (auto it = m_cache.begin(); it != m_cache.end();) {
         if (it->first < keepFrom || it->first > keepTo) {
+            TraceCacheAccess(CacheTraceEvent::kEvict, it->first, &it->second);
             it = m_cache.erase(it);
         } else {
             ++it;
@@ -477,6 +483,34 @@ void ShellTabsListView::PruneCache(int keepFrom, int keepTo) {
     }
 }
 
+void ShellTabsListView::ClearCache() {
+    if (CacheTraceRecorder::Instance().IsEnabled()) {
+        for (const auto& [index, item] : m_cache) {
+            TraceCacheAccess(CacheTraceEvent::kInvalidate, index, &item);
+        }
+    }
+    m_cache.clear();
+}
+
+void ShellTabsListView::TraceCacheAccess(CacheTraceEvent event, int index, const CachedItem* item) const {
+    CacheTraceRecorder& recorder = CacheTraceRecorder::Instance();
+    if (!recorder.IsEnabled()) {
+        return;
+    }
+    // Indices are only meaningful within one view, so the view's address is
+    // part of the key.
+    const uint64_t keyParts[] = {static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)),
+                                 static_cast<uint64_t>(static_cast<uint32_t>(index))};
+    size_t bytes = 0;
+    if (item) {
+        bytes = sizeof(CachedItem) + item->displayName.size() * sizeof(wchar_t) +
+                (item->pidl ? ILGetSize(item->pidl.get()) : 0);
+    }
+    recorder.Record(CacheTraceSource::kListView, event,
+                    HashCacheKey(std::string_view(reinterpret_cast<const char*>(keyParts), sizeof(keyParts))),
+                    bytes);
+}
+
 int ShellTabsListView::ResolveIconIndex(PCIDLIST_ABSOLUTE pidl) const {
     if (!pidl) {
         return -1;
@@ -839,7 +873,8 @@ bool ShellTabsListView::HandleCustomDraw(NMLVCUSTOMDRAW* draw, LRESULT* result)
             }
 
             // Request postpaint notification if gradient font is enabled
-            const ShellTabsOptions& options = OptionsStore::Instance().Get();
+            const auto optionsSnapshot = OptionsStore::Instance().Get();
+            const ShellTabsOptions& options = *optionsSnapshot;
             if (options.enableFileGradientFont && (draw->nmcd.uItemState & CDIS_SELECTED) == 0) {
                 *result |= CDRF_NOTIFYPOSTPAINT;
             }
@@ -848,7 +883,8 @@ bool ShellTabsListView::HandleCustomDraw(NMLVCUSTOMDRAW* draw, LRESULT* result)
         }
         case CDDS_ITEMPOSTPAINT: {
             const int index = static_cast<int>(draw->nmcd.dwItemSpec);
-            const ShellTabsOptions& options = OptionsStore::Instance().Get();
+            const auto optionsSnapshot = OptionsStore::Instance().Get();
+            const ShellTabsOptions& options = *optionsSnapshot;
 
             // Render gradient text if enabled and item is not selected
             if (options.enableFileGradientFont && (draw->nmcd.uItemState & CDIS_SELECTED) == 0) {
@@ -33,6 +33,8 @@ class Bitmap;
 
 namespace shelltabs {
 
+enum class CacheTraceEvent : uint8_t;
+
 class ShellTabsListView {
 public:
     using HighlightResolver = std::function<bool(PCIDLIST_ABSOLUTE pidl, PaneHighlight* highlight)>;
@@ -133,6 +135,8 @@ private:
     void HandleViewRangeChanged();
     CachedItem* EnsureCachedItem(int index);
     void PruneCache(int keepFrom, int keepTo);
+    void ClearCache();
+    void TraceCacheAccess(CacheTraceEvent event, int index, const CachedItem* item) const;
     int ResolveIconIndex(PCIDLIST_ABSOLUTE pidl) const;
     bool HandleCustomDraw(NMLVCUSTOMDRAW* draw, LRESULT* result);
     bool PaintBackground(HDC dc);
@@ -0,0 +1,242 @@
+#include "SoftwareTabBandPainter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "GradientFill.h"
+#include "TabLabelCache.h"
+
+namespace shelltabs {
+namespace {
+
+uint32_t ToPixel(PaintColor color) noexcept {
+    return 0xFF000000u | (static_cast<uint32_t>(PaintColorRed(color)) << 16) |
+           (static_cast<uint32_t>(PaintColorGreen(color)) << 8) | PaintColorBlue(color);
+}
+
+GradientColor ToGradientColor(PaintColor color) noexcept {
+    return {PaintColorRed(color), PaintColorGreen(color), PaintColorBlue(color), 0xFF};
+}
+
+PaintRect Intersect(const PaintRect& first, const PaintRect& second) noexcept {
+    return {std::max(first.left, second.left), std::max(first.top, second.top), std::min(first.right, second.right),
+            std::min(first.bottom, second.bottom)};
+}
+
+bool IsLowercase(wchar_t ch) noexcept { return ch >= L'a' && ch <= L'z'; }
+
+// Periods are a one pixel dot, so "..." stays narrow.
+int32_t Advance(wchar_t ch) noexcept {
+    return ch == L'.' ? 2 : SoftwareTabBandPainter::kGlyphAdvance;
+}
+
+// Whether step along a line of the given pen width falls in a dash.
+bool PatternOn(PaintLineStyle style, int32_t step, int width) noexcept {
+    switch (style) {
+        case PaintLineStyle::kDashed:
+            return (step / width) % 6 < 4;
+        case PaintLineStyle::kDotted:
+            return (step / width) % 2 == 0;
+        default:
+            return true;
+    }
+}
+
+}  // namespace
+
+SoftwareTabBandPainter::SoftwareTabBandPainter(uint32_t width, uint32_t height)
+    : m_width(width),
+      m_height(height),
+      m_bounds{0, 0, static_cast<int32_t>(width), static_cast<int32_t>(height)},
+      m_pixels(static_cast<size_t>(width) * height, 0xFF000000u) {}
+
+void SoftwareTabBandPainter::Clear(PaintColor color) { std::fill(m_pixels.begin(), m_pixels.end(), ToPixel(color)); }
+
+void SoftwareTabBandPainter::Span(int32_t y, int32_t left, int32_t right, uint32_t pixel, const PaintRect& clip) {
+    if (y < clip.top || y >= clip.bottom || y < 0 || y >= static_cast<int32_t>(m_height)) {
+        return;
+    }
+    left = std::max({left, clip.left, int32_t{0}});
+    right = std::min({right, clip.right, static_cast<int32_t>(m_width)});
+    if (right <= left) {
+        return;
+    }
+    std::fill_n(m_pixels.begin() + static_cast<ptrdiff_t>(static_cast<size_t>(y) * m_width + left), right - left,
+                pixel);
+}
+
+void SoftwareTabBandPainter::FillRect(const PaintRect& rect, PaintColor color) {
+    const PaintRect clipped = Intersect(rect, m_bounds);
+    const uint32_t pixel = ToPixel(color);
+    for (int32_t y = clipped.top; y < clipped.bottom; ++y) {
+        Span(y, clipped.left, clipped.right, pixel, m_bounds);
+    }
+}
+
+void SoftwareTabBandPainter::FillGradient(const PaintRect& rect, PaintColor start, PaintColor end, bool horizontal) {
+    const PaintRect clipped = Intersect(rect, m_bounds);
+    if (rect.Empty() || clipped.Empty()) {
+        return;
+    }
+    const uint32_t length = static_cast<uint32_t>(horizontal ? rect.Width() : rect.Height());
+    std::vector<uint32_t> ramp(length);
+    BuildGradientRamp(ToGradientColor(start), ToGradientColor(end), length, ramp.data());
+    for (int32_t y = clipped.top; y < clipped.bottom; ++y) {
+        uint32_t* row = m_pixels.data() + static_cast<size_t>(y) * m_width;
+        if (horizontal) {
+            std::copy(ramp.begin() + (clipped.left - rect.left), ramp.begin() + (clipped.right - rect.left),
+                      row + clipped.left);
+        } else {
+            std::fill(row + clipped.left, row + clipped.right, ramp[static_cast<size_t>(y - rect.top)]);
+        }
+    }
+}
+
+void SoftwareTabBandPainter::FillPolygon(const PaintPoint* points, size_t count, PaintColor color) {
+    if (!points || count < 3) {
+        return;
+    }
+    int32_t top = points[0].y;
+    int32_t bottom = points[0].y;
+    for (size_t i = 1; i < count; ++i) {
+        top = std::min(top, points[i].y);
+        bottom = std::max(bottom, points[i].y);
+    }
+
+    // Even-odd scanlines through pixel centres; a pixel is inside when its
+    // centre is, with centres on an edge going to the left-hand side.
+    const uint32_t pixel = ToPixel(color);
+    std::vector<double> crossings;
+    for (int32_t y = std::max(top, int32_t{0}); y < std::min(bottom, static_cast<int32_t>(m_height)); ++y) {
+        const double center = y + 0.5;
+        crossings.clear();
+        for (size_t i = 0; i < count; ++i) {
+            const PaintPoint& a = points[i];
+            const PaintPoint& b = points[(i + 1) % count];
+            if ((a.y <= center) == (b.y <= center)) {
+                continue;
+            }
+            crossings.push_back(a.x + (center - a.y) * static_cast<double>(b.x - a.x) / static_cast<double>(b.y - a.y));
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            const int32_t left = static_cast<int32_t>(std::ceil(crossings[i] - 0.5));
+            const int32_t right = static_cast<int32_t>(std::ceil(crossings[i + 1] - 0.5));
+            Span(y, left, right, pixel, m_bounds);
+        }
+    }
+}
+
+void SoftwareTabBandPainter::StrokePolygon(const PaintPoint* points, size_t count, PaintColor color) {
+    if (!points || count < 2) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        DrawLine(points[i], points[(i + 1) % count], color);
+    }
+}
+
+void SoftwareTabBandPainter::FillEllipse(const PaintRect& bounds, PaintColor color) {
+    if (bounds.Empty()) {
+        return;
+    }
+    const double centerX = (bounds.left + bounds.right) / 2.0;
+    const double centerY = (bounds.top + bounds.bottom) / 2.0;
+    const double radiusX = bounds.Width() / 2.0;
+    const double radiusY = bounds.Height() / 2.0;
+    const uint32_t pixel = ToPixel(color);
+    for (int32_t y = bounds.top; y < bounds.bottom; ++y) {
+        const double dy = (y + 0.5 - centerY) / radiusY;
+        if (dy * dy > 1.0) {
+            continue;
+        }
+        const double halfWidth = radiusX * std::sqrt(1.0 - dy * dy);
+        const int32_t left = static_cast<int32_t>(std::ceil(centerX - halfWidth - 0.5));
+        const int32_t right = static_cast<int32_t>(std::ceil(centerX + halfWidth - 0.5));
+        Span(y, left, right, pixel, m_bounds);
+    }
+}
+
+void SoftwareTabBandPainter::DrawLine(PaintPoint from, PaintPoint to, PaintColor color, int width,
+                                      PaintLineStyle style) {
+    width = std::max(1, width);
+    const uint32_t pixel = ToPixel(color);
+    const int32_t offset = width / 2;
+    const int32_t dx = std::abs(to.x - from.x);
+    const int32_t dy = -std::abs(to.y - from.y);
+    const int32_t stepX = from.x < to.x ? 1 : -1;
+    const int32_t stepY = from.y < to.y ? 1 : -1;
+    int32_t error = dx + dy;
+    int32_t x = from.x;
+    int32_t y = from.y;
+    for (int32_t step = 0; x != to.x || y != to.y; ++step) {
+        if (PatternOn(style, step, width)) {
+            for (int32_t row = 0; row < width; ++row) {
+                Span(y - offset + row, x - offset, x - offset + width, pixel, m_bounds);
+            }
+        }
+        const int32_t twice = 2 * error;
+        if (twice >= dy) {
+            error += dy;
+            x += stepX;
+        }
+        if (twice <= dx) {
+            error += dx;
+            y += stepY;
+        }
+    }
+}
+
+void SoftwareTabBandPainter::DrawString(const PaintRect& bounds, std::wstring_view text, PaintColor color,
+                                        PaintTextAlign align) {
+    const PaintRect clip = Intersect(bounds, m_bounds);
+    if (clip.Empty() || text.empty()) {
+        return;
+    }
+
+    // Each advance includes the gap after the glyph, which may hang past the
+    // bounds, hence the extra pixel.
+    std::wstring fitted;
+    if (align != PaintTextAlign::kCenter) {
+        std::vector<int32_t> extents(text.size());
+        int32_t extent = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            extent += Advance(text[i]);
+            extents[i] = extent;
+        }
+        const TabLabelEllipsis mode =
+            align == PaintTextAlign::kLeftPathEllipsis ? TabLabelEllipsis::kPath : TabLabelEllipsis::kEnd;
+        fitted = FitTabLabel(text, extents.data(), 3 * Advance(L'.'), bounds.Width() + 1, mode);
+        text = fitted;
+    }
+
+    int32_t width = -1;
+    for (wchar_t ch : text) {
+        width += Advance(ch);
+    }
+    int32_t x = align == PaintTextAlign::kCenter ? bounds.left + (bounds.Width() - width) / 2 : bounds.left;
+    const int32_t top = bounds.top + (bounds.Height() - kGlyphHeight) / 2;
+    const uint32_t pixel = ToPixel(color);
+    for (wchar_t ch : text) {
+        if (ch == L'.') {
+            Span(top + kGlyphHeight - 1, x, x + 1, pixel, clip);
+        } else if (ch != L' ') {
+            const int32_t glyphTop = IsLowercase(ch) ? top + 2 : top;
+            for (int32_t y = glyphTop; y < top + kGlyphHeight; ++y) {
+                Span(y, x, x + kGlyphWidth, pixel, clip);
+            }
+        }
+        x += Advance(ch);
+    }
+}
+
+void SoftwareTabBandPainter::DrawIcon(const void* icon, const PaintRect& bounds) {
+    if (!icon || bounds.Empty()) {
+        return;
+    }
+    FillRect(bounds, MakePaintColor(0x60, 0x60, 0x60));
+    FillRect({bounds.left + 1, bounds.top + 1, bounds.right - 1, bounds.bottom - 1}, MakePaintColor(0xA0, 0xA0, 0xA0));
+}
+
+}  // namespace shelltabs
@@ -26,6 +26,8 @@
 #define SBSP_EXPLORE 0x00000004
 #endif
 
+#include "ConfigurationMonitor.h"
+#include "ConfigurationService.h"
 #include "Guids.h"
 #include "GroupStore.h"
 #include "OptionsDialog.h"
@@ -246,12 +248,28 @@ bool LoadGroupStoreForContext(const wchar_t* context, GroupStore& store) {
 
 bool LoadOptionsStoreForContext(const wchar_t* context, OptionsStore& store) {
     std::wstring errorContext;
-    if (!store.Load(&errorContext)) {
+    // While the configuration monitor runs it keeps the shared store current,
+    // so windows only read the file when nothing has loaded it yet.
+    const bool loaded = ConfigurationService::Instance().IsRunning() ? store.EnsureLoaded(&errorContext)
+                                                                     : store.Load(&errorContext);
+    if (!loaded) {
         LogLoadFailure(context, errorContext);
         return false;
     }
     return true;
 }
+
+void BroadcastOptionsChanged() {
+    auto& service = ConfigurationService::Instance();
+    if (service.IsRunning()) {
+        service.Publish(ConfigurationDocument::kOptions);
+        return;
+    }
+    const UINT message = GetOptionsChangedMessage();
+    if (message != 0) {
+        SendNotifyMessageW(HWND_BROADCAST, message, 0, 0);
+    }
+}
 }
 
 TabBand::TabBand() : m_refCount(1), m_processedGroupStoreGeneration(0) {
@@ -603,6 +621,7 @@ IFACEMETHODIMP TabBand::SetSite(IUnknown* pUnkSite) {
             }
 
             LogMessage(LogLevel::Info, L"TabBand::SetSite resolved browser interfaces");
+            EnsureConfigurationMonitorStarted();
             LogMessage(LogLevel::Info, L"TabBand::SetSite EnsureWindow");
             EnsureWindow();
             if (!m_window) {
@@ -840,7 +859,7 @@ void TabBand::OnNewTabRequested(int targetGroup) {
             if (!LoadGroupStoreForContext(L"TabBand::OnNewTabRequested failed to load saved groups", store)) {
                 return;
             }
-            const SavedGroup* saved = store.Find(target);
+            const std::optional<SavedGroup> saved = store.Find(target);
             if (!saved) {
                 return;
             }
@@ -1901,7 +1920,8 @@ void TabBand::EnsureTabPreview(TabLocation location) {
         return;
     }
 
-    CaptureActiveTabPreview();
+    // The user is hovering this tab and waiting for its preview.
+    CaptureActiveTabPreview(PreviewPriority::kInteractive);
 }
 
 HWND TabBand::GetFrameWindow() const {
@@ -2005,7 +2025,7 @@ void TabBand::ReleaseWindowToken() {
     m_windowToken.clear();
 }
 
-void TabBand::CaptureActiveTabPreview() {
+void TabBand::CaptureActiveTabPreview(PreviewPriority priority) {
     if (!m_shellBrowser) {
         return;
     }
@@ -2031,7 +2051,7 @@ void TabBand::CaptureActiveTabPreview() {
     }
 
     PreviewCache::Instance().StorePreviewFromWindow(tab->pidl.get(), viewWindow, kPreviewImageSize,
-                                                    ResolveWindowToken());
+                                                    ResolveWindowToken(), priority);
 }
 
 void TabBand::EnsureWindow() {
@@ -2083,7 +2103,7 @@ void TabBand::EnsureOptionsLoaded() const {
     }
     auto& store = OptionsStore::Instance();
     LoadOptionsStoreForContext(L"TabBand::EnsureOptionsLoaded failed to load options", store);
-    m_options = store.Get();
+    m_options = *store.Get();
     m_optionsLoaded = true;
 }
 
@@ -2661,10 +2681,7 @@ void TabBand::ApplyOptionsChanges(const ShellTabsOptions& previousOptions) {
         backgroundColorsChanged || fontColorsChanged || tabColorsChanged || glowEnabledChanged ||
         glowCustomChanged || glowGradientChanged || glowColorChanged || glowPaletteChanged ||
         accentColorsChanged) {
-        const UINT message = GetOptionsChangedMessage();
-        if (message != 0) {
-            SendNotifyMessageW(HWND_BROADCAST, message, 0, 0);
-        }
+        BroadcastOptionsChanged();
     }
 }
 
@@ -3096,7 +3113,7 @@ void TabBand::OnLoadSavedGroup(const std::wstring& name, int afterGroup) {
     if (!LoadGroupStoreForContext(L"TabBand::OnLoadSavedGroup failed to load saved groups", store)) {
         return;
     }
-    const SavedGroup* saved = store.Find(name);
+    const std::optional<SavedGroup> saved = store.Find(name);
     if (!saved) {
         return;
     }
@@ -3172,10 +3189,7 @@ void TabBand::OnShowOptionsDialog(OptionsDialogPage initialPage, const std::wstr
     if (dialog.optionsChanged) {
         ApplyOptionsChanges(previousOptions);
     } else {
-        const UINT message = GetOptionsChangedMessage();
-        if (message != 0) {
-            SendNotifyMessageW(HWND_BROADCAST, message, 0, 0);
-        }
+        BroadcastOptionsChanged();
     }
     if (m_window) {
         m_window->RefreshTheme();
@@ -3188,7 +3202,7 @@ void TabBand::OnShowOptionsDialog(OptionsDialogPage initialPage, const std::wstr
         LoadGroupStoreForContext(L"TabBand::OnShowOptionsDialog failed to load saved groups", store);
         std::vector<SavedGroup> updatedGroups = dialog.savedGroups;
         if (updatedGroups.empty()) {
-            updatedGroups = store.Groups();
+            updatedGroups = *store.Groups();
         }
 
         const bool metadataUpdated =
@@ -3323,6 +3337,27 @@ bool TabBand::ApplySavedGroupMetadata(const std::vector<SavedGroup>& savedGroups
     return changed;
 }
 
+void TabBand::OnOptionsChanged(uint64_t generation, DWORD sourceProcessId) {
+    if (sourceProcessId != GetCurrentProcessId()) {
+        // Another process's counter says nothing about ours; adopting it could
+        // make us skip our own next stamp, so treat it as unstamped.
+        generation = 0;
+    }
+    if (generation != 0 && generation == m_appliedOptionsGeneration) {
+        return;
+    }
+    if (generation == 0) {
+        // Unstamped broadcasts come from processes without the monitor or from
+        // another Explorer; read the file as before.
+        m_optionsLoaded = false;
+        EnsureOptionsLoaded();
+        return;
+    }
+    m_appliedOptionsGeneration = generation;
+    m_options = *OptionsStore::Instance().Get();
+    m_optionsLoaded = true;
+}
+
 void TabBand::OnSavedGroupsChanged() {
     auto& store = GroupStore::Instance();
     if (!LoadGroupStoreForContext(L"TabBand::OnSavedGroupsChanged failed to load saved groups", store)) {
@@ -3334,10 +3369,10 @@ void TabBand::OnSavedGroupsChanged() {
         return;
     }
 
-    const auto& savedGroups = store.Groups();
-    const auto& renamedGroups = store.LastRenamedGroups();
-    const auto& removedGroupIds = store.LastRemovedGroups();
-    const bool updated = ApplySavedGroupMetadata(savedGroups, renamedGroups, removedGroupIds);
+    const auto savedGroups = store.Groups();
+    const auto renamedGroups = store.LastRenamedGroups();
+    const auto removedGroupIds = store.LastRemovedGroups();
+    const bool updated = ApplySavedGroupMetadata(*savedGroups, renamedGroups, removedGroupIds);
     if (updated) {
         UpdateTabsUI();
         SaveSession();
@@ -3413,7 +3448,7 @@ void TabBand::RunBackgroundInitialization(std::stop_token stopToken, uint64_t se
     ShellTabsOptions optionsSnapshot = m_options;
     auto& optionsStore = OptionsStore::Instance();
     if (LoadOptionsStoreForContext(L"TabBand::InitializeTabs async failed to load options", optionsStore)) {
-        optionsSnapshot = optionsStore.Get();
+        optionsSnapshot = *optionsStore.Get();
         result->optionsLoaded = true;
     }
     result->options = optionsSnapshot;
@@ -0,0 +1,318 @@
+#include "TabBandLayout.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace shelltabs {
+namespace {
+
+// Replaces items[first, last) with replacement.
+template <typename T>
+void Splice(std::vector<T>& items, size_t first, size_t last, const std::vector<T>& replacement) {
+    const auto begin = items.begin() + static_cast<ptrdiff_t>(first);
+    const size_t replaced = last - first;
+    if (replaced == replacement.size()) {
+        std::copy(replacement.begin(), replacement.end(), begin);
+        return;
+    }
+    if (replaced > replacement.size()) {
+        std::copy(replacement.begin(), replacement.end(), begin);
+        items.erase(begin + static_cast<ptrdiff_t>(replacement.size()), begin + static_cast<ptrdiff_t>(replaced));
+        return;
+    }
+    std::copy(replacement.begin(), replacement.begin() + static_cast<ptrdiff_t>(replaced), begin);
+    items.insert(begin + static_cast<ptrdiff_t>(replaced), replacement.begin() + static_cast<ptrdiff_t>(replaced),
+                 replacement.end());
+}
+
+}  // namespace
+
+bool TabBandLayout::TryWrap(Cursor& cursor) const noexcept {
+    if (cursor.row + 1 >= m_metrics.maxRows) {
+        return false;
+    }
+    ++cursor.row;
+    cursor.maxRowUsed = std::max(cursor.maxRowUsed, cursor.row);
+    cursor.x = m_metrics.originX;
+    return true;
+}
+
+bool TabBandLayout::Place(size_t index, Cursor& cursor, std::vector<TabLayoutSlot>& slots) {
+    const TabLayoutEntry& entry = m_entries[index];
+    const TabLayoutMetrics& metrics = m_metrics;
+
+    if (entry.kind == TabLayoutEntryKind::kGroupHeader) {
+        cursor.pendingIndicator = false;
+        cursor.group = entry.groupIndex;
+        cursor.header = index;
+        cursor.headerMetadata = true;
+        cursor.expectFirstTab = true;
+
+        // A hidden header hands its handle to the group's first tab.
+        if (!entry.headerVisible && !entry.collapsed && entry.hasVisibleTabs) {
+            cursor.indicator = index;
+            cursor.pendingIndicator = true;
+            return true;
+        }
+
+        if (cursor.group >= 0 && cursor.x > metrics.boundsLeft) {
+            cursor.x += metrics.groupGap;
+        }
+        if (cursor.x + metrics.indicatorWidth > metrics.maxX && !TryWrap(cursor)) {
+            return false;
+        }
+
+        TabLayoutSlot& indicator = slots.emplace_back();
+        indicator.kind = TabLayoutSlotKind::kIndicator;
+        indicator.entry = index;
+        indicator.bounds = {cursor.x, RowTop(cursor.row), cursor.x + metrics.indicatorWidth, RowBottom(cursor.row)};
+        indicator.row = cursor.row;
+        indicator.firstInGroup = true;
+        indicator.collapsedPlaceholder = entry.collapsed;
+        indicator.indicatorHandle = true;
+        cursor.x += metrics.indicatorWidth;
+
+        if (entry.headerVisible && !entry.collapsed && !entry.hasVisibleTabs) {
+            const int32_t bodyWidth = std::min(metrics.maxX - cursor.x, metrics.emptyBodyMaxWidth);
+            if (bodyWidth > 0) {
+                TabLayoutSlot& body = slots.emplace_back();
+                body.kind = TabLayoutSlotKind::kEmptyBody;
+                body.entry = index;
+                body.bounds = {cursor.x, RowTop(cursor.row), cursor.x + bodyWidth, RowBottom(cursor.row)};
+                body.row = cursor.row;
+                body.header = index;
+                cursor.x += bodyWidth;
+            }
+        }
+        return true;
+    }
+
+    if (cursor.group != entry.groupIndex) {
+        cursor.group = entry.groupIndex;
+        cursor.headerMetadata = false;
+        cursor.expectFirstTab = true;
+        if (cursor.slots > 0) {
+            cursor.x += metrics.groupGap;
+        }
+        cursor.pendingIndicator = false;
+    } else if (!cursor.expectFirstTab) {
+        cursor.x += metrics.tabGap;
+    }
+
+    TabLayoutSlot slot;
+    slot.kind = TabLayoutSlotKind::kTab;
+    slot.entry = index;
+    slot.firstInGroup = cursor.expectFirstTab;
+    cursor.expectFirstTab = false;
+    if (cursor.headerMetadata) {
+        slot.header = cursor.header;
+    }
+    if (cursor.pendingIndicator && slot.firstInGroup) {
+        slot.header = cursor.indicator;
+        slot.indicatorHandle = m_entries[cursor.indicator].headerVisible;
+        cursor.pendingIndicator = false;
+        cursor.headerMetadata = true;
+    }
+
+    int32_t width = entry.width;
+    bool wrapped = false;
+    if (cursor.x + width > metrics.maxX) {
+        if (TryWrap(cursor)) {
+            wrapped = true;
+        } else {
+            width = std::max(metrics.minTabWidth, metrics.maxX - cursor.x);
+            if (width <= 0) {
+                return false;
+            }
+        }
+    }
+
+    // The group's handle follows its first tab onto the new row. Handles
+    // come from headers, which are laid out again with the tab.
+    if (wrapped && slot.firstInGroup && !slots.empty()) {
+        TabLayoutSlot& previous = slots.back();
+        if (previous.indicatorHandle && m_entries[previous.entry].groupIndex == entry.groupIndex) {
+            const int32_t indicatorWidth = previous.bounds.Width();
+            previous.bounds = {cursor.x, RowTop(cursor.row), cursor.x + indicatorWidth, RowBottom(cursor.row)};
+            previous.row = cursor.row;
+            cursor.x += indicatorWidth;
+        }
+    }
+
+    width = std::clamp(width, metrics.minTabWidth, std::max(metrics.minTabWidth, metrics.maxX - cursor.x));
+    slot.bounds = {cursor.x, RowTop(cursor.row), cursor.x + width, RowBottom(cursor.row)};
+    slot.row = cursor.row;
+    slots.push_back(slot);
+    cursor.x += width;
+    return true;
+}
+
+const TabLayoutUpdate& TabBandLayout::Update(std::vector<TabLayoutEntry> entries, const TabLayoutMetrics& metrics) {
+    ++m_stats.updates;
+    const bool full = !m_laidOut || !(metrics == m_metrics);
+    const size_t oldCount = m_entries.size();
+    const size_t newCount = entries.size();
+
+    size_t first = 0;
+    size_t suffix = 0;
+    if (!full) {
+        const size_t common = std::min(oldCount, newCount);
+        first = static_cast<size_t>(
+            std::mismatch(m_entries.begin(), m_entries.begin() + static_cast<ptrdiff_t>(common), entries.begin())
+                .first -
+            m_entries.begin());
+        if (first == oldCount && first == newCount) {
+            m_entries = std::move(entries);
+            m_update = {};
+            m_update.firstEntry = newCount;
+            m_update.firstSlot = m_update.endSlot = m_update.oldEndSlot = m_slots.size();
+            return m_update;
+        }
+        while (suffix < common - first &&
+               m_entries[oldCount - 1 - suffix] == entries[newCount - 1 - suffix]) {
+            ++suffix;
+        }
+    } else {
+        ++m_stats.fullLayouts;
+        m_cursors.clear();
+        m_end = {};
+        m_truncated = false;
+    }
+
+    // Placing a tab can move the handle of the header entries just before
+    // it, so restart at the first of them.
+    size_t restart = first;
+    while (restart > 0 && entries[restart - 1].kind == TabLayoutEntryKind::kGroupHeader) {
+        --restart;
+    }
+    if (m_truncated) {
+        restart = std::min(restart, m_cursors.size() - 1);
+    }
+
+    Cursor cursor;
+    cursor.x = metrics.originX;
+    if (!full) {
+        cursor = restart < m_cursors.size() ? m_cursors[restart] : m_end;
+    }
+    const size_t firstSlot = cursor.slots;
+    const std::vector<TabLayoutEntry> oldEntries = std::exchange(m_entries, std::move(entries));
+    m_metrics = metrics;
+    m_laidOut = true;
+
+    // Old entry indices as new ones; false for entries that changed.
+    const ptrdiff_t delta = static_cast<ptrdiff_t>(newCount) - static_cast<ptrdiff_t>(oldCount);
+    const size_t oldTailStart = oldCount - suffix;
+    auto mapOld = [&](size_t index, size_t* mapped) {
+        if (index == kNoTabLayoutEntry || index < first) {
+            *mapped = index;
+            return true;
+        }
+        if (index >= oldTailStart) {
+            *mapped = static_cast<size_t>(static_cast<ptrdiff_t>(index) + delta);
+            return true;
+        }
+        return false;
+    };
+    auto remap = [&](size_t index) {
+        size_t mapped = index;
+        mapOld(index, &mapped);
+        return mapped;
+    };
+    auto converges = [&](const Cursor& old, const Cursor& current) {
+        size_t header = 0;
+        size_t indicator = 0;
+        return old.x == current.x && old.row == current.row && old.maxRowUsed == current.maxRowUsed &&
+               old.group == current.group && old.headerMetadata == current.headerMetadata &&
+               old.expectFirstTab == current.expectFirstTab && old.pendingIndicator == current.pendingIndicator &&
+               (old.slots == 0) == (current.slots == 0) && mapOld(old.header, &header) &&
+               header == current.header && mapOld(old.indicator, &indicator) && indicator == current.indicator;
+    };
+
+    // Lay the changed range out on the side; the old slots and cursors stay
+    // put until it is spliced in.
+    m_placedSlots.clear();
+    m_placedCursors.clear();
+    const size_t newTailStart = newCount - suffix;
+    size_t resumeEntry = m_cursors.size();
+    bool truncated = false;
+    for (size_t index = restart; index < newCount; ++index) {
+        cursor.slots = firstSlot + m_placedSlots.size();
+        // Past an unchanged tab with the wrapping back in step, every later
+        // slot is the old one moved along.
+        if (!full && index > restart && index >= newTailStart &&
+            m_entries[index - 1].kind == TabLayoutEntryKind::kTab) {
+            const size_t oldIndex = static_cast<size_t>(static_cast<ptrdiff_t>(index) - delta);
+            if (oldIndex < m_cursors.size() && converges(m_cursors[oldIndex], cursor)) {
+                resumeEntry = oldIndex;
+                break;
+            }
+        }
+
+        m_placedCursors.push_back(cursor);
+        ++m_stats.placedEntries;
+        if (!Place(index, cursor, m_placedSlots)) {
+            truncated = true;
+            break;
+        }
+    }
+    const bool converged = resumeEntry < m_cursors.size();
+    const size_t oldEndSlot = converged ? m_cursors[resumeEntry].slots : m_slots.size();
+    const size_t endSlot = firstSlot + m_placedSlots.size();
+
+    m_update = {};
+    m_update.full = full;
+    m_update.firstEntry = restart;
+    m_update.firstSlot = firstSlot;
+    m_update.endSlot = endSlot;
+    m_update.oldEndSlot = oldEndSlot;
+    for (size_t slotIndex = firstSlot; slotIndex < oldEndSlot; ++slotIndex) {
+        m_update.groups.push_back(oldEntries[m_slots[slotIndex].entry].groupIndex);
+    }
+    for (const TabLayoutSlot& slot : m_placedSlots) {
+        m_update.groups.push_back(m_entries[slot.entry].groupIndex);
+    }
+    std::sort(m_update.groups.begin(), m_update.groups.end());
+    m_update.groups.erase(std::unique(m_update.groups.begin(), m_update.groups.end()), m_update.groups.end());
+
+    Splice(m_slots, firstSlot, oldEndSlot, m_placedSlots);
+    Splice(m_cursors, restart, resumeEntry, m_placedCursors);
+    if (!converged) {
+        cursor.slots = m_slots.size();
+        m_end = cursor;
+        m_truncated = truncated;
+        return m_update;
+    }
+
+    m_stats.reusedEntries += m_cursors.size() - (restart + m_placedCursors.size());
+    const ptrdiff_t slotDelta = static_cast<ptrdiff_t>(endSlot) - static_cast<ptrdiff_t>(oldEndSlot);
+    if (delta != 0) {
+        for (size_t slotIndex = endSlot; slotIndex < m_slots.size(); ++slotIndex) {
+            m_slots[slotIndex].entry = remap(m_slots[slotIndex].entry);
+            m_slots[slotIndex].header = remap(m_slots[slotIndex].header);
+        }
+    }
+    if (delta != 0 || slotDelta != 0) {
+        for (size_t cursorIndex = restart + m_placedCursors.size(); cursorIndex < m_cursors.size(); ++cursorIndex) {
+            Cursor& moved = m_cursors[cursorIndex];
+            moved.header = remap(moved.header);
+            moved.indicator = remap(moved.indicator);
+            moved.slots = static_cast<size_t>(static_cast<ptrdiff_t>(moved.slots) + slotDelta);
+        }
+        m_end.header = remap(m_end.header);
+        m_end.indicator = remap(m_end.indicator);
+        m_end.slots = m_slots.size();
+    }
+    return m_update;
+}
+
+void TabBandLayout::Reset() {
+    m_laidOut = false;
+    m_entries.clear();
+    m_slots.clear();
+    m_cursors.clear();
+    m_end = {};
+    m_truncated = false;
+    m_update = {};
+}
+
+}  // namespace shelltabs
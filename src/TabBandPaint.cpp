@@ -0,0 +1,227 @@
+#include "TabBandPaint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "TabLabelCache.h"
+
+namespace shelltabs {
+namespace {
+
+// Outlines a rectangle the way the GDI code did: four LineTo calls around
+// its corners, so the right and bottom edges sit on right and bottom.
+void StrokeRect(TabBandPainter& painter, const PaintRect& rect, PaintColor color) {
+    painter.DrawLine({rect.left, rect.top}, {rect.right, rect.top}, color);
+    painter.DrawLine({rect.right, rect.top}, {rect.right, rect.bottom}, color);
+    painter.DrawLine({rect.right, rect.bottom}, {rect.left, rect.bottom}, color);
+    painter.DrawLine({rect.left, rect.bottom}, {rect.left, rect.top}, color);
+}
+
+void PaintTabShape(const TabVisual& visual, TabBandPainter& painter) {
+    if (visual.highContrast) {
+        PaintRect fill = visual.tabBounds;
+        fill.bottom = std::min(fill.bottom, visual.bounds.bottom - 1);
+        painter.FillRect(fill, visual.background);
+        StrokeRect(painter, fill, visual.border);
+        return;
+    }
+
+    PaintRect shape = visual.tabBounds;
+    shape.bottom = std::min(shape.bottom, visual.bounds.bottom - 1);
+    const int32_t radius = visual.cornerRadius;
+    const PaintPoint points[] = {
+        {shape.left, shape.bottom},
+        {shape.left, shape.top + radius},
+        {shape.left + radius, shape.top},
+        {shape.right - radius, shape.top},
+        {shape.right, shape.top + radius},
+        {shape.right, shape.bottom},
+    };
+    painter.FillPolygon(points, std::size(points), visual.background);
+    painter.StrokePolygon(points, std::size(points), visual.border);
+    painter.DrawLine({visual.tabBounds.left + 1, visual.bounds.bottom - 1},
+                     {visual.bounds.right - 1, visual.bounds.bottom - 1}, visual.bottomLine);
+}
+
+// A pushpin: round head, stem, and a small triangle at the tip.
+void PaintPinnedGlyph(const TabVisual& visual, PaintColor color, TabBandPainter& painter) {
+    const int32_t top = visual.tabBounds.top;
+    const int32_t bottom = visual.tabBounds.bottom;
+    const int32_t availableHeight = bottom - top;
+    if (availableHeight <= 4) {
+        return;
+    }
+
+    const int32_t width = visual.pinnedGlyphWidth;
+    const int32_t x = visual.pinnedGlyphLeft;
+    const int32_t headRadius = std::max(2, std::min(width / 2, availableHeight / 5));
+    const int32_t headCenter = top + (availableHeight / 2);
+    const int32_t headTop = std::max(headCenter - headRadius, top + 1);
+    const int32_t headBottom = std::min(headCenter + headRadius, bottom - 2);
+
+    const int32_t maxStem = std::max(1, bottom - headBottom - 2);
+    int32_t stemLength = std::min(std::max(headRadius, availableHeight / 3), maxStem);
+    if (stemLength < 1) {
+        stemLength = std::min(maxStem, 1);
+    }
+
+    const int32_t baseHalf = std::max(1, headRadius);
+    const int32_t triangleHeight = std::max(1, headRadius / 2);
+    const int32_t tipY = headBottom - 1 + stemLength;
+    const int32_t triangleBottom = std::min(bottom - 1, tipY + triangleHeight);
+    const int32_t centerX = x + width / 2;
+
+    painter.FillEllipse({x, headTop, x + width, headBottom}, color);
+    painter.DrawLine({centerX, headBottom - 1}, {centerX, tipY}, color);
+    const PaintPoint triangle[] = {
+        {centerX, tipY},
+        {centerX - baseHalf, triangleBottom},
+        {centerX + baseHalf, triangleBottom},
+    };
+    painter.FillPolygon(triangle, std::size(triangle), color);
+    painter.StrokePolygon(triangle, std::size(triangle), color);
+}
+
+void PaintProgress(const TabProgressVisual& progress, TabBandPainter& painter) {
+    const PaintRect& outer = progress.bounds;
+    if (outer.Empty()) {
+        return;
+    }
+    painter.FillRect(outer, progress.track);
+
+    const PaintRect inner{outer.left + 1, outer.top + 1, outer.right - 1, outer.bottom - 1};
+    if (inner.Empty()) {
+        return;
+    }
+
+    const int32_t width = inner.Width();
+    if (progress.indeterminate) {
+        const int32_t segment = std::max(width / 4, 12);
+        const int32_t cycle = width + segment;
+        const int32_t offset = static_cast<int32_t>((progress.tickMs / 30) % static_cast<uint64_t>(cycle)) - segment;
+        const PaintRect segmentRect{std::max(inner.left, inner.left + offset), inner.top,
+                                    std::min(inner.right, inner.left + offset + segment), inner.bottom};
+        if (!segmentRect.Empty()) {
+            painter.FillRect(segmentRect, progress.fillEnd);
+        }
+    } else {
+        const int32_t fill = std::clamp(static_cast<int32_t>(std::round(progress.fraction * width)), 0, width);
+        if (fill > 0) {
+            painter.FillGradient({inner.left, inner.top, inner.left + fill, inner.bottom}, progress.fillStart,
+                                 progress.fillEnd, true);
+        }
+    }
+
+    StrokeRect(painter, outer, progress.border);
+}
+
+void PaintCloseButton(const TabCloseVisual& close, TabBandPainter& painter) {
+    if (close.bounds.Empty() || painter.DrawNativeCloseButton(close.bounds, close.state)) {
+        return;
+    }
+    painter.FillRect(close.bounds, close.background);
+    StrokeRect(painter, close.bounds, close.border);
+    painter.DrawString(close.bounds, L"x", close.glyph, PaintTextAlign::kCenter);
+}
+
+}  // namespace
+
+bool TabBandPainter::DrawNativeBackground(const PaintRect&) { return false; }
+
+bool TabBandPainter::DrawNativeTab(const PaintRect&, bool, PaintColor*) { return false; }
+
+bool TabBandPainter::DrawNativeCloseButton(const PaintRect&, TabCloseState) { return false; }
+
+void PaintTabVisual(const TabVisual& visual, TabBandPainter& painter) {
+    if (visual.kind == TabVisualKind::kGroupHeader) {
+        if (visual.hasIndicator && !visual.indicator.Empty()) {
+            painter.FillRect(visual.indicator, visual.indicatorColor);
+        }
+        return;
+    }
+
+    PaintColor textColor = visual.text;
+    if (!painter.DrawNativeTab(visual.tabBounds, visual.selected, &textColor)) {
+        textColor = visual.text;
+        PaintTabShape(visual, painter);
+    }
+
+    if (visual.hasIndicator && !visual.indicator.Empty()) {
+        painter.FillRect(visual.indicator, visual.indicatorColor);
+    }
+
+    if (visual.pinned) {
+        PaintPinnedGlyph(visual, textColor, painter);
+    }
+
+    if (visual.icon && !visual.iconBounds.Empty()) {
+        painter.DrawIcon(visual.icon, visual.iconBounds);
+    }
+
+    const bool hasProgress = visual.progress.visible;
+    if (hasProgress) {
+        PaintProgress(visual.progress, painter);
+    }
+
+    PaintRect textRect = visual.bounds;
+    textRect.left = visual.textLeft;
+    textRect.top += 3;
+    textRect.bottom = hasProgress ? visual.tabBounds.bottom - 6 : visual.tabBounds.bottom - 3;
+    if (textRect.bottom <= textRect.top) {
+        textRect.bottom = textRect.top + 1;
+    }
+    textRect.right = std::max(visual.textLeft + 1, visual.textRight);
+    painter.DrawString(textRect, visual.name, textColor,
+                       IsPathLabel(visual.name) ? PaintTextAlign::kLeftPathEllipsis : PaintTextAlign::kLeftEllipsis);
+
+    PaintCloseButton(visual.close, painter);
+}
+
+void PaintTabBandContent(const TabBandScene& scene, TabBandPainter& painter) {
+    if (!scene.surface.Empty() && !painter.DrawNativeBackground(scene.surface)) {
+        painter.FillGradient(scene.surface, scene.backgroundTop, scene.backgroundBottom, false);
+    }
+
+    for (const TabVisual& item : scene.items) {
+        PaintTabVisual(item, painter);
+    }
+
+    for (const GroupOutlineVisual& outline : scene.outlines) {
+        const int32_t left = std::max(outline.bounds.left, scene.client.left);
+        const int32_t top = std::max(outline.bounds.top, scene.client.top);
+        const int32_t right = std::min(outline.bounds.right + 1, scene.client.right);
+        const int32_t clippedBottom = std::min(outline.bounds.bottom, scene.client.bottom);
+        if (right <= left || clippedBottom <= top) {
+            continue;
+        }
+        const int32_t bottom = clippedBottom - 1;
+        const int width = std::max(1, outline.thickness);
+        painter.DrawLine({left, top}, {right, top}, outline.color, width, outline.style);
+        painter.DrawLine({left, top}, {left, bottom}, outline.color, width, outline.style);
+        painter.DrawLine({left, bottom}, {right, bottom}, outline.color, width, outline.style);
+        painter.DrawLine({right, top}, {right, bottom}, outline.color, width, outline.style);
+    }
+
+    if (scene.dropIndicatorX >= 0) {
+        painter.DrawLine({scene.dropIndicatorX, scene.client.top + 2}, {scene.dropIndicatorX, scene.client.bottom - 2},
+                         scene.dropIndicatorColor, 2);
+    }
+}
+
+void PaintEmptyIslandPluses(const TabBandScene& scene, TabBandPainter& painter) {
+    for (const PaintRect& plus : scene.emptyIslandPluses) {
+        const int32_t centerX = plus.left + plus.Width() / 2;
+        const int32_t centerY = plus.top + plus.Height() / 2;
+        const int32_t radius = std::max(1, std::min(plus.Width(), plus.Height()) / 2 - 1);
+        painter.DrawLine({centerX - radius, centerY}, {centerX + radius, centerY}, scene.plusColor, 2);
+        painter.DrawLine({centerX, centerY - radius}, {centerX, centerY + radius}, scene.plusColor, 2);
+    }
+}
+
+void PaintTabBand(const TabBandScene& scene, TabBandPainter& painter) {
+    PaintTabBandContent(scene, painter);
+    PaintEmptyIslandPluses(scene, painter);
+}
+
+}  // namespace shelltabs
@@ -14,10 +14,10 @@
 #include <optional>
 #include <limits>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <atomic>
-#include <list>
 #include <iterator>
 
 #include <CommCtrl.h>
@@ -39,6 +39,7 @@
 #include "OptionsStore.h"
 #include "ShellTabsMessages.h"
 #include "TabBand.h"
+#include "TabLabelCache.h"
 #include "PreviewCache.h"
 #include "Utilities.h"
 #include "ExplorerThemeUtils.h"
@@ -76,105 +77,39 @@ bool EnsureNewTabButtonClassRegistered() {
     return succeeded;
 }
 
-struct FontMetricsKey {
-    LONG height = 0;
-    LONG aveCharWidth = 0;
-    LONG weight = 0;
-    BYTE italic = 0;
-    BYTE pitchAndFamily = 0;
-    BYTE charSet = 0;
-
-    bool operator==(const FontMetricsKey& other) const noexcept {
-        return height == other.height && aveCharWidth == other.aveCharWidth && weight == other.weight &&
-               italic == other.italic && pitchAndFamily == other.pitchAndFamily && charSet == other.charSet;
-    }
-};
-
-struct TextWidthCacheKey {
-    std::wstring text;
-    FontMetricsKey metrics;
-
-    bool operator==(const TextWidthCacheKey& other) const noexcept {
-        return metrics == other.metrics && text == other.text;
-    }
-};
-
-struct TextWidthCacheKeyHasher {
-    size_t operator()(const TextWidthCacheKey& key) const noexcept {
-        size_t hash = std::hash<std::wstring>{}(key.text);
-        hash ^= static_cast<size_t>(key.metrics.height) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
-        hash ^= static_cast<size_t>(key.metrics.aveCharWidth) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
-        hash ^= static_cast<size_t>(key.metrics.weight) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
-        hash ^= static_cast<size_t>(key.metrics.italic) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
-        hash ^= static_cast<size_t>(key.metrics.pitchAndFamily) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
-        hash ^= static_cast<size_t>(key.metrics.charSet) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
-        return hash;
-    }
-};
-
-class TextWidthCache {
+// Measures with the font selected into dc when constructed.
+class GdiTabTextMeasurer final : public TabTextMeasurer {
 public:
-    explicit TextWidthCache(size_t capacity) : m_capacity(std::max<size_t>(1, capacity)) {}
-
-    bool TryGet(const std::wstring& text, const FontMetricsKey& metrics, int& width) {
-        TextWidthCacheKey lookupKey{ text, metrics };
-        auto it = m_lookup.find(lookupKey);
-        if (it == m_lookup.end()) {
-            return false;
-        }
-
-        m_entries.splice(m_entries.begin(), m_entries, it->second);
-        width = it->second->width;
-        return true;
-    }
-
-    void Put(const std::wstring& text, const FontMetricsKey& metrics, int width) {
-        TextWidthCacheKey key{ text, metrics };
-        auto it = m_lookup.find(key);
-        if (it != m_lookup.end()) {
-            it->second->width = width;
-            m_entries.splice(m_entries.begin(), m_entries, it->second);
-            return;
-        }
-
-        m_entries.emplace_front();
-        Entry& entry = m_entries.front();
-        entry.key = std::move(key);
-        entry.width = width;
-        m_lookup.emplace(entry.key, m_entries.begin());
-
-        if (m_entries.size() > m_capacity) {
-            auto last = std::prev(m_entries.end());
-            m_lookup.erase(last->key);
-            m_entries.pop_back();
-        }
-    }
-
-    void Clear() {
-        m_entries.clear();
-        m_lookup.clear();
+    explicit GdiTabTextMeasurer(HDC dc) : m_dc(dc) {
+        TEXTMETRIC tm{};
+        GetTextMetrics(dc, &tm);
+        wchar_t face[LF_FACESIZE] = {};
+        const int faceLength = GetTextFaceW(dc, LF_FACESIZE, face);
+        // The count includes the terminator.
+        m_font.faceHash = HashTabLabelFace(std::wstring_view(face, faceLength > 0 ? faceLength - 1 : 0));
+        m_font.height = tm.tmHeight;
+        m_font.aveCharWidth = tm.tmAveCharWidth;
+        m_font.weight = tm.tmWeight;
+        m_font.italic = tm.tmItalic;
+        m_font.pitchAndFamily = tm.tmPitchAndFamily;
+        m_font.charSet = tm.tmCharSet;
+        m_font.dpi = static_cast<uint32_t>(std::max(GetDeviceCaps(dc, LOGPIXELSY), 1));
+    }
+
+    TabLabelFont Font() const override { return m_font; }
+
+    bool MeasureExtents(std::wstring_view text, int32_t* extents) override {
+        static_assert(sizeof(INT) == sizeof(int32_t));
+        SIZE size{};
+        return GetTextExtentExPointW(m_dc, text.data(), static_cast<int>(text.size()), 0, nullptr,
+                                     reinterpret_cast<INT*>(extents), &size) != FALSE;
     }
 
 private:
-    struct Entry {
-        TextWidthCacheKey key;
-        int width = 0;
-    };
-
-    size_t m_capacity;
-    std::list<Entry> m_entries;
-    std::unordered_map<TextWidthCacheKey, std::list<Entry>::iterator, TextWidthCacheKeyHasher> m_lookup;
+    HDC m_dc;
+    TabLabelFont m_font;
 };
 
-TextWidthCache& GetTextWidthCache() {
-    static TextWidthCache cache(128);
-    return cache;
-}
-
-void ClearTextWidthCache() {
-    GetTextWidthCache().Clear();
-}
-
 std::atomic<uint32_t> g_availableDockMask{0};
 std::mutex g_availableDockMaskMutex;
 std::unordered_map<HWND, uint32_t> g_availableDockMaskByFrame;
@@ -537,6 +472,41 @@ bool RectHasArea(const RECT& rect) {
     return rect.right > rect.left && rect.bottom > rect.top;
 }
 
+PaintRect ToPaintRect(const RECT& rect) {
+    return {static_cast<int32_t>(rect.left), static_cast<int32_t>(rect.top), static_cast<int32_t>(rect.right),
+            static_cast<int32_t>(rect.bottom)};
+}
+
+RECT ToRect(const PaintRect& rect) {
+    return {rect.left, rect.top, rect.right, rect.bottom};
+}
+
+// Top to bottom, then left to right.
+template <typename Outline>
+void SortGroupOutlines(std::vector<Outline>& outlines) {
+    std::sort(outlines.begin(), outlines.end(), [](const Outline& a, const Outline& b) {
+        if (a.bounds.top == b.bounds.top) {
+            if (a.bounds.left == b.bounds.left) {
+                return a.groupIndex < b.groupIndex;
+            }
+            return a.bounds.left < b.bounds.left;
+        }
+        return a.bounds.top < b.bounds.top;
+    });
+}
+
+PaintLineStyle ToPaintLineStyle(TabGroupOutlineStyle style) {
+    switch (style) {
+        case TabGroupOutlineStyle::kDashed:
+            return PaintLineStyle::kDashed;
+        case TabGroupOutlineStyle::kDotted:
+            return PaintLineStyle::kDotted;
+        case TabGroupOutlineStyle::kSolid:
+        default:
+            return PaintLineStyle::kSolid;
+    }
+}
+
 struct HostChromeSample {
     COLORREF top = GetSysColor(COLOR_BTNFACE);
     COLORREF bottom = GetSysColor(COLOR_BTNFACE);
@@ -911,14 +881,29 @@ void TabBandWindow::Show(bool show) {
     ShowWindow(m_hwnd, show ? SW_SHOW : SW_HIDE);
 }
 
-void TabBandWindow::RebuildTabLocationIndex() {
-    m_tabLocationIndex.clear();
-    if (m_tabData.empty()) {
-        return;
+void TabBandWindow::UpdateTabLocationIndex(const std::vector<TabViewItem>& previous) {
+    const size_t common = std::min(previous.size(), m_tabData.size());
+    size_t first = 0;
+    while (first < common && previous[first].type == m_tabData[first].type &&
+           TabLocationEqual{}(previous[first].location, m_tabData[first].location)) {
+        ++first;
+    }
+
+    // Locations are unique per tab, so dropping the old entries from first on
+    // and adding the new ones back matches a full rebuild.
+    for (size_t i = first; i < previous.size(); ++i) {
+        const auto& item = previous[i];
+        if (item.type != TabViewItemType::kTab || !item.location.IsValid()) {
+            continue;
+        }
+        const auto it = m_tabLocationIndex.find(item.location);
+        if (it != m_tabLocationIndex.end() && it->second == i) {
+            m_tabLocationIndex.erase(it);
+        }
     }
 
     m_tabLocationIndex.reserve(m_tabData.size());
-    for (size_t i = 0; i < m_tabData.size(); ++i) {
+    for (size_t i = first; i < m_tabData.size(); ++i) {
         const auto& item = m_tabData[i];
         if (item.type != TabViewItemType::kTab) {
             continue;
@@ -931,14 +916,14 @@ void TabBandWindow::RebuildTabLocationIndex() {
 }
 
 void TabBandWindow::SetTabs(const std::vector<TabViewItem>& items) {
-    m_tabData = items;
+    const std::vector<TabViewItem> previousTabs = std::exchange(m_tabData, items);
     if (auto* manager = ResolveManager(); manager) {
         m_tabLayoutVersion = manager->GetLayoutVersion();
     } else {
         m_tabLayoutVersion = 0;
     }
     RecomputeActiveProgressCount();
-    RebuildTabLocationIndex();
+    UpdateTabLocationIndex(previousTabs);
     m_contextHit = {};
     ClearExplorerContext();
 
@@ -952,26 +937,21 @@ void TabBandWindow::SetTabs(const std::vector<TabViewItem>& items) {
         m_nextRedrawIncremental = false;
         m_lastAppliedRowCount = 0;
         InvalidateGroupOutlineCache();
+        InvalidateHitIndex();
         return;
     }
 
     std::vector<VisualItem> oldItems;
     oldItems.swap(m_items);
+    std::vector<RECT> oldProgressRects;
+    oldProgressRects.swap(m_progressRects);
 
     VisualItemReuseContext reuseContext;
-    VisualItemReuseContext* reuseContextPtr = nullptr;
-    if (!oldItems.empty()) {
-        reuseContext.source = &oldItems;
-        reuseContext.reserved.assign(oldItems.size(), false);
-        reuseContext.indexByKey.reserve(oldItems.size());
-        for (size_t i = 0; i < oldItems.size(); ++i) {
-            const uint64_t key = oldItems[i].stableId != 0
-                                     ? oldItems[i].stableId
-                                     : ComputeTabViewStableId(oldItems[i].data);
-            reuseContext.indexByKey[key].push_back(i);
-        }
-        reuseContextPtr = &reuseContext;
-    }
+    VisualItemReuseContext* reuseContextPtr = PrepareReuseContext(oldItems, &reuseContext);
+
+    // Clearing a drop preview that moves indicators rebuilds the outlines
+    // from the items swapped out above.
+    const bool outlinesCurrent = !DropPreviewAffectsIndicators(m_drag.target);
 
     HideDragOverlay(true);
     HidePreviewWindow(false);
@@ -990,6 +970,8 @@ void TabBandWindow::SetTabs(const std::vector<TabViewItem>& items) {
     const bool rowCountChanged = normalizedRowCount != m_lastRowCount;
 
     m_items = std::move(layout.items);
+    InvalidateHitIndex();
+    SyncPreviewPrefetchTabs();
 
     auto isValidRect = [](const RECT& rect) {
         return rect.right > rect.left && rect.bottom > rect.top;
@@ -1010,8 +992,14 @@ void TabBandWindow::SetTabs(const std::vector<TabViewItem>& items) {
         }
     }
 
-    RebuildProgressRectCache();
-    RebuildGroupOutlineCache();
+    if (layout.update.full || !outlinesCurrent) {
+        RebuildProgressRectCache();
+        RebuildGroupOutlineCache();
+    } else {
+        const std::vector<int> affectedGroups = CollectAffectedGroups(oldItems, m_items, diff, layout.update);
+        UpdateProgressRectCache(oldProgressRects, diff, affectedGroups);
+        UpdateGroupOutlineCache(affectedGroups);
+    }
     m_lastRowCount = normalizedRowCount;
 
     if (!diff.removedIndices.empty()) {
@@ -1046,10 +1034,10 @@ void TabBandWindow::SetTabs(const std::vector<TabViewItem>& items) {
 
     UpdateProgressAnimationState();
 
-    if (diff.inserted > 0 || diff.removed > 0 || diff.moved > 0 || diff.updated > 0) {
+    if (diff.inserted > 0 || diff.removed > 0 || diff.moved > 0 || diff.reordered > 0 || diff.updated > 0) {
         LogMessage(LogLevel::Info,
-                   L"Tab diff: +%zu -%zu move=%zu update=%zu rows=%d incremental=%ls",
-                   diff.inserted, diff.removed, diff.moved, diff.updated, m_lastRowCount,
+                   L"Tab diff: +%zu -%zu move=%zu reorder=%zu update=%zu rows=%d incremental=%ls",
+                   diff.inserted, diff.removed, diff.moved, diff.reordered, diff.updated, m_lastRowCount,
                    m_nextRedrawIncremental ? L"true" : L"false");
     }
 }
@@ -1095,7 +1083,7 @@ STDMETHODIMP TabBandWindow::GetSite(REFIID riid, void** ppvSite) {
 
 void TabBandWindow::Layout(int width, int height) {
     m_clientRect = {0, 0, width, height};
-    RebuildLayout();
+    RebuildLayout(true);
 }
 
 void TabBandWindow::DestroyVisualItemResources(std::vector<VisualItem>& items) {
@@ -1120,6 +1108,7 @@ void TabBandWindow::ClearVisualItems() {
     m_emptyIslandPlusButtons.clear();
     SetRectEmpty(&m_newTabBounds);
     InvalidateGroupOutlineCache();
+    InvalidateHitIndex();
 }
 
 void TabBandWindow::ReleaseBackBuffer() {
@@ -1144,6 +1133,7 @@ void TabBandWindow::ReleaseBackBuffer() {
 TabBandWindow::LayoutResult TabBandWindow::BuildLayoutItems(const std::vector<TabViewItem>& items,
                                                             VisualItemReuseContext* reuseContext) {
     LayoutResult result;
+    result.update.full = true;
     if (!m_hwnd) {
         return result;
     }
@@ -1173,15 +1163,8 @@ TabBandWindow::LayoutResult TabBandWindow::BuildLayoutItems(const std::vector<Ta
     TEXTMETRIC tm{};
     GetTextMetrics(dc, &tm);
 
-    FontMetricsKey metricsKey;
-    metricsKey.height = tm.tmHeight;
-    metricsKey.aveCharWidth = tm.tmAveCharWidth;
-    metricsKey.weight = tm.tmWeight;
-    metricsKey.italic = tm.tmItalic;
-    metricsKey.pitchAndFamily = tm.tmPitchAndFamily;
-    metricsKey.charSet = tm.tmCharSet;
-
-    auto& widthCache = GetTextWidthCache();
+    GdiTabTextMeasurer measurer(dc);
+    auto& labelCache = GetTabLabelCache();
 
     int rowHeight = static_cast<int>(tm.tmHeight);
     if (rowHeight > 0) {
@@ -1219,27 +1202,21 @@ TabBandWindow::LayoutResult TabBandWindow::BuildLayoutItems(const std::vector<Ta
     }
     const int trailingReserve = (buttonWidth > 0) ? std::min(buttonWidth + kTabGap + kButtonMargin, bandWidth) : 0;
 
-    int x = boundsLeft + gripWidth - 3;   // DO NOT TOUCH
-
-    const int startY = boundsTop + 2;
-    const int maxX = std::max(boundsLeft + gripWidth - 3, boundsRight - trailingReserve);
-
-    int row = 0;
-    int maxRowUsed = 0;
-    auto rowTop = [&](int r) { return startY + r * (rowHeight + kRowGap); };
-    auto rowBottom = [&](int r) { return rowTop(r) + rowHeight; };
-
-    auto try_wrap = [&]() {
-        if (row + 1 < kMaxTabRows) {
-            ++row;
-            if (row > maxRowUsed) {
-                maxRowUsed = row;
-            }
-            x = boundsLeft + gripWidth - 3;  // DO NOT TOUCH
-            return true;
-        }
-        return false;
-    };
+    const int originX = boundsLeft + gripWidth - 3;   // DO NOT TOUCH
+
+    TabLayoutMetrics metrics;
+    metrics.boundsLeft = boundsLeft;
+    metrics.originX = originX;
+    metrics.maxX = std::max(originX, boundsRight - trailingReserve);
+    metrics.top = boundsTop + 2;
+    metrics.rowHeight = rowHeight;
+    metrics.rowGap = kRowGap;
+    metrics.maxRows = kMaxTabRows;
+    metrics.tabGap = kTabGap;
+    metrics.groupGap = kGroupGap;
+    metrics.indicatorWidth = kIslandIndicatorWidth;
+    metrics.emptyBodyMaxWidth = kEmptyIslandBodyMaxWidth;
+    metrics.minTabWidth = 40;
 
     auto acquireReuse = [&](VisualItem& visual) -> const VisualItem* {
         if (!reuseContext || !reuseContext->source) {
@@ -1302,152 +1279,66 @@ TabBandWindow::LayoutResult TabBandWindow::BuildLayoutItems(const std::vector<Ta
         return &(*reuseContext->source)[selected];
     };
 
-    int currentGroup = -1;
-    TabViewItem currentHeader{};
-    bool headerMetadata = false;
-    bool expectFirstTab = false;
-    bool pendingIndicator = false;
-    TabViewItem indicatorHeader{};
-
-    result.items.reserve(items.size() + 8);
+    // An unchanged tab keeps its icon, and its width while the font is the
+    // same, so only new and renamed tabs go to the label cache and the shell.
+    const TabLabelFont labelFont = measurer.Font();
+    const bool sameFont = labelFont == m_layoutFont;
+    m_layoutFont = labelFont;
+    auto findMeasured = [&](const TabViewItem& item, uint64_t key) -> const VisualItem* {
+        if (!reuseContext || !reuseContext->source) {
+            return nullptr;
+        }
+        auto it = reuseContext->indexByKey.find(key);
+        if (it == reuseContext->indexByKey.end()) {
+            return nullptr;
+        }
+        for (size_t idx : it->second) {
+            const VisualItem& candidate = (*reuseContext->source)[idx];
+            if (candidate.data.type == TabViewItemType::kTab && candidate.icon &&
+                EquivalentTabViewItem(candidate.data, item)) {
+                return &candidate;
+            }
+        }
+        return nullptr;
+    };
 
 #if defined(_DEBUG)
-    size_t cacheLookups = 0;
-    size_t cacheHits = 0;
+    const TabLabelCacheStats statsBefore = labelCache.Stats();
 #endif
 
-    RECT newTabBounds{};
-    bool newTabVisible = false;
-
-    for (const auto& item : items) {
+    std::vector<TabLayoutEntry> entries;
+    entries.reserve(items.size());
+    std::vector<VisualItem> tabVisuals(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        const auto& item = items[i];
+        TabLayoutEntry& entry = entries.emplace_back();
+        entry.groupIndex = item.location.groupIndex;
         if (item.type == TabViewItemType::kGroupHeader) {
-            pendingIndicator = false;
-            currentGroup = item.location.groupIndex;
-            currentHeader = item;
-            headerMetadata = true;
-            expectFirstTab = true;
-
-            const bool collapsed = item.collapsed;
-            const bool hasVisibleTabs = item.visibleTabs > 0;
-            if (!item.headerVisible && !collapsed && hasVisibleTabs) {
-                indicatorHeader = item;
-                pendingIndicator = true;
-                continue;
-            }
-
-            if (currentGroup >= 0 && x > boundsLeft) {
-                x += kGroupGap;
-            }
-
-            int width = kIslandIndicatorWidth;
-            if (x + width > maxX) {
-                if (!try_wrap()) {
-                    break;
-                }
-            }
-
-            VisualItem visual;
-            visual.data = item;
-            visual.stableId = item.stableId != 0 ? item.stableId : ComputeTabViewStableId(item);
-            visual.firstInGroup = true;
-            visual.collapsedPlaceholder = collapsed;
-            visual.indicatorHandle = true;
-            acquireReuse(visual);
-            visual.bounds = {x, rowTop(row), x + width, rowBottom(row)};
-            visual.row = row;
-            result.items.emplace_back(std::move(visual));
-            x += width;
-
-            if (item.headerVisible && !collapsed && !hasVisibleTabs) {
-                const int remaining = maxX - x;
-                if (remaining > 0) {
-                    const int placeholderWidth = std::min(remaining, kEmptyIslandBodyMaxWidth);
-                    if (placeholderWidth > 0) {
-                        RECT placeholder{ x, rowTop(row), x + placeholderWidth, rowBottom(row) };
-
-                        VisualItem emptyBody;
-                        emptyBody.data = item;
-                        emptyBody.stableId = item.stableId != 0 ? item.stableId : ComputeTabViewStableId(item);
-                        emptyBody.hasGroupHeader = true;
-                        emptyBody.groupHeader = currentHeader;
-                        acquireReuse(emptyBody);
-                        emptyBody.bounds = placeholder;
-                        emptyBody.row = row;
-                        result.items.emplace_back(std::move(emptyBody));
-
-                        const int bodyWidth = placeholder.right - placeholder.left;
-                        if (bodyWidth >= 4) {
-                            const int h = placeholder.bottom - placeholder.top;
-                            const int maxCentered = std::max(bodyWidth - 4, 0);
-                            int size = std::min(kEmptyPlusSize, maxCentered);
-                            if (size < 8) {
-                                size = std::max(4, maxCentered);
-                            }
-                            const int plusLeft = placeholder.left + (bodyWidth - size) / 2;
-                            RECT plus{
-                                plusLeft,
-                                placeholder.top + (h - size) / 2,
-                                plusLeft + size,
-                                placeholder.top + (h - size) / 2 + size
-                            };
-                            m_emptyIslandPlusButtons.push_back({ currentGroup, plus, placeholder });
-                        }
-
-                        x = placeholder.right;
-                    }
-                }
-            }
+            entry.kind = TabLayoutEntryKind::kGroupHeader;
+            entry.headerVisible = item.headerVisible;
+            entry.collapsed = item.collapsed;
+            entry.hasVisibleTabs = item.visibleTabs > 0;
             continue;
         }
 
-        VisualItem visual;
-        visual.data = item;
+        VisualItem& visual = tabVisuals[i];
         visual.stableId = item.stableId != 0 ? item.stableId : ComputeTabViewStableId(item);
+        visual.badgeWidth = item.pinned ? (kPinnedGlyphWidth + kPinnedGlyphPadding) : 0;
 
-        if (currentGroup != item.location.groupIndex) {
-            currentGroup = item.location.groupIndex;
-            headerMetadata = false;
-            expectFirstTab = true;
-            if (!result.items.empty()) {
-                x += kGroupGap;
+        const VisualItem* measured = findMeasured(item, visual.stableId);
+        if (measured) {
+            visual.icon = measured->icon;
+            visual.iconWidth = measured->iconWidth;
+            visual.iconHeight = measured->iconHeight;
+            visual.reusedIconMetrics = true;
+            if (sameFont && measured->measuredWidth > 0) {
+                visual.measuredWidth = measured->measuredWidth;
+                entry.width = visual.measuredWidth;
+                continue;
             }
-            pendingIndicator = false;
-        } else if (!expectFirstTab) {
-            x += kTabGap;
         }
 
-        if (expectFirstTab) {
-            visual.firstInGroup = true;
-            expectFirstTab = false;
-        }
-        visual.hasGroupHeader = headerMetadata;
-        if (visual.hasGroupHeader) {
-            visual.groupHeader = currentHeader;
-        }
-        if (pendingIndicator && visual.firstInGroup) {
-            visual.hasGroupHeader = true;
-            visual.groupHeader = indicatorHeader;
-            visual.indicatorHandle = indicatorHeader.headerVisible;
-            pendingIndicator = false;
-            headerMetadata = true;
-        }
-
-        int measuredTextWidth = 0;
-        if (!item.name.empty()) {
-#if defined(_DEBUG)
-            ++cacheLookups;
-#endif
-            if (widthCache.TryGet(item.name, metricsKey, measuredTextWidth)) {
-#if defined(_DEBUG)
-                ++cacheHits;
-#endif
-            } else {
-                SIZE textSize{0, 0};
-                GetTextExtentPoint32W(dc, item.name.c_str(), static_cast<int>(item.name.size()), &textSize);
-                measuredTextWidth = textSize.cx;
-                widthCache.Put(item.name, metricsKey, measuredTextWidth);
-            }
-        }
+        const int measuredTextWidth = item.name.empty() ? 0 : labelCache.Width(measurer, item.name);
 
         int width = measuredTextWidth + kPaddingX * 2;
         if (item.pinned) {
@@ -1455,16 +1346,6 @@ TabBandWindow::LayoutResult TabBandWindow::BuildLayoutItems(const std::vector<Ta
         }
         width = std::max(width, kItemMinWidth);
 
-        visual.badgeWidth = item.pinned ? (kPinnedGlyphWidth + kPinnedGlyphPadding) : 0;
-
-        const VisualItem* preserved = acquireReuse(visual);
-        if (preserved && EquivalentTabViewItem(preserved->data, visual.data) && preserved->icon) {
-            visual.icon = preserved->icon;
-            visual.iconWidth = preserved->iconWidth;
-            visual.iconHeight = preserved->iconHeight;
-            visual.reusedIconMetrics = true;
-        }
-
         if (!visual.icon) {
             visual.icon = LoadItemIcon(item, SHGFI_SMALLICON);
             if (visual.icon) {
@@ -1512,44 +1393,67 @@ TabBandWindow::LayoutResult TabBandWindow::BuildLayoutItems(const std::vector<Ta
         if (item.pinned) {
             width = std::min(width, kPinnedTabMaxWidth);
         }
+        visual.measuredWidth = width;
+        entry.width = width;
+    }
 
-        bool wrapped = false;
-        if (x + width > maxX) {
-            if (!try_wrap()) {
-                width = std::max(40, maxX - x);
-                if (width <= 0) {
-                    break;
-                }
-            } else {
-                wrapped = true;
-            }
-        }
-
-        if (wrapped && visual.firstInGroup) {
-            if (!result.items.empty()) {
-                VisualItem& previous = result.items.back();
-                if (previous.indicatorHandle &&
-                    previous.data.location.groupIndex == item.location.groupIndex) {
-                    const int indicatorWidth = previous.bounds.right - previous.bounds.left;
-                    previous.bounds.left = x;
-                    previous.bounds.right = x + indicatorWidth;
-                    previous.bounds.top = rowTop(row);
-                    previous.bounds.bottom = rowBottom(row);
-                    previous.row = row;
-                    x += indicatorWidth;
+    result.update = m_layout.Update(std::move(entries), metrics);
+
+    const auto& slots = m_layout.Slots();
+    result.items.reserve(slots.size());
+    for (const TabLayoutSlot& slot : slots) {
+        const TabViewItem& item = items[slot.entry];
+        VisualItem visual = slot.kind == TabLayoutSlotKind::kTab ? std::move(tabVisuals[slot.entry]) : VisualItem{};
+        visual.data = item;
+        if (slot.kind != TabLayoutSlotKind::kTab) {
+            visual.stableId = item.stableId != 0 ? item.stableId : ComputeTabViewStableId(item);
+        }
+        visual.firstInGroup = slot.firstInGroup;
+        visual.collapsedPlaceholder = slot.collapsedPlaceholder;
+        visual.indicatorHandle = slot.indicatorHandle;
+        if (slot.header != kNoTabLayoutEntry) {
+            visual.hasGroupHeader = true;
+            visual.groupHeader = items[slot.header];
+        }
+        acquireReuse(visual);
+        visual.bounds = ToRect(slot.bounds);
+        visual.row = slot.row;
+        if (slot.kind == TabLayoutSlotKind::kTab) {
+            visual.index = result.items.size();
+        }
+
+        if (slot.kind == TabLayoutSlotKind::kEmptyBody) {
+            const RECT placeholder = visual.bounds;
+            const int bodyWidth = placeholder.right - placeholder.left;
+            if (bodyWidth >= 4) {
+                const int h = placeholder.bottom - placeholder.top;
+                const int maxCentered = std::max(bodyWidth - 4, 0);
+                int size = std::min(kEmptyPlusSize, maxCentered);
+                if (size < 8) {
+                    size = std::max(4, maxCentered);
                 }
+                const int plusLeft = placeholder.left + (bodyWidth - size) / 2;
+                RECT plus{
+                    plusLeft,
+                    placeholder.top + (h - size) / 2,
+                    plusLeft + size,
+                    placeholder.top + (h - size) / 2 + size
+                };
+                m_emptyIslandPlusButtons.push_back({ item.location.groupIndex, plus, placeholder });
             }
         }
-
-        width = std::clamp(width, 40, std::max(40, maxX - x));
-
-        visual.bounds = {x, rowTop(row), x + width, rowBottom(row)};
-        visual.row = row;
-        visual.index = result.items.size();
         result.items.emplace_back(std::move(visual));
-        x += width;
     }
 
+    const int x = m_layout.EndX();
+    const int row = m_layout.EndRow();
+    int maxRowUsed = m_layout.MaxRowUsed();
+    auto rowTop = [&](int r) { return m_layout.RowTop(r); };
+    auto rowBottom = [&](int r) { return m_layout.RowBottom(r); };
+
+    RECT newTabBounds{};
+    bool newTabVisible = false;
+
     if (buttonWidth > 0 && buttonHeight > 0) {
         int slotRow = std::clamp(row, 0, kMaxTabRows - 1);
         const int baseLeft = boundsLeft + gripWidth - 3;
@@ -1602,21 +1506,38 @@ TabBandWindow::LayoutResult TabBandWindow::BuildLayoutItems(const std::vector<Ta
     ReleaseDC(m_hwnd, dc);
 
 #if defined(_DEBUG)
-    if (cacheLookups > 0) {
-        const size_t cacheMisses = cacheLookups - cacheHits;
-        const double hitRate = cacheLookups > 0 ? (static_cast<double>(cacheHits) * 100.0) / cacheLookups : 0.0;
+    const TabLabelCacheStats statsAfter = labelCache.Stats();
+    const uint64_t cacheHits = statsAfter.hits - statsBefore.hits;
+    const uint64_t cacheMisses = statsAfter.misses - statsBefore.misses;
+    if (cacheHits + cacheMisses > 0) {
+        const double hitRate = (static_cast<double>(cacheHits) * 100.0) / static_cast<double>(cacheHits + cacheMisses);
         LogMessage(LogLevel::Info,
-                   L"Tab text width cache: lookups=%Iu hits=%Iu misses=%Iu hitRate=%.2f%%",
-                   static_cast<size_t>(cacheLookups),
-                   static_cast<size_t>(cacheHits),
-                   static_cast<size_t>(cacheMisses),
+                   L"Tab label cache: lookups=%llu hits=%llu misses=%llu hitRate=%.2f%%",
+                   static_cast<unsigned long long>(cacheHits + cacheMisses),
+                   static_cast<unsigned long long>(cacheHits),
+                   static_cast<unsigned long long>(cacheMisses),
                    hitRate);
     }
 #endif
     return result;
 }
 
-void TabBandWindow::RebuildLayout() {
+TabBandWindow::VisualItemReuseContext* TabBandWindow::PrepareReuseContext(std::vector<VisualItem>& source,
+                                                                         VisualItemReuseContext* context) const {
+    if (source.empty()) {
+        return nullptr;
+    }
+    context->source = &source;
+    context->reserved.assign(source.size(), false);
+    context->indexByKey.reserve(source.size());
+    for (size_t i = 0; i < source.size(); ++i) {
+        const uint64_t key = source[i].stableId != 0 ? source[i].stableId : ComputeTabViewStableId(source[i].data);
+        context->indexByKey[key].push_back(i);
+    }
+    return context;
+}
+
+void TabBandWindow::RebuildLayout(bool reuseVisuals) {
     if (!m_hwnd) {
         DestroyVisualItemResources(m_items);
         m_items.clear();
@@ -1626,12 +1547,15 @@ void TabBandWindow::RebuildLayout() {
         SetRectEmpty(&m_newTabBounds);
         m_nextRedrawIncremental = false;
         InvalidateGroupOutlineCache();
-        RebuildTabLocationIndex();
+        InvalidateHitIndex();
         return;
     }
 
     std::vector<VisualItem> oldItems;
     oldItems.swap(m_items);
+    VisualItemReuseContext reuseContext;
+    VisualItemReuseContext* reuseContextPtr =
+        reuseVisuals ? PrepareReuseContext(oldItems, &reuseContext) : nullptr;
 
     HideDragOverlay(true);
     HidePreviewWindow(false);
@@ -1641,9 +1565,10 @@ void TabBandWindow::RebuildLayout() {
     m_contextHit = {};
     m_emptyIslandPlusButtons.clear();
 
-    LayoutResult layout = BuildLayoutItems(m_tabData, nullptr);
-    RebuildTabLocationIndex();
+    LayoutResult layout = BuildLayoutItems(m_tabData, reuseContextPtr);
     m_items = std::move(layout.items);
+    InvalidateHitIndex();
+    SyncPreviewPrefetchTabs();
     if (layout.newTabVisible && layout.newTabBounds.right > layout.newTabBounds.left &&
         layout.newTabBounds.bottom > layout.newTabBounds.top) {
         m_newTabBounds = layout.newTabBounds;
@@ -1689,16 +1614,31 @@ TabBandWindow::LayoutDiffStats TabBandWindow::ComputeLayoutDiff(std::vector<Visu
         return stats;
     }
 
-    std::unordered_map<uint64_t, std::vector<size_t>> oldMap;
-    oldMap.reserve(oldItems.size());
-    for (size_t i = 0; i < oldItems.size(); ++i) {
-        const uint64_t stableId = oldItems[i].stableId != 0 ? oldItems[i].stableId
-                                                            : ComputeTabViewStableId(oldItems[i].data);
-        oldMap[stableId].push_back(i);
-    }
-
-    std::vector<bool> consumed(oldItems.size(), false);
-    stats.matchedOldIndices.assign(newItems.size(), kInvalidIndex);
+    auto keyOf = [](const VisualItem& item) {
+        return item.stableId != 0 ? item.stableId : ComputeTabViewStableId(item.data);
+    };
+    // Among items sharing a key, prefer one with the same role and content,
+    // then the same role, then the same content.
+    auto rank = [&](size_t oldIndex, size_t newIndex) {
+        const VisualItem& oldItem = oldItems[oldIndex];
+        const VisualItem& item = newItems[newIndex];
+        const bool sameRole = oldItem.indicatorHandle == item.indicatorHandle &&
+                              oldItem.collapsedPlaceholder == item.collapsedPlaceholder &&
+                              oldItem.hasGroupHeader == item.hasGroupHeader;
+        const bool sameContent = EquivalentTabViewItem(oldItem.data, item.data);
+        if (sameRole && sameContent && oldItem.firstInGroup == item.firstInGroup) {
+            return 0;
+        }
+        if (sameRole) {
+            return 1;
+        }
+        return sameContent ? 2 : 3;
+    };
+    const TabLayoutDiffResult& result = m_layoutDiffer.Compute(
+        oldItems.size(), newItems.size(), [&](size_t i) { return keyOf(oldItems[i]); },
+        [&](size_t i) { return keyOf(newItems[i]); }, [&](size_t i) { return newItems[i].reuseSourceIndex; }, rank);
+    stats.matchedOldIndices = result.matchedOld;
+    stats.ops = result.ops;
 
     RECT client = m_clientRect;
     if (client.right <= client.left || client.bottom <= client.top) {
@@ -1713,77 +1653,48 @@ TabBandWindow::LayoutDiffStats TabBandWindow::ComputeLayoutDiff(std::vector<Visu
             stats.invalidRects.push_back(clipped);
         }
     };
+    auto enqueueUnion = [&](const RECT& oldBounds, const RECT& newBounds) {
+        RECT unionRect{};
+        RECT oldRect = NormalizeRect(oldBounds);
+        RECT newRect = NormalizeRect(newBounds);
+        UnionRect(&unionRect, &oldRect, &newRect);
+        enqueueRect(unionRect);
+    };
 
-    for (size_t newIndex = 0; newIndex < newItems.size(); ++newIndex) {
-        auto& item = newItems[newIndex];
-        const uint64_t key = item.stableId != 0 ? item.stableId : ComputeTabViewStableId(item.data);
-        auto it = oldMap.find(key);
-        if (it == oldMap.end() || it->second.empty()) {
-            ++stats.inserted;
-            enqueueRect(item.bounds);
-            continue;
-        }
-
-        auto& candidates = it->second;
-        auto selectCandidate = [&](auto&& predicate) -> size_t {
-            for (size_t idx = 0; idx < candidates.size(); ++idx) {
-                const size_t candidateIndex = candidates[idx];
-                if (predicate(oldItems[candidateIndex])) {
-                    const size_t result = candidateIndex;
-                    candidates[idx] = candidates.back();
-                    candidates.pop_back();
-                    return result;
-                }
-            }
-            return kInvalidIndex;
-        };
-
-        size_t oldIndex = kInvalidIndex;
-        if (item.reuseSourceIndex != kInvalidIndex && item.reuseSourceIndex < oldItems.size() &&
-            !consumed[item.reuseSourceIndex]) {
-            for (size_t idx = 0; idx < candidates.size(); ++idx) {
-                if (candidates[idx] == item.reuseSourceIndex) {
-                    oldIndex = item.reuseSourceIndex;
-                    candidates[idx] = candidates.back();
-                    candidates.pop_back();
-                    break;
-                }
-            }
-        }
-
-        if (oldIndex == kInvalidIndex) {
-            oldIndex = selectCandidate([&](const VisualItem& oldItem) {
-                return oldItem.indicatorHandle == item.indicatorHandle &&
-                       oldItem.collapsedPlaceholder == item.collapsedPlaceholder &&
-                       oldItem.hasGroupHeader == item.hasGroupHeader &&
-                       oldItem.firstInGroup == item.firstInGroup &&
-                       EquivalentTabViewItem(oldItem.data, item.data);
-            });
-        }
-
-        if (oldIndex == kInvalidIndex) {
-            oldIndex = selectCandidate([&](const VisualItem& oldItem) {
-                return oldItem.indicatorHandle == item.indicatorHandle &&
-                       oldItem.collapsedPlaceholder == item.collapsedPlaceholder &&
-                       oldItem.hasGroupHeader == item.hasGroupHeader;
-            });
+    for (const TabLayoutDiffOp& op : result.ops) {
+        switch (op.kind) {
+            case TabLayoutDiffOpKind::kRemove:
+                ++stats.removed;
+                enqueueRect(oldItems[op.oldIndex].bounds);
+                stats.removedIndices.push_back(op.oldIndex);
+                break;
+            case TabLayoutDiffOpKind::kInsert:
+                ++stats.inserted;
+                enqueueRect(newItems[op.newIndex].bounds);
+                break;
+            case TabLayoutDiffOpKind::kMove:
+                ++stats.reordered;
+                enqueueUnion(oldItems[op.oldIndex].bounds, newItems[op.newIndex].bounds);
+                break;
         }
+    }
 
-        if (oldIndex == kInvalidIndex) {
-            oldIndex = selectCandidate([&](const VisualItem& oldItem) {
-                return EquivalentTabViewItem(oldItem.data, item.data);
-            });
+    // Moves and inserts follow the removes in new index order.
+    auto nextOp = std::find_if(result.ops.begin(), result.ops.end(), [](const TabLayoutDiffOp& op) {
+        return op.kind != TabLayoutDiffOpKind::kRemove;
+    });
+    for (size_t newIndex = 0; newIndex < newItems.size(); ++newIndex) {
+        const size_t oldIndex = result.matchedOld[newIndex];
+        bool reordered = false;
+        if (nextOp != result.ops.end() && nextOp->newIndex == newIndex) {
+            reordered = nextOp->kind == TabLayoutDiffOpKind::kMove;
+            ++nextOp;
         }
-
-        if (oldIndex == kInvalidIndex) {
-            oldIndex = candidates.back();
-            candidates.pop_back();
+        if (oldIndex == kNoTabLayoutMatch) {
+            continue;
         }
-
-        consumed[oldIndex] = true;
         VisualItem& oldItem = oldItems[oldIndex];
-        VisualItem& newItem = item;
-        stats.matchedOldIndices[newIndex] = oldIndex;
+        VisualItem& newItem = newItems[newIndex];
         newItem.reuseSourceIndex = oldIndex;
 
         if (oldItem.icon) {
@@ -1812,20 +1723,9 @@ TabBandWindow::LayoutDiffStats TabBandWindow::ComputeLayoutDiff(std::vector<Visu
         if (contentChanged) {
             ++stats.updated;
         }
-        if (moved || contentChanged) {
-            RECT unionRect{};
-            RECT oldRect = NormalizeRect(oldItem.bounds);
-            RECT newRect = NormalizeRect(newItem.bounds);
-            UnionRect(&unionRect, &oldRect, &newRect);
-            enqueueRect(unionRect);
-        }
-    }
-
-    for (size_t i = 0; i < consumed.size(); ++i) {
-        if (!consumed[i]) {
-            ++stats.removed;
-            enqueueRect(oldItems[i].bounds);
-            stats.removedIndices.push_back(i);
+        // A reordered item was invalidated with its move op.
+        if ((moved || contentChanged) && !reordered) {
+            enqueueUnion(oldItem.bounds, newItem.bounds);
         }
     }
 
@@ -2165,50 +2065,191 @@ void TabBandWindow::RecordRedrawDuration(double milliseconds, bool incremental)
     }
 }
 
-void TabBandWindow::DrawEmptyIslandPluses(HDC dc) const {
-	if (!dc) return;
+class TabBandWindow::GdiPainter final : public TabBandPainter {
+public:
+    GdiPainter(const TabBandWindow& window, HDC dc) noexcept : m_window(window), m_dc(dc) {}
 
-	HPEN pen = CreatePen(PS_SOLID, 2,
-		m_themePalette.tabTextValid ? m_themePalette.tabText : RGB(220, 220, 220));
-	if (!pen) return;
+    bool DrawNativeBackground(const PaintRect& bounds) override {
+        m_window.DrawBackground(m_dc, ToRect(bounds));
+        return true;
+    }
 
-	HGDIOBJ old = SelectObject(dc, pen);
+    bool DrawNativeTab(const PaintRect& bounds, bool selected, PaintColor* textColor) override {
+        if (!m_window.m_tabTheme || m_window.m_darkMode) {
+            return false;
+        }
+        const int state = selected ? TIS_SELECTED : TIS_NORMAL;
+        RECT rect = ToRect(bounds);
+        if (FAILED(DrawThemeBackground(m_window.m_tabTheme, m_dc, TABP_TABITEM, state, &rect, nullptr))) {
+            return false;
+        }
+        COLORREF themeText = 0;
+        if (textColor &&
+            SUCCEEDED(GetThemeColor(m_window.m_tabTheme, TABP_TABITEM, state, TMT_TEXTCOLOR, &themeText))) {
+            *textColor = themeText;
+        }
+        return true;
+    }
 
-        for (const auto& b : m_emptyIslandPlusButtons) {
-                const RECT& plus = b.plus;
-                const int w = static_cast<int>(plus.right - plus.left);
-                const int h = static_cast<int>(plus.bottom - plus.top);
-                const int cx = plus.left + w / 2;
-                const int cy = plus.top + h / 2;
-
-		// radius = min(w, h)/2 - 1, clamped to >= 1, done without std::min/std::max
-		int d = (w < h) ? w : h;
-		int r = (d / 2) - 1;
-		if (r < 1) r = 1;
-
-		// horizontal
-		MoveToEx(dc, cx - r, cy, nullptr);
-		LineTo(dc, cx + r, cy);
-		// vertical
-		MoveToEx(dc, cx, cy - r, nullptr);
-		LineTo(dc, cx, cy + r);
-	}
+    bool DrawNativeCloseButton(const PaintRect& bounds, TabCloseState state) override {
+        if (!m_window.m_windowTheme) {
+            return false;
+        }
+        int closeState = CBS_NORMAL;
+        if (state == TabCloseState::kPressed) {
+            closeState = CBS_PUSHED;
+        } else if (state == TabCloseState::kHot) {
+            closeState = CBS_HOT;
+        }
+        RECT rect = ToRect(bounds);
+        return SUCCEEDED(DrawThemeBackground(m_window.m_windowTheme, m_dc, WP_SMALLCLOSEBUTTON, closeState, &rect,
+                                             nullptr)) ||
+               SUCCEEDED(
+                   DrawThemeBackground(m_window.m_windowTheme, m_dc, WP_CLOSEBUTTON, closeState, &rect, nullptr));
+    }
 
-	SelectObject(dc, old);
-	DeleteObject(pen);
-}
+    void FillRect(const PaintRect& rect, PaintColor color) override {
+        if (HBRUSH brush = m_window.GetCachedBrush(color)) {
+            const RECT fill = ToRect(rect);
+            ::FillRect(m_dc, &fill, brush);
+        }
+    }
 
+    void FillGradient(const PaintRect& rect, PaintColor start, PaintColor end, bool horizontal) override {
+        TRIVERTEX vertices[2] = {
+            {rect.left, rect.top, static_cast<COLOR16>(GetRValue(start) << 8),
+             static_cast<COLOR16>(GetGValue(start) << 8), static_cast<COLOR16>(GetBValue(start) << 8), 0xFFFF},
+            {rect.right, rect.bottom, static_cast<COLOR16>(GetRValue(end) << 8),
+             static_cast<COLOR16>(GetGValue(end) << 8), static_cast<COLOR16>(GetBValue(end) << 8), 0xFFFF},
+        };
+        GRADIENT_RECT gradient{0, 1};
+        GradientFill(m_dc, vertices, 2, &gradient, 1, horizontal ? GRADIENT_FILL_RECT_H : GRADIENT_FILL_RECT_V);
+    }
 
-void TabBandWindow::PaintSurface(HDC dc, const RECT& windowRect) const {
-    if (!dc) {
-        return;
+    void FillPolygon(const PaintPoint* points, size_t count, PaintColor color) override {
+        const std::vector<POINT> polygon = ToPoints(points, count);
+        HRGN region = CreatePolygonRgn(polygon.data(), static_cast<int>(polygon.size()), WINDING);
+        if (!region) {
+            return;
+        }
+        if (HBRUSH brush = m_window.GetCachedBrush(color)) {
+            FillRgn(m_dc, region, brush);
+        }
+        DeleteObject(region);
+    }
+
+    void StrokePolygon(const PaintPoint* points, size_t count, PaintColor color) override {
+        HPEN pen = m_window.GetCachedPen(color);
+        HGDIOBJ hollowBrush = GetStockObject(HOLLOW_BRUSH);
+        if (!pen || !hollowBrush) {
+            return;
+        }
+        const std::vector<POINT> polygon = ToPoints(points, count);
+        SelectObjectGuard penGuard(m_dc, pen);
+        SelectObjectGuard brushGuard(m_dc, hollowBrush);
+        Polygon(m_dc, polygon.data(), static_cast<int>(polygon.size()));
     }
 
-    DrawBackground(dc, windowRect);
+    void FillEllipse(const PaintRect& bounds, PaintColor color) override {
+        HPEN pen = m_window.GetCachedPen(color);
+        HBRUSH brush = m_window.GetCachedBrush(color);
+        if (!pen || !brush) {
+            return;
+        }
+        SelectObjectGuard penGuard(m_dc, pen);
+        SelectObjectGuard brushGuard(m_dc, brush);
+        Ellipse(m_dc, bounds.left, bounds.top, bounds.right, bounds.bottom);
+    }
 
-    HFONT font = GetDefaultFont();
-    HFONT oldFont = static_cast<HFONT>(SelectObject(dc, font));
-    SetBkMode(dc, TRANSPARENT);
+    void DrawLine(PaintPoint from, PaintPoint to, PaintColor color, int width, PaintLineStyle style) override {
+        if (style == PaintLineStyle::kSolid) {
+            if (HPEN pen = m_window.GetCachedPen(color, width)) {
+                SelectObjectGuard penGuard(m_dc, pen);
+                MoveToEx(m_dc, from.x, from.y, nullptr);
+                LineTo(m_dc, to.x, to.y);
+            }
+            return;
+        }
+
+        // Styled pens are rare (dashed and dotted group outlines), so they
+        // are not worth a cache entry.
+        const DWORD baseStyle = style == PaintLineStyle::kDashed ? PS_DASH : PS_DOT;
+        LOGBRUSH brush{};
+        brush.lbStyle = BS_SOLID;
+        brush.lbColor = color;
+        HPEN pen = ExtCreatePen(PS_GEOMETRIC | baseStyle, std::max(1, width), &brush, 0, nullptr);
+        if (!pen) {
+            pen = CreatePen(baseStyle, 1, color);
+        }
+        if (!pen) {
+            pen = CreatePen(PS_SOLID, width, color);
+        }
+        if (!pen) {
+            return;
+        }
+        {
+            SelectObjectGuard penGuard(m_dc, pen);
+            MoveToEx(m_dc, from.x, from.y, nullptr);
+            LineTo(m_dc, to.x, to.y);
+        }
+        DeleteObject(pen);
+    }
+
+    void DrawString(const PaintRect& bounds, std::wstring_view text, PaintColor color,
+                    PaintTextAlign align) override {
+        RECT rect = ToRect(bounds);
+        SetTextColor(m_dc, color);
+        if (align == PaintTextAlign::kCenter) {
+            DrawTextW(m_dc, text.data(), static_cast<int>(text.size()), &rect,
+                      DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
+            return;
+        }
+
+        // The label cache has already measured every tab name in this font,
+        // so the ellipsis is a lookup rather than DT_END_ELLIPSIS measuring
+        // the string again on each paint.
+        if (!m_measurer) {
+            m_measurer.emplace(m_dc);
+        }
+        const TabLabelEllipsis mode =
+            align == PaintTextAlign::kLeftPathEllipsis ? TabLabelEllipsis::kPath : TabLabelEllipsis::kEnd;
+        const std::wstring label = GetTabLabelCache().Fit(*m_measurer, text, bounds.Width(), mode);
+        DrawTextW(m_dc, label.c_str(), static_cast<int>(label.size()), &rect,
+                  DT_SINGLELINE | DT_VCENTER | DT_NOPREFIX);
+    }
+
+    void DrawIcon(const void* icon, const PaintRect& bounds) override {
+        DrawIconEx(m_dc, bounds.left, bounds.top, static_cast<HICON>(const_cast<void*>(icon)), bounds.Width(),
+                   bounds.Height(), 0, nullptr, DI_NORMAL);
+    }
+
+private:
+    static std::vector<POINT> ToPoints(const PaintPoint* points, size_t count) {
+        std::vector<POINT> converted;
+        converted.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            converted.push_back({points[i].x, points[i].y});
+        }
+        return converted;
+    }
+
+    const TabBandWindow& m_window;
+    HDC m_dc;
+    // Created on first use, once the caller has selected its font.
+    std::optional<GdiTabTextMeasurer> m_measurer;
+};
+
+TabBandScene TabBandWindow::BuildTabBandScene(const RECT& windowRect) const {
+    TabBandScene scene;
+    scene.surface = ToPaintRect(windowRect);
+    scene.client = ToPaintRect(m_clientRect);
+    if (m_themePalette.rebarGradientValid) {
+        scene.backgroundTop = m_themePalette.rebarGradientTop;
+        scene.backgroundBottom = m_themePalette.rebarGradientBottom;
+    } else {
+        scene.backgroundTop = m_themePalette.rebarBackground;
+        scene.backgroundBottom = m_themePalette.rebarBackground;
+    }
 
     auto outlines = BuildGroupOutlines();
 
@@ -2235,6 +2276,7 @@ void TabBandWindow::PaintSurface(HDC dc, const RECT& windowRect) const {
     bool previewGroupShifted = false;
     bool previewTabShifted = false;
 
+    scene.items.reserve(m_items.size());
     for (const auto& item : m_items) {
         VisualItem drawItem = item;
         if (previewOffset > 0 && previewTarget) {
@@ -2258,9 +2300,9 @@ void TabBandWindow::PaintSurface(HDC dc, const RECT& windowRect) const {
         }
 
         if (drawItem.data.type == TabViewItemType::kGroupHeader) {
-            DrawGroupHeader(dc, drawItem);
+            scene.items.push_back(BuildGroupHeaderVisual(drawItem));
         } else {
-            DrawTab(dc, drawItem);
+            scene.items.push_back(BuildTabVisual(drawItem));
         }
     }
 
@@ -2277,15 +2319,51 @@ void TabBandWindow::PaintSurface(HDC dc, const RECT& windowRect) const {
         }
     }
 
-	DrawGroupOutlines(dc, outlines);
-	DrawDropIndicator(dc);
-	DrawDragVisual(dc);
+    for (const auto& outline : outlines) {
+        if (!outline.initialized) {
+            continue;
+        }
+        scene.outlines.push_back(
+            {ToPaintRect(outline.bounds), outline.color, ToPaintLineStyle(outline.style), kIslandOutlineThickness});
+    }
+
+    const DropTarget* indicator = nullptr;
+    if (m_drag.dragging && m_drag.target.active && !m_drag.target.outside && m_drag.target.indicatorX >= 0) {
+        indicator = &m_drag.target;
+    } else if (m_externalDrop.active && m_externalDrop.target.active && !m_externalDrop.target.outside &&
+               m_externalDrop.target.indicatorX >= 0) {
+        indicator = &m_externalDrop.target;
+    }
+    if (indicator) {
+        scene.dropIndicatorX = indicator->indicatorX;
+        scene.dropIndicatorColor = m_accentColor;
+    }
+
+    for (const auto& button : m_emptyIslandPlusButtons) {
+        scene.emptyIslandPluses.push_back(ToPaintRect(button.plus));
+    }
+    scene.plusColor = m_themePalette.tabTextValid ? m_themePalette.tabText : RGB(220, 220, 220);
+    return scene;
+}
+
+void TabBandWindow::PaintSurface(HDC dc, const RECT& windowRect) const {
+    if (!dc) {
+        return;
+    }
+
+    HFONT font = GetDefaultFont();
+    HFONT oldFont = static_cast<HFONT>(SelectObject(dc, font));
+    SetBkMode(dc, TRANSPARENT);
 
-	// draw the '+' on empty islands last so it’s on top
-	DrawEmptyIslandPluses(dc);
+    const TabBandScene scene = BuildTabBandScene(windowRect);
+    GdiPainter painter(*this, dc);
+    PaintTabBandContent(scene, painter);
+    DrawDragVisual(dc);
 
-	if (oldFont) SelectObject(dc, oldFont);
+    // draw the '+' on empty islands last so it's on top
+    PaintEmptyIslandPluses(scene, painter);
 
+    if (oldFont) SelectObject(dc, oldFont);
 }
 
 COLORREF TabBandWindow::ResolveTabBackground(const TabViewItem& item) const {
@@ -2364,7 +2442,7 @@ bool TabBandWindow::FindEmptyIslandPlusAt(POINT pt, int* outGroupIndex) const {
 
 
 
-std::vector<TabBandWindow::GroupOutline> TabBandWindow::ComputeGroupOutlines() const {
+std::vector<TabBandWindow::GroupOutline> TabBandWindow::ComputeGroupOutlines(const std::vector<int>* groups) const {
 	struct OutlineKey {
 		int groupIndex;
 		int row;
@@ -2384,6 +2462,10 @@ std::vector<TabBandWindow::GroupOutline> TabBandWindow::ComputeGroupOutlines() c
 
 	std::unordered_map<OutlineKey, GroupOutline, OutlineKeyHasher, OutlineKeyEqual> outlines;
 
+	auto skipGroup = [groups](int groupIndex) {
+		return groups && !std::binary_search(groups->begin(), groups->end(), groupIndex);
+	};
+
         auto accumulate = [&](const VisualItem& item, const RECT& bounds, COLORREF color, bool headerVisible,
                                bool updateColor) {
                 OutlineKey key{ item.data.location.groupIndex, item.row };
@@ -2412,6 +2494,7 @@ std::vector<TabBandWindow::GroupOutline> TabBandWindow::ComputeGroupOutlines() c
 	for (const auto& item : m_items) {
 		if (item.data.type != TabViewItemType::kTab) continue;
 		if (item.data.location.groupIndex < 0)	continue;
+		if (skipGroup(item.data.location.groupIndex)) continue;
 		if (!item.data.headerVisible)		continue;
 
 		RECT rect = item.bounds;
@@ -2431,6 +2514,7 @@ std::vector<TabBandWindow::GroupOutline> TabBandWindow::ComputeGroupOutlines() c
 	for (const auto& item : m_items) {
 		if (item.data.type != TabViewItemType::kGroupHeader) continue;
 		if (item.data.location.groupIndex < 0)	continue;
+		if (skipGroup(item.data.location.groupIndex)) continue;
 		if (!item.data.headerVisible || item.collapsedPlaceholder) continue;
 
 		RECT rect = item.bounds;
@@ -2449,6 +2533,7 @@ std::vector<TabBandWindow::GroupOutline> TabBandWindow::ComputeGroupOutlines() c
 
 	        const int gi = item.data.location.groupIndex;
 	        if (gi < 0) continue;
+	        if (skipGroup(gi)) continue;
 	        if (!item.data.headerVisible || item.collapsedPlaceholder) continue;
 
 	        // NOTE: visibleTabs is a member of TabViewItem, not VisualItem
@@ -2480,16 +2565,7 @@ std::vector<TabBandWindow::GroupOutline> TabBandWindow::ComputeGroupOutlines() c
 			result.emplace_back(entry.second);
 		}
 	}
-    std::sort(result.begin(), result.end(),
-            [](const GroupOutline& a, const GroupOutline& b) {
-                    if (a.bounds.top == b.bounds.top) {
-                            if (a.bounds.left == b.bounds.left) {
-                                    return a.groupIndex < b.groupIndex;
-                            }
-                            return a.bounds.left < b.bounds.left;
-                    }
-                    return a.bounds.top < b.bounds.top;
-            });
+    SortGroupOutlines(result);
     return result;
 }
 
@@ -2510,6 +2586,26 @@ void TabBandWindow::RebuildGroupOutlineCache() const {
     m_groupOutlineCache.valid = true;
 }
 
+void TabBandWindow::UpdateGroupOutlineCache(const std::vector<int>& groups) const {
+    if (!m_groupOutlineCache.valid) {
+        RebuildGroupOutlineCache();
+        return;
+    }
+    if (groups.empty()) {
+        return;
+    }
+
+    auto& outlines = m_groupOutlineCache.outlines;
+    outlines.erase(std::remove_if(outlines.begin(), outlines.end(),
+                                  [&](const GroupOutline& outline) {
+                                      return std::binary_search(groups.begin(), groups.end(), outline.groupIndex);
+                                  }),
+                   outlines.end());
+    std::vector<GroupOutline> updated = ComputeGroupOutlines(&groups);
+    outlines.insert(outlines.end(), updated.begin(), updated.end());
+    SortGroupOutlines(outlines);
+}
+
 bool TabBandWindow::DropPreviewAffectsIndicators(const DropTarget& target) const {
     if (!target.active || target.outside) {
         return false;
@@ -2536,80 +2632,6 @@ void TabBandWindow::OnDropPreviewTargetChanged(const DropTarget& previous, const
     }
 }
 
-void TabBandWindow::DrawGroupOutlines(HDC dc, const std::vector<GroupOutline>& outlines) const {
-    const auto createPenForOutline = [](const GroupOutline& outline) -> HPEN {
-        DWORD baseStyle = PS_SOLID;
-        switch (outline.style) {
-            case TabGroupOutlineStyle::kDashed:
-                baseStyle = PS_DASH;
-                break;
-            case TabGroupOutlineStyle::kDotted:
-                baseStyle = PS_DOT;
-                break;
-            case TabGroupOutlineStyle::kSolid:
-            default:
-                baseStyle = PS_SOLID;
-                break;
-        }
-
-        if (baseStyle == PS_SOLID) {
-            return CreatePen(PS_SOLID, kIslandOutlineThickness, outline.color);
-        }
-
-        LOGBRUSH brush{};
-        brush.lbStyle = BS_SOLID;
-        brush.lbColor = outline.color;
-        HPEN pen = ExtCreatePen(PS_GEOMETRIC | baseStyle, std::max(1, kIslandOutlineThickness), &brush, 0, nullptr);
-        if (pen) {
-            return pen;
-        }
-
-        pen = CreatePen(baseStyle, 1, outline.color);
-        if (pen) {
-            return pen;
-        }
-
-        return CreatePen(PS_SOLID, kIslandOutlineThickness, outline.color);
-    };
-
-    for (const auto& outline : outlines) {
-        if (!outline.initialized) {
-            continue;
-        }
-        RECT rect = outline.bounds;
-        rect.left = std::max(rect.left, m_clientRect.left);
-        rect.top = std::max(rect.top, m_clientRect.top);
-        rect.right = std::min(rect.right + 1, m_clientRect.right);
-        rect.bottom = std::min(rect.bottom, m_clientRect.bottom);
-        if (rect.right <= rect.left || rect.bottom <= rect.top) {
-            continue;
-        }
-
-        HPEN pen = createPenForOutline(outline);
-        if (!pen) {
-            continue;
-        }
-        HPEN oldPen = static_cast<HPEN>(SelectObject(dc, pen));
-
-        const int left = rect.left;
-        const int right = rect.right;
-        const int top = rect.top;
-        const int bottom = rect.bottom - 1;
-
-        MoveToEx(dc, left, top, nullptr);
-        LineTo(dc, right, top);
-        MoveToEx(dc, left, top, nullptr);
-        LineTo(dc, left, bottom);
-        MoveToEx(dc, left, bottom, nullptr);
-        LineTo(dc, right, bottom);
-        MoveToEx(dc, right, top, nullptr);
-        LineTo(dc, right, bottom);
-
-        SelectObject(dc, oldPen);
-        DeleteObject(pen);
-    }
-}
-
 // TabBandWindow.cpp
 LRESULT CALLBACK TabBandWindow::RebarSubclassProc(HWND hwnd, UINT msg,
 	WPARAM wParam, LPARAM lParam, UINT_PTR /*id*/, DWORD_PTR refData) {
@@ -2820,7 +2842,7 @@ void TabBandWindow::ResetThemePalette() {
     m_themePalette.groupTextValid = false;
     m_themePalette.rebarGradientValid = false;
 
-    ClearTextWidthCache();
+    GetTabLabelCache().Clear();
 
     if (m_highContrast) {
         const COLORREF windowColor = GetSysColor(COLOR_WINDOW);
@@ -2970,7 +2992,7 @@ void TabBandWindow::ApplyOptionColorOverrides() {
     } else if (loggedOptionsLoadFailure) {
         loggedOptionsLoadFailure = false;
     }
-    const ShellTabsOptions options = store.Get();
+    const ShellTabsOptions options = *store.Get();
 
     auto pickTextColor = [](COLORREF background) -> COLORREF {
         return ComputeLuminance(background) > 0.55 ? RGB(0, 0, 0) : RGB(255, 255, 255);
@@ -3275,6 +3297,7 @@ void TabBandWindow::UpdateToolbarMetrics() {
         if (!updated) {
             m_closeButtonSizeCached = false;
         }
+        InvalidateHitIndex();
     }
 
     if (dc) {
@@ -3286,6 +3309,7 @@ void TabBandWindow::ResetCloseButtonMetrics() {
     m_closeButtonSizeCached = false;
     m_cachedCloseButtonSize = 0;
     m_cachedCloseButtonDpi = 0;
+    InvalidateHitIndex();
 }
 
 void TabBandWindow::CloseThemeHandles() {
@@ -3853,30 +3877,29 @@ bool TabBandWindow::IsSystemDarkMode() const {
     return IsAppDarkModePreferred();
 }
 
-void TabBandWindow::DrawGroupHeader(HDC dc, const VisualItem& item) const {
-    RECT rect = item.bounds;
-    RECT indicator = rect;
-    indicator.right = std::min(indicator.left + kIslandIndicatorWidth, indicator.right);
-    indicator.top = rect.top;
-    indicator.bottom = rect.bottom;
-    if (indicator.right > indicator.left) {
-        COLORREF indicatorColor = item.data.hasCustomOutline ? item.data.outlineColor : m_accentColor;
-        if (m_highContrast && !item.data.hasCustomOutline) {
-            indicatorColor = GetSysColor(COLOR_WINDOWTEXT);
-        }
-        if (item.data.selected) {
-            indicatorColor = BlendColors(indicatorColor, RGB(0, 0, 0), 0.2);
-        }
-        HBRUSH brush = CreateSolidBrush(indicatorColor);
-        if (brush) {
-            FillRect(dc, &indicator, brush);
-            DeleteObject(brush);
-        }
+TabVisual TabBandWindow::BuildGroupHeaderVisual(const VisualItem& item) const {
+    TabVisual visual;
+    visual.kind = TabVisualKind::kGroupHeader;
+    visual.bounds = ToPaintRect(item.bounds);
+    visual.tabBounds = visual.bounds;
+    visual.selected = item.data.selected;
+    visual.indicator = visual.bounds;
+    visual.indicator.right = std::min(visual.indicator.left + kIslandIndicatorWidth, visual.indicator.right);
+    visual.hasIndicator = !visual.indicator.Empty();
+    COLORREF indicatorColor = item.data.hasCustomOutline ? item.data.outlineColor : m_accentColor;
+    if (m_highContrast && !item.data.hasCustomOutline) {
+        indicatorColor = GetSysColor(COLOR_WINDOWTEXT);
     }
-
-    if (!item.collapsedPlaceholder) {
-        return;
+    if (item.data.selected) {
+        indicatorColor = BlendColors(indicatorColor, RGB(0, 0, 0), 0.2);
     }
+    visual.indicatorColor = indicatorColor;
+    return visual;
+}
+
+void TabBandWindow::DrawGroupHeader(HDC dc, const VisualItem& item) const {
+    GdiPainter painter(*this, dc);
+    PaintTabVisual(BuildGroupHeaderVisual(item), painter);
 }
 
 RECT TabBandWindow::ComputeCloseButtonRect(const VisualItem& item) const {
@@ -3911,65 +3934,6 @@ RECT TabBandWindow::ComputeCloseButtonRect(const VisualItem& item) const {
     return rect;
 }
 
-void TabBandWindow::DrawPinnedGlyph(HDC dc, const RECT& tabRect, int x, COLORREF color) const {
-    const int top = static_cast<int>(tabRect.top);
-    const int bottom = static_cast<int>(tabRect.bottom);
-    const int availableHeight = bottom - top;
-    if (availableHeight <= 4) {
-        return;
-    }
-
-    const int headRadius = std::max(2, std::min(kPinnedGlyphWidth / 2, availableHeight / 5));
-    const int headCenter = top + (availableHeight / 2);
-    int headTop = headCenter - headRadius;
-    int headBottom = headCenter + headRadius;
-    headTop = std::max(headTop, top + 1);
-    headBottom = std::min(headBottom, bottom - 2);
-
-    const int maxStem = std::max(1, bottom - headBottom - 2);
-    int stemLength = std::min(std::max(headRadius, availableHeight / 3), maxStem);
-    if (stemLength < 1) {
-        stemLength = std::min(maxStem, 1);
-    }
-
-    const int baseHalf = std::max(1, headRadius);
-    const int triangleHeight = std::max(1, headRadius / 2);
-    const int tipY = headBottom - 1 + stemLength;
-    const int triangleBottom = std::min(bottom - 1, tipY + triangleHeight);
-
-    HPEN pen = CreatePen(PS_SOLID, 1, color);
-    HBRUSH brush = CreateSolidBrush(color);
-    if (!pen || !brush) {
-        if (pen) {
-            DeleteObject(pen);
-        }
-        if (brush) {
-            DeleteObject(brush);
-        }
-        return;
-    }
-
-    HPEN oldPen = static_cast<HPEN>(SelectObject(dc, pen));
-    HBRUSH oldBrush = static_cast<HBRUSH>(SelectObject(dc, brush));
-
-    Ellipse(dc, x, headTop, x + kPinnedGlyphWidth, headBottom);
-
-    MoveToEx(dc, x + kPinnedGlyphWidth / 2, headBottom - 1, nullptr);
-    LineTo(dc, x + kPinnedGlyphWidth / 2, tipY);
-
-    POINT triangle[3] = {
-        {x + kPinnedGlyphWidth / 2, tipY},
-        {x + kPinnedGlyphWidth / 2 - baseHalf, triangleBottom},
-        {x + kPinnedGlyphWidth / 2 + baseHalf, triangleBottom},
-    };
-    Polygon(dc, triangle, ARRAYSIZE(triangle));
-
-    SelectObject(dc, oldBrush);
-    SelectObject(dc, oldPen);
-    DeleteObject(brush);
-    DeleteObject(pen);
-}
-
 TabBandWindow::TabPaintMetrics TabBandWindow::ComputeTabPaintMetrics(const VisualItem& item) const {
     TabPaintMetrics metrics;
     metrics.itemBounds = item.bounds;
@@ -4000,109 +3964,40 @@ TabBandWindow::TabPaintMetrics TabBandWindow::ComputeTabPaintMetrics(const Visua
     return metrics;
 }
 
-void TabBandWindow::DrawTab(HDC dc, const VisualItem& item) const {
+TabVisual TabBandWindow::BuildTabVisual(const VisualItem& item) const {
     const TabPaintMetrics metrics = ComputeTabPaintMetrics(item);
-    RECT rect = metrics.itemBounds;
-    RECT tabRect = metrics.tabBounds;
+    const RECT& rect = metrics.itemBounds;
     const bool selected = item.data.selected;
     const TabViewItem* indicatorSource = item.hasGroupHeader ? &item.groupHeader : nullptr;
     const bool hasAccent = item.data.hasCustomOutline ||
                            (indicatorSource && indicatorSource->hasCustomOutline);
-    COLORREF accentColor = hasAccent ? ResolveIndicatorColor(indicatorSource, item.data) : m_accentColor;
-
-    int state = selected ? TIS_SELECTED : TIS_NORMAL;
-    COLORREF computedBackground = ResolveTabBackground(item.data);
-    COLORREF textColor = ResolveTabTextColor(selected, computedBackground);
-    bool usedTheme = false;
-    if (m_tabTheme && !m_darkMode) {
-        if (SUCCEEDED(DrawThemeBackground(m_tabTheme, dc, TABP_TABITEM, state, &tabRect, nullptr))) {
-            usedTheme = true;
-            COLORREF themeText = 0;
-            if (SUCCEEDED(GetThemeColor(m_tabTheme, TABP_TABITEM, state, TMT_TEXTCOLOR, &themeText))) {
-                textColor = themeText;
-            } else {
-                textColor = ResolveTabTextColor(selected, computedBackground);
-            }
-        }
-    }
-
-    if (!usedTheme) {
-        COLORREF backgroundColor = computedBackground;
-        textColor = ResolveTabTextColor(selected, backgroundColor);
-        if (m_highContrast) {
-            RECT fillRect = tabRect;
-            fillRect.bottom = std::min(fillRect.bottom, rect.bottom - 1);
-            if (HBRUSH brush = GetCachedBrush(backgroundColor)) {
-                FillRect(dc, &fillRect, brush);
-            }
-            if (HPEN pen = GetCachedPen(GetSysColor(COLOR_WINDOWTEXT))) {
-                SelectObjectGuard penGuard(dc, pen);
-                MoveToEx(dc, fillRect.left, fillRect.top, nullptr);
-                LineTo(dc, fillRect.right, fillRect.top);
-                LineTo(dc, fillRect.right, fillRect.bottom);
-                LineTo(dc, fillRect.left, fillRect.bottom);
-                LineTo(dc, fillRect.left, fillRect.top);
-            }
-        } else {
-            COLORREF baseBorder = m_darkMode
-                                      ? BlendColors(backgroundColor, RGB(255, 255, 255), selected ? 0.1 : 0.05)
-                                      : BlendColors(backgroundColor, RGB(0, 0, 0), selected ? 0.15 : 0.1);
-            COLORREF borderColor = hasAccent
-                                       ? BlendColors(accentColor, RGB(0, 0, 0), selected ? 0.25 : 0.15)
-                                       : baseBorder;
-
-            RECT shapeRect = tabRect;
-            const LONG bottomLimit = rect.bottom - 1;
-            if (shapeRect.bottom > bottomLimit) {
-                shapeRect.bottom = bottomLimit;
-            }
-
-            const int radius = kTabCornerRadius;
-            POINT points[] = {
-                {shapeRect.left, shapeRect.bottom},
-                {shapeRect.left, shapeRect.top + radius},
-                {shapeRect.left + radius, shapeRect.top},
-                {shapeRect.right - radius, shapeRect.top},
-                {shapeRect.right, shapeRect.top + radius},
-                {shapeRect.right, shapeRect.bottom},
-            };
-
-            HRGN region = CreatePolygonRgn(points, ARRAYSIZE(points), WINDING);
-            if (region) {
-                if (HBRUSH brush = GetCachedBrush(backgroundColor)) {
-                    FillRgn(dc, region, brush);
-                }
-                if (HPEN pen = GetCachedPen(borderColor)) {
-                    SelectObjectGuard penGuard(dc, pen);
-                    if (HGDIOBJ hollowBrush = GetStockObject(HOLLOW_BRUSH)) {
-                        SelectObjectGuard brushGuard(dc, hollowBrush);
-                        Polygon(dc, points, ARRAYSIZE(points));
-                    } else {
-                        Polygon(dc, points, ARRAYSIZE(points));
-                    }
-                }
-                DeleteObject(region);
-            }
-
-            COLORREF bottomLineColor = selected ? backgroundColor
-                                                : (m_darkMode ? BlendColors(backgroundColor, RGB(0, 0, 0), 0.25)
-                                                              : GetSysColor(COLOR_3DLIGHT));
-            if (HPEN bottomPen = GetCachedPen(bottomLineColor)) {
-                SelectObjectGuard penGuard(dc, bottomPen);
-                MoveToEx(dc, tabRect.left + 1, rect.bottom - 1, nullptr);
-                LineTo(dc, rect.right - 1, rect.bottom - 1);
-            }
-        }
-
-        computedBackground = backgroundColor;
+    const COLORREF accentColor = hasAccent ? ResolveIndicatorColor(indicatorSource, item.data) : m_accentColor;
+    const COLORREF background = ResolveTabBackground(item.data);
+
+    TabVisual visual;
+    visual.bounds = ToPaintRect(rect);
+    visual.tabBounds = ToPaintRect(metrics.tabBounds);
+    visual.selected = selected;
+    visual.highContrast = m_highContrast;
+    visual.cornerRadius = kTabCornerRadius;
+    visual.background = background;
+    visual.text = ResolveTabTextColor(selected, background);
+    if (m_highContrast) {
+        visual.border = GetSysColor(COLOR_WINDOWTEXT);
+    } else {
+        const COLORREF baseBorder = m_darkMode
+                                        ? BlendColors(background, RGB(255, 255, 255), selected ? 0.1 : 0.05)
+                                        : BlendColors(background, RGB(0, 0, 0), selected ? 0.15 : 0.1);
+        visual.border = hasAccent ? BlendColors(accentColor, RGB(0, 0, 0), selected ? 0.25 : 0.15) : baseBorder;
+        visual.bottomLine = selected ? background
+                                     : (m_darkMode ? BlendColors(background, RGB(0, 0, 0), 0.25)
+                                                   : GetSysColor(COLOR_3DLIGHT));
     }
 
     if (item.indicatorHandle) {
-        RECT indicatorRect = tabRect;
-        indicatorRect.left = rect.left;
-        indicatorRect.right = indicatorRect.left + kIslandIndicatorWidth;
-        indicatorRect.top = rect.top;
-        indicatorRect.bottom = rect.bottom;
+        visual.hasIndicator = true;
+        visual.indicator = {static_cast<int32_t>(rect.left), static_cast<int32_t>(rect.top),
+                            static_cast<int32_t>(rect.left) + kIslandIndicatorWidth, static_cast<int32_t>(rect.bottom)};
         COLORREF indicatorColor = hasAccent ? accentColor
                                             : (m_darkMode ? RGB(120, 120, 180) : GetSysColor(COLOR_HOTLIGHT));
         if (m_highContrast) {
@@ -4111,47 +4006,42 @@ void TabBandWindow::DrawTab(HDC dc, const VisualItem& item) const {
         if (selected) {
             indicatorColor = DarkenColor(indicatorColor, 0.2);
         }
-        if (HBRUSH indicatorBrush = GetCachedBrush(indicatorColor)) {
-            FillRect(dc, &indicatorRect, indicatorBrush);
-        }
+        visual.indicatorColor = indicatorColor;
     }
 
-    RECT closeRect = metrics.closeButton;
+    visual.pinned = item.data.pinned;
+    visual.pinnedGlyphLeft = metrics.textLeft;
+    visual.pinnedGlyphWidth = kPinnedGlyphWidth;
+    visual.textLeft = visual.pinned ? metrics.textLeft + kPinnedGlyphWidth + kPinnedGlyphPadding : metrics.textLeft;
+    visual.textRight = metrics.textRight;
+    visual.name = item.data.name;
 
-    int textLeft = metrics.textLeft;
-    const int textRight = metrics.textRight;
-    if (item.data.pinned) {
-        DrawPinnedGlyph(dc, tabRect, textLeft, textColor);
-        textLeft += kPinnedGlyphWidth + kPinnedGlyphPadding;
-    }
-  
     if (item.icon) {
         const int availableHeight = rect.bottom - rect.top;
         const int iconHeight = std::min(metrics.iconHeight, availableHeight - 4);
-        const int iconWidth = metrics.iconWidth;
         const int iconY = rect.top + (availableHeight - iconHeight) / 2;
-        DrawIconEx(dc, metrics.iconLeft, iconY, item.icon.Get(), iconWidth, iconHeight, 0, nullptr, DI_NORMAL);
-    }
-
-    const bool hasProgress = item.data.progress.visible;
-    if (hasProgress) {
-        DrawTabProgress(dc, item, metrics, computedBackground);
+        visual.icon = item.icon.Get();
+        visual.iconBounds = {metrics.iconLeft, iconY, metrics.iconLeft + metrics.iconWidth, iconY + iconHeight};
     }
 
-    RECT textRect = rect;
-    textRect.left = textLeft;
-    textRect.top += 3;
-    textRect.bottom = hasProgress ? tabRect.bottom - 6 : tabRect.bottom - 3;
-    if (textRect.bottom <= textRect.top) {
-        textRect.bottom = textRect.top + 1;
+    if (item.data.progress.visible) {
+        TabProgressVisual& progress = visual.progress;
+        progress.visible = true;
+        progress.indeterminate = item.data.progress.indeterminate;
+        progress.fraction = item.data.progress.fraction;
+        progress.tickMs = GetTickCount64();
+        RECT outer{};
+        if (ComputeProgressBounds(item, metrics, &outer)) {
+            progress.bounds = ToPaintRect(outer);
+        }
+        progress.track = m_darkMode ? BlendColors(background, RGB(255, 255, 255), 0.2)
+                                    : BlendColors(background, RGB(0, 0, 0), 0.15);
+        progress.border = BlendColors(progress.track, RGB(0, 0, 0), m_darkMode ? 0.5 : 0.35);
+        progress.fillStart = m_progressStartColor;
+        progress.fillEnd = m_progressEndColor;
     }
 
-    SetTextColor(dc, textColor);
-
-    textRect.right = std::max(textLeft + 1, textRight);
-    DrawTextW(dc, item.data.name.c_str(), static_cast<int>(item.data.name.size()), &textRect,
-              DT_SINGLELINE | DT_VCENTER | DT_END_ELLIPSIS | DT_NOPREFIX);
-
+    const RECT& closeRect = metrics.closeButton;
     if (closeRect.right > closeRect.left) {
         const bool closeHot = (m_hotCloseIndex != kInvalidIndex && m_hotCloseIndex == item.index);
         bool closePressed = false;
@@ -4159,152 +4049,37 @@ void TabBandWindow::DrawTab(HDC dc, const VisualItem& item) const {
             closePressed = (m_items[m_drag.closeItemIndex].index == item.index);
         }
 
-        int closeState = CBS_NORMAL;
-        if (closePressed) {
-            closeState = CBS_PUSHED;
-        } else if (closeHot) {
-            closeState = CBS_HOT;
-        }
+        TabCloseVisual& close = visual.close;
+        close.bounds = ToPaintRect(closeRect);
+        close.state = closePressed ? TabCloseState::kPressed
+                                   : (closeHot ? TabCloseState::kHot : TabCloseState::kNormal);
 
-        bool themedClose = false;
-        if (m_windowTheme) {
-            if (SUCCEEDED(DrawThemeBackground(m_windowTheme, dc, WP_SMALLCLOSEBUTTON, closeState, &closeRect, nullptr))) {
-                themedClose = true;
-            } else if (SUCCEEDED(DrawThemeBackground(m_windowTheme, dc, WP_CLOSEBUTTON, closeState, &closeRect, nullptr))) {
-                themedClose = true;
-            }
+        COLORREF closeBackground = closeHot ? RGB(232, 17, 35)
+                                            : (m_darkMode ? BlendColors(background, RGB(255, 255, 255), 0.15)
+                                                          : BlendColors(background, RGB(0, 0, 0), 0.12));
+        if (m_highContrast) {
+            closeBackground = background;
         }
-
-        if (!themedClose) {
-            COLORREF closeBackground = closeHot ? RGB(232, 17, 35)
-                                                : (m_darkMode ? BlendColors(computedBackground, RGB(255, 255, 255), 0.15)
-                                                              : BlendColors(computedBackground, RGB(0, 0, 0), 0.12));
-            if (m_highContrast) {
-                closeBackground = computedBackground;
-            }
-            if (closePressed) {
-                closeBackground = BlendColors(closeBackground, RGB(0, 0, 0), 0.2);
-            }
-
-            if (HBRUSH closeBrush = GetCachedBrush(closeBackground)) {
-                FillRect(dc, &closeRect, closeBrush);
-            }
-
-            COLORREF borderColor = closeHot ? BlendColors(closeBackground, RGB(0, 0, 0), 0.2)
-                                            : BlendColors(closeBackground, RGB(0, 0, 0), m_darkMode ? 0.6 : 0.4);
-            if (m_highContrast) {
-                borderColor = GetSysColor(COLOR_WINDOWTEXT);
-            }
-            if (HPEN borderPen = GetCachedPen(borderColor)) {
-                SelectObjectGuard penGuard(dc, borderPen);
-                MoveToEx(dc, closeRect.left, closeRect.top, nullptr);
-                LineTo(dc, closeRect.right, closeRect.top);
-                LineTo(dc, closeRect.right, closeRect.bottom);
-                LineTo(dc, closeRect.left, closeRect.bottom);
-                LineTo(dc, closeRect.left, closeRect.top);
-            }
-
-            RECT glyphRect = closeRect;
-            COLORREF glyphColor = closeHot ? RGB(255, 255, 255) : ResolveTextColor(closeBackground);
-            if (m_highContrast) {
-                glyphColor = GetSysColor(COLOR_WINDOWTEXT);
-                if (closeHot) {
-                    glyphColor = GetSysColor(COLOR_HIGHLIGHTTEXT);
-                }
-            }
-            COLORREF previousColor = SetTextColor(dc, glyphColor);
-            DrawTextW(dc, L"x", 1, &glyphRect, DT_CENTER | DT_VCENTER | DT_SINGLELINE | DT_NOPREFIX);
-            if (previousColor != CLR_INVALID) {
-                SetTextColor(dc, previousColor);
-            } else {
-                SetTextColor(dc, textColor);
-            }
+        if (closePressed) {
+            closeBackground = BlendColors(closeBackground, RGB(0, 0, 0), 0.2);
         }
-    }
-}
-
-
-void TabBandWindow::DrawTabProgress(HDC dc, const VisualItem& item, const TabPaintMetrics& metrics,
-                                    COLORREF background) const {
-    if (!dc) {
-        return;
-    }
-
-    RECT outer{};
-    if (!ComputeProgressBounds(item, metrics, &outer)) {
-        return;
-    }
+        close.background = closeBackground;
 
-    const COLORREF trackColor = m_darkMode ? BlendColors(background, RGB(255, 255, 255), 0.2)
-                                           : BlendColors(background, RGB(0, 0, 0), 0.15);
-    if (HBRUSH trackBrush = GetCachedBrush(trackColor)) {
-        FillRect(dc, &outer, trackBrush);
+        close.border = closeHot ? BlendColors(closeBackground, RGB(0, 0, 0), 0.2)
+                                : BlendColors(closeBackground, RGB(0, 0, 0), m_darkMode ? 0.6 : 0.4);
+        close.glyph = closeHot ? RGB(255, 255, 255) : ResolveTextColor(closeBackground);
+        if (m_highContrast) {
+            close.border = GetSysColor(COLOR_WINDOWTEXT);
+            close.glyph = GetSysColor(closeHot ? COLOR_HIGHLIGHTTEXT : COLOR_WINDOWTEXT);
+        }
     }
 
-    RECT inner = outer;
-    InflateRect(&inner, -1, -1);
-    if (inner.bottom <= inner.top || inner.right <= inner.left) {
-        return;
-    }
+    return visual;
+}
 
-    if (item.data.progress.indeterminate) {
-        const int width = inner.right - inner.left;
-        if (width <= 0) {
-            return;
-        }
-        const int segment = std::max(width / 4, 12);
-        const ULONGLONG tick = GetTickCount64();
-        const int cycle = width + segment;
-        int offset = static_cast<int>((tick / 30) % cycle) - segment;
-        RECT segmentRect{inner.left + offset, inner.top, inner.left + offset + segment, inner.bottom};
-        if (segmentRect.left < inner.left) {
-            segmentRect.left = inner.left;
-        }
-        if (segmentRect.right > inner.right) {
-            segmentRect.right = inner.right;
-        }
-        if (segmentRect.right > segmentRect.left) {
-            if (HBRUSH brush = GetCachedBrush(m_progressEndColor)) {
-                FillRect(dc, &segmentRect, brush);
-            }
-        }
-    } else {
-        const int width = inner.right - inner.left;
-        if (width <= 0) {
-            return;
-        }
-        int fill = static_cast<int>(std::round(item.data.progress.fraction * width));
-        fill = std::clamp(fill, 0, width);
-        if (fill > 0) {
-            RECT fillRect = inner;
-            fillRect.right = fillRect.left + fill;
-            TRIVERTEX vertex[2];
-            vertex[0].x = fillRect.left;
-            vertex[0].y = fillRect.top;
-            vertex[0].Red = static_cast<COLOR16>(GetRValue(m_progressStartColor) << 8);
-            vertex[0].Green = static_cast<COLOR16>(GetGValue(m_progressStartColor) << 8);
-            vertex[0].Blue = static_cast<COLOR16>(GetBValue(m_progressStartColor) << 8);
-            vertex[0].Alpha = 0xFFFF;
-            vertex[1].x = fillRect.right;
-            vertex[1].y = fillRect.bottom;
-            vertex[1].Red = static_cast<COLOR16>(GetRValue(m_progressEndColor) << 8);
-            vertex[1].Green = static_cast<COLOR16>(GetGValue(m_progressEndColor) << 8);
-            vertex[1].Blue = static_cast<COLOR16>(GetBValue(m_progressEndColor) << 8);
-            vertex[1].Alpha = 0xFFFF;
-            GRADIENT_RECT gradient{0, 1};
-            GradientFill(dc, vertex, 2, &gradient, 1, GRADIENT_FILL_RECT_H);
-        }
-    }
-
-    const COLORREF borderColor = BlendColors(trackColor, RGB(0, 0, 0), m_darkMode ? 0.5 : 0.35);
-    if (HPEN pen = GetCachedPen(borderColor)) {
-        SelectObjectGuard penGuard(dc, pen);
-        MoveToEx(dc, outer.left, outer.top, nullptr);
-        LineTo(dc, outer.right, outer.top);
-        LineTo(dc, outer.right, outer.bottom);
-        LineTo(dc, outer.left, outer.bottom);
-        LineTo(dc, outer.left, outer.top);
-    }
+void TabBandWindow::DrawTab(HDC dc, const VisualItem& item) const {
+    GdiPainter painter(*this, dc);
+    PaintTabVisual(BuildTabVisual(item), painter);
 }
 
 bool TabBandWindow::ComputeProgressBounds(const VisualItem& item, const TabPaintMetrics& metrics, RECT* out) const {
@@ -4346,6 +4121,64 @@ void TabBandWindow::RebuildProgressRectCache() {
     }
 }
 
+void TabBandWindow::UpdateProgressRectCache(const std::vector<RECT>& previous, const LayoutDiffStats& diff,
+                                            const std::vector<int>& groups) {
+    m_progressRects.assign(m_items.size(), RECT{});
+    for (size_t i = 0; i < m_items.size(); ++i) {
+        const auto& item = m_items[i];
+        const size_t oldIndex = i < diff.matchedOldIndices.size() ? diff.matchedOldIndices[i] : kInvalidIndex;
+        if (oldIndex < previous.size() &&
+            !std::binary_search(groups.begin(), groups.end(), item.data.location.groupIndex)) {
+            m_progressRects[i] = previous[oldIndex];
+            continue;
+        }
+        RECT rect{};
+        if (item.data.type == TabViewItemType::kTab &&
+            ComputeProgressBounds(item, ComputeTabPaintMetrics(item), &rect)) {
+            m_progressRects[i] = rect;
+        }
+    }
+}
+
+std::vector<int> TabBandWindow::CollectAffectedGroups(const std::vector<VisualItem>& oldItems,
+                                                      const std::vector<VisualItem>& newItems,
+                                                      const LayoutDiffStats& diff,
+                                                      const TabLayoutUpdate& update) const {
+    std::vector<int> groups(update.groups.begin(), update.groups.end());
+    std::vector<bool> matched(oldItems.size(), false);
+    for (size_t i = 0; i < newItems.size(); ++i) {
+        const VisualItem& item = newItems[i];
+        const size_t oldIndex = i < diff.matchedOldIndices.size() ? diff.matchedOldIndices[i] : kInvalidIndex;
+        if (oldIndex >= oldItems.size()) {
+            groups.push_back(item.data.location.groupIndex);
+            continue;
+        }
+        matched[oldIndex] = true;
+        const VisualItem& old = oldItems[oldIndex];
+        const bool same = EqualRect(&old.bounds, &item.bounds) && old.row == item.row &&
+                          old.indicatorHandle == item.indicatorHandle &&
+                          old.collapsedPlaceholder == item.collapsedPlaceholder &&
+                          old.hasGroupHeader == item.hasGroupHeader &&
+                          old.data.location.groupIndex == item.data.location.groupIndex &&
+                          EquivalentTabViewItem(old.data, item.data) &&
+                          (!item.hasGroupHeader || EquivalentTabViewItem(old.groupHeader, item.groupHeader)) &&
+                          static_cast<bool>(old.icon) == static_cast<bool>(item.icon) &&
+                          old.iconWidth == item.iconWidth && old.iconHeight == item.iconHeight;
+        if (!same) {
+            groups.push_back(old.data.location.groupIndex);
+            groups.push_back(item.data.location.groupIndex);
+        }
+    }
+    for (size_t i = 0; i < oldItems.size(); ++i) {
+        if (!matched[i]) {
+            groups.push_back(oldItems[i].data.location.groupIndex);
+        }
+    }
+    std::sort(groups.begin(), groups.end());
+    groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+    return groups;
+}
+
 void TabBandWindow::RecomputeActiveProgressCount() {
     size_t count = 0;
     for (const auto& item : m_tabData) {
@@ -4423,27 +4256,6 @@ void TabBandWindow::InvalidateActiveProgress() {
     InvalidateProgressForIndices(m_activeProgressIndices);
 }
 
-void TabBandWindow::DrawDropIndicator(HDC dc) const {
-    const DropTarget* indicator = nullptr;
-    if (m_drag.dragging && m_drag.target.active && !m_drag.target.outside && m_drag.target.indicatorX >= 0) {
-        indicator = &m_drag.target;
-    } else if (m_externalDrop.active && m_externalDrop.target.active && !m_externalDrop.target.outside &&
-               m_externalDrop.target.indicatorX >= 0) {
-        indicator = &m_externalDrop.target;
-    }
-
-    if (!indicator) {
-        return;
-    }
-
-    if (HPEN pen = GetCachedPen(m_accentColor, 2)) {
-        SelectObjectGuard penGuard(dc, pen);
-        const int x = indicator->indicatorX;
-        MoveToEx(dc, x, m_clientRect.top + 2, nullptr);
-        LineTo(dc, x, m_clientRect.bottom - 2);
-    }
-}
-
 void TabBandWindow::DrawDragVisual(HDC dc) const {
     if (!m_drag.dragging || !m_drag.origin.hit || !m_drag.hasCurrent) {
         return;
@@ -4795,6 +4607,13 @@ void TabBandWindow::PositionPreviewWindow(const VisualItem& item, const POINT& s
 }
 
 void TabBandWindow::HandlePreviewReady(uint64_t requestId) {
+    for (auto it = m_prefetchRequests.begin(); it != m_prefetchRequests.end(); ++it) {
+        if (it->second == requestId) {
+            m_previewPrefetcher.OnPrefetchFinished(it->first);
+            m_prefetchRequests.erase(it);
+            break;
+        }
+    }
     if (requestId == 0 || requestId != m_previewRequestId) {
         return;
     }
@@ -4816,11 +4635,98 @@ void TabBandWindow::HandlePreviewReady(uint64_t requestId) {
 
 void TabBandWindow::CancelPreviewRequest() {
     if (m_previewRequestId != 0) {
-        PreviewCache::Instance().CancelRequest(m_previewRequestId);
+        // A hover that joined a prefetch leaves it running as a prefetch.
+        const bool prefetching = std::any_of(m_prefetchRequests.begin(), m_prefetchRequests.end(),
+                                             [&](const auto& entry) { return entry.second == m_previewRequestId; });
+        if (!prefetching) {
+            PreviewCache::Instance().CancelRequest(m_previewRequestId);
+        }
         m_previewRequestId = 0;
     }
 }
 
+void TabBandWindow::SyncPreviewPrefetchTabs() {
+    std::vector<PrefetchTab> tabs;
+    tabs.reserve(m_items.size());
+    m_tabIndexByStableId.clear();
+    for (size_t i = 0; i < m_items.size(); ++i) {
+        const auto& item = m_items[i];
+        if (item.data.type != TabViewItemType::kTab || !item.data.pidl || item.stableId == 0) {
+            continue;
+        }
+        m_tabIndexByStableId.emplace(item.stableId, i);
+        PrefetchTab tab;
+        tab.id = item.stableId;
+        tab.bounds = {static_cast<int>(item.bounds.left), static_cast<int>(item.bounds.top),
+                      static_cast<int>(item.bounds.right), static_cast<int>(item.bounds.bottom)};
+        tab.lastActivated = item.data.lastActivatedTick;
+        // The selected tab is captured from its live window on hover.
+        tab.eligible = !item.data.selected;
+        tabs.push_back(tab);
+    }
+    m_previewPrefetcher.SetTabs(std::move(tabs));
+
+    // Prefetches for tabs that closed are no longer worth finishing.
+    for (auto it = m_prefetchRequests.begin(); it != m_prefetchRequests.end();) {
+        if (m_tabIndexByStableId.count(it->first) != 0) {
+            ++it;
+            continue;
+        }
+        if (it->second != m_previewRequestId) {
+            PreviewCache::Instance().CancelRequest(it->second);
+        }
+        m_previewPrefetcher.OnPrefetchFinished(it->first);
+        it = m_prefetchRequests.erase(it);
+    }
+}
+
+void TabBandWindow::UpdatePreviewPrefetch(const POINT& pt) {
+    if (!m_hwnd || m_drag.dragging) {
+        return;
+    }
+    auto& cache = PreviewCache::Instance();
+    // Memory only: a preview on disk is restored by the request's worker.
+    const auto isCached = [&](uint64_t stableId) {
+        const VisualItem* item = FindTabByStableId(stableId);
+        return !item || cache.HasPreviewInMemory(item->data.pidl);
+    };
+    const std::vector<uint64_t> prefetch =
+        m_previewPrefetcher.OnPointerMove(pt.x, pt.y, std::chrono::steady_clock::now(), isCached);
+    for (const uint64_t stableId : prefetch) {
+        const VisualItem* item = FindTabByStableId(stableId);
+        const uint64_t requestId =
+            item ? cache.RequestPreviewAsync(item->data.pidl, kPreviewImageSize, m_hwnd, WM_SHELLTABS_PREVIEW_READY,
+                                             PreviewPriority::kPrefetch)
+                 : 0;
+        if (requestId == 0) {
+            m_previewPrefetcher.OnPrefetchFinished(stableId);
+            continue;
+        }
+        m_prefetchRequests[stableId] = requestId;
+    }
+}
+
+void TabBandWindow::CancelPreviewPrefetch() {
+    for (const uint64_t stableId : m_previewPrefetcher.OnPointerLeave()) {
+        auto it = m_prefetchRequests.find(stableId);
+        // The hovered tab's request is cancelled with the preview window.
+        if (it != m_prefetchRequests.end() && it->second != m_previewRequestId) {
+            PreviewCache::Instance().CancelRequest(it->second);
+        }
+    }
+    m_prefetchRequests.clear();
+}
+
+const TabBandWindow::VisualItem* TabBandWindow::FindTabByStableId(uint64_t stableId) const {
+    auto it = m_tabIndexByStableId.find(stableId);
+    if (it == m_tabIndexByStableId.end() || it->second >= m_items.size()) {
+        return nullptr;
+    }
+    // The items can be cleared without a relayout; never trust a stale slot.
+    const VisualItem& item = m_items[it->second];
+    return item.stableId == stableId && item.data.type == TabViewItemType::kTab ? &item : nullptr;
+}
+
 void TabBandWindow::RefreshProgressState() {
     RefreshProgressState({}, nullptr);
 }
@@ -5188,15 +5094,17 @@ void TabBandWindow::OnShellNotify(WPARAM wParam, LPARAM lParam) {
 }
 
 void TabBandWindow::UpdateCloseButtonHover(const POINT& pt) {
+    const PointerCell cell = PointerCellAt(pt);
+    if (m_closeHoverCell == cell) {
+        return;
+    }
+    m_closeHoverCell = cell;
+
     size_t newIndex = kInvalidIndex;
-    if (PtInRect(&m_clientRect, pt)) {
-        HitInfo hit = HitTest(pt);
-        if (hit.hit && hit.type == HitType::kTab && hit.itemIndex < m_items.size()) {
-            const auto& item = m_items[hit.itemIndex];
-            RECT closeRect = ComputeCloseButtonRect(item);
-            if (closeRect.right > closeRect.left && PtInRect(&closeRect, pt)) {
-                newIndex = item.index;
-            }
+    if (PtInRect(&m_clientRect, pt) && cell.cell.closeButton && cell.cell.item < m_items.size()) {
+        const auto& item = m_items[cell.cell.item];
+        if (item.data.type == TabViewItemType::kTab) {
+            newIndex = item.index;
         }
     }
 
@@ -5222,6 +5130,7 @@ void TabBandWindow::UpdateCloseButtonHover(const POINT& pt) {
 }
 
 void TabBandWindow::ClearCloseButtonHover() {
+    m_closeHoverCell.reset();
     if (m_hotCloseIndex == kInvalidIndex) {
         return;
     }
@@ -5553,6 +5462,7 @@ bool TabBandWindow::HandleMouseUp(const POINT& pt) {
                         outside.active = true;
                         outside.outside = true;
                         ApplyInternalDropTarget(previous, outside);
+                        m_drag.dropCell.reset();
                 }
 
                 CompleteDrop();  // this typically finalizes the move
@@ -5615,6 +5525,7 @@ bool TabBandWindow::HandleMouseMove(const POINT& pt) {
             outside.active = true;
             outside.outside = true;
             ApplyInternalDropTarget(previous, outside);
+            m_drag.dropCell.reset();
         }
         UpdateDragOverlay(pt, screen);
     }
@@ -6038,6 +5949,19 @@ TabBandWindow::DropTarget TabBandWindow::ComputeDropTarget(const POINT& pt, cons
     }
 
     HitInfo hit = HitTest(pt);
+    if (hit.hit && hit.type == HitType::kWhitespace) {
+        // Between two items of a row the drop goes in front of the right-hand
+        // one instead of jumping to the end of the band.
+        const TabHitCell cell = EnsureHitIndex().CellAt(pt.x, pt.y);
+        if (cell.between && cell.gap < m_items.size()) {
+            const auto& next = m_items[cell.gap];
+            hit.itemIndex = cell.gap;
+            hit.type = next.data.type == TabViewItemType::kTab ? HitType::kTab : HitType::kGroupHeader;
+            hit.location = next.data.location;
+            hit.before = true;
+            hit.after = false;
+        }
+    }
     if (!hit.hit || hit.type == HitType::kWhitespace || hit.type == HitType::kNewTab) {
         auto trailingIndicatorX = [&]() -> LONG {
             if (m_newTabBounds.right > m_newTabBounds.left) {
@@ -6077,8 +6001,7 @@ TabBandWindow::DropTarget TabBandWindow::ComputeDropTarget(const POINT& pt, cons
     }
 
     const VisualItem& visual = m_items[hit.itemIndex];
-    const int midX = (visual.bounds.left + visual.bounds.right) / 2;
-    const bool leftSide = pt.x < midX;
+    const bool leftSide = hit.before;
 
     if (origin.type == HitType::kGroupHeader) {
         target.group = true;
@@ -6374,6 +6297,11 @@ void TabBandWindow::ApplyExternalDropTarget(const DropTarget& previous, const Dr
 }
 
 void TabBandWindow::UpdateDropTarget(const POINT& pt) {
+    const PointerCell cell = PointerCellAt(pt);
+    if (m_drag.dropCell == cell) {
+        return;
+    }
+    m_drag.dropCell = cell;
     DropTarget previous = m_drag.target;
     DropTarget target = ComputeDropTarget(pt, m_drag.origin);
     ApplyInternalDropTarget(previous, target);
@@ -6651,22 +6579,17 @@ TabBandWindow::HitInfo TabBandWindow::HitTest(const POINT& pt) const {
         return info;
     }
 
-    for (size_t i = 0; i < m_items.size(); ++i) {
-        const auto& item = m_items[i];
-        if (PtInRect(&item.bounds, pt)) {
-            info.hit = true;
-            info.itemIndex = i;
-            info.type = (item.data.type == TabViewItemType::kTab) ? HitType::kTab : HitType::kGroupHeader;
-            info.location = item.data.location;
-            const int midX = (item.bounds.left + item.bounds.right) / 2;
-            info.before = pt.x < midX;
-            info.after = !info.before;
-            RECT closeRect = ComputeCloseButtonRect(item);
-            if (closeRect.right > closeRect.left && PtInRect(&closeRect, pt)) {
-                info.closeButton = true;
-            }
-            return info;
-        }
+    const TabHitCell cell = EnsureHitIndex().CellAt(pt.x, pt.y);
+    if (cell.item < m_items.size()) {
+        const auto& item = m_items[cell.item];
+        info.hit = true;
+        info.itemIndex = cell.item;
+        info.type = (item.data.type == TabViewItemType::kTab) ? HitType::kTab : HitType::kGroupHeader;
+        info.location = item.data.location;
+        info.before = cell.before;
+        info.after = !info.before;
+        info.closeButton = cell.closeButton;
+        return info;
     }
 
     if (m_newTabBounds.right > m_newTabBounds.left && PtInRect(&m_newTabBounds, pt)) {
@@ -6690,6 +6613,38 @@ TabBandWindow::HitInfo TabBandWindow::HitTest(const POINT& pt) const {
     return info;
 }
 
+const TabHitIndex& TabBandWindow::EnsureHitIndex() const {
+    if (m_hitIndexValid) {
+        return m_hitIndex;
+    }
+    std::vector<TabHitEntry> entries;
+    entries.reserve(m_items.size());
+    for (const auto& item : m_items) {
+        TabHitEntry& entry = entries.emplace_back();
+        entry.bounds = ToPaintRect(item.bounds);
+        entry.closeButton = ToPaintRect(ComputeCloseButtonRect(item));
+    }
+    m_hitIndex.Build(entries);
+    m_hitIndexValid = true;
+    return m_hitIndex;
+}
+
+void TabBandWindow::InvalidateHitIndex() {
+    m_hitIndexValid = false;
+}
+
+TabBandWindow::PointerCell TabBandWindow::PointerCellAt(const POINT& pt) const {
+    PointerCell result;
+    const TabHitIndex& index = EnsureHitIndex();
+    result.generation = index.Generation();
+    result.inside =
+        pt.x >= m_clientRect.left && pt.x <= m_clientRect.right && pt.y >= m_clientRect.top && pt.y <= m_clientRect.bottom;
+    if (result.inside) {
+        result.cell = index.CellAt(pt.x, pt.y);
+    }
+    return result;
+}
+
 void TabBandWindow::ShowContextMenu(const POINT& screenPt) {
     if (!m_owner) {
         return;
@@ -7058,6 +7013,9 @@ LRESULT CALLBACK TabBandWindow::WndProc(HWND hwnd, UINT message, WPARAM wParam,
     auto dispatch = [&]() -> LRESULT {
         const UINT optionsChangedMessage = GetOptionsChangedMessage();
         if (optionsChangedMessage != 0 && message == optionsChangedMessage) {
+            if (self->m_owner) {
+                self->m_owner->OnOptionsChanged(static_cast<uint64_t>(wParam), static_cast<DWORD>(lParam));
+            }
             self->RefreshTheme();
             InvalidateRect(hwnd, nullptr, TRUE);
             return 0;
@@ -7158,6 +7116,7 @@ LRESULT CALLBACK TabBandWindow::WndProc(HWND hwnd, UINT message, WPARAM wParam,
             case WM_MOUSEMOVE: {
                 POINT pt{GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam)};
                 self->EnsureMouseTracking(pt);
+                self->UpdatePreviewPrefetch(pt);
                 self->UpdateCloseButtonHover(pt);
                 if (self->HandleMouseMove(pt)) {
                     return 0;
@@ -7180,6 +7139,7 @@ LRESULT CALLBACK TabBandWindow::WndProc(HWND hwnd, UINT message, WPARAM wParam,
             }
             case WM_MOUSELEAVE: {
                 self->m_mouseTracking = false;
+                self->CancelPreviewPrefetch();
                 self->HidePreviewWindow(false);
                 self->ClearCloseButtonHover();
                 return 0;
@@ -0,0 +1,160 @@
+#include "TabHitIndex.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace shelltabs {
+namespace {
+
+bool Contains(const PaintRect& rect, int32_t x, int32_t y) noexcept {
+    return x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+}
+
+}  // namespace
+
+void TabHitIndex::Build(const std::vector<TabHitEntry>& entries) {
+    m_entries = entries;
+    m_intervals.clear();
+    m_rows.clear();
+    m_maxRowHeight = 0;
+    ++m_generation;
+
+    std::vector<size_t> order;
+    order.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (!entries[i].bounds.Empty()) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+        const PaintRect& a = entries[left].bounds;
+        const PaintRect& b = entries[right].bounds;
+        if (a.top != b.top) {
+            return a.top < b.top;
+        }
+        if (a.bottom != b.bottom) {
+            return a.bottom < b.bottom;
+        }
+        if (a.left != b.left) {
+            return a.left < b.left;
+        }
+        return left < right;
+    });
+
+    m_intervals.reserve(order.size());
+    for (size_t index : order) {
+        const PaintRect& bounds = entries[index].bounds;
+        if (m_rows.empty() || m_rows.back().top != bounds.top || m_rows.back().bottom != bounds.bottom) {
+            Row& row = m_rows.emplace_back();
+            row.top = bounds.top;
+            row.bottom = bounds.bottom;
+            row.first = m_intervals.size();
+            row.end = row.first;
+            m_maxRowHeight = std::max(m_maxRowHeight, bounds.Height());
+        }
+        Row& row = m_rows.back();
+        m_intervals.push_back({bounds.left, bounds.right, index});
+        ++row.end;
+        row.maxWidth = std::max(row.maxWidth, bounds.Width());
+    }
+}
+
+void TabHitIndex::Clear() {
+    m_entries.clear();
+    m_intervals.clear();
+    m_rows.clear();
+    m_maxRowHeight = 0;
+    ++m_generation;
+}
+
+const TabHitIndex::Row* TabHitIndex::RowAt(int32_t y) const noexcept {
+    auto it = std::upper_bound(m_rows.begin(), m_rows.end(), y,
+                               [](int32_t value, const Row& row) { return value < row.top; });
+    const Row* found = nullptr;
+    // Rows sorted by top; only those starting within one row height above y
+    // can reach it.
+    while (it != m_rows.begin()) {
+        --it;
+        if (static_cast<int64_t>(it->top) <= static_cast<int64_t>(y) - m_maxRowHeight) {
+            break;
+        }
+        if (y < it->bottom) {
+            found = &*it;
+        }
+    }
+    return found;
+}
+
+size_t TabHitIndex::ItemInRow(const Row& row, int32_t x, int32_t y) const noexcept {
+    if (y < row.top || y >= row.bottom) {
+        return kNoTabHit;
+    }
+    const auto begin = m_intervals.begin() + static_cast<ptrdiff_t>(row.first);
+    auto it = std::upper_bound(begin, m_intervals.begin() + static_cast<ptrdiff_t>(row.end), x,
+                               [](int32_t value, const Interval& interval) { return value < interval.left; });
+    size_t best = kNoTabHit;
+    while (it != begin) {
+        --it;
+        if (static_cast<int64_t>(it->left) <= static_cast<int64_t>(x) - row.maxWidth) {
+            break;
+        }
+        if (x < it->right) {
+            best = std::min(best, it->item);
+        }
+    }
+    return best;
+}
+
+size_t TabHitIndex::ItemAt(int32_t x, int32_t y) const noexcept {
+    auto it = std::upper_bound(m_rows.begin(), m_rows.end(), y,
+                               [](int32_t value, const Row& row) { return value < row.top; });
+    size_t best = kNoTabHit;
+    while (it != m_rows.begin()) {
+        --it;
+        if (static_cast<int64_t>(it->top) <= static_cast<int64_t>(y) - m_maxRowHeight) {
+            break;
+        }
+        best = std::min(best, ItemInRow(*it, x, y));
+    }
+    return best;
+}
+
+size_t TabHitIndex::CloseButtonAt(int32_t x, int32_t y) const noexcept {
+    const size_t item = ItemAt(x, y);
+    if (item == kNoTabHit) {
+        return kNoTabHit;
+    }
+    const PaintRect& close = m_entries[item].closeButton;
+    return !close.Empty() && Contains(close, x, y) ? item : kNoTabHit;
+}
+
+TabHitCell TabHitIndex::CellAt(int32_t x, int32_t y) const noexcept {
+    TabHitCell cell;
+    cell.item = ItemAt(x, y);
+    if (cell.item != kNoTabHit) {
+        const TabHitEntry& entry = m_entries[cell.item];
+        const int32_t midX = (entry.bounds.left + entry.bounds.right) / 2;
+        cell.before = x < midX;
+        cell.closeButton = !entry.closeButton.Empty() && Contains(entry.closeButton, x, y);
+        cell.gap = cell.before ? cell.item : cell.item + 1;
+        return cell;
+    }
+
+    const Row* row = RowAt(y);
+    if (!row) {
+        return cell;
+    }
+    const auto begin = m_intervals.begin() + static_cast<ptrdiff_t>(row->first);
+    const auto end = m_intervals.begin() + static_cast<ptrdiff_t>(row->end);
+    auto next = std::upper_bound(begin, end, x,
+                                 [](int32_t value, const Interval& interval) { return value < interval.left; });
+    if (next == end) {
+        cell.gap = std::prev(end)->item + 1;
+        return cell;
+    }
+    cell.gap = next->item;
+    cell.between = next != begin;
+    return cell;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,244 @@
+#include "TabLabelCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace shelltabs {
+namespace {
+
+size_t CombineHash(size_t seed, size_t value) noexcept {
+    return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+}
+
+size_t HashLabel(const TabLabelFont& font, std::wstring_view text) noexcept {
+    size_t hash = std::hash<std::wstring_view>{}(text);
+    hash = CombineHash(hash, static_cast<size_t>(font.faceHash));
+    hash = CombineHash(hash, static_cast<size_t>(static_cast<uint32_t>(font.height)));
+    hash = CombineHash(hash, static_cast<size_t>(static_cast<uint32_t>(font.aveCharWidth)));
+    hash = CombineHash(hash, static_cast<size_t>(static_cast<uint32_t>(font.weight)));
+    hash = CombineHash(hash, (static_cast<size_t>(font.italic) << 16) |
+                                 (static_cast<size_t>(font.pitchAndFamily) << 8) | font.charSet);
+    return CombineHash(hash, font.dpi);
+}
+
+wchar_t FoldFaceCase(wchar_t ch) noexcept {
+    return ch >= L'A' && ch <= L'Z' ? static_cast<wchar_t>(ch - L'A' + L'a') : ch;
+}
+
+bool IsSeparator(wchar_t ch) noexcept { return ch == L'\\' || ch == L'/'; }
+
+bool IsHighSurrogate(wchar_t ch) noexcept { return ch >= 0xD800 && ch <= 0xDBFF; }
+
+// Width of text[begin, end) from the extents of the whole text.
+int32_t SpanWidth(const int32_t* extents, size_t begin, size_t end) noexcept {
+    const int32_t before = begin == 0 ? 0 : extents[begin - 1];
+    const int32_t through = end == 0 ? 0 : extents[end - 1];
+    return through - before;
+}
+
+// The longest prefix of text[begin, end) no wider than available, in units,
+// not ending inside a surrogate pair.
+size_t FittingPrefix(std::wstring_view text, const int32_t* extents, size_t begin, size_t end, int32_t available) {
+    if (available <= 0) {
+        return 0;
+    }
+    const int32_t base = begin == 0 ? 0 : extents[begin - 1];
+    const int32_t* first = extents + begin;
+    const int32_t* last = extents + end;
+    size_t length = static_cast<size_t>(std::upper_bound(first, last, base + available) - first);
+    if (length > 0 && IsHighSurrogate(text[begin + length - 1])) {
+        --length;
+    }
+    return length;
+}
+
+std::wstring EndEllipsis(std::wstring_view text, const int32_t* extents, size_t begin, size_t end,
+                         int32_t ellipsisWidth, int32_t maxWidth) {
+    const size_t length = FittingPrefix(text, extents, begin, end, maxWidth - ellipsisWidth);
+    std::wstring label;
+    label.reserve(length + kTabLabelEllipsis.size());
+    label.append(text.substr(begin, length));
+    label.append(kTabLabelEllipsis);
+    return label;
+}
+
+}  // namespace
+
+uint64_t HashTabLabelFace(std::wstring_view face) noexcept {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const wchar_t ch : face) {
+        hash ^= static_cast<uint64_t>(FoldFaceCase(ch));
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+bool IsPathLabel(std::wstring_view text) noexcept {
+    const size_t separator = text.find_first_of(L"\\/");
+    return separator != std::wstring_view::npos && text.find_first_not_of(L"\\/", separator) != std::wstring_view::npos;
+}
+
+std::wstring FitTabLabel(std::wstring_view text, const int32_t* extents, int32_t ellipsisWidth, int32_t maxWidth,
+                         TabLabelEllipsis mode) {
+    if (text.empty() || extents[text.size() - 1] <= maxWidth) {
+        return std::wstring(text);
+    }
+    if (mode == TabLabelEllipsis::kEnd) {
+        return EndEllipsis(text, extents, 0, text.size(), ellipsisWidth, maxWidth);
+    }
+
+    // The leaf runs from the last separator that is not trailing; a trailing
+    // separator stays with it.
+    size_t leafEnd = text.size();
+    while (leafEnd > 0 && IsSeparator(text[leafEnd - 1])) {
+        --leafEnd;
+    }
+    size_t separator = leafEnd;
+    while (separator > 0 && !IsSeparator(text[separator - 1])) {
+        --separator;
+    }
+    if (separator <= 1) {
+        return EndEllipsis(text, extents, 0, text.size(), ellipsisWidth, maxWidth);
+    }
+    --separator;
+
+    const int32_t tailWidth = SpanWidth(extents, separator, text.size());
+    if (tailWidth + ellipsisWidth <= maxWidth) {
+        const size_t head = FittingPrefix(text, extents, 0, separator, maxWidth - ellipsisWidth - tailWidth);
+        std::wstring label;
+        label.reserve(head + kTabLabelEllipsis.size() + text.size() - separator);
+        label.append(text.substr(0, head));
+        label.append(kTabLabelEllipsis);
+        label.append(text.substr(separator));
+        return label;
+    }
+
+    const size_t leafBegin = separator + 1;
+    if (SpanWidth(extents, leafBegin, text.size()) <= maxWidth) {
+        return std::wstring(text.substr(leafBegin));
+    }
+    return EndEllipsis(text, extents, leafBegin, text.size(), ellipsisWidth, maxWidth);
+}
+
+TabLabelCache::TabLabelCache(size_t capacity) : m_capacity(std::max<size_t>(1, capacity)) {}
+
+TabLabelCache::EntryList::iterator TabLabelCache::FindLocked(const TabLabelFont& font, size_t hash,
+                                                             std::wstring_view text) {
+    auto [first, last] = m_lookup.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        const Entry& entry = *it->second;
+        if (entry.font == font && entry.text == text) {
+            return it->second;
+        }
+    }
+    return m_entries.end();
+}
+
+TabLabelCache::EntryList::iterator TabLabelCache::Acquire(TabTextMeasurer& measurer, std::wstring_view text,
+                                                          std::unique_lock<std::mutex>& lock) {
+    const TabLabelFont font = measurer.Font();
+    const size_t hash = HashLabel(font, text);
+    auto it = FindLocked(font, hash, text);
+    if (it != m_entries.end()) {
+        ++m_stats.hits;
+        m_entries.splice(m_entries.begin(), m_entries, it);
+        return it;
+    }
+    ++m_stats.misses;
+
+    // Measuring goes to the font rasteriser; keep other windows' bands out
+    // of the wait and let a racing measurement win.
+    lock.unlock();
+    std::vector<int32_t> extents(text.size());
+    const bool measured = text.empty() || measurer.MeasureExtents(text, extents.data());
+    lock.lock();
+    if (!measured) {
+        return m_entries.end();
+    }
+    m_stats.measuredUnits += text.size();
+
+    it = FindLocked(font, hash, text);
+    if (it != m_entries.end()) {
+        m_entries.splice(m_entries.begin(), m_entries, it);
+        return it;
+    }
+
+    Entry& entry = m_entries.emplace_front();
+    entry.font = font;
+    entry.text.assign(text);
+    entry.hash = hash;
+    entry.extents = std::move(extents);
+    m_lookup.emplace(hash, m_entries.begin());
+
+    while (m_entries.size() > m_capacity) {
+        const auto oldest = std::prev(m_entries.end());
+        auto [first, last] = m_lookup.equal_range(oldest->hash);
+        for (auto lookup = first; lookup != last; ++lookup) {
+            if (lookup->second == oldest) {
+                m_lookup.erase(lookup);
+                break;
+            }
+        }
+        m_entries.pop_back();
+    }
+    return m_entries.begin();
+}
+
+int32_t TabLabelCache::Width(TabTextMeasurer& measurer, std::wstring_view text) {
+    std::unique_lock lock(m_mutex);
+    auto it = Acquire(measurer, text, lock);
+    if (it == m_entries.end() || it->extents.empty()) {
+        return 0;
+    }
+    return it->extents.back();
+}
+
+std::wstring TabLabelCache::Fit(TabTextMeasurer& measurer, std::wstring_view text, int32_t maxWidth,
+                                TabLabelEllipsis mode) {
+    std::unique_lock lock(m_mutex);
+    auto ellipsis = Acquire(measurer, kTabLabelEllipsis, lock);
+    const int32_t ellipsisWidth = ellipsis != m_entries.end() ? ellipsis->extents.back() : 0;
+
+    auto it = Acquire(measurer, text, lock);
+    if (it == m_entries.end()) {
+        return std::wstring(text);
+    }
+
+    auto& fits = it->fits;
+    for (auto fit = fits.begin(); fit != fits.end(); ++fit) {
+        if (fit->maxWidth == maxWidth && fit->mode == mode) {
+            ++m_stats.fitHits;
+            std::rotate(fits.begin(), fit, fit + 1);
+            return fits.front().label;
+        }
+    }
+    ++m_stats.fitMisses;
+
+    Fitted fitted{maxWidth, mode, FitTabLabel(it->text, it->extents.data(), ellipsisWidth, maxWidth, mode)};
+    if (fits.size() >= kFitsPerLabel) {
+        fits.pop_back();
+    }
+    fits.insert(fits.begin(), std::move(fitted));
+    return fits.front().label;
+}
+
+void TabLabelCache::Clear() {
+    std::scoped_lock lock(m_mutex);
+    m_entries.clear();
+    m_lookup.clear();
+}
+
+TabLabelCacheStats TabLabelCache::Stats() const {
+    std::scoped_lock lock(m_mutex);
+    TabLabelCacheStats stats = m_stats;
+    stats.labels = m_entries.size();
+    return stats;
+}
+
+TabLabelCache& GetTabLabelCache() {
+    static TabLabelCache cache;
+    return cache;
+}
+
+}  // namespace shelltabs
@@ -0,0 +1,90 @@
+#include "TabLayoutDiff.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace shelltabs {
+
+size_t TabLayoutDiffer::Bucket(uint64_t key) const noexcept {
+    // Stable ids are hashes already, but a collision-prone caller should not
+    // pile everything into one chain.
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDull;
+    key ^= key >> 33;
+    return static_cast<size_t>(key) & (m_buckets.size() - 1);
+}
+
+void TabLayoutDiffer::Begin(size_t newCount) {
+    const size_t oldCount = m_oldKeys.size();
+    m_buckets.clear();
+    if (oldCount > 0) {
+        size_t bucketCount = 16;
+        while (bucketCount < oldCount * 2) {
+            bucketCount *= 2;
+        }
+        m_buckets.assign(bucketCount, kNoTabLayoutMatch);
+    }
+    m_chain.resize(oldCount);
+    // Walking down keeps each chain in ascending old index order.
+    for (size_t i = oldCount; i-- > 0;) {
+        const size_t bucket = Bucket(m_oldKeys[i]);
+        m_chain[i] = m_buckets[bucket];
+        m_buckets[bucket] = i;
+    }
+
+    m_consumed.assign(oldCount, 0);
+    m_result.matchedOld.assign(newCount, kNoTabLayoutMatch);
+    m_result.ops.clear();
+    m_result.inserted = 0;
+    m_result.removed = 0;
+    m_result.moved = 0;
+}
+
+void TabLayoutDiffer::Finish() {
+    const std::vector<size_t>& matched = m_result.matchedOld;
+    for (size_t oldIndex = 0; oldIndex < m_consumed.size(); ++oldIndex) {
+        if (!m_consumed[oldIndex]) {
+            m_result.ops.push_back({TabLayoutDiffOpKind::kRemove, oldIndex, kNoTabLayoutMatch});
+            ++m_result.removed;
+        }
+    }
+
+    // Patience sorting over the matched old indices in new order. m_tails[k]
+    // is the new index ending the best run of length k + 1 found so far.
+    m_tails.clear();
+    m_previous.assign(matched.size(), kNoTabLayoutMatch);
+    for (size_t newIndex = 0; newIndex < matched.size(); ++newIndex) {
+        const size_t oldIndex = matched[newIndex];
+        if (oldIndex == kNoTabLayoutMatch) {
+            continue;
+        }
+        auto it = std::lower_bound(m_tails.begin(), m_tails.end(), oldIndex,
+                                   [&](size_t tail, size_t value) { return matched[tail] < value; });
+        if (it != m_tails.begin()) {
+            m_previous[newIndex] = *std::prev(it);
+        }
+        if (it == m_tails.end()) {
+            m_tails.push_back(newIndex);
+        } else {
+            *it = newIndex;
+        }
+    }
+
+    m_stays.assign(matched.size(), 0);
+    for (size_t newIndex = m_tails.empty() ? kNoTabLayoutMatch : m_tails.back(); newIndex != kNoTabLayoutMatch;
+         newIndex = m_previous[newIndex]) {
+        m_stays[newIndex] = 1;
+    }
+
+    for (size_t newIndex = 0; newIndex < matched.size(); ++newIndex) {
+        if (matched[newIndex] == kNoTabLayoutMatch) {
+            m_result.ops.push_back({TabLayoutDiffOpKind::kInsert, kNoTabLayoutMatch, newIndex});
+            ++m_result.inserted;
+        } else if (!m_stays[newIndex]) {
+            m_result.ops.push_back({TabLayoutDiffOpKind::kMove, matched[newIndex], newIndex});
+            ++m_result.moved;
+        }
+    }
+}
+
+}  // namespace shelltabs
@@ -84,7 +84,7 @@ std::string WideToUtf8(std::wstring_view wide) {
     return result;
 }
 
-bool ReadUtf8File(const std::wstring& path, std::wstring* contents, bool* fileExists) {
+bool ReadFileBytes(const std::wstring& path, std::string* contents, bool* fileExists) {
     if (!contents || path.empty()) {
         return false;
     }
@@ -117,15 +117,50 @@ bool ReadUtf8File(const std::wstring& path, std::wstring* contents, bool* fileEx
         return true;
     }
 
-    std::string buffer(static_cast<size_t>(size.QuadPart), '\0');
+    contents->resize(static_cast<size_t>(size.QuadPart));
     DWORD bytesRead = 0;
-    if (!buffer.empty() &&
-        !ReadFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &bytesRead, nullptr)) {
+    if (!ReadFile(file, contents->data(), static_cast<DWORD>(contents->size()), &bytesRead, nullptr)) {
         CloseHandle(file);
+        contents->clear();
         return false;
     }
     CloseHandle(file);
-    buffer.resize(bytesRead);
+    contents->resize(bytesRead);
+    return true;
+}
+
+bool WriteFileBytes(const std::wstring& path, std::string_view contents) {
+    if (path.empty()) {
+        return false;
+    }
+
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    DWORD bytesWritten = 0;
+    BOOL result = TRUE;
+    if (!contents.empty()) {
+        result = WriteFile(file, contents.data(), static_cast<DWORD>(contents.size()), &bytesWritten, nullptr);
+        if (result && bytesWritten != contents.size()) {
+            result = FALSE;
+        }
+    }
+    CloseHandle(file);
+    return result != FALSE;
+}
+
+bool ReadUtf8File(const std::wstring& path, std::wstring* contents, bool* fileExists) {
+    if (!contents) {
+        return false;
+    }
+
+    contents->clear();
+    std::string buffer;
+    if (!ReadFileBytes(path, &buffer, fileExists)) {
+        return false;
+    }
 
     if (buffer.empty()) {
         return true;
@@ -150,21 +185,7 @@ bool WriteUtf8File(const std::wstring& path, std::wstring_view contents) {
         return false;
     }
 
-    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (file == INVALID_HANDLE_VALUE) {
-        return false;
-    }
-
-    DWORD bytesWritten = 0;
-    BOOL result = TRUE;
-    if (!utf8.empty()) {
-        result = WriteFile(file, utf8.data(), static_cast<DWORD>(utf8.size()), &bytesWritten, nullptr);
-        if (result && bytesWritten != utf8.size()) {
-            result = FALSE;
-        }
-    }
-    CloseHandle(file);
-    return result != FALSE;
+    return WriteFileBytes(path, utf8);
 }
 
 void LogUnhandledException(const wchar_t* context, const wchar_t* details) {
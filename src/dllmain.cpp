@@ -12,6 +12,7 @@
 
 #include "ClassFactory.h"
 #include "ComUtils.h"
+#include "ConfigurationMonitor.h"
 // #include "FolderBackgroundHooks.h" // TODO: Implement folder background hooks
 #include "Guids.h"
 #include "Logging.h"
@@ -1004,6 +1005,7 @@ BOOL APIENTRY DllMain(HMODULE module, DWORD reason, LPVOID) {
         }
     } else if (reason == DLL_PROCESS_DETACH) {
         LogMessage(LogLevel::Info, L"DllMain PROCESS_DETACH for %ls", CurrentProcessImageName().c_str());
+        AbandonConfigurationMonitor();
         ExplorerRibbonHook::Shutdown();
         ShutdownCompositionIntercept();
         ShutdownThemeHooks();
@@ -1013,7 +1015,13 @@ BOOL APIENTRY DllMain(HMODULE module, DWORD reason, LPVOID) {
 }
 
 STDAPI DllCanUnloadNow(void) {
-    return ModuleCanUnload() ? S_OK : S_FALSE;
+    if (!ModuleCanUnload()) {
+        return S_FALSE;
+    }
+    // The monitor threads must be joined before COM frees the module, and
+    // DllMain cannot join them under the loader lock.
+    StopConfigurationMonitor();
+    return S_OK;
 }
 
 STDAPI DllGetClassObject(REFCLSID rclsid, REFIID riid, void** object) {
@@ -0,0 +1,450 @@
+#include "BackgroundImageStore.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+using shelltabs::BackgroundImageStore;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+constexpr uint64_t kNow = 1'700'000'000;
+constexpr uint64_t kDay = 24 * 60 * 60;
+
+// Holds a scratch directory with a "store" folder for the store and a
+// "pictures" folder for images to import; removed when the test finishes.
+class TempDirectory {
+public:
+    explicit TempDirectory(const char* name) {
+        const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        m_path = std::filesystem::temp_directory_path() /
+                 (std::string("shelltabs-") + name + "-" + std::to_string(stamp));
+        std::filesystem::create_directories(m_path / "pictures");
+    }
+    ~TempDirectory() {
+        std::error_code ignored;
+        std::filesystem::remove_all(m_path, ignored);
+    }
+
+    std::filesystem::path Store() const { return m_path / "store"; }
+
+    std::filesystem::path WritePicture(const std::string& name, const std::string& contents) const {
+        const std::filesystem::path path = m_path / "pictures" / name;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        return path;
+    }
+
+private:
+    std::filesystem::path m_path;
+};
+
+std::string MakeImageBytes(size_t size, uint32_t seed) {
+    std::string bytes(size, '\0');
+    uint32_t state = seed * 2654435761u + 1u;
+    for (char& byte : bytes) {
+        state = state * 1664525u + 1013904223u;
+        byte = static_cast<char>(state >> 24);
+    }
+    return bytes;
+}
+
+size_t CountImageFiles(const std::filesystem::path& directory) {
+    size_t count = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        const auto name = entry.path().filename();
+        if (name != "backgrounds.manifest" && name != "backgrounds.lock") {
+            ++count;
+        }
+    }
+    return count;
+}
+
+bool TestImportDeduplicatesByContent() {
+    TempDirectory temp("image-store-dedupe");
+    BackgroundImageStore store;
+    if (!store.Open(temp.Store(), kNow)) {
+        PrintFailure(L"TestImportDeduplicatesByContent", L"Open failed");
+        return false;
+    }
+
+    const std::string wallpaper = MakeImageBytes(3u << 20, 1);
+    const auto first = store.Import(temp.WritePicture("lake.jpg", wallpaper), kNow);
+    // The same picture under another name, picked later for another folder.
+    const auto second = store.Import(temp.WritePicture("Lake Copy.JPG", wallpaper), kNow + 10);
+    const auto other = store.Import(temp.WritePicture("river.png", MakeImageBytes(3u << 20, 2)), kNow);
+    if (!first || !second || !other || !first->created || second->created || !other->created) {
+        PrintFailure(L"TestImportDeduplicatesByContent", L"Unexpected import results");
+        return false;
+    }
+    if (first->path != second->path || first->path == other->path ||
+        first->path.parent_path() != temp.Store() || first->path.extension() != ".jpg") {
+        PrintFailure(L"TestImportDeduplicatesByContent", L"Identical content should resolve to one stored file");
+        return false;
+    }
+    if (CountImageFiles(temp.Store()) != 2) {
+        PrintFailure(L"TestImportDeduplicatesByContent", L"Expected exactly two stored images");
+        return false;
+    }
+
+    const auto record = store.Find(first->path);
+    if (!record || record->bytes != wallpaper.size() || record->lastUse != kNow + 10) {
+        PrintFailure(L"TestImportDeduplicatesByContent", L"Manifest record is wrong");
+        return false;
+    }
+
+    std::error_code error;
+    if (store.Import(temp.Store() / "missing.jpg", kNow, &error) || !error) {
+        PrintFailure(L"TestImportDeduplicatesByContent", L"Importing a missing file should fail with an error");
+        return false;
+    }
+    return true;
+}
+
+bool TestManifestSurvivesReopen() {
+    TempDirectory temp("image-store-reopen");
+    std::filesystem::path stored;
+    {
+        BackgroundImageStore store;
+        store.Open(temp.Store(), kNow);
+        stored = store.Import(temp.WritePicture("dunes.jpg", MakeImageBytes(5000, 3)), kNow)->path;
+        store.SetReferences({stored, stored, temp.Store() / "unknown.jpg"}, kNow + kDay);
+    }
+
+    BackgroundImageStore reopened;
+    reopened.Open(temp.Store(), kNow + 2 * kDay);
+    const auto record = reopened.Find(stored);
+    if (!record || record->references != 2 || record->lastUse != kNow + kDay || record->bytes != 5000 ||
+        reopened.Records().size() != 1) {
+        PrintFailure(L"TestManifestSurvivesReopen", L"Manifest did not round-trip");
+        return false;
+    }
+
+    const auto again = reopened.Import(temp.WritePicture("dunes-again.jpg", MakeImageBytes(5000, 3)), kNow);
+    if (!again || again->created || again->path != stored) {
+        PrintFailure(L"TestManifestSurvivesReopen", L"Reopened store should still deduplicate");
+        return false;
+    }
+    return true;
+}
+
+bool TestTouchIsCoarse() {
+    TempDirectory temp("image-store-touch");
+    BackgroundImageStore store;
+    store.Open(temp.Store(), kNow);
+    const auto stored = store.Import(temp.WritePicture("a.bmp", MakeImageBytes(100, 4)), kNow)->path;
+
+    store.Touch(stored, kNow + 60);
+    if (store.Find(stored)->lastUse != kNow) {
+        PrintFailure(L"TestTouchIsCoarse", L"A use within the resolution should not be recorded");
+        return false;
+    }
+    store.Touch(stored, kNow + BackgroundImageStore::kTouchResolutionSeconds);
+    if (store.Find(stored)->lastUse != kNow + BackgroundImageStore::kTouchResolutionSeconds) {
+        PrintFailure(L"TestTouchIsCoarse", L"A later use should be recorded");
+        return false;
+    }
+    if (store.Touch(temp.Store() / "other.bmp", kNow)) {
+        PrintFailure(L"TestTouchIsCoarse", L"Unknown files should not be touched");
+        return false;
+    }
+    return true;
+}
+
+bool TestRemovesOnlyIdleUnreferencedImages() {
+    TempDirectory temp("image-store-remove");
+    BackgroundImageStore store;
+    store.Open(temp.Store(), kNow);
+    const auto kept = store.Import(temp.WritePicture("kept.jpg", MakeImageBytes(100, 5)), kNow)->path;
+    const auto idle = store.Import(temp.WritePicture("idle.jpg", MakeImageBytes(100, 6)), kNow)->path;
+    const auto recent = store.Import(temp.WritePicture("recent.jpg", MakeImageBytes(100, 7)), kNow + 29 * kDay)->path;
+
+    store.SetReferences({kept}, kNow);
+    auto removal = store.RemoveUnreferenced(kNow + 30 * kDay, 30 * kDay);
+    if (removal.removed.size() != 1 || removal.removed[0] != idle || std::filesystem::exists(idle) ||
+        !std::filesystem::exists(kept) || !std::filesystem::exists(recent) || !removal.failures.empty()) {
+        PrintFailure(L"TestRemovesOnlyIdleUnreferencedImages", L"Only the idle unreferenced image should go");
+        return false;
+    }
+
+    removal = store.RemoveUnreferenced(kNow + 30 * kDay, 0);
+    if (removal.removed.size() != 1 || std::filesystem::exists(recent) || store.Records().size() != 1) {
+        PrintFailure(L"TestRemovesOnlyIdleUnreferencedImages", L"A zero age should remove every unreferenced image");
+        return false;
+    }
+
+    // A removed image can be imported again.
+    const auto restored = store.Import(temp.WritePicture("idle.jpg", MakeImageBytes(100, 6)), kNow);
+    if (!restored || !restored->created || restored->path != idle) {
+        PrintFailure(L"TestRemovesOnlyIdleUnreferencedImages", L"Re-import after removal failed");
+        return false;
+    }
+    return true;
+}
+
+bool TestAdoptsExistingFiles() {
+    TempDirectory temp("image-store-adopt");
+    std::filesystem::create_directories(temp.Store());
+    const std::string legacy = MakeImageBytes(2000, 8);
+    {
+        // A file cached by GUID name before the store existed.
+        std::ofstream file(temp.Store() / "3F2504E04F8911D39A0C0305E82C3301.jpg", std::ios::binary);
+        file.write(legacy.data(), static_cast<std::streamsize>(legacy.size()));
+    }
+    {
+        std::ofstream file(temp.Store() / "backgrounds.manifest", std::ios::binary);
+        file << "shelltabs-background-manifest 1\n"
+             << "not a record\n"
+             << "0123456789abcdef0123456789abcdef 10 0 0 vanished.jpg\n";
+    }
+
+    BackgroundImageStore store;
+    store.Open(temp.Store(), kNow);
+    const auto records = store.Records();
+    if (records.size() != 1 || records[0].bytes != legacy.size() || records[0].references != 0) {
+        PrintFailure(L"TestAdoptsExistingFiles", L"Expected the legacy file adopted and the vanished one dropped");
+        return false;
+    }
+
+    const auto imported = store.Import(temp.WritePicture("same.jpg", legacy), kNow);
+    if (!imported || imported->created ||
+        imported->path.filename() != std::filesystem::path("3F2504E04F8911D39A0C0305E82C3301.jpg")) {
+        PrintFailure(L"TestAdoptsExistingFiles", L"Import should reuse the adopted file");
+        return false;
+    }
+    if (!store.Find(temp.Store() / "3f2504e04f8911d39a0c0305e82c3301.JPG")) {
+        PrintFailure(L"TestAdoptsExistingFiles", L"Lookups should ignore case");
+        return false;
+    }
+    return true;
+}
+
+bool TestByteCapEvictsLeastRecentlyUsed() {
+    TempDirectory temp("image-store-cap");
+    BackgroundImageStore store;
+    store.Open(temp.Store(), kNow);
+    std::vector<std::filesystem::path> stored;
+    for (uint32_t i = 0; i < 4; ++i) {
+        const auto name = "image" + std::to_string(i) + ".jpg";
+        stored.push_back(store.Import(temp.WritePicture(name, MakeImageBytes(1000, 10 + i)), kNow + i * kDay)->path);
+    }
+    // The oldest image is in use and must survive the cap.
+    store.SetReferences({stored[0]}, kNow);
+
+    const auto removal = store.RemoveUnreferenced(kNow + 4 * kDay, 30 * kDay, 2500);
+    if (removal.removed.size() != 2 || removal.removed[0] != stored[1] || removal.removed[1] != stored[2] ||
+        store.TotalBytes() != 2000 || !std::filesystem::exists(stored[0]) || !std::filesystem::exists(stored[3])) {
+        PrintFailure(L"TestByteCapEvictsLeastRecentlyUsed", L"Expected the two oldest unreferenced images evicted");
+        return false;
+    }
+
+    store.RemoveUnreferenced(kNow + 4 * kDay, 30 * kDay, 1);
+    if (store.TotalBytes() != 1000 || !std::filesystem::exists(stored[0])) {
+        PrintFailure(L"TestByteCapEvictsLeastRecentlyUsed", L"Referenced images must never be evicted");
+        return false;
+    }
+    return true;
+}
+
+bool TestManifestOutOfStepTriggersScan() {
+    TempDirectory temp("image-store-scan");
+    std::filesystem::path stored;
+    {
+        BackgroundImageStore store;
+        store.Open(temp.Store(), kNow);
+        stored = store.Import(temp.WritePicture("a.jpg", MakeImageBytes(300, 20)), kNow)->path;
+    }
+    {
+        std::ofstream stray(temp.Store() / "stray.jpg", std::ios::binary);
+        stray << "stray";
+    }
+    std::filesystem::remove(stored);
+
+    BackgroundImageStore store;
+    store.Open(temp.Store(), kNow);
+    if (!store.Find(temp.Store() / "stray.jpg") || store.Find(stored) || store.TotalBytes() != 5) {
+        PrintFailure(L"TestManifestOutOfStepTriggersScan", L"A manifest naming other files should be rescanned");
+        return false;
+    }
+
+    // The image is copied in again under its content name.
+    const auto restored = store.Import(temp.WritePicture("a.jpg", MakeImageBytes(300, 20)), kNow);
+    if (!restored || !restored->created || restored->path != stored || !std::filesystem::exists(stored)) {
+        PrintFailure(L"TestManifestOutOfStepTriggersScan", L"Import should replace a file deleted behind the manifest");
+        return false;
+    }
+
+    // A file deleted while the store is open is only noticed by Rescan.
+    std::filesystem::remove(stored);
+    store.Rescan(kNow);
+    if (!store.Find(temp.Store() / "stray.jpg") || store.Find(stored) || store.TotalBytes() != 5) {
+        PrintFailure(L"TestManifestOutOfStepTriggersScan", L"Rescan should reconcile the manifest with the directory");
+        return false;
+    }
+    return true;
+}
+
+bool TestConcurrentStoresKeepEachOthersImages() {
+    TempDirectory temp("image-store-shared");
+    // Two Explorer processes with the store open at once.
+    BackgroundImageStore first;
+    BackgroundImageStore second;
+    first.Open(temp.Store(), kNow);
+    second.Open(temp.Store(), kNow);
+
+    const auto mine = first.Import(temp.WritePicture("mine.jpg", MakeImageBytes(700, 30)), kNow);
+    const auto theirs = second.Import(temp.WritePicture("theirs.jpg", MakeImageBytes(900, 31)), kNow + kDay);
+    first.Touch(mine->path, kNow + 2 * kDay);
+
+    BackgroundImageStore reopened;
+    reopened.Open(temp.Store(), kNow + 3 * kDay);
+    const auto mineRecord = reopened.Find(mine->path);
+    if (!mineRecord || !reopened.Find(theirs->path) || reopened.TotalBytes() != 1600 ||
+        mineRecord->lastUse != kNow + 2 * kDay) {
+        PrintFailure(L"TestConcurrentStoresKeepEachOthersImages", L"The last writer dropped the other's image");
+        return false;
+    }
+
+    // An image removed by one process stays removed when the other saves.
+    second.RemoveUnreferenced(kNow + 3 * kDay, 0);
+    first.Touch(mine->path, kNow + 4 * kDay);
+    BackgroundImageStore after;
+    after.Open(temp.Store(), kNow + 5 * kDay);
+    if (after.Find(mine->path) || after.Find(theirs->path) || !after.Records().empty()) {
+        PrintFailure(L"TestConcurrentStoresKeepEachOthersImages", L"A removed image came back through the merge");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: 10k cached images, 100 of them referenced and 100 expired.
+// Compares a maintenance pass that enumerates the directory, building a key
+// and reading the timestamp of every file as the old purge did, with one
+// that works from the manifest.
+bool TestMaintenanceBenchmark() {
+    constexpr size_t kImages = 10000;
+    constexpr size_t kReferenced = 100;
+    constexpr size_t kExpired = 100;
+    constexpr uint64_t kExpiry = 30 * kDay;
+
+    TempDirectory temp("image-store-benchmark");
+    std::filesystem::create_directories(temp.Store());
+    std::vector<std::filesystem::path> files;
+    files.reserve(kImages);
+    const auto old = std::filesystem::file_time_type::clock::now() - std::chrono::hours(24 * 60);
+    for (size_t i = 0; i < kImages; ++i) {
+        files.push_back(temp.Store() / (std::to_string(i) + ".jpg"));
+        std::ofstream file(files.back(), std::ios::binary);
+        file << "image " << i;
+        file.close();
+        if (i < kExpired) {
+            std::filesystem::last_write_time(files.back(), old);
+        }
+    }
+    const uint64_t now = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    std::vector<std::filesystem::path> referenced(files.end() - kReferenced, files.end());
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    BackgroundImageStore store;
+    store.Open(temp.Store(), now);
+    const auto adoptTime = Clock::now() - start;
+
+    start = Clock::now();
+    BackgroundImageStore reopened;
+    reopened.Open(temp.Store(), now);
+    const auto reopenTime = Clock::now() - start;
+
+    start = Clock::now();
+    std::unordered_set<std::wstring> referencedKeys;
+    for (const auto& path : referenced) {
+        referencedKeys.insert(path.wstring());
+    }
+    size_t scanExpired = 0;
+    const auto cutoff = std::filesystem::file_time_type::clock::now() - std::chrono::hours(24 * 30);
+    for (const auto& entry : std::filesystem::directory_iterator(temp.Store())) {
+        std::wstring key = entry.path().wstring();
+        for (wchar_t& ch : key) {
+            ch = static_cast<wchar_t>(std::towlower(ch));
+        }
+        if (referencedKeys.count(key) == 0 && entry.last_write_time() < cutoff) {
+            ++scanExpired;
+        }
+    }
+    const auto scanTime = Clock::now() - start;
+
+    start = Clock::now();
+    reopened.SetReferences(referenced, now);
+    const auto removal = reopened.RemoveUnreferenced(now, kExpiry);
+    const auto expirePassTime = Clock::now() - start;
+
+    start = Clock::now();
+    reopened.SetReferences(referenced, now);
+    const auto idlePass = reopened.RemoveUnreferenced(now, kExpiry);
+    const auto idlePassTime = Clock::now() - start;
+
+    if (scanExpired != kExpired || removal.removed.size() != kExpired || !idlePass.removed.empty() ||
+        reopened.Records().size() != kImages - kExpired) {
+        PrintFailure(L"TestMaintenanceBenchmark", L"Passes disagree on what expired");
+        return false;
+    }
+
+    const auto ms = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+    std::wcout << L"[TestMaintenanceBenchmark] " << kImages << L" images: " << std::fixed << std::setprecision(2)
+               << L"directory pass " << ms(scanTime) << L"ms; manifest pass " << ms(expirePassTime)
+               << L"ms removing " << kExpired << L", " << ms(idlePassTime) << L"ms with nothing to do; first open "
+               << ms(adoptTime) << L"ms (scan), reopen " << ms(reopenTime) << L"ms" << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestImportDeduplicatesByContent", &TestImportDeduplicatesByContent},
+        {L"TestManifestSurvivesReopen", &TestManifestSurvivesReopen},
+        {L"TestTouchIsCoarse", &TestTouchIsCoarse},
+        {L"TestRemovesOnlyIdleUnreferencedImages", &TestRemovesOnlyIdleUnreferencedImages},
+        {L"TestAdoptsExistingFiles", &TestAdoptsExistingFiles},
+        {L"TestByteCapEvictsLeastRecentlyUsed", &TestByteCapEvictsLeastRecentlyUsed},
+        {L"TestManifestOutOfStepTriggersScan", &TestManifestOutOfStepTriggersScan},
+        {L"TestConcurrentStoresKeepEachOthersImages", &TestConcurrentStoresKeepEachOthersImages},
+        {L"TestMaintenanceBenchmark", &TestMaintenanceBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Background image store tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Background image store tests passed." << std::endl;
+    return 0;
+}
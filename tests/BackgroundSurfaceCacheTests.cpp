@@ -0,0 +1,437 @@
+#include "BackgroundSurfaceCache.h"
+#include "PreviewScaler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using shelltabs::BackgroundPixels;
+using shelltabs::BackgroundSurfaceCache;
+using shelltabs::BackgroundSurfaceKey;
+using namespace std::chrono_literals;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Stands in for a decoded wallpaper: a diagonal gradient tinted by the seed
+// so every image differs.
+BackgroundPixels MakeImage(uint32_t width, uint32_t height, uint32_t seed) {
+    BackgroundPixels pixels;
+    pixels.width = width;
+    pixels.height = height;
+    pixels.bgra.resize(static_cast<size_t>(width) * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t r = (x * 255u / width + seed * 37u) & 0xFFu;
+            const uint32_t g = (y * 255u / height + seed * 11u) & 0xFFu;
+            const uint32_t b = ((x + y) * 255u / (width + height)) & 0xFFu;
+            pixels.bgra[static_cast<size_t>(y) * width + x] = 0xFF000000u | (r << 16) | (g << 8) | b;
+        }
+    }
+    return pixels;
+}
+
+struct FakeImages {
+    uint32_t width = 400;
+    uint32_t height = 300;
+    std::atomic<int> decodes{0};
+    // When set, decoding waits for it so requests can pile up first.
+    std::shared_future<void> gate;
+
+    BackgroundSurfaceCache::Decoder Decoder() {
+        return [this](const std::wstring& path) -> std::optional<BackgroundPixels> {
+            if (gate.valid()) {
+                gate.wait();
+            }
+            ++decodes;
+            if (path.rfind(L"missing", 0) == 0) {
+                return std::nullopt;
+            }
+            return MakeImage(width, height, static_cast<uint32_t>(std::hash<std::wstring>{}(path)));
+        };
+    }
+};
+
+BackgroundSurfaceKey MakeKey(const std::wstring& path, uint32_t width, uint32_t height, uint32_t dpi = 96) {
+    BackgroundSurfaceKey key;
+    key.imagePath = path;
+    key.width = width;
+    key.height = height;
+    key.dpi = dpi;
+    return key;
+}
+
+// Returns the surface, waiting for the worker when it is not resident yet.
+BackgroundSurfaceCache::Surface AcquireAndWait(BackgroundSurfaceCache& cache, const BackgroundSurfaceKey& key,
+                                               bool* completed = nullptr) {
+    auto ready = std::make_shared<std::promise<BackgroundSurfaceCache::Surface>>();
+    std::future<BackgroundSurfaceCache::Surface> future = ready->get_future();
+    auto surface = cache.Acquire(key, [ready](const BackgroundSurfaceCache::Surface& result) {
+        ready->set_value(result);
+    });
+    if (surface) {
+        if (completed) {
+            *completed = true;
+        }
+        return surface;
+    }
+    const bool finished = future.wait_for(5s) == std::future_status::ready;
+    if (completed) {
+        *completed = finished;
+    }
+    return finished ? future.get() : nullptr;
+}
+
+bool TestSharesWorkAndSurfaces() {
+    FakeImages images;
+    std::promise<void> release;
+    images.gate = release.get_future().share();
+    BackgroundSurfaceCache cache(images.Decoder());
+
+    // Two windows opening the same folder before the first decode finishes.
+    std::promise<void> bothReady;
+    std::atomic<int> callbacks{0};
+    auto onReady = [&](const BackgroundSurfaceCache::Surface& surface) {
+        if (surface && ++callbacks == 2) {
+            bothReady.set_value();
+        }
+    };
+    const auto key = MakeKey(L"lake.jpg", 200, 150);
+    cache.Acquire(key, onReady);
+    cache.Acquire(key, onReady);
+    release.set_value();
+    if (bothReady.get_future().wait_for(5s) != std::future_status::ready) {
+        PrintFailure(L"TestSharesWorkAndSurfaces", L"Both requests should complete");
+        return false;
+    }
+
+    auto first = cache.Acquire(key);
+    auto second = cache.Acquire(key);
+    if (!first || first != second || first->width != 200 || first->height != 150) {
+        PrintFailure(L"TestSharesWorkAndSurfaces", L"Windows should share one resident surface at the painted size");
+        return false;
+    }
+
+    // A resize reuses the decoded original and only rescales.
+    bool completed = false;
+    auto resized = AcquireAndWait(cache, MakeKey(L"lake.jpg", 320, 240), &completed);
+    auto stats = cache.Stats();
+    if (!completed || !resized || images.decodes != 1 || stats.decodes != 1 || stats.scales != 2) {
+        PrintFailure(L"TestSharesWorkAndSurfaces", L"Expected one decode and two scales, got " +
+                                                       std::to_wstring(images.decodes.load()) + L" decodes and " +
+                                                       std::to_wstring(stats.scales) + L" scales");
+        return false;
+    }
+
+    // Same size at another DPI is a separate surface.
+    AcquireAndWait(cache, MakeKey(L"lake.jpg", 200, 150, 144));
+    stats = cache.Stats();
+    if (stats.surfaces != 3 || stats.decodedImages != 1 || stats.hits != 2) {
+        PrintFailure(L"TestSharesWorkAndSurfaces", L"Unexpected entry counts");
+        return false;
+    }
+    return true;
+}
+
+bool TestScalingKeepsFlatColour() {
+    BackgroundSurfaceCache cache([](const std::wstring&) -> std::optional<BackgroundPixels> {
+        BackgroundPixels pixels;
+        pixels.width = 64;
+        pixels.height = 48;
+        pixels.bgra.assign(64 * 48, 0xFF3366CCu);
+        return pixels;
+    });
+
+    for (const auto& key : {MakeKey(L"flat.png", 16, 12), MakeKey(L"flat.png", 200, 100), MakeKey(L"flat.png", 64, 48)}) {
+        auto surface = AcquireAndWait(cache, key);
+        if (!surface || surface->width != key.width || surface->height != key.height) {
+            PrintFailure(L"TestScalingKeepsFlatColour", L"Surface has the wrong size");
+            return false;
+        }
+        for (uint32_t pixel : surface->bgra) {
+            if (pixel != 0xFF3366CCu) {
+                PrintFailure(L"TestScalingKeepsFlatColour", L"Scaling changed a flat colour");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TestStaysWithinBudget() {
+    FakeImages images;
+    const size_t surfaceBytes = 200 * 150 * sizeof(uint32_t);
+    const size_t budget = surfaceBytes * 6;
+    BackgroundSurfaceCache cache(images.Decoder(), {}, budget);
+
+    for (int i = 0; i < 20; ++i) {
+        AcquireAndWait(cache, MakeKey(L"image" + std::to_wstring(i), 200, 150));
+        if (cache.Stats().residentBytes > budget) {
+            PrintFailure(L"TestStaysWithinBudget", L"Resident bytes exceeded the budget");
+            return false;
+        }
+    }
+
+    const auto stats = cache.Stats();
+    if (stats.evictions == 0 || !cache.Find(MakeKey(L"image19", 200, 150)) || cache.Find(MakeKey(L"image0", 200, 150))) {
+        PrintFailure(L"TestStaysWithinBudget", L"Least recently used surfaces should be evicted first");
+        return false;
+    }
+
+    cache.SetBudget(surfaceBytes);
+    if (cache.Stats().residentBytes > surfaceBytes || !cache.Find(MakeKey(L"image19", 200, 150))) {
+        PrintFailure(L"TestStaysWithinBudget", L"Shrinking the budget should keep only the newest surface");
+        return false;
+    }
+    return true;
+}
+
+bool TestRemembersFailuresUntilInvalidated() {
+    FakeImages images;
+    BackgroundSurfaceCache cache(images.Decoder());
+
+    bool completed = false;
+    const auto key = MakeKey(L"missing.jpg", 100, 100);
+    if (AcquireAndWait(cache, key, &completed) || !completed) {
+        PrintFailure(L"TestRemembersFailuresUntilInvalidated", L"A failed decode should report a null surface");
+        return false;
+    }
+
+    std::atomic<bool> called{false};
+    bool queued = true;
+    cache.Acquire(MakeKey(L"missing.jpg", 50, 50), [&](const BackgroundSurfaceCache::Surface&) { called = true; },
+                  &queued);
+    std::this_thread::sleep_for(50ms);
+    if (queued || images.decodes != 1 || called || cache.Stats().failures != 1) {
+        PrintFailure(L"TestRemembersFailuresUntilInvalidated", L"A known failure should not be decoded again");
+        return false;
+    }
+
+    cache.Invalidate(L"missing.jpg");
+    AcquireAndWait(cache, key);
+    if (images.decodes != 2) {
+        PrintFailure(L"TestRemembersFailuresUntilInvalidated", L"Invalidate should allow another attempt");
+        return false;
+    }
+
+    AcquireAndWait(cache, MakeKey(L"river.jpg", 100, 100));
+    cache.Invalidate(L"river.jpg");
+    if (cache.Find(MakeKey(L"river.jpg", 100, 100)) || cache.Stats().residentBytes != 0) {
+        PrintFailure(L"TestRemembersFailuresUntilInvalidated", L"Invalidate should drop the image's surfaces");
+        return false;
+    }
+    return true;
+}
+
+bool TestFailedFolderImageFallsBack() {
+    FakeImages images;
+    BackgroundSurfaceCache cache(images.Decoder());
+    const std::wstring folderImage = L"missing-folder.jpg";
+    const std::wstring universalImage = L"universal.jpg";
+
+    if (cache.ResolveImagePath(folderImage, universalImage) != folderImage) {
+        PrintFailure(L"TestFailedFolderImageFallsBack", L"An untried folder image should be used");
+        return false;
+    }
+
+    bool completed = false;
+    if (AcquireAndWait(cache, MakeKey(folderImage, 100, 100), &completed) || !completed) {
+        PrintFailure(L"TestFailedFolderImageFallsBack", L"The folder image should fail to decode");
+        return false;
+    }
+    const std::wstring resolved = cache.ResolveImagePath(folderImage, universalImage);
+    if (resolved != universalImage || !AcquireAndWait(cache, MakeKey(resolved, 100, 100))) {
+        PrintFailure(L"TestFailedFolderImageFallsBack", L"A failed folder image should fall back to the universal one");
+        return false;
+    }
+    if (!cache.ResolveImagePath(folderImage, {}).empty()) {
+        PrintFailure(L"TestFailedFolderImageFallsBack", L"Without a universal image nothing should be painted");
+        return false;
+    }
+
+    cache.Invalidate(folderImage);
+    if (cache.ResolveImagePath(folderImage, universalImage) != folderImage) {
+        PrintFailure(L"TestFailedFolderImageFallsBack", L"Invalidate should let the folder image be tried again");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: 50 folders, each with its own 1600x1000 background shown in an
+// 800x500 view. Every folder is opened once, then revisited in a skewed order
+// with a few repaints per visit. The old path kept every decoded original per
+// window and stretched it on each paint; the cache keeps pre-scaled surfaces
+// and a paint is a copy.
+bool TestNativeSizeSurfaceIsCountedOnce() {
+    FakeImages images;
+    BackgroundSurfaceCache cache(images.Decoder());
+    const size_t imageBytes = static_cast<size_t>(images.width) * images.height * sizeof(uint32_t);
+
+    if (!AcquireAndWait(cache, MakeKey(L"native.jpg", images.width, images.height))) {
+        PrintFailure(L"TestNativeSizeSurfaceIsCountedOnce", L"The native-size surface was not built");
+        return false;
+    }
+    auto stats = cache.Stats();
+    if (stats.residentBytes != imageBytes || stats.surfaces != 1 || stats.decodedImages != 0) {
+        PrintFailure(L"TestNativeSizeSurfaceIsCountedOnce", L"A decoded image used as is was counted twice");
+        return false;
+    }
+
+    // A source kept from an earlier resize moves to the surface key instead
+    // of being held twice.
+    const size_t scaledBytes = 200u * 150u * sizeof(uint32_t);
+    if (!AcquireAndWait(cache, MakeKey(L"resized.jpg", 200, 150)) ||
+        !AcquireAndWait(cache, MakeKey(L"resized.jpg", images.width, images.height))) {
+        PrintFailure(L"TestNativeSizeSurfaceIsCountedOnce", L"The resized image's surfaces were not built");
+        return false;
+    }
+    stats = cache.Stats();
+    if (stats.residentBytes != 2 * imageBytes + scaledBytes || stats.surfaces != 3 || stats.decodedImages != 0) {
+        PrintFailure(L"TestNativeSizeSurfaceIsCountedOnce", L"A cached source used as is was counted twice");
+        return false;
+    }
+    return true;
+}
+
+bool TestFiftyBackgroundsBenchmark() {
+    constexpr uint32_t kFolders = 50;
+    constexpr uint32_t kSourceWidth = 1600;
+    constexpr uint32_t kSourceHeight = 1000;
+    constexpr uint32_t kViewWidth = 800;
+    constexpr uint32_t kViewHeight = 500;
+    constexpr int kRevisits = 100;
+    constexpr int kPaintsPerVisit = 3;
+    // Stretching costs the same on every paint, so the old path is timed on
+    // a sample to keep unoptimized builds quick.
+    constexpr int kStretchSamples = 6;
+
+    std::vector<BackgroundPixels> sources;
+    sources.reserve(kFolders);
+    for (uint32_t i = 0; i < kFolders; ++i) {
+        sources.push_back(MakeImage(kSourceWidth, kSourceHeight, i));
+    }
+    std::vector<uint32_t> frame(static_cast<size_t>(kViewWidth) * kViewHeight);
+
+    std::vector<uint32_t> visits;
+    for (uint32_t folder = 0; folder < kFolders; ++folder) {
+        visits.push_back(folder);
+    }
+    uint32_t state = 12345;
+    for (int i = 0; i < kRevisits; ++i) {
+        state = state * 1664525u + 1013904223u;
+        const uint32_t a = (state >> 8) % kFolders;
+        state = state * 1664525u + 1013904223u;
+        const uint32_t b = (state >> 8) % kFolders;
+        visits.push_back(a < b ? a : b);
+    }
+
+    using Clock = std::chrono::steady_clock;
+    Clock::duration stretchTime{};
+    size_t oldResident = 0;
+    for (const BackgroundPixels& source : sources) {
+        oldResident += source.Bytes();
+    }
+    for (int sample = 0; sample < kStretchSamples; ++sample) {
+        const BackgroundPixels& source = sources[static_cast<size_t>(sample) * 7 % kFolders];
+        const auto start = Clock::now();
+        shelltabs::ScalePreviewPixels({source.bgra.data(), source.width, source.height, source.width},
+                                      frame.data(), kViewWidth, kViewHeight);
+        stretchTime += Clock::now() - start;
+    }
+
+    BackgroundSurfaceCache cache([&](const std::wstring& path) -> std::optional<BackgroundPixels> {
+        return sources[std::stoul(path)];
+    });
+    Clock::duration blitTime{};
+    Clock::duration missWait{};
+    int hits = 0;
+    int misses = 0;
+    for (uint32_t folder : visits) {
+        const auto key = MakeKey(std::to_wstring(folder), kViewWidth, kViewHeight);
+        for (int paint = 0; paint < kPaintsPerVisit; ++paint) {
+            const auto start = Clock::now();
+            auto surface = cache.Acquire(key);
+            if (surface) {
+                std::memcpy(frame.data(), surface->bgra.data(), surface->Bytes());
+                blitTime += Clock::now() - start;
+                ++hits;
+                continue;
+            }
+            // A miss paints without the image and repaints once it is ready.
+            ++misses;
+            surface = AcquireAndWait(cache, key);
+            missWait += Clock::now() - start;
+            if (!surface) {
+                PrintFailure(L"TestFiftyBackgroundsBenchmark", L"Surface was not produced");
+                return false;
+            }
+        }
+    }
+
+    const auto stats = cache.Stats();
+    auto ms = [](Clock::duration duration, int count) {
+        return std::chrono::duration<double, std::milli>(duration).count() / (count > 0 ? count : 1);
+    };
+    std::wcout << std::fixed << std::setprecision(2) << L"[TestFiftyBackgroundsBenchmark] stretch per paint: "
+               << ms(stretchTime, kStretchSamples) << L"ms/paint, " << oldResident / (1024 * 1024)
+               << L" MiB of originals resident per window" << std::endl;
+    std::wcout << L"[TestFiftyBackgroundsBenchmark] surface cache: " << ms(blitTime, hits) << L"ms/paint on "
+               << hits << L" hits, " << ms(missWait, misses) << L"ms until ready on " << misses << L" misses, "
+               << stats.residentBytes / (1024 * 1024) << L" MiB resident per process, " << stats.decodes
+               << L" decodes, " << stats.evictions << L" evictions" << std::endl;
+
+    if (stats.residentBytes > BackgroundSurfaceCache::kDefaultBudgetBytes || misses != static_cast<int>(kFolders)) {
+        PrintFailure(L"TestFiftyBackgroundsBenchmark", L"Every revisit should hit within the default budget");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestSharesWorkAndSurfaces", &TestSharesWorkAndSurfaces},
+        {L"TestScalingKeepsFlatColour", &TestScalingKeepsFlatColour},
+        {L"TestStaysWithinBudget", &TestStaysWithinBudget},
+        {L"TestRemembersFailuresUntilInvalidated", &TestRemembersFailuresUntilInvalidated},
+        {L"TestFailedFolderImageFallsBack", &TestFailedFolderImageFallsBack},
+        {L"TestNativeSizeSurfaceIsCountedOnce", &TestNativeSizeSurfaceIsCountedOnce},
+        {L"TestFiftyBackgroundsBenchmark", &TestFiftyBackgroundsBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Background surface cache tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Background surface cache tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "CachePolicy.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::CacheEvictionPolicy;
+using shelltabs::CachePolicySimulator;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+std::wstring PolicyName(CacheEvictionPolicy policy) {
+    const std::string name = shelltabs::CacheEvictionPolicyName(policy);
+    return std::wstring(name.begin(), name.end());
+}
+
+bool TestLruEvictsLeastRecentlyUsed() {
+    CachePolicySimulator cache(CacheEvictionPolicy::kLru, 3);
+    for (uint64_t key : {1, 2, 3, 1, 4}) {
+        cache.Access(key);
+    }
+    if (!cache.Access(1) || !cache.Access(3) || cache.Access(2)) {
+        PrintFailure(L"TestLruEvictsLeastRecentlyUsed", L"Expected key 2 to be the victim");
+        return false;
+    }
+    return true;
+}
+
+bool TestClockGivesSecondChance() {
+    CachePolicySimulator cache(CacheEvictionPolicy::kClock, 3);
+    for (uint64_t key : {1, 2, 3, 1, 4}) {
+        cache.Access(key);
+    }
+    if (!cache.Access(1) || cache.Access(2)) {
+        PrintFailure(L"TestClockGivesSecondChance", L"Referenced key was evicted instead of its neighbour");
+        return false;
+    }
+    return true;
+}
+
+// A small hot set is re-referenced often enough to reach 2Q's frequent queue,
+// then a long one-off scan runs. LRU loses the hot set; 2Q keeps it.
+bool TestTwoQueueResistsScans() {
+    constexpr size_t kCapacity = 100;
+    constexpr uint64_t kHotKeys = 5;
+    auto runWorkload = [](CachePolicySimulator& cache) {
+        uint64_t scanKey = 1000;
+        for (int round = 0; round < 200; ++round) {
+            cache.Access(static_cast<uint64_t>(round) % kHotKeys);
+            for (int i = 0; i < 5; ++i) {
+                cache.Access(scanKey++);
+            }
+        }
+        for (int i = 0; i < 1000; ++i) {
+            cache.Access(scanKey++);
+        }
+        size_t hotHits = 0;
+        for (uint64_t key = 0; key < kHotKeys; ++key) {
+            hotHits += cache.Access(key) ? 1 : 0;
+        }
+        return hotHits;
+    };
+
+    CachePolicySimulator lru(CacheEvictionPolicy::kLru, kCapacity);
+    CachePolicySimulator twoQueue(CacheEvictionPolicy::kTwoQueue, kCapacity);
+    const size_t lruHits = runWorkload(lru);
+    const size_t twoQueueHits = runWorkload(twoQueue);
+
+    if (twoQueueHits != kHotKeys || lruHits != 0) {
+        PrintFailure(L"TestTwoQueueResistsScans", L"Hot set survival lru=" + std::to_wstring(lruHits) +
+                                                      L" 2q=" + std::to_wstring(twoQueueHits));
+        return false;
+    }
+    return true;
+}
+
+bool TestPoliciesStayWithinCapacity() {
+    bool success = true;
+    for (CacheEvictionPolicy policy : shelltabs::kCacheEvictionPolicies) {
+        CachePolicySimulator cache(policy, 16);
+        uint32_t state = 12345;
+        for (int i = 0; i < 20000; ++i) {
+            state = state * 1664525u + 1013904223u;
+            const uint64_t key = (state >> 8) % 64;
+            if ((state & 7u) == 0) {
+                cache.Invalidate(key);
+            } else {
+                cache.Access(key);
+            }
+            if (cache.Size() > 16) {
+                PrintFailure(L"TestPoliciesStayWithinCapacity", PolicyName(policy) + L" exceeded its capacity");
+                success = false;
+                break;
+            }
+        }
+
+        cache.Access(500);
+        cache.Invalidate(500);
+        if (cache.Access(500)) {
+            PrintFailure(L"TestPoliciesStayWithinCapacity", PolicyName(policy) + L" kept an invalidated key");
+            success = false;
+        }
+        if (cache.Hits() + cache.Misses() == 0 || cache.HitRate() <= 0.0) {
+            PrintFailure(L"TestPoliciesStayWithinCapacity", PolicyName(policy) + L" recorded no hits");
+            success = false;
+        }
+    }
+    return success;
+}
+
+bool TestSimulatorTracksResidentBytes() {
+    CachePolicySimulator cache(CacheEvictionPolicy::kLru, 2);
+    cache.Access(1, 100);
+    cache.Access(2, 300);
+    cache.Access(1, 999);
+    cache.Access(3, 50);
+    bool success = true;
+    if (cache.Bytes() != 150 || cache.PeakBytes() != 400) {
+        PrintFailure(L"TestSimulatorTracksResidentBytes", L"Eviction did not release the victim's bytes");
+        success = false;
+    }
+    cache.Invalidate(1);
+    cache.Invalidate(42);
+    if (cache.Bytes() != 50 || cache.PeakBytes() != 400) {
+        PrintFailure(L"TestSimulatorTracksResidentBytes", L"Invalidation did not release its bytes");
+        success = false;
+    }
+    return success;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestLruEvictsLeastRecentlyUsed", &TestLruEvictsLeastRecentlyUsed},
+        {L"TestClockGivesSecondChance", &TestClockGivesSecondChance},
+        {L"TestTwoQueueResistsScans", &TestTwoQueueResistsScans},
+        {L"TestPoliciesStayWithinCapacity", &TestPoliciesStayWithinCapacity},
+        {L"TestSimulatorTracksResidentBytes", &TestSimulatorTracksResidentBytes},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Cache policy tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Cache policy tests passed." << std::endl;
+    return 0;
+}
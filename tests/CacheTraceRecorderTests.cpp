@@ -0,0 +1,210 @@
+#include "CacheTraceRecorder.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using shelltabs::CacheTraceEvent;
+using shelltabs::CacheTraceRecord;
+using shelltabs::CacheTraceRecorder;
+using shelltabs::CacheTraceSource;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Removes the trace file when the test finishes.
+class TempTracePath {
+public:
+    explicit TempTracePath(const char* name) {
+        const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        m_path = std::filesystem::temp_directory_path() /
+                 (std::string("shelltabs-") + name + "-" + std::to_string(stamp) + ".bin");
+    }
+    ~TempTracePath() {
+        std::error_code ignored;
+        std::filesystem::remove(m_path, ignored);
+    }
+
+    const std::filesystem::path& Get() const noexcept { return m_path; }
+
+private:
+    std::filesystem::path m_path;
+};
+
+bool TestRecordsRoundTrip() {
+    TempTracePath path("roundtrip");
+    CacheTraceRecorder recorder;
+    recorder.Record(CacheTraceSource::kIcon, CacheTraceEvent::kHit, 1, 1);
+    if (!recorder.Start(path.Get())) {
+        PrintFailure(L"TestRecordsRoundTrip", L"Start failed");
+        return false;
+    }
+    bool success = true;
+    if (recorder.Start(path.Get())) {
+        PrintFailure(L"TestRecordsRoundTrip", L"Second Start should fail while recording");
+        success = false;
+    }
+    recorder.Record(CacheTraceSource::kIcon, CacheTraceEvent::kMiss, 0x1122334455667788ull, 0);
+    recorder.Record(CacheTraceSource::kIcon, CacheTraceEvent::kInsert, 0x1122334455667788ull, 4160);
+    recorder.Record(CacheTraceSource::kPreview, CacheTraceEvent::kHit, 42, 1u << 20);
+    recorder.Record(CacheTraceSource::kListView, CacheTraceEvent::kEvict, 7, 1ull << 40);
+    recorder.Stop();
+    recorder.Record(CacheTraceSource::kIcon, CacheTraceEvent::kHit, 2, 1);
+
+    std::vector<CacheTraceRecord> records;
+    if (!shelltabs::ReadCacheTrace(path.Get(), &records) || records.size() != 4) {
+        PrintFailure(L"TestRecordsRoundTrip", L"Expected only the four records made while recording");
+        return false;
+    }
+    if (records[0].keyHash != 0x1122334455667788ull ||
+        records[0].event != static_cast<uint8_t>(CacheTraceEvent::kMiss) ||
+        records[1].sizeBytes != 4160 || records[2].source != static_cast<uint8_t>(CacheTraceSource::kPreview) ||
+        records[2].sizeBytes != (1u << 20) || records[3].sizeBytes != UINT32_MAX) {
+        PrintFailure(L"TestRecordsRoundTrip", L"Record fields did not survive the round trip");
+        success = false;
+    }
+    for (size_t i = 1; i < records.size(); ++i) {
+        if (records[i].timestampMicros < records[i - 1].timestampMicros) {
+            PrintFailure(L"TestRecordsRoundTrip", L"Timestamps went backwards");
+            success = false;
+        }
+    }
+    if (recorder.RecordedCount() != 4 || recorder.DroppedCount() != 0) {
+        PrintFailure(L"TestRecordsRoundTrip", L"Unexpected recorder counters");
+        success = false;
+    }
+    return success;
+}
+
+bool TestRejectsForeignFiles() {
+    TempTracePath path("foreign");
+    {
+        std::ofstream stream(path.Get(), std::ios::binary);
+        stream << "key-one\nkey-two\n";
+    }
+    std::vector<CacheTraceRecord> records;
+    if (shelltabs::ReadCacheTrace(path.Get(), &records) || !records.empty()) {
+        PrintFailure(L"TestRejectsForeignFiles", L"A text file was read as a trace");
+        return false;
+    }
+    if (shelltabs::ReadCacheTrace(path.Get().string() + ".missing", &records)) {
+        PrintFailure(L"TestRejectsForeignFiles", L"A missing file was read as a trace");
+        return false;
+    }
+    return true;
+}
+
+bool TestConcurrentRecordsSpanFlushes() {
+    TempTracePath path("concurrent");
+    CacheTraceRecorder recorder;
+    if (!recorder.Start(path.Get())) {
+        PrintFailure(L"TestConcurrentRecordsSpanFlushes", L"Start failed");
+        return false;
+    }
+
+    constexpr size_t kThreads = 4;
+    constexpr size_t kPerThread = CacheTraceRecorder::kFlushThreshold + 123;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&recorder, t]() {
+            for (size_t i = 0; i < kPerThread; ++i) {
+                recorder.Record(static_cast<CacheTraceSource>(t % 3), CacheTraceEvent::kHit, (t << 32) | i, i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    recorder.Stop();
+
+    std::vector<CacheTraceRecord> records;
+    if (!shelltabs::ReadCacheTrace(path.Get(), &records) || records.size() != kThreads * kPerThread) {
+        PrintFailure(L"TestConcurrentRecordsSpanFlushes", L"Records were lost across batch flushes");
+        return false;
+    }
+    std::vector<size_t> perThread(kThreads, 0);
+    for (const auto& record : records) {
+        const size_t thread = static_cast<size_t>(record.keyHash >> 32);
+        if (thread >= kThreads || record.sizeBytes != (record.keyHash & 0xffffffffu)) {
+            PrintFailure(L"TestConcurrentRecordsSpanFlushes", L"Found a torn record");
+            return false;
+        }
+        ++perThread[thread];
+    }
+    for (size_t count : perThread) {
+        if (count != kPerThread) {
+            PrintFailure(L"TestConcurrentRecordsSpanFlushes", L"A thread's records were lost");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TestFullBatchIsWrittenInTheBackground() {
+    TempTracePath path("background");
+    CacheTraceRecorder recorder;
+    if (!recorder.Start(path.Get())) {
+        PrintFailure(L"TestFullBatchIsWrittenInTheBackground", L"Start failed");
+        return false;
+    }
+    for (size_t i = 0; i < CacheTraceRecorder::kFlushThreshold; ++i) {
+        recorder.Record(CacheTraceSource::kPreview, CacheTraceEvent::kHit, i, i);
+    }
+
+    // Nothing on this thread flushes; the writer has to pick the batch up.
+    const uintmax_t expected =
+        sizeof(shelltabs::CacheTraceFileHeader) + CacheTraceRecorder::kFlushThreshold * sizeof(CacheTraceRecord);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    std::error_code error;
+    while (std::filesystem::file_size(path.Get(), error) != expected && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    const bool written = std::filesystem::file_size(path.Get(), error) == expected;
+    recorder.Stop();
+    if (!written) {
+        PrintFailure(L"TestFullBatchIsWrittenInTheBackground", L"The full batch was not written by the writer");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestRecordsRoundTrip", &TestRecordsRoundTrip},
+        {L"TestRejectsForeignFiles", &TestRejectsForeignFiles},
+        {L"TestConcurrentRecordsSpanFlushes", &TestConcurrentRecordsSpanFlushes},
+        {L"TestFullBatchIsWrittenInTheBackground", &TestFullBatchIsWrittenInTheBackground},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Cache trace recorder tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Cache trace recorder tests passed." << std::endl;
+    return 0;
+}
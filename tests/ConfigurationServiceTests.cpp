@@ -0,0 +1,286 @@
+#include "ConfigurationService.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using shelltabs::ConfigurationDocument;
+using shelltabs::ConfigurationService;
+using shelltabs::ConfigurationWatcher;
+using namespace std::chrono_literals;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// In-memory stand-in for the directory watcher. Tests raise file events by
+// hand instead of touching the file system.
+class FakeConfigurationWatcher : public ConfigurationWatcher {
+public:
+    struct Shared {
+        std::mutex mutex;
+        ChangeCallback callback;
+        std::wstring directory;
+        bool stopped = false;
+    };
+
+    explicit FakeConfigurationWatcher(std::shared_ptr<Shared> shared) : m_shared(std::move(shared)) {}
+
+    bool Start(const std::wstring& directory, ChangeCallback callback) override {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->directory = directory;
+        m_shared->callback = std::move(callback);
+        return true;
+    }
+
+    void Stop() override {
+        std::lock_guard<std::mutex> lock(m_shared->mutex);
+        m_shared->callback = nullptr;
+        m_shared->stopped = true;
+    }
+
+    static void Raise(Shared& shared, const std::wstring& fileName) {
+        ChangeCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            callback = shared.callback;
+        }
+        if (callback) {
+            callback(fileName);
+        }
+    }
+
+private:
+    std::shared_ptr<Shared> m_shared;
+};
+
+struct RecordedUpdate {
+    ConfigurationDocument document;
+    uint64_t generation;
+};
+
+class UpdateRecorder {
+public:
+    ConfigurationService::Listener Listener() {
+        return [this](ConfigurationDocument document, uint64_t generation) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_updates.push_back({document, generation});
+        };
+    }
+
+    std::vector<RecordedUpdate> Updates() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_updates;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<RecordedUpdate> m_updates;
+};
+
+bool TestBurstOfEventsReloadsOnce() {
+    ConfigurationService service(100ms);
+    int reloads = 0;
+    service.RegisterDocument(ConfigurationDocument::kOptions, L"options.db", [&]() {
+        ++reloads;
+        return true;
+    });
+    UpdateRecorder recorder;
+    service.Subscribe(recorder.Listener());
+
+    const auto start = ConfigurationService::Clock::now();
+    service.NotifyFileChanged(L"options.db", start);
+    service.NotifyFileChanged(L"OPTIONS.DB", start + 40ms);
+    service.NotifyFileChanged(L"sub\\options.db", start + 80ms);
+
+    bool success = true;
+    if (service.ProcessPendingChanges(start + 150ms) != start + 180ms || reloads != 0) {
+        PrintFailure(L"TestBurstOfEventsReloadsOnce", L"Reload ran before the debounce window elapsed");
+        success = false;
+    }
+    if (service.ProcessPendingChanges(start + 180ms) || reloads != 1) {
+        PrintFailure(L"TestBurstOfEventsReloadsOnce", L"Expected exactly one reload after the burst");
+        success = false;
+    }
+    const auto updates = recorder.Updates();
+    if (updates.size() != 1 || updates[0].document != ConfigurationDocument::kOptions ||
+        updates[0].generation != 1) {
+        PrintFailure(L"TestBurstOfEventsReloadsOnce", L"Subscribers did not receive one stamped update");
+        success = false;
+    }
+    return success;
+}
+
+bool TestUnchangedReloadIsNotPublished() {
+    ConfigurationService service(10ms);
+    bool changed = false;
+    service.RegisterDocument(ConfigurationDocument::kSavedGroups, L"groups.db", [&]() { return changed; });
+    UpdateRecorder recorder;
+    service.Subscribe(recorder.Listener());
+
+    // An in-process save publishes directly; the watcher's echo then reloads
+    // an unchanged store.
+    const uint64_t published = service.Publish(ConfigurationDocument::kSavedGroups);
+    const auto start = ConfigurationService::Clock::now();
+    service.NotifyFileChanged(L"groups.db", start);
+    service.ProcessPendingChanges(start + 10ms);
+
+    changed = true;
+    service.NotifyFileChanged(L"groups.db", start + 20ms);
+    service.ProcessPendingChanges(start + 30ms);
+
+    bool success = true;
+    const auto updates = recorder.Updates();
+    if (published != 1 || updates.size() != 2 || updates[1].generation != 2 ||
+        service.Generation(ConfigurationDocument::kSavedGroups) != 2) {
+        PrintFailure(L"TestUnchangedReloadIsNotPublished", L"Unexpected generation sequence");
+        success = false;
+    }
+    if (service.Generation(ConfigurationDocument::kOptions) != 0) {
+        PrintFailure(L"TestUnchangedReloadIsNotPublished", L"Unrelated document generation moved");
+        success = false;
+    }
+    return success;
+}
+
+bool TestUnknownFilesAndUnsubscribedListenersAreIgnored() {
+    ConfigurationService service(10ms);
+    int reloads = 0;
+    service.RegisterDocument(ConfigurationDocument::kOptions, L"options.db", [&]() {
+        ++reloads;
+        return true;
+    });
+    UpdateRecorder recorder;
+    const uint64_t token = service.Subscribe(recorder.Listener());
+    service.Unsubscribe(token);
+
+    const auto start = ConfigurationService::Clock::now();
+    service.NotifyFileChanged(L"session-1234.db", start);
+    service.NotifyFileChanged(L"options.db.tmp", start);
+
+    bool success = true;
+    if (service.ProcessPendingChanges(start + 1s) || reloads != 0) {
+        PrintFailure(L"TestUnknownFilesAndUnsubscribedListenersAreIgnored", L"Unrelated file triggered a reload");
+        success = false;
+    }
+    service.NotifyFileChanged(L"options.db", start);
+    service.ProcessPendingChanges(start + 1s);
+    if (reloads != 1 || !recorder.Updates().empty()) {
+        PrintFailure(L"TestUnknownFilesAndUnsubscribedListenersAreIgnored",
+                     L"Unsubscribed listener still received updates");
+        success = false;
+    }
+    return success;
+}
+
+bool TestDispatcherDeliversWatcherEvents() {
+    auto shared = std::make_shared<FakeConfigurationWatcher::Shared>();
+    ConfigurationService service(20ms);
+    std::atomic<int> reloads{0};
+    service.RegisterDocument(ConfigurationDocument::kOptions, L"options.db", [&]() {
+        ++reloads;
+        return true;
+    });
+    UpdateRecorder recorder;
+    service.Subscribe(recorder.Listener());
+
+    bool success = true;
+    if (!service.Start(std::make_unique<FakeConfigurationWatcher>(shared), L"C:\\ShellTabsData") ||
+        shared->directory != L"C:\\ShellTabsData") {
+        PrintFailure(L"TestDispatcherDeliversWatcherEvents", L"Watcher was not started");
+        return false;
+    }
+
+    for (int i = 0; i < 5; ++i) {
+        FakeConfigurationWatcher::Raise(*shared, L"options.db");
+    }
+
+    const auto giveUp = std::chrono::steady_clock::now() + 5s;
+    while (recorder.Updates().empty() && std::chrono::steady_clock::now() < giveUp) {
+        std::this_thread::sleep_for(5ms);
+    }
+    service.Stop();
+
+    if (reloads.load() != 1 || recorder.Updates().size() != 1) {
+        PrintFailure(L"TestDispatcherDeliversWatcherEvents", L"Dispatcher did not coalesce watcher events");
+        success = false;
+    }
+    if (!shared->stopped || service.IsRunning()) {
+        PrintFailure(L"TestDispatcherDeliversWatcherEvents", L"Stop did not release the watcher");
+        success = false;
+    }
+    return success;
+}
+
+bool TestAbandonDoesNotStopTheWatcher() {
+    auto shared = std::make_shared<FakeConfigurationWatcher::Shared>();
+    ConfigurationService service(10ms);
+    std::atomic<int> reloads{0};
+    service.RegisterDocument(ConfigurationDocument::kOptions, L"options.db", [&]() {
+        ++reloads;
+        return true;
+    });
+
+    if (!service.Start(std::make_unique<FakeConfigurationWatcher>(shared), L"C:\\ShellTabsData")) {
+        PrintFailure(L"TestAbandonDoesNotStopTheWatcher", L"Watcher was not started");
+        return false;
+    }
+    service.Abandon();
+
+    bool success = true;
+    if (shared->stopped || service.IsRunning()) {
+        PrintFailure(L"TestAbandonDoesNotStopTheWatcher", L"Abandon stopped the watcher or kept running");
+        success = false;
+    }
+
+    // The leaked watcher may still report; nothing is dispatched any more.
+    FakeConfigurationWatcher::Raise(*shared, L"options.db");
+    std::this_thread::sleep_for(50ms);
+    if (reloads.load() != 0) {
+        PrintFailure(L"TestAbandonDoesNotStopTheWatcher", L"An abandoned service still reloaded");
+        success = false;
+    }
+    return success;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestBurstOfEventsReloadsOnce", &TestBurstOfEventsReloadsOnce},
+        {L"TestUnchangedReloadIsNotPublished", &TestUnchangedReloadIsNotPublished},
+        {L"TestUnknownFilesAndUnsubscribedListenersAreIgnored", &TestUnknownFilesAndUnsubscribedListenersAreIgnored},
+        {L"TestDispatcherDeliversWatcherEvents", &TestDispatcherDeliversWatcherEvents},
+        {L"TestAbandonDoesNotStopTheWatcher", &TestAbandonDoesNotStopTheWatcher},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Configuration service tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Configuration service tests passed." << std::endl;
+    return 0;
+}
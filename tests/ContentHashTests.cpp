@@ -0,0 +1,188 @@
+#include "ContentHash.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+using shelltabs::ContentDigest;
+using shelltabs::ContentDigestHasher;
+using shelltabs::ContentHasher;
+using shelltabs::ContentHashPath;
+using shelltabs::HashContent;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+std::vector<uint8_t> MakeBytes(size_t size, uint32_t seed) {
+    std::vector<uint8_t> bytes(size);
+    uint32_t state = seed * 2654435761u + 1u;
+    for (uint8_t& byte : bytes) {
+        state = state * 1664525u + 1013904223u;
+        byte = static_cast<uint8_t>(state >> 24);
+    }
+    return bytes;
+}
+
+const wchar_t* PathName(ContentHashPath path) {
+    switch (path) {
+        case ContentHashPath::kScalar:
+            return L"scalar";
+        case ContentHashPath::kSse2:
+            return L"sse2";
+        case ContentHashPath::kAvx2:
+            return L"avx2";
+        default:
+            return L"auto";
+    }
+}
+
+std::vector<ContentHashPath> SupportedPaths() {
+    std::vector<ContentHashPath> paths;
+    for (ContentHashPath path : {ContentHashPath::kScalar, ContentHashPath::kSse2, ContentHashPath::kAvx2}) {
+        if (shelltabs::IsContentHashPathSupported(path)) {
+            paths.push_back(path);
+        }
+    }
+    return paths;
+}
+
+bool TestPathsAgree() {
+    const std::vector<size_t> sizes = {0, 1, 7, 63, 64, 65, 1023, 1024, 1025, 4096, 70001, 3u << 20};
+    for (size_t size : sizes) {
+        const std::vector<uint8_t> bytes = MakeBytes(size, static_cast<uint32_t>(size));
+        const ContentDigest expected = HashContent(bytes.data(), bytes.size(), ContentHashPath::kScalar);
+        for (ContentHashPath path : SupportedPaths()) {
+            if (HashContent(bytes.data(), bytes.size(), path) != expected) {
+                PrintFailure(L"TestPathsAgree", std::wstring(PathName(path)) + L" differs from scalar at " +
+                                                    std::to_wstring(size) + L" bytes");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TestChunkingDoesNotMatter() {
+    const std::vector<uint8_t> bytes = MakeBytes(200000, 3);
+    const ContentDigest expected = HashContent(bytes.data(), bytes.size());
+    for (size_t chunk : {size_t{1}, size_t{13}, size_t{64}, size_t{1000}, size_t{1024}, size_t{65536}}) {
+        ContentHasher hasher;
+        for (size_t offset = 0; offset < bytes.size(); offset += chunk) {
+            hasher.Update(bytes.data() + offset, std::min(chunk, bytes.size() - offset));
+        }
+        if (hasher.Finish() != expected || hasher.BytesHashed() != bytes.size()) {
+            PrintFailure(L"TestChunkingDoesNotMatter", L"Chunks of " + std::to_wstring(chunk) + L" bytes changed the digest");
+            return false;
+        }
+    }
+
+    // Finish does not end the stream.
+    ContentHasher hasher;
+    hasher.Update(bytes.data(), 5000);
+    hasher.Finish();
+    hasher.Update(bytes.data() + 5000, bytes.size() - 5000);
+    if (hasher.Finish() != expected) {
+        PrintFailure(L"TestChunkingDoesNotMatter", L"Finish disturbed the running state");
+        return false;
+    }
+    return true;
+}
+
+bool TestSensitivity() {
+    const std::string zeros(3, '\0');
+    if (HashContent("", 0) == HashContent(zeros.data(), 1) || HashContent(zeros.data(), 1) == HashContent(zeros.data(), 2) ||
+        HashContent("ab", 2) == HashContent("ab\0", 3)) {
+        PrintFailure(L"TestSensitivity", L"Trailing zeros must change the digest");
+        return false;
+    }
+
+    // Every single-bit flip in an image-sized buffer gives a distinct digest.
+    std::vector<uint8_t> bytes = MakeBytes(4096, 9);
+    std::unordered_set<ContentDigest, ContentDigestHasher> seen;
+    seen.insert(HashContent(bytes.data(), bytes.size()));
+    for (size_t bit = 0; bit < bytes.size() * 8; bit += 7) {
+        bytes[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+        if (!seen.insert(HashContent(bytes.data(), bytes.size())).second) {
+            PrintFailure(L"TestSensitivity", L"Flipping bit " + std::to_wstring(bit) + L" collided");
+            return false;
+        }
+        bytes[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+    }
+    return true;
+}
+
+bool TestFormatRoundTrip() {
+    const ContentDigest digest{0x0123456789ABCDEFull, 0xFEDCBA9876543210ull};
+    const std::wstring text = shelltabs::FormatContentDigest(digest);
+    if (text != L"fedcba98765432100123456789abcdef") {
+        PrintFailure(L"TestFormatRoundTrip", L"Unexpected text " + text);
+        return false;
+    }
+    const auto parsed = shelltabs::ParseContentDigest(text);
+    if (!parsed || *parsed != digest || shelltabs::ParseContentDigest(L"xyz") ||
+        shelltabs::ParseContentDigest(L"fedcba98765432100123456789abcdeg")) {
+        PrintFailure(L"TestFormatRoundTrip", L"Parsing does not round-trip");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: a 16 MiB buffer, the size of a large wallpaper, per path.
+bool TestThroughputBenchmark() {
+    const std::vector<uint8_t> bytes = MakeBytes(16u << 20, 1);
+    for (ContentHashPath path : SupportedPaths()) {
+        auto best = std::chrono::steady_clock::duration::max();
+        for (int run = 0; run < 3; ++run) {
+            const auto start = std::chrono::steady_clock::now();
+            HashContent(bytes.data(), bytes.size(), path);
+            best = std::min(best, std::chrono::steady_clock::now() - start);
+        }
+        const double seconds = std::chrono::duration<double>(best).count();
+        std::wcout << L"[TestThroughputBenchmark] " << PathName(path) << L": " << std::fixed << std::setprecision(2)
+                   << seconds * 1000.0 << L"ms, " << std::setprecision(0)
+                   << static_cast<double>(bytes.size()) / seconds / (1024.0 * 1024.0) << L" MiB/s" << std::endl;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestPathsAgree", &TestPathsAgree},
+        {L"TestChunkingDoesNotMatter", &TestChunkingDoesNotMatter},
+        {L"TestSensitivity", &TestSensitivity},
+        {L"TestFormatRoundTrip", &TestFormatRoundTrip},
+        {L"TestThroughputBenchmark", &TestThroughputBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Content hash tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Content hash tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include "DirtyRegion.h"
+#include "GradientDamage.h"
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::DirtyRect;
+using shelltabs::DirtyRegion;
+using shelltabs::FillGradient;
+using shelltabs::GradientColor;
+using shelltabs::GradientDirection;
+using shelltabs::GradientSpanCache;
+using shelltabs::GradientSpec;
+using shelltabs::VerticalGradientDamage;
+using shelltabs::VerticalGradientState;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+constexpr GradientColor kBlue{30, 60, 200, 255};
+constexpr GradientColor kOrange{220, 120, 20, 255};
+
+bool RectsDisjoint(const DirtyRegion& region) {
+    const auto& rects = region.Rects();
+    for (size_t i = 0; i < rects.size(); ++i) {
+        for (size_t j = i + 1; j < rects.size(); ++j) {
+            const DirtyRect& a = rects[i];
+            const DirtyRect& b = rects[j];
+            if (a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TestNeighboursJoin() {
+    DirtyRegion region;
+    region.Add({0, 0, 10, 10});
+    region.Add({10, 0, 20, 10});
+    region.Add({0, 10, 20, 15});
+    if (region.Rects().size() != 1 || !(region.Rects().front() == DirtyRect{0, 0, 20, 15})) {
+        PrintFailure(L"TestNeighboursJoin", L"Adjacent rects should form one rect");
+        return false;
+    }
+    region.Add({5, 5, 15, 12});
+    region.Add({3, 3, 3, 20});
+    if (region.Rects().size() != 1 || region.Area() != 300) {
+        PrintFailure(L"TestNeighboursJoin", L"Covered and empty rects should change nothing");
+        return false;
+    }
+    return true;
+}
+
+bool TestOverlapsCountedOnce() {
+    DirtyRegion region;
+    region.Add({0, 0, 10, 10});
+    region.Add({5, 5, 15, 15});
+    if (region.Area() != 175 || !RectsDisjoint(region) || !(region.Bounds() == DirtyRect{0, 0, 15, 15})) {
+        PrintFailure(L"TestOverlapsCountedOnce", L"Expected 175 pixels in disjoint rects");
+        return false;
+    }
+    // A rect swallowing the others.
+    region.Add({-1, -1, 16, 16});
+    if (region.Rects().size() != 1 || region.Area() != 17 * 17) {
+        PrintFailure(L"TestOverlapsCountedOnce", L"A covering rect should replace the others");
+        return false;
+    }
+    return true;
+}
+
+bool TestCheapestPairMerges() {
+    DirtyRegion region(2);
+    region.Add({0, 0, 10, 10});
+    region.Add({100, 0, 110, 10});
+    region.Add({0, 20, 10, 30});
+    // Joining the two left rects wastes 100 pixels; either pair with the
+    // right one wastes 900 or more.
+    const auto& rects = region.Rects();
+    const bool leftMerged = rects.size() == 2 && ((rects[0] == DirtyRect{0, 0, 10, 30}) ||
+                                                   (rects[1] == DirtyRect{0, 0, 10, 30}));
+    if (!leftMerged || region.Area() != 400) {
+        PrintFailure(L"TestCheapestPairMerges", L"Expected the two left rects to merge");
+        return false;
+    }
+    return true;
+}
+
+bool TestMergedRegionCoversEveryAddedPixel() {
+    constexpr int kSize = 128;
+    DirtyRegion region;
+    std::vector<uint8_t> added(kSize * kSize, 0);
+    uint32_t seed = 12345;
+    const auto next = [&seed](int limit) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int32_t>((seed >> 8) % static_cast<uint32_t>(limit));
+    };
+    for (int i = 0; i < 200; ++i) {
+        const int32_t left = next(kSize);
+        const int32_t top = next(kSize);
+        const DirtyRect rect{left, top, std::min(kSize, left + 1 + next(24)), std::min(kSize, top + 1 + next(24))};
+        region.Add(rect);
+        for (int32_t y = rect.top; y < rect.bottom; ++y) {
+            for (int32_t x = rect.left; x < rect.right; ++x) {
+                added[y * kSize + x] = 1;
+            }
+        }
+        if (region.Rects().size() > DirtyRegion::kDefaultMaxRects) {
+            PrintFailure(L"TestMergedRegionCoversEveryAddedPixel", L"Too many rects after add " + std::to_wstring(i));
+            return false;
+        }
+    }
+
+    std::vector<uint8_t> covered(kSize * kSize, 0);
+    for (const DirtyRect& rect : region.Rects()) {
+        for (int32_t y = rect.top; y < rect.bottom; ++y) {
+            for (int32_t x = rect.left; x < rect.right; ++x) {
+                ++covered[y * kSize + x];
+            }
+        }
+    }
+    for (size_t i = 0; i < added.size(); ++i) {
+        if (covered[i] > 1 || (added[i] && !covered[i])) {
+            PrintFailure(L"TestMergedRegionCoversEveryAddedPixel", L"Pixel covered wrongly at " + std::to_wstring(i));
+            return false;
+        }
+    }
+
+    region.Clip({0, 0, 32, 32});
+    if (region.Bounds().right > 32 || region.Bounds().bottom > 32 || !RectsDisjoint(region)) {
+        PrintFailure(L"TestMergedRegionCoversEveryAddedPixel", L"Clip should keep rects inside the bounds");
+        return false;
+    }
+    return true;
+}
+
+bool TestGradientDamage() {
+    const VerticalGradientState base{400, 300, kBlue, kOrange};
+
+    VerticalGradientState wider = base;
+    wider.width = 420;
+    DirtyRegion damage = VerticalGradientDamage(base, wider);
+    if (damage.Rects().size() != 1 || !(damage.Rects().front() == DirtyRect{400, 0, 420, 300})) {
+        PrintFailure(L"TestGradientDamage", L"Widening should repaint only the new columns");
+        return false;
+    }
+
+    VerticalGradientState narrower = base;
+    narrower.width = 300;
+    if (!VerticalGradientDamage(base, narrower).Empty() || !VerticalGradientDamage(base, base).Empty()) {
+        PrintFailure(L"TestGradientDamage", L"Shrinking or repeating should repaint nothing");
+        return false;
+    }
+
+    VerticalGradientState taller = base;
+    taller.height = 310;
+    VerticalGradientState recolored = base;
+    recolored.end = kBlue;
+    if (VerticalGradientDamage(base, taller).Area() != 400 * 310 ||
+        VerticalGradientDamage(base, recolored).Area() != 400 * 300 ||
+        VerticalGradientDamage(VerticalGradientState{}, base).Area() != 400 * 300) {
+        PrintFailure(L"TestGradientDamage", L"New rows, colors or an empty surface should repaint everything");
+        return false;
+    }
+
+    // With one color, rows do not depend on the height.
+    const VerticalGradientState flat{400, 300, kBlue, kBlue};
+    const VerticalGradientState flatBigger{410, 305, kBlue, kBlue};
+    damage = VerticalGradientDamage(flat, flatBigger);
+    if (damage.Area() != 10 * 305 + 400 * 5 || !RectsDisjoint(damage)) {
+        PrintFailure(L"TestGradientDamage", L"A flat fill should repaint only the exposed strips");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: an overlay bitmap with room for 640x420 follows a window being
+// dragged wider, narrower and taller with a two-color gradient, then switched
+// to one color and dragged larger again. Every step is repainted through its
+// damage and compared against a fresh fill; bytes touched are totalled
+// against repainting the whole bitmap each time, as UpdateTrackedBitmapsLocked
+// did.
+bool TestResizeSequenceBytesTouched() {
+    constexpr uint32_t kCapacityWidth = 640;
+    constexpr uint32_t kCapacityHeight = 420;
+    std::vector<VerticalGradientState> sequence;
+    VerticalGradientState state{400, 300, kBlue, kOrange};
+    sequence.push_back(state);
+    for (int i = 0; i < 50; ++i) {
+        state.width += 4;
+        sequence.push_back(state);
+    }
+    for (int i = 0; i < 30; ++i) {
+        state.width -= 4;
+        sequence.push_back(state);
+    }
+    for (int i = 0; i < 25; ++i) {
+        state.height += 4;
+        sequence.push_back(state);
+    }
+    state.end = state.start;
+    sequence.push_back(state);
+    for (int i = 0; i < 25; ++i) {
+        state.width += 4;
+        state.height -= 2;
+        sequence.push_back(state);
+    }
+
+    GradientSpanCache cache;
+    std::vector<uint32_t> pixels(kCapacityWidth * kCapacityHeight, 0);
+    std::vector<uint32_t> expected;
+    VerticalGradientState painted;
+    uint64_t fullBytes = 0;
+    uint64_t dirtyBytes = 0;
+    for (size_t step = 0; step < sequence.size(); ++step) {
+        const VerticalGradientState& next = sequence[step];
+        const DirtyRegion damage = VerticalGradientDamage(painted, next);
+        if (!shelltabs::RepaintVerticalGradient(pixels.data(), kCapacityWidth, next, damage, cache)) {
+            PrintFailure(L"TestResizeSequenceBytesTouched", L"Repaint failed at step " + std::to_wstring(step));
+            return false;
+        }
+        painted = next;
+        fullBytes += static_cast<uint64_t>(next.width) * next.height * sizeof(uint32_t);
+        dirtyBytes += static_cast<uint64_t>(damage.Area()) * sizeof(uint32_t);
+
+        expected.assign(static_cast<size_t>(next.width) * next.height, 0);
+        FillGradient(expected.data(), next.width, next.height, next.width,
+                     GradientSpec{next.start, next.end, GradientDirection::kVertical});
+        for (uint32_t y = 0; y < next.height; ++y) {
+            const uint32_t* row = pixels.data() + static_cast<size_t>(y) * kCapacityWidth;
+            if (!std::equal(row, row + next.width, expected.data() + static_cast<size_t>(y) * next.width)) {
+                PrintFailure(L"TestResizeSequenceBytesTouched",
+                             L"Row " + std::to_wstring(y) + L" is stale after step " + std::to_wstring(step));
+                return false;
+            }
+        }
+    }
+
+    std::wcout << L"[TestResizeSequenceBytesTouched] " << sequence.size() << L" resizes: full repaints "
+               << fullBytes / 1024 << L" KiB, dirty regions " << dirtyBytes / 1024 << L" KiB (" << std::fixed
+               << std::setprecision(1) << 100.0 * static_cast<double>(dirtyBytes) / static_cast<double>(fullBytes)
+               << L"%)" << std::endl;
+    return dirtyBytes < fullBytes;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestNeighboursJoin", &TestNeighboursJoin},
+        {L"TestOverlapsCountedOnce", &TestOverlapsCountedOnce},
+        {L"TestCheapestPairMerges", &TestCheapestPairMerges},
+        {L"TestMergedRegionCoversEveryAddedPixel", &TestMergedRegionCoversEveryAddedPixel},
+        {L"TestGradientDamage", &TestGradientDamage},
+        {L"TestResizeSequenceBytesTouched", &TestResizeSequenceBytesTouched},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Dirty region tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Dirty region tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,209 @@
+#include "FolderBackgroundIndex.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::FolderBackgroundIndex;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+bool ExpectMatch(const wchar_t* testName, const FolderBackgroundIndex& index, const std::wstring& path,
+                 uint32_t expectedRule, bool expectedExact) {
+    const auto match = index.FindMostSpecific(path);
+    if (!match) {
+        PrintFailure(testName, L"No match for " + path);
+        return false;
+    }
+    if (match->ruleIndex != expectedRule || match->exact != expectedExact) {
+        PrintFailure(testName, L"Unexpected match for " + path + L": rule " +
+                                   std::to_wstring(match->ruleIndex));
+        return false;
+    }
+    return true;
+}
+
+bool ExpectNoMatch(const wchar_t* testName, const FolderBackgroundIndex& index, const std::wstring& path) {
+    if (index.FindMostSpecific(path)) {
+        PrintFailure(testName, L"Unexpected match for " + path);
+        return false;
+    }
+    return true;
+}
+
+bool TestExactMatchIsCaseInsensitive() {
+    FolderBackgroundIndex index;
+    index.Insert(L"c:\\users\\public", 0, false);
+
+    bool success = true;
+    success &= ExpectMatch(L"TestExactMatchIsCaseInsensitive", index, L"C:\\Users\\Public", 0, true);
+    success &= ExpectMatch(L"TestExactMatchIsCaseInsensitive", index, L"c:/users/public/", 0, true);
+    success &= ExpectNoMatch(L"TestExactMatchIsCaseInsensitive", index, L"c:\\users");
+    success &= ExpectNoMatch(L"TestExactMatchIsCaseInsensitive", index, L"c:\\users\\publicity");
+    return success;
+}
+
+bool TestSubfoldersInheritOnlyWhenRequested() {
+    FolderBackgroundIndex index;
+    index.Insert(L"c:\\projects", 0, true);
+    index.Insert(L"c:\\photos", 1, false);
+
+    bool success = true;
+    success &= ExpectMatch(L"TestSubfoldersInheritOnlyWhenRequested", index, L"c:\\projects\\shelltabs\\src", 0,
+                           false);
+    success &= ExpectNoMatch(L"TestSubfoldersInheritOnlyWhenRequested", index, L"c:\\photos\\2024");
+    success &= ExpectMatch(L"TestSubfoldersInheritOnlyWhenRequested", index, L"c:\\photos", 1, true);
+    return success;
+}
+
+bool TestMostSpecificRuleWins() {
+    FolderBackgroundIndex index;
+    index.Insert(L"d:\\", 0, true);
+    index.Insert(L"d:\\work", 1, true);
+    index.Insert(L"d:\\work\\client\\archive", 2, false);
+
+    bool success = true;
+    success &= ExpectMatch(L"TestMostSpecificRuleWins", index, L"d:\\music", 0, false);
+    success &= ExpectMatch(L"TestMostSpecificRuleWins", index, L"d:\\work\\client", 1, false);
+    success &= ExpectMatch(L"TestMostSpecificRuleWins", index, L"d:\\work\\client\\archive", 2, true);
+    success &= ExpectMatch(L"TestMostSpecificRuleWins", index, L"d:\\work\\client\\archive\\old", 1, false);
+    success &= ExpectNoMatch(L"TestMostSpecificRuleWins", index, L"e:\\work");
+    return success;
+}
+
+bool TestUncPathsAndRejectedInputs() {
+    FolderBackgroundIndex index;
+    bool success = true;
+    if (index.Insert(L"\\\\", 0, true)) {
+        PrintFailure(L"TestUncPathsAndRejectedInputs", L"Separator-only path was accepted");
+        success = false;
+    }
+    index.Insert(L"\\\\server\\share", 1, true);
+    success &= ExpectMatch(L"TestUncPathsAndRejectedInputs", index, L"\\\\SERVER\\share\\team", 1, false);
+    if (index.RuleCount() != 1) {
+        PrintFailure(L"TestUncPathsAndRejectedInputs", L"Unexpected rule count");
+        success = false;
+    }
+    return success;
+}
+
+bool TestMemoTracksGeneration() {
+    FolderBackgroundIndex index;
+    index.Insert(L"c:\\a", 0, true);
+
+    FolderBackgroundIndex::LookupMemo memo;
+    const auto first = index.Resolve(L"c:\\a\\b", &memo);
+    const auto cached = index.Resolve(L"c:\\a\\b", &memo);
+    bool success = true;
+    if (!first || !cached || first->ruleIndex != cached->ruleIndex) {
+        PrintFailure(L"TestMemoTracksGeneration", L"Memoized lookup diverged from direct lookup");
+        success = false;
+    }
+
+    index.Clear();
+    index.Insert(L"c:\\a\\b", 7, false);
+    const auto rebuilt = index.Resolve(L"c:\\a\\b", &memo);
+    if (!rebuilt || rebuilt->ruleIndex != 7 || !rebuilt->exact) {
+        PrintFailure(L"TestMemoTracksGeneration", L"Memo returned a result from a previous generation");
+        success = false;
+    }
+    return success;
+}
+
+bool TestCollidingEdgesKeepTheirParents() {
+    // Every edge probes from the same key, so siblings of different parents
+    // with the same name sit next to each other in one probe sequence.
+    FolderBackgroundIndex index;
+    index.SetEdgeKeyForTest([](uint32_t, uint64_t) -> uint64_t { return 42; });
+    index.Insert(L"c:\\alpha\\shared", 0, false);
+    index.Insert(L"c:\\beta\\shared", 1, true);
+
+    bool success = true;
+    success &= ExpectMatch(L"TestCollidingEdgesKeepTheirParents", index, L"c:\\alpha\\shared", 0, true);
+    success &= ExpectMatch(L"TestCollidingEdgesKeepTheirParents", index, L"c:\\beta\\shared", 1, true);
+    success &= ExpectMatch(L"TestCollidingEdgesKeepTheirParents", index, L"c:\\beta\\shared\\x", 1, false);
+    success &= ExpectNoMatch(L"TestCollidingEdgesKeepTheirParents", index, L"c:\\shared");
+    success &= ExpectNoMatch(L"TestCollidingEdgesKeepTheirParents", index, L"c:\\alpha\\shared\\x");
+    if (index.NodeCount() != 6) {
+        PrintFailure(L"TestCollidingEdgesKeepTheirParents",
+                     L"Expected one node per distinct edge, got " + std::to_wstring(index.NodeCount()));
+        success = false;
+    }
+    return success;
+}
+
+bool TestLookupCostIsIndependentOfRuleCount() {
+    FolderBackgroundIndex index;
+    uint32_t rule = 0;
+    for (int top = 0; top < 50; ++top) {
+        for (int child = 0; child < 40; ++child) {
+            const std::wstring path =
+                L"c:\\share" + std::to_wstring(top) + L"\\team" + std::to_wstring(child);
+            index.Insert(path, rule++, true);
+        }
+    }
+
+    const std::wstring probe = L"C:\\Share42\\Team17\\docs\\2024\\q3";
+    bool success = ExpectMatch(L"TestLookupCostIsIndependentOfRuleCount", index, probe, 42 * 40 + 17, false);
+
+    constexpr int kIterations = 200000;
+    const auto start = std::chrono::steady_clock::now();
+    size_t hits = 0;
+    for (int i = 0; i < kIterations; ++i) {
+        if (index.FindMostSpecific(probe)) {
+            ++hits;
+        }
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::wcout << L"[TestLookupCostIsIndependentOfRuleCount] " << index.RuleCount() << L" rules, "
+               << (elapsed.count() / kIterations) << L" ns/lookup" << std::endl;
+
+    if (hits != static_cast<size_t>(kIterations)) {
+        PrintFailure(L"TestLookupCostIsIndependentOfRuleCount", L"Lookups missed during benchmark");
+        success = false;
+    }
+    return success;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestExactMatchIsCaseInsensitive", &TestExactMatchIsCaseInsensitive},
+        {L"TestSubfoldersInheritOnlyWhenRequested", &TestSubfoldersInheritOnlyWhenRequested},
+        {L"TestMostSpecificRuleWins", &TestMostSpecificRuleWins},
+        {L"TestUncPathsAndRejectedInputs", &TestUncPathsAndRejectedInputs},
+        {L"TestMemoTracksGeneration", &TestMemoTracksGeneration},
+        {L"TestCollidingEdgesKeepTheirParents", &TestCollidingEdgesKeepTheirParents},
+        {L"TestLookupCostIsIndependentOfRuleCount", &TestLookupCostIsIndependentOfRuleCount},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Folder background index tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Folder background index tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "GdiResourceBudget.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using shelltabs::GdiBudgetLimits;
+using shelltabs::GdiBudgetPressure;
+using shelltabs::GdiBudgetShedResult;
+using shelltabs::GdiResourceBudget;
+using shelltabs::GdiResourceCost;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Stand-in for a cache: entries are released oldest first when the budget
+// asks for relief.
+class FakeCache {
+public:
+    FakeCache(GdiResourceBudget& budget, const wchar_t* name) : m_budget(budget) {
+        m_client = budget.RegisterClient(name, [this](const GdiResourceCost& excess) { return Shed(excess); });
+    }
+
+    ~FakeCache() { m_budget.UnregisterClient(m_client); }
+
+    void Add(size_t count, GdiResourceCost cost) {
+        for (size_t i = 0; i < count; ++i) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_entries.push_back(cost);
+            }
+            m_budget.Charge(m_client, cost);
+        }
+    }
+
+    size_t Size() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+private:
+    GdiBudgetShedResult Shed(const GdiResourceCost& excess) {
+        GdiBudgetShedResult result;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_entries.empty() &&
+               (result.freed.bytes < excess.bytes || result.freed.handles < excess.handles)) {
+            const GdiResourceCost cost = m_entries.front();
+            m_entries.pop_front();
+            m_budget.Credit(m_client, cost);
+            result.freed.bytes += cost.bytes;
+            result.freed.handles += cost.handles;
+            ++result.entries;
+        }
+        return result;
+    }
+
+    GdiResourceBudget& m_budget;
+    GdiResourceBudget::ClientHandle m_client;
+    std::mutex m_mutex;
+    std::deque<GdiResourceCost> m_entries;
+};
+
+GdiBudgetLimits TestLimits() {
+    GdiBudgetLimits limits;
+    limits.maxBytes = 64u * 1024u * 1024u;
+    limits.maxHandles = 500;
+    limits.minHandles = 50;
+    limits.processHandleQuota = 1000;
+    limits.softLimitFraction = 0.7;
+    limits.sampleInterval = std::chrono::milliseconds(0);
+    return limits;
+}
+
+// The rest of the process steadily leaks GDI handles; the caches' share
+// shrinks until it bottoms out at the configured minimum.
+bool TestHandleExhaustionShrinksBudget() {
+    GdiResourceBudget budget;
+    budget.SetLimits(TestLimits());
+    std::atomic<size_t> otherHandles{100};
+    budget.SetHandleCountProvider(
+        [&]() { return otherHandles.load() + budget.Counters().handles; });
+
+    std::vector<GdiBudgetPressure> events;
+    budget.SubscribePressure([&events](const GdiBudgetPressure& pressure) { events.push_back(pressure); });
+
+    FakeCache cache(budget, L"Fake");
+    cache.Add(300, {1024, 1});
+
+    bool success = true;
+    if (budget.Relieve() || cache.Size() != 300 || budget.Counters().handleLimit != 500) {
+        PrintFailure(L"TestHandleExhaustionShrinksBudget", L"Shed while the process had headroom");
+        success = false;
+    }
+
+    otherHandles = 600;
+    if (!budget.Relieve() || cache.Size() != 90) {
+        PrintFailure(L"TestHandleExhaustionShrinksBudget",
+                     L"Expected shedding to 90 entries, have " + std::to_wstring(cache.Size()));
+        success = false;
+    }
+    if (events.size() != 1 || events[0].handleLimit != 100 || events[0].shed.entries != 210 ||
+        events[0].processHandles != 900) {
+        PrintFailure(L"TestHandleExhaustionShrinksBudget", L"Pressure callback reported unexpected numbers");
+        success = false;
+    }
+
+    otherHandles = 5000;
+    budget.Relieve();
+    const auto counters = budget.Counters();
+    if (cache.Size() != 45 || counters.handleLimit != 50 || counters.handles != 45 ||
+        counters.bytes != 45 * 1024) {
+        PrintFailure(L"TestHandleExhaustionShrinksBudget", L"Budget did not stop at the minimum share");
+        success = false;
+    }
+    if (counters.pressureEvents != 2 || counters.shedEntries != 255 || counters.shedHandles != 255 ||
+        counters.shedBytes != 255 * 1024) {
+        PrintFailure(L"TestHandleExhaustionShrinksBudget", L"Shed counters are inconsistent");
+        success = false;
+    }
+    return success;
+}
+
+bool TestByteLimitAsksHeaviestHandleUserFirst() {
+    GdiResourceBudget budget;
+    GdiBudgetLimits limits = TestLimits();
+    limits.maxBytes = 1000 * 1000;
+    budget.SetLimits(limits);
+    budget.SetHandleCountProvider(nullptr);
+
+    FakeCache previews(budget, L"Previews");
+    FakeCache icons(budget, L"Icons");
+    previews.Add(8, {100 * 1000, 1});
+    icons.Add(40, {10 * 1000, 2});
+
+    int notified = 0;
+    const uint64_t token = budget.SubscribePressure([&notified](const GdiBudgetPressure&) { ++notified; });
+    budget.UnsubscribePressure(token);
+
+    bool success = true;
+    if (!budget.Relieve() || notified != 0) {
+        PrintFailure(L"TestByteLimitAsksHeaviestHandleUserFirst", L"Relief did not run or reached a stale listener");
+        success = false;
+    }
+    if (previews.Size() != 8 || icons.Size() != 10 || budget.Counters().bytes > limits.maxBytes) {
+        PrintFailure(L"TestByteLimitAsksHeaviestHandleUserFirst",
+                     L"Unexpected victims: previews=" + std::to_wstring(previews.Size()) +
+                         L" icons=" + std::to_wstring(icons.Size()));
+        success = false;
+    }
+    return success;
+}
+
+bool TestConcurrentChargesBalance() {
+    GdiResourceBudget budget;
+    budget.SetLimits(TestLimits());
+    budget.SetHandleCountProvider(nullptr);
+    const auto client = budget.RegisterClient(L"Threads", nullptr);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&budget, client]() {
+            for (int i = 0; i < 10000; ++i) {
+                budget.Charge(client, {64, 1});
+                budget.Relieve();
+                budget.Credit(client, {64, 1});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto usage = budget.ClientUsage(client);
+    const auto counters = budget.Counters();
+    budget.UnregisterClient(client);
+    if (usage.bytes != 0 || usage.handles != 0 || counters.bytes != 0 || counters.handles != 0) {
+        PrintFailure(L"TestConcurrentChargesBalance", L"Charges and credits did not cancel out");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestHandleExhaustionShrinksBudget", &TestHandleExhaustionShrinksBudget},
+        {L"TestByteLimitAsksHeaviestHandleUserFirst", &TestByteLimitAsksHeaviestHandleUserFirst},
+        {L"TestConcurrentChargesBalance", &TestConcurrentChargesBalance},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"GDI resource budget tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"GDI resource budget tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,257 @@
+#include "GradientFill.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::FillGradient;
+using shelltabs::GradientColor;
+using shelltabs::GradientDirection;
+using shelltabs::GradientFillPath;
+using shelltabs::GradientSpec;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// The fill CompositionIntercept used before the kernels, minus the Windows
+// color macros.
+void ReferenceFill(uint32_t* pixels, int width, int height, GradientColor start, GradientColor end) {
+    const uint8_t alpha = 0xFF;
+    for (int y = 0; y < height; ++y) {
+        double ratio = static_cast<double>(y) / static_cast<double>(std::max(1, height - 1));
+        const uint8_t r =
+            static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(start.r + (end.r - start.r) * ratio)), 0, 255));
+        const uint8_t g =
+            static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(start.g + (end.g - start.g) * ratio)), 0, 255));
+        const uint8_t b =
+            static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround(start.b + (end.b - start.b) * ratio)), 0, 255));
+        const uint32_t pixel = (static_cast<uint32_t>(alpha) << 24) | (static_cast<uint32_t>(r) << 16) |
+                               (static_cast<uint32_t>(g) << 8) | b;
+        for (int x = 0; x < width; ++x) {
+            pixels[y * width + x] = pixel;
+        }
+    }
+}
+
+const wchar_t* PathName(GradientFillPath path) {
+    switch (path) {
+        case GradientFillPath::kScalar:
+            return L"scalar";
+        case GradientFillPath::kSse2:
+            return L"sse2";
+        case GradientFillPath::kAvx2:
+            return L"avx2";
+        default:
+            return L"auto";
+    }
+}
+
+std::vector<GradientFillPath> SupportedPaths() {
+    std::vector<GradientFillPath> paths;
+    for (GradientFillPath path : {GradientFillPath::kScalar, GradientFillPath::kSse2, GradientFillPath::kAvx2}) {
+        if (shelltabs::IsGradientFillPathSupported(path)) {
+            paths.push_back(path);
+        }
+    }
+    return paths;
+}
+
+uint32_t NextRandom(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+GradientColor RandomColor(uint32_t& state, bool opaque) {
+    GradientColor color;
+    color.r = static_cast<uint8_t>(NextRandom(state));
+    color.g = static_cast<uint8_t>(NextRandom(state));
+    color.b = static_cast<uint8_t>(NextRandom(state));
+    color.a = opaque ? 0xFF : static_cast<uint8_t>(NextRandom(state));
+    return color;
+}
+
+bool TestVerticalMatchesOriginal() {
+    struct Case {
+        GradientColor start;
+        GradientColor end;
+        int height;
+    };
+    // Exact halves the original rounds down through double error, then
+    // random pairs.
+    std::vector<Case> cases = {
+        {{0, 0, 0}, {45, 85, 165}, 11},
+        {{230, 231, 1}, {0, 1, 231}, 201},
+        {{10, 20, 30}, {10, 20, 30}, 7},
+        {{255, 0, 128}, {0, 255, 127}, 1},
+    };
+    uint32_t state = 42;
+    for (int i = 0; i < 60; ++i) {
+        for (int height : {2, 3, 11, 100, 255, 256, 1081}) {
+            cases.push_back({RandomColor(state, true), RandomColor(state, true), height});
+        }
+    }
+
+    constexpr int kWidth = 3;
+    for (const Case& test : cases) {
+        std::vector<uint32_t> expected(static_cast<size_t>(kWidth) * test.height);
+        ReferenceFill(expected.data(), kWidth, test.height, test.start, test.end);
+        for (GradientFillPath path : SupportedPaths()) {
+            std::vector<uint32_t> actual(expected.size());
+            GradientSpec spec{test.start, test.end, GradientDirection::kVertical};
+            if (!FillGradient(actual.data(), kWidth, test.height, kWidth, spec, path) || actual != expected) {
+                PrintFailure(L"TestVerticalMatchesOriginal",
+                             std::wstring(PathName(path)) + L" differs at height " + std::to_wstring(test.height));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TestPathsAgree() {
+    uint32_t state = 7;
+    for (GradientDirection direction :
+         {GradientDirection::kVertical, GradientDirection::kHorizontal, GradientDirection::kDiagonal}) {
+        for (uint32_t width : {1u, 3u, 7u, 9u, 17u, 33u, 70u}) {
+            const uint32_t height = width % 5 + 2;
+            const size_t stride = width + 3;
+            GradientSpec spec{RandomColor(state, false), RandomColor(state, false), direction};
+            std::vector<uint32_t> expected(stride * height, 0xDEADBEEFu);
+            FillGradient(expected.data(), width, height, stride, spec, GradientFillPath::kScalar);
+            for (size_t y = 0; y < height; ++y) {
+                for (size_t x = width; x < stride; ++x) {
+                    if (expected[y * stride + x] != 0xDEADBEEFu) {
+                        PrintFailure(L"TestPathsAgree", L"Row padding was written");
+                        return false;
+                    }
+                }
+            }
+            for (GradientFillPath path : SupportedPaths()) {
+                std::vector<uint32_t> actual(stride * height, 0xDEADBEEFu);
+                FillGradient(actual.data(), width, height, stride, spec, path);
+                if (actual != expected) {
+                    PrintFailure(L"TestPathsAgree",
+                                 std::wstring(PathName(path)) + L" differs at width " + std::to_wstring(width));
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool TestDirectionsAndAlpha() {
+    const GradientSpec horizontal{{200, 100, 0, 255}, {0, 100, 200, 51}, GradientDirection::kHorizontal};
+    std::vector<uint32_t> pixels(11 * 2);
+    FillGradient(pixels.data(), 11, 2, 11, horizontal);
+    // Start opaque; end at alpha 51 with channels premultiplied.
+    if (pixels[0] != 0xFFC86400u || pixels[10] != 0x33001428u || pixels[11] != pixels[0] ||
+        pixels[21] != pixels[10]) {
+        PrintFailure(L"TestDirectionsAndAlpha", L"Horizontal endpoints are wrong");
+        return false;
+    }
+    // Midpoint: channels 100, 100, 100 at alpha 153.
+    if (pixels[5] != 0x993C3C3Cu) {
+        PrintFailure(L"TestDirectionsAndAlpha", L"Horizontal midpoint is wrong");
+        return false;
+    }
+
+    const GradientSpec diagonal{{0, 0, 0}, {255, 255, 255}, GradientDirection::kDiagonal};
+    pixels.assign(4 * 3, 0);
+    FillGradient(pixels.data(), 4, 3, 4, diagonal);
+    // Anti-diagonals share a color; corners hold the endpoints.
+    if (pixels[0] != 0xFF000000u || pixels[11] != 0xFFFFFFFFu || pixels[1] != pixels[4] || pixels[6] != pixels[9] ||
+        pixels[3] == pixels[8]) {
+        PrintFailure(L"TestDirectionsAndAlpha", L"Diagonal layout is wrong");
+        return false;
+    }
+
+    if (FillGradient(nullptr, 4, 4, 4, diagonal) || FillGradient(pixels.data(), 4, 3, 3, diagonal) ||
+        FillGradient(pixels.data(), 0, 3, 4, diagonal)) {
+        PrintFailure(L"TestDirectionsAndAlpha", L"Invalid arguments should be rejected");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: a 1920x1080 overlay, the size of a maximized Explorer window's
+// scratch surface, filled by the original routine and by each path.
+bool TestThroughputBenchmark() {
+    constexpr int kWidth = 1920;
+    constexpr int kHeight = 1080;
+    constexpr double kMegapixels = kWidth * kHeight / 1'000'000.0;
+    std::vector<uint32_t> pixels(static_cast<size_t>(kWidth) * kHeight);
+    const GradientColor start{30, 60, 200};
+    const GradientColor end{220, 120, 20};
+
+    const auto best = [](auto&& fill) {
+        auto fastest = std::chrono::steady_clock::duration::max();
+        for (int run = 0; run < 3; ++run) {
+            const auto begin = std::chrono::steady_clock::now();
+            fill();
+            fastest = std::min(fastest, std::chrono::steady_clock::now() - begin);
+        }
+        return std::chrono::duration<double>(fastest).count();
+    };
+    const auto report = [&](const std::wstring& label, double seconds) {
+        std::wcout << L"[TestThroughputBenchmark] " << label << L": " << std::fixed << std::setprecision(2)
+                   << seconds * 1000.0 << L"ms, " << std::setprecision(0) << kMegapixels / seconds << L" MP/s"
+                   << std::endl;
+    };
+
+    report(L"original vertical", best([&] { ReferenceFill(pixels.data(), kWidth, kHeight, start, end); }));
+    for (GradientDirection direction :
+         {GradientDirection::kVertical, GradientDirection::kHorizontal, GradientDirection::kDiagonal}) {
+        const wchar_t* name = direction == GradientDirection::kVertical     ? L"vertical"
+                              : direction == GradientDirection::kHorizontal ? L"horizontal"
+                                                                             : L"diagonal";
+        for (GradientFillPath path : SupportedPaths()) {
+            const GradientSpec spec{start, end, direction};
+            report(std::wstring(PathName(path)) + L" " + name,
+                   best([&] { FillGradient(pixels.data(), kWidth, kHeight, kWidth, spec, path); }));
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestVerticalMatchesOriginal", &TestVerticalMatchesOriginal},
+        {L"TestPathsAgree", &TestPathsAgree},
+        {L"TestDirectionsAndAlpha", &TestDirectionsAndAlpha},
+        {L"TestThroughputBenchmark", &TestThroughputBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Gradient fill tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Gradient fill tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "GradientSpanCache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::FillGradient;
+using shelltabs::GradientColor;
+using shelltabs::GradientDirection;
+using shelltabs::GradientSpanCache;
+using shelltabs::GradientSpec;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+constexpr GradientColor kBlue{30, 60, 200, 255};
+constexpr GradientColor kOrange{220, 120, 20, 255};
+constexpr GradientColor kTranslucentOrange{220, 120, 20, 96};
+
+bool TestFillMatchesFillGradient() {
+    GradientSpanCache cache;
+    for (GradientDirection direction :
+         {GradientDirection::kVertical, GradientDirection::kHorizontal, GradientDirection::kDiagonal}) {
+        for (uint32_t size : {1u, 5u, 37u}) {
+            const uint32_t width = size;
+            const uint32_t height = size + 3;
+            const size_t stride = width + 2;
+            const GradientSpec spec{kBlue, kTranslucentOrange, direction};
+            std::vector<uint32_t> expected(stride * height, 0x12345678u);
+            std::vector<uint32_t> actual(expected);
+            FillGradient(expected.data(), width, height, stride, spec);
+            // Twice, so the second fill comes from the cached ramp.
+            for (int pass = 0; pass < 2; ++pass) {
+                if (!cache.Fill(actual.data(), width, height, stride, spec) || actual != expected) {
+                    PrintFailure(L"TestFillMatchesFillGradient", L"Cached fill differs at size " + std::to_wstring(size));
+                    return false;
+                }
+            }
+        }
+    }
+    if (cache.Fill(nullptr, 4, 4, 4, GradientSpec{}) || cache.Fill(nullptr, 0, 4, 4, GradientSpec{})) {
+        PrintFailure(L"TestFillMatchesFillGradient", L"Invalid arguments should be rejected");
+        return false;
+    }
+    return true;
+}
+
+bool TestSpansAreShared() {
+    GradientSpanCache cache;
+    std::vector<uint32_t> tall(3 * 120);
+    std::vector<uint32_t> wide(120 * 2);
+    // A vertical gradient 120 rows tall and a horizontal one 120 columns wide
+    // interpolate along the same ramp.
+    cache.Fill(tall.data(), 3, 120, 3, GradientSpec{kBlue, kOrange, GradientDirection::kVertical});
+    cache.Fill(wide.data(), 120, 2, 120, GradientSpec{kBlue, kOrange, GradientDirection::kHorizontal});
+    const auto first = cache.Acquire(kBlue, kOrange, 120);
+    const auto second = cache.Acquire(kBlue, kOrange, 120);
+
+    const auto stats = cache.Stats();
+    if (first != second || stats.hits != 3 || stats.misses != 1 || stats.spans != 1 ||
+        stats.residentBytes != 120 * sizeof(uint32_t)) {
+        PrintFailure(L"TestSpansAreShared", L"Expected one ramp serving every request");
+        return false;
+    }
+    if (cache.Acquire(kBlue, kTranslucentOrange, 120) == first || cache.Acquire(kBlue, kOrange, 121) == first ||
+        cache.Acquire(kBlue, kOrange, 0)) {
+        PrintFailure(L"TestSpansAreShared", L"Different colors or lengths must not share a ramp");
+        return false;
+    }
+    return true;
+}
+
+bool TestBudgetEvictsLeastRecentlyUsed() {
+    constexpr size_t kSpanBytes = 100 * sizeof(uint32_t);
+    GradientSpanCache cache(3 * kSpanBytes);
+    const GradientColor colors[] = {{1, 0, 0}, {2, 0, 0}, {3, 0, 0}, {4, 0, 0}};
+    for (const GradientColor& color : colors) {
+        cache.Acquire(color, kOrange, 100);
+        // Keep the first one warm.
+        cache.Acquire(colors[0], kOrange, 100);
+    }
+
+    auto stats = cache.Stats();
+    if (stats.spans != 3 || stats.evictions != 1 || stats.residentBytes != 3 * kSpanBytes) {
+        PrintFailure(L"TestBudgetEvictsLeastRecentlyUsed", L"Expected one eviction at the budget");
+        return false;
+    }
+    const uint64_t misses = stats.misses;
+    cache.Acquire(colors[0], kOrange, 100);
+    cache.Acquire(colors[1], kOrange, 100);
+    if (cache.Stats().misses != misses + 1) {
+        PrintFailure(L"TestBudgetEvictsLeastRecentlyUsed", L"The least recently used ramp should have gone");
+        return false;
+    }
+
+    // Larger than the whole budget: built, returned, not kept.
+    const auto huge = cache.Acquire(kBlue, kOrange, 1000);
+    if (!huge || huge->size() != 1000 || cache.Stats().residentBytes > 3 * kSpanBytes) {
+        PrintFailure(L"TestBudgetEvictsLeastRecentlyUsed", L"Oversized ramps should bypass the cache");
+        return false;
+    }
+
+    cache.SetBudget(kSpanBytes);
+    stats = cache.Stats();
+    if (stats.spans != 1 || stats.residentBytes != kSpanBytes) {
+        PrintFailure(L"TestBudgetEvictsLeastRecentlyUsed", L"Lowering the budget should trim");
+        return false;
+    }
+    cache.Clear();
+    if (cache.Stats().spans != 0 || cache.Stats().residentBytes != 0) {
+        PrintFailure(L"TestBudgetEvictsLeastRecentlyUsed", L"Clear should empty the cache");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: a details-view paint draws a 1px line and a 3px halo down every
+// column, 1000px tall, in the window's color set. Eight columns across three
+// windows sharing two color sets, repainted 50 times, filled with a ramp
+// rebuilt per rect as before and through the cache.
+bool TestGlowLineBenchmark() {
+    constexpr uint32_t kHeight = 1000;
+    constexpr int kRepaints = 50;
+    constexpr int kWindows = 3;
+    constexpr int kColumns = 8;
+    const GradientColor windowColors[kWindows][2] = {
+        {kBlue, kOrange},
+        {kBlue, kOrange},
+        {{10, 200, 90, 255}, {90, 10, 200, 255}},
+    };
+    std::vector<uint32_t> pixels(3 * kHeight);
+
+    const auto paintAll = [&](auto&& fill) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int repaint = 0; repaint < kRepaints; ++repaint) {
+            for (int window = 0; window < kWindows; ++window) {
+                for (int column = 0; column < kColumns; ++column) {
+                    // The halo and line are drawn at their own alpha.
+                    for (auto [width, alpha] : {std::pair<uint32_t, uint8_t>{3, 80}, {1, 200}}) {
+                        GradientColor start = windowColors[window][0];
+                        GradientColor end = windowColors[window][1];
+                        start.a = alpha;
+                        end.a = alpha;
+                        fill(width, GradientSpec{start, end, GradientDirection::kVertical});
+                    }
+                }
+            }
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    const double uncachedMs = paintAll([&](uint32_t width, const GradientSpec& spec) {
+        FillGradient(pixels.data(), width, kHeight, width, spec);
+    });
+    GradientSpanCache cache;
+    const double cachedMs = paintAll([&](uint32_t width, const GradientSpec& spec) {
+        cache.Fill(pixels.data(), width, kHeight, width, spec);
+    });
+
+    const auto stats = cache.Stats();
+    const double fills = static_cast<double>(stats.hits + stats.misses);
+    if (stats.misses != 4) {
+        PrintFailure(L"TestGlowLineBenchmark", L"Expected one miss per color set and alpha");
+        return false;
+    }
+    std::wcout << L"[TestGlowLineBenchmark] " << static_cast<uint64_t>(fills) << L" fills: rebuilt ramps "
+               << std::fixed << std::setprecision(2) << uncachedMs << L"ms, cached " << cachedMs << L"ms; hit rate "
+               << std::setprecision(1) << 100.0 * static_cast<double>(stats.hits) / fills << L"%, "
+               << stats.residentBytes << L" bytes resident" << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestFillMatchesFillGradient", &TestFillMatchesFillGradient},
+        {L"TestSpansAreShared", &TestSpansAreShared},
+        {L"TestBudgetEvictsLeastRecentlyUsed", &TestBudgetEvictsLeastRecentlyUsed},
+        {L"TestGlowLineBenchmark", &TestGlowLineBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Gradient span cache tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Gradient span cache tests passed." << std::endl;
+    return 0;
+}
@@ -1,10 +1,14 @@
+#include "GdiResourceBudget.h"
 #include "IconCache.h"
 
 #include <windows.h>
 #include <shellapi.h>
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace {
@@ -100,11 +104,284 @@ bool TestInvalidateFamilyScalesWithIndex() {
     return true;
 }
 
+bool TestConcurrentMissesShareOneLoad() {
+    auto& cache = shelltabs::IconCache::Instance();
+    const shelltabs::IconCache::Stats before = cache.GetStats();
+
+    constexpr size_t kThreads = 8;
+    std::atomic<int> loads{0};
+    auto slowLoader = [&loads]() -> HICON {
+        ++loads;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return DuplicateStockIcon();
+    };
+
+    std::vector<shelltabs::IconCache::Reference> results(kThreads);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreads; ++i) {
+        threads.emplace_back([&, i]() {
+            results[i] = cache.Acquire(L"SingleflightFamily", SHGFI_SMALLICON, slowLoader);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    bool success = true;
+    if (loads.load() != 1) {
+        PrintFailure(L"TestConcurrentMissesShareOneLoad",
+                     L"Loader ran " + std::to_wstring(loads.load()) + L" times for one variant");
+        success = false;
+    }
+    for (const auto& result : results) {
+        if (!result || result.Get() != results[0].Get()) {
+            PrintFailure(L"TestConcurrentMissesShareOneLoad", L"Callers did not share the loaded icon");
+            success = false;
+            break;
+        }
+    }
+
+    const shelltabs::IconCache::Stats after = cache.GetStats();
+    const uint64_t served = (after.misses - before.misses) + (after.coalesced - before.coalesced) +
+                            (after.hits - before.hits);
+    if (after.misses - before.misses != 1 || served != kThreads) {
+        PrintFailure(L"TestConcurrentMissesShareOneLoad", L"Counters do not account for every request");
+        success = false;
+    }
+
+    results.clear();
+    cache.InvalidateFamily(L"SingleflightFamily");
+    return success;
+}
+
+bool TestNullLoadsAreNegativelyCached() {
+    auto& cache = shelltabs::IconCache::Instance();
+    cache.DebugSetNegativeTtl(std::chrono::milliseconds(100));
+
+    int loads = 0;
+    auto failingLoader = [&loads]() -> HICON {
+        ++loads;
+        return nullptr;
+    };
+    const std::wstring family = L"NegativeFamily";
+    const shelltabs::IconCache::Stats before = cache.GetStats();
+
+    bool success = true;
+    if (cache.Acquire(family, SHGFI_SMALLICON, failingLoader) ||
+        cache.Acquire(family, SHGFI_SMALLICON, failingLoader) || loads != 1) {
+        PrintFailure(L"TestNullLoadsAreNegativelyCached", L"Failed load was retried inside the TTL");
+        success = false;
+    }
+    if (cache.GetStats().negativeHits - before.negativeHits != 1) {
+        PrintFailure(L"TestNullLoadsAreNegativelyCached", L"Negative hit was not counted");
+        success = false;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    cache.Acquire(family, SHGFI_SMALLICON, failingLoader);
+    if (loads != 2) {
+        PrintFailure(L"TestNullLoadsAreNegativelyCached", L"Negative entry outlived its TTL");
+        success = false;
+    }
+
+    cache.InvalidateFamily(family);
+    shelltabs::IconCache::Reference recovered =
+        cache.Acquire(family, SHGFI_SMALLICON, []() -> HICON { return DuplicateStockIcon(); });
+    if (!recovered) {
+        PrintFailure(L"TestNullLoadsAreNegativelyCached", L"Invalidation did not clear the negative entry");
+        success = false;
+    }
+
+    recovered.Reset();
+    cache.InvalidateFamily(family);
+    cache.DebugSetNegativeTtl(shelltabs::IconCache::kDefaultNegativeTtl);
+    return success;
+}
+
+bool TestEvictionPoliciesKeepPinnedEntries() {
+    auto& cache = shelltabs::IconCache::Instance();
+    auto loader = []() -> HICON { return DuplicateStockIcon(); };
+
+    bool success = true;
+    for (shelltabs::CacheEvictionPolicy policy : shelltabs::kCacheEvictionPolicies) {
+        const std::string policyName = shelltabs::CacheEvictionPolicyName(policy);
+        const std::wstring name(policyName.begin(), policyName.end());
+        cache.SetEvictionPolicy(policy);
+        cache.DebugSetCapacity(16);
+
+        shelltabs::IconCache::Reference pinned = cache.Acquire(L"PinnedFamily", SHGFI_SMALLICON, loader);
+        for (size_t i = 0; i < 500; ++i) {
+            cache.Acquire(L"ChurnFamily" + std::to_wstring(i), SHGFI_SMALLICON, loader);
+        }
+
+        bool reloaded = false;
+        shelltabs::IconCache::Reference again =
+            cache.Acquire(L"PinnedFamily", SHGFI_SMALLICON, [&reloaded]() -> HICON {
+                reloaded = true;
+                return DuplicateStockIcon();
+            });
+        if (!pinned || reloaded || again.Get() != pinned.Get()) {
+            PrintFailure(L"TestEvictionPoliciesKeepPinnedEntries", name + L" evicted a referenced entry");
+            success = false;
+        }
+        if (cache.GetStats().size > 16) {
+            PrintFailure(L"TestEvictionPoliciesKeepPinnedEntries", name + L" grew past its capacity");
+            success = false;
+        }
+
+        again.Reset();
+        pinned.Reset();
+        cache.InvalidateFamily(L"PinnedFamily");
+    }
+
+    cache.SetEvictionPolicy(shelltabs::CacheEvictionPolicy::kLru);
+    cache.DebugSetCapacity(128);
+    return success;
+}
+
+// Pretends the rest of Explorer has nearly exhausted its GDI quota; the
+// shared budget must squeeze the icon cache down to its minimum share.
+bool TestHandlePressureShedsColdIcons() {
+    auto& cache = shelltabs::IconCache::Instance();
+    auto& budget = shelltabs::GdiResourceBudget::Instance();
+    const shelltabs::GdiBudgetLimits originalLimits = budget.Limits();
+
+    shelltabs::GdiBudgetLimits limits = originalLimits;
+    limits.minHandles = 8;
+    limits.processHandleQuota = 1000;
+    limits.sampleInterval = std::chrono::milliseconds(0);
+    budget.SetLimits(limits);
+    budget.SetHandleCountProvider([]() -> size_t { return 5000; });
+
+    size_t pressureEvents = 0;
+    const uint64_t token =
+        budget.SubscribePressure([&pressureEvents](const shelltabs::GdiBudgetPressure&) { ++pressureEvents; });
+
+    auto loader = []() -> HICON { return DuplicateStockIcon(); };
+    shelltabs::IconCache::Reference pinned = cache.Acquire(L"PressurePinned", SHGFI_SMALLICON, loader);
+    for (size_t i = 0; i < 200; ++i) {
+        cache.Acquire(L"PressureFamily" + std::to_wstring(i), SHGFI_SMALLICON, loader);
+    }
+
+    bool success = true;
+    const auto counters = budget.Counters();
+    if (pressureEvents == 0 || counters.handleLimit != limits.minHandles) {
+        PrintFailure(L"TestHandlePressureShedsColdIcons", L"Budget did not react to handle exhaustion");
+        success = false;
+    }
+    if (counters.handles > limits.minHandles + 2 || cache.GetStats().size > limits.minHandles / 2 + 1) {
+        PrintFailure(L"TestHandlePressureShedsColdIcons",
+                     L"Icon cache kept " + std::to_wstring(cache.GetStats().size) + L" entries under pressure");
+        success = false;
+    }
+    if (!pinned || cache.Acquire(L"PressurePinned", SHGFI_SMALLICON, []() -> HICON { return nullptr; }).Get() !=
+                       pinned.Get()) {
+        PrintFailure(L"TestHandlePressureShedsColdIcons", L"Pressure shed a referenced icon");
+        success = false;
+    }
+
+    pinned.Reset();
+    cache.InvalidateFamily(L"PressurePinned");
+    budget.UnsubscribePressure(token);
+    budget.SetHandleCountProvider(nullptr);
+    budget.SetLimits(originalLimits);
+    return success;
+}
+
+// Several threads hammer a shared working set, copying and dropping
+// references the way tab rendering does, while one thread keeps invalidating
+// families. Prints throughput per thread count so contention regressions show
+// up in the log; the checks only assert that every request was served.
+bool TestConcurrentAcquireThroughput() {
+    auto& cache = shelltabs::IconCache::Instance();
+    cache.DebugSetCapacity(4096);
+
+    constexpr size_t kFamilies = 512;
+    constexpr size_t kOperationsPerThread = 20000;
+    std::vector<std::wstring> families;
+    families.reserve(kFamilies);
+    for (size_t i = 0; i < kFamilies; ++i) {
+        families.push_back(L"ThroughputFamily" + std::to_wstring(i));
+    }
+    auto loader = []() -> HICON { return DuplicateStockIcon(); };
+
+    bool success = true;
+    double singleThreadRate = 0.0;
+    for (size_t threadCount : {1u, 2u, 4u, 8u}) {
+        std::atomic<size_t> failures{0};
+        std::atomic<bool> go{false};
+        std::vector<std::thread> threads;
+        threads.reserve(threadCount);
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t]() {
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                std::vector<shelltabs::IconCache::Reference> held;
+                held.reserve(8);
+                uint32_t state = static_cast<uint32_t>(t) * 2654435761u + 1u;
+                for (size_t op = 0; op < kOperationsPerThread; ++op) {
+                    state = state * 1664525u + 1013904223u;
+                    const std::wstring& family = families[(state >> 8) % kFamilies];
+                    const UINT flags = (state & 1u) != 0 ? SHGFI_LARGEICON : SHGFI_SMALLICON;
+                    if (t == 0 && threadCount > 1 && op % 64 == 0) {
+                        cache.InvalidateFamily(family);
+                        continue;
+                    }
+                    shelltabs::IconCache::Reference icon = cache.Acquire(family, flags, loader);
+                    if (!icon) {
+                        failures.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    if (held.size() == held.capacity()) {
+                        held.erase(held.begin());
+                    }
+                    held.push_back(icon);
+                }
+            });
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double rate = elapsed > 0.0 ? (threadCount * kOperationsPerThread) / elapsed : 0.0;
+        if (threadCount == 1) {
+            singleThreadRate = rate;
+        }
+        std::wcout << L"[TestConcurrentAcquireThroughput] threads=" << threadCount << L" ops/s="
+                   << static_cast<uint64_t>(rate) << L" scaling="
+                   << (singleThreadRate > 0.0 ? rate / singleThreadRate : 0.0) << std::endl;
+
+        if (failures.load() != 0) {
+            PrintFailure(L"TestConcurrentAcquireThroughput",
+                         L"Acquire failed " + std::to_wstring(failures.load()) + L" times with " +
+                             std::to_wstring(threadCount) + L" threads");
+            success = false;
+        }
+    }
+
+    for (const auto& family : families) {
+        cache.InvalidateFamily(family);
+    }
+    cache.DebugSetCapacity(128);
+    cache.LogStatsNow();
+    return success;
+}
+
 }  // namespace
 
 int wmain() {
     const std::vector<TestDefinition> tests = {
         {L"TestInvalidateFamilyScalesWithIndex", &TestInvalidateFamilyScalesWithIndex},
+        {L"TestConcurrentMissesShareOneLoad", &TestConcurrentMissesShareOneLoad},
+        {L"TestNullLoadsAreNegativelyCached", &TestNullLoadsAreNegativelyCached},
+        {L"TestEvictionPoliciesKeepPinnedEntries", &TestEvictionPoliciesKeepPinnedEntries},
+        {L"TestHandlePressureShedsColdIcons", &TestHandlePressureShedsColdIcons},
+        {L"TestConcurrentAcquireThroughput", &TestConcurrentAcquireThroughput},
     };
 
     bool success = true;
@@ -0,0 +1,90 @@
+#include "OptionsStore.h"
+#include "StringUtils.h"
+#include "Utilities.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace shelltabs {
+namespace {
+
+void AppendWideCodePoint(std::wstring* out, uint32_t codePoint) {
+    if constexpr (sizeof(wchar_t) == 2) {
+        if (codePoint >= 0x10000) {
+            codePoint -= 0x10000;
+            out->push_back(static_cast<wchar_t>(0xD800 + (codePoint >> 10)));
+            out->push_back(static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF)));
+            return;
+        }
+    }
+    out->push_back(static_cast<wchar_t>(codePoint));
+}
+
+}  // namespace
+
+// Decodes like MultiByteToWideChar(CP_UTF8, 0, ...): each malformed sequence
+// becomes U+FFFD.
+std::wstring Utf8ToWide(std::string_view utf8) {
+    std::wstring result;
+    result.reserve(utf8.size());
+    size_t i = 0;
+    while (i < utf8.size()) {
+        const uint8_t lead = static_cast<uint8_t>(utf8[i]);
+        size_t length = 0;
+        uint32_t codePoint = 0;
+        uint32_t minimum = 0;
+        if (lead < 0x80) {
+            result.push_back(static_cast<wchar_t>(lead));
+            ++i;
+            continue;
+        } else if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+            codePoint = lead & 0x1F;
+            minimum = 0x80;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            codePoint = lead & 0x0F;
+            minimum = 0x800;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            codePoint = lead & 0x07;
+            minimum = 0x10000;
+        }
+
+        size_t consumed = 1;
+        while (length > 0 && consumed < length && i + consumed < utf8.size() &&
+               (static_cast<uint8_t>(utf8[i + consumed]) & 0xC0) == 0x80) {
+            codePoint = (codePoint << 6) | (static_cast<uint8_t>(utf8[i + consumed]) & 0x3F);
+            ++consumed;
+        }
+        if (length == 0 || consumed != length || codePoint < minimum || codePoint > 0x10FFFF ||
+            (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+            result.push_back(static_cast<wchar_t>(0xFFFD));
+        } else {
+            AppendWideCodePoint(&result, codePoint);
+        }
+        i += consumed;
+    }
+    return result;
+}
+
+// Slashes become backslashes and a trailing backslash is dropped unless it
+// belongs to a drive root, as PathCchRemoveBackslashEx does.
+std::wstring NormalizeFileSystemPath(const std::wstring& path) {
+    std::wstring normalized = path;
+    for (wchar_t& ch : normalized) {
+        if (ch == L'/') {
+            ch = L'\\';
+        }
+    }
+    const bool driveRoot = normalized.size() == 3 && normalized[1] == L':';
+    if (normalized.size() > 1 && normalized.back() == L'\\' && !driveRoot) {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+std::wstring NormalizeContextMenuIconSource(const std::wstring& iconSource) { return Trim(iconSource); }
+
+}  // namespace shelltabs
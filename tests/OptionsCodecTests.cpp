@@ -0,0 +1,253 @@
+#include "OptionsCodec.h"
+
+#include <windows.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef SHELLTABS_TEST_GOLDEN_DIR
+#define SHELLTABS_TEST_GOLDEN_DIR "tests/golden"
+#endif
+
+namespace {
+
+using shelltabs::ShellTabsOptions;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+const std::wstring kStorageDirectory = L"C:\\ShellTabsData";
+
+// tests/golden/options_v3.db was written by the OptionsStore::Save that
+// predates the codec, from a store loaded with every kind of record, so
+// matching it byte for byte keeps the on-disk format unchanged.
+bool ReadGoldenDocument(std::string* document) {
+    std::ifstream file(std::string(SHELLTABS_TEST_GOLDEN_DIR) + "/options_v3.db", std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    document->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+std::wstring Narrow(std::string_view text) { return std::wstring(text.begin(), text.end()); }
+
+bool TestGoldenDocumentRoundTrips() {
+    std::string golden;
+    if (!ReadGoldenDocument(&golden)) {
+        PrintFailure(L"TestGoldenDocumentRoundTrips", L"Missing or unreadable options_v3.db golden");
+        return false;
+    }
+    const ShellTabsOptions options = shelltabs::ParseOptionsDocument(golden, kStorageDirectory);
+    const std::string serialized = shelltabs::SerializeOptionsDocument(options, kStorageDirectory);
+    if (serialized != golden) {
+        PrintFailure(L"TestGoldenDocumentRoundTrips", L"Serialized document differs from golden:\n" +
+                                                         Narrow(serialized));
+        return false;
+    }
+
+    bool success = true;
+    if (options.newTabCustomPath != L"D:\\W\u00F6rk" ||
+        options.universalFolderBackgroundImage.displayName != L"Universal \U0001F600") {
+        PrintFailure(L"TestGoldenDocumentRoundTrips", L"Non-ASCII values were not decoded");
+        success = false;
+    }
+    if (options.contextMenuItems.size() != 3 || options.contextMenuItems[1].children.size() != 3 ||
+        options.contextMenuItems[1].children[2].children.size() != 0) {
+        PrintFailure(L"TestGoldenDocumentRoundTrips", L"Context menu tree was not rebuilt");
+        success = false;
+    }
+    if (options.folderBackgroundEntries.size() != 2 ||
+        options.folderBackgroundEntries[0].folderPath != L"C:\\Photos" ||
+        options.folderBackgroundEntries[1].image.displayName != L"Work") {
+        PrintFailure(L"TestGoldenDocumentRoundTrips", L"Folder background entries were not parsed");
+        success = false;
+    }
+    return success;
+}
+
+bool TestSubfolderFlagIsWrittenOnlyWhenSet() {
+    ShellTabsOptions options;
+    shelltabs::FolderBackgroundEntry inherited;
+    inherited.folderPath = L"C:\\Photos";
+    inherited.image.cachedImagePath = kStorageDirectory + L"\\bg\\a.png";
+    inherited.image.displayName = L"Photos";
+    inherited.applyToSubfolders = true;
+    shelltabs::FolderBackgroundEntry exact = inherited;
+    exact.folderPath = L"D:\\Work";
+    exact.applyToSubfolders = false;
+    options.folderBackgroundEntries = {inherited, exact};
+
+    const std::string serialized = shelltabs::SerializeOptionsDocument(options, kStorageDirectory);
+    if (serialized.find("folder_background_entry|C:\\Photos|C:\\ShellTabsData\\bg\\a.png|Photos|1\n") ==
+            std::string::npos ||
+        serialized.find("folder_background_entry|D:\\Work|C:\\ShellTabsData\\bg\\a.png|Photos\n") ==
+            std::string::npos) {
+        PrintFailure(L"TestSubfolderFlagIsWrittenOnlyWhenSet", L"Unexpected entries:\n" + Narrow(serialized));
+        return false;
+    }
+
+    const ShellTabsOptions parsed = shelltabs::ParseOptionsDocument(serialized, kStorageDirectory);
+    if (parsed.folderBackgroundEntries.size() != 2 || !parsed.folderBackgroundEntries[0].applyToSubfolders ||
+        parsed.folderBackgroundEntries[1].applyToSubfolders) {
+        PrintFailure(L"TestSubfolderFlagIsWrittenOnlyWhenSet", L"Subfolder flag did not round trip");
+        return false;
+    }
+    return true;
+}
+
+bool TestExtraTokensAreIgnored() {
+    // The longest record with trailing tokens from a newer writer: the fields
+    // it has must still land, whatever follows them.
+    std::string document = "context_menu_command|Run|cmd.exe|/c|||0|0|0|default|1|0|0|1|1|1|||About|run-id";
+    for (int i = 0; i < 40; ++i) {
+        document += "|extra" + std::to_string(i);
+    }
+    document += "\ntab_docking|right|extra|extra\n";
+
+    const ShellTabsOptions options = shelltabs::ParseOptionsDocument(document, kStorageDirectory);
+    if (options.contextMenuItems.size() != 1 || options.contextMenuItems[0].id != L"run-id" ||
+        options.contextMenuItems[0].description != L"About") {
+        PrintFailure(L"TestExtraTokensAreIgnored", L"Trailing fields of a long record were dropped");
+        return false;
+    }
+    if (options.tabDockMode != shelltabs::TabBandDockMode::kRight) {
+        PrintFailure(L"TestExtraTokensAreIgnored", L"Record with extra tokens was not applied");
+        return false;
+    }
+    return true;
+}
+
+bool TestTolerantParsing() {
+    constexpr std::string_view document =
+        "\xEF\xBB\xBF# comment\r\n"
+        "\r\n"
+        "  reopen_on_crash | no \r\n"
+        "unknown_key|1|2\r\n"
+        "breadcrumb_gradient_transparency|250\r\n"
+        "breadcrumb_font_transparency|50\r\n"
+        "breadcrumb_gradient_colors|yes|0x10203|not-a-color\r\n"
+        "folder_background_universal|E:\\outside\\image.png|Ignored\r\n"
+        "context_menu_end\r\n"
+        "tab_docking|bottom";
+
+    const ShellTabsOptions defaults;
+    const ShellTabsOptions options = shelltabs::ParseOptionsDocument(document, kStorageDirectory);
+
+    bool success = true;
+    if (options.reopenOnCrash) {
+        PrintFailure(L"TestTolerantParsing", L"Padded boolean was not parsed");
+        success = false;
+    }
+    if (options.breadcrumbGradientTransparency != 100) {
+        PrintFailure(L"TestTolerantParsing", L"Out of range value was not clamped");
+        success = false;
+    }
+    if (options.breadcrumbFontBrightness != defaults.breadcrumbFontBrightness / 2) {
+        PrintFailure(L"TestTolerantParsing", L"Legacy font transparency was not migrated");
+        success = false;
+    }
+    if (!options.useCustomBreadcrumbGradientColors || options.breadcrumbGradientStartColor != RGB(0x01, 0x02, 0x03) ||
+        options.breadcrumbGradientEndColor != defaults.breadcrumbGradientEndColor) {
+        PrintFailure(L"TestTolerantParsing", L"Gradient colors were not parsed with fallback");
+        success = false;
+    }
+    if (!options.universalFolderBackgroundImage.cachedImagePath.empty()) {
+        PrintFailure(L"TestTolerantParsing", L"Cache path outside the storage directory was accepted");
+        success = false;
+    }
+    if (options.tabDockMode != shelltabs::TabBandDockMode::kBottom) {
+        PrintFailure(L"TestTolerantParsing", L"Final line without newline was skipped");
+        success = false;
+    }
+    return success;
+}
+
+bool TestParseAndWriteThroughput() {
+    ShellTabsOptions options;
+    for (int i = 0; i < 2000; ++i) {
+        shelltabs::FolderBackgroundEntry entry;
+        entry.folderPath = L"D:\\Projects\\Folder" + std::to_wstring(i);
+        entry.image.cachedImagePath = kStorageDirectory + L"\\bg\\" + std::to_wstring(i) + L".png";
+        entry.image.displayName = L"Image " + std::to_wstring(i);
+        options.folderBackgroundEntries.push_back(std::move(entry));
+    }
+    for (int i = 0; i < 300; ++i) {
+        shelltabs::ContextMenuItem item;
+        item.type = shelltabs::ContextMenuItemType::kCommand;
+        item.label = L"Command " + std::to_wstring(i);
+        item.executable = L"notepad.exe";
+        item.arguments = L"%1";
+        options.contextMenuItems.push_back(std::move(item));
+    }
+
+    const std::string document = shelltabs::SerializeOptionsDocument(options, kStorageDirectory);
+
+    constexpr int kIterations = 20;
+    size_t parsedEntries = 0;
+    const auto parseStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        parsedEntries += shelltabs::ParseOptionsDocument(document, kStorageDirectory).folderBackgroundEntries.size();
+    }
+    const auto writeStart = std::chrono::steady_clock::now();
+    size_t writtenBytes = 0;
+    for (int i = 0; i < kIterations; ++i) {
+        writtenBytes += shelltabs::SerializeOptionsDocument(options, kStorageDirectory).size();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    const auto parseMicros =
+        std::chrono::duration_cast<std::chrono::microseconds>(writeStart - parseStart).count() / kIterations;
+    const auto writeMicros =
+        std::chrono::duration_cast<std::chrono::microseconds>(end - writeStart).count() / kIterations;
+    std::wcout << L"[TestParseAndWriteThroughput] " << document.size() << L" bytes, parse " << parseMicros
+               << L" us, write " << writeMicros << L" us" << std::endl;
+
+    if (parsedEntries != options.folderBackgroundEntries.size() * kIterations ||
+        writtenBytes != document.size() * kIterations) {
+        PrintFailure(L"TestParseAndWriteThroughput", L"Benchmark iterations produced inconsistent output");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestGoldenDocumentRoundTrips", &TestGoldenDocumentRoundTrips},
+        {L"TestSubfolderFlagIsWrittenOnlyWhenSet", &TestSubfolderFlagIsWrittenOnlyWhenSet},
+        {L"TestExtraTokensAreIgnored", &TestExtraTokensAreIgnored},
+        {L"TestTolerantParsing", &TestTolerantParsing},
+        {L"TestParseAndWriteThroughput", &TestParseAndWriteThroughput},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Options codec tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Options codec tests passed." << std::endl;
+    return 0;
+}
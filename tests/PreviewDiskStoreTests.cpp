@@ -0,0 +1,416 @@
+#include "PreviewDiskStore.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+using shelltabs::PreviewDiskKey;
+using shelltabs::PreviewDiskRecordHeader;
+using shelltabs::PreviewDiskStore;
+using shelltabs::PreviewPixels;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Removes the store and any compaction leftovers when the test finishes.
+class TempStorePath {
+public:
+    explicit TempStorePath(const char* name) {
+        const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+        m_path = std::filesystem::temp_directory_path() /
+                 (std::string("shelltabs-") + name + "-" + std::to_string(stamp) + ".bin");
+    }
+    ~TempStorePath() {
+        std::error_code ignored;
+        std::filesystem::remove(m_path, ignored);
+        std::filesystem::remove(std::filesystem::path(m_path).concat(".compact"), ignored);
+    }
+
+    const std::filesystem::path& Get() const noexcept { return m_path; }
+
+private:
+    std::filesystem::path m_path;
+};
+
+uint32_t NextRandom(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// A folder-window-like capture: gradient header and rows of icons and text.
+PreviewPixels MakePreview(uint32_t seed) {
+    constexpr uint32_t kWidth = 192;
+    constexpr uint32_t kHeight = 128;
+    PreviewPixels pixels;
+    pixels.width = kWidth;
+    pixels.height = kHeight;
+    pixels.bgra.assign(static_cast<size_t>(kWidth) * kHeight, 0xFFFFFFFFu);
+    uint32_t state = seed * 7919u + 1u;
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < kWidth; ++x) {
+            const uint32_t shade = 0xE0u - y * 3u - x / 16u;
+            pixels.bgra[y * kWidth + x] = 0xFF000000u | (shade << 16) | (shade << 8) | 0xF0u;
+        }
+    }
+    for (uint32_t row = 20; row + 10 < kHeight; row += 14) {
+        const uint32_t iconColor = 0xFF000000u | (NextRandom(&state) & 0x00FFFFFFu);
+        const uint32_t textLength = 40 + NextRandom(&state) % 120;
+        for (uint32_t y = row; y < row + 10; ++y) {
+            for (uint32_t x = 4; x < 14; ++x) {
+                pixels.bgra[y * kWidth + x] = iconColor;
+            }
+            for (uint32_t x = 20; x < 20 + textLength && x < kWidth; ++x) {
+                if (NextRandom(&state) % 3 == 0) {
+                    pixels.bgra[y * kWidth + x] = 0xFF404040u;
+                }
+            }
+        }
+    }
+    return pixels;
+}
+
+PreviewDiskKey KeyFor(uint64_t item, uint64_t stamp = 1) {
+    return PreviewDiskKey{{item * 0x9E3779B97F4A7C15ull, item + 1}, stamp};
+}
+
+bool Matches(PreviewDiskStore& store, const PreviewDiskKey& key, uint32_t seed) {
+    const auto pixels = store.Load(key);
+    return pixels && pixels->bgra == MakePreview(seed).bgra;
+}
+
+void PatchFile(const std::filesystem::path& path, uint64_t offset, uint8_t value) {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.put(static_cast<char>(value));
+}
+
+uint64_t RecordBytes(const PreviewPixels& pixels) {
+    std::vector<uint8_t> encoded;
+    shelltabs::EncodePreviewPixels(pixels, &encoded);
+    return sizeof(PreviewDiskRecordHeader) + encoded.size();
+}
+
+bool TestPreviewsSurviveReopen() {
+    TempStorePath path("reopen");
+    bool success = true;
+    {
+        PreviewDiskStore store;
+        if (!store.Open(path.Get())) {
+            PrintFailure(L"TestPreviewsSurviveReopen", L"Failed to create the store");
+            return false;
+        }
+        for (uint32_t i = 0; i < 3; ++i) {
+            store.Store(KeyFor(i), MakePreview(i));
+        }
+        // Superseded by a later capture of the same item.
+        store.Store(KeyFor(1, 2), MakePreview(10));
+    }
+
+    PreviewDiskStore store;
+    if (!store.Open(path.Get()) || store.Stats().entries != 3) {
+        PrintFailure(L"TestPreviewsSurviveReopen", L"Reopened store lost entries");
+        return false;
+    }
+    if (!Matches(store, KeyFor(0), 0) || !Matches(store, KeyFor(2), 2) || !Matches(store, KeyFor(1, 2), 10)) {
+        PrintFailure(L"TestPreviewsSurviveReopen", L"Reopened previews differ from what was stored");
+        success = false;
+    }
+    if (store.Load(KeyFor(2, 5)) || store.Contains(KeyFor(2)) || store.Stats().staleMisses != 1) {
+        PrintFailure(L"TestPreviewsSurviveReopen", L"A changed folder stamp still hit");
+        success = false;
+    }
+    if (store.Load(KeyFor(99)) || store.Stats().hits != 3) {
+        PrintFailure(L"TestPreviewsSurviveReopen", L"Unexpected hit statistics");
+        success = false;
+    }
+    return success;
+}
+
+bool TestKeysSharingTheLowHalfStayApart() {
+    TempStorePath path("collide");
+    PreviewDiskKey first = KeyFor(7);
+    PreviewDiskKey second = first;
+    second.item.high ^= 0xFFFF;
+    {
+        PreviewDiskStore store;
+        store.Open(path.Get());
+        store.Store(first, MakePreview(1));
+        store.Store(second, MakePreview(2));
+    }
+
+    PreviewDiskStore store;
+    store.Open(path.Get());
+    bool success = true;
+    if (store.Stats().entries != 2 || !Matches(store, first, 1) || !Matches(store, second, 2)) {
+        PrintFailure(L"TestKeysSharingTheLowHalfStayApart", L"Records sharing a low half were merged");
+        success = false;
+    }
+    PreviewDiskKey third = first;
+    third.item.high ^= 0xF0F0;
+    if (store.Contains(third) || store.Load(third)) {
+        PrintFailure(L"TestKeysSharingTheLowHalfStayApart", L"A key matching only the low half hit");
+        success = false;
+    }
+    return success;
+}
+
+bool TestTornTailIsTruncated() {
+    TempStorePath path("torn");
+    {
+        PreviewDiskStore store;
+        store.Open(path.Get());
+        for (uint32_t i = 0; i < 3; ++i) {
+            store.Store(KeyFor(i), MakePreview(i));
+        }
+    }
+    const uint64_t fullSize = std::filesystem::file_size(path.Get());
+    // The last record's write stopped partway through its payload.
+    std::filesystem::resize_file(path.Get(), fullSize - 25);
+
+    bool success = true;
+    {
+        PreviewDiskStore store;
+        if (!store.Open(path.Get()) || store.Stats().entries != 2 || store.Contains(KeyFor(2))) {
+            PrintFailure(L"TestTornTailIsTruncated", L"Torn record was not discarded");
+            return false;
+        }
+        if (std::filesystem::file_size(path.Get()) != fullSize - RecordBytes(MakePreview(2))) {
+            PrintFailure(L"TestTornTailIsTruncated", L"Log was not cut back to a record boundary");
+            success = false;
+        }
+        store.Store(KeyFor(3), MakePreview(3));
+    }
+
+    PreviewDiskStore store;
+    store.Open(path.Get());
+    if (store.Stats().entries != 3 || !Matches(store, KeyFor(1), 1) || !Matches(store, KeyFor(3), 3)) {
+        PrintFailure(L"TestTornTailIsTruncated", L"Appends after recovery were not readable");
+        success = false;
+    }
+    return success;
+}
+
+bool TestGarbledRecordsAreRejected() {
+    TempStorePath path("garbled");
+    {
+        PreviewDiskStore store;
+        store.Open(path.Get());
+        for (uint32_t i = 0; i < 3; ++i) {
+            store.Store(KeyFor(i), MakePreview(i));
+        }
+    }
+    const uint64_t second = sizeof(shelltabs::PreviewDiskFileHeader) + RecordBytes(MakePreview(0));
+
+    bool success = true;
+    PatchFile(path.Get(), second + sizeof(PreviewDiskRecordHeader) + 7, 0x5A);
+    {
+        PreviewDiskStore store;
+        store.Open(path.Get());
+        if (store.Load(KeyFor(1)) || store.Stats().corruptRecords != 1 || !Matches(store, KeyFor(2), 2)) {
+            PrintFailure(L"TestGarbledRecordsAreRejected", L"Corrupt payload was served or broke its neighbours");
+            success = false;
+        }
+    }
+
+    // A garbled header hides where the following records start, so the log
+    // ends before it.
+    PatchFile(path.Get(), second + 9, 0xA5);
+    {
+        PreviewDiskStore store;
+        store.Open(path.Get());
+        if (store.Stats().entries != 1 || !Matches(store, KeyFor(0), 0)) {
+            PrintFailure(L"TestGarbledRecordsAreRejected", L"Log did not end at the garbled header");
+            success = false;
+        }
+    }
+
+    {
+        std::ofstream foreign(path.Get(), std::ios::binary | std::ios::trunc);
+        foreign << "not a preview store";
+    }
+    PreviewDiskStore store;
+    if (!store.Open(path.Get()) || store.Stats().entries != 0 || !store.Store(KeyFor(4), MakePreview(4)) ||
+        !Matches(store, KeyFor(4), 4)) {
+        PrintFailure(L"TestGarbledRecordsAreRejected", L"Foreign file was not replaced by an empty store");
+        success = false;
+    }
+    return success;
+}
+
+bool TestInterruptedCompactionKeepsOriginal() {
+    TempStorePath path("interrupted");
+    {
+        PreviewDiskStore store;
+        store.Open(path.Get());
+        for (uint32_t i = 0; i < 4; ++i) {
+            store.Store(KeyFor(i), MakePreview(i));
+        }
+    }
+    const std::filesystem::path leftover = std::filesystem::path(path.Get()).concat(".compact");
+    {
+        std::ofstream partial(leftover, std::ios::binary | std::ios::trunc);
+        partial << "STPREVW1 half-written copy";
+    }
+
+    PreviewDiskStore store;
+    if (!store.Open(path.Get()) || store.Stats().entries != 4 || !Matches(store, KeyFor(3), 3) ||
+        std::filesystem::exists(leftover)) {
+        PrintFailure(L"TestInterruptedCompactionKeepsOriginal", L"Leftover compaction file was not discarded");
+        return false;
+    }
+    return true;
+}
+
+bool TestCompactionKeepsRecentlyUsed() {
+    TempStorePath path("compact");
+    const PreviewPixels pixels = MakePreview(0);
+    const uint64_t record = RecordBytes(pixels);
+    // Room for seven records.
+    PreviewDiskStore store(sizeof(shelltabs::PreviewDiskFileHeader) + 8 * record - 1);
+    store.Open(path.Get());
+    for (uint64_t i = 0; i < 7; ++i) {
+        store.Store(KeyFor(i), pixels);
+    }
+    store.Load(KeyFor(0));
+    // The eighth record pushes the log over its cap.
+    store.Store(KeyFor(7), pixels);
+
+    bool success = true;
+    const auto stats = store.Stats();
+    if (stats.compactions != 1 || stats.entries != 5 || stats.fileBytes != std::filesystem::file_size(path.Get())) {
+        PrintFailure(L"TestCompactionKeepsRecentlyUsed", L"Compaction did not shrink the log to its target");
+        success = false;
+    }
+    for (uint64_t i = 0; i < 8; ++i) {
+        const bool expected = i == 0 || i >= 4;
+        if (store.Contains(KeyFor(i)) != expected) {
+            PrintFailure(L"TestCompactionKeepsRecentlyUsed", L"Compaction kept the wrong previews");
+            success = false;
+            break;
+        }
+    }
+
+    store.Close();
+    store.Open(path.Get());
+    if (store.Stats().entries != 5 || !Matches(store, KeyFor(0), 0) || !Matches(store, KeyFor(7), 0)) {
+        PrintFailure(L"TestCompactionKeepsRecentlyUsed", L"Compacted log did not reopen");
+        success = false;
+    }
+    return success;
+}
+
+bool TestCompactionDoesNotBlockLookups() {
+    TempStorePath path("compact-unlocked");
+    const PreviewPixels pixels = MakePreview(0);
+    const uint64_t record = RecordBytes(pixels);
+    PreviewDiskStore store(sizeof(shelltabs::PreviewDiskFileHeader) + 8 * record);
+    store.Open(path.Get());
+    for (uint64_t i = 0; i < 4; ++i) {
+        store.Store(KeyFor(i), pixels);
+    }
+
+    // The hook runs on this thread, so a compaction still holding the lock
+    // would deadlock here instead of serving the lookup and the store.
+    bool loadedDuringCompaction = false;
+    store.SetCompactionWrittenHookForTest([&]() {
+        loadedDuringCompaction = store.Load(KeyFor(0)).has_value();
+        store.Store(KeyFor(9), MakePreview(9));
+    });
+    const bool compacted = store.Compact(sizeof(shelltabs::PreviewDiskFileHeader) + 2 * record);
+    store.SetCompactionWrittenHookForTest(nullptr);
+
+    bool success = true;
+    if (!compacted || !loadedDuringCompaction) {
+        PrintFailure(L"TestCompactionDoesNotBlockLookups", L"Lookup during compaction failed");
+        success = false;
+    }
+    if (store.Stats().entries != 3 || store.Contains(KeyFor(0)) || !Matches(store, KeyFor(3), 0) ||
+        !Matches(store, KeyFor(9), 9)) {
+        PrintFailure(L"TestCompactionDoesNotBlockLookups", L"Record stored during compaction was lost");
+        success = false;
+    }
+    return success;
+}
+
+// Benchmark: an Explorer restart with 300 tabs. Every preview comes back from
+// the store instead of being regenerated.
+bool TestColdStartRestores300Tabs() {
+    constexpr uint32_t kTabs = 300;
+    TempStorePath path("coldstart");
+    {
+        PreviewDiskStore store;
+        store.Open(path.Get());
+        for (uint32_t i = 0; i < kTabs; ++i) {
+            store.Store(KeyFor(i), MakePreview(i));
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    PreviewDiskStore store;
+    store.Open(path.Get());
+    const auto opened = std::chrono::steady_clock::now();
+    uint32_t restored = 0;
+    for (uint32_t i = 0; i < kTabs; ++i) {
+        restored += store.Load(KeyFor(i)) ? 1 : 0;
+    }
+    const auto finished = std::chrono::steady_clock::now();
+
+    const auto micros = [](auto duration) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    };
+    std::wcout << L"[TestColdStartRestores300Tabs] file=" << store.Stats().fileBytes / 1024 << L"KiB open="
+               << micros(opened - start) << L"us restore=" << micros(finished - opened) << L"us ("
+               << micros(finished - opened) / kTabs << L"us/tab)" << std::endl;
+
+    if (restored != kTabs) {
+        PrintFailure(L"TestColdStartRestores300Tabs", L"Not every tab's preview was restored");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestPreviewsSurviveReopen", &TestPreviewsSurviveReopen},
+        {L"TestKeysSharingTheLowHalfStayApart", &TestKeysSharingTheLowHalfStayApart},
+        {L"TestTornTailIsTruncated", &TestTornTailIsTruncated},
+        {L"TestGarbledRecordsAreRejected", &TestGarbledRecordsAreRejected},
+        {L"TestInterruptedCompactionKeepsOriginal", &TestInterruptedCompactionKeepsOriginal},
+        {L"TestCompactionKeepsRecentlyUsed", &TestCompactionKeepsRecentlyUsed},
+        {L"TestCompactionDoesNotBlockLookups", &TestCompactionDoesNotBlockLookups},
+        {L"TestColdStartRestores300Tabs", &TestColdStartRestores300Tabs},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Preview disk store tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Preview disk store tests passed." << std::endl;
+    return 0;
+}
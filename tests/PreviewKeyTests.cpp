@@ -0,0 +1,185 @@
+#include "PreviewKey.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+using shelltabs::HashPreviewKey;
+using shelltabs::PreviewKey;
+using shelltabs::PreviewKeyHasher;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Mimics a file-system PIDL: one SHITEMID per path component (a size prefix,
+// a fixed header and the UTF-16 name) and a zero terminator.
+std::string MakePidl(const std::vector<std::wstring>& components) {
+    std::string bytes;
+    for (const std::wstring& component : components) {
+        const uint16_t size = static_cast<uint16_t>(2 + 12 + (component.size() + 1) * 2);
+        bytes.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        bytes.append("\x31\x00\x00\x00\x00\x00\x5a\x4f\x21\x10\x20\x00", 12);
+        for (const wchar_t ch : component) {
+            const uint16_t unit = static_cast<uint16_t>(ch);
+            bytes.append(reinterpret_cast<const char*>(&unit), sizeof(unit));
+        }
+        bytes.append(2, '\0');
+    }
+    bytes.append(2, '\0');
+    return bytes;
+}
+
+std::vector<std::wstring> MakePath(size_t index) {
+    return {L"C:\\", L"Users", L"alex", L"Projects", L"Client " + std::to_wstring(index / 100),
+            L"Folder" + std::to_wstring(index)};
+}
+
+PreviewKey HashOf(const std::string& bytes) { return HashPreviewKey(bytes.data(), bytes.size()); }
+
+bool TestHashIsStableAndLengthSensitive() {
+    const std::string pidl = MakePidl(MakePath(7));
+    bool success = true;
+    if (HashOf(pidl) != HashOf(std::string(pidl)) || HashOf(pidl).Empty()) {
+        PrintFailure(L"TestHashIsStableAndLengthSensitive", L"Hash is not deterministic");
+        success = false;
+    }
+    if (HashOf(std::string("ab")) == HashOf(std::string("ab\0", 3)) || HashOf(std::string()).Empty()) {
+        PrintFailure(L"TestHashIsStableAndLengthSensitive", L"Trailing zeros or empty input are mishandled");
+        success = false;
+    }
+    return success;
+}
+
+bool TestEveryBitReachesBothHalves() {
+    const std::string pidl = MakePidl(MakePath(42));
+    const PreviewKey original = HashOf(pidl);
+    for (size_t byte = 0; byte < pidl.size(); ++byte) {
+        for (int bit = 0; bit < 8; ++bit) {
+            std::string changed = pidl;
+            changed[byte] = static_cast<char>(changed[byte] ^ (1 << bit));
+            const PreviewKey key = HashOf(changed);
+            if (key.low == original.low || key.high == original.high) {
+                PrintFailure(L"TestEveryBitReachesBothHalves",
+                             L"Flipping bit " + std::to_wstring(bit) + L" of byte " + std::to_wstring(byte) +
+                                 L" left a half unchanged");
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TestSimilarPidlsDoNotCollide() {
+    constexpr size_t kItems = 200000;
+    std::unordered_set<PreviewKey, PreviewKeyHasher> keys;
+    std::unordered_set<uint64_t> lows;
+    keys.reserve(kItems);
+    lows.reserve(kItems);
+    for (size_t i = 0; i < kItems; ++i) {
+        const PreviewKey key = HashOf(MakePidl(MakePath(i)));
+        keys.insert(key);
+        lows.insert(key.low);
+    }
+    // The on-disk store keys by the low half alone.
+    if (keys.size() != kItems || lows.size() != kItems) {
+        PrintFailure(L"TestSimilarPidlsDoNotCollide", L"Distinct PIDLs produced the same key");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: the old lookup built a parsing-name string per call and hashed
+// it into string-keyed maps; the new one hashes the PIDL bytes directly. The
+// shell call behind the parsing name is not included, so this understates
+// the old cost.
+bool TestLookupBenchmark() {
+    constexpr size_t kItems = 1000;
+    constexpr size_t kLookups = 200000;
+    std::vector<std::string> pidls;
+    std::vector<std::wstring> names;
+    std::unordered_map<std::wstring, size_t> byName;
+    std::unordered_map<PreviewKey, size_t, PreviewKeyHasher> byKey;
+    for (size_t i = 0; i < kItems; ++i) {
+        pidls.push_back(MakePidl(MakePath(i)));
+        std::wstring name;
+        for (const std::wstring& component : MakePath(i)) {
+            name += component;
+            if (name.back() != L'\\') {
+                name += L'\\';
+            }
+        }
+        names.push_back(name);
+        byName.emplace(name, i);
+        byKey.emplace(HashOf(pidls.back()), i);
+    }
+
+    size_t nameHits = 0;
+    const auto nameStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kLookups; ++i) {
+        const std::wstring key(names[(i * 7919) % kItems]);
+        nameHits += byName.count(key);
+    }
+    const auto nameTime = std::chrono::steady_clock::now() - nameStart;
+
+    size_t keyHits = 0;
+    const auto keyStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kLookups; ++i) {
+        const std::string& pidl = pidls[(i * 7919) % kItems];
+        keyHits += byKey.count(HashPreviewKey(pidl.data(), pidl.size()));
+    }
+    const auto keyTime = std::chrono::steady_clock::now() - keyStart;
+
+    const auto nanosPerLookup = [&](auto duration) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / static_cast<long long>(kLookups);
+    };
+    std::wcout << L"[TestLookupBenchmark] string key=" << nanosPerLookup(nameTime) << L"ns hashed pidl="
+               << nanosPerLookup(keyTime) << L"ns per lookup (" << pidls.front().size() << L"-byte pidl)" << std::endl;
+
+    if (nameHits != kLookups || keyHits != kLookups) {
+        PrintFailure(L"TestLookupBenchmark", L"Lookups missed");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestHashIsStableAndLengthSensitive", &TestHashIsStableAndLengthSensitive},
+        {L"TestEveryBitReachesBothHalves", &TestEveryBitReachesBothHalves},
+        {L"TestSimilarPidlsDoNotCollide", &TestSimilarPidlsDoNotCollide},
+        {L"TestLookupBenchmark", &TestLookupBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Preview key tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Preview key tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,469 @@
+#include "PreviewPrefetcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+using shelltabs::PrefetchTab;
+using shelltabs::PreviewPrefetchOptions;
+using shelltabs::PreviewPrefetchPlanner;
+
+using Clock = PreviewPrefetchPlanner::Clock;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+constexpr int kTabWidth = 100;
+constexpr int kTabHeight = 28;
+
+// A single row of tabs with ids 1..count, none of them recently used.
+std::vector<PrefetchTab> MakeRow(size_t count) {
+    std::vector<PrefetchTab> tabs;
+    for (size_t i = 0; i < count; ++i) {
+        PrefetchTab tab;
+        tab.id = i + 1;
+        tab.bounds = {static_cast<int>(i) * kTabWidth, 0, static_cast<int>(i + 1) * kTabWidth, kTabHeight};
+        tabs.push_back(tab);
+    }
+    return tabs;
+}
+
+Clock::time_point At(int milliseconds) { return Clock::time_point{} + std::chrono::milliseconds(milliseconds); }
+
+bool NothingCached(uint64_t) { return false; }
+
+std::wstring Describe(const std::vector<uint64_t>& ids) {
+    std::wstring text = L"[";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        text += (i == 0 ? L"" : L", ") + std::to_wstring(ids[i]);
+    }
+    return text + L"]";
+}
+
+bool TestRestingPointerPrefetchesHoveredAndNeighbours() {
+    PreviewPrefetchOptions options;
+    options.maxOutstanding = 3;
+    PreviewPrefetchPlanner planner(options);
+    planner.SetTabs(MakeRow(5));
+
+    const std::vector<uint64_t> issued = planner.OnPointerMove(250, 14, At(0), NothingCached);
+    const std::vector<uint64_t> expected = {3, 2, 4};
+    if (issued != expected) {
+        PrintFailure(L"TestRestingPointerPrefetchesHoveredAndNeighbours",
+                     L"Expected [3, 2, 4], got " + Describe(issued));
+        return false;
+    }
+    return true;
+}
+
+bool TestTrajectoryFavoursTabsAhead() {
+    PreviewPrefetchPlanner planner;
+    planner.SetTabs(MakeRow(6));
+
+    // A pointer that has not moved yet is resting on the tab it is over.
+    const std::vector<uint64_t> first = planner.OnPointerMove(10, 14, At(0), NothingCached);
+    const std::vector<uint64_t> resting = {1, 2};
+    if (first != resting) {
+        PrintFailure(L"TestTrajectoryFavoursTabsAhead", L"Expected [1, 2], got " + Describe(first));
+        return false;
+    }
+    planner.OnPrefetchFinished(1);
+    planner.OnPrefetchFinished(2);
+
+    // Moving right at 1000 px/s; 200ms ahead lies tab 3.
+    std::vector<uint64_t> issued;
+    for (int step = 1; step <= 6 && issued.empty(); ++step) {
+        issued = planner.OnPointerMove(10 + step * 8, 14, At(step * 8), NothingCached);
+    }
+    if (issued.empty() || issued.front() != 3 ||
+        std::find(issued.begin(), issued.end(), uint64_t{1}) != issued.end()) {
+        PrintFailure(L"TestTrajectoryFavoursTabsAhead", L"Expected tab 3 first, got " + Describe(issued));
+        return false;
+    }
+    return true;
+}
+
+bool TestMruFillsFreeSlots() {
+    PreviewPrefetchPlanner planner;
+    std::vector<PrefetchTab> tabs = MakeRow(6);
+    tabs[4].lastActivated = 50;
+    tabs[5].lastActivated = 90;
+    tabs[5].eligible = false;  // selected
+    planner.SetTabs(tabs);
+
+    // Resting on tab 1 with its only neighbour already cached.
+    const std::vector<uint64_t> issued =
+        planner.OnPointerMove(50, 14, At(0), [](uint64_t id) { return id == 2; });
+    const std::vector<uint64_t> expected = {1, 5};
+    if (issued != expected) {
+        PrintFailure(L"TestMruFillsFreeSlots", L"Expected [1, 5], got " + Describe(issued));
+        return false;
+    }
+    if (planner.Stats().alreadyCached != 1) {
+        PrintFailure(L"TestMruFillsFreeSlots", L"Cached neighbour was not counted");
+        return false;
+    }
+    return true;
+}
+
+bool TestOutstandingLimitAndBudget() {
+    PreviewPrefetchOptions options;
+    options.maxOutstanding = 2;
+    options.sessionBudget = 3;
+    PreviewPrefetchPlanner planner(options);
+    planner.SetTabs(MakeRow(8));
+
+    std::vector<uint64_t> all;
+    const auto rest = [&](int x, int time) {
+        const std::vector<uint64_t> issued = planner.OnPointerMove(x, 14, At(time), NothingCached);
+        all.insert(all.end(), issued.begin(), issued.end());
+        return issued.size();
+    };
+
+    bool success = true;
+    if (rest(150, 0) != 2 || rest(150, 500) != 0) {
+        PrintFailure(L"TestOutstandingLimitAndBudget", L"Outstanding limit not honoured: " + Describe(all));
+        success = false;
+    }
+    planner.OnPrefetchFinished(all[0]);
+    planner.OnPrefetchFinished(all[1]);
+    rest(450, 1000);
+    planner.OnPrefetchFinished(all.back());
+    if (rest(650, 1500) != 0 || all.size() != 3) {
+        PrintFailure(L"TestOutstandingLimitAndBudget", L"Budget not honoured: " + Describe(all));
+        success = false;
+    }
+    planner.OnPointerLeave();
+    if (rest(650, 2000) == 0) {
+        PrintFailure(L"TestOutstandingLimitAndBudget", L"Budget did not reset for a new visit");
+        success = false;
+    }
+    return success;
+}
+
+bool TestLeaveReturnsOutstanding() {
+    PreviewPrefetchPlanner planner;
+    planner.SetTabs(MakeRow(4));
+
+    const std::vector<uint64_t> issued = planner.OnPointerMove(150, 14, At(0), NothingCached);
+    if (issued.size() != 2) {
+        PrintFailure(L"TestLeaveReturnsOutstanding", L"Expected two prefetches, got " + Describe(issued));
+        return false;
+    }
+    planner.OnPrefetchFinished(issued[0]);
+    const std::vector<uint64_t> cancelled = planner.OnPointerLeave();
+    bool success = true;
+    if (cancelled.size() != 1 || cancelled[0] != issued[1] || planner.Outstanding() != 0) {
+        PrintFailure(L"TestLeaveReturnsOutstanding", L"Leave returned " + Describe(cancelled));
+        success = false;
+    }
+    if (planner.Stats().finished != 1 || planner.Stats().cancelled != 1) {
+        PrintFailure(L"TestLeaveReturnsOutstanding", L"Stats do not match");
+        success = false;
+    }
+    // A finish arriving after the leave is ignored.
+    planner.OnPrefetchFinished(issued[1]);
+    if (planner.Stats().finished != 1) {
+        PrintFailure(L"TestLeaveReturnsOutstanding", L"Late finish was counted");
+        success = false;
+    }
+    return success;
+}
+
+// Virtual-time model of the tab band and the preview worker pool, used to
+// compare how long a hovered tab shows its placeholder with and without
+// prefetch. Each visit starts with a cold cache, enters the band from the
+// top, glides to one to three tabs with an ease-out motion, waits for the
+// hover delay, looks at the preview and leaves. Two workers, one of them
+// held back for hover requests as in PreviewWorkQueue; generating a preview
+// costs 40-120ms.
+struct SimulationResult {
+    std::vector<int> latencies;
+    uint64_t prefetches = 0;
+    uint64_t unusedPrefetches = 0;
+    size_t maxPrefetchesPerVisit = 0;
+};
+
+SimulationResult RunHoverSimulation(bool prefetch, uint32_t seed) {
+    constexpr size_t kTabs = 14;
+    constexpr size_t kVisits = 400;
+    constexpr size_t kWorkers = 2;
+    constexpr int kHoverDelay = 400;
+    constexpr int kMoveInterval = 8;
+    constexpr int kGapBetweenVisits = 1000;
+
+    std::mt19937 random(seed);
+    const auto uniform = [&](int low, int high) { return std::uniform_int_distribution<int>(low, high)(random); };
+
+    std::vector<PrefetchTab> tabs;
+    std::vector<int> cost(kTabs);
+    for (size_t i = 0; i < kTabs; ++i) {
+        PrefetchTab tab;
+        tab.id = i;
+        tab.bounds = {static_cast<int>(i) * 140, 0, static_cast<int>(i + 1) * 140, kTabHeight};
+        tabs.push_back(tab);
+        cost[i] = uniform(40, 120);
+    }
+    std::vector<size_t> mruOrder(kTabs);
+    for (size_t i = 0; i < kTabs; ++i) {
+        mruOrder[i] = i;
+    }
+    std::shuffle(mruOrder.begin(), mruOrder.end(), random);
+    for (size_t rank = 0; rank < kTabs; ++rank) {
+        tabs[mruOrder[rank]].lastActivated = kTabs - rank;
+    }
+    const size_t selected = mruOrder[0];
+    tabs[selected].eligible = false;
+
+    PreviewPrefetchPlanner planner;
+    planner.SetTabs(tabs);
+
+    struct Job {
+        size_t tab = 0;
+        bool interactive = false;
+    };
+    struct Worker {
+        std::optional<size_t> tab;
+        int finish = 0;
+    };
+    std::deque<Job> queue;
+    std::vector<Worker> workers(kWorkers);
+    std::unordered_set<size_t> cached;
+    SimulationResult result;
+
+    int now = 0;
+    std::optional<size_t> awaiting;
+    int hoverStart = 0;
+
+    const auto isRunning = [&](size_t tab) {
+        return std::any_of(workers.begin(), workers.end(), [&](const Worker& w) { return w.tab == tab; });
+    };
+    const auto step = [&](const auto& onMove) {
+        for (Worker& worker : workers) {
+            if (worker.tab && worker.finish <= now) {
+                const size_t tab = *worker.tab;
+                worker.tab.reset();
+                cached.insert(tab);
+                planner.OnPrefetchFinished(tab);
+                if (awaiting == tab) {
+                    result.latencies.push_back(now - hoverStart);
+                    awaiting.reset();
+                }
+            }
+        }
+        onMove();
+        for (Worker& worker : workers) {
+            if (worker.tab || queue.empty()) {
+                continue;
+            }
+            const size_t busy = static_cast<size_t>(
+                std::count_if(workers.begin(), workers.end(), [](const Worker& w) { return w.tab.has_value(); }));
+            auto next = std::find_if(queue.begin(), queue.end(), [](const Job& job) { return job.interactive; });
+            if (next == queue.end()) {
+                if (busy + 1 >= kWorkers) {
+                    continue;  // the last worker is held for hovers
+                }
+                next = queue.begin();
+            }
+            worker.tab = next->tab;
+            worker.finish = now + cost[next->tab];
+            queue.erase(next);
+        }
+        ++now;
+    };
+
+    std::unordered_set<size_t> issuedThisVisit;
+    const auto move = [&](int x, int y) {
+        if (!prefetch) {
+            return;
+        }
+        const std::vector<uint64_t> ids = planner.OnPointerMove(
+            x, y, At(now), [&](uint64_t id) { return cached.count(id) != 0 || isRunning(id); });
+        for (const uint64_t id : ids) {
+            queue.push_back({static_cast<size_t>(id), false});
+            issuedThisVisit.insert(static_cast<size_t>(id));
+            ++result.prefetches;
+        }
+    };
+
+    for (size_t visit = 0; visit < kVisits; ++visit) {
+        for (int idle = 0; idle < kGapBetweenVisits; ++idle) {
+            step([] {});
+        }
+        cached.clear();
+        issuedThisVisit.clear();
+        std::unordered_set<size_t> hovered;
+
+        double x = uniform(0, static_cast<int>(kTabs) * 140 - 1);
+        double y = 0;
+        size_t target = 0;
+        const size_t hops = static_cast<size_t>(uniform(1, 3));
+        for (size_t hop = 0; hop < hops; ++hop) {
+            // Mostly recently used tabs or the neighbour of the last one.
+            const int choice = uniform(0, 9);
+            if (hop > 0 && choice < 4) {
+                target = target + 1 < kTabs && (target == 0 || uniform(0, 1) == 0) ? target + 1 : target - 1;
+            } else if (choice < 7) {
+                target = mruOrder[static_cast<size_t>(uniform(1, 4))];
+            } else {
+                target = static_cast<size_t>(uniform(0, static_cast<int>(kTabs) - 1));
+            }
+            if (target == selected) {
+                target = mruOrder[1];
+            }
+
+            const double startX = x;
+            const double startY = y;
+            const double endX = tabs[target].bounds.left + 70 + uniform(-40, 40);
+            const double endY = 14 + uniform(-6, 6);
+            const double distance = std::hypot(endX - startX, endY - startY);
+            const int duration = std::max(40, static_cast<int>(distance * 1000.0 / uniform(600, 1400)));
+            for (int elapsed = 0; elapsed < duration; ++elapsed) {
+                step([&] {
+                    if (elapsed % kMoveInterval == 0) {
+                        const double u = static_cast<double>(elapsed) / duration;
+                        const double eased = 1.0 - (1.0 - u) * (1.0 - u);
+                        x = startX + (endX - startX) * eased;
+                        y = startY + (endY - startY) * eased;
+                        move(static_cast<int>(x), static_cast<int>(y));
+                    }
+                });
+            }
+            x = endX;
+            y = endY;
+            for (int elapsed = 0; elapsed < kHoverDelay; ++elapsed) {
+                step([&] {
+                    if (elapsed <= 3 * kMoveInterval && elapsed % kMoveInterval == 0) {
+                        move(static_cast<int>(x) + (elapsed / kMoveInterval) % 2, static_cast<int>(y));
+                    }
+                });
+            }
+
+            hovered.insert(target);
+            step([&] {
+                if (cached.count(target) != 0) {
+                    result.latencies.push_back(0);
+                    return;
+                }
+                awaiting = target;
+                hoverStart = now;
+                auto pending = std::find_if(queue.begin(), queue.end(), [&](const Job& job) { return job.tab == target; });
+                if (pending != queue.end()) {
+                    pending->interactive = true;
+                } else if (!isRunning(target)) {
+                    queue.push_back({target, true});
+                }
+            });
+            while (awaiting) {
+                step([] {});
+            }
+            for (int dwell = uniform(300, 800); dwell > 0; --dwell) {
+                step([] {});
+            }
+        }
+
+        step([&] {
+            if (!prefetch) {
+                return;
+            }
+            for (const uint64_t id : planner.OnPointerLeave()) {
+                queue.erase(std::remove_if(queue.begin(), queue.end(),
+                                           [&](const Job& job) { return job.tab == id && !job.interactive; }),
+                            queue.end());
+            }
+        });
+        size_t unused = 0;
+        for (const size_t tab : issuedThisVisit) {
+            unused += hovered.count(tab) == 0 ? 1 : 0;
+        }
+        result.unusedPrefetches += unused;
+        result.maxPrefetchesPerVisit = std::max(result.maxPrefetchesPerVisit, issuedThisVisit.size());
+    }
+    return result;
+}
+
+int Percentile(std::vector<int> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(fraction * static_cast<double>(values.size() - 1))];
+}
+
+void PrintDistribution(const wchar_t* label, const SimulationResult& result) {
+    const std::vector<int>& latencies = result.latencies;
+    const size_t instant = static_cast<size_t>(std::count(latencies.begin(), latencies.end(), 0));
+    std::wcout << L"[TestHoverLatencySimulation] " << label << L": p50=" << Percentile(latencies, 0.5)
+               << L"ms p90=" << Percentile(latencies, 0.9) << L"ms p99=" << Percentile(latencies, 0.99)
+               << L"ms max=" << Percentile(latencies, 1.0) << L"ms instant=" << std::fixed << std::setprecision(1)
+               << 100.0 * static_cast<double>(instant) / static_cast<double>(latencies.size()) << L"% prefetches="
+               << result.prefetches << L" unused=" << result.unusedPrefetches << std::endl;
+}
+
+bool TestHoverLatencySimulation() {
+    const SimulationResult without = RunHoverSimulation(false, 7);
+    const SimulationResult with = RunHoverSimulation(true, 7);
+    PrintDistribution(L"without prefetch", without);
+    PrintDistribution(L"with prefetch", with);
+
+    bool success = true;
+    if (with.latencies.size() != without.latencies.size()) {
+        PrintFailure(L"TestHoverLatencySimulation", L"Runs hovered a different number of tabs");
+        success = false;
+    }
+    if (Percentile(with.latencies, 0.5) >= Percentile(without.latencies, 0.5) ||
+        Percentile(with.latencies, 0.9) > Percentile(without.latencies, 0.9)) {
+        PrintFailure(L"TestHoverLatencySimulation", L"Prefetch did not reduce preview latency");
+        success = false;
+    }
+    if (with.maxPrefetchesPerVisit > PreviewPrefetchOptions{}.sessionBudget) {
+        PrintFailure(L"TestHoverLatencySimulation", L"A visit exceeded the prefetch budget");
+        success = false;
+    }
+    return success;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestRestingPointerPrefetchesHoveredAndNeighbours", &TestRestingPointerPrefetchesHoveredAndNeighbours},
+        {L"TestTrajectoryFavoursTabsAhead", &TestTrajectoryFavoursTabsAhead},
+        {L"TestMruFillsFreeSlots", &TestMruFillsFreeSlots},
+        {L"TestOutstandingLimitAndBudget", &TestOutstandingLimitAndBudget},
+        {L"TestLeaveReturnsOutstanding", &TestLeaveReturnsOutstanding},
+        {L"TestHoverLatencySimulation", &TestHoverLatencySimulation},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Preview prefetcher tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Preview prefetcher tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,313 @@
+#include "PreviewScaler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::IsPreviewScalerPathSupported;
+using shelltabs::PreviewPixelView;
+using shelltabs::PreviewScaleFilter;
+using shelltabs::PreviewScalerPath;
+using shelltabs::ScalePreviewPixels;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+struct Image {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> pixels;
+
+    PreviewPixelView View() const { return {pixels.data(), width, height, width}; }
+};
+
+constexpr PreviewScalerPath kPaths[] = {PreviewScalerPath::kScalar, PreviewScalerPath::kSse2,
+                                        PreviewScalerPath::kAvx2};
+constexpr PreviewScaleFilter kFilters[] = {PreviewScaleFilter::kBox, PreviewScaleFilter::kBilinear};
+
+const wchar_t* PathName(PreviewScalerPath path) {
+    switch (path) {
+        case PreviewScalerPath::kSse2:
+            return L"sse2";
+        case PreviewScalerPath::kAvx2:
+            return L"avx2";
+        default:
+            return L"scalar";
+    }
+}
+
+const wchar_t* FilterName(PreviewScaleFilter filter) {
+    return filter == PreviewScaleFilter::kBox ? L"box" : L"bilinear";
+}
+
+std::wstring SizeText(uint32_t width, uint32_t height) {
+    return std::to_wstring(width) + L"x" + std::to_wstring(height);
+}
+
+// Random premultiplied pixels: no colour channel exceeds alpha.
+Image MakeNoise(uint32_t width, uint32_t height, uint32_t seed, bool opaque = false) {
+    std::mt19937 random(seed);
+    Image image{width, height, std::vector<uint32_t>(static_cast<size_t>(width) * height)};
+    for (uint32_t& pixel : image.pixels) {
+        const uint32_t alpha = opaque ? 255u : random() % 256u;
+        pixel = alpha << 24;
+        for (int channel = 0; channel < 3; ++channel) {
+            pixel |= (random() % (alpha + 1)) << (channel * 8);
+        }
+    }
+    return image;
+}
+
+// Straightforward double-precision resampler with the same filter
+// definitions: box weights are the covered area, bilinear weights a triangle
+// of radius max(scale, 1) sampled at pixel centres, both clipped at the edges
+// and normalized.
+std::vector<std::vector<std::pair<uint32_t, double>>> ReferenceWeights(uint32_t source, uint32_t dest,
+                                                                       PreviewScaleFilter filter) {
+    std::vector<std::vector<std::pair<uint32_t, double>>> result(dest);
+    const double scale = static_cast<double>(source) / dest;
+    const double support = std::max(scale, 1.0);
+    for (uint32_t d = 0; d < dest; ++d) {
+        const double center = (d + 0.5) * scale;
+        double total = 0.0;
+        for (uint32_t i = 0; i < source; ++i) {
+            double weight = 0.0;
+            if (filter == PreviewScaleFilter::kBox) {
+                const double left = std::max<double>(i, center - support / 2);
+                const double right = std::min<double>(i + 1.0, center + support / 2);
+                weight = right - left;
+            } else {
+                weight = 1.0 - std::fabs(i + 0.5 - center) / support;
+            }
+            if (weight > 0.0) {
+                result[d].emplace_back(i, weight);
+                total += weight;
+            }
+        }
+        for (auto& entry : result[d]) {
+            entry.second /= total;
+        }
+    }
+    return result;
+}
+
+std::vector<uint32_t> ReferenceScale(const Image& source, uint32_t width, uint32_t height, PreviewScaleFilter filter) {
+    const auto columns = ReferenceWeights(source.width, width, filter);
+    const auto rows = ReferenceWeights(source.height, height, filter);
+    std::vector<uint32_t> result(static_cast<size_t>(width) * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+            double sums[4] = {};
+            for (const auto& [sy, wy] : rows[y]) {
+                for (const auto& [sx, wx] : columns[x]) {
+                    const uint32_t pixel = source.pixels[static_cast<size_t>(sy) * source.width + sx];
+                    for (int channel = 0; channel < 4; ++channel) {
+                        sums[channel] += wy * wx * ((pixel >> (channel * 8)) & 0xFF);
+                    }
+                }
+            }
+            uint32_t pixel = 0;
+            for (int channel = 0; channel < 4; ++channel) {
+                pixel |= static_cast<uint32_t>(std::lround(std::clamp(sums[channel], 0.0, 255.0))) << (channel * 8);
+            }
+            result[static_cast<size_t>(y) * width + x] = pixel;
+        }
+    }
+    return result;
+}
+
+int MaxChannelError(const std::vector<uint32_t>& left, const std::vector<uint32_t>& right) {
+    int worst = 0;
+    for (size_t i = 0; i < left.size(); ++i) {
+        for (int channel = 0; channel < 4; ++channel) {
+            const int a = static_cast<int>((left[i] >> (channel * 8)) & 0xFF);
+            const int b = static_cast<int>((right[i] >> (channel * 8)) & 0xFF);
+            worst = std::max(worst, std::abs(a - b));
+        }
+    }
+    return worst;
+}
+
+struct Case {
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t width;
+    uint32_t height;
+};
+
+constexpr Case kCases[] = {
+    {1000, 700, 192, 128},  // typical window capture
+    {193, 129, 192, 128},   // barely shrinking
+    {37, 23, 192, 128},     // small shell thumbnail, upscaled
+    {5, 1, 3, 1},           // narrower than one SIMD chunk
+    {640, 480, 7, 5},       // odd widths exercise every tail
+};
+
+bool TestMatchesReference() {
+    bool success = true;
+    uint32_t seed = 1;
+    for (const Case& test : kCases) {
+        const Image source = MakeNoise(test.sourceWidth, test.sourceHeight, seed++);
+        for (const PreviewScaleFilter filter : kFilters) {
+            const std::vector<uint32_t> expected = ReferenceScale(source, test.width, test.height, filter);
+            std::vector<uint32_t> actual(expected.size());
+            if (!ScalePreviewPixels(source.View(), actual.data(), test.width, test.height, filter,
+                                    PreviewScalerPath::kScalar)) {
+                PrintFailure(L"TestMatchesReference", L"Scaling failed");
+                return false;
+            }
+            const int error = MaxChannelError(expected, actual);
+            if (error > 1) {
+                PrintFailure(L"TestMatchesReference", std::wstring(FilterName(filter)) + L" " +
+                                                          SizeText(test.sourceWidth, test.sourceHeight) + L" -> " +
+                                                          SizeText(test.width, test.height) + L" is off by " +
+                                                          std::to_wstring(error));
+                success = false;
+            }
+        }
+    }
+    return success;
+}
+
+bool TestPathsAgree() {
+    bool success = true;
+    uint32_t seed = 100;
+    for (const Case& test : kCases) {
+        const Image source = MakeNoise(test.sourceWidth, test.sourceHeight, seed++);
+        for (const PreviewScaleFilter filter : kFilters) {
+            std::vector<uint32_t> scalar(static_cast<size_t>(test.width) * test.height);
+            ScalePreviewPixels(source.View(), scalar.data(), test.width, test.height, filter, PreviewScalerPath::kScalar);
+            for (const PreviewScalerPath path : kPaths) {
+                if (!IsPreviewScalerPathSupported(path)) {
+                    continue;
+                }
+                std::vector<uint32_t> output(scalar.size());
+                ScalePreviewPixels(source.View(), output.data(), test.width, test.height, filter, path);
+                if (output != scalar) {
+                    PrintFailure(L"TestPathsAgree", std::wstring(PathName(path)) + L" " + FilterName(filter) + L" " +
+                                                        SizeText(test.sourceWidth, test.sourceHeight) +
+                                                        L" differs from scalar");
+                    success = false;
+                }
+            }
+        }
+    }
+    return success;
+}
+
+bool TestPreservesFlatColourAndAlpha() {
+    bool success = true;
+    Image flat{300, 200, std::vector<uint32_t>(300 * 200, 0x80402010u)};
+    const Image opaque = MakeNoise(333, 222, 7, true);
+    const Image translucent = MakeNoise(333, 222, 8);
+    for (const PreviewScaleFilter filter : kFilters) {
+        std::vector<uint32_t> output(192 * 128);
+        ScalePreviewPixels(flat.View(), output.data(), 192, 128, filter);
+        if (std::any_of(output.begin(), output.end(), [](uint32_t pixel) { return pixel != 0x80402010u; })) {
+            PrintFailure(L"TestPreservesFlatColourAndAlpha", std::wstring(FilterName(filter)) + L" changed a flat fill");
+            success = false;
+        }
+        ScalePreviewPixels(opaque.View(), output.data(), 192, 128, filter);
+        if (std::any_of(output.begin(), output.end(), [](uint32_t pixel) { return (pixel >> 24) != 0xFF; })) {
+            PrintFailure(L"TestPreservesFlatColourAndAlpha", std::wstring(FilterName(filter)) + L" lost opacity");
+            success = false;
+        }
+        ScalePreviewPixels(translucent.View(), output.data(), 192, 128, filter);
+        const bool premultiplied = std::all_of(output.begin(), output.end(), [](uint32_t pixel) {
+            const uint32_t alpha = pixel >> 24;
+            return (pixel & 0xFF) <= alpha && ((pixel >> 8) & 0xFF) <= alpha && ((pixel >> 16) & 0xFF) <= alpha;
+        });
+        if (!premultiplied) {
+            PrintFailure(L"TestPreservesFlatColourAndAlpha",
+                         std::wstring(FilterName(filter)) + L" produced a colour brighter than its alpha");
+            success = false;
+        }
+    }
+    return success;
+}
+
+bool TestRejectsInvalidInput() {
+    const Image source = MakeNoise(4, 4, 9);
+    uint32_t output[4] = {};
+    PreviewPixelView padded = source.View();
+    padded.stride = 3;
+    if (ScalePreviewPixels(source.View(), output, 0, 2) || ScalePreviewPixels(PreviewPixelView{}, output, 2, 2) ||
+        ScalePreviewPixels(padded, output, 2, 2) || ScalePreviewPixels(source.View(), nullptr, 2, 2)) {
+        PrintFailure(L"TestRejectsInvalidInput", L"Invalid input was accepted");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: a 4K window capture shrunk to the preview size. The old path was
+// a HALFTONE StretchBlt, which cannot run here.
+bool TestThroughputBenchmark() {
+    constexpr uint32_t kWidth = 3840;
+    constexpr uint32_t kHeight = 2160;
+    constexpr int kRuns = 5;
+    const Image source = MakeNoise(kWidth, kHeight, 11, true);
+    std::vector<uint32_t> output(192 * 108);
+    for (const PreviewScaleFilter filter : kFilters) {
+        for (const PreviewScalerPath path : kPaths) {
+            if (!IsPreviewScalerPathSupported(path)) {
+                continue;
+            }
+            auto best = std::chrono::steady_clock::duration::max();
+            for (int run = 0; run < kRuns; ++run) {
+                const auto start = std::chrono::steady_clock::now();
+                ScalePreviewPixels(source.View(), output.data(), 192, 108, filter, path);
+                best = std::min(best, std::chrono::steady_clock::now() - start);
+            }
+            const double seconds = std::chrono::duration<double>(best).count();
+            std::wcout << L"[TestThroughputBenchmark] " << FilterName(filter) << L" " << PathName(path) << L": "
+                       << std::fixed << std::setprecision(2) << seconds * 1000.0 << L"ms per 4K frame, "
+                       << std::setprecision(0) << kWidth * static_cast<double>(kHeight) / seconds / 1e6
+                       << L" source Mpx/s" << std::endl;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestMatchesReference", &TestMatchesReference},
+        {L"TestPathsAgree", &TestPathsAgree},
+        {L"TestPreservesFlatColourAndAlpha", &TestPreservesFlatColourAndAlpha},
+        {L"TestRejectsInvalidInput", &TestRejectsInvalidInput},
+        {L"TestThroughputBenchmark", &TestThroughputBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Preview scaler tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Preview scaler tests passed." << std::endl;
+    return 0;
+}
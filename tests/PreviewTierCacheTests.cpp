@@ -0,0 +1,364 @@
+#include "PreviewCodec.h"
+#include "PreviewTierCache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::PreviewPixels;
+using shelltabs::PreviewTierCache;
+using shelltabs::PreviewTierEvent;
+using shelltabs::PreviewTierLimits;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+constexpr uint32_t kWidth = 192;
+constexpr uint32_t kHeight = 128;
+
+uint32_t NextRandom(uint32_t* state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Approximates a folder window capture: a gradient header, white rows of
+// dark "text" runs, and a few coloured icons. The seed varies the layout.
+PreviewPixels MakeWindowLikePixels(uint32_t seed) {
+    PreviewPixels pixels;
+    pixels.width = kWidth;
+    pixels.height = kHeight;
+    pixels.bgra.assign(static_cast<size_t>(kWidth) * kHeight, 0xFFFFFFFFu);
+    uint32_t state = seed * 7919u + 1u;
+    for (uint32_t y = 0; y < 16; ++y) {
+        for (uint32_t x = 0; x < kWidth; ++x) {
+            const uint32_t shade = 0xE0u - y * 3u - x / 16u;
+            pixels.bgra[y * kWidth + x] = 0xFF000000u | (shade << 16) | (shade << 8) | 0xF0u;
+        }
+    }
+    for (uint32_t row = 20; row + 10 < kHeight; row += 14) {
+        const uint32_t iconColor = 0xFF000000u | (NextRandom(&state) & 0x00FFFFFFu);
+        const uint32_t textLength = 40 + NextRandom(&state) % 120;
+        for (uint32_t y = row; y < row + 10; ++y) {
+            for (uint32_t x = 4; x < 14; ++x) {
+                pixels.bgra[y * kWidth + x] = iconColor;
+            }
+            for (uint32_t x = 20; x < 20 + textLength && x < kWidth; ++x) {
+                if (NextRandom(&state) % 3 == 0) {
+                    const uint32_t ink = 0x20u + NextRandom(&state) % 0x60u;
+                    pixels.bgra[y * kWidth + x] = 0xFF000000u | (ink << 16) | (ink << 8) | ink;
+                }
+            }
+        }
+    }
+    return pixels;
+}
+
+PreviewPixels MakeNoisePixels(uint32_t seed) {
+    PreviewPixels pixels;
+    pixels.width = kWidth;
+    pixels.height = kHeight;
+    pixels.bgra.resize(static_cast<size_t>(kWidth) * kHeight);
+    uint32_t state = seed;
+    for (uint32_t& pixel : pixels.bgra) {
+        pixel = NextRandom(&state) ^ (NextRandom(&state) << 24);
+    }
+    return pixels;
+}
+
+bool RoundTrips(const PreviewPixels& pixels, std::vector<uint8_t>* encoded) {
+    shelltabs::EncodePreviewPixels(pixels, encoded);
+    PreviewPixels decoded;
+    return shelltabs::DecodePreviewPixels(encoded->data(), encoded->size(), pixels.width, pixels.height, &decoded) &&
+           decoded.bgra == pixels.bgra;
+}
+
+bool TestCodecRoundTripsAndCompresses() {
+    bool success = true;
+    std::vector<uint8_t> encoded;
+    const PreviewPixels window = MakeWindowLikePixels(1);
+    const size_t raw = window.bgra.size() * sizeof(uint32_t);
+    if (!RoundTrips(window, &encoded) || encoded.size() * 4 > raw) {
+        PrintFailure(L"TestCodecRoundTripsAndCompresses", L"Window-like preview did not compress 4:1 losslessly");
+        success = false;
+    }
+
+    const PreviewPixels noise = MakeNoisePixels(2);
+    if (!RoundTrips(noise, &encoded) || encoded.size() > shelltabs::MaxEncodedPreviewSize(noise.bgra.size())) {
+        PrintFailure(L"TestCodecRoundTripsAndCompresses", L"Noise broke the round trip or the size bound");
+        success = false;
+    }
+
+    PreviewPixels flat;
+    flat.width = 61;
+    flat.height = 3;
+    flat.bgra.assign(183, 0xFF000000u);
+    flat.bgra[62] = 0x00000000u;
+    flat.bgra[120] = 0x7F102030u;
+    if (!RoundTrips(flat, &encoded)) {
+        PrintFailure(L"TestCodecRoundTripsAndCompresses", L"Runs across row ends and alpha changes failed");
+        success = false;
+    }
+    return success;
+}
+
+bool TestDecoderRejectsMalformedStreams() {
+    std::vector<uint8_t> encoded;
+    const PreviewPixels window = MakeWindowLikePixels(3);
+    shelltabs::EncodePreviewPixels(window, &encoded);
+    PreviewPixels decoded;
+    bool success = true;
+    for (size_t cut : {size_t{0}, size_t{1}, encoded.size() / 2, encoded.size() - 1}) {
+        if (shelltabs::DecodePreviewPixels(encoded.data(), cut, kWidth, kHeight, &decoded)) {
+            PrintFailure(L"TestDecoderRejectsMalformedStreams", L"Accepted a truncated stream");
+            success = false;
+        }
+    }
+    std::vector<uint8_t> padded = encoded;
+    padded.push_back(0x00);
+    if (shelltabs::DecodePreviewPixels(padded.data(), padded.size(), kWidth, kHeight, &decoded)) {
+        PrintFailure(L"TestDecoderRejectsMalformedStreams", L"Accepted trailing bytes");
+        success = false;
+    }
+    const std::vector<uint8_t> overrun = {0xFD, 0xFD};
+    if (shelltabs::DecodePreviewPixels(overrun.data(), overrun.size(), 10, 1, &decoded)) {
+        PrintFailure(L"TestDecoderRejectsMalformedStreams", L"Accepted a run past the end of the image");
+        success = false;
+    }
+    return success;
+}
+
+// Stands in for a GDI bitmap; tracks how many are alive.
+struct FakeImage {
+    PreviewPixels pixels;
+    int* live = nullptr;
+};
+
+struct FakeHooks {
+    int live = 0;
+    bool failReads = false;
+    std::vector<std::wstring> evicted;
+
+    PreviewTierCache<FakeImage>::Hooks Build() {
+        PreviewTierCache<FakeImage>::Hooks hooks;
+        hooks.readPixels = [this](const FakeImage& image) -> std::optional<PreviewPixels> {
+            if (failReads) {
+                return std::nullopt;
+            }
+            return image.pixels;
+        };
+        hooks.createImage = [this](const PreviewPixels& pixels) -> std::optional<FakeImage> { return Make(pixels); };
+        hooks.destroyImage = [](FakeImage& image) { --*image.live; };
+        hooks.observer = [this](const std::wstring& key, PreviewTierEvent event, size_t) {
+            if (event == PreviewTierEvent::kEvicted) {
+                evicted.push_back(key);
+            }
+        };
+        return hooks;
+    }
+
+    FakeImage Make(const PreviewPixels& pixels) {
+        ++live;
+        return FakeImage{pixels, &live};
+    }
+};
+
+std::wstring KeyFor(int index) { return L"C:\\Folder" + std::to_wstring(index); }
+
+bool TestHotOverflowDemotesAndColdHitPromotes() {
+    FakeHooks fake;
+    bool success = true;
+    {
+        PreviewTierLimits limits;
+        limits.hotEntries = 2;
+        PreviewTierCache<FakeImage> cache(fake.Build(), limits);
+        for (int i = 0; i < 5; ++i) {
+            cache.Store(KeyFor(i), fake.Make(MakeWindowLikePixels(static_cast<uint32_t>(i))));
+        }
+        auto stats = cache.Stats();
+        if (stats.hotEntries != 2 || stats.coldEntries != 3 || fake.live != 2 || stats.demotions != 3) {
+            PrintFailure(L"TestHotOverflowDemotesAndColdHitPromotes", L"Overflow was not demoted to the cold tier");
+            success = false;
+        }
+
+        const FakeImage* promoted = cache.Find(KeyFor(0));
+        if (!promoted || promoted->pixels.bgra != MakeWindowLikePixels(0).bgra) {
+            PrintFailure(L"TestHotOverflowDemotesAndColdHitPromotes", L"Cold hit did not restore the pixels");
+            success = false;
+        }
+        stats = cache.Stats();
+        if (stats.promotions != 1 || stats.hotEntries != 2 || stats.coldEntries != 3 || fake.live != 2) {
+            PrintFailure(L"TestHotOverflowDemotesAndColdHitPromotes", L"Promotion did not swap tiers");
+            success = false;
+        }
+        // Key 3 was the least recent hot entry and should now be cold.
+        cache.Find(KeyFor(4));
+        if (!cache.Find(KeyFor(3)) || cache.Stats().promotions != 2 || cache.Find(L"missing")) {
+            PrintFailure(L"TestHotOverflowDemotesAndColdHitPromotes", L"Unexpected tier for key 3");
+            success = false;
+        }
+        cache.Store(KeyFor(3), fake.Make(MakeWindowLikePixels(30)));
+        if (cache.Find(KeyFor(3))->pixels.bgra != MakeWindowLikePixels(30).bgra) {
+            PrintFailure(L"TestHotOverflowDemotesAndColdHitPromotes", L"Store did not replace the entry");
+            success = false;
+        }
+    }
+    if (fake.live != 0) {
+        PrintFailure(L"TestHotOverflowDemotesAndColdHitPromotes", L"Images leaked");
+        success = false;
+    }
+    return success;
+}
+
+bool TestColdByteLimitEvictsLeastRecent() {
+    FakeHooks fake;
+    std::vector<uint8_t> encoded;
+    shelltabs::EncodePreviewPixels(MakeWindowLikePixels(0), &encoded);
+
+    PreviewTierLimits limits;
+    limits.hotEntries = 1;
+    limits.coldBytes = encoded.size() * 5 / 2;
+    PreviewTierCache<FakeImage> cache(fake.Build(), limits);
+    for (int i = 0; i < 6; ++i) {
+        cache.Store(KeyFor(i), fake.Make(MakeWindowLikePixels(0)));
+    }
+    bool success = true;
+    const auto stats = cache.Stats();
+    if (stats.coldBytes > limits.coldBytes || stats.coldEntries != 2 || stats.coldEvictions != 3 ||
+        fake.evicted.size() != 3 || fake.evicted.front() != KeyFor(0)) {
+        PrintFailure(L"TestColdByteLimitEvictsLeastRecent", L"Cold tier ignored its byte limit or LRU order");
+        success = false;
+    }
+    if (cache.Contains(KeyFor(2)) || !cache.Contains(KeyFor(3)) || !cache.Contains(KeyFor(5))) {
+        PrintFailure(L"TestColdByteLimitEvictsLeastRecent", L"Wrong entries survived");
+        success = false;
+    }
+    return success;
+}
+
+bool TestUnreadableImagesAreDropped() {
+    FakeHooks fake;
+    PreviewTierLimits limits;
+    limits.hotEntries = 4;
+    PreviewTierCache<FakeImage> cache(fake.Build(), limits);
+    for (int i = 0; i < 4; ++i) {
+        cache.Store(KeyFor(i), fake.Make(MakeWindowLikePixels(static_cast<uint32_t>(i))));
+    }
+    fake.failReads = true;
+    bool success = true;
+    if (cache.DemoteColdest(2) != 2 || cache.Contains(KeyFor(0)) || cache.Contains(KeyFor(1)) ||
+        cache.Stats().coldEntries != 0 || fake.live != 2) {
+        PrintFailure(L"TestUnreadableImagesAreDropped", L"Unreadable images were not dropped");
+        success = false;
+    }
+    fake.failReads = false;
+    if (cache.DemoteColdest(10) != 2 || cache.Stats().coldEntries != 2 || fake.live != 0) {
+        PrintFailure(L"TestUnreadableImagesAreDropped", L"DemoteColdest did not empty the hot tier");
+        success = false;
+    }
+    cache.Clear();
+    if (cache.Stats().coldBytes != 0 || cache.Stats().coldRawBytes != 0) {
+        PrintFailure(L"TestUnreadableImagesAreDropped", L"Clear left cold bytes accounted");
+        success = false;
+    }
+    return success;
+}
+
+// Benchmark: codec throughput on window-like previews, and how many previews
+// the default limits keep for a user cycling through 300 tabs.
+bool TestCodecAndTierBenchmark() {
+    constexpr int kSamples = 32;
+    std::vector<PreviewPixels> samples;
+    for (int i = 0; i < kSamples; ++i) {
+        samples.push_back(MakeWindowLikePixels(static_cast<uint32_t>(i)));
+    }
+    const size_t rawBytes = samples.front().bgra.size() * sizeof(uint32_t);
+
+    std::vector<std::vector<uint8_t>> encoded(kSamples);
+    size_t encodedBytes = 0;
+    const auto encodeStart = std::chrono::steady_clock::now();
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < kSamples; ++i) {
+            shelltabs::EncodePreviewPixels(samples[i], &encoded[i]);
+        }
+    }
+    const auto encodeTime = std::chrono::steady_clock::now() - encodeStart;
+    for (const auto& stream : encoded) {
+        encodedBytes += stream.size();
+    }
+
+    PreviewPixels decoded;
+    const auto decodeStart = std::chrono::steady_clock::now();
+    for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < kSamples; ++i) {
+            shelltabs::DecodePreviewPixels(encoded[i].data(), encoded[i].size(), kWidth, kHeight, &decoded);
+        }
+    }
+    const auto decodeTime = std::chrono::steady_clock::now() - decodeStart;
+
+    const double megabytes = static_cast<double>(rawBytes) * kSamples * 4 / (1024.0 * 1024.0);
+    const auto seconds = [](auto duration) { return std::chrono::duration<double>(duration).count(); };
+    std::wcout << L"[TestCodecAndTierBenchmark] ratio=" << static_cast<double>(rawBytes * kSamples) / encodedBytes
+               << L" encode=" << megabytes / seconds(encodeTime) << L"MB/s decode="
+               << megabytes / seconds(decodeTime) << L"MB/s" << std::endl;
+
+    FakeHooks fake;
+    PreviewTierCache<FakeImage> cache(fake.Build(), PreviewTierLimits{});
+    for (int i = 0; i < 300; ++i) {
+        cache.Store(KeyFor(i), fake.Make(samples[i % kSamples]));
+    }
+    int resident = 0;
+    for (int i = 0; i < 300; ++i) {
+        resident += cache.Contains(KeyFor(i)) ? 1 : 0;
+    }
+    const auto stats = cache.Stats();
+    std::wcout << L"[TestCodecAndTierBenchmark] 300 tabs: resident=" << resident << L" hot=" << stats.hotEntries
+               << L" coldKiB=" << stats.coldBytes / 1024 << L" (raw " << stats.coldRawBytes / 1024 << L")"
+               << std::endl;
+    if (resident != 300) {
+        PrintFailure(L"TestCodecAndTierBenchmark", L"Default limits did not keep 300 previews");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestCodecRoundTripsAndCompresses", &TestCodecRoundTripsAndCompresses},
+        {L"TestDecoderRejectsMalformedStreams", &TestDecoderRejectsMalformedStreams},
+        {L"TestHotOverflowDemotesAndColdHitPromotes", &TestHotOverflowDemotesAndColdHitPromotes},
+        {L"TestColdByteLimitEvictsLeastRecent", &TestColdByteLimitEvictsLeastRecent},
+        {L"TestUnreadableImagesAreDropped", &TestUnreadableImagesAreDropped},
+        {L"TestCodecAndTierBenchmark", &TestCodecAndTierBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Preview tier cache tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Preview tier cache tests passed." << std::endl;
+    return 0;
+}
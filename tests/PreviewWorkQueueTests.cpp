@@ -0,0 +1,314 @@
+#include "PreviewWorkQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using shelltabs::PreviewPriority;
+using shelltabs::PreviewWorkQueue;
+using shelltabs::PreviewWorkQueueOptions;
+using namespace std::chrono_literals;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Holds workers inside a task until released, so tests can queue work behind
+// it deterministically.
+class Gate {
+public:
+    void Wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ++m_waiting;
+        m_changed.notify_all();
+        m_changed.wait(lock, [this]() { return m_open; });
+    }
+
+    void WaitForWaiters(int count) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_changed.wait(lock, [&]() { return m_waiting >= count; });
+    }
+
+    void Open() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open = true;
+        }
+        m_changed.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    int m_waiting = 0;
+    bool m_open = false;
+};
+
+class OrderRecorder {
+public:
+    void Add(int value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_order.push_back(value);
+    }
+
+    std::vector<int> Order() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_order;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<int> m_order;
+};
+
+PreviewWorkQueueOptions SingleWorker() {
+    PreviewWorkQueueOptions options;
+    options.workers = 1;
+    options.agingStep = 1h;
+    return options;
+}
+
+void WaitForIdle(const PreviewWorkQueue& queue, size_t expectedStarted) {
+    const auto giveUp = std::chrono::steady_clock::now() + 5s;
+    while (std::chrono::steady_clock::now() < giveUp) {
+        size_t started = 0;
+        for (const auto& stats : queue.Stats()) {
+            started += stats.started;
+        }
+        if (started >= expectedStarted && queue.Pending() == 0) {
+            return;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+}
+
+bool TestPriorityClassesRunInOrder() {
+    PreviewWorkQueue queue(SingleWorker());
+    Gate gate;
+    OrderRecorder recorder;
+    queue.Submit(PreviewPriority::kBackground, [&]() { gate.Wait(); });
+    gate.WaitForWaiters(1);
+
+    queue.Submit(PreviewPriority::kBackground, [&]() { recorder.Add(30); });
+    queue.Submit(PreviewPriority::kPrefetch, [&]() { recorder.Add(20); });
+    queue.Submit(PreviewPriority::kBackground, [&]() { recorder.Add(31); });
+    queue.Submit(PreviewPriority::kInteractive, [&]() { recorder.Add(10); });
+    queue.Submit(PreviewPriority::kPrefetch, [&]() { recorder.Add(21); });
+    gate.Open();
+    WaitForIdle(queue, 6);
+
+    const std::vector<int> expected = {10, 20, 21, 30, 31};
+    if (recorder.Order() != expected) {
+        PrintFailure(L"TestPriorityClassesRunInOrder", L"Tasks did not run by class, then submission order");
+        return false;
+    }
+    return true;
+}
+
+bool TestCancelRemovesQueuedWork() {
+    PreviewWorkQueue queue(SingleWorker());
+    Gate gate;
+    std::atomic<int> ran{0};
+    queue.Submit(PreviewPriority::kInteractive, [&]() { gate.Wait(); });
+    gate.WaitForWaiters(1);
+
+    std::vector<uint64_t> ids;
+    for (int i = 0; i < 10; ++i) {
+        ids.push_back(queue.Submit(PreviewPriority::kBackground, [&]() { ++ran; }));
+    }
+    bool success = true;
+    for (size_t i = 0; i < ids.size(); i += 2) {
+        if (!queue.Cancel(ids[i])) {
+            PrintFailure(L"TestCancelRemovesQueuedWork", L"Cancel missed a queued task");
+            success = false;
+        }
+    }
+    if (queue.Pending() != 5 || queue.Cancel(ids[0])) {
+        PrintFailure(L"TestCancelRemovesQueuedWork", L"Cancelled tasks were not removed from the queue");
+        success = false;
+    }
+    gate.Open();
+    WaitForIdle(queue, 6);
+
+    const auto stats = queue.Stats()[static_cast<size_t>(PreviewPriority::kBackground)];
+    if (ran.load() != 5 || stats.cancelled != 5 || stats.started != 5) {
+        PrintFailure(L"TestCancelRemovesQueuedWork", L"Cancelled work still ran");
+        success = false;
+    }
+    if (queue.Cancel(ids[1])) {
+        PrintFailure(L"TestCancelRemovesQueuedWork", L"Cancel reported success for finished work");
+        success = false;
+    }
+    return success;
+}
+
+bool TestReprioritizePromotesQueuedWork() {
+    PreviewWorkQueue queue(SingleWorker());
+    Gate gate;
+    OrderRecorder recorder;
+    queue.Submit(PreviewPriority::kInteractive, [&]() { gate.Wait(); });
+    gate.WaitForWaiters(1);
+
+    queue.Submit(PreviewPriority::kPrefetch, [&]() { recorder.Add(1); });
+    const uint64_t promoted = queue.Submit(PreviewPriority::kBackground, [&]() { recorder.Add(2); });
+    queue.Submit(PreviewPriority::kInteractive, [&]() { recorder.Add(3); });
+    queue.Reprioritize(promoted, PreviewPriority::kInteractive);
+    gate.Open();
+    WaitForIdle(queue, 4);
+
+    // The promoted task keeps its earlier submission time within its new class.
+    const std::vector<int> expected = {2, 3, 1};
+    if (recorder.Order() != expected) {
+        PrintFailure(L"TestReprioritizePromotesQueuedWork", L"Promoted task did not move ahead");
+        return false;
+    }
+    return true;
+}
+
+bool TestAgingPreventsStarvation() {
+    PreviewWorkQueueOptions options = SingleWorker();
+    options.agingStep = 5ms;
+    PreviewWorkQueue queue(options);
+    std::atomic<bool> backgroundRan{false};
+
+    queue.Submit(PreviewPriority::kBackground, [&]() { backgroundRan = true; });
+    // A steady stream of interactive work that would starve strict priority.
+    const auto giveUp = std::chrono::steady_clock::now() + 2s;
+    while (!backgroundRan.load() && std::chrono::steady_clock::now() < giveUp) {
+        queue.Submit(PreviewPriority::kInteractive, [&]() { std::this_thread::sleep_for(1ms); });
+        std::this_thread::sleep_for(500us);
+    }
+    queue.Shutdown();
+
+    if (!backgroundRan.load()) {
+        PrintFailure(L"TestAgingPreventsStarvation", L"Background task starved behind interactive work");
+        return false;
+    }
+    return true;
+}
+
+// Benchmark: a burst of slow fake captures lands just before a hover. Compare
+// the hover's wait on the old single FIFO worker with the prioritized pool.
+bool TestHoverLatencyUnderCaptureBurst() {
+    constexpr int kCaptures = 8;
+    constexpr auto kCaptureCost = 20ms;
+    constexpr auto kHoverCost = 5ms;
+
+    const auto measure = [&](PreviewWorkQueueOptions options, PreviewPriority capturePriority) {
+        PreviewWorkQueue queue(std::move(options));
+        for (int i = 0; i < kCaptures; ++i) {
+            queue.Submit(capturePriority, [&]() { std::this_thread::sleep_for(kCaptureCost); });
+        }
+        std::this_thread::sleep_for(2ms);
+        std::atomic<bool> done{false};
+        const auto requested = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point finished{};
+        queue.Submit(PreviewPriority::kInteractive, [&]() {
+            std::this_thread::sleep_for(kHoverCost);
+            finished = std::chrono::steady_clock::now();
+            done = true;
+        });
+        while (!done.load()) {
+            std::this_thread::sleep_for(1ms);
+        }
+        WaitForIdle(queue, kCaptures + 1);
+        return std::chrono::duration_cast<std::chrono::milliseconds>(finished - requested);
+    };
+
+    PreviewWorkQueueOptions fifo = SingleWorker();
+    const auto baseline = measure(fifo, PreviewPriority::kInteractive);
+
+    PreviewWorkQueueOptions pool;
+    pool.workers = 2;
+    const auto prioritized = measure(pool, PreviewPriority::kBackground);
+
+    std::wcout << L"[TestHoverLatencyUnderCaptureBurst] fifo=" << baseline.count() << L"ms pool="
+               << prioritized.count() << L"ms" << std::endl;
+
+    // The pool keeps a worker free for hovers, so the wait is roughly the
+    // hover's own cost rather than the whole burst.
+    if (prioritized >= baseline || prioritized > kCaptureCost * 3) {
+        PrintFailure(L"TestHoverLatencyUnderCaptureBurst", L"Hover waited behind the capture burst");
+        return false;
+    }
+    return true;
+}
+
+bool TestShutdownDropsQueuedWork() {
+    PreviewWorkQueueOptions options = SingleWorker();
+    std::atomic<int> started{0};
+    std::atomic<int> stopped{0};
+    options.threadStart = [&]() { ++started; };
+    options.threadStop = [&]() { ++stopped; };
+    PreviewWorkQueue queue(options);
+    Gate gate;
+    std::atomic<int> ran{0};
+    queue.Submit(PreviewPriority::kInteractive, [&]() { gate.Wait(); });
+    gate.WaitForWaiters(1);
+    for (int i = 0; i < 4; ++i) {
+        queue.Submit(PreviewPriority::kPrefetch, [&]() { ++ran; });
+    }
+
+    std::thread closer([&]() { queue.Shutdown(); });
+    // Shutdown empties the queue before it waits for the running task.
+    while (queue.Pending() != 0) {
+        std::this_thread::sleep_for(1ms);
+    }
+    gate.Open();
+    closer.join();
+
+    bool success = true;
+    if (ran.load() != 0 || queue.Submit(PreviewPriority::kInteractive, [&]() { ++ran; }) != 0) {
+        PrintFailure(L"TestShutdownDropsQueuedWork", L"Work ran after shutdown");
+        success = false;
+    }
+    if (started.load() != 1 || stopped.load() != 1) {
+        PrintFailure(L"TestShutdownDropsQueuedWork", L"Thread hooks did not run once per worker");
+        success = false;
+    }
+    return success;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestPriorityClassesRunInOrder", &TestPriorityClassesRunInOrder},
+        {L"TestCancelRemovesQueuedWork", &TestCancelRemovesQueuedWork},
+        {L"TestReprioritizePromotesQueuedWork", &TestReprioritizePromotesQueuedWork},
+        {L"TestAgingPreventsStarvation", &TestAgingPreventsStarvation},
+        {L"TestHoverLatencyUnderCaptureBurst", &TestHoverLatencyUnderCaptureBurst},
+        {L"TestShutdownDropsQueuedWork", &TestShutdownDropsQueuedWork},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Preview work queue tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Preview work queue tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include "TabBandLayout.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::TabBandLayout;
+using shelltabs::TabLayoutEntry;
+using shelltabs::TabLayoutEntryKind;
+using shelltabs::TabLayoutMetrics;
+using shelltabs::TabLayoutSlot;
+using shelltabs::TabLayoutSlotKind;
+using shelltabs::TabLayoutUpdate;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// The band's own constants on a 600 pixel wide band with a 9 pixel grip.
+TabLayoutMetrics MakeMetrics(int32_t maxX = 560, int32_t maxRows = 5) {
+    TabLayoutMetrics metrics;
+    metrics.boundsLeft = 0;
+    metrics.originX = 6;
+    metrics.maxX = maxX;
+    metrics.top = 2;
+    metrics.rowHeight = 24;
+    metrics.rowGap = 2;
+    metrics.maxRows = maxRows;
+    metrics.tabGap = 4;
+    metrics.groupGap = 4;
+    metrics.indicatorWidth = 5;
+    metrics.emptyBodyMaxWidth = 32;
+    metrics.minTabWidth = 40;
+    return metrics;
+}
+
+TabLayoutEntry Header(int32_t group, bool visible = true, bool collapsed = false, bool hasVisibleTabs = true) {
+    TabLayoutEntry entry;
+    entry.kind = TabLayoutEntryKind::kGroupHeader;
+    entry.groupIndex = group;
+    entry.headerVisible = visible;
+    entry.collapsed = collapsed;
+    entry.hasVisibleTabs = hasVisibleTabs;
+    return entry;
+}
+
+TabLayoutEntry Tab(int32_t group, int32_t width) {
+    TabLayoutEntry entry;
+    entry.kind = TabLayoutEntryKind::kTab;
+    entry.groupIndex = group;
+    entry.width = width;
+    return entry;
+}
+
+bool SameRect(const shelltabs::PaintRect& left, const shelltabs::PaintRect& right) {
+    return left.left == right.left && left.top == right.top && left.right == right.right &&
+           left.bottom == right.bottom;
+}
+
+bool SameSlot(const TabLayoutSlot& left, const TabLayoutSlot& right) {
+    return left.kind == right.kind && left.entry == right.entry && SameRect(left.bounds, right.bounds) &&
+           left.row == right.row && left.firstInGroup == right.firstInGroup &&
+           left.collapsedPlaceholder == right.collapsedPlaceholder &&
+           left.indicatorHandle == right.indicatorHandle && left.header == right.header;
+}
+
+// Compares an incrementally updated layout with one laid out from scratch.
+bool SameLayout(const TabBandLayout& incremental, const TabBandLayout& fresh, std::wstring* message) {
+    const auto& slots = incremental.Slots();
+    const auto& expected = fresh.Slots();
+    if (slots.size() != expected.size()) {
+        *message = L"slot count " + std::to_wstring(slots.size()) + L" != " + std::to_wstring(expected.size());
+        return false;
+    }
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (!SameSlot(slots[i], expected[i])) {
+            *message = L"slot " + std::to_wstring(i) + L" differs";
+            return false;
+        }
+    }
+    if (incremental.EndX() != fresh.EndX() || incremental.EndRow() != fresh.EndRow() ||
+        incremental.MaxRowUsed() != fresh.MaxRowUsed() || incremental.Truncated() != fresh.Truncated()) {
+        *message = L"end state differs";
+        return false;
+    }
+    return true;
+}
+
+bool TestWrapsIntoRows() {
+    TabBandLayout layout;
+    std::vector<TabLayoutEntry> entries = {Header(0), Tab(0, 200), Tab(0, 200), Tab(0, 200), Header(1), Tab(1, 100)};
+    layout.Update(entries, MakeMetrics());
+
+    const auto& slots = layout.Slots();
+    if (slots.size() != 6) {
+        PrintFailure(L"TestWrapsIntoRows", L"Expected six slots");
+        return false;
+    }
+    // The indicator a group gap past the origin, the first tab right after
+    // it, the second 4 pixels on; the third does not fit before 560 and wraps.
+    if (slots[0].kind != TabLayoutSlotKind::kIndicator || !SameRect(slots[0].bounds, {10, 2, 15, 26}) ||
+        !SameRect(slots[1].bounds, {15, 2, 215, 26}) || !slots[1].firstInGroup || slots[1].header != 0 ||
+        !SameRect(slots[2].bounds, {219, 2, 419, 26}) || slots[2].firstInGroup) {
+        PrintFailure(L"TestWrapsIntoRows", L"First row misplaced");
+        return false;
+    }
+    if (slots[3].row != 1 || !SameRect(slots[3].bounds, {6, 28, 206, 52})) {
+        PrintFailure(L"TestWrapsIntoRows", L"Third tab did not wrap to the second row");
+        return false;
+    }
+    // The next group starts a group gap on.
+    if (!SameRect(slots[4].bounds, {210, 28, 215, 52}) || !SameRect(slots[5].bounds, {215, 28, 315, 52})) {
+        PrintFailure(L"TestWrapsIntoRows", L"Second group misplaced");
+        return false;
+    }
+    if (layout.EndX() != 315 || layout.EndRow() != 1 || layout.MaxRowUsed() != 1 || layout.Truncated()) {
+        PrintFailure(L"TestWrapsIntoRows", L"Unexpected end state");
+        return false;
+    }
+
+    // On the last row tabs shrink to the minimum width and run past the end.
+    TabBandLayout oneRow;
+    oneRow.Update({Tab(-1, 300), Tab(-1, 300), Tab(-1, 300)}, MakeMetrics(560, 1));
+    const auto& clamped = oneRow.Slots();
+    if (clamped.size() != 3 || !SameRect(clamped[1].bounds, {314, 2, 560, 26}) ||
+        !SameRect(clamped[2].bounds, {564, 2, 604, 26})) {
+        PrintFailure(L"TestWrapsIntoRows", L"Last row tabs not clamped");
+        return false;
+    }
+    return true;
+}
+
+bool TestHeaderHandles() {
+    TabBandLayout layout;
+    // Group 0 has a hidden header, so its first tab carries the header; group
+    // 1 is an empty island; group 2's handle follows its first tab to row 1.
+    std::vector<TabLayoutEntry> entries = {Header(0, false), Tab(0, 120), Tab(0, 120),
+                                           Header(1, true, false, false), Header(2), Tab(2, 300)};
+    layout.Update(entries, MakeMetrics());
+    const auto& slots = layout.Slots();
+    if (slots.size() != 6) {
+        PrintFailure(L"TestHeaderHandles", L"Expected six slots, got " + std::to_wstring(slots.size()));
+        return false;
+    }
+    if (slots[0].kind != TabLayoutSlotKind::kTab || slots[0].header != 0 || !slots[0].firstInGroup ||
+        slots[1].header != 0 || !SameRect(slots[0].bounds, {6, 2, 126, 26})) {
+        PrintFailure(L"TestHeaderHandles", L"Hidden header not handed to its tabs");
+        return false;
+    }
+    if (slots[2].kind != TabLayoutSlotKind::kIndicator || !SameRect(slots[2].bounds, {254, 2, 259, 26}) ||
+        slots[3].kind != TabLayoutSlotKind::kEmptyBody || slots[3].header != 3 ||
+        !SameRect(slots[3].bounds, {259, 2, 291, 26})) {
+        PrintFailure(L"TestHeaderHandles", L"Empty island misplaced");
+        return false;
+    }
+    if (slots[4].kind != TabLayoutSlotKind::kIndicator || slots[4].row != 1 ||
+        !SameRect(slots[4].bounds, {6, 28, 11, 52}) || !SameRect(slots[5].bounds, {11, 28, 311, 52})) {
+        PrintFailure(L"TestHeaderHandles", L"Handle did not follow its tab to the next row");
+        return false;
+    }
+
+    // Headers that run out of rows end the layout.
+    TabBandLayout full;
+    full.Update({Tab(0, 500), Header(1), Tab(1, 50)}, MakeMetrics(505, 1));
+    if (!full.Truncated() || full.Slots().size() != 1) {
+        PrintFailure(L"TestHeaderHandles", L"Expected the layout to stop at the header");
+        return false;
+    }
+    return true;
+}
+
+bool TestRenameRelaysFromChangedTab() {
+    std::vector<TabLayoutEntry> entries;
+    for (int32_t group = 0; group < 8; ++group) {
+        entries.push_back(Header(group));
+        for (int32_t tab = 0; tab < 6; ++tab) {
+            entries.push_back(Tab(group, 100 + (group * 7 + tab * 13) % 60));
+        }
+    }
+    const TabLayoutMetrics metrics = MakeMetrics(1200, 8);
+    TabBandLayout layout;
+    layout.Update(entries, metrics);
+    const std::vector<TabLayoutSlot> before = layout.Slots();
+
+    // Group 1's third tab grows; the rest of its row moves and nothing past
+    // the next wrap does.
+    entries[10].width += 30;
+    const TabLayoutUpdate update = layout.Update(entries, metrics);
+    if (update.full || update.firstEntry != 10 || update.firstSlot != 10) {
+        PrintFailure(L"TestRenameRelaysFromChangedTab", L"Expected the update to start at the renamed tab");
+        return false;
+    }
+    if (update.endSlot >= layout.Slots().size() || update.endSlot != update.oldEndSlot) {
+        PrintFailure(L"TestRenameRelaysFromChangedTab", L"Expected the wrapping to converge before the end");
+        return false;
+    }
+    for (size_t i = 0; i < before.size(); ++i) {
+        if ((i < update.firstSlot || i >= update.endSlot) && !SameSlot(before[i], layout.Slots()[i])) {
+            PrintFailure(L"TestRenameRelaysFromChangedTab", L"Slot outside the update moved");
+            return false;
+        }
+    }
+    if (update.groups.empty() || update.groups.front() != 1) {
+        PrintFailure(L"TestRenameRelaysFromChangedTab", L"Renamed tab's group not reported");
+        return false;
+    }
+
+    TabBandLayout fresh;
+    fresh.Update(entries, metrics);
+    std::wstring message;
+    if (!SameLayout(layout, fresh, &message)) {
+        PrintFailure(L"TestRenameRelaysFromChangedTab", message);
+        return false;
+    }
+
+    // The same entries again change nothing.
+    if (layout.Update(entries, metrics).Changed()) {
+        PrintFailure(L"TestRenameRelaysFromChangedTab", L"Unchanged entries reported a change");
+        return false;
+    }
+    return true;
+}
+
+bool TestIncrementalMatchesFullLayout() {
+    uint32_t seed = 0x2545F491u;
+    auto next = [&](uint32_t bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % bound;
+    };
+    auto randomEntry = [&]() {
+        const int32_t group = static_cast<int32_t>(next(6)) - 1;
+        if (next(5) == 0) {
+            return Header(group, next(3) != 0, next(6) == 0, next(4) != 0);
+        }
+        return Tab(group, 40 + static_cast<int32_t>(next(220)));
+    };
+
+    std::vector<TabLayoutEntry> entries;
+    for (int i = 0; i < 60; ++i) {
+        entries.push_back(randomEntry());
+    }
+
+    TabBandLayout layout;
+    TabLayoutMetrics metrics = MakeMetrics(900, 5);
+    for (int step = 0; step < 600; ++step) {
+        const uint32_t edit = next(10);
+        const size_t at = entries.empty() ? 0 : next(static_cast<uint32_t>(entries.size()));
+        if (edit < 3 || entries.empty()) {
+            entries.insert(entries.begin() + static_cast<ptrdiff_t>(at), randomEntry());
+        } else if (edit < 5) {
+            entries.erase(entries.begin() + static_cast<ptrdiff_t>(at));
+        } else if (edit < 8) {
+            entries[at].width = 40 + static_cast<int32_t>(next(220));
+        } else if (edit < 9) {
+            entries[at] = randomEntry();
+        } else {
+            metrics = MakeMetrics(600 + static_cast<int32_t>(next(600)), 1 + static_cast<int32_t>(next(5)));
+        }
+
+        layout.Update(entries, metrics);
+        TabBandLayout fresh;
+        fresh.Update(entries, metrics);
+        std::wstring message;
+        if (!SameLayout(layout, fresh, &message)) {
+            PrintFailure(L"TestIncrementalMatchesFullLayout", L"Step " + std::to_wstring(step) + L": " + message);
+            return false;
+        }
+    }
+    if (layout.Stats().reusedEntries == 0) {
+        PrintFailure(L"TestIncrementalMatchesFullLayout", L"No update converged early");
+        return false;
+    }
+    return true;
+}
+
+bool TestRelayoutBenchmark() {
+    constexpr int32_t kTabs = 1000;
+    constexpr int kEdits = 200;
+
+    // 1000 tabs in 50 groups over roughly 20 rows of a 7000 pixel band.
+    std::vector<TabLayoutEntry> entries;
+    for (int32_t i = 0; i < kTabs; ++i) {
+        if (i % 20 == 0) {
+            entries.push_back(Header(i / 20));
+        }
+        entries.push_back(Tab(i / 20, 90 + (i * 37) % 80));
+    }
+    const TabLayoutMetrics metrics = MakeMetrics(7000, 32);
+
+    // Each edit renames one tab; odd edits rename it back.
+    std::vector<size_t> targets;
+    uint32_t seed = 12345u;
+    for (int edit = 0; edit < kEdits; ++edit) {
+        seed = seed * 1664525u + 1013904223u;
+        targets.push_back((seed >> 8) % entries.size());
+    }
+    auto edited = [&](int edit) {
+        std::vector<TabLayoutEntry> copy = entries;
+        if (copy[targets[edit]].kind == TabLayoutEntryKind::kTab) {
+            copy[targets[edit]].width += 25;
+        } else {
+            copy[targets[edit]].collapsed = !copy[targets[edit]].collapsed;
+        }
+        return copy;
+    };
+    std::vector<std::vector<TabLayoutEntry>> inputs;
+    for (int edit = 0; edit < kEdits; ++edit) {
+        inputs.push_back(edited(edit));
+        inputs.push_back(entries);
+    }
+
+    uint64_t fullPlaced = 0;
+    const auto fullStart = std::chrono::steady_clock::now();
+    for (const auto& input : inputs) {
+        TabBandLayout fresh;
+        fresh.Update(input, metrics);
+        fullPlaced += fresh.Stats().placedEntries;
+    }
+    const double fullMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - fullStart).count();
+
+    TabBandLayout layout;
+    layout.Update(entries, metrics);
+    const uint64_t initialPlaced = layout.Stats().placedEntries;
+    const auto incrementalStart = std::chrono::steady_clock::now();
+    for (const auto& input : inputs) {
+        layout.Update(input, metrics);
+    }
+    const double incrementalMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - incrementalStart).count();
+    const uint64_t incrementalPlaced = layout.Stats().placedEntries - initialPlaced;
+
+    if (layout.MaxRowUsed() < 10) {
+        PrintFailure(L"TestRelayoutBenchmark", L"Expected the tabs to span many rows");
+        return false;
+    }
+    TabBandLayout fresh;
+    fresh.Update(entries, metrics);
+    std::wstring message;
+    if (!SameLayout(layout, fresh, &message)) {
+        PrintFailure(L"TestRelayoutBenchmark", message);
+        return false;
+    }
+    if (incrementalPlaced * 10 > fullPlaced) {
+        PrintFailure(L"TestRelayoutBenchmark", L"Incremental updates placed " + std::to_wstring(incrementalPlaced) +
+                                                   L" entries, full layouts " + std::to_wstring(fullPlaced));
+        return false;
+    }
+
+    std::wcout << L"[TestRelayoutBenchmark] " << kTabs << L" tabs on " << (layout.MaxRowUsed() + 1) << L" rows, "
+               << inputs.size() << L" updates: placed " << fullPlaced << L" -> " << incrementalPlaced << L", "
+               << std::fixed << std::setprecision(2) << fullMs << L" ms -> " << incrementalMs << L" ms" << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestWrapsIntoRows", &TestWrapsIntoRows},
+        {L"TestHeaderHandles", &TestHeaderHandles},
+        {L"TestRenameRelaysFromChangedTab", &TestRenameRelaysFromChangedTab},
+        {L"TestIncrementalMatchesFullLayout", &TestIncrementalMatchesFullLayout},
+        {L"TestRelayoutBenchmark", &TestRelayoutBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Tab band layout tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Tab band layout tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,470 @@
+#include "SoftwareTabBandPainter.h"
+#include "TabBandPaint.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef SHELLTABS_TEST_GOLDEN_DIR
+#define SHELLTABS_TEST_GOLDEN_DIR "tests/golden"
+#endif
+
+namespace {
+
+using shelltabs::GroupOutlineVisual;
+using shelltabs::MakePaintColor;
+using shelltabs::PaintColor;
+using shelltabs::PaintLineStyle;
+using shelltabs::PaintPoint;
+using shelltabs::PaintRect;
+using shelltabs::PaintTextAlign;
+using shelltabs::SoftwareTabBandPainter;
+using shelltabs::TabBandScene;
+using shelltabs::TabCloseState;
+using shelltabs::TabVisual;
+using shelltabs::TabVisualKind;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Layout constants mirrored from TabBandWindow.
+constexpr int32_t kTabGap = 4;
+constexpr int32_t kPaddingX = 12;
+constexpr int32_t kTabCornerRadius = 8;
+constexpr int32_t kIconGap = 6;
+constexpr int32_t kIconSize = 16;
+constexpr int32_t kIslandIndicatorWidth = 5;
+constexpr int32_t kCloseButtonSize = 14;
+constexpr int32_t kCloseButtonEdgePadding = 6;
+constexpr int32_t kCloseButtonSpacing = 6;
+constexpr int32_t kPinnedGlyphWidth = 12;
+constexpr int32_t kPinnedGlyphPadding = 6;
+
+constexpr uint32_t kWhite = 0xFFFFFFFFu;
+constexpr uint32_t kBlack = 0xFF000000u;
+
+struct Palette {
+    PaintColor backgroundTop;
+    PaintColor backgroundBottom;
+    PaintColor tab;
+    PaintColor selectedTab;
+    PaintColor border;
+    PaintColor text;
+    PaintColor accent;
+    PaintColor closeNormal;
+    PaintColor closeHot;
+    PaintColor closePressed;
+};
+
+constexpr Palette kLight{MakePaintColor(236, 240, 246), MakePaintColor(214, 222, 232), MakePaintColor(226, 230, 236),
+                         MakePaintColor(255, 255, 255), MakePaintColor(160, 168, 180), MakePaintColor(20, 24, 32),
+                         MakePaintColor(0, 120, 215),   MakePaintColor(226, 230, 236), MakePaintColor(200, 206, 214),
+                         MakePaintColor(176, 184, 196)};
+
+constexpr Palette kDark{MakePaintColor(40, 42, 48),    MakePaintColor(28, 30, 34),  MakePaintColor(52, 54, 60),
+                        MakePaintColor(70, 74, 82),    MakePaintColor(96, 100, 110), MakePaintColor(230, 232, 236),
+                        MakePaintColor(255, 140, 40),  MakePaintColor(52, 54, 60),  MakePaintColor(196, 43, 28),
+                        MakePaintColor(150, 30, 20)};
+
+struct TabSpec {
+    std::wstring name;
+    int32_t width = 120;
+    bool selected = false;
+    bool island = false;
+    bool icon = false;
+    bool pinned = false;
+    bool closable = true;
+    TabCloseState closeState = TabCloseState::kNormal;
+    int progress = -1;  // percent, 101 for indeterminate
+};
+
+const int kIconToken = 0;
+
+// Lays tabs out the way TabBandWindow::ComputeTabPaintMetrics does.
+TabVisual MakeTab(const TabSpec& spec, int32_t left, int32_t top, int32_t bottom, const Palette& palette) {
+    TabVisual visual;
+    visual.bounds = {left, top, left + spec.width, bottom};
+    visual.tabBounds = visual.bounds;
+    const int32_t indicator = spec.island ? kIslandIndicatorWidth : 0;
+    visual.tabBounds.left += indicator;
+    visual.selected = spec.selected;
+    visual.cornerRadius = kTabCornerRadius;
+    visual.background = spec.selected ? palette.selectedTab : palette.tab;
+    visual.border = palette.border;
+    visual.bottomLine = spec.selected ? palette.selectedTab : palette.border;
+    visual.text = palette.text;
+    if (spec.island) {
+        visual.hasIndicator = true;
+        visual.indicator = {left, top, left + kIslandIndicatorWidth, bottom};
+        visual.indicatorColor = palette.accent;
+    }
+
+    const int32_t height = bottom - top;
+    if (spec.closable) {
+        const int32_t size = std::min(kCloseButtonSize, height - 6);
+        const int32_t right = visual.bounds.right - kCloseButtonEdgePadding;
+        const int32_t closeTop = top + (height - size) / 2;
+        visual.close.bounds = {right - size, closeTop, right, closeTop + size};
+        visual.close.state = spec.closeState;
+        visual.close.background = spec.closeState == TabCloseState::kPressed ? palette.closePressed
+                                  : spec.closeState == TabCloseState::kHot   ? palette.closeHot
+                                                                             : palette.closeNormal;
+        visual.close.border = palette.border;
+        visual.close.glyph = palette.text;
+    }
+
+    const int32_t iconLeft = left + indicator + kPaddingX;
+    visual.textLeft = iconLeft;
+    visual.textRight = visual.bounds.right - kPaddingX;
+    if (!visual.close.bounds.Empty()) {
+        visual.textRight = std::min(visual.textRight, visual.close.bounds.left - kCloseButtonSpacing);
+    }
+    if (spec.icon) {
+        visual.icon = &kIconToken;
+        const int32_t iconTop = top + (height - kIconSize) / 2;
+        visual.iconBounds = {iconLeft, iconTop, iconLeft + kIconSize, iconTop + kIconSize};
+        visual.textLeft += kIconSize + kIconGap;
+    }
+    const int32_t progressLeft = visual.textLeft;
+    if (spec.pinned) {
+        visual.pinned = true;
+        visual.pinnedGlyphLeft = visual.textLeft;
+        visual.pinnedGlyphWidth = kPinnedGlyphWidth;
+        visual.textLeft += kPinnedGlyphWidth + kPinnedGlyphPadding;
+    }
+    visual.name = spec.name;
+
+    if (spec.progress >= 0) {
+        auto& progress = visual.progress;
+        progress.visible = true;
+        progress.indeterminate = spec.progress > 100;
+        progress.fraction = std::min(spec.progress, 100) / 100.0;
+        progress.tickMs = 1234;
+        progress.bounds = {progressLeft, std::max(visual.tabBounds.top + 4, visual.tabBounds.bottom - 6),
+                           visual.textRight, visual.tabBounds.bottom - 2};
+        progress.track = palette.tab;
+        progress.border = palette.border;
+        progress.fillStart = palette.accent;
+        progress.fillEnd = palette.text;
+    }
+    return visual;
+}
+
+TabBandScene MakeScene(const std::vector<TabSpec>& tabs, const Palette& palette, int32_t width, int32_t height) {
+    TabBandScene scene;
+    scene.surface = {0, 0, width, height};
+    scene.client = scene.surface;
+    scene.backgroundTop = palette.backgroundTop;
+    scene.backgroundBottom = palette.backgroundBottom;
+    int32_t x = 4;
+    for (const TabSpec& spec : tabs) {
+        scene.items.push_back(MakeTab(spec, x, 2, height, palette));
+        x += spec.width + kTabGap;
+    }
+    return scene;
+}
+
+TabBandScene LightScene() {
+    const std::vector<TabSpec> tabs = {
+        {L"Documents", 130, true, true, true},
+        {L"Downloads and a name that needs an ellipsis", 150, false, false, true},
+        {L"Pinned", 110, false, false, true, true, false},
+        {L"Projects", 120, false, true, false, false, true, TabCloseState::kHot},
+    };
+    TabBandScene scene = MakeScene(tabs, kLight, 560, 30);
+    TabVisual header;
+    header.kind = TabVisualKind::kGroupHeader;
+    header.bounds = {538, 2, 554, 30};
+    header.hasIndicator = true;
+    header.indicator = {538, 2, 538 + kIslandIndicatorWidth, 30};
+    header.indicatorColor = MakePaintColor(80, 160, 60);
+    scene.items.push_back(header);
+    scene.outlines.push_back({{4, 1, 133, 29}, kLight.accent, PaintLineStyle::kSolid, 1});
+    scene.dropIndicatorX = 270;
+    scene.dropIndicatorColor = kLight.accent;
+    return scene;
+}
+
+TabBandScene DarkProgressScene() {
+    const std::vector<TabSpec> tabs = {
+        {L"Copying files", 150, true, true, true, false, true, TabCloseState::kPressed, 45},
+        {L"Indeterminate", 120, false, false, false, false, true, TabCloseState::kHot, 101},
+        {L"Done", 100, false, true, false, true, true, TabCloseState::kNormal, 100},
+        {L"D:\\Builds\\Nightly\\Contrast", 140, false, false, true},
+    };
+    TabBandScene scene = MakeScene(tabs, kDark, 560, 30);
+    TabVisual& contrast = scene.items.back();
+    contrast.highContrast = true;
+    contrast.background = MakePaintColor(0, 0, 0);
+    contrast.border = MakePaintColor(255, 255, 0);
+    contrast.text = MakePaintColor(255, 255, 0);
+    scene.outlines.push_back({{4, 1, 157, 29}, kDark.accent, PaintLineStyle::kDashed, 1});
+    scene.outlines.push_back({{282, 1, 385, 29}, MakePaintColor(120, 200, 120), PaintLineStyle::kDotted, 2});
+    scene.emptyIslandPluses.push_back({530, 8, 544, 22});
+    scene.plusColor = MakePaintColor(220, 220, 220);
+    return scene;
+}
+
+uint32_t PixelAt(const SoftwareTabBandPainter& painter, int32_t x, int32_t y) {
+    return painter.Pixels()[static_cast<size_t>(y) * painter.Width() + x];
+}
+
+size_t CountPixels(const SoftwareTabBandPainter& painter, const PaintRect& rect, uint32_t pixel) {
+    size_t count = 0;
+    for (int32_t y = rect.top; y < rect.bottom; ++y) {
+        for (int32_t x = rect.left; x < rect.right; ++x) {
+            count += PixelAt(painter, x, y) == pixel ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+bool WritePpm(const std::string& path, const SoftwareTabBandPainter& painter) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file << "P6\n" << painter.Width() << ' ' << painter.Height() << "\n255\n";
+    for (uint32_t pixel : painter.Pixels()) {
+        const char rgb[] = {static_cast<char>((pixel >> 16) & 0xFF), static_cast<char>((pixel >> 8) & 0xFF),
+                            static_cast<char>(pixel & 0xFF)};
+        file.write(rgb, sizeof(rgb));
+    }
+    return static_cast<bool>(file);
+}
+
+bool ReadPpm(const std::string& path, uint32_t* width, uint32_t* height, std::vector<uint32_t>* pixels) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    uint32_t maxValue = 0;
+    if (!(file >> magic >> *width >> *height >> maxValue) || magic != "P6" || maxValue != 255) {
+        return false;
+    }
+    file.get();
+    std::vector<unsigned char> rgb(static_cast<size_t>(*width) * *height * 3);
+    if (!file.read(reinterpret_cast<char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()))) {
+        return false;
+    }
+    pixels->resize(static_cast<size_t>(*width) * *height);
+    for (size_t i = 0; i < pixels->size(); ++i) {
+        (*pixels)[i] = 0xFF000000u | (static_cast<uint32_t>(rgb[i * 3]) << 16) |
+                       (static_cast<uint32_t>(rgb[i * 3 + 1]) << 8) | rgb[i * 3 + 2];
+    }
+    return true;
+}
+
+// Compares a rendered scene with tests/golden/<name>.ppm. Set
+// SHELLTABS_UPDATE_GOLDEN=1 to rewrite the goldens; on a mismatch the
+// rendering is left next to the golden as <name>.actual.ppm.
+bool MatchesGolden(const wchar_t* testName, const std::string& name, const TabBandScene& scene) {
+    SoftwareTabBandPainter painter(static_cast<uint32_t>(scene.surface.Width()),
+                                   static_cast<uint32_t>(scene.surface.Height()));
+    shelltabs::PaintTabBand(scene, painter);
+
+    const std::string goldenPath = std::string(SHELLTABS_TEST_GOLDEN_DIR) + "/" + name + ".ppm";
+    const char* update = std::getenv("SHELLTABS_UPDATE_GOLDEN");
+    if (update && std::string(update) == "1") {
+        if (!WritePpm(goldenPath, painter)) {
+            PrintFailure(testName, L"Could not write the golden image");
+            return false;
+        }
+        std::wcout << L"[" << testName << L"] Updated golden image" << std::endl;
+        return true;
+    }
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> golden;
+    if (!ReadPpm(goldenPath, &width, &height, &golden)) {
+        PrintFailure(testName, L"Missing or unreadable golden image; run with SHELLTABS_UPDATE_GOLDEN=1");
+        return false;
+    }
+    if (width != painter.Width() || height != painter.Height()) {
+        PrintFailure(testName, L"Golden image size differs from the scene");
+        return false;
+    }
+
+    size_t differing = 0;
+    size_t first = golden.size();
+    for (size_t i = 0; i < golden.size(); ++i) {
+        if (golden[i] != painter.Pixels()[i]) {
+            first = std::min(first, i);
+            ++differing;
+        }
+    }
+    if (differing == 0) {
+        return true;
+    }
+    const std::string actualPath = std::string(SHELLTABS_TEST_GOLDEN_DIR) + "/" + name + ".actual.ppm";
+    WritePpm(actualPath, painter);
+    std::wstringstream message;
+    message << differing << L" pixels differ from the golden image, first at (" << first % width << L", "
+            << first / width << L")";
+    PrintFailure(testName, message.str());
+    return false;
+}
+
+bool TestFillsLeaveOutRightAndBottom() {
+    SoftwareTabBandPainter painter(16, 16);
+    painter.Clear(MakePaintColor(0, 0, 0));
+    painter.FillRect({2, 3, 6, 8}, MakePaintColor(255, 255, 255));
+    if (CountPixels(painter, {0, 0, 16, 16}, kWhite) != 20 || PixelAt(painter, 2, 3) != kWhite ||
+        PixelAt(painter, 6, 3) != kBlack || PixelAt(painter, 2, 8) != kBlack) {
+        PrintFailure(L"TestFillsLeaveOutRightAndBottom", L"FillRect should cover [left, right) x [top, bottom)");
+        return false;
+    }
+
+    painter.Clear(MakePaintColor(0, 0, 0));
+    const PaintPoint square[] = {{2, 3}, {6, 3}, {6, 8}, {2, 8}};
+    painter.FillPolygon(square, std::size(square), MakePaintColor(255, 255, 255));
+    if (CountPixels(painter, {0, 0, 16, 16}, kWhite) != 20 || CountPixels(painter, {2, 3, 6, 8}, kWhite) != 20) {
+        PrintFailure(L"TestFillsLeaveOutRightAndBottom", L"A rectangular polygon should fill like FillRect");
+        return false;
+    }
+    return true;
+}
+
+bool TestLinesLeaveOutLastPixel() {
+    SoftwareTabBandPainter painter(16, 16);
+    painter.Clear(MakePaintColor(0, 0, 0));
+    painter.DrawLine({1, 4}, {9, 4}, MakePaintColor(255, 255, 255));
+    if (CountPixels(painter, {0, 0, 16, 16}, kWhite) != 8 || PixelAt(painter, 9, 4) != kBlack) {
+        PrintFailure(L"TestLinesLeaveOutLastPixel", L"A horizontal line should stop short of its end point");
+        return false;
+    }
+
+    painter.Clear(MakePaintColor(0, 0, 0));
+    painter.DrawLine({2, 2}, {12, 12}, MakePaintColor(255, 255, 255));
+    for (int32_t i = 2; i < 12; ++i) {
+        if (PixelAt(painter, i, i) != kWhite) {
+            PrintFailure(L"TestLinesLeaveOutLastPixel", L"A diagonal should cover each step");
+            return false;
+        }
+    }
+
+    painter.Clear(MakePaintColor(0, 0, 0));
+    const PaintPoint square[] = {{2, 2}, {10, 2}, {10, 10}, {2, 10}};
+    painter.StrokePolygon(square, std::size(square), MakePaintColor(255, 255, 255));
+    if (CountPixels(painter, {0, 0, 16, 16}, kWhite) != 32 || PixelAt(painter, 6, 6) != kBlack) {
+        PrintFailure(L"TestLinesLeaveOutLastPixel", L"A stroked polygon should be a closed one pixel outline");
+        return false;
+    }
+
+    painter.Clear(MakePaintColor(0, 0, 0));
+    painter.DrawLine({0, 8}, {16, 8}, MakePaintColor(255, 255, 255), 2, PaintLineStyle::kDashed);
+    const size_t dashed = CountPixels(painter, {0, 0, 16, 16}, kWhite);
+    if (dashed == 0 || dashed >= 32 || PixelAt(painter, 0, 7) != kWhite || PixelAt(painter, 0, 8) != kWhite) {
+        PrintFailure(L"TestLinesLeaveOutLastPixel", L"A wide dashed line should be two rows with gaps");
+        return false;
+    }
+    return true;
+}
+
+bool TestDrawingIsClipped() {
+    SoftwareTabBandPainter painter(8, 8);
+    painter.Clear(MakePaintColor(0, 0, 0));
+    painter.FillRect({-20, -20, 40, 40}, MakePaintColor(255, 255, 255));
+    painter.FillGradient({-8, 4, 16, 20}, MakePaintColor(0, 0, 0), MakePaintColor(255, 0, 0), false);
+    painter.DrawLine({-5, 2}, {30, 2}, MakePaintColor(0, 255, 0), 3);
+    const PaintPoint points[] = {{-10, -10}, {20, -4}, {4, 40}};
+    painter.FillPolygon(points, std::size(points), MakePaintColor(0, 0, 255));
+    painter.FillEllipse({-6, -6, 20, 20}, MakePaintColor(0, 0, 255));
+    painter.DrawString({-30, 0, 40, 8}, L"Clipped text", MakePaintColor(255, 255, 255), PaintTextAlign::kCenter);
+    if (painter.Pixels().size() != 64) {
+        PrintFailure(L"TestDrawingIsClipped", L"Painting outside the image should not resize it");
+        return false;
+    }
+
+    SoftwareTabBandPainter text(40, 12);
+    text.Clear(MakePaintColor(0, 0, 0));
+    text.DrawString({4, 0, 30, 12}, L"ABCDEFGH", MakePaintColor(255, 255, 255), PaintTextAlign::kLeftEllipsis);
+    if (CountPixels(text, {0, 0, 4, 12}, kWhite) != 0 || CountPixels(text, {30, 0, 40, 12}, kWhite) != 0 ||
+        CountPixels(text, {4, 0, 30, 12}, kWhite) == 0) {
+        PrintFailure(L"TestDrawingIsClipped", L"Text should be ellipsised inside its bounds");
+        return false;
+    }
+    return true;
+}
+
+bool TestGoldenLightBand() { return MatchesGolden(L"TestGoldenLightBand", "tab_band_light", LightScene()); }
+
+bool TestGoldenDarkProgressBand() {
+    return MatchesGolden(L"TestGoldenDarkProgressBand", "tab_band_dark_progress", DarkProgressScene());
+}
+
+bool TestFrameTime() {
+    constexpr int32_t kWidth = 1600;
+    constexpr int32_t kHeight = 32;
+    constexpr int kTabs = 40;
+    constexpr int kFrames = 60;
+
+    std::vector<TabSpec> tabs;
+    for (int i = 0; i < kTabs; ++i) {
+        TabSpec spec;
+        spec.name = L"Folder " + std::to_wstring(i);
+        spec.width = 36;
+        spec.selected = i == 3;
+        spec.island = i % 8 == 0;
+        spec.icon = true;
+        spec.progress = i % 10 == 5 ? 60 : -1;
+        tabs.push_back(spec);
+    }
+    const TabBandScene scene = MakeScene(tabs, kLight, kWidth, kHeight);
+
+    SoftwareTabBandPainter painter(kWidth, kHeight);
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < kFrames; ++frame) {
+        shelltabs::PaintTabBand(scene, painter);
+    }
+    const double elapsedMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::wcout << L"[TestFrameTime] " << kTabs << L" tabs at " << kWidth << L"x" << kHeight << L": " << std::fixed
+               << std::setprecision(3) << elapsedMs / kFrames << L" ms/frame" << std::endl;
+    return CountPixels(painter, {0, 0, kWidth, kHeight}, kBlack) == 0;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestFillsLeaveOutRightAndBottom", &TestFillsLeaveOutRightAndBottom},
+        {L"TestLinesLeaveOutLastPixel", &TestLinesLeaveOutLastPixel},
+        {L"TestDrawingIsClipped", &TestDrawingIsClipped},
+        {L"TestGoldenLightBand", &TestGoldenLightBand},
+        {L"TestGoldenDarkProgressBand", &TestGoldenDarkProgressBand},
+        {L"TestFrameTime", &TestFrameTime},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Tab band paint tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Tab band paint tests passed." << std::endl;
+    return 0;
+}
@@ -3,6 +3,10 @@
 #include <windows.h>
 #include <shellapi.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -190,12 +194,169 @@ bool TestIconPreservedWhenResized() {
     return success;
 }
 
+// Tabs keyed by stable id, laid out twenty to a row.
+std::vector<TabBandWindowDiffTestHarness::VisualItem> MakeKeyedItems(const std::vector<uint64_t>& keys) {
+    std::vector<TabBandWindowDiffTestHarness::VisualItem> items;
+    items.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        TabViewItem data;
+        data.type = TabViewItemType::kTab;
+        data.location = {0, static_cast<int>(i)};
+        data.name = L"Tab " + std::to_wstring(keys[i]);
+        data.path = L"C:/Tabs/" + std::to_wstring(keys[i]);
+        const LONG left = static_cast<LONG>((i % 20) * 100);
+        const LONG top = static_cast<LONG>((i / 20) * 24);
+        auto item = TabBandWindowDiffTestHarness::MakeVisualItem(data, {left, top, left + 96, top + 24});
+        item.stableId = keys[i];
+        items.emplace_back(std::move(item));
+    }
+    return items;
+}
+
+size_t LongestIncreasingRun(const std::vector<size_t>& values) {
+    std::vector<size_t> tails;
+    for (size_t value : values) {
+        auto it = std::lower_bound(tails.begin(), tails.end(), value);
+        if (it == tails.end()) {
+            tails.push_back(value);
+        } else {
+            *it = value;
+        }
+    }
+    return tails.size();
+}
+
+bool TestRandomizedDiffsReplayToNewOrder() {
+    TabBandWindow window(nullptr);
+    TabBandWindowDiffTestHarness::InitializeWindow(window, {0, 0, 2000, 400});
+
+    uint32_t seed = 0x5EEDu;
+    auto next = [&](uint32_t bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % bound;
+    };
+
+    std::vector<uint64_t> keys;
+    uint64_t nextKey = 1;
+    for (int step = 0; step < 300; ++step) {
+        std::vector<uint64_t> edited = keys;
+        const uint32_t edits = 1 + next(4);
+        for (uint32_t e = 0; e < edits; ++e) {
+            const uint32_t kind = next(4);
+            const size_t at = edited.empty() ? 0 : next(static_cast<uint32_t>(edited.size()));
+            if (kind == 0 || edited.empty()) {
+                edited.insert(edited.begin() + static_cast<ptrdiff_t>(at), nextKey++);
+            } else if (kind == 1) {
+                edited.erase(edited.begin() + static_cast<ptrdiff_t>(at));
+            } else {
+                const uint64_t key = edited[at];
+                edited.erase(edited.begin() + static_cast<ptrdiff_t>(at));
+                const size_t to = next(static_cast<uint32_t>(edited.size() + 1));
+                edited.insert(edited.begin() + static_cast<ptrdiff_t>(to), key);
+            }
+        }
+
+        auto oldItems = MakeKeyedItems(keys);
+        auto newItems = MakeKeyedItems(edited);
+        const auto stats = TabBandWindowDiffTestHarness::Diff(window, oldItems, newItems);
+
+        // Dropping the removed and moved items from the old order must leave
+        // exactly the new order's items that neither moved nor were inserted.
+        std::vector<bool> dropped(keys.size(), false);
+        std::vector<bool> placed(edited.size(), false);
+        for (const TabLayoutDiffOp& op : stats.ops) {
+            if (op.kind != TabLayoutDiffOpKind::kInsert) {
+                dropped[op.oldIndex] = true;
+            }
+            if (op.kind != TabLayoutDiffOpKind::kRemove) {
+                placed[op.newIndex] = true;
+            }
+        }
+        std::vector<uint64_t> survivors;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (!dropped[i]) {
+                survivors.push_back(keys[i]);
+            }
+        }
+        std::vector<uint64_t> kept;
+        std::vector<size_t> matchedOrder;
+        for (size_t i = 0; i < edited.size(); ++i) {
+            if (!placed[i]) {
+                kept.push_back(edited[i]);
+            }
+            if (stats.matchedOldIndices[i] != kNoTabLayoutMatch) {
+                matchedOrder.push_back(stats.matchedOldIndices[i]);
+            }
+        }
+        if (survivors != kept) {
+            PrintFailure(L"TestRandomizedDiffsReplayToNewOrder",
+                         L"Ops do not replay to the new order at step " + std::to_wstring(step));
+            return false;
+        }
+        if (stats.reordered != matchedOrder.size() - LongestIncreasingRun(matchedOrder) ||
+            stats.inserted + matchedOrder.size() != edited.size() ||
+            stats.removed + matchedOrder.size() != keys.size() || stats.removedIndices.size() != stats.removed) {
+            PrintFailure(L"TestRandomizedDiffsReplayToNewOrder",
+                         L"Unexpected op counts at step " + std::to_wstring(step));
+            return false;
+        }
+        keys = std::move(edited);
+    }
+    return true;
+}
+
+bool TestDiffBenchmark() {
+    TabBandWindow window(nullptr);
+    TabBandWindowDiffTestHarness::InitializeWindow(window, {0, 0, 2000, 1200});
+
+    constexpr size_t kItems = 1000;
+    constexpr int kDiffs = 200;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < kItems; ++i) {
+        keys.push_back(0x9E3779B97F4A7C15ull * (i + 1));
+    }
+    uint32_t seed = 7u;
+    auto next = [&](uint32_t bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % bound;
+    };
+
+    double totalMs = 0.0;
+    size_t reordered = 0;
+    for (int i = 0; i < kDiffs; ++i) {
+        std::vector<uint64_t> edited = keys;
+        const size_t from = next(static_cast<uint32_t>(edited.size()));
+        const uint64_t dragged = edited[from];
+        edited.erase(edited.begin() + static_cast<ptrdiff_t>(from));
+        edited.insert(edited.begin() + next(static_cast<uint32_t>(edited.size())), dragged);
+
+        auto oldItems = MakeKeyedItems(keys);
+        auto newItems = MakeKeyedItems(edited);
+        const auto start = std::chrono::steady_clock::now();
+        const auto stats = TabBandWindowDiffTestHarness::Diff(window, oldItems, newItems);
+        totalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (stats.inserted != 0 || stats.removed != 0 || stats.reordered > 1) {
+            PrintFailure(L"TestDiffBenchmark", L"Expected a drag to move at most one item");
+            return false;
+        }
+        reordered += stats.reordered;
+        keys = std::move(edited);
+    }
+
+    std::wcout << L"[TestDiffBenchmark] " << kItems << L" items, " << kDiffs << L" drags, " << reordered
+               << L" moves: " << std::fixed << std::setprecision(3) << totalMs / kDiffs << L" ms per diff"
+               << std::endl;
+    return true;
+}
+
 }  // namespace
 
 int wmain() {
     const std::vector<TestDefinition> tests = {
         {L"TestIconPreservedWhenMovingGroups", &TestIconPreservedWhenMovingGroups},
         {L"TestIconPreservedWhenResized", &TestIconPreservedWhenResized},
+        {L"TestRandomizedDiffsReplayToNewOrder", &TestRandomizedDiffsReplayToNewOrder},
+        {L"TestDiffBenchmark", &TestDiffBenchmark},
     };
 
     bool success = true;
@@ -0,0 +1,305 @@
+#include "TabBandLayout.h"
+#include "TabHitIndex.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using shelltabs::kNoTabHit;
+using shelltabs::PaintRect;
+using shelltabs::TabBandLayout;
+using shelltabs::TabHitCell;
+using shelltabs::TabHitEntry;
+using shelltabs::TabHitIndex;
+using shelltabs::TabLayoutEntry;
+using shelltabs::TabLayoutEntryKind;
+using shelltabs::TabLayoutMetrics;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+std::wstring Describe(int32_t x, int32_t y) {
+    return L"(" + std::to_wstring(x) + L", " + std::to_wstring(y) + L")";
+}
+
+TabHitEntry Entry(int32_t left, int32_t top, int32_t right, int32_t bottom, bool close = false) {
+    TabHitEntry entry;
+    entry.bounds = {left, top, right, bottom};
+    if (close) {
+        entry.closeButton = {right - 16, top + 4, right - 4, bottom - 4};
+    }
+    return entry;
+}
+
+bool Contains(const PaintRect& rect, int32_t x, int32_t y) {
+    return x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom;
+}
+
+// What TabBandWindow::HitTest found by scanning the items front to back.
+size_t ScanItemAt(const std::vector<TabHitEntry>& entries, int32_t x, int32_t y) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (Contains(entries[i].bounds, x, y)) {
+            return i;
+        }
+    }
+    return kNoTabHit;
+}
+
+// A tab band laid out by TabBandLayout: groups of tabs with handles, wrapped
+// over several rows.
+std::vector<TabHitEntry> LayOutBand(int32_t tabs, int32_t maxX, int32_t maxRows) {
+    std::vector<TabLayoutEntry> entries;
+    for (int32_t i = 0; i < tabs; ++i) {
+        if (i % 12 == 0) {
+            TabLayoutEntry header;
+            header.kind = TabLayoutEntryKind::kGroupHeader;
+            header.groupIndex = i / 12;
+            header.headerVisible = true;
+            header.hasVisibleTabs = true;
+            entries.push_back(header);
+        }
+        TabLayoutEntry tab;
+        tab.groupIndex = i / 12;
+        tab.width = 60 + (i * 53) % 110;
+        entries.push_back(tab);
+    }
+    TabLayoutMetrics metrics;
+    metrics.originX = 6;
+    metrics.maxX = maxX;
+    metrics.top = 2;
+    metrics.rowHeight = 24;
+    metrics.rowGap = 2;
+    metrics.maxRows = maxRows;
+    metrics.tabGap = 4;
+    metrics.groupGap = 12;
+    metrics.indicatorWidth = 10;
+    metrics.emptyBodyMaxWidth = 80;
+
+    TabBandLayout layout;
+    layout.Update(std::move(entries), metrics);
+    std::vector<TabHitEntry> result;
+    for (const auto& slot : layout.Slots()) {
+        TabHitEntry entry;
+        entry.bounds = slot.bounds;
+        if (slot.kind == shelltabs::TabLayoutSlotKind::kTab && slot.bounds.Width() > 40) {
+            entry.closeButton = {slot.bounds.right - 18, slot.bounds.top + 5, slot.bounds.right - 4,
+                                 slot.bounds.bottom - 5};
+        }
+        result.push_back(entry);
+    }
+    return result;
+}
+
+bool TestFindsItemsAndCloseButtons() {
+    // A handle and two tabs, then a second row with a gap in it.
+    const std::vector<TabHitEntry> entries = {
+        Entry(0, 0, 10, 20), Entry(14, 0, 100, 20, true), Entry(104, 0, 200, 20, true),
+        Entry(0, 22, 90, 42, true), Entry(200, 22, 260, 42),
+    };
+    TabHitIndex index;
+    index.Build(entries);
+    if (index.RowCount() != 2) {
+        PrintFailure(L"TestFindsItemsAndCloseButtons", L"Expected two rows, got " + std::to_wstring(index.RowCount()));
+        return false;
+    }
+
+    struct Probe {
+        int32_t x;
+        int32_t y;
+        size_t item;
+        size_t close;
+    };
+    const Probe probes[] = {
+        {0, 0, 0, kNoTabHit},        {9, 19, 0, kNoTabHit},     {10, 5, kNoTabHit, kNoTabHit},
+        {14, 10, 1, kNoTabHit},      {90, 10, 1, 1},            {99, 10, 1, kNoTabHit},
+        {150, 20, kNoTabHit, kNoTabHit}, {150, 21, kNoTabHit, kNoTabHit}, {5, 22, 3, kNoTabHit},
+        {80, 30, 3, 3},              {259, 41, 4, kNoTabHit},   {260, 41, kNoTabHit, kNoTabHit},
+        {-1, 5, kNoTabHit, kNoTabHit}, {5, 42, kNoTabHit, kNoTabHit},
+    };
+    for (const auto& probe : probes) {
+        const size_t item = index.ItemAt(probe.x, probe.y);
+        const size_t close = index.CloseButtonAt(probe.x, probe.y);
+        if (item != probe.item || close != probe.close) {
+            PrintFailure(L"TestFindsItemsAndCloseButtons",
+                         L"Unexpected hit at " + Describe(probe.x, probe.y) + L": item " + std::to_wstring(item) +
+                             L", close " + std::to_wstring(close));
+            return false;
+        }
+    }
+
+    index.Clear();
+    if (!index.Empty() || index.ItemAt(5, 5) != kNoTabHit || index.CellAt(5, 5).gap != kNoTabHit) {
+        PrintFailure(L"TestFindsItemsAndCloseButtons", L"Expected a cleared index to miss");
+        return false;
+    }
+    return true;
+}
+
+bool TestResolvesGaps() {
+    const std::vector<TabHitEntry> entries = {
+        Entry(0, 0, 100, 20), Entry(110, 0, 200, 20), Entry(0, 22, 100, 42),
+    };
+    TabHitIndex index;
+    index.Build(entries);
+
+    struct Probe {
+        int32_t x;
+        int32_t y;
+        size_t item;
+        bool before;
+        size_t gap;
+        bool between;
+    };
+    const Probe probes[] = {
+        {10, 5, 0, true, 0, false},         {50, 5, 0, false, 1, false},
+        {105, 5, kNoTabHit, false, 1, true}, {154, 5, 1, true, 1, false},
+        {155, 5, 1, false, 2, false},        {300, 5, kNoTabHit, false, 2, false},
+        {300, 30, kNoTabHit, false, 3, false}, {50, 21, kNoTabHit, false, kNoTabHit, false},
+    };
+    for (const auto& probe : probes) {
+        const TabHitCell cell = index.CellAt(probe.x, probe.y);
+        if (cell.item != probe.item || cell.before != probe.before || cell.gap != probe.gap ||
+            cell.between != probe.between) {
+            PrintFailure(L"TestResolvesGaps", L"Unexpected cell at " + Describe(probe.x, probe.y) + L": item " +
+                                                  std::to_wstring(cell.item) + L", gap " +
+                                                  std::to_wstring(cell.gap));
+            return false;
+        }
+    }
+
+    if (!(index.CellAt(10, 5) == index.CellAt(40, 15)) || index.CellAt(10, 5) == index.CellAt(60, 5)) {
+        PrintFailure(L"TestResolvesGaps", L"Expected points to share cells only on the same half of an item");
+        return false;
+    }
+    const uint64_t generation = index.Generation();
+    index.Build(entries);
+    if (index.Generation() == generation) {
+        PrintFailure(L"TestResolvesGaps", L"Expected a rebuild to bump the generation");
+        return false;
+    }
+    return true;
+}
+
+bool TestMatchesLinearScan() {
+    std::vector<TabHitEntry> band = LayOutBand(300, 1400, 12);
+
+    // Overlapping and odd-sized items as well, where the lowest index wins.
+    std::vector<TabHitEntry> overlapping;
+    uint32_t seed = 0x9E3779B9u;
+    auto next = [&](uint32_t bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int32_t>((seed >> 8) % bound);
+    };
+    for (int i = 0; i < 200; ++i) {
+        const int32_t left = next(600);
+        const int32_t top = next(200);
+        overlapping.push_back(Entry(left, top, left + next(120), top + 1 + next(40), next(2) == 0));
+    }
+
+    for (const auto* entries : {&band, &overlapping}) {
+        TabHitIndex index;
+        index.Build(*entries);
+        for (int32_t y = -2; y < 330; y += 1) {
+            for (int32_t x = -2; x < 1410; x += 3) {
+                const size_t expected = ScanItemAt(*entries, x, y);
+                if (index.ItemAt(x, y) != expected) {
+                    PrintFailure(L"TestMatchesLinearScan", L"Index and scan disagree at " + Describe(x, y) +
+                                                               L": expected " + std::to_wstring(expected));
+                    return false;
+                }
+                const bool onClose = expected != kNoTabHit && !(*entries)[expected].closeButton.Empty() &&
+                                     Contains((*entries)[expected].closeButton, x, y);
+                if (index.CellAt(x, y).closeButton != onClose) {
+                    PrintFailure(L"TestMatchesLinearScan", L"Close button mismatch at " + Describe(x, y));
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+bool TestHitTestBenchmark() {
+    const std::vector<TabHitEntry> entries = LayOutBand(1000, 7000, 32);
+    TabHitIndex index;
+    index.Build(entries);
+    if (index.RowCount() < 10) {
+        PrintFailure(L"TestHitTestBenchmark", L"Expected the tabs to span many rows");
+        return false;
+    }
+
+    // A drag sweeping the band row by row.
+    std::vector<std::pair<int32_t, int32_t>> points;
+    const int32_t bottom = entries.back().bounds.bottom;
+    for (int32_t y = 0; y < bottom; y += 5) {
+        for (int32_t x = 0; x < 7000; x += 11) {
+            points.emplace_back(x, y);
+        }
+    }
+
+    size_t scanHits = 0;
+    const auto scanStart = std::chrono::steady_clock::now();
+    for (const auto& [x, y] : points) {
+        scanHits += ScanItemAt(entries, x, y) != kNoTabHit;
+    }
+    const double scanMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scanStart).count();
+
+    size_t indexHits = 0;
+    const auto indexStart = std::chrono::steady_clock::now();
+    for (const auto& [x, y] : points) {
+        indexHits += index.ItemAt(x, y) != kNoTabHit;
+    }
+    const double indexMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - indexStart).count();
+
+    if (scanHits != indexHits || indexHits == 0) {
+        PrintFailure(L"TestHitTestBenchmark", L"Expected the index and the scan to hit the same points");
+        return false;
+    }
+
+    std::wcout << L"[TestHitTestBenchmark] " << entries.size() << L" items on " << index.RowCount() << L" rows, "
+               << points.size() << L" points: " << std::fixed << std::setprecision(2) << scanMs << L" ms -> "
+               << indexMs << L" ms" << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestFindsItemsAndCloseButtons", &TestFindsItemsAndCloseButtons},
+        {L"TestResolvesGaps", &TestResolvesGaps},
+        {L"TestMatchesLinearScan", &TestMatchesLinearScan},
+        {L"TestHitTestBenchmark", &TestHitTestBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Tab hit index tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Tab hit index tests passed." << std::endl;
+    return 0;
+}
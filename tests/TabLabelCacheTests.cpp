@@ -0,0 +1,336 @@
+#include "TabLabelCache.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+using shelltabs::FitTabLabel;
+using shelltabs::TabLabelCache;
+using shelltabs::TabLabelEllipsis;
+using shelltabs::TabLabelFont;
+using shelltabs::TabTextMeasurer;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+// Fixed advances at 96 DPI, scaled by the font's DPI: wide capitals, narrow
+// punctuation, 7 pixels for everything else.
+class FakeMeasurer final : public TabTextMeasurer {
+public:
+    explicit FakeMeasurer(uint32_t dpi = 96) { m_font.height = 16; m_font.aveCharWidth = 7; m_font.dpi = dpi; }
+
+    TabLabelFont Font() const override { return m_font; }
+
+    void SetFace(std::wstring_view face) { m_font.faceHash = shelltabs::HashTabLabelFace(face); }
+
+    bool MeasureExtents(std::wstring_view text, int32_t* extents) override {
+        ++calls;
+        units += text.size();
+        int32_t extent = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            extent += Advance(text[i]);
+            extents[i] = extent;
+        }
+        return true;
+    }
+
+    int32_t Advance(wchar_t ch) const {
+        int32_t advance = 7;
+        if (ch == L'W' || ch == L'M') {
+            advance = 10;
+        } else if (ch == L'i' || ch == L'l' || ch == L'.' || ch == L':') {
+            advance = 3;
+        } else if (ch == L'\\') {
+            advance = 4;
+        }
+        return advance * static_cast<int32_t>(m_font.dpi) / 96;
+    }
+
+    int32_t Width(std::wstring_view text) const {
+        int32_t width = 0;
+        for (wchar_t ch : text) {
+            width += Advance(ch);
+        }
+        return width;
+    }
+
+    size_t calls = 0;
+    size_t units = 0;
+
+private:
+    TabLabelFont m_font;
+};
+
+std::wstring Fit(const FakeMeasurer& measurer, std::wstring_view text, int32_t maxWidth, TabLabelEllipsis mode) {
+    std::vector<int32_t> extents(text.size());
+    int32_t extent = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        extent += measurer.Advance(text[i]);
+        extents[i] = extent;
+    }
+    return FitTabLabel(text, extents.data(), measurer.Width(shelltabs::kTabLabelEllipsis), maxWidth, mode);
+}
+
+bool TestWidthMeasuredOncePerFont() {
+    TabLabelCache cache;
+    FakeMeasurer measurer;
+    const int32_t first = cache.Width(measurer, L"Documents");
+    const int32_t second = cache.Width(measurer, L"Documents");
+    if (first != measurer.Width(L"Documents") || second != first || measurer.calls != 1) {
+        PrintFailure(L"TestWidthMeasuredOncePerFont", L"A repeated name should be measured once");
+        return false;
+    }
+
+    FakeMeasurer highDpi(144);
+    if (cache.Width(highDpi, L"Documents") != highDpi.Width(L"Documents") || highDpi.calls != 1) {
+        PrintFailure(L"TestWidthMeasuredOncePerFont", L"Another DPI should be measured separately");
+        return false;
+    }
+
+    const auto stats = cache.Stats();
+    if (stats.hits != 1 || stats.misses != 2 || stats.labels != 2 || stats.measuredUnits != 18) {
+        PrintFailure(L"TestWidthMeasuredOncePerFont", L"Unexpected cache stats");
+        return false;
+    }
+    return true;
+}
+
+bool TestFacesWithEqualMetricsAreKeptApart() {
+    TabLabelCache cache;
+    FakeMeasurer segoe;
+    segoe.SetFace(L"Segoe UI");
+    FakeMeasurer tahoma;
+    tahoma.SetFace(L"Tahoma");
+    cache.Width(segoe, L"Documents");
+    cache.Width(tahoma, L"Documents");
+    if (segoe.calls != 1 || tahoma.calls != 1 || cache.Stats().labels != 2) {
+        PrintFailure(L"TestFacesWithEqualMetricsAreKeptApart", L"Another face should be measured separately");
+        return false;
+    }
+
+    FakeMeasurer segoeUpper;
+    segoeUpper.SetFace(L"SEGOE UI");
+    cache.Width(segoeUpper, L"Documents");
+    if (segoeUpper.calls != 0) {
+        PrintFailure(L"TestFacesWithEqualMetricsAreKeptApart", L"Face names should match case-insensitively");
+        return false;
+    }
+    return true;
+}
+
+bool TestEndEllipsis() {
+    FakeMeasurer measurer;
+    if (Fit(measurer, L"Downloads", 59, TabLabelEllipsis::kEnd) != L"Downloads") {
+        PrintFailure(L"TestEndEllipsis", L"A label that fits should not change");
+        return false;
+    }
+    if (Fit(measurer, L"Downloads", 40, TabLabelEllipsis::kEnd) != L"Downl...") {
+        PrintFailure(L"TestEndEllipsis", L"Expected the longest prefix that fits with the ellipsis");
+        return false;
+    }
+    if (Fit(measurer, L"Downloads", 4, TabLabelEllipsis::kEnd) != L"...") {
+        PrintFailure(L"TestEndEllipsis", L"Too narrow for any character should leave the ellipsis");
+        return false;
+    }
+
+    const std::wstring emoji{L'a', L'b', static_cast<wchar_t>(0xD83D), static_cast<wchar_t>(0xDE00), L'c'};
+    if (Fit(measurer, emoji, 21 + 9, TabLabelEllipsis::kEnd) != L"ab...") {
+        PrintFailure(L"TestEndEllipsis", L"A surrogate pair should not be split");
+        return false;
+    }
+    return true;
+}
+
+bool TestPathEllipsisKeepsLeaf() {
+    FakeMeasurer measurer;
+    const std::wstring path = L"C:\\Users\\Public\\Projects";
+    const int32_t full = measurer.Width(path);
+    const int32_t tail = measurer.Width(L"\\Projects");
+    const int32_t ellipsis = measurer.Width(L"...");
+
+    const std::wstring middle = Fit(measurer, path, full - 8, TabLabelEllipsis::kPath);
+    if (middle != L"C:\\Users\\Pu...\\Projects" || measurer.Width(middle) > full - 8) {
+        PrintFailure(L"TestPathEllipsisKeepsLeaf", L"Expected the ellipsis before the leaf, got " + middle);
+        return false;
+    }
+    if (Fit(measurer, path, tail + ellipsis, TabLabelEllipsis::kPath) != L"...\\Projects") {
+        PrintFailure(L"TestPathEllipsisKeepsLeaf", L"The whole leaf should survive at its own width");
+        return false;
+    }
+    if (Fit(measurer, path, tail + ellipsis - 1, TabLabelEllipsis::kPath) != L"Projects") {
+        PrintFailure(L"TestPathEllipsisKeepsLeaf", L"The bare leaf should be preferred to cutting it");
+        return false;
+    }
+    if (Fit(measurer, path, 30, TabLabelEllipsis::kPath) != L"Pro...") {
+        PrintFailure(L"TestPathEllipsisKeepsLeaf", L"A leaf that cannot fit should be cut at its end");
+        return false;
+    }
+    if (Fit(measurer, path + L"\\", tail + ellipsis + 4, TabLabelEllipsis::kPath) != L"...\\Projects\\") {
+        PrintFailure(L"TestPathEllipsisKeepsLeaf", L"A trailing separator should stay with the leaf");
+        return false;
+    }
+    if (Fit(measurer, L"Documents", 40, TabLabelEllipsis::kPath) != Fit(measurer, L"Documents", 40,
+                                                                         TabLabelEllipsis::kEnd)) {
+        PrintFailure(L"TestPathEllipsisKeepsLeaf", L"A name without separators should be cut at its end");
+        return false;
+    }
+    if (!shelltabs::IsPathLabel(path) || shelltabs::IsPathLabel(L"Documents") || shelltabs::IsPathLabel(L"\\\\")) {
+        PrintFailure(L"TestPathEllipsisKeepsLeaf", L"IsPathLabel misclassified a label");
+        return false;
+    }
+    return true;
+}
+
+bool TestFitsCachedPerWidth() {
+    TabLabelCache cache;
+    FakeMeasurer measurer;
+    const std::wstring first = cache.Fit(measurer, L"Downloads", 40, TabLabelEllipsis::kEnd);
+    const std::wstring second = cache.Fit(measurer, L"Downloads", 40, TabLabelEllipsis::kEnd);
+    if (first != L"Downl..." || second != first || measurer.calls != 2 || cache.Stats().fitHits != 1) {
+        PrintFailure(L"TestFitsCachedPerWidth", L"A repeated fit should come from the cache");
+        return false;
+    }
+
+    for (int32_t width = 41; width < 41 + static_cast<int32_t>(TabLabelCache::kFitsPerLabel); ++width) {
+        cache.Fit(measurer, L"Downloads", width, TabLabelEllipsis::kEnd);
+    }
+    const uint64_t missesBefore = cache.Stats().fitMisses;
+    if (cache.Fit(measurer, L"Downloads", 40, TabLabelEllipsis::kEnd) != first ||
+        cache.Stats().fitMisses != missesBefore + 1 || measurer.calls != 2) {
+        PrintFailure(L"TestFitsCachedPerWidth", L"The oldest fit should be recomputed without measuring again");
+        return false;
+    }
+    return true;
+}
+
+bool TestCapacityEvictsLeastRecent() {
+    TabLabelCache cache(3);
+    FakeMeasurer measurer;
+    cache.Width(measurer, L"Alpha");
+    cache.Width(measurer, L"Beta");
+    cache.Width(measurer, L"Gamma");
+    cache.Width(measurer, L"Alpha");
+    cache.Width(measurer, L"Delta");
+    if (measurer.calls != 4) {
+        PrintFailure(L"TestCapacityEvictsLeastRecent", L"Expected four measurements");
+        return false;
+    }
+    cache.Width(measurer, L"Alpha");
+    if (measurer.calls != 4) {
+        PrintFailure(L"TestCapacityEvictsLeastRecent", L"A recently used label should survive");
+        return false;
+    }
+    cache.Width(measurer, L"Beta");
+    if (measurer.calls != 5 || cache.Stats().labels != 3) {
+        PrintFailure(L"TestCapacityEvictsLeastRecent", L"The least recently used label should be evicted");
+        return false;
+    }
+    return true;
+}
+
+// Lays out and paints 1000 tabs over a series of resizes, once measuring and
+// fitting every label each pass as the band used to, once through the cache.
+bool TestRelayoutMeasurementBenchmark() {
+    constexpr size_t kTabs = 1000;
+    constexpr int kPasses = 20;
+
+    std::vector<std::wstring> names;
+    for (size_t i = 0; i < kTabs; ++i) {
+        names.push_back(i % 4 == 0 ? L"C:\\Users\\Public\\Projects\\Folder " + std::to_wstring(i)
+                                   : L"Folder with a longer name " + std::to_wstring(i));
+    }
+
+    FakeMeasurer uncachedMeasurer;
+    std::vector<std::wstring> uncachedLabels;
+    std::vector<int32_t> extents;
+    const auto uncachedStart = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < kPasses; ++pass) {
+        const int32_t maxWidth = 120 + pass % 3;
+        for (const auto& name : names) {
+            extents.resize(name.size());
+            uncachedMeasurer.MeasureExtents(name, extents.data());
+            std::vector<int32_t> ellipsis(3);
+            uncachedMeasurer.MeasureExtents(shelltabs::kTabLabelEllipsis, ellipsis.data());
+            const TabLabelEllipsis mode =
+                shelltabs::IsPathLabel(name) ? TabLabelEllipsis::kPath : TabLabelEllipsis::kEnd;
+            uncachedLabels.push_back(FitTabLabel(name, extents.data(), ellipsis.back(), maxWidth, mode));
+        }
+    }
+    const double uncachedMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uncachedStart).count();
+
+    TabLabelCache cache(2048);
+    FakeMeasurer cachedMeasurer;
+    std::vector<std::wstring> cachedLabels;
+    const auto cachedStart = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < kPasses; ++pass) {
+        const int32_t maxWidth = 120 + pass % 3;
+        for (const auto& name : names) {
+            cache.Width(cachedMeasurer, name);
+            const TabLabelEllipsis mode =
+                shelltabs::IsPathLabel(name) ? TabLabelEllipsis::kPath : TabLabelEllipsis::kEnd;
+            cachedLabels.push_back(cache.Fit(cachedMeasurer, name, maxWidth, mode));
+        }
+    }
+    const double cachedMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cachedStart).count();
+
+    if (cachedLabels != uncachedLabels) {
+        PrintFailure(L"TestRelayoutMeasurementBenchmark", L"Cached labels differ from freshly fitted ones");
+        return false;
+    }
+    if (cachedMeasurer.calls != kTabs + 1) {
+        PrintFailure(L"TestRelayoutMeasurementBenchmark", L"Each label should be measured once");
+        return false;
+    }
+
+    std::wcout << L"[TestRelayoutMeasurementBenchmark] " << kTabs << L" tabs x " << kPasses
+               << L" passes: measured units " << uncachedMeasurer.units << L" -> " << cachedMeasurer.units
+               << L", " << std::fixed << std::setprecision(2) << uncachedMs << L" ms -> " << cachedMs << L" ms"
+               << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestWidthMeasuredOncePerFont", &TestWidthMeasuredOncePerFont},
+        {L"TestFacesWithEqualMetricsAreKeptApart", &TestFacesWithEqualMetricsAreKeptApart},
+        {L"TestEndEllipsis", &TestEndEllipsis},
+        {L"TestPathEllipsisKeepsLeaf", &TestPathEllipsisKeepsLeaf},
+        {L"TestFitsCachedPerWidth", &TestFitsCachedPerWidth},
+        {L"TestCapacityEvictsLeastRecent", &TestCapacityEvictsLeastRecent},
+        {L"TestRelayoutMeasurementBenchmark", &TestRelayoutMeasurementBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Tab label cache tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Tab label cache tests passed." << std::endl;
+    return 0;
+}
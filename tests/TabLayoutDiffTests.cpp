@@ -0,0 +1,411 @@
+#include "TabLayoutDiff.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using shelltabs::kNoTabLayoutMatch;
+using shelltabs::TabLayoutDiffer;
+using shelltabs::TabLayoutDiffOp;
+using shelltabs::TabLayoutDiffOpKind;
+using shelltabs::TabLayoutDiffResult;
+
+struct TestDefinition {
+    const wchar_t* name;
+    bool (*fn)();
+};
+
+void PrintFailure(const wchar_t* testName, const std::wstring& message) {
+    std::wcerr << L"[" << testName << L"] " << message << std::endl;
+}
+
+const TabLayoutDiffResult& Diff(TabLayoutDiffer& differ, const std::vector<uint64_t>& oldKeys,
+                                const std::vector<uint64_t>& newKeys) {
+    return differ.Compute(
+        oldKeys.size(), newKeys.size(), [&](size_t i) { return oldKeys[i]; }, [&](size_t i) { return newKeys[i]; },
+        [](size_t) { return kNoTabLayoutMatch; }, [](size_t, size_t) { return 0; });
+}
+
+size_t LongestIncreasingRun(const std::vector<size_t>& values) {
+    std::vector<size_t> lengths(values.size(), 1);
+    size_t best = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        for (size_t j = 0; j < i; ++j) {
+            if (values[j] < values[i]) {
+                lengths[i] = std::max(lengths[i], lengths[j] + 1);
+            }
+        }
+        best = std::max(best, lengths[i]);
+    }
+    return best;
+}
+
+// Checks the result against the keys: a one-to-one keyed matching, ops that
+// cover every unmatched and moved item, and a minimal set of moves.
+bool Validate(const std::vector<uint64_t>& oldKeys, const std::vector<uint64_t>& newKeys,
+              const TabLayoutDiffResult& result, std::wstring* message) {
+    if (result.matchedOld.size() != newKeys.size()) {
+        *message = L"Expected a match slot per new item";
+        return false;
+    }
+    std::vector<bool> usedOld(oldKeys.size(), false);
+    std::vector<size_t> matchedOrder;
+    for (size_t i = 0; i < newKeys.size(); ++i) {
+        const size_t oldIndex = result.matchedOld[i];
+        if (oldIndex == kNoTabLayoutMatch) {
+            continue;
+        }
+        if (oldIndex >= oldKeys.size() || usedOld[oldIndex] || oldKeys[oldIndex] != newKeys[i]) {
+            *message = L"Bad match for new item " + std::to_wstring(i);
+            return false;
+        }
+        usedOld[oldIndex] = true;
+        matchedOrder.push_back(oldIndex);
+    }
+
+    // Every key present on both sides is matched as often as it can be.
+    std::unordered_map<uint64_t, int> balance;
+    for (size_t i = 0; i < oldKeys.size(); ++i) {
+        if (!usedOld[i]) {
+            ++balance[oldKeys[i]];
+        }
+    }
+    for (size_t i = 0; i < newKeys.size(); ++i) {
+        if (result.matchedOld[i] == kNoTabLayoutMatch && balance[newKeys[i]] > 0) {
+            *message = L"New item " + std::to_wstring(i) + L" left unmatched";
+            return false;
+        }
+    }
+
+    std::vector<bool> movedNew(newKeys.size(), false);
+    size_t inserts = 0;
+    size_t moves = 0;
+    size_t removes = 0;
+    bool pastRemoves = false;
+    size_t lastOld = 0;
+    size_t lastNew = 0;
+    for (const TabLayoutDiffOp& op : result.ops) {
+        const bool remove = op.kind == TabLayoutDiffOpKind::kRemove;
+        const bool outOfOrder = remove ? (pastRemoves || (removes > 0 && op.oldIndex <= lastOld))
+                                       : (moves + inserts > 0 && op.newIndex <= lastNew);
+        if (outOfOrder) {
+            *message = L"Ops out of order";
+            return false;
+        }
+        if (remove) {
+            lastOld = op.oldIndex;
+        } else {
+            pastRemoves = true;
+            lastNew = op.newIndex;
+        }
+        switch (op.kind) {
+            case TabLayoutDiffOpKind::kRemove:
+                if (op.oldIndex >= oldKeys.size() || usedOld[op.oldIndex]) {
+                    *message = L"Removed a matched item";
+                    return false;
+                }
+                ++removes;
+                break;
+            case TabLayoutDiffOpKind::kInsert:
+                if (op.newIndex >= newKeys.size() || result.matchedOld[op.newIndex] != kNoTabLayoutMatch) {
+                    *message = L"Inserted a matched item";
+                    return false;
+                }
+                ++inserts;
+                break;
+            case TabLayoutDiffOpKind::kMove:
+                if (op.newIndex >= newKeys.size() || result.matchedOld[op.newIndex] != op.oldIndex) {
+                    *message = L"Move does not follow the match";
+                    return false;
+                }
+                movedNew[op.newIndex] = true;
+                ++moves;
+                break;
+        }
+    }
+    if (inserts != result.inserted || moves != result.moved || removes != result.removed ||
+        removes != oldKeys.size() - matchedOrder.size() || inserts != newKeys.size() - matchedOrder.size()) {
+        *message = L"Op counts disagree with the result";
+        return false;
+    }
+
+    // What stays must already be in old order, and no larger set could be.
+    size_t previous = 0;
+    bool first = true;
+    size_t stays = 0;
+    for (size_t i = 0; i < newKeys.size(); ++i) {
+        const size_t oldIndex = result.matchedOld[i];
+        if (oldIndex == kNoTabLayoutMatch || movedNew[i]) {
+            continue;
+        }
+        if (!first && oldIndex <= previous) {
+            *message = L"Items left in place are out of order";
+            return false;
+        }
+        first = false;
+        previous = oldIndex;
+        ++stays;
+    }
+    if (stays != LongestIncreasingRun(matchedOrder)) {
+        *message = L"Expected " + std::to_wstring(matchedOrder.size() - LongestIncreasingRun(matchedOrder)) +
+                   L" moves, got " + std::to_wstring(moves);
+        return false;
+    }
+    return true;
+}
+
+bool TestClassifiesOps() {
+    TabLayoutDiffer differ;
+    const std::vector<uint64_t> oldKeys = {10, 20, 30, 40};
+    const std::vector<uint64_t> newKeys = {20, 10, 50, 40};
+    const TabLayoutDiffResult& result = Diff(differ, oldKeys, newKeys);
+
+    const std::vector<TabLayoutDiffOp> expected = {
+        {TabLayoutDiffOpKind::kRemove, 2, kNoTabLayoutMatch},
+        {TabLayoutDiffOpKind::kMove, 1, 0},
+        {TabLayoutDiffOpKind::kInsert, kNoTabLayoutMatch, 2},
+    };
+    if (result.ops != expected || result.inserted != 1 || result.removed != 1 || result.moved != 1) {
+        PrintFailure(L"TestClassifiesOps", L"Unexpected ops for a swap, a replacement and a kept tail");
+        return false;
+    }
+
+    const TabLayoutDiffResult& same = Diff(differ, oldKeys, oldKeys);
+    if (!same.ops.empty() || same.matchedOld != std::vector<size_t>{0, 1, 2, 3}) {
+        PrintFailure(L"TestClassifiesOps", L"Expected no ops for an unchanged list");
+        return false;
+    }
+
+    // Moving the first item to the end moves one item, not the other three.
+    const TabLayoutDiffResult& rotated = Diff(differ, oldKeys, {20, 30, 40, 10});
+    if (rotated.moved != 1 || rotated.ops.size() != 1 || rotated.ops[0].oldIndex != 0 ||
+        rotated.ops[0].newIndex != 3) {
+        PrintFailure(L"TestClassifiesOps", L"Expected a rotation to move a single item");
+        return false;
+    }
+    return true;
+}
+
+bool TestDuplicateKeysUseHintAndRank() {
+    // An island handle and its empty body share the header's key.
+    const std::vector<uint64_t> oldKeys = {7, 7, 7};
+    const std::vector<int> oldKinds = {0, 1, 2};
+    const std::vector<uint64_t> newKeys = {7, 7, 7};
+    const std::vector<int> newKinds = {2, 0, 1};
+
+    TabLayoutDiffer differ;
+    const TabLayoutDiffResult& ranked = differ.Compute(
+        oldKeys.size(), newKeys.size(), [&](size_t i) { return oldKeys[i]; }, [&](size_t i) { return newKeys[i]; },
+        [](size_t) { return kNoTabLayoutMatch; },
+        [&](size_t oldIndex, size_t newIndex) { return oldKinds[oldIndex] == newKinds[newIndex] ? 0 : 1; });
+    if (ranked.matchedOld != std::vector<size_t>{2, 0, 1} || ranked.moved != 1) {
+        PrintFailure(L"TestDuplicateKeysUseHintAndRank", L"Expected the rank to pair items of the same kind");
+        return false;
+    }
+
+    const TabLayoutDiffResult& hinted = differ.Compute(
+        oldKeys.size(), newKeys.size(), [&](size_t i) { return oldKeys[i]; }, [&](size_t i) { return newKeys[i]; },
+        [](size_t newIndex) { return newIndex == 0 ? size_t{1} : kNoTabLayoutMatch; },
+        [](size_t, size_t) { return 0; });
+    if (hinted.matchedOld != std::vector<size_t>{1, 0, 2}) {
+        PrintFailure(L"TestDuplicateKeysUseHintAndRank", L"Expected the hint to win and ties to take the lowest index");
+        return false;
+    }
+
+    // A hint for another key is ignored.
+    const TabLayoutDiffResult& foreign = differ.Compute(
+        2, 1, [](size_t i) { return i == 0 ? uint64_t{1} : uint64_t{2}; }, [](size_t) { return uint64_t{1}; },
+        [](size_t) { return size_t{1}; }, [](size_t, size_t) { return 0; });
+    if (foreign.matchedOld != std::vector<size_t>{0} || foreign.removed != 1) {
+        PrintFailure(L"TestDuplicateKeysUseHintAndRank", L"Expected a mismatched hint to be ignored");
+        return false;
+    }
+    return true;
+}
+
+bool TestRandomizedDiffs() {
+    uint32_t seed = 0xC0FFEEu;
+    auto next = [&](uint32_t bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % bound;
+    };
+
+    TabLayoutDiffer differ;
+    std::vector<uint64_t> keys;
+    uint64_t nextKey = 1;
+    for (int step = 0; step < 2000; ++step) {
+        std::vector<uint64_t> edited = keys;
+        const uint32_t edits = 1 + next(4);
+        for (uint32_t e = 0; e < edits; ++e) {
+            const uint32_t kind = next(6);
+            const size_t at = edited.empty() ? 0 : next(static_cast<uint32_t>(edited.size()));
+            if (kind <= 1 || edited.empty()) {
+                // Mostly fresh keys, sometimes a duplicate of one already there.
+                const uint64_t key = !edited.empty() && next(5) == 0 ? edited[at] : nextKey++;
+                edited.insert(edited.begin() + static_cast<ptrdiff_t>(at), key);
+            } else if (kind == 2) {
+                edited.erase(edited.begin() + static_cast<ptrdiff_t>(at));
+            } else {
+                const uint64_t key = edited[at];
+                edited.erase(edited.begin() + static_cast<ptrdiff_t>(at));
+                const size_t to = edited.empty() ? 0 : next(static_cast<uint32_t>(edited.size() + 1));
+                edited.insert(edited.begin() + static_cast<ptrdiff_t>(to), key);
+            }
+        }
+        if (edited.size() > 120) {
+            edited.resize(60);
+        }
+
+        const TabLayoutDiffResult& result = Diff(differ, keys, edited);
+        std::wstring message;
+        if (!Validate(keys, edited, result, &message)) {
+            PrintFailure(L"TestRandomizedDiffs", L"Step " + std::to_wstring(step) + L": " + message);
+            return false;
+        }
+        keys = std::move(edited);
+    }
+    return true;
+}
+
+bool TestWarmDifferKeepsBuffers() {
+    std::vector<uint64_t> oldKeys;
+    for (uint64_t i = 0; i < 500; ++i) {
+        oldKeys.push_back(i * 3 + 1);
+    }
+    std::vector<uint64_t> newKeys = oldKeys;
+    std::reverse(newKeys.begin(), newKeys.begin() + 100);
+
+    std::vector<uint64_t> rotated = newKeys;
+    std::rotate(rotated.begin(), rotated.begin() + 250, rotated.end());
+
+    TabLayoutDiffer differ;
+    Diff(differ, oldKeys, rotated);
+    const TabLayoutDiffResult& first = Diff(differ, oldKeys, newKeys);
+    const size_t* matched = first.matchedOld.data();
+    const TabLayoutDiffOp* ops = first.ops.data();
+    const size_t moved = first.moved;
+
+    Diff(differ, oldKeys, rotated);
+    const TabLayoutDiffResult& again = Diff(differ, oldKeys, newKeys);
+    if (again.matchedOld.data() != matched || again.ops.data() != ops || again.moved != moved || moved != 99) {
+        PrintFailure(L"TestWarmDifferKeepsBuffers", L"Expected repeated diffs to reuse the result buffers");
+        return false;
+    }
+    return true;
+}
+
+bool TestDiffBenchmark() {
+    constexpr size_t kItems = 1000;
+    constexpr int kDiffs = 400;
+
+    // Each diff closes a tab, opens one and drags one to a new place.
+    std::vector<std::vector<uint64_t>> lists;
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < kItems; ++i) {
+        keys.push_back(0x9E3779B97F4A7C15ull * (i + 1));
+    }
+    uint32_t seed = 99u;
+    auto next = [&](uint32_t bound) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % bound;
+    };
+    lists.push_back(keys);
+    for (int i = 0; i < kDiffs; ++i) {
+        keys.erase(keys.begin() + next(static_cast<uint32_t>(keys.size())));
+        keys.insert(keys.begin() + next(static_cast<uint32_t>(keys.size())), 0xABCDEFull + static_cast<uint64_t>(i));
+        const size_t from = next(static_cast<uint32_t>(keys.size()));
+        const uint64_t dragged = keys[from];
+        keys.erase(keys.begin() + static_cast<ptrdiff_t>(from));
+        keys.insert(keys.begin() + next(static_cast<uint32_t>(keys.size())), dragged);
+        lists.push_back(keys);
+    }
+
+    // The map matching TabBandWindow::ComputeLayoutDiff used to do.
+    size_t mapMatched = 0;
+    const auto mapStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < kDiffs; ++i) {
+        const auto& oldKeys = lists[i];
+        const auto& newKeys = lists[i + 1];
+        std::unordered_map<uint64_t, std::vector<size_t>> oldMap;
+        oldMap.reserve(oldKeys.size());
+        for (size_t j = 0; j < oldKeys.size(); ++j) {
+            oldMap[oldKeys[j]].push_back(j);
+        }
+        std::vector<bool> consumed(oldKeys.size(), false);
+        std::vector<size_t> matched(newKeys.size(), kNoTabLayoutMatch);
+        for (size_t j = 0; j < newKeys.size(); ++j) {
+            auto it = oldMap.find(newKeys[j]);
+            if (it == oldMap.end() || it->second.empty()) {
+                continue;
+            }
+            matched[j] = it->second.back();
+            consumed[matched[j]] = true;
+            it->second.pop_back();
+            ++mapMatched;
+        }
+    }
+    const double mapMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mapStart).count();
+
+    TabLayoutDiffer differ;
+    size_t keyedMatched = 0;
+    size_t moves = 0;
+    const auto keyedStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < kDiffs; ++i) {
+        const TabLayoutDiffResult& result = Diff(differ, lists[i], lists[i + 1]);
+        keyedMatched += lists[i + 1].size() - result.inserted;
+        moves += result.moved;
+    }
+    const double keyedMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - keyedStart).count();
+
+    if (keyedMatched != mapMatched) {
+        PrintFailure(L"TestDiffBenchmark", L"Expected both matchings to pair the same number of items");
+        return false;
+    }
+    if (moves > static_cast<size_t>(kDiffs) * 2) {
+        PrintFailure(L"TestDiffBenchmark", L"Expected about one move per drag, got " + std::to_wstring(moves));
+        return false;
+    }
+
+    std::wcout << L"[TestDiffBenchmark] " << kItems << L" items, " << kDiffs << L" diffs, " << moves
+               << L" moves: map " << std::fixed << std::setprecision(2) << mapMs << L" ms, keyed " << keyedMs
+               << L" ms" << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::vector<TestDefinition> tests = {
+        {L"TestClassifiesOps", &TestClassifiesOps},
+        {L"TestDuplicateKeysUseHintAndRank", &TestDuplicateKeysUseHintAndRank},
+        {L"TestRandomizedDiffs", &TestRandomizedDiffs},
+        {L"TestWarmDifferKeepsBuffers", &TestWarmDifferKeepsBuffers},
+        {L"TestDiffBenchmark", &TestDiffBenchmark},
+    };
+
+    bool success = true;
+    for (const auto& test : tests) {
+        if (!test.fn()) {
+            std::wcerr << L"[FAILED] " << test.name << std::endl;
+            success = false;
+        } else {
+            std::wcout << L"[PASSED] " << test.name << std::endl;
+        }
+    }
+
+    if (!success) {
+        std::wcerr << L"Tab layout diff tests failed." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Tab layout diff tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <windows.h>
+
+struct ITEMIDLIST;
+using PIDLIST_ABSOLUTE = ITEMIDLIST*;
+using PCIDLIST_ABSOLUTE = const ITEMIDLIST*;
@@ -0,0 +1,5 @@
+#pragma once
+
+struct IShellItem;
+struct IShellBrowser;
+struct IWebBrowser2;
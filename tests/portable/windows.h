@@ -0,0 +1,32 @@
+#pragma once
+
+// The slice of the Win32 headers that the options model and codec compile
+// against, so their tests can run on hosts without the Windows SDK. Only
+// portable test targets put this directory on the include path.
+
+#include <cstdint>
+
+using BYTE = uint8_t;
+using WORD = uint16_t;
+using DWORD = uint32_t;
+using UINT = unsigned int;
+using BOOL = int;
+using COLORREF = DWORD;
+
+struct HWND__;
+using HWND = HWND__*;
+struct HICON__;
+using HICON = HICON__*;
+
+struct SIZE {
+    long cx;
+    long cy;
+};
+
+constexpr COLORREF RGB(unsigned r, unsigned g, unsigned b) {
+    return static_cast<COLORREF>((r & 0xFF) | ((g & 0xFF) << 8) | ((b & 0xFF) << 16));
+}
+
+constexpr BYTE GetRValue(COLORREF color) { return static_cast<BYTE>(color & 0xFF); }
+constexpr BYTE GetGValue(COLORREF color) { return static_cast<BYTE>((color >> 8) & 0xFF); }
+constexpr BYTE GetBValue(COLORREF color) { return static_cast<BYTE>((color >> 16) & 0xFF); }
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace Microsoft::WRL {
+
+template <typename T>
+class ComPtr;
+
+}  // namespace Microsoft::WRL
@@ -0,0 +1,217 @@
+// Replays a recorded cache access trace against every eviction policy and
+// prints the hit rate and peak resident size each achieves at a range of
+// capacities.
+//
+// Traces are either binary files written by CacheTraceRecorder or text with
+// one key per line. In text traces a line starting with '-' invalidates the
+// key that follows it; blank lines and lines starting with '#' are ignored.
+//
+// Usage: ShellTabsCacheTraceReplay [--source=icon|preview|listview]
+//                                  <trace-file> [capacity...]
+
+#include "CachePolicy.h"
+#include "CacheTraceRecorder.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Sources share one key space in the simulator, so keep them apart.
+uint64_t SimulatorKey(const shelltabs::CacheTraceRecord& record) {
+    return record.keyHash ^ (static_cast<uint64_t>(record.source) << 56);
+}
+
+struct TraceEvent {
+    uint64_t key = 0;
+    size_t bytes = 0;
+    bool invalidate = false;
+};
+
+// Converts recorder events into accesses. Hits and misses replay as lookups
+// sized by the last insert recorded for the key; the recorded cache's own
+// evictions are dropped since the simulator makes its own.
+bool LoadBinaryTrace(const char* path, std::optional<shelltabs::CacheTraceSource> source,
+                     std::vector<TraceEvent>* events) {
+    std::vector<shelltabs::CacheTraceRecord> records;
+    if (!shelltabs::ReadCacheTrace(path, &records)) {
+        return false;
+    }
+
+    std::unordered_map<uint64_t, size_t> sizes;
+    uint64_t hits = 0;
+    uint64_t lookups = 0;
+    for (const auto& record : records) {
+        if (source && record.source != static_cast<uint8_t>(*source)) {
+            continue;
+        }
+        if (record.event == static_cast<uint8_t>(shelltabs::CacheTraceEvent::kInsert) && record.sizeBytes != 0) {
+            sizes[SimulatorKey(record)] = record.sizeBytes;
+        }
+    }
+
+    for (const auto& record : records) {
+        if (source && record.source != static_cast<uint8_t>(*source)) {
+            continue;
+        }
+        const uint64_t key = SimulatorKey(record);
+        switch (static_cast<shelltabs::CacheTraceEvent>(record.event)) {
+            case shelltabs::CacheTraceEvent::kHit:
+                ++hits;
+                [[fallthrough]];
+            case shelltabs::CacheTraceEvent::kMiss: {
+                ++lookups;
+                auto size = sizes.find(key);
+                events->push_back({key, size != sizes.end() ? size->second : record.sizeBytes, false});
+                break;
+            }
+            case shelltabs::CacheTraceEvent::kInvalidate:
+                events->push_back({key, 0, true});
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::printf("%zu records, recorded hit rate %.2f%%\n", records.size(),
+                lookups == 0 ? 0.0 : static_cast<double>(hits) * 100.0 / static_cast<double>(lookups));
+    return true;
+}
+
+bool IsBinaryTrace(const char* path) {
+    std::ifstream stream(path, std::ios::binary);
+    char magic[sizeof(shelltabs::CacheTraceFileHeader::magic)] = {};
+    const shelltabs::CacheTraceFileHeader header;
+    return stream.read(magic, sizeof(magic)) && std::memcmp(magic, header.magic, sizeof(magic)) == 0;
+}
+
+bool LoadTextTrace(const char* path, std::vector<TraceEvent>* events) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::string_view view(line);
+        if (!view.empty() && view.back() == '\r') {
+            view.remove_suffix(1);
+        }
+        if (view.empty() || view.front() == '#') {
+            continue;
+        }
+        TraceEvent event;
+        if (view.front() == '-') {
+            event.invalidate = true;
+            view.remove_prefix(1);
+        }
+        event.key = shelltabs::HashCacheKey(view);
+        events->push_back(event);
+    }
+    return true;
+}
+
+std::optional<shelltabs::CacheTraceSource> ParseSource(std::string_view name) {
+    for (auto source : {shelltabs::CacheTraceSource::kIcon, shelltabs::CacheTraceSource::kPreview,
+                        shelltabs::CacheTraceSource::kListView}) {
+        if (name == shelltabs::CacheTraceSourceName(source)) {
+            return source;
+        }
+    }
+    return std::nullopt;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int arg = 1;
+    std::optional<shelltabs::CacheTraceSource> source;
+    constexpr std::string_view kSourceFlag = "--source=";
+    if (arg < argc && std::string_view(argv[arg]).substr(0, kSourceFlag.size()) == kSourceFlag) {
+        source = ParseSource(std::string_view(argv[arg]).substr(kSourceFlag.size()));
+        if (!source) {
+            std::fprintf(stderr, "unknown source %s\n", argv[arg]);
+            return 2;
+        }
+        ++arg;
+    }
+    if (arg >= argc) {
+        std::fprintf(stderr, "usage: %s [--source=icon|preview|listview] <trace-file> [capacity...]\n", argv[0]);
+        return 2;
+    }
+
+    const char* path = argv[arg++];
+    std::vector<TraceEvent> events;
+    const bool loaded = IsBinaryTrace(path) ? LoadBinaryTrace(path, source, &events) : LoadTextTrace(path, &events);
+    if (!loaded) {
+        std::fprintf(stderr, "cannot read trace %s\n", path);
+        return 1;
+    }
+
+    std::vector<size_t> capacities;
+    for (int i = arg; i < argc; ++i) {
+        const long long value = std::atoll(argv[i]);
+        if (value > 0) {
+            capacities.push_back(static_cast<size_t>(value));
+        }
+    }
+    if (capacities.empty()) {
+        capacities = {32, 64, 128, 256, 512};
+    }
+
+    std::printf("%zu events\n", events.size());
+
+    struct Result {
+        double hitRate = 0.0;
+        size_t peakBytes = 0;
+    };
+    std::vector<std::vector<Result>> results;
+    for (size_t capacity : capacities) {
+        auto& row = results.emplace_back();
+        for (shelltabs::CacheEvictionPolicy policy : shelltabs::kCacheEvictionPolicies) {
+            shelltabs::CachePolicySimulator simulator(policy, capacity);
+            for (const TraceEvent& event : events) {
+                if (event.invalidate) {
+                    simulator.Invalidate(event.key);
+                } else {
+                    simulator.Access(event.key, event.bytes);
+                }
+            }
+            row.push_back({simulator.HitRate(), simulator.PeakBytes()});
+        }
+    }
+
+    std::printf("\nhit rate\n%10s", "capacity");
+    for (shelltabs::CacheEvictionPolicy policy : shelltabs::kCacheEvictionPolicies) {
+        std::printf("%10s", shelltabs::CacheEvictionPolicyName(policy));
+    }
+    std::printf("\n");
+    for (size_t i = 0; i < capacities.size(); ++i) {
+        std::printf("%10zu", capacities[i]);
+        for (const Result& result : results[i]) {
+            std::printf("%9.2f%%", result.hitRate * 100.0);
+        }
+        std::printf("\n");
+    }
+
+    std::printf("\npeak resident KiB\n%10s", "capacity");
+    for (shelltabs::CacheEvictionPolicy policy : shelltabs::kCacheEvictionPolicies) {
+        std::printf("%10s", shelltabs::CacheEvictionPolicyName(policy));
+    }
+    std::printf("\n");
+    for (size_t i = 0; i < capacities.size(); ++i) {
+        std::printf("%10zu", capacities[i]);
+        for (const Result& result : results[i]) {
+            std::printf("%10zu", (result.peakBytes + 1023) / 1024);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}